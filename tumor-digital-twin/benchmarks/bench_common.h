@@ -0,0 +1,84 @@
+#pragma once
+
+#include <benchmark/benchmark.h>
+#include <cstdint>
+#include <random>
+#include <string>
+
+#include "simulation.pb.h"
+#include "simulation/diffusion_solver.h"
+#include "simulation/scalar_grid.h"
+#include "simulation/simulation_engine.h"
+#include "utils/profiler.h"
+
+namespace tumordtwin {
+namespace bench {
+
+/**
+ * @brief Parameters of a cubic domain of n^3 voxels seeded with `cells` tumor cells
+ */
+inline SimulationParameters cubeParameters(int n, int64_t cells, int num_threads = 1) {
+    SimulationParameters params;
+    params.set_grid_size_x(n);
+    params.set_grid_size_y(n);
+    params.set_grid_size_z(n);
+    params.set_spatial_resolution(10.0);
+    params.set_num_steps(1000000);
+    params.set_time_step(0.1);
+    params.set_mutation_rate(0.001);
+    params.set_division_rate(0.5);
+    params.set_death_rate(0.05);
+    params.set_migration_rate(0.1);
+    params.set_oxygen_diffusion_coeff(100.0);
+    params.set_glucose_diffusion_coeff(80.0);
+    params.set_num_threads(num_threads);
+    params.set_num_mpi_ranks(1);
+    (*params.mutable_extra_params())[SimulationEngine::kParamInitialTumorCells] =
+        static_cast<double>(cells);
+    return params;
+}
+
+/**
+ * @brief Field with uniformly random values, so no kernel can skip work
+ */
+inline ScalarGrid randomField(int nx, int ny, int nz, unsigned seed = 42) {
+    ScalarGrid field(nx, ny, nz, 10.0);
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<double> dist(0.0, 1.0);
+    for (size_t i = 0; i < field.size(); ++i) {
+        field.data()[i] = dist(rng);
+    }
+    return field;
+}
+
+/**
+ * @brief Oxygen coefficients at the largest stable time step of a 10 um lattice
+ */
+inline DiffusionParams oxygenParams() {
+    DiffusionParams params;
+    params.diffusion_coeff = 100.0;
+    params.decay_rate = 0.01;
+    params.boundary_value = 1.0;
+    return params;
+}
+
+inline double stableTimeStep(const DiffusionParams& params) {
+    return DiffusionSolver::maxStableTimeStep(params.diffusion_coeff, 10.0);
+}
+
+/**
+ * @brief Report the mean time per call of every profiled phase as "<phase>_ms" counters
+ */
+inline void reportPhases(benchmark::State& state, const StepProfiler& profiler) {
+    for (size_t p = 0; p < kNumProfilePhases; ++p) {
+        const auto phase = static_cast<ProfilePhase>(p);
+        const StepProfiler::PhaseStats& stats = profiler.stats(phase);
+        if (stats.calls > 0) {
+            state.counters[std::string(profilePhaseName(phase)) + "_ms"] =
+                static_cast<double>(stats.total_ns) / static_cast<double>(stats.calls) / 1e6;
+        }
+    }
+}
+
+} // namespace bench
+} // namespace tumordtwin
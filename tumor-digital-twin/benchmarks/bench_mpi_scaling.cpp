@@ -0,0 +1,118 @@
+#include <benchmark/benchmark.h>
+#include <mpi.h>
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "bench_common.h"
+#include "simulation/domain_decomposition.h"
+
+using namespace tumordtwin;
+
+// Slab-decomposed diffusion over MPI, one benchmark process per rank:
+//
+//   mpirun -n 8 bench_mpi_scaling --benchmark_out=mpi.json --benchmark_out_format=json
+//
+// Every rank runs the same benchmarks with fixed iteration counts, since
+// the steps are collective and ranks must not disagree on when to stop.
+// Each iteration is timed as the slowest rank's time; only rank 0 reports.
+
+namespace {
+
+constexpr int kStrongEdge = 256;
+constexpr int kWeakEdge = 128;
+constexpr int kWeakPlanesPerRank = 32;
+constexpr int kStepsPerIteration = 4;
+constexpr int kIterations = 20;
+
+int worldSize() {
+    int size = 1;
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+    return size;
+}
+
+void runSlabDiffusion(benchmark::State& state, int nx, int ny, int nz) {
+    MpiSlabTransport transport;
+    SlabDomain domain(nx, ny, nz, 10.0, transport);
+    ScalarGrid field;
+    domain.allocate(field);
+    const ScalarGrid noise = bench::randomField(nx, ny, field.nz(),
+                                                42u + static_cast<unsigned>(domain.rank()));
+    field = noise;
+
+    const DiffusionParams params = bench::oxygenParams();
+    const double dt = bench::stableTimeStep(params);
+    DiffusionSolver solver(1);
+
+    for (auto _ : state) {
+        MPI_Barrier(MPI_COMM_WORLD);
+        const auto start = std::chrono::steady_clock::now();
+        for (int s = 0; s < kStepsPerIteration; ++s) {
+            domain.diffuse(solver, field, params, dt);
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+                             .count();
+        MPI_Allreduce(MPI_IN_PLACE, &seconds, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+        state.SetIterationTime(seconds);
+    }
+    state.counters["ranks"] = transport.numRanks();
+    state.SetItemsProcessed(state.iterations() * kStepsPerIteration *
+                            static_cast<int64_t>(nx) * ny * nz);
+}
+
+// Discards results on ranks other than 0
+class NullReporter : public benchmark::BenchmarkReporter {
+public:
+    bool ReportContext(const Context&) override { return true; }
+    void ReportRuns(const std::vector<Run>&) override {}
+};
+
+} // namespace
+
+static void BM_StrongScalingMpiRanks(benchmark::State& state) {
+    runSlabDiffusion(state, kStrongEdge, kStrongEdge, kStrongEdge);
+}
+BENCHMARK(BM_StrongScalingMpiRanks)
+    ->Iterations(kIterations)
+    ->UseManualTime()
+    ->Unit(benchmark::kMillisecond);
+
+static void BM_WeakScalingMpiRanks(benchmark::State& state) {
+    runSlabDiffusion(state, kWeakEdge, kWeakEdge, kWeakPlanesPerRank * worldSize());
+}
+BENCHMARK(BM_WeakScalingMpiRanks)
+    ->Iterations(kIterations)
+    ->UseManualTime()
+    ->Unit(benchmark::kMillisecond);
+
+int main(int argc, char** argv) {
+    MPI_Init(&argc, &argv);
+    int rank = 0;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+    // Only rank 0 writes --benchmark_out
+    std::vector<char*> args;
+    for (int i = 0; i < argc; ++i) {
+        if (rank == 0 || std::strncmp(argv[i], "--benchmark_out", 15) != 0) {
+            args.push_back(argv[i]);
+        }
+    }
+    int num_args = static_cast<int>(args.size());
+    args.push_back(nullptr);
+
+    benchmark::Initialize(&num_args, args.data());
+    if (benchmark::ReportUnrecognizedArguments(num_args, args.data())) {
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    if (rank == 0) {
+        benchmark::AddCustomContext("mpi_ranks", std::to_string(worldSize()));
+        benchmark::RunSpecifiedBenchmarks();
+    } else {
+        NullReporter reporter;
+        benchmark::RunSpecifiedBenchmarks(&reporter);
+    }
+    benchmark::Shutdown();
+    MPI_Finalize();
+    return 0;
+}
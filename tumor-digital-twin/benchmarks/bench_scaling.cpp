@@ -0,0 +1,210 @@
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "bench_common.h"
+#include "simulation/domain_decomposition.h"
+
+using namespace tumordtwin;
+
+// Strong scaling keeps the problem fixed while workers are added, so the
+// ideal time falls as 1/workers. Weak scaling grows the domain along z
+// with the workers, so the ideal time stays flat. Every benchmark reports
+// its worker count as a counter; efficiencies are computed from the JSON
+// output against the single-worker run.
+
+namespace {
+
+constexpr int kStrongEdge = 256;
+constexpr int kWeakEdge = 128;
+constexpr int kWeakPlanesPerWorker = 32;
+constexpr int kStepsPerIteration = 4;
+
+// 1, 2, 4, ... up to the hardware concurrency, plus the concurrency itself
+void workerCounts(benchmark::internal::Benchmark* b) {
+    const int max_workers = std::max(1u, std::thread::hardware_concurrency());
+    for (int workers = 1; workers < max_workers; workers *= 2) {
+        b->Arg(workers);
+    }
+    b->Arg(max_workers);
+}
+
+// Rank state of an in-process slab decomposition, built once per benchmark
+struct LocalRanks {
+    LocalRanks(int nx, int ny, int nz, int num_ranks) : fabric(num_ranks) {
+        const ScalarGrid global = bench::randomField(nx, ny, nz);
+        for (int rank = 0; rank < num_ranks; ++rank) {
+            domains.push_back(std::make_unique<SlabDomain>(nx, ny, nz, 10.0,
+                                                           fabric.transport(rank)));
+            fields.emplace_back();
+            domains.back()->allocate(fields.back());
+            ScalarGrid& local = fields.back();
+            for (int k = 0; k < local.nz(); ++k) {
+                const int global_k = domains.back()->globalPlane(k);
+                for (int j = 0; j < ny; ++j) {
+                    for (int i = 0; i < nx; ++i) {
+                        local.at(i, j, k) = global.at(i, j, global_k);
+                    }
+                }
+            }
+            solvers.emplace_back(1);
+        }
+    }
+
+    // One thread per rank, like the processes of an MPI job
+    void diffuse(const DiffusionParams& params, double dt, int steps) {
+        std::vector<std::thread> threads;
+        for (int rank = 0; rank < fabric.numRanks(); ++rank) {
+            threads.emplace_back([&, rank] {
+                for (int s = 0; s < steps; ++s) {
+                    domains[rank]->diffuse(solvers[rank], fields[rank], params, dt);
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
+
+    LocalSlabFabric fabric;
+    std::vector<std::unique_ptr<SlabDomain>> domains;
+    std::vector<ScalarGrid> fields;
+    std::vector<DiffusionSolver> solvers;
+};
+
+void reportScaling(benchmark::State& state, const char* workers_name, int workers,
+                   int64_t voxels) {
+    state.counters[workers_name] = workers;
+    state.SetItemsProcessed(state.iterations() * kStepsPerIteration * voxels);
+}
+
+} // namespace
+
+// ============================================================================
+// Threads: OpenMP diffusion and full engine steps
+// ============================================================================
+
+static void BM_StrongScalingDiffusionThreads(benchmark::State& state) {
+    const int threads = static_cast<int>(state.range(0));
+    ScalarGrid field = bench::randomField(kStrongEdge, kStrongEdge, kStrongEdge);
+    const DiffusionParams params = bench::oxygenParams();
+    const double dt = bench::stableTimeStep(params);
+    DiffusionSolver solver(threads);
+
+    for (auto _ : state) {
+        for (int s = 0; s < kStepsPerIteration; ++s) {
+            solver.step(field, params, dt);
+        }
+        benchmark::ClobberMemory();
+    }
+    reportScaling(state, "threads", threads, static_cast<int64_t>(field.size()));
+}
+BENCHMARK(BM_StrongScalingDiffusionThreads)
+    ->Apply(workerCounts)
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+
+static void BM_WeakScalingDiffusionThreads(benchmark::State& state) {
+    const int threads = static_cast<int>(state.range(0));
+    ScalarGrid field = bench::randomField(kWeakEdge, kWeakEdge,
+                                          kWeakPlanesPerWorker * threads);
+    const DiffusionParams params = bench::oxygenParams();
+    const double dt = bench::stableTimeStep(params);
+    DiffusionSolver solver(threads);
+
+    for (auto _ : state) {
+        for (int s = 0; s < kStepsPerIteration; ++s) {
+            solver.step(field, params, dt);
+        }
+        benchmark::ClobberMemory();
+    }
+    reportScaling(state, "threads", threads, static_cast<int64_t>(field.size()));
+}
+BENCHMARK(BM_WeakScalingDiffusionThreads)
+    ->Apply(workerCounts)
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+
+static void BM_StrongScalingEngineThreads(benchmark::State& state) {
+    const int threads = static_cast<int>(state.range(0));
+    SimulationEngine engine(bench::cubeParameters(128, 100000, threads), threads);
+    engine.initialize();
+    engine.profiler().reset();
+
+    for (auto _ : state) {
+        for (int s = 0; s < kStepsPerIteration; ++s) {
+            engine.step();
+        }
+    }
+    reportScaling(state, "threads", threads, int64_t{128} * 128 * 128);
+    bench::reportPhases(state, engine.profiler());
+}
+BENCHMARK(BM_StrongScalingEngineThreads)
+    ->Apply(workerCounts)
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+
+static void BM_WeakScalingEngineThreads(benchmark::State& state) {
+    const int threads = static_cast<int>(state.range(0));
+    SimulationParameters params = bench::cubeParameters(kWeakEdge, 10000 * threads, threads);
+    params.set_grid_size_z(kWeakPlanesPerWorker * threads);
+    SimulationEngine engine(params, threads);
+    engine.initialize();
+    engine.profiler().reset();
+
+    for (auto _ : state) {
+        for (int s = 0; s < kStepsPerIteration; ++s) {
+            engine.step();
+        }
+    }
+    reportScaling(state, "threads", threads,
+                  int64_t{kWeakEdge} * kWeakEdge * kWeakPlanesPerWorker * threads);
+    bench::reportPhases(state, engine.profiler());
+}
+BENCHMARK(BM_WeakScalingEngineThreads)
+    ->Apply(workerCounts)
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+
+// ============================================================================
+// Ranks: slab decomposition over the in-process transport
+// ============================================================================
+
+// Measures decomposition and halo overhead without a launcher; the MPI
+// transport is measured by bench_mpi_scaling under mpirun.
+static void BM_StrongScalingSlabRanks(benchmark::State& state) {
+    const int ranks = static_cast<int>(state.range(0));
+    LocalRanks local(kStrongEdge, kStrongEdge, kStrongEdge, ranks);
+    const DiffusionParams params = bench::oxygenParams();
+    const double dt = bench::stableTimeStep(params);
+
+    for (auto _ : state) {
+        local.diffuse(params, dt, kStepsPerIteration);
+    }
+    reportScaling(state, "ranks", ranks, int64_t{kStrongEdge} * kStrongEdge * kStrongEdge);
+}
+BENCHMARK(BM_StrongScalingSlabRanks)
+    ->Apply(workerCounts)
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+
+static void BM_WeakScalingSlabRanks(benchmark::State& state) {
+    const int ranks = static_cast<int>(state.range(0));
+    const int nz = kWeakPlanesPerWorker * ranks;
+    LocalRanks local(kWeakEdge, kWeakEdge, nz, ranks);
+    const DiffusionParams params = bench::oxygenParams();
+    const double dt = bench::stableTimeStep(params);
+
+    for (auto _ : state) {
+        local.diffuse(params, dt, kStepsPerIteration);
+    }
+    reportScaling(state, "ranks", ranks, int64_t{kWeakEdge} * kWeakEdge * nz);
+}
+BENCHMARK(BM_WeakScalingSlabRanks)
+    ->Apply(workerCounts)
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,211 @@
+#include <benchmark/benchmark.h>
+#include <memory>
+#include <string>
+
+#include "bench_common.h"
+#include "grpc_server.h"
+#include "storage/results_stream.h"
+
+using namespace tumordtwin;
+
+namespace {
+
+SimulationRequest validRequest(size_t dicom_bytes) {
+    SimulationRequest request;
+    request.set_patient_id("bench_patient");
+    request.set_simulation_name("bench");
+    PatientData* data = request.mutable_data();
+    data->set_patient_id("bench_patient");
+    data->mutable_dicom()->set_patient_id("bench_patient");
+    data->mutable_dicom()->set_modality("CT");
+    data->mutable_dicom()->set_dicom_archive(std::string(dicom_bytes, '\x5a'));
+    *request.mutable_params() = bench::cubeParameters(100, 1000);
+    return request;
+}
+
+// Engine state after a few steps; the snapshot is what results are served from
+std::shared_ptr<const SimulationSnapshot> engineSnapshot(int n, int64_t cells) {
+    SimulationEngine engine(bench::cubeParameters(n, cells), 1);
+    engine.initialize();
+    for (int i = 0; i < 3; ++i) {
+        engine.step();
+    }
+    return engine.snapshot();
+}
+
+SimulationState stateHeader(const SimulationSnapshot& snapshot) {
+    SimulationState header;
+    header.set_simulation_id("bench_sim");
+    header.set_patient_id("bench_patient");
+    header.set_current_step(snapshot.step);
+    header.set_current_time(snapshot.time);
+    header.set_status(SimulationStatus::COMPLETED);
+    *header.mutable_parameters() = snapshot.parameters;
+    *header.mutable_metrics() = snapshot.metrics;
+    return header;
+}
+
+ResultsRequest fullResults(GridCompression compression = GridCompression::COMPRESSION_NONE) {
+    ResultsRequest request;
+    request.set_simulation_id("bench_sim");
+    request.set_include_agents(true);
+    request.set_include_grid_data(true);
+    request.set_step_number(-1);
+    request.mutable_grid_encoding()->set_compression(compression);
+    return request;
+}
+
+// The whole state as one message, as a client reassembles it from the chunks
+SimulationState materializedState(int n, int64_t cells) {
+    auto snapshot = engineSnapshot(n, cells);
+    ResultsStream stream(stateHeader(*snapshot), snapshot);
+    std::string error_msg;
+    stream.init(fullResults(), error_msg);
+    std::string payload;
+    ResultsChunk chunk;
+    while (stream.next(&chunk)) {
+        payload += chunk.data();
+    }
+    SimulationState state;
+    state.ParseFromString(payload);
+    return state;
+}
+
+} // namespace
+
+// ============================================================================
+// Request validation
+// ============================================================================
+
+// Validation reads the patient data's presence, never its bytes, so the
+// time per request should not grow with the archive size
+static void BM_ValidateSimulationRequest(benchmark::State& state) {
+    const SimulationRequest request = validRequest(static_cast<size_t>(state.range(0)));
+    std::string error_msg;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(
+            SimulationServiceImpl::validateSimulationRequest(request, error_msg));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ValidateSimulationRequest)->RangeMultiplier(64)->Range(1 << 10, 1 << 26);
+
+static void BM_ValidateSimulationParameters(benchmark::State& state) {
+    const SimulationParameters params = bench::cubeParameters(100, 1000);
+    std::string error_msg;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(
+            SimulationServiceImpl::validateSimulationParameters(params, error_msg));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ValidateSimulationParameters);
+
+// Server-side cost of receiving a request: parsing it, then validating it
+static void BM_ParseAndValidateRequest(benchmark::State& state) {
+    const std::string wire = validRequest(static_cast<size_t>(state.range(0))).SerializeAsString();
+    std::string error_msg;
+    for (auto _ : state) {
+        SimulationRequest request;
+        request.ParseFromString(wire);
+        benchmark::DoNotOptimize(
+            SimulationServiceImpl::validateSimulationRequest(request, error_msg));
+    }
+    state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(wire.size()));
+}
+BENCHMARK(BM_ParseAndValidateRequest)->RangeMultiplier(64)->Range(1 << 10, 1 << 26);
+
+// A request with bad parameters as the completion-queue server receives it:
+// refused from the envelope, so the time should not grow with the archive
+static void BM_RejectRequestFromWire(benchmark::State& state) {
+    SimulationRequest request = validRequest(static_cast<size_t>(state.range(0)));
+    request.mutable_params()->set_num_steps(0);
+    grpc::ByteBuffer wire;
+    bool own_buffer = false;
+    grpc::SerializationTraits<SimulationRequest>::Serialize(request, &wire, &own_buffer);
+    SimulationServiceImpl service;
+    for (auto _ : state) {
+        grpc::ByteBuffer response;
+        benchmark::DoNotOptimize(service.startSimulationFromWire(nullptr, &wire, &response));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_RejectRequestFromWire)->RangeMultiplier(64)->Range(1 << 10, 1 << 26);
+
+// ============================================================================
+// SimulationState serialization
+// ============================================================================
+
+// Args: lattice edge, tumor cells
+static void BM_SerializeSimulationState(benchmark::State& state) {
+    const SimulationState message = materializedState(static_cast<int>(state.range(0)),
+                                                      state.range(1));
+    std::string bytes;
+    for (auto _ : state) {
+        bytes.clear();
+        message.SerializeToString(&bytes);
+        benchmark::DoNotOptimize(bytes.data());
+    }
+    state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(bytes.size()));
+    state.counters["message_bytes"] = static_cast<double>(bytes.size());
+}
+BENCHMARK(BM_SerializeSimulationState)
+    ->Args({32, 1000})
+    ->Args({64, 10000})
+    ->Args({128, 50000})
+    ->Unit(benchmark::kMillisecond);
+
+static void BM_ParseSimulationState(benchmark::State& state) {
+    const std::string bytes = materializedState(static_cast<int>(state.range(0)),
+                                                state.range(1))
+                                  .SerializeAsString();
+    for (auto _ : state) {
+        SimulationState message;
+        benchmark::DoNotOptimize(message.ParseFromString(bytes));
+    }
+    state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(bytes.size()));
+}
+BENCHMARK(BM_ParseSimulationState)
+    ->Args({32, 1000})
+    ->Args({64, 10000})
+    ->Args({128, 50000})
+    ->Unit(benchmark::kMillisecond);
+
+// ============================================================================
+// ResultsChunk streaming
+// ============================================================================
+
+// Everything GetSimulationResults does per request except the network write.
+// Args: lattice edge, tumor cells, GridCompression
+static void BM_ResultsStream(benchmark::State& state) {
+    auto snapshot = engineSnapshot(static_cast<int>(state.range(0)), state.range(1));
+    const SimulationState header = stateHeader(*snapshot);
+    const ResultsRequest request = fullResults(static_cast<GridCompression>(state.range(2)));
+
+    size_t bytes = 0;
+    int64_t chunks = 0;
+    for (auto _ : state) {
+        ResultsStream stream(header, snapshot);
+        std::string error_msg;
+        if (!stream.init(request, error_msg)) {
+            state.SkipWithError(error_msg.c_str());
+            break;
+        }
+        ResultsChunk chunk;
+        while (stream.next(&chunk)) {
+            benchmark::DoNotOptimize(chunk.data().data());
+            ++chunks;
+        }
+        bytes += stream.totalBytes();
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(bytes));
+    state.counters["chunks"] = benchmark::Counter(static_cast<double>(chunks),
+                                                  benchmark::Counter::kAvgIterations);
+}
+BENCHMARK(BM_ResultsStream)
+    ->Args({64, 10000, GridCompression::COMPRESSION_NONE})
+    ->Args({128, 50000, GridCompression::COMPRESSION_NONE})
+    ->Args({128, 50000, GridCompression::COMPRESSION_DEFLATE})
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
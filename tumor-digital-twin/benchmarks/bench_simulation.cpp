@@ -0,0 +1,175 @@
+#include <benchmark/benchmark.h>
+#include <random>
+
+#include "bench_common.h"
+#include "simulation/agent_store.h"
+#include "simulation/brick_grid.h"
+#include "simulation/spatial_index.h"
+
+using namespace tumordtwin;
+
+// ============================================================================
+// Diffusion stencil
+// ============================================================================
+
+// One explicit step of an n^3 field on one thread
+static void BM_DiffusionStep(benchmark::State& state) {
+    const int n = static_cast<int>(state.range(0));
+    ScalarGrid field = bench::randomField(n, n, n);
+    const DiffusionParams params = bench::oxygenParams();
+    const double dt = bench::stableTimeStep(params);
+    DiffusionSolver solver(1);
+
+    for (auto _ : state) {
+        solver.step(field, params, dt);
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(field.size()));
+    // Read and written once per step
+    state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(field.size()) * 2 *
+                            static_cast<int64_t>(sizeof(double)));
+}
+BENCHMARK(BM_DiffusionStep)->RangeMultiplier(2)->Range(32, 256)->Unit(benchmark::kMillisecond);
+
+static void BM_DiffusionStepWithUptake(benchmark::State& state) {
+    const int n = static_cast<int>(state.range(0));
+    ScalarGrid field = bench::randomField(n, n, n);
+    const ScalarGrid uptake = bench::randomField(n, n, n, 7);
+    const DiffusionParams params = bench::oxygenParams();
+    const double dt = bench::stableTimeStep(params) * 0.5;
+    DiffusionSolver solver(1);
+
+    for (auto _ : state) {
+        solver.step(field, params, dt, &uptake);
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(field.size()));
+}
+BENCHMARK(BM_DiffusionStepWithUptake)
+    ->RangeMultiplier(2)
+    ->Range(32, 256)
+    ->Unit(benchmark::kMillisecond);
+
+static void BM_DiffusionStepNeumann(benchmark::State& state) {
+    const int n = static_cast<int>(state.range(0));
+    ScalarGrid field = bench::randomField(n, n, n);
+    DiffusionParams params = bench::oxygenParams();
+    params.boundary = BoundaryCondition::Neumann;
+    const double dt = bench::stableTimeStep(params);
+    DiffusionSolver solver(1);
+
+    for (auto _ : state) {
+        solver.step(field, params, dt);
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(field.size()));
+}
+BENCHMARK(BM_DiffusionStepNeumann)->Arg(64)->Arg(128)->Unit(benchmark::kMillisecond);
+
+// A small perturbation in a large uniform domain, as the sparse path sees a young tumor.
+// Args: lattice edge, edge of the perturbed cube
+static void BM_SparseDiffusionStep(benchmark::State& state) {
+    const int n = static_cast<int>(state.range(0));
+    const int blob = static_cast<int>(state.range(1));
+    BrickGrid field(n, n, n, 10.0, 1.0);
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<double> dist(0.0, 1.0);
+    const int lo = (n - blob) / 2;
+    for (int k = lo; k < lo + blob; ++k) {
+        for (int j = lo; j < lo + blob; ++j) {
+            for (int i = lo; i < lo + blob; ++i) {
+                field.at(i, j, k) = dist(rng);
+            }
+        }
+    }
+    const DiffusionParams params = bench::oxygenParams();
+    const double dt = bench::stableTimeStep(params);
+    DiffusionSolver solver(1);
+
+    for (auto _ : state) {
+        solver.step(field, params, dt, nullptr, 1e-9);
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(field.size()));
+    state.counters["dense_bricks"] = static_cast<double>(field.denseBricks());
+}
+BENCHMARK(BM_SparseDiffusionStep)
+    ->Args({256, 16})
+    ->Args({512, 16})
+    ->Args({512, 64})
+    ->Unit(benchmark::kMillisecond);
+
+// ============================================================================
+// Agent update
+// ============================================================================
+
+// Full engine steps; the per-phase counters split out the agent update,
+// lifecycle and neighbor index from diffusion. Args: lattice edge, tumor cells
+static void BM_EngineStep(benchmark::State& state) {
+    SimulationEngine engine(bench::cubeParameters(static_cast<int>(state.range(0)),
+                                                  state.range(1)),
+                            1);
+    engine.initialize();
+    engine.profiler().reset();
+
+    for (auto _ : state) {
+        engine.step();
+    }
+    state.SetItemsProcessed(state.iterations() *
+                            static_cast<int64_t>(engine.agents().size()));
+    state.counters["agents"] = static_cast<double>(engine.agents().size());
+    bench::reportPhases(state, engine.profiler());
+}
+BENCHMARK(BM_EngineStep)
+    ->Args({64, 1000})
+    ->Args({64, 10000})
+    ->Args({128, 100000})
+    ->Unit(benchmark::kMillisecond);
+
+static AgentStore randomAgents(size_t count, double extent) {
+    AgentStore agents;
+    agents.reserve(count);
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<double> position(0.0, extent);
+    for (size_t i = 0; i < count; ++i) {
+        agents.add(AgentType::CANCER_CELL, position(rng), position(rng), position(rng));
+    }
+    return agents;
+}
+
+// Neighbor index rebuild from scratch, as after a checkpoint restore
+static void BM_SpatialIndexRebuild(benchmark::State& state) {
+    const int n = 128;
+    const AgentStore agents = randomAgents(static_cast<size_t>(state.range(0)), n * 10.0);
+    SpatialIndex index;
+    index.reset(n, n, n, 10.0);
+
+    for (auto _ : state) {
+        index.rebuild(agents);
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_SpatialIndexRebuild)->RangeMultiplier(10)->Range(1000, 1000000);
+
+// Neighbor queries at the contact radius for every agent
+static void BM_NeighborQueries(benchmark::State& state) {
+    const int n = 128;
+    const AgentStore agents = randomAgents(static_cast<size_t>(state.range(0)), n * 10.0);
+    SpatialIndex index;
+    index.reset(n, n, n, 10.0);
+    index.rebuild(agents);
+
+    for (auto _ : state) {
+        size_t neighbors = 0;
+        for (size_t i = 0; i < agents.size(); ++i) {
+            index.forEachNeighbor(agents, agents.x()[i], agents.y()[i], agents.z()[i], 10.0,
+                                  [&](size_t) { ++neighbors; });
+        }
+        benchmark::DoNotOptimize(neighbors);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_NeighborQueries)->RangeMultiplier(10)->Range(1000, 1000000);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,507 @@
+#include <grpcpp/grpcpp.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "grpc_server.h"
+#include "service.grpc.pb.h"
+
+// Mixed-traffic load generator for SimulationService.
+//
+// Drives four traffic classes at the same time for a fixed duration:
+//   start    StartSimulation in bursts of --burst-size every --burst-interval-ms
+//   status   GetSimulationStatus from --pollers threads at --poll-rate calls/s in total
+//   results  GetSimulationResults streams of a --results-grid^3 run, back to back
+//   list     ListSimulations walking every page of --list-page entries
+// and reports p50/p99/p999 latency, throughput and errors per class.
+//
+// Without --target it starts a GrpcServer in this process, so runs of
+// different server builds or configurations can be compared with the same
+// client; --label names a run in the report and the --json output.
+// Options prefixed with --server- configure that server, e.g.
+// --server-mode=async --server-cqs=4 (see GrpcServerOptions::set).
+
+using namespace tumordtwin;
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+struct Options {
+    std::string target;  // Empty = in-process server
+    std::string label = "default";
+    std::string json_path;
+    double duration_s = 30.0;
+    int channels = 4;
+    int pollers = 8;
+    double poll_rate = 2000.0;  // Calls/s over all pollers; 0 = as fast as possible
+    int burst_size = 32;
+    int burst_interval_ms = 1000;
+    int results_streams = 2;
+    int results_grid = 64;
+    int list_clients = 2;
+    int list_page = 50;
+    int seed_simulations = 200;
+    GrpcServerOptions server;  // In-process server only
+};
+
+bool parseOptions(int argc, char** argv, Options& options) {
+    using Setter = std::function<void(const std::string&)>;
+    auto text = [](std::string& field) {
+        return Setter([&field](const std::string& value) { field = value; });
+    };
+    auto integer = [](int& field) {
+        return Setter([&field](const std::string& value) { field = std::stoi(value); });
+    };
+    auto real = [](double& field) {
+        return Setter([&field](const std::string& value) { field = std::stod(value); });
+    };
+    const std::map<std::string, Setter> setters = {
+        {"target", text(options.target)},
+        {"label", text(options.label)},
+        {"json", text(options.json_path)},
+        {"duration", real(options.duration_s)},
+        {"channels", integer(options.channels)},
+        {"pollers", integer(options.pollers)},
+        {"poll-rate", real(options.poll_rate)},
+        {"burst-size", integer(options.burst_size)},
+        {"burst-interval-ms", integer(options.burst_interval_ms)},
+        {"results-streams", integer(options.results_streams)},
+        {"results-grid", integer(options.results_grid)},
+        {"list-clients", integer(options.list_clients)},
+        {"list-page", integer(options.list_page)},
+        {"seed-simulations", integer(options.seed_simulations)},
+    };
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const size_t eq = arg.find('=');
+        if (arg.rfind("--", 0) != 0 || eq == std::string::npos) {
+            std::cerr << "Expected --name=value, got " << arg << std::endl;
+            return false;
+        }
+        const std::string name = arg.substr(2, eq - 2);
+        if (name.rfind("server-", 0) == 0) {
+            std::string error_msg;
+            if (!options.server.set(name.substr(7), arg.substr(eq + 1), error_msg)) {
+                std::cerr << error_msg << std::endl;
+                return false;
+            }
+            continue;
+        }
+        const auto setter = setters.find(name);
+        if (setter == setters.end()) {
+            std::cerr << "Unknown option --" << name << std::endl;
+            return false;
+        }
+        try {
+            setter->second(arg.substr(eq + 1));
+        } catch (const std::exception&) {
+            std::cerr << "Invalid value for " << arg << std::endl;
+            return false;
+        }
+    }
+    if (options.channels < 1 || options.duration_s <= 0.0 || options.list_page < 1 ||
+        options.burst_interval_ms < 1) {
+        std::cerr << "--channels, --duration, --list-page and --burst-interval-ms must be positive"
+                  << std::endl;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Latencies and outcomes of one traffic class
+ *
+ * Each worker records into its own Recorder; they are merged after the run.
+ */
+struct Recorder {
+    std::vector<uint64_t> latencies_ns;
+    std::map<grpc::StatusCode, uint64_t> codes;
+    uint64_t bytes = 0;
+
+    void record(Clock::time_point start, const grpc::Status& status, uint64_t payload = 0) {
+        latencies_ns.push_back(static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count()));
+        ++codes[status.error_code()];
+        bytes += payload;
+    }
+
+    void merge(const Recorder& other) {
+        latencies_ns.insert(latencies_ns.end(), other.latencies_ns.begin(),
+                            other.latencies_ns.end());
+        for (const auto& entry : other.codes) {
+            codes[entry.first] += entry.second;
+        }
+        bytes += other.bytes;
+    }
+};
+
+struct ClassReport {
+    std::string name;
+    uint64_t calls = 0;
+    uint64_t errors = 0;
+    double throughput = 0.0;  // Calls/s
+    double mb_per_s = 0.0;
+    double p50_ms = 0.0;
+    double p99_ms = 0.0;
+    double p999_ms = 0.0;
+    double max_ms = 0.0;
+    std::map<grpc::StatusCode, uint64_t> codes;
+};
+
+ClassReport summarize(const std::string& name, Recorder recorder, double seconds) {
+    ClassReport report;
+    report.name = name;
+    report.calls = recorder.latencies_ns.size();
+    report.codes = recorder.codes;
+    for (const auto& entry : recorder.codes) {
+        if (entry.first != grpc::StatusCode::OK) {
+            report.errors += entry.second;
+        }
+    }
+    report.throughput = static_cast<double>(report.calls) / seconds;
+    report.mb_per_s = static_cast<double>(recorder.bytes) / seconds / 1e6;
+
+    std::vector<uint64_t>& samples = recorder.latencies_ns;
+    if (!samples.empty()) {
+        std::sort(samples.begin(), samples.end());
+        auto quantile = [&](double q) {
+            const size_t rank = static_cast<size_t>(q * static_cast<double>(samples.size() - 1));
+            return static_cast<double>(samples[rank]) / 1e6;
+        };
+        report.p50_ms = quantile(0.5);
+        report.p99_ms = quantile(0.99);
+        report.p999_ms = quantile(0.999);
+        report.max_ms = static_cast<double>(samples.back()) / 1e6;
+    }
+    return report;
+}
+
+// Small and quick, so bursts measure admission rather than simulation
+SimulationRequest simulationRequest(const std::string& patient_id, int grid, int num_steps) {
+    SimulationRequest request;
+    request.set_patient_id(patient_id);
+    request.set_simulation_name("loadgen");
+    PatientData* data = request.mutable_data();
+    data->set_patient_id(patient_id);
+    data->mutable_dicom()->set_patient_id(patient_id);
+    data->mutable_dicom()->set_dicom_archive("loadgen");
+    data->mutable_dicom()->set_modality("CT");
+
+    SimulationParameters* params = request.mutable_params();
+    params->set_grid_size_x(grid);
+    params->set_grid_size_y(grid);
+    params->set_grid_size_z(grid);
+    params->set_spatial_resolution(10.0);
+    params->set_num_steps(num_steps);
+    params->set_time_step(0.1);
+    params->set_mutation_rate(0.001);
+    params->set_division_rate(0.1);
+    params->set_death_rate(0.05);
+    params->set_migration_rate(0.01);
+    params->set_oxygen_diffusion_coeff(1.0);
+    params->set_glucose_diffusion_coeff(0.8);
+    params->set_num_threads(1);
+    params->set_num_mpi_ranks(1);
+    return request;
+}
+
+class LoadGenerator {
+public:
+    LoadGenerator(const Options& options, const std::string& address) : options_(options) {
+        // Separate subchannel pools, so every channel has its own connection
+        for (int c = 0; c < options.channels; ++c) {
+            grpc::ChannelArguments args;
+            args.SetInt(GRPC_ARG_USE_LOCAL_SUBCHANNEL_POOL, 1);
+            args.SetMaxReceiveMessageSize(-1);
+            stubs_.push_back(SimulationService::NewStub(
+                grpc::CreateCustomChannel(address, grpc::InsecureChannelCredentials(), args)));
+        }
+    }
+
+    /**
+     * @brief Start the simulations the status and results traffic reads
+     * @return false if the server accepted none of them
+     */
+    bool seed() {
+        for (int i = 0; i < options_.seed_simulations; ++i) {
+            grpc::ClientContext context;
+            SimulationResponse response;
+            if (stub(i).StartSimulation(&context, simulationRequest("loadgen_seed", 16, 10),
+                                        &response)
+                    .ok()) {
+                seeded_ids_.push_back(response.simulation_id());
+            }
+        }
+        if (options_.results_streams > 0) {
+            grpc::ClientContext context;
+            SimulationResponse response;
+            const int grid = options_.results_grid;
+            if (!stub(0).StartSimulation(&context, simulationRequest("loadgen_results", grid, 5),
+                                         &response)
+                     .ok()) {
+                return false;
+            }
+            results_id_ = response.simulation_id();
+            if (!waitForCompletion(results_id_)) {
+                std::cerr << "Results simulation did not complete" << std::endl;
+                return false;
+            }
+        }
+        return !seeded_ids_.empty();
+    }
+
+    std::vector<ClassReport> run() {
+        const Clock::time_point start = Clock::now();
+        deadline_ = start + std::chrono::duration_cast<Clock::duration>(
+                                std::chrono::duration<double>(options_.duration_s));
+
+        std::vector<std::thread> threads;
+        std::vector<Recorder> status(static_cast<size_t>(std::max(0, options_.pollers)));
+        std::vector<Recorder> results(static_cast<size_t>(std::max(0, options_.results_streams)));
+        std::vector<Recorder> list(static_cast<size_t>(std::max(0, options_.list_clients)));
+        Recorder starts;
+
+        if (options_.burst_size > 0) {
+            threads.emplace_back([&] { runBursts(starts); });
+        }
+        for (size_t i = 0; i < status.size(); ++i) {
+            threads.emplace_back([&, i] { runPoller(static_cast<int>(i), status[i]); });
+        }
+        for (size_t i = 0; i < results.size(); ++i) {
+            threads.emplace_back([&, i] { runResults(static_cast<int>(i), results[i]); });
+        }
+        for (size_t i = 0; i < list.size(); ++i) {
+            threads.emplace_back([&, i] { runList(static_cast<int>(i), list[i]); });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+        auto merged = [](const std::vector<Recorder>& recorders) {
+            Recorder all;
+            for (const auto& recorder : recorders) {
+                all.merge(recorder);
+            }
+            return all;
+        };
+        return {summarize("start", std::move(starts), seconds),
+                summarize("status", merged(status), seconds),
+                summarize("results", merged(results), seconds),
+                summarize("list", merged(list), seconds)};
+    }
+
+private:
+    SimulationService::Stub& stub(int worker) {
+        return *stubs_[static_cast<size_t>(worker) % stubs_.size()];
+    }
+
+    bool waitForCompletion(const std::string& simulation_id) {
+        const Clock::time_point deadline = Clock::now() + std::chrono::minutes(10);
+        while (Clock::now() < deadline) {
+            grpc::ClientContext context;
+            StatusRequest request;
+            request.set_simulation_id(simulation_id);
+            StatusResponse response;
+            if (!stub(0).GetSimulationStatus(&context, request, &response).ok()) {
+                return false;
+            }
+            if (response.status() == SimulationStatus::COMPLETED) {
+                return true;
+            }
+            if (response.status() == SimulationStatus::FAILED ||
+                response.status() == SimulationStatus::STOPPED) {
+                return false;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        }
+        return false;
+    }
+
+    // Every call of a burst is issued at once from its own thread
+    void runBursts(Recorder& recorder) {
+        std::mutex mutex;
+        const SimulationRequest request = simulationRequest("loadgen_burst", 16, 10);
+        Clock::time_point next = Clock::now();
+        while (next < deadline_) {
+            std::this_thread::sleep_until(next);
+            std::vector<std::thread> calls;
+            for (int i = 0; i < options_.burst_size; ++i) {
+                calls.emplace_back([&, i] {
+                    grpc::ClientContext context;
+                    SimulationResponse response;
+                    const Clock::time_point start = Clock::now();
+                    const grpc::Status status = stub(i).StartSimulation(&context, request,
+                                                                        &response);
+                    std::lock_guard<std::mutex> lock(mutex);
+                    recorder.record(start, status);
+                });
+            }
+            for (auto& call : calls) {
+                call.join();
+            }
+            next += std::chrono::milliseconds(options_.burst_interval_ms);
+        }
+    }
+
+    // Open loop at a fixed rate: latency counts from the scheduled send time,
+    // so a stalled server is charged for the calls it delayed
+    void runPoller(int worker, Recorder& recorder) {
+        const bool paced = options_.poll_rate > 0.0;
+        const auto interval = std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>(paced ? options_.pollers / options_.poll_rate : 0.0));
+        Clock::time_point next = Clock::now();
+        size_t cursor = static_cast<size_t>(worker);
+        while (Clock::now() < deadline_) {
+            if (paced) {
+                std::this_thread::sleep_until(next);
+            }
+            const Clock::time_point start = paced ? next : Clock::now();
+            grpc::ClientContext context;
+            StatusRequest request;
+            request.set_simulation_id(seeded_ids_[cursor++ % seeded_ids_.size()]);
+            StatusResponse response;
+            recorder.record(start, stub(worker).GetSimulationStatus(&context, request, &response));
+            next += interval;
+        }
+    }
+
+    // One record per whole stream; bytes are the payload of every chunk
+    void runResults(int worker, Recorder& recorder) {
+        ResultsRequest request;
+        request.set_simulation_id(results_id_);
+        request.set_include_agents(true);
+        request.set_include_grid_data(true);
+        request.set_step_number(-1);
+        while (Clock::now() < deadline_) {
+            grpc::ClientContext context;
+            const Clock::time_point start = Clock::now();
+            auto reader = stub(worker).GetSimulationResults(&context, request);
+            ResultsChunk chunk;
+            uint64_t bytes = 0;
+            while (reader->Read(&chunk)) {
+                bytes += chunk.data().size();
+            }
+            recorder.record(start, reader->Finish(), bytes);
+        }
+    }
+
+    // Each call fetches one page; a pass walks from offset 0 to the end
+    void runList(int worker, Recorder& recorder) {
+        int offset = 0;
+        while (Clock::now() < deadline_) {
+            grpc::ClientContext context;
+            ListRequest request;
+            request.set_limit(options_.list_page);
+            request.set_offset(offset);
+            SimulationList response;
+            const Clock::time_point start = Clock::now();
+            const grpc::Status status = stub(worker).ListSimulations(&context, request,
+                                                                     &response);
+            recorder.record(start, status);
+            offset += options_.list_page;
+            if (!status.ok() || offset >= response.total_count()) {
+                offset = 0;
+            }
+        }
+    }
+
+    const Options& options_;
+    std::vector<std::unique_ptr<SimulationService::Stub>> stubs_;
+    std::vector<std::string> seeded_ids_;
+    std::string results_id_;
+    Clock::time_point deadline_;
+};
+
+void printReport(const Options& options, const std::vector<ClassReport>& reports) {
+    std::cout << "Run: " << options.label << " (" << options.duration_s << " s)" << std::endl;
+    std::cout << std::left << std::setw(10) << "class" << std::right << std::setw(10)
+              << "calls" << std::setw(10) << "errors" << std::setw(12) << "calls/s"
+              << std::setw(10) << "MB/s" << std::setw(11) << "p50 ms" << std::setw(11)
+              << "p99 ms" << std::setw(11) << "p999 ms" << std::setw(11) << "max ms"
+              << std::endl;
+    std::cout << std::fixed << std::setprecision(2);
+    for (const auto& report : reports) {
+        if (report.calls == 0) {
+            continue;
+        }
+        std::cout << std::left << std::setw(10) << report.name << std::right << std::setw(10)
+                  << report.calls << std::setw(10) << report.errors << std::setw(12)
+                  << report.throughput << std::setw(10) << report.mb_per_s << std::setw(11)
+                  << report.p50_ms << std::setw(11) << report.p99_ms << std::setw(11)
+                  << report.p999_ms << std::setw(11) << report.max_ms << std::endl;
+        for (const auto& entry : report.codes) {
+            if (entry.first != grpc::StatusCode::OK) {
+                std::cout << "    status " << entry.first << ": " << entry.second << std::endl;
+            }
+        }
+    }
+}
+
+bool writeJson(const Options& options, const std::vector<ClassReport>& reports) {
+    std::ofstream out(options.json_path);
+    if (!out) {
+        return false;
+    }
+    out << "{\n  \"label\": \"" << options.label << "\",\n"
+        << "  \"duration_s\": " << options.duration_s << ",\n  \"classes\": [";
+    for (size_t i = 0; i < reports.size(); ++i) {
+        const ClassReport& report = reports[i];
+        out << (i ? ",\n" : "\n") << "    {\"name\": \"" << report.name << "\""
+            << ", \"calls\": " << report.calls << ", \"errors\": " << report.errors
+            << ", \"calls_per_s\": " << report.throughput << ", \"mb_per_s\": " << report.mb_per_s
+            << ", \"p50_ms\": " << report.p50_ms << ", \"p99_ms\": " << report.p99_ms
+            << ", \"p999_ms\": " << report.p999_ms << ", \"max_ms\": " << report.max_ms << "}";
+    }
+    out << "\n  ]\n}\n";
+    return static_cast<bool>(out);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        return 1;
+    }
+
+    std::unique_ptr<GrpcServer> server;
+    std::string address = options.target;
+    if (address.empty()) {
+        address = "localhost:50061";
+        server = std::make_unique<GrpcServer>(address, "", options.server);
+        if (!server->start()) {
+            std::cerr << "Failed to start in-process server on " << address << std::endl;
+            return 1;
+        }
+    }
+
+    LoadGenerator generator(options, address);
+    if (!generator.seed()) {
+        std::cerr << "Could not seed simulations on " << address << std::endl;
+        return 1;
+    }
+    const std::vector<ClassReport> reports = generator.run();
+
+    if (server) {
+        server->shutdown();
+    }
+
+    printReport(options, reports);
+    if (!options.json_path.empty() && !writeJson(options, reports)) {
+        std::cerr << "Failed to write " << options.json_path << std::endl;
+        return 1;
+    }
+    return 0;
+}
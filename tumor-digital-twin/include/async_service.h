@@ -0,0 +1,129 @@
+#pragma once
+
+#include <grpcpp/grpcpp.h>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "service.grpc.pb.h"
+
+namespace tumordtwin {
+
+class SimulationServiceImpl;
+
+// Every method on completion queues except UploadPatientData and the rare cluster
+// calls, which stay synchronous.
+// StartSimulation arrives unparsed (SimulationServiceImpl::startSimulationFromWire).
+using AsyncSimulationMethods =
+    SimulationService::WithRawMethod_StartSimulation<
+    SimulationService::WithAsyncMethod_StartEnsemble<
+    SimulationService::WithAsyncMethod_GetEnsembleStatus<
+    SimulationService::WithAsyncMethod_GetSimulationStatus<
+    SimulationService::WithAsyncMethod_WatchSimulation<
+    SimulationService::WithAsyncMethod_GetSimulationResults<
+    SimulationService::WithAsyncMethod_GetMetricHistory<
+    SimulationService::WithAsyncMethod_StopSimulation<
+    SimulationService::WithAsyncMethod_ListSimulations<
+    SimulationService::WithAsyncMethod_LoadSimulation<
+    SimulationService::WithAsyncMethod_HealthCheck<
+    SimulationService::Service>>>>>>>>>>>;
+
+/**
+ * @brief Completion-queue frontend of SimulationServiceImpl
+ *
+ * Serves the RPCs from a fixed set of completion queues, each drained by
+ * one thread that can be pinned to a core, instead of holding a thread
+ * per in-flight call. Every call is bound to one queue, so its steps run
+ * in order on that queue's thread.
+ *
+ * Unary handlers are short and run directly on the queue thread.
+ * StartSimulation is received as raw bytes, so a request with bad
+ * parameters is refused before its patient data is parsed, and accepted
+ * payloads are shared with the job instead of copied.
+ * GetSimulationResults opens its stream (loading and encoding the
+ * snapshot) on an offload thread and resumes on its queue through an
+ * alarm, then encodes its next chunk only once the previous write has
+ * completed; WatchSimulation re-checks its simulation on an alarm, so a
+ * slow client holds no thread. UploadPatientData is forwarded
+ * on gRPC's sync pool: its parser applies backpressure by blocking, which
+ * must not stall a completion queue.
+ */
+class AsyncSimulationService final : public AsyncSimulationMethods {
+public:
+    /**
+     * @param impl Service the handlers are forwarded to; must outlive this object
+     * @param num_cqs Completion queues and threads (0 = one per core)
+     * @param pin_threads Pin the thread of queue i to core i modulo the core count
+     */
+    AsyncSimulationService(SimulationServiceImpl& impl, int num_cqs, bool pin_threads);
+    ~AsyncSimulationService() override;
+
+    /**
+     * @brief Create the completion queues; call before BuildAndStart()
+     */
+    void addCompletionQueues(grpc::ServerBuilder& builder);
+
+    /**
+     * @brief Post the first call of every method and start the queue threads
+     */
+    void start();
+
+    /**
+     * @brief Drain and stop the offload threads and the queues; call after
+     *        grpc::Server::Shutdown()
+     */
+    void shutdown();
+
+    /**
+     * @brief Run work too slow for a queue thread on one of the offload threads
+     *
+     * Every task posted before shutdown() runs; a task resumes its call by
+     * setting an alarm on the call's queue.
+     */
+    void offload(std::function<void()> task);
+
+    size_t numCompletionQueues() const { return cqs_.size(); }
+
+    grpc::Status UploadPatientData(
+        grpc::ServerContext* context,
+        grpc::ServerReader<PatientDataChunk>* reader,
+        UploadResponse* response) override;
+
+    grpc::Status ReportNodeStatus(
+        grpc::ServerContext* context,
+        const NodeStatus* request,
+        NodeStatusResponse* response) override;
+
+    grpc::Status ReleaseQueuedJobs(
+        grpc::ServerContext* context,
+        const ReleaseJobsRequest* request,
+        ReleaseJobsResponse* response) override;
+
+    grpc::Status ConfirmRelease(
+        grpc::ServerContext* context,
+        const ConfirmReleaseRequest* request,
+        ConfirmReleaseResponse* response) override;
+
+private:
+    void poll(size_t queue);
+    void runOffloaded();
+
+    SimulationServiceImpl& impl_;
+    int num_cqs_;
+    bool pin_threads_;
+    std::vector<std::unique_ptr<grpc::ServerCompletionQueue>> cqs_;
+    std::vector<std::thread> threads_;
+
+    // One offload thread per queue, taking tasks in order
+    std::mutex offload_mutex_;
+    std::condition_variable offload_cv_;
+    std::deque<std::function<void()>> offload_tasks_;
+    bool offload_stopping_ = false;
+    std::vector<std::thread> offload_threads_;
+};
+
+} // namespace tumordtwin
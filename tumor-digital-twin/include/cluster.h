@@ -0,0 +1,203 @@
+#pragma once
+
+#include <grpcpp/grpcpp.h>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "service.grpc.pb.h"
+
+namespace tumordtwin {
+
+class SimulationServiceImpl;
+
+/**
+ * @brief Places simulations on the nodes of a cluster and balances their queues
+ *
+ * Nodes are GrpcServer instances started with a coordinator to join. They
+ * register and report their core budget and load with ReportNodeStatus at
+ * every heartbeat; a node that misses kMissedHeartbeats of them gets no new
+ * work until it reports again.
+ *
+ * A simulation is placed whole on the node where it would finish soonest:
+ * the one with the least outstanding cost (grid cells x steps of its queued
+ * and running runs, see JobScheduler::estimateCost) per core once the new
+ * run is added. Between heartbeats the coordinator adds what it placed to
+ * the last reported load, so a burst of submissions is spread out.
+ *
+ * Estimates are wrong by design, so a balancer also runs at every
+ * heartbeat: a node with idle cores and nothing queued takes queued runs
+ * from the node with the most queued cost per core. The handoff has two
+ * phases. The busy node holds the runs out of its queue
+ * (ReleaseQueuedJobs), the coordinator restarts them on the idle node
+ * under the same simulation ID, and ConfirmRelease tells the busy node
+ * which ones to drop. The rest go back to its queue, as do all of them if
+ * the confirmation does not arrive within the hold. Both calls carry the
+ * release token the busy node sent with its reports, so no other client
+ * can take work off a node.
+ *
+ * Requests about a simulation are forwarded to the node that owns it;
+ * ListSimulations is merged from every node.
+ */
+class ClusterCoordinator {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr int kDefaultHeartbeatMs = 1000;
+    static constexpr int kMissedHeartbeats = 3;
+
+    explicit ClusterCoordinator(int heartbeat_ms = kDefaultHeartbeatMs);
+    ~ClusterCoordinator();
+
+    ClusterCoordinator(const ClusterCoordinator&) = delete;
+    ClusterCoordinator& operator=(const ClusterCoordinator&) = delete;
+
+    /**
+     * @brief Start and stop the balancer thread
+     */
+    void start();
+    void stop();
+
+    int heartbeatMs() const { return heartbeat_ms_; }
+
+    /**
+     * @brief Node that should run a simulation of the given cost
+     * @return Index into `nodes`, or -1 if none has a core budget
+     */
+    static int pickNode(const std::vector<NodeStatus>& nodes, double cost);
+
+    /**
+     * @brief Idle node that should take queued runs from a busy one
+     * @param max_jobs How many runs it has cores for
+     * @return false if no node is idle or none has a queue to take from
+     */
+    static bool pickSteal(const std::vector<NodeStatus>& nodes, int* thief, int* victim,
+                          int* max_jobs);
+
+    /**
+     * @brief Run one round of work stealing
+     * @return Number of simulations moved
+     */
+    int rebalance();
+
+    /**
+     * @brief Nodes that reported within the last kMissedHeartbeats intervals
+     */
+    std::vector<NodeStatus> liveNodes() const;
+
+    /**
+     * @brief Node running a simulation or ensemble, empty if unknown
+     */
+    std::string owner(const std::string& id) const;
+
+    // RPCs served by a coordinator in place of SimulationServiceImpl
+    grpc::Status reportNodeStatus(const NodeStatus& status, NodeStatusResponse* response);
+    grpc::Status startSimulation(grpc::ServerContext* context, SimulationRequest request,
+                                 SimulationResponse* response);
+    grpc::Status startEnsemble(grpc::ServerContext* context, const EnsembleRequest& request,
+                               double cost, EnsembleResponse* response);
+    grpc::Status getEnsembleStatus(grpc::ServerContext* context,
+                                   const EnsembleStatusRequest& request,
+                                   EnsembleStatusResponse* response);
+    grpc::Status getSimulationStatus(grpc::ServerContext* context, const StatusRequest& request,
+                                     StatusResponse* response);
+    grpc::Status getSimulationResults(grpc::ServerContext* context,
+                                      const ResultsRequest& request,
+                                      grpc::ServerWriter<ResultsChunk>* writer);
+    grpc::Status getMetricHistory(grpc::ServerContext* context,
+                                  const MetricHistoryRequest& request, MetricHistory* response);
+    grpc::Status stopSimulation(grpc::ServerContext* context, const StopRequest& request,
+                                StopResponse* response);
+    grpc::Status listSimulations(grpc::ServerContext* context, const ListRequest& request,
+                                 SimulationList* response);
+
+private:
+    using Stub = SimulationService::Stub;
+
+    struct Node {
+        NodeStatus status;  // As reported, plus what was placed on it since
+        std::shared_ptr<Stub> stub;
+        Clock::time_point last_report;
+    };
+
+    // Forward a call about `id` to its owner, following it if it moved meanwhile;
+    // an ID the coordinator has not placed is looked for on every node
+    grpc::Status forward(grpc::ServerContext* context, const std::string& id,
+                         const std::function<grpc::Status(Stub&, grpc::ClientContext*)>& call);
+
+    // Start a simulation with its ID set on one node
+    grpc::Status place(const std::string& node_id, const std::shared_ptr<Stub>& stub,
+                       grpc::ClientContext* context, const SimulationRequest& request,
+                       double cost, SimulationResponse* response);
+
+    std::shared_ptr<Stub> stub(const std::string& node_id) const;
+    bool isLive(const Node& node, Clock::time_point now) const;
+    Clock::duration callTimeout() const;
+    void balancerLoop();
+
+    const int heartbeat_ms_;
+
+    mutable std::mutex mutex_;
+    std::map<std::string, Node> nodes_;
+    std::unordered_map<std::string, std::string> owners_;  // Simulation or ensemble ID -> node
+
+    std::mutex rebalance_mutex_;  // One round of stealing at a time
+
+    std::mutex balancer_mutex_;
+    std::condition_variable balancer_cv_;
+    bool stopping_ = false;
+    std::thread balancer_;
+};
+
+/**
+ * @brief Registers a node with its coordinator and reports its load
+ *
+ * Sends the node's NodeStatus every heartbeat on a background thread;
+ * the coordinator may change the interval in its reply. Each heartbeat
+ * also requeues released simulations the coordinator did not confirm.
+ */
+class ClusterMember {
+public:
+    /**
+     * @param service Service whose scheduler load is reported
+     * @param coordinator_address host:port of the coordinator
+     * @param node_id Address the coordinator reaches this node at
+     */
+    ClusterMember(SimulationServiceImpl& service, std::string coordinator_address,
+                  std::string node_id, int heartbeat_ms);
+    ~ClusterMember();
+
+    ClusterMember(const ClusterMember&) = delete;
+    ClusterMember& operator=(const ClusterMember&) = delete;
+
+    void start();
+    void stop();
+
+    /**
+     * @brief Whether the last report reached the coordinator
+     */
+    bool registered() const;
+
+private:
+    void run();
+
+    SimulationServiceImpl& service_;
+    const std::string node_id_;
+    std::unique_ptr<SimulationService::Stub> stub_;
+    int heartbeat_ms_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    bool stopping_ = false;
+    bool registered_ = false;
+    std::thread thread_;
+};
+
+} // namespace tumordtwin
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+namespace tumordtwin {
+
+/**
+ * @brief Incremental decompressor for BGZF, gzip and uncompressed streams
+ *
+ * BGZF, the block-gzip container of BAM and bgzipped VCF, is a series of
+ * independent gzip members of at most 64 KB, each recording its own
+ * compressed size. feed() cuts the bytes received so far into complete
+ * blocks and inflates a batch of them in parallel, appending the output
+ * in stream order; a partial block waits for the next feed(). Plain gzip
+ * (e.g. fastq.gz from gzip) is inflated serially, and input without the
+ * gzip magic passes through unchanged. The format is detected from the
+ * first bytes.
+ */
+class BgzfInflater {
+public:
+    enum class Format { Unknown, Raw, Gzip, Bgzf };
+
+    /**
+     * @param num_threads Threads for inflating BGZF blocks (0 = runtime default)
+     */
+    explicit BgzfInflater(int num_threads = 0);
+    ~BgzfInflater();
+
+    BgzfInflater(const BgzfInflater&) = delete;
+    BgzfInflater& operator=(const BgzfInflater&) = delete;
+
+    /**
+     * @brief Consume the next bytes of the stream
+     * @param out Decompressed bytes are appended here
+     * @param error_msg Output parameter for error message
+     * @return false on corrupt input; the inflater is unusable afterwards
+     */
+    bool feed(const char* data, size_t size, std::string* out, std::string& error_msg);
+
+    /**
+     * @brief End of input: flush undetected short input and reject truncated streams
+     */
+    bool finish(std::string* out, std::string& error_msg);
+
+    Format format() const { return format_; }
+
+    /**
+     * @brief Compressed bytes consumed so far
+     */
+    size_t bytesIn() const { return bytes_in_; }
+
+private:
+    struct GzipStream;
+
+    void detect();
+    bool consume(const char* data, size_t size, std::string* out, std::string& error_msg);
+    bool inflateBlocks(std::string* out, std::string& error_msg);
+    bool inflateGzip(const char* data, size_t size, std::string* out, std::string& error_msg);
+
+    int num_threads_;
+    Format format_ = Format::Unknown;
+    size_t bytes_in_ = 0;
+    std::string pending_;  // Bytes not yet consumed: detection prefix or a partial BGZF batch
+    std::unique_ptr<GzipStream> gzip_;
+};
+
+} // namespace tumordtwin
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace tumordtwin {
+
+/**
+ * @brief Image volume assembled from the DICOM files of one series
+ *
+ * The archive is the DicomData.dicom_archive layout: DICOM Part 10
+ * files (128-byte preamble, "DICM") concatenated, optionally gzip or
+ * BGZF compressed as a whole. Each file holds one slice or a multi-frame
+ * stack. Uncompressed little-endian transfer syntaxes (explicit and
+ * implicit VR) with 8- or 16-bit monochrome pixels are decoded; the
+ * slices are ordered by ImagePositionPatient z (InstanceNumber when the
+ * position is missing) and the stored values are rescaled with
+ * RescaleSlope/Intercept. Other transfer syntaxes are rejected.
+ */
+class DicomVolume {
+public:
+    /**
+     * @brief Whether bytes start like a DICOM Part 10 file
+     */
+    static bool isDicom(std::string_view bytes);
+
+    /**
+     * @brief Decode every file of an uncompressed archive into the volume
+     * @param error_msg Output parameter for error message
+     * @return false on malformed or unsupported files, or slices of different shapes
+     */
+    bool parse(std::string_view archive, std::string& error_msg);
+
+    int nx() const { return nx_; }
+    int ny() const { return ny_; }
+    int nz() const { return nz_; }
+
+    /**
+     * @brief Voxel edge lengths in millimeters (columns, rows, slices)
+     */
+    double dx() const { return dx_; }
+    double dy() const { return dy_; }
+    double dz() const { return dz_; }
+
+    /**
+     * @brief Rescaled values, x fastest then y then slice
+     */
+    const std::vector<float>& values() const { return values_; }
+
+private:
+    int nx_ = 0;
+    int ny_ = 0;
+    int nz_ = 0;
+    double dx_ = 1.0;
+    double dy_ = 1.0;
+    double dz_ = 1.0;
+    std::vector<float> values_;
+};
+
+} // namespace tumordtwin
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace tumordtwin {
+
+/**
+ * @brief A single-base driver hotspot
+ *
+ * GRCh38, 1-based position, forward-strand alleles.
+ */
+struct DriverHotspot {
+    std::string_view chromosome;  // Without the "chr" prefix
+    int64_t position;
+    char reference;
+    char alternate;
+    std::string_view label;       // Gene:protein change, as in Genotype.driver_mutations
+};
+
+/**
+ * @brief Panel of known driver hotspots looked for in uploaded genomic data
+ *
+ * Both the VCF parser (called variants) and the BAM parser (pileup at
+ * each hotspot) report drivers against this panel. Chromosome names
+ * match with or without the "chr" prefix.
+ */
+class DriverPanel {
+public:
+    static const std::vector<DriverHotspot>& hotspots();
+
+    /**
+     * @brief Hotspot for a variant, or nullptr if it is not a known driver
+     */
+    static const DriverHotspot* find(std::string_view chromosome, int64_t position,
+                                     std::string_view reference, std::string_view alternate);
+
+    /**
+     * @brief Chromosome name without a "chr" prefix
+     */
+    static std::string_view canonicalChromosome(std::string_view name);
+};
+
+} // namespace tumordtwin
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+namespace tumordtwin {
+
+/**
+ * @brief Splits text arriving in arbitrary pieces into lines
+ *
+ * Complete lines are passed to the callback as views into the piece
+ * being fed, without the newline (or a trailing carriage return); only a
+ * line split across pieces is copied.
+ */
+class LineBuffer {
+public:
+    /**
+     * @param on_line Callable taking a std::string_view, returning false to stop
+     * @return false if the callback stopped
+     */
+    template <typename OnLine>
+    bool feed(std::string_view text, OnLine&& on_line) {
+        if (!partial_.empty()) {
+            const size_t newline = text.find('\n');
+            if (newline == std::string_view::npos) {
+                partial_.append(text);
+                return true;
+            }
+            partial_.append(text.substr(0, newline));
+            text.remove_prefix(newline + 1);
+            const std::string line = std::move(partial_);
+            partial_.clear();
+            if (!on_line(trim(line))) {
+                return false;
+            }
+        }
+
+        for (size_t newline; (newline = text.find('\n')) != std::string_view::npos;) {
+            if (!on_line(trim(text.substr(0, newline)))) {
+                return false;
+            }
+            text.remove_prefix(newline + 1);
+        }
+        partial_.assign(text);
+        return true;
+    }
+
+    /**
+     * @brief End of input: pass an unterminated last line, if any
+     */
+    template <typename OnLine>
+    bool finish(OnLine&& on_line) {
+        if (partial_.empty()) {
+            return true;
+        }
+        const std::string line = std::move(partial_);
+        partial_.clear();
+        return on_line(trim(line));
+    }
+
+private:
+    static std::string_view trim(std::string_view line) {
+        if (!line.empty() && line.back() == '\r') {
+            line.remove_suffix(1);
+        }
+        return line;
+    }
+
+    std::string partial_;
+};
+
+} // namespace tumordtwin
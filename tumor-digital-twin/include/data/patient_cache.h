@@ -0,0 +1,113 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "data/patient_model.h"
+#include "patient_data.pb.h"
+
+namespace tumordtwin {
+
+/**
+ * @brief Content-addressed cache of PatientModels shared by all simulations
+ *
+ * Parameter sweeps start many simulations from the same PatientData, and
+ * building its PatientModel (decoding and segmenting the DICOM series,
+ * piling up BAM reads) dominates their start-up. Models are keyed by
+ * contentKey(), a SHA-256 over exactly the inputs of PatientModel::build,
+ * so the same patient finds the model built the first time whether it
+ * is sent inline or through a fresh upload.
+ *
+ * Built models stay in memory up to a byte budget, least recently used
+ * evicted first, and are written through to one file per key in the
+ * cache directory; a model evicted from memory, or built before a
+ * restart, is read back instead of rebuilt. get() calls for a key that
+ * is still being built wait for that build instead of starting their own.
+ *
+ * Thread-safe.
+ */
+class PatientCache {
+public:
+    static constexpr size_t kDefaultMemoryBudget = size_t{256} << 20;
+
+    struct Stats {
+        uint64_t hits = 0;        // Served from memory, or by waiting for a build in progress
+        uint64_t disk_hits = 0;   // Read back from the cache directory
+        uint64_t misses = 0;      // Built from the PatientData
+        size_t entries = 0;       // Models in memory
+        size_t memory_bytes = 0;
+    };
+
+    /**
+     * @param directory Where built models are written (created on first use)
+     * @param memory_budget Bytes of models kept in memory
+     * @param num_threads Threads a build may use for decompression (0 = runtime default)
+     */
+    explicit PatientCache(std::string directory, size_t memory_budget = kDefaultMemoryBudget,
+                          int num_threads = 0);
+
+    /**
+     * @brief Content hash of the PatientData sources a model is built from
+     *
+     * Covers the DICOM archive (read from the spool file for uploads), the
+     * inline BAM bytes, the VCF mutations and the segmentation window, but
+     * not IDs or how the data arrived.
+     *
+     * @param key Set to 64 hex digits
+     * @return false if a spooled source cannot be read
+     */
+    static bool contentKey(const PatientData& data, std::string* key, std::string& error_msg);
+
+    /**
+     * @brief Model for a validated PatientData, built only on a miss
+     * @param error_msg Output parameter for error message
+     * @return The shared model, or nullptr if it cannot be built
+     */
+    std::shared_ptr<const PatientModel> get(const PatientData& data, std::string& error_msg);
+
+    Stats stats() const;
+
+    const std::string& directory() const { return directory_; }
+
+    /**
+     * @brief File a model is written to
+     */
+    std::string modelPath(const std::string& key) const;
+
+private:
+    struct Entry {
+        std::string key;
+        std::shared_ptr<const PatientModel> model;
+        size_t bytes;
+    };
+
+    struct BuildResult {
+        std::shared_ptr<const PatientModel> model;
+        std::string error_msg;
+    };
+
+    BuildResult load(const std::string& key, const PatientData& data);
+    std::shared_ptr<const PatientModel> readModel(const std::string& key) const;
+    bool writeModel(const std::string& key, const PatientModel& model,
+                    std::string& error_msg) const;
+    // Caller holds mutex_
+    void insert(const std::string& key, std::shared_ptr<const PatientModel> model);
+
+    std::string directory_;
+    size_t memory_budget_;
+    int num_threads_;
+
+    mutable std::mutex mutex_;
+    std::list<Entry> lru_;  // Most recently used first
+    std::unordered_map<std::string, std::list<Entry>::iterator> index_;
+    std::unordered_map<std::string, std::shared_future<BuildResult>> building_;
+    Stats stats_;
+};
+
+} // namespace tumordtwin
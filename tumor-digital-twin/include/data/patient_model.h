@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "patient_data.pb.h"
+#include "evolution/genotype_table.h"
+
+namespace tumordtwin {
+
+/**
+ * @brief Segmented tumor on the imaging lattice
+ */
+struct TumorGeometry {
+    int nx = 0;
+    int ny = 0;
+    int nz = 0;
+    double dx = 1.0;  // Voxel edge lengths in millimeters
+    double dy = 1.0;
+    double dz = 1.0;
+    std::vector<uint32_t> voxels;  // Linear indices (x fastest) of tumor voxels
+
+    bool empty() const { return voxels.empty(); }
+};
+
+/**
+ * @brief Initial tumor state derived from a PatientData
+ *
+ * Building it is the expensive part of starting from patient data: the
+ * DICOM series is decoded (DicomVolume) and segmented into a
+ * TumorGeometry, inline BAM reads are piled up at the DriverPanel, and
+ * the VCF mutations are clustered by cancer cell fraction into a ladder
+ * of nested founding clones. SimulationEngine::initialize(const
+ * PatientModel&) seeds the tumor in this shape with cells drawn from
+ * these clones; PatientCache keeps built models by content hash.
+ *
+ * Voxels whose values lie in [kMetadataSegmentationLower,
+ * kMetadataSegmentationUpper] (PatientData.metadata) are tumor. The
+ * default window [0.5, +inf) takes every nonzero voxel of a label map,
+ * the usual export of a segmentation tool; intensity images need an
+ * explicit window. An archive without DICOM Part 10 files yields no
+ * geometry, and the engine seeds a sphere as before.
+ *
+ * A mutation's cancer cell fraction is twice its allele frequency
+ * (heterozygous in a diploid, pure sample), capped at 1; a missing
+ * allele frequency counts as clonal. Each clone carries the mutations of
+ * the clones above it, so higher fractions are ancestral.
+ */
+struct PatientModel {
+    static constexpr const char* kMetadataSegmentationLower = "segmentation.lower";
+    static constexpr const char* kMetadataSegmentationUpper = "segmentation.upper";
+
+    // Mutations whose cancer cell fractions are within this of a clone's join it
+    static constexpr double kCloneFractionTolerance = 0.1;
+
+    TumorGeometry geometry;
+    GenotypeTable genotypes;
+    std::vector<double> clone_fractions;  // Share of tumor cells per GenotypeId; empty = all founder
+
+    bool empty() const { return geometry.empty() && clone_fractions.empty(); }
+
+    /**
+     * @brief Build the model for a validated PatientData
+     * @param num_threads Threads for decompressing the DICOM archive (0 = runtime default)
+     * @param error_msg Output parameter for error message
+     * @return false on malformed imaging or genomic data
+     */
+    static bool build(const PatientData& data, PatientModel* model, std::string& error_msg,
+                      int num_threads = 0);
+
+    /**
+     * @brief Segment a decoded volume into the tumor geometry
+     */
+    static TumorGeometry segment(const std::vector<float>& values, int nx, int ny, int nz,
+                                 double dx, double dy, double dz, double lower, double upper);
+
+    /**
+     * @brief Cluster mutations into the clone ladder of genotypes and clone_fractions
+     */
+    void buildClones(const std::vector<const Mutation*>& mutations);
+
+    void toProto(PreprocessedPatient* proto) const;
+    bool fromProto(const PreprocessedPatient& proto, std::string& error_msg);
+
+    /**
+     * @brief Approximate heap bytes, for the cache's memory budget
+     */
+    size_t memoryBytes() const;
+};
+
+} // namespace tumordtwin
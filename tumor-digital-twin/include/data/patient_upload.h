@@ -0,0 +1,121 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "patient_data.pb.h"
+
+namespace tumordtwin {
+
+/**
+ * @brief Receives one client-streamed patient data upload
+ *
+ * The RPC thread hands payload pieces to append(); a parser thread spools
+ * each payload to a file in the upload directory and parses it while the
+ * rest is still arriving: VCF into mutations, BAM into a pileup at the
+ * DriverPanel hotspots, FASTQ checked and counted. Compressed payloads go
+ * through a BgzfInflater, which inflates BGZF blocks in parallel. The
+ * queue between the two threads is bounded, so a client that sends faster
+ * than the parser keeps up is held back by gRPC flow control instead of
+ * being buffered in memory.
+ *
+ * finish() produces the PatientData to simulate from: the header with the
+ * parsed and called mutations added to vcf, and the spool paths in
+ * metadata (kMetadata* keys) in place of the bulk bytes.
+ */
+class PatientUpload {
+public:
+    static constexpr size_t kMaxQueuedChunks = 16;
+
+    static constexpr const char* kMetadataBamPath = "upload.bam_path";
+    static constexpr const char* kMetadataFastqPath = "upload.fastq_path";
+    static constexpr const char* kMetadataVcfPath = "upload.vcf_path";
+    static constexpr const char* kMetadataDicomPath = "upload.dicom_path";
+
+    // Namespace of the keys above; only finish() sets them
+    static constexpr const char* kReservedMetadataPrefix = "upload.";
+
+    /**
+     * @brief Whether a metadata key is reserved for spool paths
+     */
+    static bool isReservedMetadataKey(const std::string& key);
+
+    /**
+     * @param directory Directory the payloads are spooled to, created if missing
+     * @param num_threads Threads for inflating BGZF blocks (0 = runtime default)
+     */
+    explicit PatientUpload(std::string directory, int num_threads = 0);
+
+    // Stops the parser; spooled files are left for the caller to remove
+    ~PatientUpload();
+
+    PatientUpload(const PatientUpload&) = delete;
+    PatientUpload& operator=(const PatientUpload&) = delete;
+
+    /**
+     * @brief Merge the non-bulk fields sent with a chunk
+     *
+     * Reserved metadata keys are dropped, so a client cannot point the
+     * server at files of its choosing.
+     */
+    void mergeHeader(const PatientData& header);
+
+    /**
+     * @brief Queue the next piece of a payload, blocking while the queue is full
+     * @param error_msg Output parameter for error message
+     * @return false once parsing has failed; the rest of the upload is pointless
+     */
+    bool append(UploadPayload payload, std::string data, std::string& error_msg);
+
+    /**
+     * @brief Wait for the parser to drain the queue and assemble the result
+     * @return false if any payload failed to parse
+     */
+    bool finish(PatientData* data, std::string& error_msg);
+
+    const std::string& directory() const { return directory_; }
+    int64_t bytesReceived() const { return bytes_received_; }
+
+    // Valid after a successful finish()
+    const std::vector<std::string>& drivers() const { return drivers_; }
+    int64_t reads() const { return reads_; }
+
+private:
+    struct Chunk {
+        UploadPayload payload;
+        std::string data;
+    };
+    struct Parsers;
+
+    void parseLoop();
+    bool parse(Chunk& chunk, std::string& error_msg);
+    void fail(const std::string& error_msg);
+
+    std::string directory_;
+    int num_threads_;
+    PatientData header_;
+    int64_t bytes_received_ = 0;
+
+    std::mutex mutex_;
+    std::condition_variable queue_changed_;
+    std::deque<Chunk> queue_;
+    bool closed_ = false;
+    bool failed_ = false;
+    std::string error_;
+
+    // Only touched by the parser thread until it is joined
+    std::unique_ptr<Parsers> parsers_;
+    std::vector<std::string> drivers_;
+    int64_t reads_ = 0;
+
+    std::thread parser_;
+};
+
+} // namespace tumordtwin
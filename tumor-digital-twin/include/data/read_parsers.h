@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "data/line_buffer.h"
+#include "patient_data.pb.h"
+
+namespace tumordtwin {
+
+/**
+ * @brief Incremental BAM record parser with a pileup at the driver hotspots
+ *
+ * Takes the decompressed BAM stream (see BgzfInflater) in arbitrary
+ * pieces. After the header, every primary, mapped, non-duplicate read
+ * that covers a DriverPanel hotspot adds its base there to the pileup;
+ * nothing else of the read is kept, so memory does not grow with the
+ * file. callDrivers() turns hotspots with enough supporting reads into
+ * Mutations.
+ */
+class BamParser {
+public:
+    static constexpr int kMinMappingQuality = 20;
+    static constexpr int kMinBaseQuality = 20;
+    static constexpr uint32_t kMinDepth = 8;
+    static constexpr uint32_t kMinAltReads = 3;
+    static constexpr double kMinAlleleFrequency = 0.05;
+
+    BamParser();
+
+    /**
+     * @brief Parse the next piece of decompressed BAM
+     * @return false on a malformed header or record
+     */
+    bool feed(std::string_view bytes, std::string& error_msg);
+
+    /**
+     * @brief End of input: reject a truncated header or record
+     */
+    bool finish(std::string& error_msg);
+
+    /**
+     * @brief Append the hotspot calls as Mutations and their driver labels
+     */
+    void callDrivers(VcfData* vcf, std::vector<std::string>* drivers) const;
+
+    size_t reads() const { return reads_; }
+
+private:
+    struct Pileup {
+        uint32_t depth = 0;
+        uint32_t alt = 0;
+    };
+
+    // Bytes consumed, 0 when more are needed, -1 on a malformed header
+    long parseHeader(const char* data, size_t size);
+    void parseRecord(const char* record, size_t size);
+
+    std::string pending_;
+    bool have_header_ = false;
+    std::vector<std::vector<size_t>> hotspots_by_reference_;  // Hotspot indices per refID
+    std::vector<Pileup> pileups_;                             // Per DriverPanel hotspot
+    size_t reads_ = 0;
+};
+
+/**
+ * @brief Incremental FASTQ validator
+ *
+ * Unaligned reads carry no positions, so FASTQ is only checked for its
+ * four-line record structure and counted; the reads themselves are
+ * spooled for offline alignment.
+ */
+class FastqParser {
+public:
+    bool feed(std::string_view text, std::string& error_msg);
+    bool finish(std::string& error_msg);
+
+    size_t reads() const { return reads_; }
+    size_t bases() const { return bases_; }
+
+private:
+    bool parseLine(std::string_view line, std::string& error_msg);
+
+    LineBuffer lines_;
+    size_t line_number_ = 0;
+    size_t sequence_length_ = 0;
+    size_t reads_ = 0;
+    size_t bases_ = 0;
+};
+
+} // namespace tumordtwin
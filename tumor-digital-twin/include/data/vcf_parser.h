@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "data/line_buffer.h"
+#include "patient_data.pb.h"
+
+namespace tumordtwin {
+
+/**
+ * @brief Incremental VCF text parser
+ *
+ * Text may arrive in arbitrary pieces (decompress bgzipped VCF with
+ * BgzfInflater first); a line split across feed() calls is completed by
+ * the next one. Each ALT allele of a record whose FILTER is PASS or "."
+ * becomes a Mutation, with the allele frequency from INFO AF (or the
+ * first sample's AF) and the first sample's GT. Variants on the
+ * DriverPanel are also collected as driver labels.
+ */
+class VcfParser {
+public:
+    /**
+     * @param vcf Destination; mutations are appended, and sample_id is taken
+     *            from the #CHROM header line when it is empty
+     */
+    explicit VcfParser(VcfData* vcf);
+
+    /**
+     * @brief Parse the next piece of text
+     * @param error_msg Output parameter for error message (with the line number)
+     * @return false on a malformed record
+     */
+    bool feed(std::string_view text, std::string& error_msg);
+
+    /**
+     * @brief End of input: parse an unterminated last line
+     */
+    bool finish(std::string& error_msg);
+
+    /**
+     * @brief Labels of the driver hotspots seen so far, each once
+     */
+    const std::vector<std::string>& drivers() const { return drivers_; }
+
+    size_t records() const { return records_; }
+
+private:
+    bool parseLine(std::string_view line, std::string& error_msg);
+
+    VcfData* vcf_;
+    LineBuffer lines_;
+    size_t line_number_ = 0;
+    size_t records_ = 0;
+    std::vector<std::string> drivers_;
+};
+
+} // namespace tumordtwin
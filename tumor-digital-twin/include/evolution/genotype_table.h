@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace tumordtwin {
+
+/**
+ * @brief Interning table for serialized genotypes, with their phylogeny
+ *
+ * Cells that share a clone share a genotype, so agents store a 32-bit
+ * index into this table instead of their own copy of the bytes. Index 0
+ * is always the empty genotype, the founding clone.
+ *
+ * Each entry also records the clone it was forked from, so the table is
+ * the phylogeny of the tumor, and a stable 64-bit hash of its bytes for
+ * SubcloneInfo.genotype_hash. Forked genotypes are serialized Genotype
+ * messages: the parent's, with one more mutation position.
+ */
+class GenotypeTable {
+public:
+    using GenotypeId = uint32_t;
+
+    static constexpr GenotypeId kEmptyGenotype = 0;
+
+    GenotypeTable();
+
+    // Copies rebuild the index over their own storage
+    GenotypeTable(const GenotypeTable& other);
+    GenotypeTable& operator=(const GenotypeTable& other);
+    GenotypeTable(GenotypeTable&&) = default;
+    GenotypeTable& operator=(GenotypeTable&&) = default;
+
+    /**
+     * @brief Return the ID of a genotype, adding it if it is new
+     * @param parent Clone a new entry descends from; ignored for known genotypes
+     */
+    GenotypeId intern(std::string_view genotype_data, GenotypeId parent = kEmptyGenotype);
+
+    /**
+     * @brief Child clone of parent carrying one more mutation
+     *
+     * The parent's genotype is read as a Genotype message (opaque bytes
+     * that do not parse are dropped) and mutation_position is appended.
+     */
+    GenotypeId fork(GenotypeId parent, int32_t mutation_position);
+
+    /**
+     * @brief Look up the serialized genotype for an ID
+     * @return The genotype bytes, or an empty string for unknown IDs
+     */
+    const std::string& get(GenotypeId id) const;
+
+    /**
+     * @brief Clone an entry was forked from; the founding clone is its own parent
+     */
+    GenotypeId parent(GenotypeId id) const {
+        return id < parents_.size() ? parents_[id] : kEmptyGenotype;
+    }
+
+    /**
+     * @brief FNV-1a hash of the genotype bytes, stable across runs and platforms
+     */
+    uint64_t hash(GenotypeId id) const {
+        return id < hashes_.size() ? hashes_[id] : hashes_[kEmptyGenotype];
+    }
+
+    size_t size() const { return genotypes_.size(); }
+
+    void clear();
+
+private:
+    void rebuildIndex();
+
+    // Deque keeps element addresses stable, so the views in index_ stay valid
+    std::deque<std::string> genotypes_;
+    std::vector<GenotypeId> parents_;
+    std::vector<uint64_t> hashes_;
+    std::unordered_map<std::string_view, GenotypeId> index_;
+};
+
+} // namespace tumordtwin
@@ -2,24 +2,327 @@
 
 #include <grpcpp/grpcpp.h>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <array>
 #include <atomic>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <unordered_map>
+#include <vector>
 
 #include "service.grpc.pb.h"
+#include "cluster.h"
+#include "data/patient_cache.h"
+#include "metrics_exporter.h"
+#include "simulation/engine_pool.h"
+#include "simulation/ensemble.h"
+#include "simulation/job_scheduler.h"
+#include "simulation/simulation_registry.h"
+#include "storage/checkpoint.h"
+#include "storage/step_history.h"
+#include "utils/metrics_registry.h"
+#include "utils/profiler.h"
 
 namespace tumordtwin {
 
+class AsyncSimulationService;
+class ResultsStream;
+
+/**
+ * @brief Threading model of GrpcServer
+ */
+enum class ServerMode {
+    Sync,   // One thread per in-flight RPC from gRPC's sync server pool
+    Async   // Completion queues drained by a fixed set of threads (AsyncSimulationService)
+};
+
+/**
+ * @brief Threading and transport settings of GrpcServer
+ *
+ * Zero leaves a setting at the gRPC default.
+ */
+struct GrpcServerOptions {
+    // Edge of the cubic lattice warm engines are sized for when warm_grid is 0
+    static constexpr int kDefaultWarmGrid = 100;
+
+    ServerMode mode = ServerMode::Sync;
+
+    // Async: completion queues, each drained by one thread (0 = one per core).
+    // Sync: completion queues of the sync server pool.
+    int num_cqs = 0;
+    // Async: pin the thread of completion queue i to core i modulo the core count
+    bool pin_cqs = false;
+
+    // Sync: threads polling for new calls, and the cap on all RPC threads
+    int sync_min_pollers = 0;
+    int sync_max_pollers = 0;
+    int sync_max_threads = 0;
+
+    int max_message_bytes = 0;      // Largest message received or sent (gRPC default 4 MB in)
+    int keepalive_time_ms = 0;      // Ping idle connections at this interval
+    int keepalive_timeout_ms = 0;   // Close a connection whose ping is not answered in time
+    int max_concurrent_streams = 0; // Concurrent RPCs per client connection
+
+    // Cluster: place simulations on the nodes that join this server (sync mode only),
+    // or join the coordinator at host:port as a node, reachable at `advertise`
+    // (empty = the server address)
+    bool coordinator = false;
+    std::string join;
+    std::string advertise;
+    int heartbeat_ms = 0;           // Node status reports (0 = ClusterCoordinator default)
+
+    // Simulation engines built in the background once the port is open; HealthCheck
+    // reports NOT_SERVING until they are ready (not in coordinator mode)
+    int warm_engines = 0;
+    int warm_grid = 0;              // Edge of the lattice they are sized for
+    bool warm_gpu = false;          // Also create their CUDA contexts and device fields
+
+    // Finished simulations kept for status and results requests, and for how long
+    // (0 = SimulationRegistry defaults)
+    int retain_finished = 0;
+    int retain_finished_s = 0;
+
+    // Started under mpirun: the other MPI ranks hold the slabs of multi-rank
+    // simulations (read by tumor_server, see SlabRanks::attachMpi)
+    bool mpi = false;
+
+    /**
+     * @brief Parameters the warm engines are built with
+     */
+    SimulationParameters warmParameters() const;
+
+    /**
+     * @brief Set one option by its command line name, e.g. ("mode", "async")
+     *
+     * Names: mode (sync|async), cqs, pin-cqs, sync-min-pollers,
+     * sync-max-pollers, sync-max-threads, max-message-mb, keepalive-ms,
+     * keepalive-timeout-ms, max-streams, coordinator, join, advertise,
+     * heartbeat-ms, warm-engines, warm-grid, warm-gpu, retain-finished,
+     * retain-finished-s, mpi.
+     *
+     * @param error_msg Output parameter for error message
+     * @return false for an unknown name or an invalid value
+     */
+    bool set(const std::string& name, const std::string& value, std::string& error_msg);
+};
+
+/**
+ * @brief Decides when a WatchSimulation stream sends its next update
+ *
+ * Status changes are always sent; progress once step_interval steps have
+ * passed and min_interval_ms has elapsed since the previous update. Used
+ * by the blocking and the completion-queue handlers, which only differ in
+ * how they wait.
+ */
+class WatchCursor {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit WatchCursor(const WatchRequest& request);
+
+    /**
+     * @brief Whether an update is due now
+     * @param wait When none is due: how long the rate limit holds back
+     *             pending progress, or zero if nothing is pending
+     */
+    bool due(const SimulationRecord& record, Clock::time_point now,
+             Clock::duration* wait) const;
+
+    /**
+     * @brief Note an update as sent
+     * @return true if it carried a final status, which ends the stream
+     */
+    bool sent(const StatusResponse& response, Clock::time_point now);
+
+private:
+    int32_t step_interval_;
+    Clock::duration min_interval_;
+    SimulationStatus sent_status_ = SimulationStatus::SIMULATION_STATUS_UNSPECIFIED;
+    int32_t sent_step_ = 0;
+    Clock::time_point sent_at_;
+};
+
 /**
  * @brief Implementation of the SimulationService gRPC service
  * 
  * This class provides the server-side implementation of all RPC methods
  * defined in the SimulationService. It handles simulation lifecycle,
  * status queries, and result retrieval.
+ *
+ * Operational metrics go to a MetricsRegistry (see metrics()): the phase
+ * timings of every simulation step, checkpoint and result serialization
+ * as histograms, and the scheduler queue and simulation counts as gauges.
+ * GrpcServer adds per-RPC latencies and serves the registry over HTTP.
  */
 class SimulationServiceImpl final : public SimulationService::Service {
 public:
-    SimulationServiceImpl();
-    ~SimulationServiceImpl() override = default;
+    // Uploads kept for StartSimulation; the oldest is dropped, with its spool files, beyond this
+    static constexpr size_t kMaxRetainedUploads = 64;
+
+    // ListSimulations page size when none is requested, and the largest one served
+    static constexpr int32_t kDefaultListLimit = 100;
+    static constexpr int32_t kMaxListLimit = 1000;
+
+    // Ensembles kept before the first sweep for those the registry has let go (see
+    // ensembleRetired())
+    static constexpr size_t kMinEnsembleSweep = 64;
+
+    /**
+     * @param checkpoint_directory Where checkpoints are written
+     *                             (empty = a directory under the system temp path)
+     * @param upload_directory Where UploadPatientData spools payloads
+     *                         (empty = a directory under the system temp path)
+     * @param patient_cache_directory Where preprocessed patient data is kept across runs
+     *                                (empty = a directory under the system temp path)
+     * @param history_directory Where the metrics and snapshots of past steps are kept
+     *                          (empty = a directory under the system temp path)
+     */
+    explicit SimulationServiceImpl(std::string checkpoint_directory = "",
+                                   std::string upload_directory = "",
+                                   std::string patient_cache_directory = "",
+                                   std::string history_directory = "");
+    ~SimulationServiceImpl() override;
+
+    /**
+     * @brief Path of the checkpoint file kept for a simulation
+     */
+    std::string checkpointPath(const std::string& simulation_id) const;
+
+    /**
+     * @brief Directory of the StepHistory kept for a simulation
+     */
+    std::string historyPath(const std::string& simulation_id) const;
+
+    /**
+     * @brief Report NOT_SERVING and end open WatchSimulation streams
+     *
+     * Called before the gRPC server shuts down, which waits for every
+     * in-flight call to return.
+     */
+    void beginShutdown() { is_serving_ = false; }
+    bool isServing() const { return is_serving_; }
+
+    /**
+     * @brief Keep `engines` simulation engines warm, built in the background
+     *
+     * HealthCheck reports NOT_SERVING until the engines are built; `on_ready`
+     * is then called on the warm-up thread. Accepted jobs take an idle warm
+     * engine and return it when they end (see EnginePool). Call once.
+     *
+     * @param params Lattice, resolution and GPU use the engines are sized for
+     */
+    void warmUp(size_t engines, const SimulationParameters& params,
+                std::function<void()> on_ready = nullptr);
+    bool warmedUp() const { return engine_pool_.ready(); }
+    const EnginePool& enginePool() const { return engine_pool_; }
+
+    /**
+     * @brief Stop a warm-up in progress, e.g. before the server shuts down
+     */
+    void stopWarmUp() { engine_pool_.stop(); }
+
+    /**
+     * @brief Preprocessed patient data shared by the simulations of this service
+     */
+    const PatientCache& patientCache() const { return *patient_cache_; }
+
+    /**
+     * @brief Serve as the coordinator of a cluster instead of running simulations
+     *
+     * Simulations are placed on the nodes that report to this service, and
+     * requests about them are forwarded to their node (see ClusterCoordinator).
+     * Uploads and LoadSimulation are refused. Call before the server starts.
+     */
+    void enableCoordinator(int heartbeat_ms);
+    ClusterCoordinator* coordinator() { return coordinator_.get(); }
+
+    /**
+     * @brief Bound the finished simulations kept, see SimulationRegistry::setRetention
+     */
+    void setRetention(size_t max_finished, std::chrono::seconds ttl);
+
+    /**
+     * @brief Run as a node of the coordinator this service reports to
+     *
+     * Creates the secret sent with every NodeStatus report. Only calls that
+     * present it may release queued simulations, so only the joined
+     * coordinator can move work off this node. Call before the server starts.
+     */
+    void joinCluster();
+
+    /**
+     * @brief Capacity and scheduler load of this service, as reported to a coordinator
+     */
+    void nodeStatus(NodeStatus* status) const;
+
+    /**
+     * @brief Requeue released simulations whose hold ran out unconfirmed
+     */
+    void expireReleases();
+
+    /**
+     * @brief Operational metrics of this service
+     */
+    MetricsRegistry& metrics() { return metrics_; }
+
+    /**
+     * @brief Request validation shared by StartSimulation, StartEnsemble and LoadSimulation
+     *
+     * Stateless: uploads named by a request are resolved separately. The
+     * envelope checks run before the patient data is looked at.
+     * @param error_msg Output parameter for error message
+     * @return false if the request cannot be simulated
+     */
+    static bool validateSimulationRequest(const SimulationRequest& request,
+                                          std::string& error_msg);
+
+    /**
+     * @brief The checks of validateSimulationRequest that do not read the patient data
+     * @param has_data Whether the request carries inline patient data
+     */
+    static bool validateRequestEnvelope(const SimulationRequest& request, bool has_data,
+                                        std::string& error_msg);
+    static bool validateSimulationParameters(const SimulationParameters& params,
+                                             std::string& error_msg);
+    static bool validatePatientData(const PatientData& data, std::string& error_msg);
+
+    /**
+     * @brief Whether a client-chosen simulation ID is safe to name files after
+     */
+    static bool isSafeSimulationId(const std::string& simulation_id);
+
+    /**
+     * @brief Validate a WatchSimulation request and find the simulation it watches
+     */
+    grpc::Status watchTarget(const WatchRequest& request,
+                             std::shared_ptr<SimulationRecord>* record) const;
+
+    /**
+     * @brief Validate a GetSimulationResults request and lay out its chunks
+     *
+     * A past step is served from the simulation's StepHistory: its metrics
+     * alone, or its grids and agents if a snapshot was stored for it. The
+     * caller pulls the chunks with ResultsStream::next() at the pace
+     * its client reads them, and reports the time spent encoding with
+     * recordResultSerialization().
+     */
+    grpc::Status openResults(const ResultsRequest& request,
+                             std::unique_ptr<ResultsStream>* stream) const;
+    void recordResultSerialization(uint64_t encode_ns) const;
+
+    /**
+     * @brief StartSimulation on the serialized request, as received
+     *
+     * Parses and validates everything but the inline patient data first,
+     * skipping over its bytes, so a bad request is rejected before a copy
+     * of its payloads is made. An accepted request is parsed once onto an
+     * arena that the job keeps alive for as long as it needs the data.
+     */
+    grpc::Status startSimulationFromWire(grpc::ServerContext* context,
+                                         const grpc::ByteBuffer* request,
+                                         grpc::ByteBuffer* response);
 
     // RPC method implementations
     grpc::Status StartSimulation(
@@ -27,16 +330,41 @@ public:
         const SimulationRequest* request,
         SimulationResponse* response) override;
 
+    grpc::Status StartEnsemble(
+        grpc::ServerContext* context,
+        const EnsembleRequest* request,
+        EnsembleResponse* response) override;
+
+    grpc::Status GetEnsembleStatus(
+        grpc::ServerContext* context,
+        const EnsembleStatusRequest* request,
+        EnsembleStatusResponse* response) override;
+
+    grpc::Status UploadPatientData(
+        grpc::ServerContext* context,
+        grpc::ServerReader<PatientDataChunk>* reader,
+        UploadResponse* response) override;
+
     grpc::Status GetSimulationStatus(
         grpc::ServerContext* context,
         const StatusRequest* request,
         StatusResponse* response) override;
 
+    grpc::Status WatchSimulation(
+        grpc::ServerContext* context,
+        const WatchRequest* request,
+        grpc::ServerWriter<StatusResponse>* writer) override;
+
     grpc::Status GetSimulationResults(
         grpc::ServerContext* context,
         const ResultsRequest* request,
         grpc::ServerWriter<ResultsChunk>* writer) override;
 
+    grpc::Status GetMetricHistory(
+        grpc::ServerContext* context,
+        const MetricHistoryRequest* request,
+        MetricHistory* response) override;
+
     grpc::Status StopSimulation(
         grpc::ServerContext* context,
         const StopRequest* request,
@@ -57,32 +385,144 @@ public:
         const HealthCheckRequest* request,
         HealthCheckResponse* response) override;
 
+    grpc::Status ReportNodeStatus(
+        grpc::ServerContext* context,
+        const NodeStatus* request,
+        NodeStatusResponse* response) override;
+
+    grpc::Status ReleaseQueuedJobs(
+        grpc::ServerContext* context,
+        const ReleaseJobsRequest* request,
+        ReleaseJobsResponse* response) override;
+
+    grpc::Status ConfirmRelease(
+        grpc::ServerContext* context,
+        const ConfirmReleaseRequest* request,
+        ConfirmReleaseResponse* response) override;
+
+    // Longest a coordinator may hold released simulations out of the queue
+    static constexpr int kMaxReleaseHoldMs = 5 * 60 * 1000;
+
 private:
-    // Helper methods for request validation
-    bool validateSimulationRequest(const SimulationRequest& request, std::string& error_msg);
-    bool validateSimulationParameters(const SimulationParameters& params, std::string& error_msg);
-    bool validatePatientData(const PatientData& data, std::string& error_msg);
-    
+    // Queued jobs handed to the coordinator, kept until it confirms where they run
+    struct PendingRelease {
+        std::vector<std::shared_ptr<SimulationJob>> jobs;  // Latest first, as taken
+        std::chrono::steady_clock::time_point expires;
+    };
+
     // Generate unique simulation ID
     std::string generateSimulationId();
+
+    // OK if `token` is the one this node reports to its coordinator
+    grpc::Status authorizeRelease(const std::string& token) const;
+
+    // Patient data of a finished upload, or null if unknown
+    std::shared_ptr<const PatientData> findUpload(const std::string& upload_id) const;
+
+    // The upload a validated request names, null if it sends its data inline
+    grpc::Status resolveUpload(const SimulationRequest& request,
+                               std::shared_ptr<const PatientData>* upload) const;
+
+    // Register and queue a validated request; the job reads its patient data from `patient`,
+    // never from request.data()
+    grpc::Status submitSimulation(const SimulationRequest& request,
+                                  std::shared_ptr<const PatientData> patient,
+                                  SimulationResponse* response);
+
+    // Job body executed on a scheduler worker thread; resumes from `checkpoint` when non-empty,
+    // starts ensemble members from `initial` when set, else from the request's patient data
+    void runSimulation(SimulationJob& job, SimulationRecord& record,
+                       const CheckpointChain& checkpoint, SharedInitialState* initial = nullptr);
+
+    bool writeCheckpoint(const SimulationJob& job, const SimulationRecord& record,
+                         SimulationEngine& engine, CheckpointSeries& series,
+                         bool compact, std::string& error_msg) const;
+
+    // The state of a step not held in memory, from the simulation's history
+    grpc::Status pastSnapshot(const SimulationRecord& record, const ResultsRequest& request,
+                              int32_t step,
+                              std::shared_ptr<const SimulationSnapshot>* snapshot) const;
+
+    // True once every member has finished and the registry's retention has dropped it
+    bool ensembleRetired(const EnsembleRecord& ensemble) const;
+
+    // Drop retired ensembles once the map has doubled since the last sweep; ensembles_mutex_ held
+    void sweepEnsembles();
+
+    // Observe the phases an engine ran since `seen` (its call counts, updated here)
+    void publishProfile(const StepProfiler& profiler,
+                        std::array<uint64_t, kNumProfilePhases>* seen) const;
+
+    // Declared first so the series below can be resolved in the constructor
+    MetricsRegistry metrics_;
+    std::array<Histogram*, kNumProfilePhases> phase_seconds_{};
+    Histogram* step_seconds_ = nullptr;
+    Histogram* result_serialization_seconds_ = nullptr;
+    Counter* steps_total_ = nullptr;
+    Counter* warm_engine_runs_ = nullptr;
+    Counter* cold_engine_runs_ = nullptr;
     
+    // Directory holding one checkpoint file per simulation
+    std::string checkpoint_directory_;
+
+    // Parent of one spool directory per upload
+    std::string upload_directory_;
+
+    // Parent of one StepHistory directory per simulation
+    std::string history_directory_;
+
+    // Finished uploads by ID, and their IDs oldest first for eviction
+    mutable std::mutex uploads_mutex_;
+    std::unordered_map<std::string, std::shared_ptr<const PatientData>> uploads_;
+    std::deque<std::string> upload_order_;
+
+    // Models built from PatientData, so repeat submissions skip preprocessing
+    std::unique_ptr<PatientCache> patient_cache_;
+
+    // Ensembles by ID; their members are also in the registry
+    mutable std::mutex ensembles_mutex_;
+    std::unordered_map<std::string, std::shared_ptr<const EnsembleRecord>> ensembles_;
+    size_t ensemble_sweep_at_ = kMinEnsembleSweep;
+
     // Server state
     std::atomic<bool> is_serving_{true};
+
+    // All simulations accepted by this service
+    SimulationRegistry registry_;
+
+    // Set in coordinator mode, where the registry and scheduler stay empty
+    std::unique_ptr<ClusterCoordinator> coordinator_;
+
+    // Set by joinCluster(); releases of queued jobs by release ID
+    std::string release_token_;
+    std::mutex releases_mutex_;
+    std::unordered_map<std::string, PendingRelease> pending_releases_;
+
+    // Engines reused across runs; outlives the workers that lease them
+    EnginePool engine_pool_;
+
+    // Declared last so workers are joined before the rest of the service is torn down
+    JobScheduler scheduler_;
 };
 
 /**
  * @brief gRPC server wrapper class
  * 
  * Manages the lifecycle of the gRPC server, including initialization,
- * starting, and graceful shutdown.
+ * starting, and graceful shutdown. GrpcServerOptions selects the sync or
+ * the completion-queue threading model and tunes the transport.
  */
 class GrpcServer {
 public:
     /**
      * @brief Construct a new GrpcServer
      * @param server_address Address to bind the server to (e.g., "0.0.0.0:50051")
+     * @param metrics_address host:port serving Prometheus metrics over HTTP (empty = none)
+     * @param options Threading model and transport settings
      */
-    explicit GrpcServer(const std::string& server_address);
+    explicit GrpcServer(const std::string& server_address,
+                        const std::string& metrics_address = "",
+                        const GrpcServerOptions& options = GrpcServerOptions());
     
     ~GrpcServer();
 
@@ -110,10 +550,32 @@ public:
      */
     bool isRunning() const { return is_running_; }
 
+    /**
+     * @brief Port of the metrics endpoint while running, 0 without one
+     */
+    int metricsPort() const { return exporter_ ? exporter_->port() : 0; }
+
+    SimulationServiceImpl& service() { return *service_; }
+    const GrpcServerOptions& options() const { return options_; }
+
+    /**
+     * @brief Heartbeat to the coordinator while running as a node, else null
+     */
+    const ClusterMember* member() const { return member_.get(); }
+
 private:
+    void applyOptions(grpc::ServerBuilder& builder) const;
+
     std::string server_address_;
+    std::string metrics_address_;
+    GrpcServerOptions options_;
     std::unique_ptr<SimulationServiceImpl> service_;
+    // Async mode only; declared after the service it forwards to
+    std::unique_ptr<AsyncSimulationService> async_service_;
     std::unique_ptr<grpc::Server> server_;
+    // Declared after the service so it stops reading its metrics first
+    std::unique_ptr<MetricsExporter> exporter_;
+    std::unique_ptr<ClusterMember> member_;
     std::atomic<bool> is_running_{false};
 };
 
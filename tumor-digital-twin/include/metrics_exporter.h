@@ -0,0 +1,62 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <thread>
+
+#include "utils/metrics_registry.h"
+
+namespace tumordtwin {
+
+/**
+ * @brief Minimal HTTP endpoint serving a MetricsRegistry to Prometheus scrapers
+ *
+ * Answers GET /metrics with MetricsRegistry::renderPrometheus() and
+ * anything else with 404. One background thread accepts a connection at
+ * a time and closes it after the response, which is all a scraper polling
+ * every few seconds needs.
+ */
+class MetricsExporter {
+public:
+    static constexpr const char* kMetricsPath = "/metrics";
+
+    /**
+     * @param registry Registry to serve; must outlive the exporter
+     * @param address host:port to listen on; port 0 picks a free port
+     */
+    MetricsExporter(const MetricsRegistry& registry, std::string address);
+    ~MetricsExporter();
+
+    MetricsExporter(const MetricsExporter&) = delete;
+    MetricsExporter& operator=(const MetricsExporter&) = delete;
+
+    /**
+     * @brief Bind the address and start serving
+     * @param error_msg Output parameter for error message
+     * @return false if the address is invalid or cannot be bound
+     */
+    bool start(std::string& error_msg);
+
+    /**
+     * @brief Stop serving and join the thread; safe to call more than once
+     */
+    void stop();
+
+    /**
+     * @brief Port actually bound, after start()
+     */
+    int port() const { return port_; }
+
+private:
+    void serve();
+    void handle(int client) const;
+
+    const MetricsRegistry& registry_;
+    const std::string address_;
+    int listen_fd_ = -1;
+    int port_ = 0;
+    std::atomic<bool> running_{false};
+    std::thread thread_;
+};
+
+} // namespace tumordtwin
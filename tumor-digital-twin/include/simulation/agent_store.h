@@ -0,0 +1,230 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <google/protobuf/repeated_field.h>
+
+#include "common.pb.h"
+#include "evolution/genotype_table.h"
+#include "utils/aligned_allocator.h"
+
+namespace tumordtwin {
+
+/**
+ * @brief Structure-of-arrays container for the cell population
+ *
+ * Each agent attribute lives in its own contiguous, cache-line aligned
+ * column, so update kernels stream through exactly the fields they use.
+ * Agents are addressed by a dense index that is not stable across
+ * removals (removal swaps the last agent into the hole); the 64-bit
+ * agent ID is the stable identity. Protobuf Agent messages are only built
+ * at the API boundary via toProto()/fromProto().
+ *
+ * Agents are kept partitioned by type into contiguous buckets, so the
+ * rules of each type run as a loop over [bucketBegin(), bucketEnd())
+ * without testing the type of every agent. Cancer cells are the last
+ * bucket: dividing and dying cells are appended and swap-removed at the
+ * end of the store exactly as without buckets. Adding or removing an
+ * agent of another type moves one agent of every later bucket.
+ */
+class AgentStore {
+public:
+    using GenotypeId = GenotypeTable::GenotypeId;
+
+    static constexpr size_t kNumBuckets = 6;
+
+    /**
+     * @brief Bucket holding a type; unknown type values share the first bucket
+     */
+    static constexpr size_t bucketOf(AgentType type) {
+        switch (type) {
+            case AgentType::T_CELL: return 1;
+            case AgentType::MACROPHAGE: return 2;
+            case AgentType::FIBROBLAST: return 3;
+            case AgentType::ENDOTHELIAL: return 4;
+            case AgentType::CANCER_CELL: return kNumBuckets - 1;
+            default: return 0;
+        }
+    }
+
+    /**
+     * @brief Insert an agent with a freshly assigned ID at the end of its bucket
+     * @return Dense index of the new agent
+     */
+    size_t add(AgentType type, double x, double y, double z,
+               CellState state = CellState::PROLIFERATING,
+               double age = 0.0, double cycle_phase = 0.0,
+               GenotypeId genotype = GenotypeTable::kEmptyGenotype);
+
+    /**
+     * @brief Remove the agent at a dense index by swapping in the last agent
+     *
+     * The hole is filled from the end of the agent's bucket; outside the
+     * last bucket the last agent of every later bucket then moves down by
+     * one, so a SpatialIndex mirroring the removal needs an update().
+     *
+     * @return Whether agents other than the last one moved
+     */
+    bool remove(size_t index);
+
+    /**
+     * @brief Remove all agents for which the predicate returns true
+     *
+     * Preserves the relative order of surviving agents.
+     *
+     * @param pred Callable taking a dense index
+     * @return Number of agents removed
+     */
+    template <typename Pred>
+    size_t removeIf(Pred pred);
+
+    void reserve(size_t capacity);
+    void clear();
+
+    /**
+     * @brief Resize every column, e.g. before bulk-loading them from a checkpoint
+     *
+     * New agents are zero-initialized; callers must fill the columns,
+     * restore the ID counter with setNextId() and call restoreBuckets().
+     */
+    void resize(size_t count);
+
+    /**
+     * @brief Re-partition agents by type after their columns were written directly
+     *
+     * A stable sort by bucket; O(N) and without moves when the agents are
+     * already partitioned, e.g. when loaded from a checkpoint of a store.
+     */
+    void restoreBuckets();
+
+    size_t size() const { return ids_.size(); }
+    bool empty() const { return ids_.empty(); }
+
+    /**
+     * @brief Dense index range of the agents of one type
+     */
+    size_t bucketBegin(AgentType type) const { return bucket_begin_[bucketOf(type)]; }
+    size_t bucketEnd(AgentType type) const { return bucket_begin_[bucketOf(type) + 1]; }
+
+    /**
+     * @brief Count agents of a given type
+     */
+    size_t countType(AgentType type) const { return bucketEnd(type) - bucketBegin(type); }
+
+    // Column access for update kernels
+    AlignedVector<uint64_t>& ids() { return ids_; }
+    AlignedVector<double>& x() { return x_; }
+    AlignedVector<double>& y() { return y_; }
+    AlignedVector<double>& z() { return z_; }
+    AlignedVector<uint8_t>& types() { return types_; }
+    AlignedVector<uint8_t>& states() { return states_; }
+    AlignedVector<double>& ages() { return ages_; }
+    AlignedVector<double>& cyclePhases() { return cycle_phases_; }
+    AlignedVector<GenotypeId>& genotypes() { return genotypes_; }
+
+    const AlignedVector<uint64_t>& ids() const { return ids_; }
+    const AlignedVector<double>& x() const { return x_; }
+    const AlignedVector<double>& y() const { return y_; }
+    const AlignedVector<double>& z() const { return z_; }
+    const AlignedVector<uint8_t>& types() const { return types_; }
+    const AlignedVector<uint8_t>& states() const { return states_; }
+    const AlignedVector<double>& ages() const { return ages_; }
+    const AlignedVector<double>& cyclePhases() const { return cycle_phases_; }
+    const AlignedVector<GenotypeId>& genotypes() const { return genotypes_; }
+
+    AgentType type(size_t index) const { return static_cast<AgentType>(types_[index]); }
+    CellState state(size_t index) const { return static_cast<CellState>(states_[index]); }
+
+    /**
+     * @brief Next ID that add() will assign
+     */
+    uint64_t nextId() const { return next_id_; }
+    void setNextId(uint64_t next_id) { next_id_ = next_id; }
+
+    /**
+     * @brief Export the population into SimulationState.agents
+     * @param agents Destination field (cleared first)
+     * @param genotypes Table the genotype indices refer to
+     */
+    void toProto(google::protobuf::RepeatedPtrField<Agent>* agents,
+                 const GenotypeTable& genotypes) const;
+
+    /**
+     * @brief Export a single agent, e.g. when streaming the population in batches
+     */
+    void toProto(size_t index, Agent* agent, const GenotypeTable& genotypes) const;
+
+    /**
+     * @brief Replace the population with agents from SimulationState.agents
+     *
+     * Agent IDs are preserved; genotype bytes are interned into the table.
+     * Agents keep their order within each type.
+     */
+    void fromProto(const google::protobuf::RepeatedPtrField<Agent>& agents,
+                   GenotypeTable& genotypes);
+
+private:
+    // Copy every column of one agent over another
+    void moveAgent(size_t from, size_t to);
+
+    AlignedVector<uint64_t> ids_;
+    AlignedVector<double> x_;
+    AlignedVector<double> y_;
+    AlignedVector<double> z_;
+    AlignedVector<uint8_t> types_;
+    AlignedVector<uint8_t> states_;
+    AlignedVector<double> ages_;
+    AlignedVector<double> cycle_phases_;
+    AlignedVector<GenotypeId> genotypes_;
+
+    // Bucket b holds [bucket_begin_[b], bucket_begin_[b + 1]); the last entry is size()
+    std::array<size_t, kNumBuckets + 1> bucket_begin_{};
+    uint64_t next_id_ = 1;
+};
+
+inline void AgentStore::moveAgent(size_t from, size_t to) {
+    ids_[to] = ids_[from];
+    x_[to] = x_[from];
+    y_[to] = y_[from];
+    z_[to] = z_[from];
+    types_[to] = types_[from];
+    states_[to] = states_[from];
+    ages_[to] = ages_[from];
+    cycle_phases_[to] = cycle_phases_[from];
+    genotypes_[to] = genotypes_[from];
+}
+
+template <typename Pred>
+size_t AgentStore::removeIf(Pred pred) {
+    const size_t n = size();
+    size_t out = 0;
+    for (size_t b = 0; b < kNumBuckets; ++b) {
+        const size_t begin = bucket_begin_[b];
+        const size_t end = bucket_begin_[b + 1];
+        bucket_begin_[b] = out;
+        for (size_t i = begin; i < end; ++i) {
+            if (pred(i)) {
+                continue;
+            }
+            if (out != i) {
+                moveAgent(i, out);
+            }
+            ++out;
+        }
+    }
+    bucket_begin_[kNumBuckets] = out;
+
+    ids_.resize(out);
+    x_.resize(out);
+    y_.resize(out);
+    z_.resize(out);
+    types_.resize(out);
+    states_.resize(out);
+    ages_.resize(out);
+    cycle_phases_.resize(out);
+    genotypes_.resize(out);
+    return n - out;
+}
+
+} // namespace tumordtwin
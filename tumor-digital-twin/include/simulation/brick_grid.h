@@ -0,0 +1,190 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "simulation.pb.h"
+#include "simulation/scalar_grid.h"
+#include "utils/block_pool.h"
+
+namespace tumordtwin {
+
+/**
+ * @brief Sparse 3D scalar field tiled into 8^3 bricks
+ *
+ * A brick is either uniform, holding one value for all of its voxels and
+ * no storage, or dense with 512 values. A small tumor in a large domain
+ * only perturbs the bricks around it; the far field stays uniform and
+ * costs a few bytes per brick instead of 4 KB. Writes expand a uniform
+ * brick on demand; collapse() turns bricks that are flat again back into
+ * uniform ones. Brick storage comes from a per-grid BlockPool, so bricks
+ * that are expanded and collapsed every step reuse the same memory.
+ *
+ * Logical indexing is the same as ScalarGrid, and the flat GridData.values
+ * layout is produced on export. Bricks on the high faces may be partial
+ * when a dimension is not a multiple of 8; their voxels beyond the domain
+ * are never read.
+ */
+class BrickGrid {
+public:
+    static constexpr int kBrickEdge = 8;
+    static constexpr int kBrickShift = 3;
+    static constexpr size_t kBrickVoxels = 512;
+
+    BrickGrid() = default;
+    BrickGrid(int nx, int ny, int nz, double spacing, double initial_value = 0.0);
+
+    // Copies hold only the dense bricks, in a pool of their own
+    BrickGrid(const BrickGrid& other);
+    BrickGrid& operator=(const BrickGrid& other);
+    BrickGrid(BrickGrid&&) noexcept = default;
+    BrickGrid& operator=(BrickGrid&&) noexcept = default;
+
+    /**
+     * @brief Set the shape and make every brick uniform at initial_value
+     */
+    void resize(int nx, int ny, int nz, double spacing, double initial_value = 0.0);
+
+    /**
+     * @brief Make every brick uniform at value, releasing all brick storage
+     */
+    void fill(double value);
+
+    int nx() const { return nx_; }
+    int ny() const { return ny_; }
+    int nz() const { return nz_; }
+    double spacing() const { return spacing_; }
+    size_t size() const { return static_cast<size_t>(nx_) * ny_ * nz_; }
+
+    int bricksX() const { return bx_; }
+    int bricksY() const { return by_; }
+    int bricksZ() const { return bz_; }
+    size_t numBricks() const { return bricks_.size(); }
+
+    size_t brickIndex(int bi, int bj, int bk) const {
+        return (static_cast<size_t>(bk) * by_ + bj) * bx_ + bi;
+    }
+
+    /**
+     * @brief Index of a voxel within its brick (x fastest, like the flat layout)
+     */
+    static size_t localIndex(int li, int lj, int lk) {
+        return (static_cast<size_t>(lk) * kBrickEdge + lj) * kBrickEdge + li;
+    }
+
+    bool isUniform(size_t brick) const { return bricks_[brick].values == nullptr; }
+    double uniformValue(size_t brick) const { return bricks_[brick].value; }
+
+    /**
+     * @brief Values of a dense brick, or nullptr if it is uniform
+     */
+    const double* brickData(size_t brick) const {
+        return bricks_[brick].values;
+    }
+
+    /**
+     * @brief Values of a brick, expanding it first if it is uniform
+     */
+    double* denseBrick(size_t brick);
+
+    /**
+     * @brief Make one brick uniform, releasing its storage
+     */
+    void setUniform(size_t brick, double value);
+
+    /**
+     * @brief Check whether a brick's values span at most tolerance
+     * @param value Set to the value the brick would collapse to
+     */
+    bool isFlat(size_t brick, double tolerance, double* value) const;
+
+    /**
+     * @brief Collapse a dense brick whose values span at most tolerance
+     * @return true if the brick is uniform afterwards
+     */
+    bool collapseBrick(size_t brick, double tolerance = 0.0);
+
+    /**
+     * @brief Collapse every dense brick that is flat within tolerance
+     * @return Number of bricks collapsed
+     */
+    size_t collapse(double tolerance = 0.0);
+
+    double value(int i, int j, int k) const {
+        const Brick& brick = bricks_[brickIndex(i >> kBrickShift, j >> kBrickShift, k >> kBrickShift)];
+        return !brick.values
+                   ? brick.value
+                   : brick.values[localIndex(i & (kBrickEdge - 1), j & (kBrickEdge - 1),
+                                             k & (kBrickEdge - 1))];
+    }
+
+    /**
+     * @brief Writable voxel reference; expands the brick if it is uniform
+     */
+    double& at(int i, int j, int k) {
+        double* values = denseBrick(brickIndex(i >> kBrickShift, j >> kBrickShift, k >> kBrickShift));
+        return values[localIndex(i & (kBrickEdge - 1), j & (kBrickEdge - 1), k & (kBrickEdge - 1))];
+    }
+
+    /**
+     * @brief Number of voxels of a brick that lie inside the domain
+     */
+    size_t validVoxels(size_t brick) const;
+
+    size_t denseBricks() const;
+
+    /**
+     * @brief Heap bytes held by the grid, including pooled bricks not in use
+     */
+    size_t memoryBytes() const;
+
+    double mean() const;
+
+    /**
+     * @brief Build from a dense grid, keeping bricks flat within tolerance uniform
+     */
+    void fromDense(const ScalarGrid& grid, double tolerance = 0.0);
+
+    /**
+     * @brief Expand into a dense grid
+     */
+    void toDense(ScalarGrid& grid) const;
+
+    /**
+     * @brief Copy values [first, first + count) of the flat GridData layout
+     */
+    void copyValues(size_t first, size_t count, double* out) const;
+
+    /**
+     * @brief Export into a GridData message (raw little-endian doubles, flat layout)
+     */
+    void toProto(GridData* grid, SubstanceType substance) const;
+
+    /**
+     * @brief Fill everything in a GridData message except the values
+     */
+    void toProtoHeader(GridData* grid, SubstanceType substance) const;
+
+    void swap(BrickGrid& other) noexcept;
+
+private:
+    struct Brick {
+        double value = 0.0;         // Uniform value; stale while dense
+        double* values = nullptr;   // Pool block; null when uniform
+    };
+
+    using Pool = BlockPool<double, kBrickVoxels>;
+
+    int nx_ = 0;
+    int ny_ = 0;
+    int nz_ = 0;
+    int bx_ = 0;
+    int by_ = 0;
+    int bz_ = 0;
+    double spacing_ = 1.0;
+    std::vector<Brick> bricks_;
+    Pool pool_;
+};
+
+} // namespace tumordtwin
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "simulation/brick_grid.h"
+#include "simulation/scalar_grid.h"
+
+namespace tumordtwin {
+
+/**
+ * @brief Boundary treatment on the outer faces of the domain
+ */
+enum class BoundaryCondition {
+    Dirichlet,  // Faces held at a fixed far-field concentration
+    Neumann     // Zero flux through the faces
+};
+
+/**
+ * @brief Coefficients of one reaction-diffusion field
+ *
+ * du/dt = D * laplacian(u) - (decay_rate + uptake(x)) * u
+ */
+struct DiffusionParams {
+    double diffusion_coeff = 0.0;   // Spatial units^2 per time unit
+    double decay_rate = 0.0;        // Uniform first-order decay per time unit
+    double boundary_value = 0.0;    // Face value for Dirichlet boundaries
+    BoundaryCondition boundary = BoundaryCondition::Dirichlet;
+};
+
+/**
+ * @brief Explicit 3D reaction-diffusion solver on a ScalarGrid
+ *
+ * Uses a 7-point stencil with forward Euler time integration. Interior
+ * rows go through an AVX-512 / AVX2 kernel when the build targets those
+ * instruction sets, and the domain is tiled in y and z so that each
+ * thread streams a small slab of planes through cache. Each call takes
+ * one explicit step; callers advancing by more than the stability limit
+ * split the interval into subSteps() calls.
+ */
+class DiffusionSolver {
+public:
+    /**
+     * @brief Construct a solver
+     * @param num_threads OpenMP threads per step (0 = runtime default)
+     */
+    explicit DiffusionSolver(int num_threads = 0);
+
+    /**
+     * @brief Advance a field by one explicit time step
+     * @param field Field to update in place
+     * @param params Diffusion, decay and boundary coefficients
+     * @param dt Time step
+     * @param uptake Optional per-voxel linear uptake rate (same shape as field)
+     */
+    void step(ScalarGrid& field, const DiffusionParams& params, double dt,
+              const ScalarGrid* uptake = nullptr);
+
+    /**
+     * @brief Advance a sparse field by one explicit time step
+     *
+     * Only bricks that are dense, carry uptake, or border a brick with a
+     * different value are computed voxel by voxel; a uniform brick in a
+     * uniform neighbourhood stays uniform and is updated with one
+     * multiply. Computed bricks that end up flat within
+     * collapse_tolerance are collapsed again. With collapse_tolerance = 0
+     * the result equals the dense step() up to rounding of the vector
+     * kernels.
+     *
+     * @param uptake Optional per-voxel linear uptake rate (same shape as field)
+     */
+    void step(BrickGrid& field, const DiffusionParams& params, double dt,
+              const BrickGrid* uptake = nullptr, double collapse_tolerance = 0.0);
+
+    /**
+     * @brief Compute planes [k_begin, k_end) of the next time step without publishing them
+     *
+     * Lets a caller update parts of the field at different times, e.g. the
+     * planes away from a slab's ghost planes while those are still being
+     * received. commit() swaps the result in; planes that were not updated
+     * are left undefined, which is fine for ghost planes that are refilled
+     * before the next step.
+     */
+    void stepPlanes(const ScalarGrid& field, const DiffusionParams& params, double dt,
+                    const ScalarGrid* uptake, int k_begin, int k_end);
+
+    /**
+     * @brief Publish the planes computed by stepPlanes() into the field
+     */
+    void commit(ScalarGrid& field);
+
+    /**
+     * @brief Largest stable explicit time step for a diffusion coefficient
+     */
+    static double maxStableTimeStep(double diffusion_coeff, double spacing);
+
+    /**
+     * @brief Number of equal explicit steps needed to advance a field by dt
+     *
+     * Forward Euler stays stable and non-negative while
+     * dt_sub * (6 D / h^2 + decay_rate + uptake) <= 1, where uptake is the
+     * largest per-voxel uptake rate over the interval.
+     *
+     * @return At least 1, at most kMaxSubSteps
+     */
+    static int subSteps(const DiffusionParams& params, double spacing, double dt,
+                        double max_uptake = 0.0);
+
+    static constexpr int kMaxSubSteps = 1 << 16;
+
+    void setNumThreads(int num_threads) { num_threads_ = num_threads; }
+    int numThreads() const { return num_threads_; }
+
+private:
+    // Interior voxels and face voxels are separate sweeps, each specialized
+    // on what is fixed for the step so the per-voxel loops do not branch on it
+    template <bool HasUptake>
+    void applyInterior(const ScalarGrid& in, ScalarGrid& out, double r, double center,
+                       double dt, const double* uptake, int k_begin, int k_end) const;
+    template <BoundaryCondition Boundary, bool HasUptake>
+    void applyBoundary(const ScalarGrid& in, ScalarGrid& out, const DiffusionParams& params,
+                       double r, double center, double dt, const double* uptake,
+                       int k_begin, int k_end) const;
+
+    bool brickIsSteady(const BrickGrid& field, const BrickGrid* uptake,
+                       const DiffusionParams& params, int bi, int bj, int bk,
+                       double next) const;
+    void stepBrick(const BrickGrid& field, const BrickGrid* uptake,
+                   const DiffusionParams& params, double r, double center, double dt,
+                   int bi, int bj, int bk, double* out) const;
+
+    int num_threads_;
+    ScalarGrid scratch_;
+    BrickGrid brick_scratch_;
+    // Per-brick plan of the sparse step: value of steady/flat bricks, and which are computed
+    std::vector<double> brick_values_;
+    std::vector<uint8_t> brick_computed_;
+};
+
+} // namespace tumordtwin
@@ -0,0 +1,202 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "evolution/genotype_table.h"
+#include "simulation/agent_store.h"
+#include "simulation/brick_grid.h"
+#include "simulation/diffusion_solver.h"
+#include "simulation/scalar_grid.h"
+#include "simulation/slab_transport.h"
+
+namespace tumordtwin {
+
+/**
+ * @brief z-planes owned by one rank of a slab decomposition
+ *
+ * A rank's local fields hold its owned planes plus one ghost plane on
+ * each side that has a neighbouring rank. Ranks on the outer z faces
+ * have no ghost plane there, so the solver's boundary handling applies
+ * to their local field unchanged.
+ */
+struct SlabExtent {
+    int z_begin = 0;  // First owned global plane
+    int z_end = 0;    // One past the last owned global plane
+    bool ghost_below = false;
+    bool ghost_above = false;
+
+    int ownedPlanes() const { return z_end - z_begin; }
+    int localPlanes() const { return ownedPlanes() + ghost_below + ghost_above; }
+
+    // Local index of plane z_begin
+    int firstOwnedLocal() const { return ghost_below ? 1 : 0; }
+};
+
+/**
+ * @brief Split of the nz planes of the lattice into contiguous slabs, one per rank
+ *
+ * Slabs differ in size by at most one plane. Slabs along z keep every
+ * owned plane contiguous in memory, so halo planes are sent without
+ * packing.
+ */
+class SlabDecomposition {
+public:
+    /**
+     * @brief Check that nz planes can be split across num_ranks ranks
+     * @param error_msg Output parameter for error message
+     */
+    static bool validate(int nz, int num_ranks, std::string& error_msg);
+
+    /**
+     * @param nz Planes of the global lattice
+     * @param num_ranks Number of slabs (see validate())
+     */
+    SlabDecomposition(int nz, int num_ranks);
+
+    int nz() const { return nz_; }
+    int numRanks() const { return num_ranks_; }
+
+    SlabExtent extent(int rank) const;
+
+    /**
+     * @brief Rank owning a global plane
+     */
+    int ownerOfPlane(int k) const;
+
+    /**
+     * @brief Rank owning a z coordinate; positions outside the domain go to the nearest slab
+     */
+    int ownerOfZ(double z, double spacing) const;
+
+private:
+    int nz_;
+    int num_ranks_;
+    int base_planes_;  // Planes per slab; the first extra_planes_ slabs get one more
+    int extra_planes_;
+};
+
+/**
+ * @brief One rank's part of a slab-decomposed simulation domain
+ *
+ * Allocates the local fields, advances them with halo exchange overlapped
+ * with interior compute, and hands agents to the rank whose slab they
+ * moved into. Agent coordinates stay global. All methods except
+ * allocate() and ownsZ() are collective: every rank must call them in the
+ * same order.
+ */
+class SlabDomain {
+public:
+    /**
+     * @param nx, ny, nz Global lattice dimensions
+     * @param spacing Voxel edge length
+     * @param transport Connection to the other ranks; must outlive the domain
+     */
+    SlabDomain(int nx, int ny, int nz, double spacing, SlabTransport& transport);
+
+    const SlabDecomposition& decomposition() const { return decomposition_; }
+    const SlabExtent& extent() const { return extent_; }
+    int rank() const { return transport_.rank(); }
+
+    /**
+     * @brief Size a field to this rank's owned and ghost planes
+     */
+    void allocate(ScalarGrid& field, double initial_value = 0.0) const;
+
+    /**
+     * @brief Global plane index of a local plane
+     */
+    int globalPlane(int local_k) const { return extent_.z_begin - extent_.firstOwnedLocal() + local_k; }
+
+    bool ownsZ(double z) const;
+
+    /**
+     * @brief Fill the ghost planes of a local field from the neighbouring ranks
+     */
+    void exchangeHalo(ScalarGrid& field);
+
+    /**
+     * @brief Advance a local field by one step
+     *
+     * Planes that do not touch a ghost plane are computed while the halo
+     * is in flight; the two planes next to the ghosts follow once it has
+     * arrived. Bitwise identical to DiffusionSolver::step() on the global
+     * field.
+     */
+    void diffuse(DiffusionSolver& solver, ScalarGrid& field, const DiffusionParams& params,
+                 double dt, const ScalarGrid* uptake = nullptr);
+
+    /**
+     * @brief Send agents outside this rank's slab to their owners and adopt arriving ones
+     *
+     * Agent IDs and genotypes travel with the agent; arriving genotypes are
+     * interned into the local table. Ranks must assign IDs from disjoint
+     * ranges (see AgentStore::setNextId()).
+     *
+     * @return Number of agents that left this rank
+     */
+    size_t migrateAgents(AgentStore& agents, GenotypeTable& genotypes);
+
+    /**
+     * @brief Assemble the owned planes of every rank into a global field on rank 0
+     * @param global Set to the global field on rank 0; untouched elsewhere
+     */
+    void gatherField(const ScalarGrid& local, ScalarGrid* global);
+
+    /**
+     * @brief Assemble the owned planes of every rank into a BrickGrid on rank 0
+     *
+     * Each layer of bricks is collapsed (within tolerance) as soon as all
+     * of its planes have arrived, so rank 0 never holds the dense field.
+     */
+    void gatherField(const ScalarGrid& local, BrickGrid* global, double tolerance);
+
+    /**
+     * @brief Copy every rank's agents into one store on rank 0
+     *
+     * Genotypes from other ranks are interned into `global_genotypes`,
+     * which starts as a copy of this rank's table.
+     *
+     * @param global, global_genotypes Set on rank 0; untouched elsewhere
+     */
+    void gatherAgents(const AgentStore& agents, const GenotypeTable& genotypes,
+                      AgentStore* global, GenotypeTable* global_genotypes);
+
+    /**
+     * @brief Rank 0's buffer, on every rank
+     * @param data Sent by rank 0; ignored elsewhere
+     */
+    std::string broadcast(std::string data);
+
+    /**
+     * @brief Every rank's buffer on rank 0, indexed by rank; empty elsewhere
+     */
+    std::vector<std::string> gather(std::string data);
+
+    /**
+     * @brief Element-wise sum or maximum of equally sized vectors over all ranks, on every rank
+     */
+    void allReduceSum(std::vector<double>& values);
+    void allReduceMax(std::vector<double>& values);
+
+private:
+    // Largest exchange of a gather; planes are sent in batches below it
+    static constexpr size_t kGatherBatchBytes = size_t{1} << 30;
+
+    // Calls receive(global_k, values) on rank 0 for every owned plane of every rank
+    template <typename Receive>
+    void gatherPlanes(const ScalarGrid& local, Receive receive);
+
+    template <typename Combine>
+    void allReduce(std::vector<double>& values, Combine combine);
+
+    int nx_;
+    int ny_;
+    double spacing_;
+    SlabTransport& transport_;
+    SlabDecomposition decomposition_;
+    SlabExtent extent_;
+};
+
+} // namespace tumordtwin
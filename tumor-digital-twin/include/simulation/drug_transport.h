@@ -0,0 +1,213 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <queue>
+#include <string>
+#include <vector>
+
+#include "simulation.pb.h"
+#include "simulation/brick_grid.h"
+#include "simulation/diffusion_solver.h"
+#include "simulation/scalar_grid.h"
+
+namespace tumordtwin {
+
+/**
+ * @brief How a drug acts on the cancer cells it reaches
+ */
+enum class DrugMechanism {
+    Cytotoxic,  // Adds to the death rate
+    Cytostatic  // Slows cell cycle progression
+};
+
+/**
+ * @brief A dose of one drug that is due at a simulation time
+ */
+struct DoseEvent {
+    double time = 0.0;  // Hours
+    double amount = 0.0;
+    int drug = 0;       // Index into TreatmentProtocol.drugs
+    int schedule = 0;   // Index into TreatmentProtocol.schedules
+    int32_t dose = 0;   // Number of the dose within its schedule
+};
+
+/**
+ * @brief Drug fields of a TreatmentProtocol, dosed by discrete events
+ *
+ * Each drug has a plasma concentration and a tissue field. A dose raises
+ * the plasma concentration by dose_amount / volume_of_distribution, and
+ * plasma decays with the drug's half_life. The tissue field follows
+ *
+ *   du/dt = D * laplacian(u) - k * u,  k = ln 2 / half_life
+ *
+ * with the domain faces held at the plasma concentration (vascular supply,
+ * like oxygen), and is advanced with the diffusion solver, sub-cycled for
+ * stability.
+ *
+ * Doses are events in a queue ordered by time, so a step only compares the
+ * earliest pending dose with its end time: schedules[i] doses drugs[i], and
+ * every schedule doses the only drug of a single-drug protocol. Doses due
+ * within a step are given at its start. num_doses 0 counts as one dose.
+ *
+ * A drug's field only exists from its first dose until both the plasma
+ * concentration and the whole field have fallen below a negligible
+ * concentration; in between doses nothing is allocated or solved.
+ *
+ * Effects follow an Emax model, E = emax * u / (u + ec50), read from
+ * Drug.properties (kProperty* keys): cytotoxic drugs add E to the death
+ * rate per hour, cytostatic drugs slow cycle progression by the fraction E
+ * (emax at most 1).
+ */
+class DrugTransport {
+public:
+    static constexpr const char* kPropertyEmax = "emax";
+    static constexpr const char* kPropertyEc50 = "ec50";
+    static constexpr const char* kPropertyVolume = "volume_of_distribution";
+
+    static constexpr double kDefaultEmax = 1.0;
+    static constexpr double kDefaultEc50 = 1.0;
+    static constexpr double kDefaultVolume = 1.0;
+    static constexpr double kDefaultNegligibleConcentration = 1e-6;
+
+    /**
+     * @brief Check that a protocol can be simulated
+     * @return false on unknown mechanisms, non-positive half lives or inconsistent schedules
+     */
+    static bool validate(const TreatmentProtocol& protocol, std::string& error_msg);
+
+    /**
+     * @brief Set the drugs and the lattice of a validated protocol; no drug is given yet
+     * @param negligible Concentration below which a field is released
+     */
+    void configure(const TreatmentProtocol& protocol, int nx, int ny, int nz, double spacing,
+                   double negligible = kDefaultNegligibleConcentration);
+
+    size_t numDrugs() const { return drugs_.size(); }
+    const std::string& drugName(size_t drug) const { return drugs_[drug].name; }
+
+    /**
+     * @brief Release every field and queue the doses due from `time` on
+     * @param sparse Store fields as BrickGrids instead of ScalarGrids
+     */
+    void reset(double time, bool sparse);
+
+    /**
+     * @brief Queue the doses due from `time` on, keeping the loaded drug state
+     *
+     * Called when a run resumes from a checkpoint (see loadState()).
+     */
+    void reschedule(double time, bool sparse);
+
+    /**
+     * @brief Give the doses due before time + dt, then advance the active fields by dt
+     * @param min_substeps Lower bound on the diffusion sub-steps
+     * @param sparse_tolerance Collapse tolerance of sparse fields
+     */
+    void step(DiffusionSolver& solver, double time, double dt, int min_substeps = 1,
+              double sparse_tolerance = 0.0);
+
+    /**
+     * @brief Whether any drug field is allocated
+     */
+    bool active() const { return active_drugs_ > 0; }
+
+    bool fieldActive(size_t drug) const { return drugs_[drug].active; }
+    double plasmaConcentration(size_t drug) const { return drugs_[drug].plasma; }
+
+    /**
+     * @brief Time of the earliest pending dose, +inf if none is left
+     */
+    double nextDoseTime() const {
+        return events_.empty() ? std::numeric_limits<double>::infinity() : events_.top().time;
+    }
+
+    /**
+     * @brief Tissue concentration of one drug at a voxel (0 while its field is released)
+     */
+    double concentration(size_t drug, int i, int j, int k) const;
+
+    /**
+     * @brief Extra death rate per hour from the cytotoxic drugs at a voxel
+     */
+    double killRate(int i, int j, int k) const;
+
+    /**
+     * @brief Fraction by which the cytostatic drugs slow the cell cycle at a voxel
+     */
+    double arrestFraction(int i, int j, int k) const;
+
+    /**
+     * @brief Mean tissue concentration of one drug
+     */
+    double meanConcentration(size_t drug) const;
+
+    /**
+     * @brief Sum of all drug fields, filled only when any drug is active
+     *
+     * The dense or the sparse grid is set, matching the storage of the fields.
+     */
+    void totalField(ScalarGrid* dense, BrickGrid* sparse) const;
+
+    /**
+     * @brief Serialize the plasma concentrations and active fields (dense, x fastest)
+     */
+    std::string saveState() const;
+
+    /**
+     * @brief Restore state from saveState(); empty bytes restore no drug at all
+     * @return false if the bytes do not match the configured drugs and lattice
+     */
+    bool loadState(const std::string& bytes, std::string& error_msg);
+
+private:
+    struct Drug {
+        std::string name;
+        DrugMechanism mechanism = DrugMechanism::Cytotoxic;
+        DiffusionParams params;  // boundary_value follows the plasma concentration
+        double emax = kDefaultEmax;
+        double ec50 = kDefaultEc50;
+        double volume = kDefaultVolume;
+
+        double plasma = 0.0;
+        bool active = false;
+        ScalarGrid field;
+        BrickGrid sparse_field;
+    };
+
+    struct Schedule {
+        int drug = 0;
+        double start = 0.0;
+        double interval = 0.0;
+        double amount = 0.0;
+        int32_t doses = 1;
+
+        double doseTime(int32_t dose) const { return start + dose * interval; }
+    };
+
+    struct LaterDose {
+        bool operator()(const DoseEvent& a, const DoseEvent& b) const {
+            return a.time != b.time ? a.time > b.time : a.schedule > b.schedule;
+        }
+    };
+
+    void activate(Drug& drug);
+    void release(Drug& drug);
+    double maxConcentration(const Drug& drug) const;
+    double effect(const Drug& drug, int i, int j, int k) const;
+
+    int nx_ = 0;
+    int ny_ = 0;
+    int nz_ = 0;
+    double spacing_ = 1.0;
+    double negligible_ = kDefaultNegligibleConcentration;
+    bool sparse_ = false;
+
+    std::vector<Drug> drugs_;
+    std::vector<Schedule> schedules_;
+    std::priority_queue<DoseEvent, std::vector<DoseEvent>, LaterDose> events_;
+    size_t active_drugs_ = 0;
+};
+
+} // namespace tumordtwin
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "simulation.pb.h"
+#include "simulation/simulation_engine.h"
+
+namespace tumordtwin {
+
+/**
+ * @brief Idle SimulationEngines kept ready for the next run
+ *
+ * warmUp() builds the engines on a background thread: each one is
+ * initialized and stepped once on a template lattice, which allocates its
+ * fields, uptake buffers and solver scratch, starts the OpenMP thread
+ * pool and, for GPU templates, creates the device context and fields.
+ * acquire() hands out an idle engine rebound to a run's parameters
+ * (SimulationEngine::rebind), preferring one already sized for the run's
+ * lattice, and builds a cold engine only when none is idle. Engines come
+ * back through their Lease and are kept up to capacity(); an idle engine
+ * holds on to the buffers of its last run.
+ */
+class EnginePool {
+public:
+    /**
+     * @brief An engine on loan; returns it to the pool when destroyed
+     */
+    class Lease {
+    public:
+        Lease() = default;
+        Lease(EnginePool* pool, std::unique_ptr<SimulationEngine> engine, bool warm)
+            : pool_(pool), engine_(std::move(engine)), warm_(warm) {}
+        ~Lease();
+
+        Lease(Lease&& other) noexcept = default;
+        Lease& operator=(Lease&& other) noexcept;
+        Lease(const Lease&) = delete;
+        Lease& operator=(const Lease&) = delete;
+
+        SimulationEngine& operator*() const { return *engine_; }
+        SimulationEngine* operator->() const { return engine_.get(); }
+        SimulationEngine* get() const { return engine_.get(); }
+
+        /**
+         * @brief Whether the engine came from the pool rather than a cold start
+         */
+        bool warm() const { return warm_; }
+
+    private:
+        EnginePool* pool_ = nullptr;
+        std::unique_ptr<SimulationEngine> engine_;
+        bool warm_ = false;
+    };
+
+    EnginePool() = default;
+    ~EnginePool();
+
+    EnginePool(const EnginePool&) = delete;
+    EnginePool& operator=(const EnginePool&) = delete;
+
+    /**
+     * @brief Keep up to `engines` idle engines and build them in the background
+     *
+     * Returns at once. Once every engine is idle in the pool, or stop() cut
+     * the warm-up short, `on_ready` is called on the warm-up thread and
+     * ready() turns true after it returns. Until then acquire() may still
+     * start cold. Call at most once; without it the pool keeps nothing and
+     * every run starts cold.
+     *
+     * @param params Lattice, resolution and GPU use of the engines; valid parameters
+     * @param num_threads Threads of each engine (0 = runtime default)
+     */
+    void warmUp(size_t engines, const SimulationParameters& params, int num_threads,
+                std::function<void()> on_ready = nullptr);
+
+    /**
+     * @brief Stop a warm-up in progress and join its thread
+     */
+    void stop();
+
+    /**
+     * @brief Whether no warm-up is pending: none was started, or it finished
+     */
+    bool ready() const { return ready_.load(std::memory_order_acquire); }
+
+    /**
+     * @brief An engine for a run, warm if one is idle
+     *
+     * The engine is bound to `params` but holds no state yet: callers
+     * initialize() it or restore a checkpoint into it, as with a new engine.
+     */
+    Lease acquire(const SimulationParameters& params, int num_threads);
+
+    size_t capacity() const;
+    size_t idle() const;
+
+private:
+    void release(std::unique_ptr<SimulationEngine> engine);
+    void warmLoop(size_t engines, SimulationParameters params, int num_threads,
+                  std::function<void()> on_ready);
+
+    // Whether an idle engine already holds buffers for a run's lattice
+    static bool fits(const SimulationEngine& engine, const SimulationParameters& params);
+
+    mutable std::mutex mutex_;
+    size_t capacity_ = 0;
+    std::vector<std::unique_ptr<SimulationEngine>> idle_;
+
+    std::atomic<bool> ready_{true};
+    std::atomic<bool> stopping_{false};
+    std::thread warm_thread_;
+};
+
+} // namespace tumordtwin
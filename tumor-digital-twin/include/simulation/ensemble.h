@@ -0,0 +1,135 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "service.pb.h"
+#include "data/patient_cache.h"
+#include "simulation/simulation_engine.h"
+#include "simulation/simulation_registry.h"
+
+namespace tumordtwin {
+
+/**
+ * @brief One simulation of an ensemble, with its overrides applied
+ */
+struct EnsembleMemberSpec {
+    std::string name;
+    SimulationParameters params;
+    TreatmentProtocol treatment;
+};
+
+/**
+ * @brief Expansion of an EnsembleRequest into its members
+ *
+ * Every EnsembleMember (or the base request alone, if there are none) is
+ * combined with every point of the parameter grid, the last axis varying
+ * fastest. A member's overrides are applied to the base parameters first
+ * and the grid values after them.
+ *
+ * Parameters are named by their SimulationParameters field (numeric and
+ * bool fields only; integer fields take integral values) or as
+ * "extra_params.<key>".
+ */
+class EnsemblePlan {
+public:
+    static constexpr size_t kMaxMembers = 1024;
+    static constexpr const char* kExtraParamsPrefix = "extra_params.";
+
+    /**
+     * @param members Set to the members in submission order
+     * @param error_msg Output parameter for error message
+     * @return false on unknown parameters, empty axes or too many members
+     */
+    static bool expand(const EnsembleRequest& request, std::vector<EnsembleMemberSpec>* members,
+                       std::string& error_msg);
+
+    /**
+     * @brief Set one named parameter
+     * @return false if the name is unknown or the value does not fit the field
+     */
+    static bool applyOverride(SimulationParameters* params, const std::string& name, double value,
+                              std::string& error_msg);
+};
+
+/**
+ * @brief Initial state shared by ensemble members with the same initialize() inputs
+ *
+ * The first member to run builds the PatientModel (through the
+ * PatientCache) and seeds one base engine; every member then copies its
+ * engine state from that base instead of seeding its own (see
+ * SimulationEngine::initialize(const SimulationEngine&)). Members that are
+ * still queued hold nothing but a reference, and the base is released as
+ * soon as the last member has copied it. A lone member is initialized
+ * directly without a base.
+ *
+ * Thread-safe; members arriving while the base is built wait for it.
+ */
+class SharedInitialState {
+public:
+    /**
+     * @param patient Patient data of the ensemble
+     * @param params Parameters of any member (only their initialStateKey() matters)
+     * @param members Members that will initialize from this state
+     */
+    SharedInitialState(std::shared_ptr<const PatientData> patient,
+                       const SimulationParameters& params, size_t members);
+
+    /**
+     * @brief Initialize a member's engine from the shared state
+     * @param num_threads Threads for building the base (0 = runtime default)
+     * @param error_msg Output parameter for error message
+     * @return false if the patient data cannot be preprocessed
+     */
+    bool initialize(SimulationEngine& engine, PatientCache& cache, int num_threads,
+                    std::string& error_msg);
+
+    /**
+     * @brief Whether a base engine is currently held
+     */
+    bool holdsBase() const;
+
+private:
+    std::shared_ptr<const PatientData> patient_;
+    SimulationParameters params_;
+
+    mutable std::mutex mutex_;
+    size_t remaining_;
+    std::shared_ptr<const SimulationEngine> base_;
+    bool failed_ = false;
+    std::string error_msg_;
+};
+
+/**
+ * @brief Tracked state of an ensemble, aggregated from its member records
+ */
+class EnsembleRecord {
+public:
+    EnsembleRecord(std::string ensemble_id, std::string ensemble_name,
+                   std::vector<std::shared_ptr<SimulationRecord>> members);
+
+    const std::string& ensembleId() const { return ensemble_id_; }
+    const std::string& ensembleName() const { return ensemble_name_; }
+    const std::vector<std::shared_ptr<SimulationRecord>>& members() const { return members_; }
+
+    /**
+     * @brief QUEUED until a member starts, RUNNING until every member has ended,
+     *        then FAILED or STOPPED if any member did, else COMPLETED
+     */
+    SimulationStatus status() const;
+
+    /**
+     * @brief Fill an EnsembleStatusResponse, with metrics over the members that have results
+     */
+    void toStatusResponse(EnsembleStatusResponse* response) const;
+
+private:
+    const std::string ensemble_id_;
+    const std::string ensemble_name_;
+    const std::vector<std::shared_ptr<SimulationRecord>> members_;
+};
+
+} // namespace tumordtwin
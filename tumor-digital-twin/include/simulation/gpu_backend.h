@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+#include "simulation/agent_store.h"
+#include "simulation/diffusion_solver.h"
+#include "simulation/scalar_grid.h"
+#include "utils/aligned_allocator.h"
+
+namespace tumordtwin {
+
+/**
+ * @brief Substance field update of one engine step on a CUDA device
+ *
+ * The oxygen and glucose fields and their uptake buffers stay resident in
+ * device memory for the whole run; the host copies are only refreshed
+ * when the engine hands the fields out (snapshots, checkpoints). Each
+ * step uploads the agent columns the uptake depends on (positions and
+ * states, about 25 bytes per agent), deposits uptake with atomics,
+ * advances both fields with the same explicit 7-point scheme as
+ * DiffusionSolver, and returns the oxygen level at every agent so the
+ * cell-state update can stay on the host next to the population
+ * dynamics, which consume the engine's sequential random stream.
+ *
+ * Results match the CPU path to rounding, not bitwise (the device
+ * contracts multiply-adds differently).
+ *
+ * Built only when CMake finds a CUDA compiler (TUMORDTWIN_HAVE_CUDA);
+ * otherwise isAvailable() is false and create() fails.
+ */
+class GpuBackend {
+public:
+    /**
+     * @brief Whether the build has CUDA support and a device is present
+     */
+    static bool isAvailable();
+
+    /**
+     * @brief Allocate device buffers for a lattice
+     * @param error_msg Output parameter for error message
+     * @return The backend, or nullptr if no device can be used
+     */
+    static std::unique_ptr<GpuBackend> create(int nx, int ny, int nz, double spacing,
+                                              std::string& error_msg);
+
+    ~GpuBackend();
+
+    GpuBackend(const GpuBackend&) = delete;
+    GpuBackend& operator=(const GpuBackend&) = delete;
+
+    /**
+     * @brief Whether the device fields were allocated for this lattice
+     */
+    bool fits(int nx, int ny, int nz, double spacing) const;
+
+    /**
+     * @brief Replace the device fields with host fields of the same shape
+     */
+    void upload(const ScalarGrid& oxygen, const ScalarGrid& glucose);
+
+    /**
+     * @brief Copy the device fields back into host fields of the same shape
+     */
+    void download(ScalarGrid& oxygen, ScalarGrid& glucose);
+
+    /**
+     * @brief Deposit agent uptake and advance both fields by one time step
+     * @param oxygen_uptake_rate, glucose_uptake_rate Uptake per nutrient-consuming agent
+     * @param oxygen_substeps, glucose_substeps Explicit diffusion steps dt is split into
+     * @param outside_value Oxygen reported for agents outside the lattice
+     * @param agent_oxygen Set to the updated oxygen level at each agent
+     */
+    void step(const AgentStore& agents,
+              const DiffusionParams& oxygen, double oxygen_uptake_rate,
+              const DiffusionParams& glucose, double glucose_uptake_rate,
+              double dt, int oxygen_substeps, int glucose_substeps,
+              double outside_value, AlignedVector<double>* agent_oxygen);
+
+    /**
+     * @brief Field means reduced on the device, for metrics without a download
+     */
+    double oxygenMean();
+    double glucoseMean();
+
+private:
+    struct Device;
+
+    explicit GpuBackend(std::unique_ptr<Device> device);
+
+    std::unique_ptr<Device> device_;
+};
+
+} // namespace tumordtwin
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+#include "simulation/brick_grid.h"
+#include "simulation/scalar_grid.h"
+
+namespace tumordtwin {
+
+/**
+ * @brief Coarser copies of a snapshot's fields, built on first use
+ *
+ * Level L holds the mean of every 2^L x 2^L x 2^L block of full-resolution
+ * voxels (blocks at the far edges average the voxels they cover). A level
+ * is built in one pass over the full-resolution field, a z plane at a
+ * time, and then kept, so later previews of the same snapshot never touch
+ * the full-resolution field again.
+ */
+class GridPyramid {
+public:
+    // Beyond this a 1000^3 lattice is a single voxel
+    static constexpr int kMaxLevel = 10;
+
+    /**
+     * @brief Level `level` (1..kMaxLevel) of a field, building it if needed
+     *
+     * Thread-safe; the returned grid lives as long as this pyramid.
+     * @param key Identifies the field among those of the snapshot
+     * @param dense Full-resolution field, or nullptr if `sparse` is given
+     */
+    const ScalarGrid& level(int key, int level, const ScalarGrid* dense,
+                            const BrickGrid* sparse) const;
+
+    /**
+     * @brief Average 2^level blocks of a field into `out`
+     */
+    static void downsample(const ScalarGrid& field, int level, ScalarGrid& out);
+    static void downsample(const BrickGrid& field, int level, ScalarGrid& out);
+
+    /**
+     * @brief Voxels along an axis of `extent` full-resolution voxels at a level
+     */
+    static int levelExtent(int extent, int level) {
+        return (extent + (1 << level) - 1) >> level;
+    }
+
+private:
+    mutable std::mutex mutex_;
+    mutable std::map<std::pair<int, int>, std::unique_ptr<ScalarGrid>> levels_;
+};
+
+} // namespace tumordtwin
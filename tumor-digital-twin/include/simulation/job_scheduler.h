@@ -0,0 +1,152 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "service.pb.h"
+
+namespace tumordtwin {
+
+/**
+ * @brief A simulation accepted by the scheduler
+ *
+ * Holds the request the job was created from, the number of cores it
+ * reserves while running, and the body executed on a worker thread.
+ * The body is expected to poll cancelRequested() between steps.
+ */
+struct SimulationJob {
+    std::string simulation_id;
+    SimulationRequest request;  // Without patient data, which is shared through `patient`
+    std::shared_ptr<const PatientData> patient;  // Null for jobs resumed from a checkpoint
+    unsigned num_threads = 1;
+    double cost = 0.0;      // JobScheduler::estimateCost of the request
+    bool movable = false;   // May be handed to another node while queued
+    std::function<void(SimulationJob&)> run;
+    std::atomic<bool> cancel_requested{false};
+
+    bool cancelRequested() const { return cancel_requested.load(std::memory_order_relaxed); }
+};
+
+/**
+ * @brief In-process scheduler for simulation jobs
+ *
+ * Accepted jobs wait in a bounded FIFO queue and are dispatched to a pool
+ * of worker threads. Every job reserves num_threads cores out of a fixed
+ * core budget (the host core count by default), so the sum of threads used
+ * by running jobs never exceeds the budget. Submissions beyond the queue
+ * capacity are refused instead of accumulating.
+ */
+class JobScheduler {
+public:
+    static constexpr size_t kDefaultMaxQueueDepth = 256;
+
+    /**
+     * @brief Construct a scheduler and start its worker pool
+     * @param max_queue_depth Maximum number of jobs waiting to run
+     * @param core_budget Total cores shared by running jobs (0 = host core count)
+     */
+    explicit JobScheduler(size_t max_queue_depth = kDefaultMaxQueueDepth,
+                          unsigned core_budget = 0);
+
+    ~JobScheduler();
+
+    JobScheduler(const JobScheduler&) = delete;
+    JobScheduler& operator=(const JobScheduler&) = delete;
+
+    /**
+     * @brief Queue a job for execution
+     *
+     * The job's num_threads is clamped to [1, coreBudget()].
+     *
+     * @return false if the queue is full or the scheduler is shutting down
+     */
+    bool submit(std::shared_ptr<SimulationJob> job);
+
+    /**
+     * @brief Queue several jobs together, in order
+     *
+     * Either every job is queued or none is, so a batch never runs partially.
+     *
+     * @return false if the queue cannot take all of them or the scheduler is shutting down
+     */
+    bool submitBatch(const std::vector<std::shared_ptr<SimulationJob>>& jobs);
+
+    /**
+     * @brief Cancel a job
+     *
+     * A queued job is removed from the queue; a running job has its
+     * cancellation flag raised and stops at its next step boundary.
+     *
+     * @return true if a queued or running job with this ID was found
+     */
+    bool cancel(const std::string& simulation_id);
+
+    /**
+     * @brief Remove up to max_jobs movable jobs from the back of the queue
+     *
+     * The jobs are handed to the caller to run elsewhere; they are not
+     * cancelled. The back of the queue is taken so the jobs that have waited
+     * longest keep their place.
+     *
+     * @return The removed jobs, latest first
+     */
+    std::vector<std::shared_ptr<SimulationJob>> takeQueued(size_t max_jobs);
+
+    /**
+     * @brief Put jobs from takeQueued() back at the end of the queue
+     *
+     * They were accepted before, so they return in their original order
+     * even if the queue is full by now. Cancelled jobs are dropped.
+     */
+    void restore(const std::vector<std::shared_ptr<SimulationJob>>& jobs);
+
+    /**
+     * @brief Stop accepting jobs, cancel everything and join the workers
+     */
+    void shutdown();
+
+    /**
+     * @brief Resolve a requested thread count against the core budget
+     * @param requested Value of SimulationParameters.num_threads (0 = default)
+     */
+    unsigned resolveThreadCount(int requested) const;
+
+    /**
+     * @brief Relative cost of a run: grid cells times steps
+     */
+    static double estimateCost(const SimulationParameters& params);
+
+    size_t queueDepth() const;
+    size_t runningJobs() const;
+    unsigned coresInUse() const;
+    double queuedCost() const;
+    double outstandingCost() const;  // Queued and running jobs
+    size_t maxQueueDepth() const { return max_queue_depth_; }
+    unsigned coreBudget() const { return core_budget_; }
+
+private:
+    void workerLoop();
+    bool canDispatchLocked() const;
+
+    const size_t max_queue_depth_;
+    const unsigned core_budget_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<std::shared_ptr<SimulationJob>> queue_;
+    std::vector<std::shared_ptr<SimulationJob>> running_;
+    unsigned cores_in_use_ = 0;
+    bool stopping_ = false;
+
+    std::vector<std::thread> workers_;
+};
+
+} // namespace tumordtwin
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "simulation.pb.h"
+#include "utils/aligned_allocator.h"
+
+namespace tumordtwin {
+
+/**
+ * @brief Dense 3D scalar field on the simulation voxel lattice
+ *
+ * Values are stored in the same flat layout as GridData.values: x is the
+ * fastest varying index, then y, then z.
+ */
+class ScalarGrid {
+public:
+    ScalarGrid() = default;
+    ScalarGrid(int nx, int ny, int nz, double spacing, double initial_value = 0.0);
+
+    void resize(int nx, int ny, int nz, double spacing, double initial_value = 0.0);
+    void fill(double value);
+
+    int nx() const { return nx_; }
+    int ny() const { return ny_; }
+    int nz() const { return nz_; }
+    double spacing() const { return spacing_; }
+    size_t size() const { return values_.size(); }
+
+    size_t index(int i, int j, int k) const {
+        return (static_cast<size_t>(k) * ny_ + j) * nx_ + i;
+    }
+
+    double& at(int i, int j, int k) { return values_[index(i, j, k)]; }
+    double at(int i, int j, int k) const { return values_[index(i, j, k)]; }
+
+    double* data() { return values_.data(); }
+    const double* data() const { return values_.data(); }
+
+    double mean() const;
+
+    /**
+     * @brief Swap contents with another grid of any shape
+     */
+    void swap(ScalarGrid& other) noexcept;
+
+    /**
+     * @brief Export into a GridData message (raw little-endian doubles)
+     */
+    void toProto(GridData* grid, SubstanceType substance) const;
+
+    /**
+     * @brief Fill everything in a GridData message except the values
+     */
+    void toProtoHeader(GridData* grid, SubstanceType substance) const;
+
+    /**
+     * @brief Load from an uncompressed GridData message
+     * @return false if the metadata and value buffer disagree
+     */
+    bool fromProto(const GridData& grid);
+
+private:
+    int nx_ = 0;
+    int ny_ = 0;
+    int nz_ = 0;
+    double spacing_ = 1.0;
+    AlignedVector<double> values_;
+};
+
+} // namespace tumordtwin
@@ -0,0 +1,404 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "simulation.pb.h"
+#include "data/patient_model.h"
+#include "simulation/agent_store.h"
+#include "simulation/brick_grid.h"
+#include "simulation/diffusion_solver.h"
+#include "simulation/domain_decomposition.h"
+#include "simulation/drug_transport.h"
+#include "simulation/gpu_backend.h"
+#include "simulation/scalar_grid.h"
+#include "simulation/simulation_snapshot.h"
+#include "simulation/spatial_index.h"
+#include "evolution/genotype_table.h"
+#include "utils/profiler.h"
+
+namespace tumordtwin {
+
+/**
+ * @brief Per-simulation model state and time stepping
+ *
+ * Owns the substance fields, the cell population and the solvers for a
+ * single simulation run. One step() advances the model by
+ * SimulationParameters.time_step: cellular uptake is deposited onto the
+ * lattice, oxygen and glucose are diffused (sub-cycled with the uptake
+ * held fixed whenever time_step exceeds the explicit stability limit, see
+ * DiffusionSolver::subSteps), the cells react to their
+ * local environment, and division, death, immune killing and migration
+ * are resolved through a SpatialIndex over the voxel lattice.
+ *
+ * Model constants that are not part of SimulationParameters are read from
+ * SimulationParameters.extra_params (see the kParam* keys below).
+ *
+ * With SimulationParameters.use_gpu set and a CUDA device present, uptake
+ * and diffusion run on a GpuBackend that keeps the fields on the device;
+ * the field accessors copy them back on demand. Without a device the
+ * engine silently runs on the CPU (see usingGpu()).
+ *
+ * Large domains keep the fields in BrickGrids instead (kParamSparseGrid),
+ * so a small tumor pays only for the bricks its gradients reach. The
+ * dense accessors then expand the fields on demand, and snapshots carry
+ * the sparse copies. The sparse path always runs on the CPU.
+ *
+ * Drugs of the TreatmentProtocol given to setTreatment() are dosed and
+ * transported by a DrugTransport after the nutrients; while a drug field
+ * is active, cytostatic drugs slow the cycle progression and cytotoxic
+ * drugs raise the death rate of the cancer cells in each voxel. Between
+ * doses no drug field exists and a step pays nothing for the treatment.
+ *
+ * Every step() times its phases in a StepProfiler, summarized by
+ * computeMetrics() as "profile.<phase>_ms" extra metrics.
+ *
+ * Dividing cancer cells mutate with probability mutation_rate; the
+ * daughter then founds a new clone forked from its parent's in the
+ * GenotypeTable. Cancer cells per clone are counted as cells divide and
+ * are cleared, so SimulationMetrics.subclones never rescans the
+ * population. Mutable access to the agents recounts them at the next
+ * computeMetrics().
+ *
+ * An engine given a SlabTransport by attachDomain() is one rank of a
+ * slab-decomposed run (see SlabDomain): it holds the dense fields of its
+ * own z planes and the agents inside them, diffuses with halo exchange
+ * and hands agents that left its slab to their new rank after every
+ * step. Cells only see the neighbors on their own rank for contact
+ * inhibition and T cell killing. Rank 0 is driven like any engine, and
+ * each of its initialize(), step() and snapshot() calls is mirrored by
+ * the other ranks in followRank0(). Decomposed runs have no drugs and
+ * always run on the CPU.
+ */
+class SimulationEngine {
+public:
+    static constexpr const char* kParamInitialTumorCells = "initial_tumor_cells";
+    static constexpr const char* kParamRandomSeed = "random_seed";
+    static constexpr const char* kParamOxygenUptake = "oxygen_uptake_rate";
+    static constexpr const char* kParamGlucoseUptake = "glucose_uptake_rate";
+    static constexpr const char* kParamHypoxiaThreshold = "hypoxia_threshold";
+    static constexpr const char* kParamNecrosisThreshold = "necrosis_threshold";
+    static constexpr const char* kParamMaxCellsPerVoxel = "max_cells_per_voxel";
+    static constexpr const char* kParamInitialTCells = "initial_t_cells";
+    static constexpr const char* kParamTCellKillRate = "t_cell_kill_rate";
+    // 1 = sparse fields, 0 = dense; unset = sparse from kAutoSparseVoxels voxels
+    static constexpr const char* kParamSparseGrid = "sparse_grid";
+    // Largest spread of a brick that is still stored as one value
+    static constexpr const char* kParamSparseTolerance = "sparse_tolerance";
+    // Lower bound on the diffusion sub-steps per step (default 1; more are added for stability)
+    static constexpr const char* kParamMinDiffusionSubSteps = "min_diffusion_substeps";
+    // Concentration below which a drug field is released (default 1e-6)
+    static constexpr const char* kParamDrugNegligible = "drug_negligible_concentration";
+
+    // 2^27 voxels, 1 GB per dense field
+    static constexpr int64_t kAutoSparseVoxels = int64_t{1} << 27;
+    // 2^28 voxels, the largest lattice (or slab of a decomposed run) one process holds
+    static constexpr int64_t kMaxVoxelsPerProcess = int64_t{1} << 28;
+
+    /**
+     * @brief Construct an engine for one simulation
+     * @param params Validated simulation parameters
+     * @param num_threads Threads the engine may use (0 = runtime default)
+     */
+    explicit SimulationEngine(const SimulationParameters& params, int num_threads = 0);
+
+    /**
+     * @brief Bind this engine to another run, keeping its allocations
+     *
+     * The fields, uptake buffers, solver scratch and agent columns keep
+     * their capacity, and a GPU backend is kept for a run on the same
+     * lattice (see EnginePool). The treatment and the profiler are reset;
+     * the run then starts with initialize() or a restore like a new engine.
+     */
+    void rebind(const SimulationParameters& params, int num_threads = 0);
+
+    /**
+     * @brief Run this engine as one rank of a slab-decomposed simulation
+     *
+     * Called once, before initialize(); the engine cannot be rebound or
+     * resumed afterwards. Every rank's engine must have the same parameters.
+     *
+     * @param transport Connection to the other ranks; must outlive the engine
+     */
+    void attachDomain(SlabTransport& transport);
+
+    /**
+     * @brief This rank's slab, or nullptr for a run in one engine
+     */
+    const SlabDomain* domain() const { return domain_.get(); }
+
+    /**
+     * @brief Mirror rank 0's initialize(), step() and snapshot() calls until releaseRanks()
+     *
+     * Run by every rank but rank 0, in place of driving the engine.
+     */
+    void followRank0();
+
+    /**
+     * @brief End followRank0() on the other ranks; called by rank 0 once the run is over
+     */
+    void releaseRanks();
+
+    /**
+     * @brief Set the treatment of this run, before initialize() or resume()
+     * @param protocol Protocol accepted by DrugTransport::validate()
+     */
+    void setTreatment(const TreatmentProtocol& protocol);
+    const TreatmentProtocol& treatment() const { return treatment_; }
+
+    /**
+     * @brief Allocate the fields and seed the initial tumor
+     *
+     * In a decomposed run rank 0 seeds every cell and hands them to the
+     * ranks owning them, so the tumor is the one a single engine seeds.
+     */
+    void initialize();
+
+    /**
+     * @brief Allocate the fields and seed the tumor of a patient
+     *
+     * The cancer cells fill the patient's segmented geometry, scaled to
+     * the seeded cell count and centered in the domain (a sphere when the
+     * geometry is empty), and are drawn from its founding clones, whose
+     * genotypes start the GenotypeTable. An empty model seeds exactly
+     * like initialize().
+     */
+    void initialize(const PatientModel& patient);
+
+    /**
+     * @brief Start from the state another engine was initialized to
+     *
+     * Copies the fields, agents, genotypes and random stream of `initial`,
+     * so the run continues exactly as if this engine had been initialized
+     * itself. Both engines must have the same initialStateKey(); the other
+     * parameters (rates, time step, step count, GPU use) are this engine's.
+     */
+    void initialize(const SimulationEngine& initial);
+
+    /**
+     * @brief The parameters initialize() reads
+     *
+     * Engines initialized from the same patient with equal keys start from
+     * identical state, so parameter sweeps seed the tumor once per key.
+     */
+    static std::string initialStateKey(const SimulationParameters& params);
+
+    /**
+     * @brief Continue from externally loaded state instead of initialize()
+     *
+     * The fields, agents, genotype table and drug state must already have
+     * been filled through the mutable accessors, after setTreatment() (see
+     * CheckpointReader::restore).
+     *
+     * @param step Step the loaded state belongs to
+     * @param rng_state Random engine state from rngState()
+     * @param error_msg Output parameter for error message
+     * @return false if the loaded state does not match the parameters
+     */
+    bool resume(int32_t step, const std::string& rng_state, std::string& error_msg);
+
+    /**
+     * @brief Advance the model by one time step
+     */
+    void step();
+
+    /**
+     * @brief Serialized random engine state, so a resumed run continues the same stream
+     */
+    std::string rngState() const;
+
+    int32_t currentStep() const { return current_step_; }
+    double currentTime() const { return current_step_ * params_.time_step(); }
+    const SimulationParameters& parameters() const { return params_; }
+
+    // On the GPU and sparse paths these expand the resident fields first;
+    // mutable access also reloads them from the dense copy at the next step().
+    // In a decomposed run they are this rank's planes (see SlabDomain::allocate).
+    ScalarGrid& oxygen();
+    ScalarGrid& glucose();
+    const ScalarGrid& oxygen() const;
+    const ScalarGrid& glucose() const;
+
+    /**
+     * @brief Whether fields are advanced on a GPU for this run
+     */
+    bool usingGpu() const { return gpu_ != nullptr; }
+
+    /**
+     * @brief Whether fields are stored as BrickGrids for this run
+     */
+    bool usingSparseGrid() const { return sparse_; }
+
+    /**
+     * @brief Diffusion sub-steps of oxygen and glucose in the last step()
+     */
+    int oxygenSubSteps() const { return oxygen_substeps_; }
+    int glucoseSubSteps() const { return glucose_substeps_; }
+
+    /**
+     * @brief Drug state; mutable access is for loading it before resume()
+     */
+    DrugTransport& drugs() { return drugs_; }
+    const DrugTransport& drugs() const { return drugs_; }
+
+    /**
+     * @brief Phase timings of this engine; callers may time their own work on it
+     *        (e.g. ProfilePhase::Checkpoint)
+     */
+    StepProfiler& profiler() { return profiler_; }
+    const StepProfiler& profiler() const { return profiler_; }
+
+    AgentStore& agents() {
+        clone_counts_current_ = false;
+        return agents_;
+    }
+    const AgentStore& agents() const { return agents_; }
+    GenotypeTable& genotypes() { return genotypes_; }
+    const GenotypeTable& genotypes() const { return genotypes_; }
+    const SpatialIndex& spatialIndex() const { return index_; }
+
+    /**
+     * @brief Cancer cells per clone, indexed by GenotypeId (one entry per genotype)
+     */
+    const std::vector<int64_t>& cloneCounts() const;
+
+    /**
+     * @brief Fill SimulationMetrics for the current step
+     *
+     * A decomposed run reduces its metrics over all ranks at the end of
+     * every step, so this is not a collective call: every rank reports the
+     * totals and averages of the whole run, and rank 0 also its subclones.
+     */
+    void computeMetrics(SimulationMetrics* metrics) const;
+
+    /**
+     * @brief Copy the current model state for readers outside the worker
+     *
+     * In a decomposed run rank 0 gathers the fields and agents of every
+     * rank (see followRank0()); the other ranks return nullptr. Fields of
+     * lattices from kAutoSparseVoxels voxels arrive as BrickGrids.
+     */
+    std::shared_ptr<const SimulationSnapshot> snapshot() const;
+
+    /**
+     * @brief Voxel index containing a position, or -1 when outside the domain
+     */
+    int64_t voxelIndex(double x, double y, double z) const;
+
+    /**
+     * @brief Voxel coordinates containing a position
+     * @return false when outside the domain
+     */
+    bool voxelCoords(double x, double y, double z, int* i, int* j, int* k) const;
+
+private:
+    // Calls of rank 0 that the other ranks of a decomposed run mirror
+    enum class RankCommand : char { Initialize, Step, Snapshot, Release };
+
+    double extraParam(const char* key, double default_value) const;
+
+    // Tell the other ranks what rank 0 does next; no-op elsewhere and without a domain
+    void leadRanks(RankCommand command) const;
+    // Hand out the cells seeded by rank 0 and give each rank its own ID range and stream
+    void distributeSeededAgents();
+    // Metrics of the whole decomposed run, after every step
+    void reduceMetrics();
+    std::shared_ptr<const SimulationSnapshot> gatherSnapshot() const;
+    // Index of a position in the dense fields (this rank's planes), or -1 outside them
+    int64_t fieldIndex(double x, double y, double z) const;
+
+    // Choose dense, sparse or GPU field storage for this run
+    void initFieldStorage();
+    void syncHostFields() const;
+    int minSubSteps() const;
+    // Uptake and oxygen/glucose diffusion of one step
+    void stepNutrients(double dt);
+    void stepSparse(const DiffusionParams& oxygen_params,
+                    const DiffusionParams& glucose_params, double dt);
+    // Sub-steps for both fields given the largest per-voxel uptake rates
+    void planSubSteps(const DiffusionParams& oxygen_params, double max_oxygen_uptake,
+                      const DiffusionParams& glucose_params, double max_glucose_uptake,
+                      double dt);
+    // Upper bound on nutrient-consuming cells sharing a voxel
+    size_t maxConsumersPerVoxel() const;
+
+    void seedTumor(const PatientModel& patient);
+    // Cell positions inside the patient geometry; false if none fit the domain
+    bool seedGeometry(const TumorGeometry& geometry, size_t count);
+    void seedImmuneCells();
+    void depositUptake();
+    void updateAgents();
+
+    // Where agent kernels read the oxygen field; fixed for a step
+    enum class FieldStorage { Dense, Sparse, Resident };
+
+    // Per-type kernels run over their AgentStore bucket, specialized on what
+    // is fixed for the step so the per-agent loop carries no dispatch
+    template <FieldStorage kStorage, bool kDrugs>
+    void updateCancerCells();
+    template <bool kDrugs>
+    void applyCancerDeath();
+    void applyTCellKilling();
+
+    // Population dynamics, all O(N) through the spatial index
+    void applyLifecycle();
+    void clearDeadCells();
+    void applyDeathAndKilling();
+    void applyDivision();
+    void applyMigration();
+    void clampToDomain(double& x, double& y, double& z) const;
+
+    // Incremental clone bookkeeping for SimulationMetrics.subclones
+    void countClones() const;
+    void addToClone(GenotypeTable::GenotypeId genotype, int64_t cells);
+
+    SimulationParameters params_;
+    int num_threads_;
+    int32_t current_step_ = 0;
+
+    // Mutable so const accessors can refresh them from the resident copy
+    mutable ScalarGrid oxygen_;
+    mutable ScalarGrid glucose_;
+    ScalarGrid oxygen_uptake_;
+    ScalarGrid glucose_uptake_;
+    DiffusionSolver solver_;
+    int oxygen_substeps_ = 1;
+    int glucose_substeps_ = 1;
+
+    // Resident fields of the sparse path
+    bool sparse_ = false;
+    double sparse_tolerance_ = 0.0;
+    BrickGrid sparse_oxygen_;
+    BrickGrid sparse_glucose_;
+    BrickGrid sparse_oxygen_uptake_;
+    BrickGrid sparse_glucose_uptake_;
+
+    // Drug fields follow the sparse_ storage and always run on the CPU
+    TreatmentProtocol treatment_;
+    DrugTransport drugs_;
+
+    std::unique_ptr<GpuBackend> gpu_;
+    AlignedVector<double> agent_oxygen_;  // Oxygen at each agent after a GPU step
+
+    // Which copy is up to date while the fields live on the GPU or in bricks
+    mutable bool host_fields_current_ = true;
+    bool resident_fields_current_ = false;
+
+    AgentStore agents_;
+    GenotypeTable genotypes_;
+    mutable std::vector<int64_t> clone_counts_;
+    mutable bool clone_counts_current_ = false;
+    SpatialIndex index_;
+    std::mt19937_64 rng_;
+
+    StepProfiler profiler_;
+
+    // Set by attachDomain(); metrics of the whole run, reduced after every step
+    std::unique_ptr<SlabDomain> domain_;
+    SimulationMetrics run_metrics_;
+};
+
+} // namespace tumordtwin
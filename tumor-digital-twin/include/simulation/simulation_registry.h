@@ -0,0 +1,364 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "service.pb.h"
+
+namespace tumordtwin {
+
+struct SimulationSnapshot;
+class StepHistory;
+
+/**
+ * @brief Tracked state of a single simulation
+ *
+ * Identity fields are immutable after construction. Progress is kept in
+ * atomics so that worker threads publish it without taking any lock and
+ * status readers never block on a running simulation.
+ */
+class SimulationRecord {
+public:
+    SimulationRecord(std::string simulation_id,
+                     std::string patient_id,
+                     std::string simulation_name,
+                     int32_t total_steps,
+                     int64_t created_at);
+
+    const std::string& simulationId() const { return simulation_id_; }
+    const std::string& patientId() const { return patient_id_; }
+    const std::string& simulationName() const { return simulation_name_; }
+    int32_t totalSteps() const { return total_steps_; }
+    int64_t createdAt() const { return created_at_; }
+
+    SimulationStatus status() const {
+        return static_cast<SimulationStatus>(status_.load(std::memory_order_acquire));
+    }
+    int32_t currentStep() const { return current_step_.load(std::memory_order_relaxed); }
+    int64_t updatedAt() const { return updated_at_.load(std::memory_order_relaxed); }
+    double progressPercentage() const;
+
+    /**
+     * @brief Estimate the remaining wall time from the observed step rate
+     * @return Seconds remaining, or -1 if no estimate is available yet
+     */
+    int64_t estimatedTimeRemaining() const;
+
+    std::string message() const;
+
+    /**
+     * @brief Publish progress from the worker running this simulation
+     */
+    void setProgress(int32_t current_step);
+
+    /**
+     * @brief Publish the latest metrics from the worker running this simulation
+     */
+    void setMetrics(const SimulationMetrics& metrics);
+
+    /**
+     * @brief Publish the model state that results are served from
+     */
+    void setSnapshot(std::shared_ptr<const SimulationSnapshot> snapshot);
+
+    /**
+     * @brief Latest published model state, or nullptr if none is held in memory
+     */
+    std::shared_ptr<const SimulationSnapshot> snapshot() const;
+
+    /**
+     * @brief Drop the published model state once the history has stored it
+     *
+     * Results are loaded from the history at resultsStep() from then on, so
+     * a finished simulation holds no grids or agents in memory.
+     */
+    void releaseSnapshot();
+
+    /**
+     * @brief Step of the last published model state, or -1 if none was published
+     */
+    int32_t resultsStep() const { return results_step_.load(std::memory_order_acquire); }
+
+    /**
+     * @brief Metrics of the last published model state
+     * @return false if none was published
+     */
+    bool resultMetrics(SimulationMetrics* metrics) const;
+
+    /**
+     * @brief Attach the on-disk history the worker records every step to
+     */
+    void setHistory(std::shared_ptr<const StepHistory> history);
+
+    /**
+     * @brief History of past steps, or nullptr before the simulation has started
+     */
+    std::shared_ptr<const StepHistory> history() const;
+
+    /**
+     * @brief Ask the worker to write a checkpoint when it stops this simulation
+     */
+    void requestCheckpoint() { checkpoint_requested_.store(true, std::memory_order_relaxed); }
+    bool checkpointRequested() const {
+        return checkpoint_requested_.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Counter bumped on every progress, metrics or status change
+     */
+    uint64_t version() const { return version_.load(std::memory_order_acquire); }
+
+    /**
+     * @brief Block until version() differs from `seen` or the timeout expires
+     * @return true if the record changed
+     */
+    bool waitForChange(uint64_t seen, std::chrono::milliseconds timeout) const;
+
+    /**
+     * @brief Register a client streaming updates of this record
+     *
+     * Changes only wake waiters while at least one watcher is registered,
+     * so unwatched simulations publish progress without taking any lock.
+     */
+    void addWatcher() { watchers_.fetch_add(1, std::memory_order_acq_rel); }
+    void removeWatcher() { watchers_.fetch_sub(1, std::memory_order_acq_rel); }
+    bool hasWatchers() const { return watchers_.load(std::memory_order_acquire) > 0; }
+
+    /**
+     * @brief Fill a StatusResponse from the current record state
+     */
+    void toStatusResponse(StatusResponse* response) const;
+
+    /**
+     * @brief Fill a SimulationSummary from the current record state
+     */
+    void toSummary(SimulationSummary* summary) const;
+
+    /**
+     * @brief Check whether the simulation reached a final state
+     */
+    bool isTerminal() const;
+
+private:
+    friend class SimulationRegistry;
+
+    // Status changes go through the registry so indexes stay consistent
+    void setStatus(SimulationStatus status, const std::string& message);
+
+    // Bump the version and wake watchers
+    void notifyChange();
+
+    const std::string simulation_id_;
+    const std::string patient_id_;
+    const std::string simulation_name_;
+    const int32_t total_steps_;
+    const int64_t created_at_;
+    uint64_t sequence_ = 0;  // Insertion order, assigned by the registry
+
+    std::atomic<int> status_{SimulationStatus::QUEUED};
+    std::atomic<int32_t> current_step_{0};
+    std::atomic<int64_t> updated_at_;
+    std::atomic<int64_t> started_at_ms_{0};
+    std::atomic<bool> checkpoint_requested_{false};
+    std::atomic<int32_t> results_step_{-1};
+
+    mutable std::mutex message_mutex_;
+    std::string message_;
+
+    mutable std::mutex metrics_mutex_;
+    SimulationMetrics metrics_;
+    bool has_metrics_ = false;
+
+    std::atomic<uint64_t> version_{0};
+    std::atomic<int> watchers_{0};
+    mutable std::mutex watch_mutex_;
+    mutable std::condition_variable watch_cv_;
+
+    mutable std::mutex snapshot_mutex_;
+    std::shared_ptr<const SimulationSnapshot> snapshot_;
+    std::shared_ptr<const StepHistory> history_;
+};
+
+/**
+ * @brief Concurrent registry of all simulations known to the service
+ *
+ * Lookups by simulation ID go through a fixed number of independently
+ * locked shards. Secondary indexes on patient ID and status, ordered by
+ * creation, serve ListSimulations filters and pagination without scanning
+ * unrelated records. Progress updates bypass the registry entirely (see
+ * SimulationRecord::setProgress); only status transitions touch the indexes.
+ * Finished simulations are kept up to the bounds set by setRetention().
+ */
+class SimulationRegistry {
+public:
+    static constexpr size_t kNumShards = 16;
+
+    // Finished simulations kept unless setRetention() says otherwise
+    static constexpr size_t kDefaultMaxFinished = 10000;
+    static constexpr std::chrono::seconds kDefaultFinishedTtl{7 * 24 * 3600};
+
+    /**
+     * @brief Bound the finished (completed, failed or stopped) simulations kept
+     *
+     * The earliest finished are erased once more than `max_finished` have
+     * finished, or once they finished more than `ttl` ago (0 = no limit).
+     * Checked whenever a simulation is inserted or finishes.
+     */
+    void setRetention(size_t max_finished, std::chrono::seconds ttl);
+
+    /**
+     * @brief Register a new simulation
+     * @return false if the ID is already registered
+     */
+    bool insert(const std::shared_ptr<SimulationRecord>& record);
+
+    /**
+     * @brief Remove a simulation (e.g. when it could not be scheduled)
+     */
+    void erase(const std::string& simulation_id);
+
+    /**
+     * @brief Find a simulation by ID
+     * @return The record, or nullptr if unknown
+     */
+    std::shared_ptr<SimulationRecord> find(const std::string& simulation_id) const;
+
+    /**
+     * @brief Transition a simulation to a new status
+     *
+     * Transitions out of a terminal status are ignored.
+     *
+     * @return true if the status was changed
+     */
+    bool updateStatus(SimulationRecord& record, SimulationStatus status,
+                      const std::string& message);
+
+    /**
+     * @brief Query simulations in creation order
+     * @param patient_id Patient filter, empty for all
+     * @param status Status filter, SIMULATION_STATUS_UNSPECIFIED for all
+     * @param offset Number of matches to skip
+     * @param limit Maximum number of records to return
+     * @param total_count Set to the number of matches before pagination
+     */
+    std::vector<std::shared_ptr<SimulationRecord>> list(
+        const std::string& patient_id,
+        SimulationStatus status,
+        size_t offset,
+        size_t limit,
+        size_t& total_count) const;
+
+    size_t size() const;
+
+private:
+    /**
+     * Records ordered by insertion sequence in a treap that counts its
+     * subtrees, so a page at any offset is found in O(log n) rather than
+     * by walking past everything before it.
+     */
+    class OrderedIndex {
+    public:
+        void insert(uint64_t sequence, std::shared_ptr<SimulationRecord> record);
+        // Returns the removed record, or nullptr if the sequence is not indexed
+        std::shared_ptr<SimulationRecord> erase(uint64_t sequence);
+        size_t size() const { return root_ ? root_->size : 0; }
+        bool empty() const { return !root_; }
+
+        // Visit records in sequence order from the offset-th one on, while `visit` returns true
+        template <typename Visit>
+        void forEachFrom(size_t offset, Visit&& visit) const {
+            walk(root_.get(), offset, visit);
+        }
+
+    private:
+        struct Node {
+            uint64_t sequence;
+            uint64_t priority;
+            size_t size = 1;
+            std::shared_ptr<SimulationRecord> record;
+            std::unique_ptr<Node> left;
+            std::unique_ptr<Node> right;
+        };
+        using NodePtr = std::unique_ptr<Node>;
+
+        static size_t sizeOf(const NodePtr& node) { return node ? node->size : 0; }
+        static void update(Node& node) {
+            node.size = 1 + sizeOf(node.left) + sizeOf(node.right);
+        }
+        // Entries below `sequence` go to `less`, the rest to `rest`
+        static void split(NodePtr node, uint64_t sequence, NodePtr& less, NodePtr& rest);
+        static NodePtr merge(NodePtr left, NodePtr right);
+
+        template <typename Visit>
+        static bool walk(const Node* node, size_t skip, Visit& visit) {
+            while (node) {
+                const size_t left = sizeOf(node->left);
+                if (skip < left) {
+                    if (!walk(node->left.get(), skip, visit)) {
+                        return false;
+                    }
+                    skip = 0;
+                } else {
+                    skip -= left;
+                }
+                if (skip == 0) {
+                    if (!visit(node->record)) {
+                        return false;
+                    }
+                } else {
+                    --skip;
+                }
+                node = node->right.get();
+            }
+            return true;
+        }
+
+        NodePtr root_;
+    };
+
+    struct Shard {
+        mutable std::shared_mutex mutex;
+        std::unordered_map<std::string, std::shared_ptr<SimulationRecord>> records;
+    };
+
+    struct Finished {
+        std::chrono::steady_clock::time_point at;
+        uint64_t sequence;
+    };
+
+    static constexpr size_t kNumStatuses = SimulationStatus_ARRAYSIZE;
+
+    Shard& shardFor(const std::string& simulation_id);
+    const Shard& shardFor(const std::string& simulation_id) const;
+
+    // Remove a record from the secondary indexes; index lock held
+    void unindex(const SimulationRecord& record);
+    // Erase finished records past the retention bounds; index lock held
+    void evictFinished(std::chrono::steady_clock::time_point now);
+
+    std::array<Shard, kNumShards> shards_;
+
+    // Secondary indexes, keyed by insertion sequence
+    mutable std::shared_mutex index_mutex_;
+    uint64_t next_sequence_ = 0;
+    OrderedIndex all_;
+    std::unordered_map<std::string, OrderedIndex> by_patient_;
+    std::array<OrderedIndex, kNumStatuses> by_status_;
+
+    // Records in the order they finished, for retention
+    size_t max_finished_ = kDefaultMaxFinished;
+    std::chrono::seconds finished_ttl_ = kDefaultFinishedTtl;
+    std::deque<Finished> finished_;
+};
+
+} // namespace tumordtwin
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstdint>
+
+#include "simulation.pb.h"
+#include "simulation/agent_store.h"
+#include "simulation/brick_grid.h"
+#include "simulation/grid_pyramid.h"
+#include "simulation/scalar_grid.h"
+#include "evolution/genotype_table.h"
+
+namespace tumordtwin {
+
+/**
+ * @brief Immutable copy of the model state at one step
+ *
+ * Taken by the worker running a simulation (see SimulationEngine::snapshot)
+ * and shared read-only with result readers, so streaming results never
+ * touches the live engine.
+ */
+struct SimulationSnapshot {
+    int32_t step = 0;
+    double time = 0.0;
+    SimulationParameters parameters;
+    SimulationMetrics metrics;
+
+    ScalarGrid oxygen;
+    ScalarGrid glucose;
+    // Sum of the drug fields; empty while no drug is active
+    ScalarGrid drug;
+
+    // Set instead of the dense grids when the engine stores fields sparsely
+    BrickGrid sparse_oxygen;
+    BrickGrid sparse_glucose;
+    BrickGrid sparse_drug;
+
+    AgentStore agents;
+    GenotypeTable genotypes;
+
+    // Coarse levels of the fields above, filled in as results requests ask for them
+    GridPyramid pyramid;
+
+    /**
+     * @brief Dense field of a substance, or nullptr if the model does not track it
+     *        or the snapshot holds it as a sparseGrid()
+     */
+    const ScalarGrid* grid(SubstanceType substance) const {
+        if (sparseGrid(substance)) {
+            return nullptr;
+        }
+        switch (substance) {
+            case SubstanceType::OXYGEN:
+                return &oxygen;
+            case SubstanceType::GLUCOSE:
+                return &glucose;
+            case SubstanceType::DRUG:
+                return drug.size() > 0 ? &drug : nullptr;
+            default:
+                return nullptr;
+        }
+    }
+
+    /**
+     * @brief Sparse field of a substance, or nullptr if it is stored densely or not tracked
+     */
+    const BrickGrid* sparseGrid(SubstanceType substance) const {
+        const BrickGrid* field = nullptr;
+        switch (substance) {
+            case SubstanceType::OXYGEN:
+                field = &sparse_oxygen;
+                break;
+            case SubstanceType::GLUCOSE:
+                field = &sparse_glucose;
+                break;
+            case SubstanceType::DRUG:
+                field = &sparse_drug;
+                break;
+            default:
+                break;
+        }
+        return field && field->size() > 0 ? field : nullptr;
+    }
+
+    /**
+     * @brief Field of a substance at a pyramid level (0 = full resolution, dense only)
+     * @return nullptr if the model does not track the substance
+     */
+    const ScalarGrid* levelGrid(SubstanceType substance, int level) const {
+        const ScalarGrid* dense = grid(substance);
+        const BrickGrid* sparse = sparseGrid(substance);
+        if (level == 0 || (!dense && !sparse)) {
+            return dense;
+        }
+        return &pyramid.level(static_cast<int>(substance), level, dense, sparse);
+    }
+};
+
+} // namespace tumordtwin
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "simulation.pb.h"
+#include "simulation/simulation_engine.h"
+#include "simulation/slab_transport.h"
+
+namespace tumordtwin {
+
+/**
+ * @brief The ranks of one slab-decomposed simulation, driven through rank 0
+ *
+ * The caller runs engine(), rank 0, like any other engine; the other
+ * ranks mirror its initialize(), step() and snapshot() calls (see
+ * SimulationEngine::followRank0()) until the SlabRanks is destroyed.
+ *
+ * The other ranks are the processes of the MPI job this server was
+ * started in (see attachMpi()) when it has enough of them, so every slab
+ * lives in its own process. Otherwise they run on threads of this process
+ * over a LocalSlabFabric, which splits the work but not the memory (see
+ * fits()). One run holds the MPI ranks at a time; later MPI runs wait
+ * for it in the constructor.
+ */
+class SlabRanks {
+public:
+    /**
+     * @brief Start the other ranks of a run and attach rank 0's engine to them
+     * @param params Validated parameters; num_mpi_ranks is the number of ranks
+     * @param num_threads Threads of the run; in-process ranks share them
+     */
+    SlabRanks(const SimulationParameters& params, int num_threads);
+
+    /**
+     * @brief Release the other ranks and wait for them
+     */
+    ~SlabRanks();
+
+    SlabRanks(const SlabRanks&) = delete;
+    SlabRanks& operator=(const SlabRanks&) = delete;
+
+    SimulationEngine& engine() { return *engine_; }
+    bool usesMpi() const { return mpi_; }
+
+    /**
+     * @brief Check that this process can run a decomposed simulation
+     *
+     * Runs on in-process ranks hold the whole lattice in this process, so
+     * it must stay within SimulationEngine::kMaxVoxelsPerProcess.
+     *
+     * @param error_msg Output parameter for error message
+     */
+    static bool fits(const SimulationParameters& params, std::string& error_msg);
+
+    /**
+     * @brief Ranks of the attached MPI job, or 0 without one
+     */
+    static int mpiRanks();
+
+    /**
+     * @brief Join the MPI job this process was started in (tumor_server --mpi)
+     * @param rank Set to this process's rank; ranks > 0 go on to serveMpiRank()
+     * @param error_msg Output parameter for error message
+     */
+    static bool attachMpi(int* argc, char*** argv, int* rank, std::string& error_msg);
+
+    /**
+     * @brief Run the slabs of rank 0's runs until detachMpi(), then finalize MPI; ranks > 0 only
+     */
+    static void serveMpiRank();
+
+    /**
+     * @brief End serveMpiRank() on the other ranks and finalize MPI; rank 0 only
+     */
+    static void detachMpi();
+
+private:
+    bool mpi_ = false;
+    std::unique_ptr<LocalSlabFabric> fabric_;
+    std::vector<std::thread> followers_;
+#ifdef TUMORDTWIN_HAVE_MPI
+    std::unique_lock<std::mutex> mpi_lock_;
+    MPI_Comm comm_ = MPI_COMM_NULL;
+    std::unique_ptr<MpiSlabTransport> mpi_transport_;
+#endif
+    std::unique_ptr<SimulationEngine> engine_;
+};
+
+} // namespace tumordtwin
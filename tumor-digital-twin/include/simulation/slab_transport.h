@@ -0,0 +1,117 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "simulation/scalar_grid.h"
+
+#ifdef TUMORDTWIN_HAVE_MPI
+#include <mpi.h>
+#endif
+
+namespace tumordtwin {
+
+struct SlabExtent;
+
+/**
+ * @brief Message passing between the ranks of a slab-decomposed domain
+ *
+ * Ranks are ordered along z, so halo exchange only talks to rank - 1 and
+ * rank + 1. The exchange is split into a start and a finish call; the
+ * caller computes every plane that does not read a ghost plane in
+ * between, which hides the transfer behind interior work.
+ */
+class SlabTransport {
+public:
+    virtual ~SlabTransport() = default;
+
+    virtual int rank() const = 0;
+    virtual int numRanks() const = 0;
+
+    /**
+     * @brief Send the outermost owned planes and post receives for the ghost planes
+     *
+     * The owned planes must not be modified and the ghost planes must not
+     * be read until finishHaloExchange() returns.
+     */
+    virtual void startHaloExchange(ScalarGrid& field, const SlabExtent& extent) = 0;
+
+    /**
+     * @brief Wait until the ghost planes of the last startHaloExchange() are filled
+     */
+    virtual void finishHaloExchange() = 0;
+
+    /**
+     * @brief Collective all-to-all exchange of byte buffers
+     * @param outgoing One buffer per rank; outgoing[rank()] is returned as is
+     * @return One buffer per rank, received from that rank
+     */
+    virtual std::vector<std::string> exchange(std::vector<std::string> outgoing) = 0;
+};
+
+/**
+ * @brief In-process transport connecting ranks that run on separate threads
+ *
+ * Each rank's endpoint is used by exactly one thread, like an MPI process.
+ * Used to run and test decomposed simulations without an MPI launcher.
+ */
+class LocalSlabFabric {
+public:
+    explicit LocalSlabFabric(int num_ranks);
+    ~LocalSlabFabric();
+
+    LocalSlabFabric(const LocalSlabFabric&) = delete;
+    LocalSlabFabric& operator=(const LocalSlabFabric&) = delete;
+
+    int numRanks() const { return static_cast<int>(endpoints_.size()); }
+    SlabTransport& transport(int rank);
+
+private:
+    class Endpoint;
+
+    void send(int source, int dest, int tag, std::string data);
+    std::string receive(int source, int dest, int tag);
+
+    std::vector<std::unique_ptr<Endpoint>> endpoints_;
+
+    // FIFO per (source, dest, tag), like MPI's non-overtaking rule
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::map<std::tuple<int, int, int>, std::deque<std::string>> mailboxes_;
+};
+
+#ifdef TUMORDTWIN_HAVE_MPI
+/**
+ * @brief Transport over an MPI communicator
+ *
+ * Ghost planes are received straight into the field with MPI_Irecv and
+ * owned planes sent with MPI_Isend; nothing is staged. The caller owns
+ * MPI_Init/MPI_Finalize.
+ */
+class MpiSlabTransport : public SlabTransport {
+public:
+    explicit MpiSlabTransport(MPI_Comm comm = MPI_COMM_WORLD);
+
+    int rank() const override { return rank_; }
+    int numRanks() const override { return size_; }
+
+    void startHaloExchange(ScalarGrid& field, const SlabExtent& extent) override;
+    void finishHaloExchange() override;
+    std::vector<std::string> exchange(std::vector<std::string> outgoing) override;
+
+private:
+    MPI_Comm comm_;
+    int rank_ = 0;
+    int size_ = 1;
+    std::vector<MPI_Request> requests_;
+};
+#endif
+
+} // namespace tumordtwin
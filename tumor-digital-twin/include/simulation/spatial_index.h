@@ -0,0 +1,150 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "simulation/agent_store.h"
+
+namespace tumordtwin {
+
+/**
+ * @brief Uniform spatial hash over the voxel lattice for neighbor queries
+ *
+ * Agents are bucketed by the voxel that contains them, using the same
+ * lattice as the substance grids. Voxel keys are hashed into a table
+ * sized to the population rather than the domain, so memory is O(N) even
+ * for 1000^3 lattices. Each slot heads a doubly linked list of agent
+ * indices, which allows a moved agent to be re-bucketed in O(1).
+ *
+ * The index tracks AgentStore dense indices. update() incrementally
+ * re-buckets agents that changed voxel and picks up appended agents;
+ * removals must be mirrored with remove() in the same order they are
+ * applied to the store.
+ */
+class SpatialIndex {
+public:
+    static constexpr int32_t kNone = -1;
+
+    /**
+     * @brief Set the lattice the index is bucketed on and drop all entries
+     */
+    void reset(int nx, int ny, int nz, double spacing);
+
+    /**
+     * @brief Re-bucket every agent from scratch
+     */
+    void rebuild(const AgentStore& agents);
+
+    /**
+     * @brief Bring the index up to date after agents moved or were appended
+     *
+     * Only agents whose voxel changed are relinked. Falls back to a full
+     * rebuild when the hash table has to grow.
+     */
+    void update(const AgentStore& agents);
+
+    /**
+     * @brief Link agents appended to the store since the last update
+     *
+     * Cheaper than update() when only new agents need to be visible, e.g.
+     * for crowding checks between divisions within one step.
+     */
+    void insertAppended(const AgentStore& agents);
+
+    /**
+     * @brief Re-bucket one agent after it moved to a new position
+     */
+    void relocate(size_t index, double x, double y, double z);
+
+    /**
+     * @brief Mirror AgentStore::remove(index) (swap the last agent into the hole)
+     *
+     * When the store moved other agents too (remove() returned true), an
+     * update() brings the index back in line.
+     */
+    void remove(size_t index);
+
+    /**
+     * @brief Linear voxel key containing a position (clamped to the domain)
+     */
+    int64_t voxelKey(double x, double y, double z) const;
+
+    /**
+     * @brief Number of indexed agents in a voxel
+     */
+    size_t countInVoxel(int64_t key) const;
+
+    /**
+     * @brief Visit every agent within radius of a point
+     * @param f Callable taking the dense agent index; may be called for the
+     *          querying agent itself
+     */
+    template <typename F>
+    void forEachNeighbor(const AgentStore& agents, double x, double y, double z,
+                         double radius, F&& f) const;
+
+    size_t size() const { return voxel_.size(); }
+    size_t tableSize() const { return head_.size(); }
+
+private:
+    size_t slotFor(int64_t key) const;
+    void link(int32_t index, int64_t key);
+    void unlink(int32_t index);
+    void growTable(size_t population);
+
+    int nx_ = 0;
+    int ny_ = 0;
+    int nz_ = 0;
+    double inv_spacing_ = 1.0;
+
+    // Hash table of list heads
+    std::vector<int32_t> head_;
+    size_t mask_ = 0;
+
+    // Per-agent links and bucket key
+    std::vector<int32_t> next_;
+    std::vector<int32_t> prev_;
+    std::vector<int64_t> voxel_;
+};
+
+template <typename F>
+void SpatialIndex::forEachNeighbor(const AgentStore& agents, double x, double y, double z,
+                                   double radius, F&& f) const {
+    if (head_.empty()) {
+        return;
+    }
+
+    const int reach = static_cast<int>(std::ceil(radius * inv_spacing_));
+    const int ci = std::clamp(static_cast<int>(std::floor(x * inv_spacing_)), 0, nx_ - 1);
+    const int cj = std::clamp(static_cast<int>(std::floor(y * inv_spacing_)), 0, ny_ - 1);
+    const int ck = std::clamp(static_cast<int>(std::floor(z * inv_spacing_)), 0, nz_ - 1);
+    const double r2 = radius * radius;
+    const auto& ax = agents.x();
+    const auto& ay = agents.y();
+    const auto& az = agents.z();
+
+    for (int k = std::max(ck - reach, 0); k <= std::min(ck + reach, nz_ - 1); ++k) {
+        for (int j = std::max(cj - reach, 0); j <= std::min(cj + reach, ny_ - 1); ++j) {
+            for (int i = std::max(ci - reach, 0); i <= std::min(ci + reach, nx_ - 1); ++i) {
+                const int64_t key = (static_cast<int64_t>(k) * ny_ + j) * nx_ + i;
+                // Distinct voxels may share a slot; the key check visits each agent once
+                for (int32_t a = head_[slotFor(key)]; a != kNone; a = next_[a]) {
+                    if (voxel_[a] != key) {
+                        continue;
+                    }
+                    const double dx = ax[a] - x;
+                    const double dy = ay[a] - y;
+                    const double dz = az[a] - z;
+                    if (dx * dx + dy * dy + dz * dz <= r2) {
+                        f(static_cast<size_t>(a));
+                    }
+                }
+            }
+        }
+    }
+}
+
+} // namespace tumordtwin
@@ -0,0 +1,202 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "simulation.pb.h"
+#include "simulation/simulation_engine.h"
+
+namespace tumordtwin {
+
+/**
+ * @brief Whether a checkpoint holds the whole state or changes on top of another one
+ */
+enum class CheckpointKind : uint32_t {
+    Full = 1,
+    Delta = 2,
+};
+
+/**
+ * @brief State of the last checkpoint written, which the next delta is diffed against
+ */
+struct CheckpointBaseline {
+    int32_t step = -1;
+    ScalarGrid oxygen;
+    ScalarGrid glucose;
+    AgentStore agents;
+    size_t num_genotypes = 0;
+
+    bool empty() const { return step < 0; }
+    void capture(const SimulationEngine& engine);
+};
+
+/**
+ * @brief Binary checkpoint files
+ *
+ * A checkpoint is a fixed header with a section table followed by
+ * 64-byte aligned sections:
+ *   - metadata: a small serialized SimulationState (IDs, step, parameters,
+ *     treatment) without agents or grids
+ *   - one raw little-endian double section per substance field
+ *   - one raw section per AgentStore column
+ *   - the genotype table and the random engine state
+ *   - the drug state (DrugTransport::saveState), stored whole even in deltas
+ *
+ * Bulk sections are stored exactly as they are laid out in memory, so a
+ * memory-mapped checkpoint is restored with one memcpy per column. Files
+ * are written to a temporary name, synced and renamed into place, so a
+ * preempted writer never leaves a truncated checkpoint at the final path.
+ *
+ * A delta checkpoint has the same layout but only stores what differs from
+ * its parent: the 16^3 grid tiles and 1024-agent column blocks whose bytes
+ * changed (each with an index section listing them), genotypes interned
+ * since the parent, and the new random engine state. Population inserts
+ * and deletes show up as a changed agent count plus the blocks they touched.
+ */
+class CheckpointWriter {
+public:
+    /**
+     * @brief Write the full engine state to a checkpoint file
+     * @param metadata Scalar state stored alongside the bulk sections
+     * @param error_msg Output parameter for error message
+     */
+    static bool write(const std::string& path, const SimulationState& metadata,
+                      const SimulationEngine& engine, std::string& error_msg);
+
+    /**
+     * @brief Write the changes since `baseline` as a delta checkpoint
+     */
+    static bool writeDelta(const std::string& path, const SimulationState& metadata,
+                           const SimulationEngine& engine, const CheckpointBaseline& baseline,
+                           std::string& error_msg);
+};
+
+/**
+ * @brief Read-only memory-mapped view of a checkpoint file
+ */
+class CheckpointReader {
+public:
+    CheckpointReader() = default;
+    ~CheckpointReader();
+
+    CheckpointReader(const CheckpointReader&) = delete;
+    CheckpointReader& operator=(const CheckpointReader&) = delete;
+
+    /**
+     * @brief Map a checkpoint and validate its header and section table
+     * @param error_msg Output parameter for error message
+     * @return false if the file is missing, truncated or not a checkpoint
+     */
+    bool open(const std::string& path, std::string& error_msg);
+
+    /**
+     * @brief Scalar state stored in the checkpoint
+     */
+    const SimulationState& metadata() const { return metadata_; }
+
+    CheckpointKind kind() const { return kind_; }
+    int32_t step() const { return step_; }
+
+    /**
+     * @brief Step of the checkpoint a delta applies to (-1 for full checkpoints)
+     */
+    int32_t parentStep() const { return parent_step_; }
+
+    /**
+     * @brief Load the checkpoint into an engine built from metadata().parameters()
+     *
+     * A full checkpoint replaces initialize(); a delta must be applied to an
+     * engine at parentStep(), i.e. after the checkpoints before it in the
+     * chain. Either way the engine continues at step(). The engine's
+     * treatment must already be set (SimulationEngine::setTreatment).
+     */
+    bool restore(SimulationEngine& engine, std::string& error_msg) const;
+
+    size_t fileSize() const { return size_; }
+
+private:
+    struct Section {
+        const char* data = nullptr;
+        size_t size = 0;
+    };
+
+    Section section(uint32_t kind) const;
+    bool restoreFull(SimulationEngine& engine, std::string& error_msg) const;
+    bool applyDelta(SimulationEngine& engine, std::string& error_msg) const;
+    void close();
+
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+    CheckpointKind kind_ = CheckpointKind::Full;
+    int32_t step_ = 0;
+    int32_t parent_step_ = -1;
+    SimulationState metadata_;
+};
+
+/**
+ * @brief Readers of a full checkpoint and its deltas, in replay order
+ */
+using CheckpointChain = std::vector<std::shared_ptr<const CheckpointReader>>;
+
+/**
+ * @brief Checkpoint chain of one simulation: a full snapshot plus deltas
+ *
+ * The full checkpoint lives at a fixed path; each delta is written next to
+ * it with the step in its name and records the step it applies to.
+ * Every compaction interval (or on request) a new full checkpoint replaces
+ * the chain and the old deltas are deleted. Readers replay the deltas that
+ * link up from the full checkpoint and ignore stale ones.
+ */
+class CheckpointSeries {
+public:
+    // SimulationParameters.extra_params key: deltas written between full checkpoints
+    static constexpr const char* kParamCompactionInterval = "checkpoint_compaction_interval";
+    static constexpr int kDefaultCompactionInterval = 8;
+
+    /**
+     * @param full_path Path of the full checkpoint
+     * @param compaction_interval Deltas between full checkpoints (0 = always full)
+     */
+    explicit CheckpointSeries(std::string full_path,
+                              int compaction_interval = kDefaultCompactionInterval);
+
+    /**
+     * @brief Write the next checkpoint in the series
+     * @param compact Write a full checkpoint regardless of the interval
+     * @param error_msg Output parameter for error message
+     */
+    bool write(const SimulationState& metadata, const SimulationEngine& engine,
+               bool compact, std::string& error_msg);
+
+    const std::string& fullPath() const { return full_path_; }
+    int deltasSinceFull() const { return deltas_since_full_; }
+
+    /**
+     * @brief Path of the delta checkpoint for a step
+     */
+    static std::string deltaPath(const std::string& full_path, int32_t step);
+
+    /**
+     * @brief Open the full checkpoint and the deltas that apply on top of it
+     * @param chain Set to the readers in replay order
+     * @return false if the full checkpoint cannot be opened
+     */
+    static bool open(const std::string& full_path, CheckpointChain& chain,
+                     std::string& error_msg);
+
+    /**
+     * @brief Delete all delta files next to a full checkpoint
+     */
+    static void removeDeltas(const std::string& full_path);
+
+private:
+    std::string full_path_;
+    int compaction_interval_;
+    int deltas_since_full_ = 0;
+    CheckpointBaseline baseline_;
+};
+
+} // namespace tumordtwin
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <string>
+
+#include "simulation.pb.h"
+#include "simulation/scalar_grid.h"
+
+namespace tumordtwin {
+
+/**
+ * @brief Encoder/decoder for the GridData.values representations
+ *
+ * Encoding is a pipeline of up to three stages, each selected by
+ * GridEncoding:
+ *   1. precision: doubles, floats, or uint32 steps of 2 * max_error
+ *   2. delta: consecutive differences of the integer representation,
+ *      which turns smooth fields into runs of small numbers
+ *   3. compression: the words are byte-shuffled (all low bytes, then the
+ *      next byte plane, ...) and passed to DEFLATE, zstd or LZ4
+ *
+ * DEFLATE is always available; zstd and LZ4 only when the build found
+ * them (see isAvailable()).
+ */
+class GridCodec {
+public:
+    /**
+     * @brief Check whether a compression codec is compiled into this build
+     */
+    static bool isAvailable(GridCompression compression);
+
+    /**
+     * @brief Resolve a requested encoding to one this build can produce
+     *
+     * Unavailable codecs fall back to DEFLATE; the encoder-owned
+     * quantization fields are cleared.
+     */
+    static GridEncoding negotiate(const GridEncoding& requested);
+
+    /**
+     * @brief Validate a requested encoding
+     * @param error_msg Output parameter for error message
+     * @return true if the encoding can be applied
+     */
+    static bool validate(const GridEncoding& encoding, std::string& error_msg);
+
+    /**
+     * @brief Check whether an encoding leaves the values as raw doubles
+     */
+    static bool isRaw(const GridEncoding& encoding);
+
+    /**
+     * @brief Encode grid values
+     * @param encoding In: negotiated encoding; out: quantization parameters filled in
+     * @param out Encoded bytes for GridData.values
+     */
+    static bool encode(const ScalarGrid& grid, GridEncoding& encoding,
+                       std::string* out, std::string& error_msg);
+
+    /**
+     * @brief Decode GridData.values into a grid already sized to the metadata
+     */
+    static bool decode(const std::string& bytes, const GridEncoding& encoding,
+                       ScalarGrid& grid, std::string& error_msg);
+
+    /**
+     * @brief Export into a GridData message with the given encoding
+     */
+    static bool toProto(const ScalarGrid& grid, SubstanceType substance,
+                        const GridEncoding& encoding, GridData* data,
+                        std::string& error_msg);
+
+    /**
+     * @brief Load a raw or compressed GridData message
+     */
+    static bool fromProto(const GridData& data, ScalarGrid& grid, std::string& error_msg);
+};
+
+} // namespace tumordtwin
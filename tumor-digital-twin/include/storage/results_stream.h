@@ -0,0 +1,146 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "service.pb.h"
+#include "simulation/simulation_snapshot.h"
+#include "storage/grid_codec.h"
+
+namespace tumordtwin {
+
+/**
+ * @brief Pull-based encoder that splits a SimulationState into ResultsChunks
+ *
+ * The concatenated ResultsChunk.data payloads form one serialized
+ * SimulationState, but the state is never materialized as a single
+ * message. Grid values are sliced straight out of the snapshot's flat
+ * buffers (sparse grids are expanded one batch of values at a time), and
+ * agents are encoded in small batches as the cursor reaches them, so the memory held per call is one chunk regardless of the
+ * domain size. Grids requested with a non-raw GridEncoding are encoded
+ * up front instead, since their size is only known after encoding.
+ *
+ * A request can narrow the grids to a region or slice, sample them with
+ * a stride, and read them from a coarser level of the snapshot's
+ * GridPyramid; agents can be limited to that region and to some types and
+ * states. Selected grids are cut out when the stream is laid out, so only
+ * the selection is held per call; whole pyramid levels are served from
+ * the snapshot like full-resolution grids.
+ *
+ * Chunk boundaries fall at arbitrary byte offsets; clients must
+ * concatenate all chunks in order before parsing.
+ */
+class ResultsStream {
+public:
+    // Well below gRPC's default 4 MB message limit
+    static constexpr size_t kDefaultChunkBytes = 1 << 20;
+
+    /**
+     * @param header Scalar SimulationState fields (IDs, status, metrics, ...);
+     *               its agents and grids are ignored
+     * @param snapshot Model state the bulk data is read from
+     * @param chunk_bytes Maximum payload size of one chunk
+     */
+    ResultsStream(const SimulationState& header,
+                  std::shared_ptr<const SimulationSnapshot> snapshot,
+                  size_t chunk_bytes = kDefaultChunkBytes);
+
+    /**
+     * @brief Lay out the encoded state for a results request
+     *
+     * Applies include_agents, include_grid_data, substances and the
+     * region, slice, level, stride and agent filters, and negotiates
+     * grid_encoding (see GridCodec::negotiate).
+     *
+     * @param error_msg Output parameter for error message
+     * @return false if the selection or the requested encoding is invalid
+     *         or cannot be applied
+     */
+    bool init(const ResultsRequest& request, std::string& error_msg);
+
+    /**
+     * @brief Encode the next chunk
+     * @return false once every chunk has been produced
+     */
+    bool next(ResultsChunk* chunk);
+
+    size_t totalBytes() const { return total_bytes_; }
+    int32_t totalChunks() const { return total_chunks_; }
+
+private:
+    // One contiguous run of the encoded message
+    struct Segment {
+        enum class Kind { Owned, View, Agents, Bricks };
+
+        Kind kind = Kind::Owned;
+        size_t size = 0;
+        std::string bytes;           // Owned: field headers and small messages
+        const char* view = nullptr;  // View: borrowed snapshot memory
+        size_t begin = 0;            // Agents: range of selected agents; Bricks: flat values
+        size_t end = 0;              //   both encoded lazily
+        const BrickGrid* bricks = nullptr;
+    };
+
+    bool resolveSelection(const ResultsRequest& request, std::string& error_msg);
+    void selectAgents(const ResultsRequest& request);
+    size_t numAgents() const;
+    size_t agentIndex(size_t position) const {
+        return agents_filtered_ ? agent_indices_[position] : position;
+    }
+
+    void addOwned(std::string bytes);
+    void addView(const char* data, size_t size);
+    bool addSelectedGrid(SubstanceType substance, const GridEncoding& encoding,
+                         std::string& error_msg);
+    // `extent` carries the region, level and stride of a selected grid
+    bool addGrid(SubstanceType substance, const ScalarGrid& grid,
+                 const GridEncoding& encoding, std::string& error_msg,
+                 const GridData* extent = nullptr);
+    bool addSparseGrid(SubstanceType substance, const BrickGrid& grid,
+                       const GridEncoding& encoding, std::string& error_msg);
+    void addGridPrefix(const GridData& message, size_t value_bytes);
+    void addAgents();
+
+    void encodeAgents(size_t begin, size_t end, std::string* out) const;
+    const char* segmentData(size_t index);
+
+    std::shared_ptr<const SimulationSnapshot> snapshot_;
+    std::string simulation_id_;
+    std::string header_bytes_;  // Serialized scalar fields of the header
+    size_t chunk_bytes_;
+
+    // Selection in full-resolution voxels [lo, hi) of the snapshot lattice
+    int lattice_[3] = {0, 0, 0};
+    double lattice_spacing_ = 0.0;
+    int lo_[3] = {0, 0, 0};
+    int hi_[3] = {0, 0, 0};
+    bool region_selected_ = false;
+    int level_ = 0;
+    int stride_ = 1;
+
+    // Dense indices of the selected agents, when filtered
+    bool agents_filtered_ = false;
+    std::vector<size_t> agent_indices_;
+
+    // Grids cut out for the selection; deque keeps the views into them valid
+    std::deque<ScalarGrid> selected_grids_;
+
+    std::vector<Segment> segments_;
+    size_t total_bytes_ = 0;
+    int32_t total_chunks_ = 0;
+
+    // Read cursor
+    int32_t next_chunk_ = 0;
+    size_t segment_ = 0;
+    size_t offset_ = 0;
+
+    // Encoded form of the agent or value batch under the cursor
+    std::string batch_buffer_;
+    size_t batch_buffer_segment_ = SIZE_MAX;
+};
+
+} // namespace tumordtwin
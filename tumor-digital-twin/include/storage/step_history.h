@@ -0,0 +1,133 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "service.pb.h"
+#include "simulation/simulation_snapshot.h"
+
+namespace tumordtwin {
+
+/**
+ * @brief Metrics of every step and periodic snapshots of one simulation, on disk
+ *
+ * A history is a directory holding:
+ *   - one append-only column file per scalar SimulationMetrics field, with
+ *     one fixed-width native-endian value per step
+ *   - a variable-width column with the subclones and extra metrics of each
+ *     step, serialized, plus a column of their end offsets
+ *   - the parameters of the run
+ *   - snapshot_<step>.pb files with the grids (lossless DEFLATE) and agents
+ *     of every snapshot interval-th step
+ *
+ * Steps are appended consecutively, so step s is row s - firstStep() of
+ * every column: a step or a range of steps is read with one positioned read
+ * per column, never a scan. A row is published only once all of its columns
+ * are written, so results readers on other threads read the steps a running
+ * simulation has published so far while it keeps appending. Reopening a
+ * history drops rows whose columns a crash cut short.
+ */
+class StepHistory {
+public:
+    // SimulationParameters.extra_params key: steps between snapshots
+    // (absent = checkpoint_interval, 0 = final state only)
+    static constexpr const char* kParamSnapshotInterval = "history_snapshot_interval";
+
+    explicit StepHistory(std::string directory);
+    ~StepHistory();
+
+    StepHistory(const StepHistory&) = delete;
+    StepHistory& operator=(const StepHistory&) = delete;
+
+    /**
+     * @brief Open or create the history of a run that continues after `last_step`
+     *
+     * Rows and snapshots after `last_step` are dropped, so a run resumed
+     * from a checkpoint rewinds the history to it; -1 starts over.
+     * @param error_msg Output parameter for error message
+     */
+    bool open(const SimulationParameters& parameters, int32_t last_step,
+              std::string& error_msg);
+
+    /**
+     * @brief Snapshot interval of a run, from its parameters
+     */
+    static int snapshotInterval(const SimulationParameters& parameters);
+
+    /**
+     * @brief Append the metrics of the next step
+     * @return false if the step does not follow the last one or a write failed
+     */
+    bool append(const SimulationMetrics& metrics, std::string& error_msg);
+
+    /**
+     * @brief Store the grids and agents of a step
+     */
+    bool writeSnapshot(const SimulationSnapshot& snapshot, std::string& error_msg);
+
+    const std::string& directory() const { return directory_; }
+    const SimulationParameters& parameters() const { return parameters_; }
+
+    /**
+     * @brief First recorded step, or -1 while the history is empty
+     */
+    int32_t firstStep() const { return first_step_.load(std::memory_order_acquire); }
+
+    /**
+     * @brief Published steps
+     */
+    size_t rows() const { return rows_.load(std::memory_order_acquire); }
+
+    bool hasStep(int32_t step) const;
+
+    /**
+     * @brief Read the metrics of one published step
+     */
+    bool metrics(int32_t step, SimulationMetrics* metrics, std::string& error_msg) const;
+
+    /**
+     * @brief Read the published steps in [from_step, to_step], every stride-th
+     *
+     * Bounds outside the published steps are clamped to them.
+     * @param details Also fill MetricHistory.details
+     */
+    bool read(int32_t from_step, int32_t to_step, int32_t stride, bool details,
+              MetricHistory* history, std::string& error_msg) const;
+
+    /**
+     * @brief Steps with a stored snapshot, in ascending order
+     */
+    std::vector<int32_t> snapshotSteps() const;
+
+    /**
+     * @brief Load the snapshot of a step
+     * @return nullptr if none is stored for the step or it cannot be read
+     */
+    std::shared_ptr<const SimulationSnapshot> loadSnapshot(int32_t step,
+                                                           std::string& error_msg) const;
+
+private:
+    std::string snapshotPath(int32_t step) const;
+    bool readDetails(size_t row, SimulationMetrics* metrics, std::string& error_msg) const;
+    void close();
+
+    std::string directory_;
+    SimulationParameters parameters_;
+    std::vector<int> column_fds_;  // One per scalar field of SimulationMetrics
+    int offsets_fd_ = -1;          // End offset of each row in the details column
+    int details_fd_ = -1;
+    uint64_t details_size_ = 0;
+
+    std::atomic<int32_t> first_step_{-1};
+    std::atomic<size_t> rows_{0};
+
+    mutable std::mutex snapshots_mutex_;
+    std::vector<int32_t> snapshot_steps_;
+};
+
+} // namespace tumordtwin
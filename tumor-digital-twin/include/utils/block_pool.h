@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+#include "utils/aligned_allocator.h"
+
+namespace tumordtwin {
+
+/**
+ * @brief Free-list allocator for fixed-size blocks carved out of large slabs
+ *
+ * Blocks are never handed back to the heap while the pool lives:
+ * release() puts a block on a free list that acquire() drains first.
+ * Structures that expand and collapse blocks every step (sparse grid
+ * bricks, per-step uptake) settle into a steady state with no heap
+ * traffic and no page faults on fresh memory.
+ *
+ * Not thread-safe; callers acquire and release from one thread.
+ */
+template <typename T, std::size_t BlockSize, std::size_t BlocksPerSlab = 64>
+class BlockPool {
+public:
+    BlockPool() = default;
+
+    BlockPool(const BlockPool&) = delete;
+    BlockPool& operator=(const BlockPool&) = delete;
+    // Slab buffers move with their vector, so outstanding blocks stay valid
+    BlockPool(BlockPool&&) noexcept = default;
+    BlockPool& operator=(BlockPool&&) noexcept = default;
+
+    /**
+     * @brief A block of BlockSize elements with unspecified contents
+     */
+    T* acquire() {
+        if (free_.empty()) {
+            grow();
+        }
+        T* block = free_.back();
+        free_.pop_back();
+        return block;
+    }
+
+    void release(T* block) { free_.push_back(block); }
+
+    /**
+     * @brief Blocks held from the heap, in use or free
+     */
+    std::size_t capacity() const { return slabs_.size() * BlocksPerSlab; }
+    std::size_t inUse() const { return capacity() - free_.size(); }
+
+    /**
+     * @brief Return all memory to the heap; no block may be in use
+     */
+    void clear() {
+        slabs_.clear();
+        free_.clear();
+    }
+
+    void swap(BlockPool& other) noexcept {
+        slabs_.swap(other.slabs_);
+        free_.swap(other.free_);
+    }
+
+private:
+    void grow() {
+        slabs_.emplace_back(BlockSize * BlocksPerSlab);
+        T* slab = slabs_.back().data();
+        free_.reserve(free_.size() + BlocksPerSlab);
+        // Hand out the slab front to back
+        for (std::size_t b = BlocksPerSlab; b-- > 0;) {
+            free_.push_back(slab + b * BlockSize);
+        }
+    }
+
+    std::vector<AlignedVector<T>> slabs_;
+    std::vector<T*> free_;
+};
+
+} // namespace tumordtwin
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace tumordtwin {
+
+/**
+ * @brief Label names and values of one time series, in output order
+ */
+using MetricLabels = std::vector<std::pair<std::string, std::string>>;
+
+/**
+ * @brief Monotonic counter, lock-free to increment
+ */
+class Counter {
+public:
+    void increment(uint64_t n = 1) { value_.fetch_add(n, std::memory_order_relaxed); }
+    uint64_t value() const { return value_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint64_t> value_{0};
+};
+
+/**
+ * @brief Histogram over fixed bucket upper bounds, lock-free to observe
+ *
+ * Buckets are counted individually and made cumulative when rendered, so
+ * observe() touches one bucket, the count and the sum.
+ */
+class Histogram {
+public:
+    /**
+     * @param upper_bounds Ascending bucket bounds; a +Inf bucket is implied
+     */
+    explicit Histogram(std::vector<double> upper_bounds);
+
+    void observe(double value);
+
+    const std::vector<double>& upperBounds() const { return upper_bounds_; }
+
+    /**
+     * @brief Observations in bucket i alone (i == upperBounds().size() is +Inf)
+     */
+    uint64_t bucketCount(size_t i) const { return buckets_[i].load(std::memory_order_relaxed); }
+    uint64_t count() const { return count_.load(std::memory_order_relaxed); }
+    double sum() const { return sum_.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief `count` bounds starting at `start`, each `factor` times the previous
+     */
+    static std::vector<double> exponentialBuckets(double start, double factor, size_t count);
+
+private:
+    const std::vector<double> upper_bounds_;
+    std::unique_ptr<std::atomic<uint64_t>[]> buckets_;
+    std::atomic<uint64_t> count_{0};
+    std::atomic<double> sum_{0.0};
+};
+
+/**
+ * @brief Named counters, gauges and histograms rendered in the Prometheus text format
+ *
+ * Lookups create a series on first use and return the same object after
+ * that; returned references stay valid for the registry's lifetime, so hot
+ * paths resolve their series once and then update them without locking.
+ * Gauges are read through a callback when the registry is rendered.
+ *
+ * Thread-safe.
+ */
+class MetricsRegistry {
+public:
+    /**
+     * @brief Latency buckets from 50 us to about 100 s, in seconds
+     */
+    static std::vector<double> latencyBuckets();
+
+    /**
+     * @param name Metric name, e.g. "tumordtwin_rpc_requests_total"
+     * @param help One-line description, taken from the first registration of the name
+     */
+    Counter& counter(const std::string& name, const std::string& help,
+                     const MetricLabels& labels = {});
+
+    /**
+     * @param upper_bounds Bucket bounds, used by the first series of the name only
+     */
+    Histogram& histogram(const std::string& name, const std::string& help,
+                         const MetricLabels& labels = {},
+                         const std::vector<double>& upper_bounds = latencyBuckets());
+
+    /**
+     * @brief Register (or replace) a gauge whose value is read at render time
+     *
+     * The callback runs under the registry lock and must not use the registry.
+     */
+    void gauge(const std::string& name, const std::string& help, const MetricLabels& labels,
+               std::function<double()> read);
+
+    /**
+     * @brief All series in the Prometheus text exposition format (version 0.0.4)
+     */
+    std::string renderPrometheus() const;
+
+private:
+    enum class Type { Counter, Gauge, Histogram };
+
+    struct Series {
+        MetricLabels labels;
+        std::unique_ptr<Counter> counter;
+        std::unique_ptr<Histogram> histogram;
+        std::function<double()> gauge;
+    };
+
+    struct Family {
+        std::string help;
+        Type type = Type::Counter;
+        std::vector<double> upper_bounds;
+        std::map<std::string, Series> series;  // By rendered label set
+    };
+
+    // A family of the given type; a name registered with another type is a programming error
+    Family& family(const std::string& name, const std::string& help, Type type);
+
+    mutable std::mutex mutex_;
+    std::map<std::string, Family> families_;
+};
+
+} // namespace tumordtwin
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace tumordtwin {
+
+/**
+ * @brief Incremental SHA-256 (FIPS 180-4)
+ *
+ * Used for content addressing, where a 64-bit hash would let two
+ * different inputs share an entry.
+ */
+class Sha256 {
+public:
+    Sha256();
+
+    void update(const void* data, size_t size);
+    void update(std::string_view bytes) { update(bytes.data(), bytes.size()); }
+
+    /**
+     * @brief Finish and return the 32-byte digest; the hasher is reset afterwards
+     */
+    std::array<uint8_t, 32> digest();
+
+    /**
+     * @brief Finish and return the digest as 64 lowercase hex digits
+     */
+    std::string hexDigest();
+
+private:
+    void compress(const uint8_t* block);
+    void reset();
+
+    std::array<uint32_t, 8> state_;
+    std::array<uint8_t, 64> buffer_;
+    size_t buffered_ = 0;
+    uint64_t length_ = 0;  // Bytes hashed so far
+};
+
+} // namespace tumordtwin
@@ -0,0 +1,474 @@
+#include "async_service.h"
+#include "grpc_server.h"
+#include "storage/results_stream.h"
+#include "utils/profiler.h"
+
+#include <grpcpp/alarm.h>
+#include <algorithm>
+#include <chrono>
+#include <optional>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace tumordtwin {
+
+namespace {
+
+// How often an idle watch re-checks its simulation; the sync handler is
+// woken by the record instead, but a queue thread must never block on it
+constexpr auto kWatchPollInterval = std::chrono::milliseconds(20);
+
+/**
+ * @brief State machine of one RPC; its address is the tag of every operation it starts
+ */
+class AsyncCall {
+public:
+    virtual ~AsyncCall() = default;
+
+    /**
+     * @brief Advance after an operation of this call completed
+     * @param ok Whether the operation succeeded
+     */
+    virtual void proceed(bool ok) = 0;
+};
+
+struct CallEnv {
+    AsyncSimulationService* service;
+    SimulationServiceImpl* impl;
+    grpc::ServerCompletionQueue* cq;
+};
+
+/**
+ * @brief Unary RPC answered by a SimulationServiceImpl handler on the queue thread
+ */
+template <typename Request, typename Response>
+class UnaryCall final : public AsyncCall {
+public:
+    using RequestMethod = void (AsyncSimulationService::*)(
+        grpc::ServerContext*, Request*, grpc::ServerAsyncResponseWriter<Response>*,
+        grpc::CompletionQueue*, grpc::ServerCompletionQueue*, void*);
+    using Handler = grpc::Status (SimulationServiceImpl::*)(grpc::ServerContext*,
+                                                            const Request*, Response*);
+
+    UnaryCall(const CallEnv& env, RequestMethod request_method, Handler handler)
+        : env_(env),
+          request_method_(request_method),
+          handler_(handler),
+          responder_(&context_) {
+        (env_.service->*request_method_)(&context_, &request_, &responder_, env_.cq, env_.cq,
+                                         this);
+    }
+
+    void proceed(bool ok) override {
+        if (!ok || finished_) {
+            delete this;
+            return;
+        }
+        // Accept the next call of this method while this one is handled
+        new UnaryCall(env_, request_method_, handler_);
+
+        const grpc::Status status = (env_.impl->*handler_)(&context_, &request_, &response_);
+        finished_ = true;
+        responder_.Finish(response_, status, this);
+    }
+
+private:
+    CallEnv env_;
+    RequestMethod request_method_;
+    Handler handler_;
+    grpc::ServerContext context_;
+    Request request_;
+    Response response_;
+    grpc::ServerAsyncResponseWriter<Response> responder_;
+    bool finished_ = false;
+};
+
+template <typename Request, typename Response>
+void postUnary(const CallEnv& env,
+               typename UnaryCall<Request, Response>::RequestMethod request_method,
+               typename UnaryCall<Request, Response>::Handler handler) {
+    new UnaryCall<Request, Response>(env, request_method, handler);
+}
+
+/**
+ * @brief GetSimulationResults, opened off the queue thread, then one chunk
+ *        encoded per completed write
+ */
+class ResultsCall final : public AsyncCall {
+public:
+    explicit ResultsCall(const CallEnv& env) : env_(env), writer_(&context_) {
+        env_.service->RequestGetSimulationResults(&context_, &request_, &writer_, env_.cq,
+                                                  env_.cq, this);
+    }
+
+    void proceed(bool ok) override {
+        switch (state_) {
+            case State::Requested: {
+                if (!ok) {
+                    delete this;
+                    return;
+                }
+                new ResultsCall(env_);
+                // Loading and encoding the snapshot would stall every call on this queue
+                state_ = State::Opening;
+                env_.service->offload([this] {
+                    const uint64_t start_ns = StepProfiler::nowNs();
+                    open_status_ = env_.impl->openResults(request_, &stream_);
+                    encode_ns_ += StepProfiler::nowNs() - start_ns;
+                    alarm_.Set(env_.cq, std::chrono::system_clock::now(), this);
+                });
+                return;
+            }
+            case State::Opening:
+                if (!open_status_.ok()) {
+                    finish(open_status_);
+                    return;
+                }
+                state_ = State::Writing;
+                writeNext();
+                return;
+            case State::Writing:
+                if (!ok) {
+                    finish(grpc::Status(grpc::StatusCode::CANCELLED,
+                                        "Results stream cancelled by client"));
+                    return;
+                }
+                writeNext();
+                return;
+            case State::Finishing:
+                delete this;
+                return;
+        }
+    }
+
+private:
+    enum class State { Requested, Opening, Writing, Finishing };
+
+    void writeNext() {
+        const uint64_t start_ns = StepProfiler::nowNs();
+        const bool more = stream_->next(&chunk_);
+        encode_ns_ += StepProfiler::nowNs() - start_ns;
+        if (!more || chunk_.is_final()) {
+            env_.impl->recordResultSerialization(encode_ns_);
+        }
+        if (!more) {
+            finish(grpc::Status::OK);
+        } else if (chunk_.is_final()) {
+            // The last chunk and the status leave in one batch
+            state_ = State::Finishing;
+            writer_.WriteAndFinish(chunk_, grpc::WriteOptions(), grpc::Status::OK, this);
+        } else {
+            writer_.Write(chunk_, this);
+        }
+    }
+
+    void finish(const grpc::Status& status) {
+        state_ = State::Finishing;
+        writer_.Finish(status, this);
+    }
+
+    CallEnv env_;
+    State state_ = State::Requested;
+    grpc::ServerContext context_;
+    ResultsRequest request_;
+    grpc::ServerAsyncWriter<ResultsChunk> writer_;
+    grpc::Status open_status_;
+    grpc::Alarm alarm_;
+    std::unique_ptr<ResultsStream> stream_;
+    ResultsChunk chunk_;
+    uint64_t encode_ns_ = 0;
+};
+
+/**
+ * @brief WatchSimulation, woken by write completions and alarms
+ *
+ * The done notification is a second tag of the same call, so the call is
+ * deleted only once both its final status was sent and gRPC reported it
+ * done.
+ */
+class WatchCall final : public AsyncCall {
+public:
+    explicit WatchCall(const CallEnv& env) : env_(env), writer_(&context_), done_tag_(this) {
+        context_.AsyncNotifyWhenDone(&done_tag_);
+        env_.service->RequestWatchSimulation(&context_, &request_, &writer_, env_.cq, env_.cq,
+                                             this);
+    }
+
+    ~WatchCall() override {
+        if (record_) {
+            record_->removeWatcher();
+        }
+    }
+
+    void proceed(bool ok) override {
+        switch (state_) {
+            case State::Requested: {
+                // A call that never started gets no done notification
+                if (!ok) {
+                    delete this;
+                    return;
+                }
+                new WatchCall(env_);
+                std::shared_ptr<SimulationRecord> record;
+                const grpc::Status status = env_.impl->watchTarget(request_, &record);
+                if (!status.ok()) {
+                    finish(status);
+                    return;
+                }
+                record_ = std::move(record);
+                record_->addWatcher();
+                cursor_.emplace(request_);
+                check();
+                return;
+            }
+            case State::Writing:
+                if (!ok) {
+                    finish(grpc::Status(grpc::StatusCode::CANCELLED, "Client stopped reading"));
+                    return;
+                }
+                check();
+                return;
+            case State::Waiting:
+                // Fired, or cancelled because the call is done
+                check();
+                return;
+            case State::Finishing:
+                finished_ = true;
+                release();
+                return;
+        }
+    }
+
+private:
+    enum class State { Requested, Writing, Waiting, Finishing };
+
+    class DoneTag final : public AsyncCall {
+    public:
+        explicit DoneTag(WatchCall* call) : call_(call) {}
+        void proceed(bool) override { call_->onDone(); }
+
+    private:
+        WatchCall* call_;
+    };
+
+    void onDone() {
+        done_ = true;
+        if (state_ == State::Waiting) {
+            alarm_.Cancel();
+        }
+        release();
+    }
+
+    void check() {
+        if (done_) {
+            finish(grpc::Status(grpc::StatusCode::CANCELLED, "Client cancelled the watch"));
+            return;
+        }
+        if (!env_.impl->isServing()) {
+            finish(grpc::Status(grpc::StatusCode::UNAVAILABLE, "Service is shutting down"));
+            return;
+        }
+
+        const auto now = WatchCursor::Clock::now();
+        WatchCursor::Clock::duration wait{};
+        if (cursor_->due(*record_, now, &wait)) {
+            response_.Clear();
+            record_->toStatusResponse(&response_);
+            if (cursor_->sent(response_, now)) {
+                state_ = State::Finishing;
+                writer_.WriteAndFinish(response_, grpc::WriteOptions(), grpc::Status::OK, this);
+            } else {
+                state_ = State::Writing;
+                writer_.Write(response_, this);
+            }
+            return;
+        }
+
+        if (wait == WatchCursor::Clock::duration::zero() || wait > kWatchPollInterval) {
+            wait = kWatchPollInterval;
+        }
+        state_ = State::Waiting;
+        alarm_.Set(env_.cq, std::chrono::system_clock::now() + wait, this);
+    }
+
+    void finish(const grpc::Status& status) {
+        state_ = State::Finishing;
+        writer_.Finish(status, this);
+    }
+
+    void release() {
+        if (finished_ && done_) {
+            delete this;
+        }
+    }
+
+    CallEnv env_;
+    State state_ = State::Requested;
+    grpc::ServerContext context_;
+    WatchRequest request_;
+    grpc::ServerAsyncWriter<StatusResponse> writer_;
+    DoneTag done_tag_;
+    bool done_ = false;
+    bool finished_ = false;
+    std::shared_ptr<SimulationRecord> record_;
+    std::optional<WatchCursor> cursor_;
+    StatusResponse response_;
+    grpc::Alarm alarm_;
+};
+
+void postCalls(const CallEnv& env) {
+    using Service = AsyncSimulationService;
+    using Impl = SimulationServiceImpl;
+    postUnary<grpc::ByteBuffer, grpc::ByteBuffer>(env, &Service::RequestStartSimulation,
+                                                  &Impl::startSimulationFromWire);
+    postUnary<EnsembleRequest, EnsembleResponse>(env, &Service::RequestStartEnsemble,
+                                                 &Impl::StartEnsemble);
+    postUnary<EnsembleStatusRequest, EnsembleStatusResponse>(
+        env, &Service::RequestGetEnsembleStatus, &Impl::GetEnsembleStatus);
+    postUnary<StatusRequest, StatusResponse>(env, &Service::RequestGetSimulationStatus,
+                                             &Impl::GetSimulationStatus);
+    postUnary<MetricHistoryRequest, MetricHistory>(env, &Service::RequestGetMetricHistory,
+                                                   &Impl::GetMetricHistory);
+    postUnary<StopRequest, StopResponse>(env, &Service::RequestStopSimulation,
+                                         &Impl::StopSimulation);
+    postUnary<ListRequest, SimulationList>(env, &Service::RequestListSimulations,
+                                           &Impl::ListSimulations);
+    postUnary<LoadSimulationRequest, LoadSimulationResponse>(
+        env, &Service::RequestLoadSimulation, &Impl::LoadSimulation);
+    postUnary<HealthCheckRequest, HealthCheckResponse>(env, &Service::RequestHealthCheck,
+                                                       &Impl::HealthCheck);
+    new WatchCall(env);
+    new ResultsCall(env);
+}
+
+} // namespace
+
+AsyncSimulationService::AsyncSimulationService(SimulationServiceImpl& impl, int num_cqs,
+                                               bool pin_threads)
+    : impl_(impl),
+      num_cqs_(num_cqs > 0 ? num_cqs
+                           : static_cast<int>(std::max(1u, std::thread::hardware_concurrency()))),
+      pin_threads_(pin_threads) {
+}
+
+AsyncSimulationService::~AsyncSimulationService() {
+    shutdown();
+}
+
+void AsyncSimulationService::addCompletionQueues(grpc::ServerBuilder& builder) {
+    cqs_.clear();
+    for (int i = 0; i < num_cqs_; ++i) {
+        cqs_.push_back(builder.AddCompletionQueue());
+    }
+}
+
+void AsyncSimulationService::start() {
+    offload_stopping_ = false;
+    for (size_t q = 0; q < cqs_.size(); ++q) {
+        offload_threads_.emplace_back([this] { runOffloaded(); });
+    }
+    for (size_t q = 0; q < cqs_.size(); ++q) {
+        // One outstanding call per method and queue; each re-posts itself when matched
+        postCalls(CallEnv{this, &impl_, cqs_[q].get()});
+        threads_.emplace_back([this, q] { poll(q); });
+    }
+}
+
+void AsyncSimulationService::shutdown() {
+    // Offloaded tasks finish first: each resumes its call through its queue
+    {
+        std::lock_guard<std::mutex> lock(offload_mutex_);
+        offload_stopping_ = true;
+    }
+    offload_cv_.notify_all();
+    for (auto& thread : offload_threads_) {
+        thread.join();
+    }
+    offload_threads_.clear();
+
+    for (auto& cq : cqs_) {
+        cq->Shutdown();
+    }
+    // The threads drain the queues, deleting the calls that were never matched
+    for (auto& thread : threads_) {
+        thread.join();
+    }
+    threads_.clear();
+    cqs_.clear();
+}
+
+void AsyncSimulationService::poll(size_t queue) {
+#ifdef __linux__
+    if (pin_threads_) {
+        const unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(static_cast<int>(queue % cores), &cpus);
+        pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+    }
+#endif
+
+    grpc::ServerCompletionQueue& cq = *cqs_[queue];
+    void* tag = nullptr;
+    bool ok = false;
+    while (cq.Next(&tag, &ok)) {
+        static_cast<AsyncCall*>(tag)->proceed(ok);
+    }
+}
+
+void AsyncSimulationService::offload(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(offload_mutex_);
+        offload_tasks_.push_back(std::move(task));
+    }
+    offload_cv_.notify_one();
+}
+
+void AsyncSimulationService::runOffloaded() {
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(offload_mutex_);
+            offload_cv_.wait(lock, [this] { return offload_stopping_ || !offload_tasks_.empty(); });
+            if (offload_tasks_.empty()) {
+                return;
+            }
+            task = std::move(offload_tasks_.front());
+            offload_tasks_.pop_front();
+        }
+        task();
+    }
+}
+
+grpc::Status AsyncSimulationService::UploadPatientData(
+    grpc::ServerContext* context,
+    grpc::ServerReader<PatientDataChunk>* reader,
+    UploadResponse* response) {
+    return impl_.UploadPatientData(context, reader, response);
+}
+
+grpc::Status AsyncSimulationService::ReportNodeStatus(
+    grpc::ServerContext* context,
+    const NodeStatus* request,
+    NodeStatusResponse* response) {
+    return impl_.ReportNodeStatus(context, request, response);
+}
+
+grpc::Status AsyncSimulationService::ReleaseQueuedJobs(
+    grpc::ServerContext* context,
+    const ReleaseJobsRequest* request,
+    ReleaseJobsResponse* response) {
+    return impl_.ReleaseQueuedJobs(context, request, response);
+}
+
+grpc::Status AsyncSimulationService::ConfirmRelease(
+    grpc::ServerContext* context,
+    const ConfirmReleaseRequest* request,
+    ConfirmReleaseResponse* response) {
+    return impl_.ConfirmRelease(context, request, response);
+}
+
+} // namespace tumordtwin
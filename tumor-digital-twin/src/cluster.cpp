@@ -0,0 +1,597 @@
+#include "cluster.h"
+#include "grpc_server.h"
+#include "simulation/job_scheduler.h"
+#include <algorithm>
+#include <iostream>
+#include <limits>
+#include <set>
+
+namespace tumordtwin {
+
+// ============================================================================
+// ClusterCoordinator Implementation
+// ============================================================================
+
+ClusterCoordinator::ClusterCoordinator(int heartbeat_ms)
+    : heartbeat_ms_(heartbeat_ms > 0 ? heartbeat_ms : kDefaultHeartbeatMs) {
+}
+
+ClusterCoordinator::~ClusterCoordinator() {
+    stop();
+}
+
+void ClusterCoordinator::start() {
+    std::lock_guard<std::mutex> lock(balancer_mutex_);
+    if (!balancer_.joinable()) {
+        stopping_ = false;
+        balancer_ = std::thread(&ClusterCoordinator::balancerLoop, this);
+    }
+}
+
+void ClusterCoordinator::stop() {
+    {
+        std::lock_guard<std::mutex> lock(balancer_mutex_);
+        stopping_ = true;
+    }
+    balancer_cv_.notify_all();
+    if (balancer_.joinable()) {
+        balancer_.join();
+    }
+}
+
+void ClusterCoordinator::balancerLoop() {
+    std::unique_lock<std::mutex> lock(balancer_mutex_);
+    while (!balancer_cv_.wait_for(lock, std::chrono::milliseconds(heartbeat_ms_),
+                                  [this] { return stopping_; })) {
+        lock.unlock();
+        rebalance();
+        lock.lock();
+    }
+}
+
+int ClusterCoordinator::pickNode(const std::vector<NodeStatus>& nodes, double cost) {
+    int best = -1;
+    double best_finish = 0.0;
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        if (nodes[i].core_budget() <= 0) {
+            continue;
+        }
+        const double finish = (nodes[i].outstanding_cost() + cost) / nodes[i].core_budget();
+        if (best < 0 || finish < best_finish) {
+            best = static_cast<int>(i);
+            best_finish = finish;
+        }
+    }
+    return best;
+}
+
+bool ClusterCoordinator::pickSteal(const std::vector<NodeStatus>& nodes, int* thief,
+                                   int* victim, int* max_jobs) {
+    *thief = -1;
+    *victim = -1;
+    int most_idle = 0;
+    double most_queued = 0.0;
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        const NodeStatus& node = nodes[i];
+        const int idle = node.core_budget() - node.cores_in_use();
+        if (node.queued_jobs() == 0 && idle > most_idle) {
+            *thief = static_cast<int>(i);
+            most_idle = idle;
+        }
+        if (node.queued_jobs() > 0 && node.core_budget() > 0) {
+            const double queued = node.queued_cost() / node.core_budget();
+            if (*victim < 0 || queued > most_queued) {
+                *victim = static_cast<int>(i);
+                most_queued = queued;
+            }
+        }
+    }
+    if (*thief < 0 || *victim < 0) {
+        return false;
+    }
+    *max_jobs = std::min(most_idle, nodes[*victim].queued_jobs());
+    return true;
+}
+
+int ClusterCoordinator::rebalance() {
+    std::lock_guard<std::mutex> rebalance_lock(rebalance_mutex_);
+    const std::vector<NodeStatus> nodes = liveNodes();
+    int thief = -1;
+    int victim = -1;
+    int max_jobs = 0;
+    if (!pickSteal(nodes, &thief, &victim, &max_jobs)) {
+        return 0;
+    }
+    const std::string& thief_id = nodes[thief].node_id();
+    const std::string& victim_id = nodes[victim].node_id();
+    const std::string& token = nodes[victim].release_token();
+    std::shared_ptr<Stub> thief_stub = stub(thief_id);
+    std::shared_ptr<Stub> victim_stub = stub(victim_id);
+
+    // The victim holds the runs for every restart and the confirmation; past
+    // that it queues them again
+    ReleaseJobsRequest release;
+    release.set_max_jobs(max_jobs);
+    release.set_release_token(token);
+    release.set_hold_ms(static_cast<int32_t>(
+        std::chrono::duration_cast<std::chrono::milliseconds>(callTimeout()).count() *
+        (max_jobs + 2)));
+    ReleaseJobsResponse released;
+    grpc::ClientContext release_context;
+    release_context.set_deadline(std::chrono::system_clock::now() + callTimeout());
+    if (!victim_stub->ReleaseQueuedJobs(&release_context, release, &released).ok() ||
+        released.requests_size() == 0) {
+        return 0;
+    }
+
+    // Until confirmed the victim keeps the runs and answers for them
+    ConfirmReleaseRequest confirm;
+    confirm.set_release_token(token);
+    confirm.set_release_id(released.release_id());
+    double moved_cost = 0.0;
+    for (const SimulationRequest& request : released.requests()) {
+        const double cost = JobScheduler::estimateCost(request.params());
+        SimulationResponse response;
+        grpc::ClientContext context;
+        context.set_deadline(std::chrono::system_clock::now() + callTimeout());
+        if (place(thief_id, thief_stub, &context, request, cost, &response).ok()) {
+            confirm.add_moved_ids(request.simulation_id());
+            moved_cost += cost;
+        }
+    }
+
+    ConfirmReleaseResponse confirmed;
+    grpc::ClientContext confirm_context;
+    confirm_context.set_deadline(std::chrono::system_clock::now() + callTimeout());
+    const grpc::Status confirm_status =
+        victim_stub->ConfirmRelease(&confirm_context, confirm, &confirmed);
+
+    auto stopOnThief = [&](const std::string& simulation_id) {
+        StopRequest request;
+        request.set_simulation_id(simulation_id);
+        StopResponse response;
+        grpc::ClientContext context;
+        context.set_deadline(std::chrono::system_clock::now() + callTimeout());
+        thief_stub->StopSimulation(&context, request, &response);
+    };
+
+    if (confirm_status.error_code() == grpc::StatusCode::NOT_FOUND) {
+        // The hold ran out and the victim queued them again: undo the copies
+        for (const std::string& simulation_id : confirm.moved_ids()) {
+            stopOnThief(simulation_id);
+            std::lock_guard<std::mutex> lock(mutex_);
+            owners_[simulation_id] = victim_id;
+        }
+        return 0;
+    }
+    if (!confirm_status.ok()) {
+        std::cerr << "Could not confirm moving " << confirm.moved_ids_size()
+                  << " simulations from " << victim_id << " to " << thief_id << ": "
+                  << confirm_status.error_message()
+                  << "; they may run on both nodes" << std::endl;
+        return confirm.moved_ids_size();
+    }
+    for (const std::string& simulation_id : confirmed.stopped_ids()) {
+        stopOnThief(simulation_id);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        NodeStatus& load = nodes_[victim_id].status;
+        load.set_queued_jobs(std::max(load.queued_jobs() - confirm.moved_ids_size(), 0));
+        load.set_queued_cost(std::max(load.queued_cost() - moved_cost, 0.0));
+        load.set_outstanding_cost(std::max(load.outstanding_cost() - moved_cost, 0.0));
+    }
+    return confirm.moved_ids_size();
+}
+
+std::vector<NodeStatus> ClusterCoordinator::liveNodes() const {
+    std::vector<NodeStatus> live;
+    const auto now = Clock::now();
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& [node_id, node] : nodes_) {
+        if (isLive(node, now)) {
+            live.push_back(node.status);
+        }
+    }
+    return live;
+}
+
+std::string ClusterCoordinator::owner(const std::string& id) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = owners_.find(id);
+    return it != owners_.end() ? it->second : std::string();
+}
+
+bool ClusterCoordinator::isLive(const Node& node, Clock::time_point now) const {
+    return node.stub &&
+           now - node.last_report <= std::chrono::milliseconds(heartbeat_ms_) * kMissedHeartbeats;
+}
+
+ClusterCoordinator::Clock::duration ClusterCoordinator::callTimeout() const {
+    return std::chrono::milliseconds(heartbeat_ms_) * kMissedHeartbeats;
+}
+
+std::shared_ptr<ClusterCoordinator::Stub> ClusterCoordinator::stub(
+    const std::string& node_id) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = nodes_.find(node_id);
+    return it != nodes_.end() ? it->second.stub : nullptr;
+}
+
+grpc::Status ClusterCoordinator::reportNodeStatus(const NodeStatus& status,
+                                                  NodeStatusResponse* response) {
+    if (status.node_id().empty() || status.core_budget() <= 0) {
+        return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT,
+                          "A node must report its address and core budget");
+    }
+
+    bool joined = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Node& node = nodes_[status.node_id()];
+        if (!node.stub) {
+            // Results and histories can exceed the default 4 MB receive limit
+            grpc::ChannelArguments args;
+            args.SetMaxReceiveMessageSize(-1);
+            node.stub = SimulationService::NewStub(grpc::CreateCustomChannel(
+                status.node_id(), grpc::InsecureChannelCredentials(), args));
+        }
+        joined = !isLive(node, Clock::now());
+        node.status = status;
+        node.last_report = Clock::now();
+    }
+    if (joined) {
+        std::cout << "Node " << status.node_id() << " joined with " << status.core_budget()
+                  << " cores" << std::endl;
+    }
+
+    response->set_heartbeat_interval_ms(heartbeat_ms_);
+    return grpc::Status::OK;
+}
+
+grpc::Status ClusterCoordinator::place(const std::string& node_id,
+                                       const std::shared_ptr<Stub>& stub,
+                                       grpc::ClientContext* context,
+                                       const SimulationRequest& request, double cost,
+                                       SimulationResponse* response) {
+    const grpc::Status status = stub->StartSimulation(context, request, response);
+    if (status.ok()) {
+        // Counted until the node's next report includes it
+        std::lock_guard<std::mutex> lock(mutex_);
+        owners_[request.simulation_id()] = node_id;
+        NodeStatus& load = nodes_[node_id].status;
+        load.set_queued_jobs(load.queued_jobs() + 1);
+        load.set_queued_cost(load.queued_cost() + cost);
+        load.set_outstanding_cost(load.outstanding_cost() + cost);
+    }
+    return status;
+}
+
+grpc::Status ClusterCoordinator::startSimulation(grpc::ServerContext* context,
+                                                 SimulationRequest request,
+                                                 SimulationResponse* response) {
+    if (!request.upload_id().empty()) {
+        return grpc::Status(grpc::StatusCode::FAILED_PRECONDITION,
+                          "Uploads stay on the node they were sent to; send the patient data "
+                          "inline to a coordinator");
+    }
+
+    const double cost = JobScheduler::estimateCost(request.params());
+    std::set<std::string> tried;
+    grpc::Status last(grpc::StatusCode::UNAVAILABLE, "No node can take the simulation");
+    while (true) {
+        std::vector<NodeStatus> nodes = liveNodes();
+        nodes.erase(std::remove_if(nodes.begin(), nodes.end(),
+                                   [&tried](const NodeStatus& node) {
+                                       return tried.count(node.node_id()) > 0;
+                                   }),
+                    nodes.end());
+        const int pick = pickNode(nodes, cost);
+        if (pick < 0) {
+            return last;
+        }
+        const std::string node_id = nodes[pick].node_id();
+        tried.insert(node_id);
+
+        auto client = grpc::ClientContext::FromServerContext(*context);
+        const grpc::Status status = place(node_id, stub(node_id), client.get(), request, cost,
+                                          response);
+        // A full or unreachable node is skipped; anything else is the request's own fault
+        if (status.error_code() != grpc::StatusCode::RESOURCE_EXHAUSTED &&
+            status.error_code() != grpc::StatusCode::UNAVAILABLE) {
+            return status;
+        }
+        last = status;
+    }
+}
+
+grpc::Status ClusterCoordinator::startEnsemble(grpc::ServerContext* context,
+                                               const EnsembleRequest& request, double cost,
+                                               EnsembleResponse* response) {
+    if (!request.base().upload_id().empty()) {
+        return grpc::Status(grpc::StatusCode::FAILED_PRECONDITION,
+                          "Uploads stay on the node they were sent to; send the patient data "
+                          "inline to a coordinator");
+    }
+
+    // Members share their initial state, so an ensemble stays on one node
+    std::set<std::string> tried;
+    grpc::Status last(grpc::StatusCode::UNAVAILABLE, "No node can take the ensemble");
+    while (true) {
+        std::vector<NodeStatus> nodes = liveNodes();
+        nodes.erase(std::remove_if(nodes.begin(), nodes.end(),
+                                   [&tried](const NodeStatus& node) {
+                                       return tried.count(node.node_id()) > 0;
+                                   }),
+                    nodes.end());
+        const int pick = pickNode(nodes, cost);
+        if (pick < 0) {
+            return last;
+        }
+        const std::string node_id = nodes[pick].node_id();
+        tried.insert(node_id);
+
+        auto client = grpc::ClientContext::FromServerContext(*context);
+        const grpc::Status status = stub(node_id)->StartEnsemble(client.get(), request, response);
+        if (status.ok()) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            owners_[response->ensemble_id()] = node_id;
+            for (const std::string& simulation_id : response->simulation_ids()) {
+                owners_[simulation_id] = node_id;
+            }
+            NodeStatus& load = nodes_[node_id].status;
+            load.set_queued_jobs(load.queued_jobs() + response->simulation_ids_size());
+            load.set_queued_cost(load.queued_cost() + cost);
+            load.set_outstanding_cost(load.outstanding_cost() + cost);
+            return status;
+        }
+        if (status.error_code() != grpc::StatusCode::RESOURCE_EXHAUSTED &&
+            status.error_code() != grpc::StatusCode::UNAVAILABLE) {
+            return status;
+        }
+        last = status;
+    }
+}
+
+grpc::Status ClusterCoordinator::forward(
+    grpc::ServerContext* context, const std::string& id,
+    const std::function<grpc::Status(Stub&, grpc::ClientContext*)>& call) {
+
+    auto ask = [&](const std::string& node_id) {
+        std::shared_ptr<Stub> node_stub = stub(node_id);
+        auto client = grpc::ClientContext::FromServerContext(*context);
+        return call(*node_stub, client.get());
+    };
+
+    std::set<std::string> asked;
+    grpc::Status status(grpc::StatusCode::NOT_FOUND, "Not found on any node: " + id);
+    for (std::string node_id = owner(id); !node_id.empty() && asked.insert(node_id).second;
+         node_id = owner(id)) {
+        status = ask(node_id);
+        if (status.error_code() != grpc::StatusCode::NOT_FOUND) {
+            return status;
+        }
+        // Dropped after work stealing moved it: the owner changed before that
+    }
+
+    // Started on a node directly, or before this coordinator came up
+    for (const NodeStatus& node : liveNodes()) {
+        if (asked.count(node.node_id()) > 0) {
+            continue;
+        }
+        status = ask(node.node_id());
+        if (status.error_code() != grpc::StatusCode::NOT_FOUND) {
+            if (status.ok()) {
+                std::lock_guard<std::mutex> lock(mutex_);
+                owners_.emplace(id, node.node_id());
+            }
+            return status;
+        }
+    }
+    return status;
+}
+
+grpc::Status ClusterCoordinator::getEnsembleStatus(grpc::ServerContext* context,
+                                                   const EnsembleStatusRequest& request,
+                                                   EnsembleStatusResponse* response) {
+    return forward(context, request.ensemble_id(), [&](Stub& node, grpc::ClientContext* client) {
+        return node.GetEnsembleStatus(client, request, response);
+    });
+}
+
+grpc::Status ClusterCoordinator::getSimulationStatus(grpc::ServerContext* context,
+                                                     const StatusRequest& request,
+                                                     StatusResponse* response) {
+    return forward(context, request.simulation_id(),
+                   [&](Stub& node, grpc::ClientContext* client) {
+                       return node.GetSimulationStatus(client, request, response);
+                   });
+}
+
+grpc::Status ClusterCoordinator::getSimulationResults(grpc::ServerContext* context,
+                                                      const ResultsRequest& request,
+                                                      grpc::ServerWriter<ResultsChunk>* writer) {
+    // Chunks are passed on as they arrive; a slow client holds back the node's stream
+    return forward(context, request.simulation_id(),
+                   [&](Stub& node, grpc::ClientContext* client) {
+                       auto reader = node.GetSimulationResults(client, request);
+                       ResultsChunk chunk;
+                       while (reader->Read(&chunk)) {
+                           if (!writer->Write(chunk)) {
+                               client->TryCancel();
+                               break;
+                           }
+                       }
+                       return reader->Finish();
+                   });
+}
+
+grpc::Status ClusterCoordinator::getMetricHistory(grpc::ServerContext* context,
+                                                  const MetricHistoryRequest& request,
+                                                  MetricHistory* response) {
+    return forward(context, request.simulation_id(),
+                   [&](Stub& node, grpc::ClientContext* client) {
+                       return node.GetMetricHistory(client, request, response);
+                   });
+}
+
+grpc::Status ClusterCoordinator::stopSimulation(grpc::ServerContext* context,
+                                                const StopRequest& request,
+                                                StopResponse* response) {
+    return forward(context, request.simulation_id(),
+                   [&](Stub& node, grpc::ClientContext* client) {
+                       return node.StopSimulation(client, request, response);
+                   });
+}
+
+grpc::Status ClusterCoordinator::listSimulations(grpc::ServerContext* context,
+                                                 const ListRequest& request,
+                                                 SimulationList* response) {
+    const int64_t limit = request.limit() > 0
+        ? std::min(request.limit(), SimulationServiceImpl::kMaxListLimit)
+        : SimulationServiceImpl::kDefaultListLimit;
+    const int64_t wanted = static_cast<int64_t>(request.offset()) + limit;
+
+    // Each node's matches, oldest first, read a page at a time; a node serves at most
+    // kMaxListLimit per page, so deep pages take several
+    struct NodeCursor {
+        std::string node_id;
+        SimulationList page;
+        int next = 0;             // Next summary of `page`
+        int64_t node_offset = 0;  // Offset of the node's page after `page`
+        int64_t total = 0;
+    };
+    auto fetch = [&](NodeCursor& cursor, int64_t needed) {
+        ListRequest node_request = request;
+        node_request.set_offset(static_cast<int32_t>(cursor.node_offset));
+        node_request.set_limit(static_cast<int32_t>(
+            std::min<int64_t>(needed, SimulationServiceImpl::kMaxListLimit)));
+        cursor.page.Clear();
+        cursor.next = 0;
+        auto client = grpc::ClientContext::FromServerContext(*context);
+        const grpc::Status status =
+            stub(cursor.node_id)->ListSimulations(client.get(), node_request, &cursor.page);
+        if (!status.ok()) {
+            return grpc::Status(status.error_code(),
+                              "Node " + cursor.node_id + ": " + status.error_message());
+        }
+        cursor.total = cursor.page.total_count();
+        // A node that lost matches since its last page has nothing more to give
+        cursor.node_offset = cursor.page.simulations_size() > 0
+            ? cursor.node_offset + cursor.page.simulations_size()
+            : cursor.total;
+        return grpc::Status::OK;
+    };
+
+    std::vector<NodeCursor> cursors;
+    int64_t total_count = 0;
+    for (const NodeStatus& node : liveNodes()) {
+        cursors.push_back(NodeCursor{node.node_id()});
+        const grpc::Status status = fetch(cursors.back(), wanted);
+        if (!status.ok()) {
+            return status;
+        }
+        total_count += cursors.back().total;
+    }
+
+    // Merge the nodes oldest first, ties in node order, up to the end of the requested page
+    for (int64_t position = 0; position < wanted; ++position) {
+        NodeCursor* oldest = nullptr;
+        for (NodeCursor& cursor : cursors) {
+            if (cursor.next == cursor.page.simulations_size() &&
+                cursor.node_offset < cursor.total) {
+                const grpc::Status status = fetch(cursor, wanted - position);
+                if (!status.ok()) {
+                    return status;
+                }
+            }
+            if (cursor.next < cursor.page.simulations_size() &&
+                (!oldest || cursor.page.simulations(cursor.next).created_at() <
+                                oldest->page.simulations(oldest->next).created_at())) {
+                oldest = &cursor;
+            }
+        }
+        if (!oldest) {
+            break;
+        }
+        SimulationSummary* summary = oldest->page.mutable_simulations(oldest->next++);
+        if (position >= request.offset()) {
+            *response->add_simulations() = std::move(*summary);
+        }
+    }
+    response->set_total_count(static_cast<int32_t>(
+        std::min<int64_t>(total_count, std::numeric_limits<int32_t>::max())));
+    return grpc::Status::OK;
+}
+
+// ============================================================================
+// ClusterMember Implementation
+// ============================================================================
+
+ClusterMember::ClusterMember(SimulationServiceImpl& service,
+                             std::string coordinator_address, std::string node_id,
+                             int heartbeat_ms)
+    : service_(service),
+      node_id_(std::move(node_id)),
+      stub_(SimulationService::NewStub(grpc::CreateChannel(
+          coordinator_address, grpc::InsecureChannelCredentials()))),
+      heartbeat_ms_(heartbeat_ms > 0 ? heartbeat_ms : ClusterCoordinator::kDefaultHeartbeatMs) {
+}
+
+ClusterMember::~ClusterMember() {
+    stop();
+}
+
+void ClusterMember::start() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!thread_.joinable()) {
+        stopping_ = false;
+        thread_ = std::thread(&ClusterMember::run, this);
+    }
+}
+
+void ClusterMember::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    cv_.notify_all();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+bool ClusterMember::registered() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return registered_;
+}
+
+void ClusterMember::run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stopping_) {
+        const auto timeout = std::chrono::milliseconds(heartbeat_ms_);
+        lock.unlock();
+
+        service_.expireReleases();
+        NodeStatus status;
+        service_.nodeStatus(&status);
+        status.set_node_id(node_id_);
+        NodeStatusResponse response;
+        grpc::ClientContext context;
+        context.set_deadline(std::chrono::system_clock::now() + timeout);
+        const grpc::Status result = stub_->ReportNodeStatus(&context, status, &response);
+
+        lock.lock();
+        if (registered_ && !result.ok()) {
+            std::cerr << "Lost the coordinator: " << result.error_message() << std::endl;
+        }
+        registered_ = result.ok();
+        if (result.ok() && response.heartbeat_interval_ms() > 0) {
+            heartbeat_ms_ = response.heartbeat_interval_ms();
+        }
+        cv_.wait_for(lock, std::chrono::milliseconds(heartbeat_ms_), [this] { return stopping_; });
+    }
+}
+
+} // namespace tumordtwin
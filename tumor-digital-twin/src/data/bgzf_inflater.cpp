@@ -0,0 +1,263 @@
+#include "data/bgzf_inflater.h"
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include <zlib.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace tumordtwin {
+
+namespace {
+
+constexpr size_t kGzipHeaderBytes = 12;   // Up to and including XLEN
+constexpr size_t kDetectBytes = 18;       // Fixed BGZF header with its BC subfield
+constexpr size_t kGzipTrailerBytes = 8;   // CRC32 and ISIZE
+constexpr size_t kGzipChunkBytes = 64 * 1024;
+constexpr size_t kMaxBgzfBlockOutput = 64 * 1024;  // SAM/BAM spec limit on ISIZE
+
+int resolveThreads(int requested) {
+#ifdef _OPENMP
+    return requested > 0 ? requested : omp_get_max_threads();
+#else
+    (void)requested;
+    return 1;
+#endif
+}
+
+uint16_t readU16(const char* p) {
+    return static_cast<uint16_t>(static_cast<uint8_t>(p[0]) | (static_cast<uint8_t>(p[1]) << 8));
+}
+
+uint32_t readU32(const char* p) {
+    uint32_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+bool hasGzipMagic(const char* p) {
+    return static_cast<uint8_t>(p[0]) == 0x1f && static_cast<uint8_t>(p[1]) == 0x8b;
+}
+
+// Size of the BGZF block at p: 0 when more bytes are needed, -1 when p is not a BGZF block
+long bgzfBlockSize(const char* p, size_t available) {
+    if (available < kGzipHeaderBytes) {
+        return 0;
+    }
+    if (!hasGzipMagic(p) || static_cast<uint8_t>(p[2]) != 8 || !(static_cast<uint8_t>(p[3]) & 4)) {
+        return -1;
+    }
+    const size_t xlen = readU16(p + 10);
+    if (available < kGzipHeaderBytes + xlen) {
+        return 0;
+    }
+    // Find the BC subfield holding the total block size minus one
+    for (size_t offset = kGzipHeaderBytes; offset + 4 <= kGzipHeaderBytes + xlen;) {
+        const size_t slen = readU16(p + offset + 2);
+        if (p[offset] == 'B' && p[offset + 1] == 'C' && slen == 2) {
+            const size_t size = static_cast<size_t>(readU16(p + offset + 4)) + 1;
+            return size >= kGzipHeaderBytes + xlen + kGzipTrailerBytes ? static_cast<long>(size) : -1;
+        }
+        offset += 4 + slen;
+    }
+    return -1;
+}
+
+struct Block {
+    size_t offset;     // In the pending input
+    size_t size;
+    size_t out_offset;
+    size_t out_size;
+};
+
+bool inflateBlock(const char* block, size_t size, char* out, size_t out_size) {
+    const size_t header = kGzipHeaderBytes + readU16(block + 10);
+    z_stream stream{};
+    if (inflateInit2(&stream, -MAX_WBITS) != Z_OK) {
+        return false;
+    }
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(block + header));
+    stream.avail_in = static_cast<uInt>(size - header - kGzipTrailerBytes);
+    stream.next_out = reinterpret_cast<Bytef*>(out);
+    stream.avail_out = static_cast<uInt>(out_size);
+    const int result = inflate(&stream, Z_FINISH);
+    const bool complete = result == Z_STREAM_END && stream.avail_out == 0;
+    inflateEnd(&stream);
+    if (!complete) {
+        return false;
+    }
+    const uint32_t crc = readU32(block + size - kGzipTrailerBytes);
+    return crc32(0L, reinterpret_cast<const Bytef*>(out), static_cast<uInt>(out_size)) == crc;
+}
+
+} // namespace
+
+struct BgzfInflater::GzipStream {
+    z_stream stream{};
+    bool in_member = false;
+    std::vector<char> buffer;
+
+    GzipStream() : buffer(kGzipChunkBytes) { inflateInit2(&stream, MAX_WBITS + 16); }
+    ~GzipStream() { inflateEnd(&stream); }
+};
+
+// ============================================================================
+// BgzfInflater Implementation
+// ============================================================================
+
+BgzfInflater::BgzfInflater(int num_threads)
+    : num_threads_(num_threads) {
+}
+
+BgzfInflater::~BgzfInflater() = default;
+
+bool BgzfInflater::feed(const char* data, size_t size, std::string* out, std::string& error_msg) {
+    bytes_in_ += size;
+    if (format_ != Format::Unknown) {
+        return consume(data, size, out, error_msg);
+    }
+
+    pending_.append(data, size);
+    if (pending_.size() < kDetectBytes) {
+        return true;
+    }
+    detect();
+    std::string prefix;
+    prefix.swap(pending_);
+    return consume(prefix.data(), prefix.size(), out, error_msg);
+}
+
+bool BgzfInflater::finish(std::string* out, std::string& error_msg) {
+    if (format_ == Format::Unknown) {
+        if (pending_.size() >= 2 && hasGzipMagic(pending_.data())) {
+            error_msg = "Truncated gzip stream";
+            return false;
+        }
+        format_ = Format::Raw;
+        out->append(pending_);
+        pending_.clear();
+        return true;
+    }
+    if (format_ == Format::Bgzf && !pending_.empty()) {
+        error_msg = "Truncated BGZF block at end of stream";
+        return false;
+    }
+    if (format_ == Format::Gzip && gzip_ && gzip_->in_member) {
+        error_msg = "Truncated gzip stream";
+        return false;
+    }
+    return true;
+}
+
+void BgzfInflater::detect() {
+    if (!hasGzipMagic(pending_.data())) {
+        format_ = Format::Raw;
+    } else if (bgzfBlockSize(pending_.data(), pending_.size()) > 0) {
+        format_ = Format::Bgzf;
+    } else {
+        format_ = Format::Gzip;
+        gzip_ = std::make_unique<GzipStream>();
+    }
+}
+
+bool BgzfInflater::consume(const char* data, size_t size, std::string* out,
+                           std::string& error_msg) {
+    switch (format_) {
+        case Format::Raw:
+            out->append(data, size);
+            return true;
+        case Format::Gzip:
+            return inflateGzip(data, size, out, error_msg);
+        case Format::Bgzf:
+            pending_.append(data, size);
+            return inflateBlocks(out, error_msg);
+        case Format::Unknown:
+            break;
+    }
+    return true;
+}
+
+bool BgzfInflater::inflateBlocks(std::string* out, std::string& error_msg) {
+    // Cut the complete blocks out of the pending bytes
+    std::vector<Block> blocks;
+    size_t offset = 0;
+    size_t out_size = out->size();
+    while (offset < pending_.size()) {
+        const long size = bgzfBlockSize(pending_.data() + offset, pending_.size() - offset);
+        if (size < 0) {
+            error_msg = "Corrupt BGZF block header";
+            return false;
+        }
+        if (size == 0 || static_cast<size_t>(size) > pending_.size() - offset) {
+            break;
+        }
+        const size_t block_out = readU32(pending_.data() + offset + size - 4);
+        if (block_out > kMaxBgzfBlockOutput) {
+            error_msg = "BGZF block claims " + std::to_string(block_out) + " inflated bytes";
+            return false;
+        }
+        blocks.push_back({offset, static_cast<size_t>(size), out_size, block_out});
+        offset += static_cast<size_t>(size);
+        out_size += block_out;
+    }
+    if (blocks.empty()) {
+        return true;
+    }
+
+    // Every block knows where its output goes, so they inflate independently
+    out->resize(out_size);
+    char* base = &(*out)[0];
+    const long count = static_cast<long>(blocks.size());
+    int failed = 0;
+    #pragma omp parallel for schedule(dynamic) num_threads(resolveThreads(num_threads_)) reduction(|:failed) if(count > 1)
+    for (long b = 0; b < count; ++b) {
+        const Block& block = blocks[b];
+        if (!inflateBlock(pending_.data() + block.offset, block.size,
+                          base + block.out_offset, block.out_size)) {
+            failed |= 1;
+        }
+    }
+    pending_.erase(0, offset);
+    if (failed) {
+        error_msg = "Corrupt BGZF block data";
+        return false;
+    }
+    return true;
+}
+
+bool BgzfInflater::inflateGzip(const char* data, size_t size, std::string* out,
+                               std::string& error_msg) {
+    z_stream& stream = gzip_->stream;
+    std::vector<char>& buffer = gzip_->buffer;
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+    stream.avail_in = static_cast<uInt>(size);
+    while (true) {
+        stream.next_out = reinterpret_cast<Bytef*>(buffer.data());
+        stream.avail_out = static_cast<uInt>(buffer.size());
+        const int result = inflate(&stream, Z_NO_FLUSH);
+        if (result != Z_OK && result != Z_STREAM_END && result != Z_BUF_ERROR) {
+            error_msg = "Corrupt gzip stream";
+            return false;
+        }
+        out->append(buffer.data(), buffer.size() - stream.avail_out);
+        if (result == Z_STREAM_END) {
+            // Concatenated members continue the same stream
+            gzip_->in_member = false;
+            inflateReset(&stream);
+            if (stream.avail_in == 0) {
+                return true;
+            }
+            continue;
+        }
+        gzip_->in_member = true;
+        // Done once the input is used up and zlib has no more output buffered
+        if (result == Z_BUF_ERROR || (stream.avail_in == 0 && stream.avail_out != 0)) {
+            return true;
+        }
+    }
+}
+
+} // namespace tumordtwin
@@ -0,0 +1,428 @@
+#include "data/dicom_volume.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+namespace tumordtwin {
+
+namespace {
+
+constexpr size_t kPreambleBytes = 128;
+constexpr size_t kMagicBytes = 4;
+constexpr uint32_t kUndefinedLength = 0xFFFFFFFF;
+constexpr int kMaxSequenceDepth = 16;
+
+constexpr const char* kExplicitVrLittleEndian = "1.2.840.10008.1.2.1";
+constexpr const char* kImplicitVrLittleEndian = "1.2.840.10008.1.2";
+
+constexpr uint32_t tag(uint16_t group, uint16_t element) {
+    return (static_cast<uint32_t>(group) << 16) | element;
+}
+
+constexpr uint32_t kTagTransferSyntax = tag(0x0002, 0x0010);
+constexpr uint32_t kTagSliceThickness = tag(0x0018, 0x0050);
+constexpr uint32_t kTagSpacingBetweenSlices = tag(0x0018, 0x0088);
+constexpr uint32_t kTagInstanceNumber = tag(0x0020, 0x0013);
+constexpr uint32_t kTagImagePosition = tag(0x0020, 0x0032);
+constexpr uint32_t kTagSamplesPerPixel = tag(0x0028, 0x0002);
+constexpr uint32_t kTagNumberOfFrames = tag(0x0028, 0x0008);
+constexpr uint32_t kTagRows = tag(0x0028, 0x0010);
+constexpr uint32_t kTagColumns = tag(0x0028, 0x0011);
+constexpr uint32_t kTagPixelSpacing = tag(0x0028, 0x0030);
+constexpr uint32_t kTagBitsAllocated = tag(0x0028, 0x0100);
+constexpr uint32_t kTagPixelRepresentation = tag(0x0028, 0x0103);
+constexpr uint32_t kTagRescaleIntercept = tag(0x0028, 0x1052);
+constexpr uint32_t kTagRescaleSlope = tag(0x0028, 0x1053);
+constexpr uint32_t kTagPixelData = tag(0x7FE0, 0x0010);
+
+constexpr uint32_t kTagItem = tag(0xFFFE, 0xE000);
+constexpr uint32_t kTagItemDelimiter = tag(0xFFFE, 0xE00D);
+constexpr uint32_t kTagSequenceDelimiter = tag(0xFFFE, 0xE0DD);
+
+template <typename T>
+T readLe(const char* p) {
+    T value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+// Explicit VRs whose length field is 32 bits, after two reserved bytes
+bool hasLongLength(const char* vr) {
+    static constexpr const char* kLongVrs[] = {"OB", "OD", "OF", "OL", "OV", "OW", "SQ",
+                                               "SV", "UC", "UN", "UR", "UT", "UV"};
+    for (const char* candidate : kLongVrs) {
+        if (vr[0] == candidate[0] && vr[1] == candidate[1]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+struct Element {
+    uint32_t tag = 0;
+    uint32_t length = 0;
+    size_t value = 0;  // Offset of the value
+};
+
+// Element headers of one file, over either little-endian VR encoding
+class ElementCursor {
+public:
+    ElementCursor(std::string_view data, size_t pos) : data_(data), pos_(pos) {}
+
+    bool atEnd() const { return pos_ >= data_.size(); }
+    size_t pos() const { return pos_; }
+    void setExplicitVr(bool explicit_vr) { explicit_vr_ = explicit_vr; }
+
+    // Header of the next element; the cursor is left at its value
+    bool next(Element* element, std::string& error_msg) {
+        if (data_.size() - pos_ < 8) {
+            error_msg = "Truncated DICOM element header";
+            return false;
+        }
+        const char* p = data_.data() + pos_;
+        element->tag = tag(readLe<uint16_t>(p), readLe<uint16_t>(p + 2));
+        const bool delimiter = (element->tag >> 16) == 0xFFFE;
+        if (!explicit_vr_ || delimiter) {
+            element->length = readLe<uint32_t>(p + 4);
+            pos_ += 8;
+        } else if (hasLongLength(p + 4)) {
+            if (data_.size() - pos_ < 12) {
+                error_msg = "Truncated DICOM element header";
+                return false;
+            }
+            element->length = readLe<uint32_t>(p + 8);
+            pos_ += 12;
+        } else {
+            element->length = readLe<uint16_t>(p + 6);
+            pos_ += 8;
+        }
+        element->value = pos_;
+        if (element->length != kUndefinedLength && element->length > data_.size() - pos_) {
+            error_msg = "Truncated DICOM element value";
+            return false;
+        }
+        return true;
+    }
+
+    // Step over the value of the element just read
+    bool skip(const Element& element, std::string& error_msg, int depth = 0) {
+        if (element.length != kUndefinedLength) {
+            pos_ = element.value + element.length;
+            return true;
+        }
+        return skipSequence(error_msg, depth);
+    }
+
+    std::string_view value(const Element& element) const {
+        return data_.substr(element.value, element.length);
+    }
+
+private:
+    // Items of an undefined-length sequence, up to its delimiter
+    bool skipSequence(std::string& error_msg, int depth) {
+        if (depth >= kMaxSequenceDepth) {
+            error_msg = "DICOM sequences nested too deeply";
+            return false;
+        }
+        Element item;
+        while (next(&item, error_msg)) {
+            if (item.tag == kTagSequenceDelimiter) {
+                return true;
+            }
+            if (item.tag != kTagItem) {
+                error_msg = "Malformed DICOM sequence";
+                return false;
+            }
+            if (item.length != kUndefinedLength) {
+                pos_ = item.value + item.length;
+                continue;
+            }
+            Element element;
+            for (;;) {
+                if (!next(&element, error_msg)) {
+                    return false;
+                }
+                if (element.tag == kTagItemDelimiter) {
+                    break;
+                }
+                if (!skip(element, error_msg, depth + 1)) {
+                    return false;
+                }
+            }
+        }
+        return false;
+    }
+
+    std::string_view data_;
+    size_t pos_;
+    bool explicit_vr_ = true;
+};
+
+std::string_view trimValue(std::string_view value) {
+    while (!value.empty() && (value.back() == ' ' || value.back() == '\0')) {
+        value.remove_suffix(1);
+    }
+    while (!value.empty() && value.front() == ' ') {
+        value.remove_prefix(1);
+    }
+    return value;
+}
+
+// The n-th number of a backslash-separated DS or IS value
+bool numberAt(std::string_view value, size_t n, double* out) {
+    for (size_t i = 0; i < n; ++i) {
+        const size_t sep = value.find('\\');
+        if (sep == std::string_view::npos) {
+            return false;
+        }
+        value.remove_prefix(sep + 1);
+    }
+    const std::string text(trimValue(value.substr(0, value.find('\\'))));
+    if (text.empty()) {
+        return false;
+    }
+    char* end = nullptr;
+    *out = std::strtod(text.c_str(), &end);
+    return end == text.c_str() + text.size();
+}
+
+// A Part 10 file starts with a 128-byte preamble and "DICM"
+bool hasPreamble(std::string_view bytes) {
+    return bytes.size() >= kPreambleBytes + kMagicBytes &&
+           bytes.compare(kPreambleBytes, kMagicBytes, "DICM") == 0;
+}
+
+// Image attributes and pixels of one file
+struct Slice {
+    int rows = 0;
+    int columns = 0;
+    int frames = 1;
+    int bits_allocated = 0;
+    int pixel_representation = 0;
+    int samples_per_pixel = 1;
+    double row_spacing = 1.0;
+    double column_spacing = 1.0;
+    double thickness = 0.0;
+    double spacing_between = 0.0;
+    bool has_position = false;
+    double z = 0.0;
+    double instance = 0.0;
+    double slope = 1.0;
+    double intercept = 0.0;
+    std::string_view pixels;
+    size_t end = 0;  // Offset just past this file in the archive
+};
+
+// One Part 10 file starting at `start`
+bool parseFile(std::string_view archive, size_t start, Slice* slice, std::string& error_msg) {
+    ElementCursor cursor(archive, start + kPreambleBytes + kMagicBytes);
+    // The file meta group is always explicit VR; the data set follows the transfer syntax
+    bool in_meta = true;
+    bool have_syntax = false;
+    bool explicit_vr = true;
+    Element element;
+    while (!cursor.atEnd()) {
+        const size_t header = cursor.pos();
+        if (in_meta && archive.size() - header >= 2 &&
+            readLe<uint16_t>(archive.data() + header) != 0x0002) {
+            if (!have_syntax) {
+                error_msg = "DICOM file has no transfer syntax";
+                return false;
+            }
+            cursor.setExplicitVr(explicit_vr);
+            in_meta = false;
+        }
+        if (!cursor.next(&element, error_msg)) {
+            return false;
+        }
+        const std::string_view value =
+            element.length != kUndefinedLength ? cursor.value(element) : std::string_view();
+        auto us = [&]() { return value.size() >= 2 ? readLe<uint16_t>(value.data()) : 0; };
+        double number = 0.0;
+
+        switch (element.tag) {
+            case kTagTransferSyntax: {
+                const std::string_view syntax = trimValue(value);
+                if (syntax == kExplicitVrLittleEndian) {
+                    explicit_vr = true;
+                } else if (syntax == kImplicitVrLittleEndian) {
+                    explicit_vr = false;
+                } else {
+                    error_msg = "Unsupported DICOM transfer syntax " + std::string(syntax);
+                    return false;
+                }
+                have_syntax = true;
+                break;
+            }
+            case kTagSliceThickness:
+                numberAt(value, 0, &slice->thickness);
+                break;
+            case kTagSpacingBetweenSlices:
+                numberAt(value, 0, &slice->spacing_between);
+                break;
+            case kTagInstanceNumber:
+                numberAt(value, 0, &slice->instance);
+                break;
+            case kTagImagePosition:
+                slice->has_position = numberAt(value, 2, &slice->z);
+                break;
+            case kTagSamplesPerPixel:
+                slice->samples_per_pixel = us();
+                break;
+            case kTagNumberOfFrames:
+                if (numberAt(value, 0, &number)) {
+                    slice->frames = static_cast<int>(number);
+                }
+                break;
+            case kTagRows:
+                slice->rows = us();
+                break;
+            case kTagColumns:
+                slice->columns = us();
+                break;
+            case kTagPixelSpacing:
+                numberAt(value, 0, &slice->row_spacing);
+                numberAt(value, 1, &slice->column_spacing);
+                break;
+            case kTagBitsAllocated:
+                slice->bits_allocated = us();
+                break;
+            case kTagPixelRepresentation:
+                slice->pixel_representation = us();
+                break;
+            case kTagRescaleIntercept:
+                numberAt(value, 0, &slice->intercept);
+                break;
+            case kTagRescaleSlope:
+                numberAt(value, 0, &slice->slope);
+                break;
+            case kTagPixelData:
+                if (element.length == kUndefinedLength) {
+                    error_msg = "Encapsulated DICOM pixel data is not supported";
+                    return false;
+                }
+                slice->pixels = value;
+                // Trailing elements belong to this file, up to the next preamble
+                if (!cursor.skip(element, error_msg)) {
+                    return false;
+                }
+                while (!cursor.atEnd() && !hasPreamble(archive.substr(cursor.pos()))) {
+                    if (!cursor.next(&element, error_msg) || !cursor.skip(element, error_msg)) {
+                        return false;
+                    }
+                }
+                slice->end = cursor.pos();
+                return true;
+            default:
+                break;
+        }
+        if (!cursor.skip(element, error_msg)) {
+            return false;
+        }
+    }
+    error_msg = "DICOM file has no pixel data";
+    return false;
+}
+
+} // namespace
+
+// ============================================================================
+// DicomVolume Implementation
+// ============================================================================
+
+bool DicomVolume::isDicom(std::string_view bytes) {
+    return hasPreamble(bytes);
+}
+
+bool DicomVolume::parse(std::string_view archive, std::string& error_msg) {
+    nx_ = ny_ = nz_ = 0;
+    values_.clear();
+
+    std::vector<Slice> slices;
+    size_t offset = 0;
+    while (offset < archive.size()) {
+        if (!isDicom(archive.substr(offset))) {
+            error_msg = "Expected a DICOM file at archive offset " + std::to_string(offset);
+            return false;
+        }
+        Slice slice;
+        if (!parseFile(archive, offset, &slice, error_msg)) {
+            return false;
+        }
+        if (slice.samples_per_pixel != 1 ||
+            (slice.bits_allocated != 8 && slice.bits_allocated != 16)) {
+            error_msg = "Only 8- and 16-bit monochrome DICOM images are supported";
+            return false;
+        }
+        if (slice.rows <= 0 || slice.columns <= 0 || slice.frames <= 0) {
+            error_msg = "DICOM image has no rows, columns or frames";
+            return false;
+        }
+        const size_t pixel_bytes = static_cast<size_t>(slice.rows) * slice.columns *
+                                   slice.frames * (slice.bits_allocated / 8);
+        if (slice.pixels.size() < pixel_bytes) {
+            error_msg = "DICOM pixel data is shorter than the image";
+            return false;
+        }
+        if (!slices.empty() &&
+            (slice.rows != slices[0].rows || slice.columns != slices[0].columns)) {
+            error_msg = "DICOM slices of different shapes";
+            return false;
+        }
+        offset = slice.end;
+        slices.push_back(slice);
+    }
+    if (slices.empty()) {
+        error_msg = "DICOM archive is empty";
+        return false;
+    }
+
+    // Position order when every slice has one, acquisition order otherwise
+    const bool positioned = std::all_of(slices.begin(), slices.end(),
+                                        [](const Slice& s) { return s.has_position; });
+    std::stable_sort(slices.begin(), slices.end(), [positioned](const Slice& a, const Slice& b) {
+        return positioned ? a.z < b.z : a.instance < b.instance;
+    });
+
+    const Slice& first = slices.front();
+    nx_ = first.columns;
+    ny_ = first.rows;
+    dx_ = first.column_spacing > 0.0 ? first.column_spacing : 1.0;
+    dy_ = first.row_spacing > 0.0 ? first.row_spacing : 1.0;
+    if (positioned && slices.size() > 1 && slices.back().z > first.z) {
+        dz_ = (slices.back().z - first.z) / static_cast<double>(slices.size() - 1);
+    } else if (first.spacing_between > 0.0) {
+        dz_ = first.spacing_between;
+    } else {
+        dz_ = first.thickness > 0.0 ? first.thickness : 1.0;
+    }
+
+    size_t frames = 0;
+    for (const Slice& slice : slices) {
+        frames += static_cast<size_t>(slice.frames);
+    }
+    nz_ = static_cast<int>(frames);
+
+    const size_t plane = static_cast<size_t>(nx_) * ny_;
+    values_.resize(plane * frames);
+    float* out = values_.data();
+    for (const Slice& slice : slices) {
+        const size_t count = plane * static_cast<size_t>(slice.frames);
+        const char* p = slice.pixels.data();
+        const bool is_signed = slice.pixel_representation == 1;
+        for (size_t n = 0; n < count; ++n) {
+            double stored;
+            if (slice.bits_allocated == 8) {
+                stored = is_signed ? static_cast<int8_t>(p[n]) : static_cast<uint8_t>(p[n]);
+            } else {
+                const uint16_t raw = readLe<uint16_t>(p + 2 * n);
+                stored = is_signed ? static_cast<int16_t>(raw) : raw;
+            }
+            out[n] = static_cast<float>(stored * slice.slope + slice.intercept);
+        }
+        out += count;
+    }
+    return true;
+}
+
+} // namespace tumordtwin
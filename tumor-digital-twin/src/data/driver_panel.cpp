@@ -0,0 +1,49 @@
+#include "data/driver_panel.h"
+
+namespace tumordtwin {
+
+// ============================================================================
+// DriverPanel Implementation
+// ============================================================================
+
+const std::vector<DriverHotspot>& DriverPanel::hotspots() {
+    // KRAS, TP53 and IDH1 are on the reverse strand, so their alleles are
+    // the complement of the coding change
+    static const std::vector<DriverHotspot> panel = {
+        {"12", 25245350, 'C', 'T', "KRAS:G12D"},
+        {"12", 25245350, 'C', 'A', "KRAS:G12V"},
+        {"12", 25245351, 'C', 'A', "KRAS:G12C"},
+        {"7", 140753336, 'A', 'T', "BRAF:V600E"},
+        {"7", 55191822, 'T', 'G', "EGFR:L858R"},
+        {"3", 179234297, 'A', 'G', "PIK3CA:H1047R"},
+        {"3", 179218303, 'G', 'A', "PIK3CA:E545K"},
+        {"17", 7675088, 'C', 'T', "TP53:R175H"},
+        {"17", 7673802, 'C', 'T', "TP53:R273H"},
+        {"2", 208248388, 'C', 'T', "IDH1:R132H"},
+    };
+    return panel;
+}
+
+const DriverHotspot* DriverPanel::find(std::string_view chromosome, int64_t position,
+                                       std::string_view reference, std::string_view alternate) {
+    if (reference.size() != 1 || alternate.size() != 1) {
+        return nullptr;
+    }
+    chromosome = canonicalChromosome(chromosome);
+    for (const DriverHotspot& hotspot : hotspots()) {
+        if (hotspot.position == position && hotspot.chromosome == chromosome &&
+            hotspot.reference == reference[0] && hotspot.alternate == alternate[0]) {
+            return &hotspot;
+        }
+    }
+    return nullptr;
+}
+
+std::string_view DriverPanel::canonicalChromosome(std::string_view name) {
+    if (name.size() > 3 && name.substr(0, 3) == "chr") {
+        name.remove_prefix(3);
+    }
+    return name;
+}
+
+} // namespace tumordtwin
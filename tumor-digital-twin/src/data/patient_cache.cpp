@@ -0,0 +1,248 @@
+#include "data/patient_cache.h"
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+#include "data/patient_upload.h"
+#include "utils/sha256.h"
+
+namespace tumordtwin {
+
+namespace {
+
+// Bump when PatientModel::build changes what it derives, so old entries miss
+constexpr char kKeyVersion[] = "tumordtwin-patient-model-1";
+
+constexpr size_t kFileReadBytes = size_t{1} << 20;
+
+// Length-prefixed, tagged field so adjacent sources cannot run into each other
+void hashField(Sha256& hasher, char tag, std::string_view bytes) {
+    const uint64_t size = bytes.size();
+    hasher.update(&tag, 1);
+    hasher.update(&size, sizeof(size));
+    hasher.update(bytes);
+}
+
+bool hashFileField(Sha256& hasher, char tag, const std::string& path, std::string& error_msg) {
+    std::error_code ec;
+    const uint64_t size = std::filesystem::file_size(path, ec);
+    std::ifstream file(path, std::ios::binary);
+    if (ec || !file) {
+        error_msg = "Cannot read " + path;
+        return false;
+    }
+    hasher.update(&tag, 1);
+    hasher.update(&size, sizeof(size));
+    std::string buffer(kFileReadBytes, '\0');
+    uint64_t remaining = size;
+    while (remaining > 0) {
+        const uint64_t want = std::min<uint64_t>(remaining, buffer.size());
+        file.read(buffer.data(), static_cast<std::streamsize>(want));
+        const auto got = static_cast<uint64_t>(file.gcount());
+        if (got == 0) {
+            error_msg = "Cannot read " + path;
+            return false;
+        }
+        hasher.update(buffer.data(), got);
+        remaining -= got;
+    }
+    return true;
+}
+
+} // namespace
+
+// ============================================================================
+// PatientCache Implementation
+// ============================================================================
+
+PatientCache::PatientCache(std::string directory, size_t memory_budget, int num_threads)
+    : directory_(std::move(directory)),
+      memory_budget_(memory_budget),
+      num_threads_(num_threads) {
+}
+
+bool PatientCache::contentKey(const PatientData& data, std::string* key, std::string& error_msg) {
+    Sha256 hasher;
+    hasher.update(kKeyVersion);
+
+    const auto& metadata = data.metadata();
+    auto dicom_path = metadata.find(PatientUpload::kMetadataDicomPath);
+    if (dicom_path != metadata.end()) {
+        if (!hashFileField(hasher, 'd', dicom_path->second, error_msg)) {
+            return false;
+        }
+    } else {
+        hashField(hasher, 'd', data.dicom().dicom_archive());
+    }
+    hashField(hasher, 'b', data.genomic_sequences().bam_data());
+    for (const Mutation& mutation : data.vcf().mutations()) {
+        hashField(hasher, 'm', mutation.SerializeAsString());
+    }
+    for (const char* name : {PatientModel::kMetadataSegmentationLower,
+                             PatientModel::kMetadataSegmentationUpper}) {
+        auto it = metadata.find(name);
+        if (it != metadata.end()) {
+            hashField(hasher, 's', name);
+            hashField(hasher, 'v', it->second);
+        }
+    }
+    *key = hasher.hexDigest();
+    return true;
+}
+
+std::shared_ptr<const PatientModel> PatientCache::get(const PatientData& data,
+                                                      std::string& error_msg) {
+    std::string key;
+    if (!contentKey(data, &key, error_msg)) {
+        return nullptr;
+    }
+
+    std::promise<BuildResult> promise;
+    std::shared_future<BuildResult> pending;
+    bool builder = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = index_.find(key);
+        if (it != index_.end()) {
+            lru_.splice(lru_.begin(), lru_, it->second);
+            ++stats_.hits;
+            return it->second->model;
+        }
+        auto building = building_.find(key);
+        if (building != building_.end()) {
+            pending = building->second;
+            ++stats_.hits;
+        } else {
+            pending = promise.get_future().share();
+            building_.emplace(key, pending);
+            builder = true;
+        }
+    }
+
+    if (builder) {
+        BuildResult result;
+        try {
+            result = load(key, data);
+        } catch (const std::exception& e) {
+            result.error_msg = std::string("Preprocessing failed: ") + e.what();
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (result.model) {
+                insert(key, result.model);
+            }
+            building_.erase(key);
+        }
+        promise.set_value(std::move(result));
+    }
+
+    const BuildResult& result = pending.get();
+    if (!result.model) {
+        error_msg = result.error_msg;
+    }
+    return result.model;
+}
+
+PatientCache::Stats PatientCache::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+std::string PatientCache::modelPath(const std::string& key) const {
+    return (std::filesystem::path(directory_) / (key + ".model")).string();
+}
+
+PatientCache::BuildResult PatientCache::load(const std::string& key, const PatientData& data) {
+    BuildResult result;
+    result.model = readModel(key);
+    if (result.model) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++stats_.disk_hits;
+        return result;
+    }
+
+    auto model = std::make_shared<PatientModel>();
+    if (!PatientModel::build(data, model.get(), result.error_msg, num_threads_)) {
+        return result;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++stats_.misses;
+    }
+
+    // A failed write only costs a rebuild after eviction or restart
+    std::string error_msg;
+    if (!writeModel(key, *model, error_msg)) {
+        std::cerr << "Patient cache: " << error_msg << std::endl;
+    }
+    result.model = std::move(model);
+    return result;
+}
+
+std::shared_ptr<const PatientModel> PatientCache::readModel(const std::string& key) const {
+    std::ifstream file(modelPath(key), std::ios::binary);
+    if (!file) {
+        return nullptr;
+    }
+    PreprocessedPatient proto;
+    auto model = std::make_shared<PatientModel>();
+    std::string error_msg;
+    // Unreadable or foreign files are rebuilt over
+    if (!proto.ParseFromIstream(&file) || proto.content_key() != key ||
+        !model->fromProto(proto, error_msg)) {
+        return nullptr;
+    }
+    return model;
+}
+
+bool PatientCache::writeModel(const std::string& key, const PatientModel& model,
+                              std::string& error_msg) const {
+    std::error_code ec;
+    std::filesystem::create_directories(directory_, ec);
+    if (ec) {
+        error_msg = "Cannot create " + directory_ + ": " + ec.message();
+        return false;
+    }
+
+    PreprocessedPatient proto;
+    proto.set_content_key(key);
+    model.toProto(&proto);
+
+    // Renamed into place so a reader never sees a partial file
+    const std::string path = modelPath(key);
+    const std::string temp_path = path + ".tmp";
+    {
+        std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+        if (!file || !proto.SerializeToOstream(&file) || !file.flush()) {
+            error_msg = "Cannot write " + temp_path;
+            return false;
+        }
+    }
+    std::filesystem::rename(temp_path, path, ec);
+    if (ec) {
+        error_msg = "Cannot rename " + temp_path + ": " + ec.message();
+        std::filesystem::remove(temp_path, ec);
+        return false;
+    }
+    return true;
+}
+
+void PatientCache::insert(const std::string& key, std::shared_ptr<const PatientModel> model) {
+    const size_t bytes = model->memoryBytes();
+    if (bytes > memory_budget_) {
+        return;  // Served from disk only
+    }
+    lru_.push_front(Entry{key, std::move(model), bytes});
+    index_[key] = lru_.begin();
+    stats_.memory_bytes += bytes;
+    while (stats_.memory_bytes > memory_budget_) {
+        const Entry& oldest = lru_.back();
+        stats_.memory_bytes -= oldest.bytes;
+        index_.erase(oldest.key);
+        lru_.pop_back();
+    }
+    stats_.entries = lru_.size();
+}
+
+} // namespace tumordtwin
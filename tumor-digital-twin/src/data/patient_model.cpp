@@ -0,0 +1,302 @@
+#include "data/patient_model.h"
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <unordered_set>
+
+#include "common.pb.h"
+#include "data/bgzf_inflater.h"
+#include "data/dicom_volume.h"
+#include "data/driver_panel.h"
+#include "data/patient_upload.h"
+#include "data/read_parsers.h"
+
+namespace tumordtwin {
+
+namespace {
+
+constexpr double kDefaultSegmentationLower = 0.5;
+constexpr size_t kBamFeedBytes = size_t{1} << 20;
+
+bool readFile(const std::string& path, std::string* out, std::string& error_msg) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        error_msg = "Cannot open " + path;
+        return false;
+    }
+    std::ostringstream contents;
+    contents << file.rdbuf();
+    *out = contents.str();
+    return true;
+}
+
+bool metadataNumber(const PatientData& data, const char* key, double default_value,
+                    double* value, std::string& error_msg) {
+    auto it = data.metadata().find(key);
+    if (it == data.metadata().end()) {
+        *value = default_value;
+        return true;
+    }
+    char* end = nullptr;
+    *value = std::strtod(it->second.c_str(), &end);
+    if (it->second.empty() || end != it->second.c_str() + it->second.size()) {
+        error_msg = std::string("Metadata ") + key + " is not a number";
+        return false;
+    }
+    return true;
+}
+
+std::string mutationKey(const Mutation& mutation) {
+    return std::string(DriverPanel::canonicalChromosome(mutation.chromosome())) + ':' +
+           std::to_string(mutation.position()) + ':' + mutation.reference_allele() + '>' +
+           mutation.alternate_allele();
+}
+
+// Abstract site of a called mutation in Genotype.mutation_positions, stable across runs
+int32_t sitePosition(const std::string& key) {
+    uint32_t hash = 0x811c9dc5u;
+    for (unsigned char c : key) {
+        hash = (hash ^ c) * 0x01000193u;
+    }
+    return static_cast<int32_t>(hash);
+}
+
+double cancerCellFraction(const Mutation& mutation) {
+    const double frequency = mutation.allele_frequency();
+    return frequency > 0.0 ? std::min(1.0, 2.0 * frequency) : 1.0;
+}
+
+// Mutations called from inline BAM bytes
+bool callBamDrivers(const std::string& bam, int num_threads, VcfData* called,
+                    std::string& error_msg) {
+    BgzfInflater inflater(num_threads);
+    BamParser parser;
+    std::string inflated;
+    for (size_t offset = 0; offset < bam.size(); offset += kBamFeedBytes) {
+        inflated.clear();
+        if (!inflater.feed(bam.data() + offset, std::min(kBamFeedBytes, bam.size() - offset),
+                           &inflated, error_msg) ||
+            !parser.feed(inflated, error_msg)) {
+            return false;
+        }
+    }
+    inflated.clear();
+    if (!inflater.finish(&inflated, error_msg) || !parser.feed(inflated, error_msg) ||
+        !parser.finish(error_msg)) {
+        return false;
+    }
+    std::vector<std::string> drivers;
+    parser.callDrivers(called, &drivers);
+    return true;
+}
+
+} // namespace
+
+// ============================================================================
+// PatientModel Implementation
+// ============================================================================
+
+bool PatientModel::build(const PatientData& data, PatientModel* model, std::string& error_msg,
+                         int num_threads) {
+    *model = PatientModel();
+
+    // Imaging, inline or spooled by an upload
+    std::string archive;
+    auto dicom_path = data.metadata().find(PatientUpload::kMetadataDicomPath);
+    if (dicom_path != data.metadata().end()) {
+        if (!readFile(dicom_path->second, &archive, error_msg)) {
+            return false;
+        }
+    } else {
+        archive = data.dicom().dicom_archive();
+    }
+    if (!archive.empty()) {
+        BgzfInflater inflater(num_threads);
+        std::string files;
+        if (!inflater.feed(archive.data(), archive.size(), &files, error_msg) ||
+            !inflater.finish(&files, error_msg)) {
+            error_msg = "DICOM archive: " + error_msg;
+            return false;
+        }
+        archive = std::string();
+        if (DicomVolume::isDicom(files)) {
+            DicomVolume volume;
+            if (!volume.parse(files, error_msg)) {
+                return false;
+            }
+            const uint64_t voxels = static_cast<uint64_t>(volume.nx()) * volume.ny() * volume.nz();
+            if (voxels > std::numeric_limits<uint32_t>::max()) {
+                error_msg = "DICOM volume is too large to segment";
+                return false;
+            }
+            double lower, upper;
+            if (!metadataNumber(data, kMetadataSegmentationLower, kDefaultSegmentationLower,
+                                &lower, error_msg) ||
+                !metadataNumber(data, kMetadataSegmentationUpper,
+                                std::numeric_limits<double>::infinity(), &upper, error_msg)) {
+                return false;
+            }
+            model->geometry = segment(volume.values(), volume.nx(), volume.ny(), volume.nz(),
+                                      volume.dx(), volume.dy(), volume.dz(), lower, upper);
+        }
+    }
+
+    // Genomics: the VCF mutations, plus drivers called from inline reads
+    VcfData called;
+    const std::string& bam = data.genomic_sequences().bam_data();
+    if (!bam.empty() && !callBamDrivers(bam, num_threads, &called, error_msg)) {
+        error_msg = "BAM data: " + error_msg;
+        return false;
+    }
+
+    std::vector<const Mutation*> mutations;
+    std::unordered_set<std::string> seen;
+    for (const auto* source : {&data.vcf().mutations(), &called.mutations()}) {
+        for (const Mutation& mutation : *source) {
+            if (seen.insert(mutationKey(mutation)).second) {
+                mutations.push_back(&mutation);
+            }
+        }
+    }
+    model->buildClones(mutations);
+    return true;
+}
+
+TumorGeometry PatientModel::segment(const std::vector<float>& values, int nx, int ny, int nz,
+                                    double dx, double dy, double dz, double lower, double upper) {
+    TumorGeometry geometry;
+    geometry.nx = nx;
+    geometry.ny = ny;
+    geometry.nz = nz;
+    geometry.dx = dx;
+    geometry.dy = dy;
+    geometry.dz = dz;
+    for (size_t n = 0; n < values.size(); ++n) {
+        if (values[n] >= lower && values[n] <= upper) {
+            geometry.voxels.push_back(static_cast<uint32_t>(n));
+        }
+    }
+    return geometry;
+}
+
+void PatientModel::buildClones(const std::vector<const Mutation*>& mutations) {
+    genotypes.clear();
+    clone_fractions.clear();
+    if (mutations.empty()) {
+        return;
+    }
+
+    std::vector<const Mutation*> ordered(mutations);
+    std::stable_sort(ordered.begin(), ordered.end(), [](const Mutation* a, const Mutation* b) {
+        return cancerCellFraction(*a) > cancerCellFraction(*b);
+    });
+
+    // Greedy clustering down the sorted fractions; each cluster is one clone
+    struct Cluster {
+        explicit Cluster(double fraction) : top(fraction) {}
+
+        double top;
+        double sum = 0.0;
+        std::vector<const Mutation*> mutations;
+    };
+    std::vector<Cluster> clusters;
+    for (const Mutation* mutation : ordered) {
+        const double fraction = cancerCellFraction(*mutation);
+        if (clusters.empty() || clusters.back().top - fraction > kCloneFractionTolerance) {
+            clusters.emplace_back(fraction);
+        }
+        clusters.back().sum += fraction;
+        clusters.back().mutations.push_back(mutation);
+    }
+
+    std::vector<double> fractions;
+    for (const Cluster& cluster : clusters) {
+        fractions.push_back(cluster.sum / static_cast<double>(cluster.mutations.size()));
+    }
+
+    // Cells of a clone are those in its fraction but not in the nested one below
+    clone_fractions.push_back(1.0 - fractions.front());
+    Genotype genotype;
+    GenotypeTable::GenotypeId parent = GenotypeTable::kEmptyGenotype;
+    for (size_t c = 0; c < clusters.size(); ++c) {
+        for (const Mutation* mutation : clusters[c].mutations) {
+            genotype.add_mutation_positions(sitePosition(mutationKey(*mutation)));
+            const DriverHotspot* hotspot =
+                DriverPanel::find(mutation->chromosome(), mutation->position(),
+                                  mutation->reference_allele(), mutation->alternate_allele());
+            if (hotspot) {
+                genotype.add_driver_mutations(std::string(hotspot->label));
+            }
+        }
+        parent = genotypes.intern(genotype.SerializeAsString(), parent);
+        const double below = c + 1 < fractions.size() ? fractions[c + 1] : 0.0;
+        clone_fractions.push_back(fractions[c] - below);
+    }
+}
+
+void PatientModel::toProto(PreprocessedPatient* proto) const {
+    proto->set_nx(geometry.nx);
+    proto->set_ny(geometry.ny);
+    proto->set_nz(geometry.nz);
+    proto->set_dx(geometry.dx);
+    proto->set_dy(geometry.dy);
+    proto->set_dz(geometry.dz);
+    proto->mutable_tumor_voxels()->Add(geometry.voxels.begin(), geometry.voxels.end());
+    for (GenotypeTable::GenotypeId id = 1; id < genotypes.size(); ++id) {
+        proto->add_genotypes(genotypes.get(id));
+        proto->add_genotype_parents(genotypes.parent(id));
+    }
+    proto->mutable_clone_fractions()->Add(clone_fractions.begin(), clone_fractions.end());
+}
+
+bool PatientModel::fromProto(const PreprocessedPatient& proto, std::string& error_msg) {
+    *this = PatientModel();
+    if (proto.nx() < 0 || proto.ny() < 0 || proto.nz() < 0) {
+        error_msg = "Negative tumor geometry shape";
+        return false;
+    }
+    const uint64_t voxels = static_cast<uint64_t>(proto.nx()) * proto.ny() * proto.nz();
+    for (uint32_t voxel : proto.tumor_voxels()) {
+        if (voxel >= voxels) {
+            error_msg = "Tumor voxel outside the imaging lattice";
+            return false;
+        }
+    }
+    if (proto.genotype_parents_size() != proto.genotypes_size() ||
+        (!proto.clone_fractions().empty() &&
+         proto.clone_fractions_size() != proto.genotypes_size() + 1)) {
+        error_msg = "Inconsistent clone table";
+        return false;
+    }
+
+    geometry.nx = proto.nx();
+    geometry.ny = proto.ny();
+    geometry.nz = proto.nz();
+    geometry.dx = proto.dx();
+    geometry.dy = proto.dy();
+    geometry.dz = proto.dz();
+    geometry.voxels.assign(proto.tumor_voxels().begin(), proto.tumor_voxels().end());
+    for (int g = 0; g < proto.genotypes_size(); ++g) {
+        const auto expected = static_cast<GenotypeTable::GenotypeId>(g + 1);
+        if (proto.genotype_parents(g) >= expected ||
+            genotypes.intern(proto.genotypes(g), proto.genotype_parents(g)) != expected) {
+            error_msg = "Inconsistent clone table";
+            return false;
+        }
+    }
+    clone_fractions.assign(proto.clone_fractions().begin(), proto.clone_fractions().end());
+    return true;
+}
+
+size_t PatientModel::memoryBytes() const {
+    size_t bytes = sizeof(PatientModel) + geometry.voxels.capacity() * sizeof(uint32_t) +
+                   clone_fractions.capacity() * sizeof(double);
+    for (GenotypeTable::GenotypeId id = 0; id < genotypes.size(); ++id) {
+        bytes += genotypes.get(id).size() + sizeof(std::string);
+    }
+    return bytes;
+}
+
+} // namespace tumordtwin
@@ -0,0 +1,250 @@
+#include "data/patient_upload.h"
+#include <algorithm>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+
+#include "data/bgzf_inflater.h"
+#include "data/read_parsers.h"
+#include "data/vcf_parser.h"
+
+namespace tumordtwin {
+
+// Per-payload state of the parser thread
+struct PatientUpload::Parsers {
+    struct Spool {
+        Spool(const char* file, const char* key) : file_name(file), metadata_key(key) {}
+
+        const char* file_name;
+        const char* metadata_key;
+        std::string path;
+        std::ofstream file;
+        std::unique_ptr<BgzfInflater> inflater;  // Null for payloads that are only spooled
+        std::string inflated;
+    };
+
+    Spool bam{"sequences.bam", kMetadataBamPath};
+    Spool fastq{"reads.fastq", kMetadataFastqPath};
+    Spool vcf{"variants.vcf", kMetadataVcfPath};
+    Spool dicom{"imaging.dicom", kMetadataDicomPath};
+
+    BamParser bam_parser;
+    FastqParser fastq_parser;
+    VcfData vcf_data;
+    VcfParser vcf_parser{&vcf_data};
+
+    Spool* spool(UploadPayload payload) {
+        switch (payload) {
+            case UPLOAD_BAM: return &bam;
+            case UPLOAD_FASTQ: return &fastq;
+            case UPLOAD_VCF: return &vcf;
+            case UPLOAD_DICOM: return &dicom;
+            default: return nullptr;
+        }
+    }
+
+    // Hand decompressed bytes to the payload's parser
+    bool parse(UploadPayload payload, std::string_view bytes, std::string& error_msg) {
+        switch (payload) {
+            case UPLOAD_BAM: return bam_parser.feed(bytes, error_msg);
+            case UPLOAD_FASTQ: return fastq_parser.feed(bytes, error_msg);
+            case UPLOAD_VCF: return vcf_parser.feed(bytes, error_msg);
+            default: return true;
+        }
+    }
+};
+
+// ============================================================================
+// PatientUpload Implementation
+// ============================================================================
+
+PatientUpload::PatientUpload(std::string directory, int num_threads)
+    : directory_(std::move(directory)),
+      num_threads_(num_threads),
+      parsers_(std::make_unique<Parsers>()),
+      parser_(&PatientUpload::parseLoop, this) {
+}
+
+PatientUpload::~PatientUpload() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+        queue_.clear();
+    }
+    queue_changed_.notify_all();
+    if (parser_.joinable()) {
+        parser_.join();
+    }
+}
+
+bool PatientUpload::isReservedMetadataKey(const std::string& key) {
+    return key.compare(0, std::strlen(kReservedMetadataPrefix), kReservedMetadataPrefix) == 0;
+}
+
+void PatientUpload::mergeHeader(const PatientData& header) {
+    header_.MergeFrom(header);
+    auto* metadata = header_.mutable_metadata();
+    for (auto it = metadata->begin(); it != metadata->end();) {
+        it = isReservedMetadataKey(it->first) ? metadata->erase(it) : std::next(it);
+    }
+}
+
+bool PatientUpload::append(UploadPayload payload, std::string data, std::string& error_msg) {
+    if (!parsers_->spool(payload)) {
+        error_msg = "Upload chunk has no valid payload kind";
+        return false;
+    }
+    const size_t size = data.size();
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        queue_changed_.wait(lock, [this] { return failed_ || queue_.size() < kMaxQueuedChunks; });
+        if (failed_) {
+            error_msg = error_;
+            return false;
+        }
+        queue_.push_back({payload, std::move(data)});
+    }
+    queue_changed_.notify_all();
+    bytes_received_ += static_cast<int64_t>(size);
+    return true;
+}
+
+bool PatientUpload::finish(PatientData* data, std::string& error_msg) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+    }
+    queue_changed_.notify_all();
+    if (parser_.joinable()) {
+        parser_.join();
+    }
+    if (failed_) {
+        error_msg = error_;
+        return false;
+    }
+
+    // The parser thread is gone; flush what each payload still holds
+    Parsers& p = *parsers_;
+    for (UploadPayload payload : {UPLOAD_BAM, UPLOAD_FASTQ, UPLOAD_VCF, UPLOAD_DICOM}) {
+        Parsers::Spool& spool = *p.spool(payload);
+        if (spool.path.empty()) {
+            continue;
+        }
+        spool.file.close();
+        if (!spool.file) {
+            error_msg = "Cannot write upload spool file " + spool.path;
+            return false;
+        }
+        if (spool.inflater) {
+            spool.inflated.clear();
+            if (!spool.inflater->finish(&spool.inflated, error_msg) ||
+                !p.parse(payload, spool.inflated, error_msg)) {
+                return false;
+            }
+        }
+        (*header_.mutable_metadata())[spool.metadata_key] = spool.path;
+    }
+
+    if (!p.bam.path.empty()) {
+        if (!p.bam_parser.finish(error_msg)) {
+            return false;
+        }
+        p.bam_parser.callDrivers(&p.vcf_data, &drivers_);
+        reads_ += static_cast<int64_t>(p.bam_parser.reads());
+    }
+    if (!p.fastq.path.empty()) {
+        if (!p.fastq_parser.finish(error_msg)) {
+            return false;
+        }
+        reads_ += static_cast<int64_t>(p.fastq_parser.reads());
+    }
+    if (!p.vcf.path.empty() && !p.vcf_parser.finish(error_msg)) {
+        return false;
+    }
+    for (const std::string& driver : p.vcf_parser.drivers()) {
+        if (std::find(drivers_.begin(), drivers_.end(), driver) == drivers_.end()) {
+            drivers_.push_back(driver);
+        }
+    }
+
+    if (p.vcf_data.mutations_size() > 0) {
+        VcfData* vcf = header_.mutable_vcf();
+        vcf->mutable_mutations()->MergeFrom(p.vcf_data.mutations());
+        if (vcf->sample_id().empty()) {
+            // Calls from the BAM belong to the sequenced sample
+            vcf->set_sample_id(!p.vcf_data.sample_id().empty()
+                                   ? p.vcf_data.sample_id()
+                                   : header_.genomic_sequences().sample_id());
+        }
+    }
+    *data = header_;
+    return true;
+}
+
+void PatientUpload::parseLoop() {
+    while (true) {
+        Chunk chunk;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            queue_changed_.wait(lock, [this] { return closed_ || !queue_.empty(); });
+            if (queue_.empty()) {
+                return;
+            }
+            chunk = std::move(queue_.front());
+            queue_.pop_front();
+        }
+        queue_changed_.notify_all();
+
+        std::string error_msg;
+        try {
+            if (!failed_ && !parse(chunk, error_msg)) {
+                fail(error_msg);
+            }
+        } catch (const std::exception& e) {
+            // An allocation sized by the stream fails the upload, not the server
+            fail(std::string("Upload parsing failed: ") + e.what());
+        }
+    }
+}
+
+bool PatientUpload::parse(Chunk& chunk, std::string& error_msg) {
+    Parsers::Spool& spool = *parsers_->spool(chunk.payload);
+    if (spool.path.empty()) {
+        std::error_code ec;
+        std::filesystem::create_directories(directory_, ec);
+        spool.path = (std::filesystem::path(directory_) / spool.file_name).string();
+        spool.file.open(spool.path, std::ios::binary | std::ios::trunc);
+        if (ec || !spool.file) {
+            error_msg = "Cannot create upload spool file " + spool.path;
+            return false;
+        }
+        if (chunk.payload != UPLOAD_DICOM) {
+            spool.inflater = std::make_unique<BgzfInflater>(num_threads_);
+        }
+    }
+
+    spool.file.write(chunk.data.data(), static_cast<std::streamsize>(chunk.data.size()));
+    if (!spool.file) {
+        error_msg = "Cannot write upload spool file " + spool.path;
+        return false;
+    }
+    if (!spool.inflater) {
+        return true;
+    }
+    spool.inflated.clear();
+    return spool.inflater->feed(chunk.data.data(), chunk.data.size(), &spool.inflated, error_msg) &&
+           parsers_->parse(chunk.payload, spool.inflated, error_msg);
+}
+
+void PatientUpload::fail(const std::string& error_msg) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        failed_ = true;
+        error_ = error_msg;
+    }
+    queue_changed_.notify_all();
+}
+
+} // namespace tumordtwin
@@ -0,0 +1,288 @@
+#include "data/read_parsers.h"
+#include <cstring>
+
+#include "data/driver_panel.h"
+
+namespace tumordtwin {
+
+namespace {
+
+constexpr char kBamMagic[4] = {'B', 'A', 'M', '\1'};
+constexpr size_t kRecordFixedBytes = 32;  // refID .. tlen, after block_size
+constexpr int32_t kMaxHeaderTextBytes = 64 << 20;  // SAM header text buffered before n_ref
+
+// Unmapped, secondary, QC fail, duplicate, supplementary
+constexpr uint16_t kSkippedFlags = 0x4 | 0x100 | 0x200 | 0x400 | 0x800;
+
+// CIGAR operations
+constexpr uint32_t kCigarMatch = 0;
+constexpr uint32_t kCigarInsertion = 1;
+constexpr uint32_t kCigarDeletion = 2;
+constexpr uint32_t kCigarSkip = 3;
+constexpr uint32_t kCigarSoftClip = 4;
+constexpr uint32_t kCigarSeqMatch = 7;
+constexpr uint32_t kCigarSeqMismatch = 8;
+
+constexpr char kBases[] = "=ACMGRSVTWYHKDBN";
+
+template <typename T>
+T readLe(const char* p) {
+    T value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+// Query offset aligned to reference position target, or -1 (not covered, or deleted)
+long queryOffsetAt(const char* cigar, uint16_t n_cigar, int32_t start, int64_t target) {
+    int64_t ref = start;
+    long query = 0;
+    for (uint16_t c = 0; c < n_cigar && ref <= target; ++c) {
+        const uint32_t op = readLe<uint32_t>(cigar + 4 * c);
+        const uint32_t length = op >> 4;
+        switch (op & 0xf) {
+            case kCigarMatch:
+            case kCigarSeqMatch:
+            case kCigarSeqMismatch:
+                if (target < ref + length) {
+                    return query + static_cast<long>(target - ref);
+                }
+                ref += length;
+                query += length;
+                break;
+            case kCigarDeletion:
+            case kCigarSkip:
+                ref += length;
+                break;
+            case kCigarInsertion:
+            case kCigarSoftClip:
+                query += length;
+                break;
+            default:  // Hard clip, padding
+                break;
+        }
+    }
+    return -1;
+}
+
+} // namespace
+
+// ============================================================================
+// BamParser Implementation
+// ============================================================================
+
+BamParser::BamParser()
+    : pileups_(DriverPanel::hotspots().size()) {
+}
+
+bool BamParser::feed(std::string_view bytes, std::string& error_msg) {
+    pending_.append(bytes);
+    size_t offset = 0;
+    if (!have_header_) {
+        const long consumed = parseHeader(pending_.data(), pending_.size());
+        if (consumed < 0) {
+            error_msg = "Malformed BAM header";
+            return false;
+        }
+        if (consumed == 0) {
+            return true;
+        }
+        have_header_ = true;
+        offset = static_cast<size_t>(consumed);
+    }
+
+    while (pending_.size() - offset >= sizeof(int32_t)) {
+        const int32_t block_size = readLe<int32_t>(pending_.data() + offset);
+        if (block_size < static_cast<int32_t>(kRecordFixedBytes)) {
+            error_msg = "Malformed BAM record after " + std::to_string(reads_) + " reads";
+            return false;
+        }
+        if (pending_.size() - offset - sizeof(int32_t) < static_cast<size_t>(block_size)) {
+            break;
+        }
+        parseRecord(pending_.data() + offset + sizeof(int32_t), static_cast<size_t>(block_size));
+        offset += sizeof(int32_t) + static_cast<size_t>(block_size);
+    }
+    pending_.erase(0, offset);
+    return true;
+}
+
+bool BamParser::finish(std::string& error_msg) {
+    if (!have_header_) {
+        error_msg = "BAM stream ended inside the header";
+        return false;
+    }
+    if (!pending_.empty()) {
+        error_msg = "BAM stream ended inside a record";
+        return false;
+    }
+    return true;
+}
+
+long BamParser::parseHeader(const char* data, size_t size) {
+    if (size < sizeof(kBamMagic) + sizeof(int32_t)) {
+        return 0;
+    }
+    if (std::memcmp(data, kBamMagic, sizeof(kBamMagic)) != 0) {
+        return -1;
+    }
+    size_t offset = sizeof(kBamMagic);
+    const int32_t l_text = readLe<int32_t>(data + offset);
+    if (l_text < 0 || l_text > kMaxHeaderTextBytes) {
+        return -1;
+    }
+    offset += sizeof(int32_t) + static_cast<size_t>(l_text);
+    if (size < offset + sizeof(int32_t)) {
+        return 0;
+    }
+    const int32_t n_ref = readLe<int32_t>(data + offset);
+    if (n_ref < 0) {
+        return -1;
+    }
+    offset += sizeof(int32_t);
+
+    // Sized as the entries arrive: n_ref alone is not trusted for an allocation
+    std::vector<std::vector<size_t>> by_reference;
+    const std::vector<DriverHotspot>& hotspots = DriverPanel::hotspots();
+    for (int32_t r = 0; r < n_ref; ++r) {
+        if (size < offset + sizeof(int32_t)) {
+            return 0;
+        }
+        const int32_t l_name = readLe<int32_t>(data + offset);
+        if (l_name <= 0) {
+            return -1;
+        }
+        offset += sizeof(int32_t);
+        if (size < offset + static_cast<size_t>(l_name) + sizeof(int32_t)) {
+            return 0;
+        }
+        const std::string_view name =
+            DriverPanel::canonicalChromosome(std::string_view(data + offset, static_cast<size_t>(l_name) - 1));
+        std::vector<size_t>& reference_hotspots = by_reference.emplace_back();
+        for (size_t h = 0; h < hotspots.size(); ++h) {
+            if (hotspots[h].chromosome == name) {
+                reference_hotspots.push_back(h);
+            }
+        }
+        offset += static_cast<size_t>(l_name) + sizeof(int32_t);  // Name and l_ref
+    }
+    hotspots_by_reference_ = std::move(by_reference);
+    return static_cast<long>(offset);
+}
+
+void BamParser::parseRecord(const char* record, size_t size) {
+    ++reads_;
+    const int32_t ref_id = readLe<int32_t>(record);
+    const int32_t pos = readLe<int32_t>(record + 4);
+    const uint8_t l_read_name = static_cast<uint8_t>(record[8]);
+    const uint8_t mapq = static_cast<uint8_t>(record[9]);
+    const uint16_t n_cigar = readLe<uint16_t>(record + 12);
+    const uint16_t flag = readLe<uint16_t>(record + 14);
+    const int32_t l_seq = readLe<int32_t>(record + 16);
+    if (ref_id < 0 || static_cast<size_t>(ref_id) >= hotspots_by_reference_.size() ||
+        hotspots_by_reference_[ref_id].empty() || (flag & kSkippedFlags) || mapq < kMinMappingQuality ||
+        l_seq <= 0) {
+        return;
+    }
+
+    const size_t cigar_offset = kRecordFixedBytes + l_read_name;
+    const size_t seq_offset = cigar_offset + 4 * static_cast<size_t>(n_cigar);
+    const size_t qual_offset = seq_offset + (static_cast<size_t>(l_seq) + 1) / 2;
+    if (qual_offset + static_cast<size_t>(l_seq) > size) {
+        return;  // Inconsistent lengths; skip rather than read past the record
+    }
+
+    const std::vector<DriverHotspot>& hotspots = DriverPanel::hotspots();
+    for (size_t h : hotspots_by_reference_[ref_id]) {
+        const int64_t target = hotspots[h].position - 1;  // BAM positions are 0-based
+        if (target < pos) {
+            continue;
+        }
+        const long query = queryOffsetAt(record + cigar_offset, n_cigar, pos, target);
+        if (query < 0 || query >= l_seq) {
+            continue;
+        }
+        const uint8_t quality = static_cast<uint8_t>(record[qual_offset + query]);
+        if (quality != 0xff && quality < kMinBaseQuality) {
+            continue;
+        }
+        const uint8_t packed = static_cast<uint8_t>(record[seq_offset + query / 2]);
+        const char base = kBases[(query % 2 == 0) ? (packed >> 4) : (packed & 0xf)];
+        ++pileups_[h].depth;
+        if (base == hotspots[h].alternate) {
+            ++pileups_[h].alt;
+        }
+    }
+}
+
+void BamParser::callDrivers(VcfData* vcf, std::vector<std::string>* drivers) const {
+    const std::vector<DriverHotspot>& hotspots = DriverPanel::hotspots();
+    for (size_t h = 0; h < hotspots.size(); ++h) {
+        const Pileup& pileup = pileups_[h];
+        if (pileup.depth < kMinDepth || pileup.alt < kMinAltReads) {
+            continue;
+        }
+        const double frequency = static_cast<double>(pileup.alt) / pileup.depth;
+        if (frequency < kMinAlleleFrequency) {
+            continue;
+        }
+        Mutation* mutation = vcf->add_mutations();
+        mutation->set_chromosome(std::string(hotspots[h].chromosome));
+        mutation->set_position(hotspots[h].position);
+        mutation->set_reference_allele(std::string(1, hotspots[h].reference));
+        mutation->set_alternate_allele(std::string(1, hotspots[h].alternate));
+        mutation->set_allele_frequency(frequency);
+        drivers->emplace_back(hotspots[h].label);
+    }
+}
+
+// ============================================================================
+// FastqParser Implementation
+// ============================================================================
+
+bool FastqParser::feed(std::string_view text, std::string& error_msg) {
+    return lines_.feed(text, [&](std::string_view line) { return parseLine(line, error_msg); });
+}
+
+bool FastqParser::finish(std::string& error_msg) {
+    if (!lines_.finish([&](std::string_view line) { return parseLine(line, error_msg); })) {
+        return false;
+    }
+    if (line_number_ % 4 != 0) {
+        error_msg = "FASTQ stream ends inside a record";
+        return false;
+    }
+    return true;
+}
+
+bool FastqParser::parseLine(std::string_view line, std::string& error_msg) {
+    const size_t field = line_number_++ % 4;
+    switch (field) {
+        case 0:
+            if (line.empty() || line[0] != '@') {
+                error_msg = "FASTQ line " + std::to_string(line_number_) + " is not a record header";
+                return false;
+            }
+            break;
+        case 1:
+            sequence_length_ = line.size();
+            break;
+        case 2:
+            if (line.empty() || line[0] != '+') {
+                error_msg = "FASTQ line " + std::to_string(line_number_) + " is not a '+' separator";
+                return false;
+            }
+            break;
+        default:
+            if (line.size() != sequence_length_) {
+                error_msg = "FASTQ line " + std::to_string(line_number_) +
+                            " has a quality string of the wrong length";
+                return false;
+            }
+            ++reads_;
+            bases_ += sequence_length_;
+            break;
+    }
+    return true;
+}
+
+} // namespace tumordtwin
@@ -0,0 +1,177 @@
+#include "data/vcf_parser.h"
+#include <algorithm>
+#include <charconv>
+#include <cstdlib>
+
+#include "data/driver_panel.h"
+
+namespace tumordtwin {
+
+namespace {
+
+// Columns of a VCF record line
+enum Column { kChrom, kPos, kId, kRef, kAlt, kQual, kFilter, kInfo, kFormat, kFirstSample };
+
+constexpr size_t kMaxColumns = kFirstSample + 1;  // Later samples are ignored
+
+// Split on a delimiter into at most max_fields views; the last holds the rest
+size_t split(std::string_view text, char delimiter, std::string_view* fields, size_t max_fields) {
+    size_t count = 0;
+    while (count + 1 < max_fields) {
+        const size_t end = text.find(delimiter);
+        if (end == std::string_view::npos) {
+            break;
+        }
+        fields[count++] = text.substr(0, end);
+        text.remove_prefix(end + 1);
+    }
+    fields[count++] = text;
+    return count;
+}
+
+// The n-th comma-separated item of a list, or empty
+std::string_view listItem(std::string_view list, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        const size_t comma = list.find(',');
+        if (comma == std::string_view::npos) {
+            return {};
+        }
+        list.remove_prefix(comma + 1);
+    }
+    return list.substr(0, list.find(','));
+}
+
+// Value of key in a ';'-separated INFO column, or empty
+std::string_view infoValue(std::string_view info, std::string_view key) {
+    while (!info.empty()) {
+        const size_t end = std::min(info.find(';'), info.size());
+        const std::string_view entry = info.substr(0, end);
+        if (entry.size() > key.size() && entry.substr(0, key.size()) == key &&
+            entry[key.size()] == '=') {
+            return entry.substr(key.size() + 1);
+        }
+        info.remove_prefix(std::min(end + 1, info.size()));
+    }
+    return {};
+}
+
+// Value of key in a sample column given its FORMAT column, or empty
+std::string_view sampleValue(std::string_view format, std::string_view sample, std::string_view key) {
+    while (!format.empty()) {
+        const size_t format_end = std::min(format.find(':'), format.size());
+        const size_t sample_end = std::min(sample.find(':'), sample.size());
+        if (format.substr(0, format_end) == key) {
+            return sample.substr(0, sample_end);
+        }
+        format.remove_prefix(std::min(format_end + 1, format.size()));
+        sample.remove_prefix(std::min(sample_end + 1, sample.size()));
+    }
+    return {};
+}
+
+bool parseDouble(std::string_view text, double* value) {
+    if (text.empty() || text == ".") {
+        return false;
+    }
+    // strtod needs a terminator; frequencies are short
+    const std::string copy(text);
+    char* end = nullptr;
+    *value = std::strtod(copy.c_str(), &end);
+    return end == copy.c_str() + copy.size();
+}
+
+} // namespace
+
+// ============================================================================
+// VcfParser Implementation
+// ============================================================================
+
+VcfParser::VcfParser(VcfData* vcf)
+    : vcf_(vcf) {
+}
+
+bool VcfParser::feed(std::string_view text, std::string& error_msg) {
+    return lines_.feed(text, [&](std::string_view line) { return parseLine(line, error_msg); });
+}
+
+bool VcfParser::finish(std::string& error_msg) {
+    return lines_.finish([&](std::string_view line) { return parseLine(line, error_msg); });
+}
+
+bool VcfParser::parseLine(std::string_view line, std::string& error_msg) {
+    ++line_number_;
+    if (line.empty()) {
+        return true;
+    }
+
+    std::string_view columns[kMaxColumns];
+    const size_t count = split(line, '\t', columns, kMaxColumns);
+    if (line[0] == '#') {
+        // #CHROM POS ... FORMAT SAMPLE names the first sample
+        if (line.substr(0, 6) == "#CHROM" && count > kFirstSample && vcf_->sample_id().empty()) {
+            const std::string_view sample = columns[kFirstSample];
+            vcf_->set_sample_id(std::string(sample.substr(0, sample.find('\t'))));
+        }
+        return true;
+    }
+
+    if (count <= kInfo) {
+        error_msg = "VCF line " + std::to_string(line_number_) + " has too few columns";
+        return false;
+    }
+    int64_t position = 0;
+    const std::string_view pos = columns[kPos];
+    if (std::from_chars(pos.data(), pos.data() + pos.size(), position).ec != std::errc() ||
+        position <= 0) {
+        error_msg = "VCF line " + std::to_string(line_number_) + " has an invalid position";
+        return false;
+    }
+    ++records_;
+
+    const std::string_view filter = columns[kFilter];
+    if (filter != "PASS" && filter != ".") {
+        return true;
+    }
+
+    const std::string_view reference = columns[kRef];
+    const std::string_view info = columns[kInfo];
+    std::string_view format;
+    std::string_view sample;
+    if (count > kFirstSample) {
+        format = columns[kFormat];
+        sample = columns[kFirstSample].substr(0, columns[kFirstSample].find('\t'));
+    }
+    const std::string_view genotype = sampleValue(format, sample, "GT");
+    const std::string_view info_af = infoValue(info, "AF");
+    const std::string_view sample_af = sampleValue(format, sample, "AF");
+
+    std::string_view alternates = columns[kAlt];
+    for (size_t allele = 0; !alternates.empty(); ++allele) {
+        const size_t comma = std::min(alternates.find(','), alternates.size());
+        const std::string_view alternate = alternates.substr(0, comma);
+        alternates.remove_prefix(std::min(comma + 1, alternates.size()));
+        if (alternate == "." || alternate == "*") {
+            continue;
+        }
+
+        Mutation* mutation = vcf_->add_mutations();
+        mutation->set_chromosome(std::string(columns[kChrom]));
+        mutation->set_position(position);
+        mutation->set_reference_allele(std::string(reference));
+        mutation->set_alternate_allele(std::string(alternate));
+        mutation->set_genotype(std::string(genotype));
+        double frequency = 0.0;
+        if (parseDouble(listItem(info_af, allele), &frequency) ||
+            parseDouble(listItem(sample_af, allele), &frequency)) {
+            mutation->set_allele_frequency(frequency);
+        }
+
+        const DriverHotspot* hotspot = DriverPanel::find(columns[kChrom], position, reference, alternate);
+        if (hotspot && std::find(drivers_.begin(), drivers_.end(), hotspot->label) == drivers_.end()) {
+            drivers_.emplace_back(hotspot->label);
+        }
+    }
+    return true;
+}
+
+} // namespace tumordtwin
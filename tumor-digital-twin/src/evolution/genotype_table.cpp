@@ -0,0 +1,91 @@
+#include "evolution/genotype_table.h"
+
+#include "common.pb.h"
+
+namespace tumordtwin {
+
+namespace {
+
+uint64_t fnv1a(std::string_view bytes) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (unsigned char c : bytes) {
+        hash = (hash ^ c) * 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+} // namespace
+
+// ============================================================================
+// GenotypeTable Implementation
+// ============================================================================
+
+GenotypeTable::GenotypeTable() {
+    clear();
+}
+
+GenotypeTable::GenotypeTable(const GenotypeTable& other)
+    : genotypes_(other.genotypes_),
+      parents_(other.parents_),
+      hashes_(other.hashes_) {
+    rebuildIndex();
+}
+
+GenotypeTable& GenotypeTable::operator=(const GenotypeTable& other) {
+    if (this != &other) {
+        genotypes_ = other.genotypes_;
+        parents_ = other.parents_;
+        hashes_ = other.hashes_;
+        rebuildIndex();
+    }
+    return *this;
+}
+
+GenotypeTable::GenotypeId GenotypeTable::intern(std::string_view genotype_data, GenotypeId parent) {
+    auto it = index_.find(genotype_data);
+    if (it != index_.end()) {
+        return it->second;
+    }
+
+    auto id = static_cast<GenotypeId>(genotypes_.size());
+    const std::string& stored = genotypes_.emplace_back(genotype_data);
+    parents_.push_back(parent < id ? parent : kEmptyGenotype);
+    hashes_.push_back(fnv1a(stored));
+    index_.emplace(std::string_view(stored), id);
+    return id;
+}
+
+GenotypeTable::GenotypeId GenotypeTable::fork(GenotypeId parent, int32_t mutation_position) {
+    Genotype genotype;
+    if (!genotype.ParseFromString(get(parent))) {
+        genotype.Clear();
+    }
+    genotype.add_mutation_positions(mutation_position);
+    return intern(genotype.SerializeAsString(), parent);
+}
+
+const std::string& GenotypeTable::get(GenotypeId id) const {
+    if (id >= genotypes_.size()) {
+        return genotypes_[kEmptyGenotype];
+    }
+    return genotypes_[id];
+}
+
+void GenotypeTable::rebuildIndex() {
+    index_.clear();
+    index_.reserve(genotypes_.size());
+    for (size_t i = 0; i < genotypes_.size(); ++i) {
+        index_.emplace(std::string_view(genotypes_[i]), static_cast<GenotypeId>(i));
+    }
+}
+
+void GenotypeTable::clear() {
+    index_.clear();
+    genotypes_.clear();
+    parents_.assign(1, kEmptyGenotype);
+    hashes_.assign(1, fnv1a({}));
+    genotypes_.emplace_back();
+    index_.emplace(std::string_view(genotypes_.front()), kEmptyGenotype);
+}
+
+} // namespace tumordtwin
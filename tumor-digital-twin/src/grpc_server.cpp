@@ -1,19 +1,226 @@
 #include "grpc_server.h"
+#include "async_service.h"
+#include "data/patient_upload.h"
+#include "simulation/drug_transport.h"
+#include "simulation/simulation_engine.h"
+#include "simulation/slab_ranks.h"
+#include "storage/results_stream.h"
+#include <google/protobuf/arena.h>
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/io/zero_copy_stream_impl_lite.h>
+#include <google/protobuf/wire_format_lite.h>
 #include <grpcpp/ext/proto_server_reflection_plugin.h>
 #include <grpcpp/health_check_service_interface.h>
+#include <grpcpp/resource_quota.h>
+#include <grpcpp/support/proto_buffer_reader.h>
+#include <grpcpp/support/server_interceptor.h>
 #include <chrono>
+#include <filesystem>
+#include <iostream>
 #include <random>
 #include <sstream>
 #include <iomanip>
+#include <algorithm>
+#include <cctype>
+#include <limits>
+#include <thread>
+#include <unordered_set>
 
 namespace tumordtwin {
 
+namespace {
+
+const char* statusCodeName(grpc::StatusCode code) {
+    switch (code) {
+        case grpc::StatusCode::OK: return "OK";
+        case grpc::StatusCode::CANCELLED: return "CANCELLED";
+        case grpc::StatusCode::UNKNOWN: return "UNKNOWN";
+        case grpc::StatusCode::INVALID_ARGUMENT: return "INVALID_ARGUMENT";
+        case grpc::StatusCode::DEADLINE_EXCEEDED: return "DEADLINE_EXCEEDED";
+        case grpc::StatusCode::NOT_FOUND: return "NOT_FOUND";
+        case grpc::StatusCode::ALREADY_EXISTS: return "ALREADY_EXISTS";
+        case grpc::StatusCode::PERMISSION_DENIED: return "PERMISSION_DENIED";
+        case grpc::StatusCode::RESOURCE_EXHAUSTED: return "RESOURCE_EXHAUSTED";
+        case grpc::StatusCode::FAILED_PRECONDITION: return "FAILED_PRECONDITION";
+        case grpc::StatusCode::ABORTED: return "ABORTED";
+        case grpc::StatusCode::OUT_OF_RANGE: return "OUT_OF_RANGE";
+        case grpc::StatusCode::UNIMPLEMENTED: return "UNIMPLEMENTED";
+        case grpc::StatusCode::INTERNAL: return "INTERNAL";
+        case grpc::StatusCode::UNAVAILABLE: return "UNAVAILABLE";
+        case grpc::StatusCode::DATA_LOSS: return "DATA_LOSS";
+        case grpc::StatusCode::UNAUTHENTICATED: return "UNAUTHENTICATED";
+        default: return "UNKNOWN";
+    }
+}
+
+/**
+ * @brief Times every RPC from arrival to its final status
+ */
+class RpcMetricsInterceptor : public grpc::experimental::Interceptor {
+public:
+    RpcMetricsInterceptor(MetricsRegistry& metrics, std::string method)
+        : metrics_(metrics),
+          method_(std::move(method)),
+          start_ns_(StepProfiler::nowNs()) {
+    }
+
+    void Intercept(grpc::experimental::InterceptorBatchMethods* methods) override {
+        if (methods->QueryInterceptionHookPoint(
+                grpc::experimental::InterceptionHookPoints::PRE_SEND_STATUS)) {
+            const grpc::Status status = methods->GetSendStatus();
+            const double seconds = static_cast<double>(StepProfiler::nowNs() - start_ns_) * 1e-9;
+            metrics_.histogram("tumordtwin_rpc_duration_seconds",
+                               "Time from the arrival of an RPC to its final status",
+                               {{"method", method_}})
+                .observe(seconds);
+            metrics_.counter("tumordtwin_rpc_requests_total", "RPCs finished, by status code",
+                             {{"method", method_}, {"code", statusCodeName(status.error_code())}})
+                .increment();
+        }
+        methods->Proceed();
+    }
+
+private:
+    MetricsRegistry& metrics_;
+    const std::string method_;
+    const uint64_t start_ns_;
+};
+
+class RpcMetricsInterceptorFactory
+    : public grpc::experimental::ServerInterceptorFactoryInterface {
+public:
+    explicit RpcMetricsInterceptorFactory(MetricsRegistry& metrics) : metrics_(metrics) {}
+
+    grpc::experimental::Interceptor* CreateServerInterceptor(
+        grpc::experimental::ServerRpcInfo* info) override {
+        // "/tumordtwin.SimulationService/StartSimulation" -> "StartSimulation"
+        std::string method = info->method() ? info->method() : "";
+        const size_t slash = method.rfind('/');
+        if (slash != std::string::npos) {
+            method = method.substr(slash + 1);
+        }
+        return new RpcMetricsInterceptor(metrics_, std::move(method));
+    }
+
+private:
+    MetricsRegistry& metrics_;
+};
+
+} // namespace
+
+// ============================================================================
+// WatchCursor Implementation
+// ============================================================================
+
+WatchCursor::WatchCursor(const WatchRequest& request)
+    : step_interval_(std::max(request.step_interval(), 1)),
+      min_interval_(std::chrono::milliseconds(request.min_interval_ms())) {
+}
+
+bool WatchCursor::due(const SimulationRecord& record, Clock::time_point now,
+                      Clock::duration* wait) const {
+    *wait = Clock::duration::zero();
+    // The first update always goes out: nothing has been sent yet
+    if (record.status() != sent_status_) {
+        return true;
+    }
+    if (record.currentStep() < sent_step_ + step_interval_) {
+        return false;
+    }
+    if (now - sent_at_ >= min_interval_) {
+        return true;
+    }
+    *wait = sent_at_ + min_interval_ - now;
+    return false;
+}
+
+bool WatchCursor::sent(const StatusResponse& response, Clock::time_point now) {
+    sent_status_ = response.status();
+    sent_step_ = response.current_step();
+    sent_at_ = now;
+    return sent_status_ == SimulationStatus::COMPLETED ||
+           sent_status_ == SimulationStatus::FAILED ||
+           sent_status_ == SimulationStatus::STOPPED;
+}
+
 // ============================================================================
 // SimulationServiceImpl Implementation
 // ============================================================================
 
-SimulationServiceImpl::SimulationServiceImpl() {
-    // Initialize service
+SimulationServiceImpl::SimulationServiceImpl(std::string checkpoint_directory,
+                                             std::string upload_directory,
+                                             std::string patient_cache_directory,
+                                             std::string history_directory)
+    : checkpoint_directory_(std::move(checkpoint_directory)),
+      upload_directory_(std::move(upload_directory)),
+      history_directory_(std::move(history_directory)) {
+    if (checkpoint_directory_.empty()) {
+        checkpoint_directory_ =
+            (std::filesystem::temp_directory_path() / "tumordtwin_checkpoints").string();
+    }
+    if (upload_directory_.empty()) {
+        upload_directory_ =
+            (std::filesystem::temp_directory_path() / "tumordtwin_uploads").string();
+    }
+    if (history_directory_.empty()) {
+        history_directory_ =
+            (std::filesystem::temp_directory_path() / "tumordtwin_history").string();
+    }
+    if (patient_cache_directory.empty()) {
+        patient_cache_directory =
+            (std::filesystem::temp_directory_path() / "tumordtwin_patient_cache").string();
+    }
+    patient_cache_ = std::make_unique<PatientCache>(std::move(patient_cache_directory));
+
+    // Hot paths update these series without going through the registry
+    for (size_t p = 0; p < kNumProfilePhases; ++p) {
+        phase_seconds_[p] = &metrics_.histogram(
+            "tumordtwin_phase_duration_seconds", "Duration of one call of a simulation phase",
+            {{"phase", profilePhaseName(static_cast<ProfilePhase>(p))}});
+    }
+    result_serialization_seconds_ = &metrics_.histogram(
+        "tumordtwin_phase_duration_seconds", "Duration of one call of a simulation phase",
+        {{"phase", "result_serialization"}});
+    step_seconds_ = &metrics_.histogram("tumordtwin_step_duration_seconds",
+                                        "Duration of one simulation step");
+    steps_total_ = &metrics_.counter("tumordtwin_simulation_steps_total",
+                                     "Simulation steps run by this server");
+    warm_engine_runs_ = &metrics_.counter("tumordtwin_engine_acquisitions_total",
+                                          "Engines handed to runs, by origin",
+                                          {{"origin", "warm"}});
+    cold_engine_runs_ = &metrics_.counter("tumordtwin_engine_acquisitions_total",
+                                          "Engines handed to runs, by origin",
+                                          {{"origin", "cold"}});
+
+    metrics_.gauge("tumordtwin_scheduler_queue_depth", "Simulations waiting for a worker", {},
+                   [this] { return static_cast<double>(scheduler_.queueDepth()); });
+    metrics_.gauge("tumordtwin_scheduler_running_jobs", "Simulations running on a worker", {},
+                   [this] { return static_cast<double>(scheduler_.runningJobs()); });
+    metrics_.gauge("tumordtwin_engine_pool_idle", "Warm simulation engines waiting for a run",
+                   {}, [this] { return static_cast<double>(engine_pool_.idle()); });
+    for (int s = SimulationStatus_MIN; s <= SimulationStatus_MAX; ++s) {
+        const auto status = static_cast<SimulationStatus>(s);
+        if (status == SimulationStatus::SIMULATION_STATUS_UNSPECIFIED ||
+            !SimulationStatus_IsValid(s)) {
+            continue;
+        }
+        metrics_.gauge("tumordtwin_simulations", "Registered simulations by status",
+                       {{"status", SimulationStatus_Name(status)}}, [this, status] {
+                           size_t count = 0;
+                           registry_.list("", status, 0, 0, count);
+                           return static_cast<double>(count);
+                       });
+    }
+}
+
+SimulationServiceImpl::~SimulationServiceImpl() {
+    is_serving_ = false;
+    scheduler_.shutdown();
+
+    // Upload IDs die with the service; dropping them removes their spools
+    std::lock_guard<std::mutex> lock(uploads_mutex_);
+    uploads_.clear();
+    upload_order_.clear();
 }
 
 grpc::Status SimulationServiceImpl::StartSimulation(
@@ -26,9 +233,148 @@ grpc::Status SimulationServiceImpl::StartSimulation(
     if (!validateSimulationRequest(*request, error_msg)) {
         return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, error_msg);
     }
+    if (coordinator_) {
+        SimulationRequest placed = *request;
+        if (placed.simulation_id().empty()) {
+            placed.set_simulation_id(generateSimulationId());
+        }
+        return coordinator_->startSimulation(context, std::move(placed), response);
+    }
+
+    std::shared_ptr<const PatientData> patient;
+    grpc::Status upload_status = resolveUpload(*request, &patient);
+    if (!upload_status.ok()) {
+        return upload_status;
+    }
+    // gRPC owns the request, so inline data is copied once; startSimulationFromWire avoids it
+    if (!patient) {
+        patient = std::make_shared<const PatientData>(request->data());
+    }
+    return submitSimulation(*request, std::move(patient), response);
+}
+
+grpc::Status SimulationServiceImpl::startSimulationFromWire(
+    grpc::ServerContext* context,
+    const grpc::ByteBuffer* request,
+    grpc::ByteBuffer* response) {
+
+    // Everything but field 2 (data), whose bytes are skipped in place
+    SimulationRequest envelope;
+    bool has_data = false;
+    {
+        grpc::ByteBuffer payload(*request);  // Shares the received slices
+        grpc::ProtoBufferReader reader(&payload);
+        google::protobuf::io::CodedInputStream input(&reader);
+        std::string fields;
+        google::protobuf::io::StringOutputStream fields_stream(&fields);
+        google::protobuf::io::CodedOutputStream output(&fields_stream);
+        using google::protobuf::internal::WireFormatLite;
+        while (const uint32_t tag = input.ReadTag()) {
+            if (WireFormatLite::GetTagFieldNumber(tag) == SimulationRequest::kDataFieldNumber &&
+                WireFormatLite::GetTagWireType(tag) ==
+                    WireFormatLite::WIRETYPE_LENGTH_DELIMITED) {
+                uint32_t length = 0;
+                if (!input.ReadVarint32(&length) || !input.Skip(static_cast<int>(length))) {
+                    return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT,
+                                      "Malformed SimulationRequest");
+                }
+                has_data = true;
+            } else if (!WireFormatLite::SkipField(&input, tag, &output)) {
+                return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT,
+                                  "Malformed SimulationRequest");
+            }
+        }
+        output.Trim();
+        if (!input.ConsumedEntireMessage() || !envelope.ParseFromString(fields)) {
+            return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT,
+                              "Malformed SimulationRequest");
+        }
+    }
+
+    std::string error_msg;
+    if (!validateRequestEnvelope(envelope, has_data, error_msg)) {
+        return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, error_msg);
+    }
+
+    std::shared_ptr<const PatientData> patient;
+    grpc::Status upload_status = resolveUpload(envelope, &patient);
+    if (!upload_status.ok()) {
+        return upload_status;
+    }
+    if (!patient) {
+        // The job shares the arena; the payload bytes are never copied after this parse
+        auto arena = std::make_shared<google::protobuf::Arena>();
+        auto* full = google::protobuf::Arena::CreateMessage<SimulationRequest>(arena.get());
+        grpc::ByteBuffer payload(*request);
+        grpc::ProtoBufferReader reader(&payload);
+        if (!full->ParseFromZeroCopyStream(&reader)) {
+            return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT,
+                              "Malformed SimulationRequest");
+        }
+        if (!validateSimulationRequest(*full, error_msg)) {
+            return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, error_msg);
+        }
+        patient = std::shared_ptr<const PatientData>(arena, &full->data());
+    }
+
+    SimulationResponse reply;
+    grpc::Status status = submitSimulation(envelope, std::move(patient), &reply);
+    if (status.ok()) {
+        bool own_buffer = false;
+        status = grpc::SerializationTraits<SimulationResponse>::Serialize(reply, response,
+                                                                          &own_buffer);
+    }
+    return status;
+}
+
+grpc::Status SimulationServiceImpl::submitSimulation(
+    const SimulationRequest& request,
+    std::shared_ptr<const PatientData> patient,
+    SimulationResponse* response) {
+
+    // A multi-rank run needs its MPI ranks here, or a lattice one process holds
+    std::string error_msg;
+    if (!SlabRanks::fits(request.params(), error_msg)) {
+        return grpc::Status(grpc::StatusCode::FAILED_PRECONDITION, error_msg);
+    }
+
+    // Generate unique simulation ID, unless a coordinator chose it
+    const bool preset_id = !request.simulation_id().empty();
+    std::string sim_id = preset_id ? request.simulation_id() : generateSimulationId();
+
+    auto now = std::chrono::system_clock::now();
+    auto record = std::make_shared<SimulationRecord>(
+        sim_id,
+        request.patient_id(),
+        request.simulation_name(),
+        request.params().num_steps(),
+        std::chrono::duration_cast<std::chrono::seconds>(now.time_since_epoch()).count());
+    if (!registry_.insert(record)) {
+        return grpc::Status(grpc::StatusCode::ALREADY_EXISTS,
+                          preset_id ? "Simulation already exists: " + sim_id
+                                    : std::string("Simulation ID collision, retry"));
+    }
+
+    // Hand the request to the scheduler; refuse rather than pile up work
+    auto job = std::make_shared<SimulationJob>();
+    job->simulation_id = sim_id;
+    job->request.set_patient_id(request.patient_id());
+    job->request.set_simulation_name(request.simulation_name());
+    *job->request.mutable_params() = request.params();
+    *job->request.mutable_treatment() = request.treatment();
+    // The job holds an upload's data, so its spools outlive eviction until the run is done
+    job->patient = std::move(patient);
+    job->num_threads = scheduler_.resolveThreadCount(request.params().num_threads());
+    job->cost = JobScheduler::estimateCost(request.params());
+    // An upload's spools and reserved metadata keys only exist on this node
+    job->movable = request.upload_id().empty();
+    job->run = [this, record](SimulationJob& j) { runSimulation(j, *record, {}); };
 
-    // Generate unique simulation ID
-    std::string sim_id = generateSimulationId();
+    if (!scheduler_.submit(job)) {
+        registry_.erase(sim_id);
+        return grpc::Status(grpc::StatusCode::RESOURCE_EXHAUSTED,
+                          "Simulation queue is full, retry later");
+    }
     
     // Set response fields
     response->set_simulation_id(sim_id);
@@ -36,7 +382,6 @@ grpc::Status SimulationServiceImpl::StartSimulation(
     response->set_message("Simulation queued successfully");
     
     // Set estimated completion time (placeholder - 1 hour from now)
-    auto now = std::chrono::system_clock::now();
     auto future = now + std::chrono::hours(1);
     auto timestamp = std::chrono::duration_cast<std::chrono::seconds>(
         future.time_since_epoch()).count();
@@ -45,6 +390,265 @@ grpc::Status SimulationServiceImpl::StartSimulation(
     return grpc::Status::OK;
 }
 
+grpc::Status SimulationServiceImpl::StartEnsemble(
+    grpc::ServerContext* context,
+    const EnsembleRequest* request,
+    EnsembleResponse* response) {
+
+    // The base is validated once; members only differ in their parameters and treatment
+    const SimulationRequest& base = request->base();
+    std::string error_msg;
+    if (!validateSimulationRequest(base, error_msg)) {
+        return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, error_msg);
+    }
+    std::shared_ptr<const PatientData> patient;
+    grpc::Status upload_status = resolveUpload(base, &patient);
+    if (!upload_status.ok()) {
+        return upload_status;
+    }
+    if (!patient) {
+        patient = std::make_shared<const PatientData>(base.data());
+    }
+
+    std::vector<EnsembleMemberSpec> members;
+    if (!EnsemblePlan::expand(*request, &members, error_msg)) {
+        return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, error_msg);
+    }
+    for (size_t m = 0; m < members.size(); ++m) {
+        if (!validateSimulationParameters(members[m].params, error_msg) ||
+            !DrugTransport::validate(members[m].treatment, error_msg)) {
+            return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT,
+                              "Member " + std::to_string(m) + ": " + error_msg);
+        }
+        // Members start from one shared seeded state, which a slab run cannot take
+        if (members[m].params.num_mpi_ranks() > 1) {
+            return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT,
+                              "Member " + std::to_string(m) +
+                                  ": ensemble members run on one rank (num_mpi_ranks must be 0 or 1)");
+        }
+    }
+    if (members.size() > scheduler_.maxQueueDepth()) {
+        return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT,
+                          "Ensemble has more members than the simulation queue holds");
+    }
+    if (coordinator_) {
+        double cost = 0.0;
+        for (const EnsembleMemberSpec& member : members) {
+            cost += JobScheduler::estimateCost(member.params);
+        }
+        return coordinator_->startEnsemble(context, *request, cost, response);
+    }
+
+    // One seeded state per distinct set of initialize() inputs, usually just one
+    std::vector<std::string> keys;
+    std::unordered_map<std::string, size_t> members_per_key;
+    for (const EnsembleMemberSpec& member : members) {
+        keys.push_back(SimulationEngine::initialStateKey(member.params));
+        ++members_per_key[keys.back()];
+    }
+    std::unordered_map<std::string, std::shared_ptr<SharedInitialState>> initial_states;
+
+    const std::string ensemble_id = generateSimulationId();
+    auto now = std::chrono::system_clock::now();
+    const int64_t created_at =
+        std::chrono::duration_cast<std::chrono::seconds>(now.time_since_epoch()).count();
+    std::vector<std::shared_ptr<SimulationRecord>> records;
+    std::vector<std::shared_ptr<SimulationJob>> jobs;
+    auto unregister = [this, &records]() {
+        for (const auto& record : records) {
+            registry_.erase(record->simulationId());
+        }
+    };
+    for (size_t m = 0; m < members.size(); ++m) {
+        EnsembleMemberSpec& member = members[m];
+        auto& initial = initial_states[keys[m]];
+        if (!initial) {
+            initial = std::make_shared<SharedInitialState>(patient, member.params,
+                                                           members_per_key[keys[m]]);
+        }
+
+        const std::string sim_id = generateSimulationId();
+        auto record = std::make_shared<SimulationRecord>(
+            sim_id, base.patient_id(), member.name, member.params.num_steps(), created_at);
+        if (!registry_.insert(record)) {
+            unregister();
+            return grpc::Status(grpc::StatusCode::ALREADY_EXISTS,
+                              "Simulation ID collision, retry");
+        }
+        records.push_back(record);
+
+        // The patient data lives once in the shared state, not in every job
+        auto job = std::make_shared<SimulationJob>();
+        job->simulation_id = sim_id;
+        job->request.set_patient_id(base.patient_id());
+        job->request.set_simulation_name(member.name);
+        *job->request.mutable_params() = std::move(member.params);
+        *job->request.mutable_treatment() = std::move(member.treatment);
+        job->num_threads = scheduler_.resolveThreadCount(job->request.params().num_threads());
+        job->cost = JobScheduler::estimateCost(job->request.params());
+        job->run = [this, record, initial](SimulationJob& j) {
+            runSimulation(j, *record, {}, initial.get());
+        };
+        jobs.push_back(std::move(job));
+    }
+
+    if (!scheduler_.submitBatch(jobs)) {
+        unregister();
+        return grpc::Status(grpc::StatusCode::RESOURCE_EXHAUSTED,
+                          "Simulation queue cannot take the ensemble, retry later");
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(ensembles_mutex_);
+        ensembles_.emplace(ensemble_id, std::make_shared<const EnsembleRecord>(
+                                            ensemble_id, request->ensemble_name(), records));
+        sweepEnsembles();
+    }
+
+    response->set_ensemble_id(ensemble_id);
+    for (const auto& record : records) {
+        response->add_simulation_ids(record->simulationId());
+    }
+    response->set_status(SimulationStatus::QUEUED);
+    response->set_message("Ensemble of " + std::to_string(records.size()) +
+                          " simulations queued successfully");
+    return grpc::Status::OK;
+}
+
+grpc::Status SimulationServiceImpl::GetEnsembleStatus(
+    grpc::ServerContext* context,
+    const EnsembleStatusRequest* request,
+    EnsembleStatusResponse* response) {
+
+    if (request->ensemble_id().empty()) {
+        return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT,
+                          "Ensemble ID cannot be empty");
+    }
+    if (coordinator_) {
+        return coordinator_->getEnsembleStatus(context, *request, response);
+    }
+
+    std::shared_ptr<const EnsembleRecord> ensemble;
+    {
+        std::lock_guard<std::mutex> lock(ensembles_mutex_);
+        auto it = ensembles_.find(request->ensemble_id());
+        if (it != ensembles_.end()) {
+            if (ensembleRetired(*it->second)) {
+                ensembles_.erase(it);
+            } else {
+                ensemble = it->second;
+            }
+        }
+    }
+    if (!ensemble) {
+        return grpc::Status(grpc::StatusCode::NOT_FOUND,
+                          "Ensemble not found: " + request->ensemble_id());
+    }
+
+    ensemble->toStatusResponse(response);
+    return grpc::Status::OK;
+}
+
+bool SimulationServiceImpl::ensembleRetired(const EnsembleRecord& ensemble) const {
+    for (const auto& member : ensemble.members()) {
+        // A member resumed by LoadSimulation is a new record under the same ID
+        if (!member->isTerminal() || registry_.find(member->simulationId()) == member) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void SimulationServiceImpl::sweepEnsembles() {
+    if (ensembles_.size() < ensemble_sweep_at_) {
+        return;
+    }
+    for (auto it = ensembles_.begin(); it != ensembles_.end();) {
+        it = ensembleRetired(*it->second) ? ensembles_.erase(it) : std::next(it);
+    }
+    ensemble_sweep_at_ = std::max(kMinEnsembleSweep, 2 * ensembles_.size());
+}
+
+grpc::Status SimulationServiceImpl::UploadPatientData(
+    grpc::ServerContext* context,
+    grpc::ServerReader<PatientDataChunk>* reader,
+    UploadResponse* response) {
+
+    if (coordinator_) {
+        return grpc::Status(grpc::StatusCode::FAILED_PRECONDITION,
+                          "A coordinator keeps no uploads; upload to a node");
+    }
+
+    const std::string upload_id = generateSimulationId();
+    const std::filesystem::path directory = std::filesystem::path(upload_directory_) / upload_id;
+    auto discard = [&directory](grpc::StatusCode code, const std::string& message) {
+        std::error_code ec;
+        std::filesystem::remove_all(directory, ec);
+        return grpc::Status(code, message);
+    };
+
+    std::string error_msg;
+    PatientData data;
+    {
+        PatientUpload upload(directory.string());
+        PatientDataChunk chunk;
+        while (reader->Read(&chunk)) {
+            if (chunk.has_header()) {
+                upload.mergeHeader(chunk.header());
+            }
+            // Parsing runs behind the reads; the bytes move into the queue
+            if (!chunk.data().empty() &&
+                !upload.append(chunk.payload(), std::move(*chunk.mutable_data()), error_msg)) {
+                return discard(grpc::StatusCode::INVALID_ARGUMENT, error_msg);
+            }
+            chunk.Clear();
+        }
+        if (context->IsCancelled()) {
+            return discard(grpc::StatusCode::CANCELLED, "Upload cancelled");
+        }
+        if (!upload.finish(&data, error_msg)) {
+            return discard(grpc::StatusCode::INVALID_ARGUMENT, error_msg);
+        }
+
+        response->set_bytes_received(upload.bytesReceived());
+        response->set_reads(upload.reads());
+        for (const std::string& driver : upload.drivers()) {
+            response->add_driver_mutations(driver);
+        }
+    }
+
+    if (data.patient_id().empty()) {
+        return discard(grpc::StatusCode::INVALID_ARGUMENT, "Patient ID is required");
+    }
+    if (!validatePatientData(data, error_msg)) {
+        return discard(grpc::StatusCode::INVALID_ARGUMENT, error_msg);
+    }
+    response->set_upload_id(upload_id);
+    response->set_mutations(data.vcf().mutations_size());
+    response->set_message("Upload received");
+
+    // The spools go with the last reference, so queued simulations can still read them
+    std::shared_ptr<const PatientData> stored(
+        new PatientData(std::move(data)), [directory](const PatientData* patient) {
+            delete patient;
+            std::error_code ec;
+            std::filesystem::remove_all(directory, ec);
+        });
+    std::shared_ptr<const PatientData> evicted;
+    {
+        std::lock_guard<std::mutex> lock(uploads_mutex_);
+        uploads_.emplace(upload_id, std::move(stored));
+        upload_order_.push_back(upload_id);
+        if (upload_order_.size() > kMaxRetainedUploads) {
+            auto oldest = uploads_.find(upload_order_.front());
+            evicted = std::move(oldest->second);
+            uploads_.erase(oldest);
+            upload_order_.pop_front();
+        }
+    }
+    return grpc::Status::OK;
+}
+
 grpc::Status SimulationServiceImpl::GetSimulationStatus(
     grpc::ServerContext* context,
     const StatusRequest* request,
@@ -55,43 +659,279 @@ grpc::Status SimulationServiceImpl::GetSimulationStatus(
         return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, 
                           "Simulation ID cannot be empty");
     }
+    if (coordinator_) {
+        return coordinator_->getSimulationStatus(context, *request, response);
+    }
 
-    // Stub implementation - return placeholder status
-    response->set_simulation_id(request->simulation_id());
-    response->set_status(SimulationStatus::QUEUED);
-    response->set_current_step(0);
-    response->set_total_steps(100);
-    response->set_progress_percentage(0.0);
-    response->set_estimated_time_remaining(3600);
-    response->set_message("Simulation is queued");
+    auto record = registry_.find(request->simulation_id());
+    if (!record) {
+        return grpc::Status(grpc::StatusCode::NOT_FOUND,
+                          "Simulation not found: " + request->simulation_id());
+    }
+
+    record->toStatusResponse(response);
 
     return grpc::Status::OK;
 }
 
+grpc::Status SimulationServiceImpl::WatchSimulation(
+    grpc::ServerContext* context,
+    const WatchRequest* request,
+    grpc::ServerWriter<StatusResponse>* writer) {
+
+    if (coordinator_) {
+        return grpc::Status(grpc::StatusCode::UNIMPLEMENTED,
+                          "Watch the node running the simulation, not the coordinator");
+    }
+
+    std::shared_ptr<SimulationRecord> record;
+    grpc::Status target_status = watchTarget(*request, &record);
+    if (!target_status.ok()) {
+        return target_status;
+    }
+
+    struct WatchGuard {
+        SimulationRecord& record;
+        explicit WatchGuard(SimulationRecord& r) : record(r) { record.addWatcher(); }
+        ~WatchGuard() { record.removeWatcher(); }
+    } guard(*record);
+
+    // Wake up regularly to notice cancelled clients and server shutdown
+    constexpr auto kPollInterval = std::chrono::milliseconds(100);
+    WatchCursor cursor(*request);
+
+    // Updates are built on an arena reset before each one. Its first block is
+    // on the stack, so a long-running watch streams without heap allocations.
+    alignas(std::max_align_t) char arena_block[4096];
+    google::protobuf::ArenaOptions arena_options;
+    arena_options.initial_block = arena_block;
+    arena_options.initial_block_size = sizeof(arena_block);
+    google::protobuf::Arena arena(arena_options);
+
+    while (true) {
+        if (context->IsCancelled()) {
+            return grpc::Status(grpc::StatusCode::CANCELLED, "Client cancelled the watch");
+        }
+        if (!is_serving_) {
+            return grpc::Status(grpc::StatusCode::UNAVAILABLE, "Service is shutting down");
+        }
+
+        // Read the version first so a change made while sending is not missed
+        const uint64_t version = record->version();
+        const auto now = WatchCursor::Clock::now();
+        WatchCursor::Clock::duration wait{};
+
+        if (cursor.due(*record, now, &wait)) {
+            // Always the latest state: whatever changed while the previous
+            // Write() was blocked on a slow client collapses into this update
+            arena.Reset();
+            auto* response = google::protobuf::Arena::CreateMessage<StatusResponse>(&arena);
+            record->toStatusResponse(response);
+            if (!writer->Write(*response)) {
+                return grpc::Status(grpc::StatusCode::CANCELLED, "Client stopped reading");
+            }
+            if (cursor.sent(*response, now)) {
+                return grpc::Status::OK;
+            }
+        } else if (wait > WatchCursor::Clock::duration::zero()) {
+            // Rate limited: progress is pending, so wait out the interval instead
+            std::this_thread::sleep_for(std::min<WatchCursor::Clock::duration>(wait, kPollInterval));
+        } else {
+            record->waitForChange(version, kPollInterval);
+        }
+    }
+}
+
+grpc::Status SimulationServiceImpl::watchTarget(const WatchRequest& request,
+                                                std::shared_ptr<SimulationRecord>* record) const {
+    // Validate simulation ID
+    if (request.simulation_id().empty()) {
+        return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT,
+                          "Simulation ID cannot be empty");
+    }
+    if (request.step_interval() < 0 || request.min_interval_ms() < 0) {
+        return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT,
+                          "Watch intervals must be non-negative");
+    }
+
+    *record = registry_.find(request.simulation_id());
+    if (!*record) {
+        return grpc::Status(grpc::StatusCode::NOT_FOUND,
+                          "Simulation not found: " + request.simulation_id());
+    }
+    return grpc::Status::OK;
+}
+
 grpc::Status SimulationServiceImpl::GetSimulationResults(
     grpc::ServerContext* context,
     const ResultsRequest* request,
     grpc::ServerWriter<ResultsChunk>* writer) {
-    
+
+    if (coordinator_) {
+        return coordinator_->getSimulationResults(context, *request, writer);
+    }
+
+    // Chunks are produced one at a time; a blocking Write() only returns once
+    // the transport has taken the previous one, so a slow reader throttles
+    // encoding instead of making the server buffer the whole state
+
+    // Only encoding is timed, not the writes a slow client holds up
+    uint64_t start_ns = StepProfiler::nowNs();
+    std::unique_ptr<ResultsStream> stream;
+    grpc::Status open_status = openResults(*request, &stream);
+    if (!open_status.ok()) {
+        return open_status;
+    }
+
+    uint64_t encode_ns = 0;
+    ResultsChunk chunk;
+    while (stream->next(&chunk)) {
+        encode_ns += StepProfiler::nowNs() - start_ns;
+        if (context->IsCancelled() || !writer->Write(chunk)) {
+            return grpc::Status(grpc::StatusCode::CANCELLED, "Results stream cancelled by client");
+        }
+        start_ns = StepProfiler::nowNs();
+    }
+    encode_ns += StepProfiler::nowNs() - start_ns;
+    recordResultSerialization(encode_ns);
+
+    return grpc::Status::OK;
+}
+
+grpc::Status SimulationServiceImpl::openResults(const ResultsRequest& request,
+                                                std::unique_ptr<ResultsStream>* stream) const {
     // Validate simulation ID
-    if (request->simulation_id().empty()) {
+    if (request.simulation_id().empty()) {
         return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT,
                           "Simulation ID cannot be empty");
     }
 
-    // Stub implementation - send a single empty chunk
-    ResultsChunk chunk;
-    chunk.set_simulation_id(request->simulation_id());
-    chunk.set_chunk_number(0);
-    chunk.set_total_chunks(1);
-    chunk.set_is_final(true);
-    chunk.set_data("");  // Empty data for now
+    auto record = registry_.find(request.simulation_id());
+    if (!record) {
+        return grpc::Status(grpc::StatusCode::NOT_FOUND,
+                          "Simulation not found: " + request.simulation_id());
+    }
+
+    // A finished simulation's final state is released to its history
+    auto snapshot = record->snapshot();
+    const int32_t step = request.step_number() >= 0 || snapshot ? request.step_number()
+                                                                : record->resultsStep();
+    if (step >= 0 && (!snapshot || step != snapshot->step)) {
+        grpc::Status past_status = pastSnapshot(*record, request, step, &snapshot);
+        if (!past_status.ok()) {
+            return past_status;
+        }
+    }
+    if (!snapshot) {
+        return grpc::Status(grpc::StatusCode::FAILED_PRECONDITION,
+                          "No results available for simulation: " + request.simulation_id());
+    }
+
+    // The header (parameters map included) lives only until it is serialized;
+    // building it on an arena replaces its per-field allocations with one block
+    google::protobuf::Arena arena;
+    auto* header = google::protobuf::Arena::CreateMessage<SimulationState>(&arena);
+    header->set_simulation_id(record->simulationId());
+    header->set_patient_id(record->patientId());
+    header->set_current_step(snapshot->step);
+    header->set_current_time(snapshot->time);
+    header->set_status(record->status());
+    *header->mutable_parameters() = snapshot->parameters;
+    *header->mutable_metrics() = snapshot->metrics;
+    header->set_created_at(record->createdAt());
+    header->set_updated_at(record->updatedAt());
 
-    writer->Write(chunk);
+    auto results = std::make_unique<ResultsStream>(*header, std::move(snapshot));
+    std::string error_msg;
+    if (!results->init(request, error_msg)) {
+        return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, error_msg);
+    }
+    *stream = std::move(results);
+    return grpc::Status::OK;
+}
+
+grpc::Status SimulationServiceImpl::pastSnapshot(
+    const SimulationRecord& record, const ResultsRequest& request, int32_t step,
+    std::shared_ptr<const SimulationSnapshot>* snapshot) const {
+    auto history = record.history();
+    if (!history || !history->hasStep(step)) {
+        return grpc::Status(grpc::StatusCode::NOT_FOUND,
+                          "No results stored for step " + std::to_string(step));
+    }
 
+    std::string error_msg;
+    if (request.include_grid_data() || request.include_agents()) {
+        const std::vector<int32_t> stored = history->snapshotSteps();
+        if (!std::binary_search(stored.begin(), stored.end(), step)) {
+            const int interval = StepHistory::snapshotInterval(history->parameters());
+            return grpc::Status(grpc::StatusCode::NOT_FOUND,
+                              "No grids or agents stored for step " + std::to_string(step) +
+                              (interval > 0 ? "; they are kept every " +
+                                                  std::to_string(interval) + " steps"
+                                            : "; only the final state is kept"));
+        }
+        auto past = history->loadSnapshot(step, error_msg);
+        if (!past) {
+            return grpc::Status(grpc::StatusCode::DATA_LOSS, error_msg);
+        }
+        *snapshot = std::move(past);
+        return grpc::Status::OK;
+    }
+
+    // Metrics alone come straight from the step's row of the history columns
+    auto past = std::make_shared<SimulationSnapshot>();
+    if (!history->metrics(step, &past->metrics, error_msg)) {
+        return grpc::Status(grpc::StatusCode::DATA_LOSS, error_msg);
+    }
+    past->step = step;
+    past->time = past->metrics.simulation_time();
+    past->parameters = history->parameters();
+    *snapshot = std::move(past);
     return grpc::Status::OK;
 }
 
+grpc::Status SimulationServiceImpl::GetMetricHistory(
+    grpc::ServerContext* context,
+    const MetricHistoryRequest* request,
+    MetricHistory* response) {
+
+    if (request->simulation_id().empty()) {
+        return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT,
+                          "Simulation ID cannot be empty");
+    }
+    if (request->stride() < 0) {
+        return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT,
+                          "Stride must be non-negative");
+    }
+    if (coordinator_) {
+        return coordinator_->getMetricHistory(context, *request, response);
+    }
+
+    auto record = registry_.find(request->simulation_id());
+    if (!record) {
+        return grpc::Status(grpc::StatusCode::NOT_FOUND,
+                          "Simulation not found: " + request->simulation_id());
+    }
+
+    response->set_simulation_id(request->simulation_id());
+    auto history = record->history();
+    if (!history) {
+        return grpc::Status::OK;  // Nothing recorded before the simulation starts
+    }
+    std::string error_msg;
+    const int32_t to_step =
+        request->to_step() > 0 ? request->to_step() : std::numeric_limits<int32_t>::max();
+    if (!history->read(request->from_step(), to_step, request->stride(),
+                       request->include_details(), response, error_msg)) {
+        return grpc::Status(grpc::StatusCode::DATA_LOSS, error_msg);
+    }
+    return grpc::Status::OK;
+}
+
+void SimulationServiceImpl::recordResultSerialization(uint64_t encode_ns) const {
+    result_serialization_seconds_->observe(static_cast<double>(encode_ns) * 1e-9);
+}
+
 grpc::Status SimulationServiceImpl::StopSimulation(
     grpc::ServerContext* context,
     const StopRequest* request,
@@ -102,14 +942,41 @@ grpc::Status SimulationServiceImpl::StopSimulation(
         return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT,
                           "Simulation ID cannot be empty");
     }
+    if (coordinator_) {
+        return coordinator_->stopSimulation(context, *request, response);
+    }
+
+    auto record = registry_.find(request->simulation_id());
+    if (!record) {
+        return grpc::Status(grpc::StatusCode::NOT_FOUND,
+                          "Simulation not found: " + request->simulation_id());
+    }
 
-    // Stub implementation
     response->set_simulation_id(request->simulation_id());
-    response->set_success(true);
-    response->set_message("Simulation stop requested");
-    
+    if (record->isTerminal()) {
+        response->set_success(false);
+        response->set_message("Simulation has already finished");
+        return grpc::Status::OK;
+    }
+
+    // A queued job is dropped right away; a running one stops at its next step
     if (request->save_checkpoint()) {
-        response->set_checkpoint_path("/tmp/checkpoint_" + request->simulation_id());
+        record->requestCheckpoint();
+    }
+    scheduler_.cancel(request->simulation_id());
+    bool stopped_before_start =
+        record->status() == SimulationStatus::QUEUED &&
+        registry_.updateStatus(*record, SimulationStatus::STOPPED, "Simulation stopped before start");
+
+    response->set_success(true);
+    if (!request->save_checkpoint()) {
+        response->set_message("Simulation stop requested");
+    } else if (stopped_before_start) {
+        response->set_message("Simulation stopped before start, nothing to checkpoint");
+    } else {
+        // Written by the worker once it reaches its next step boundary
+        response->set_checkpoint_path(checkpointPath(request->simulation_id()));
+        response->set_message("Simulation stop requested, checkpoint will be written");
     }
 
     return grpc::Status::OK;
@@ -120,8 +987,27 @@ grpc::Status SimulationServiceImpl::ListSimulations(
     const ListRequest* request,
     SimulationList* response) {
     
-    // Stub implementation - return empty list
-    response->set_total_count(0);
+    if (request->limit() < 0 || request->offset() < 0) {
+        return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT,
+                          "Limit and offset must be non-negative");
+    }
+    if (coordinator_) {
+        return coordinator_->listSimulations(context, *request, response);
+    }
+
+    // A zero limit means "default page size"
+    int32_t limit = request->limit() > 0 ? std::min(request->limit(), kMaxListLimit)
+                                         : kDefaultListLimit;
+
+    size_t total_count = 0;
+    auto records = registry_.list(request->patient_id(), request->status(),
+                                  static_cast<size_t>(request->offset()),
+                                  static_cast<size_t>(limit), total_count);
+
+    for (const auto& record : records) {
+        record->toSummary(response->add_simulations());
+    }
+    response->set_total_count(static_cast<int32_t>(total_count));
 
     return grpc::Status::OK;
 }
@@ -137,10 +1023,101 @@ grpc::Status SimulationServiceImpl::LoadSimulation(
                           "Simulation ID cannot be empty");
     }
 
-    // Stub implementation
-    response->set_simulation_id(request->simulation_id());
-    response->set_success(false);
-    response->set_message("Load simulation not yet implemented");
+    // The ID names the checkpoint file written for the resumed run
+    const std::string& sim_id = request->simulation_id();
+    if (!isSafeSimulationId(sim_id)) {
+        return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT,
+                          "Simulation ID may only contain letters, digits, '-' and '_'");
+    }
+    if (coordinator_) {
+        return grpc::Status(grpc::StatusCode::FAILED_PRECONDITION,
+                          "Checkpoints are on the nodes; load them on the node that wrote them");
+    }
+
+    // Only checkpoints written by this service may be loaded
+    std::error_code ec;
+    auto directory = std::filesystem::weakly_canonical(checkpoint_directory_, ec);
+    if (directory.filename().empty()) {
+        directory = directory.parent_path();  // Trailing separator
+    }
+    const auto path = std::filesystem::weakly_canonical(
+        request->checkpoint_path().empty() ? checkpointPath(sim_id) : request->checkpoint_path(), ec);
+    auto [dir_end, path_it] = std::mismatch(directory.begin(), directory.end(),
+                                            path.begin(), path.end());
+    if (ec || dir_end != directory.end() || path_it == path.end()) {
+        return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT,
+                          "Checkpoint path must be inside " + checkpoint_directory_);
+    }
+
+    if (!std::filesystem::exists(path, ec)) {
+        return grpc::Status(grpc::StatusCode::NOT_FOUND,
+                          "Checkpoint not found: " + path.string());
+    }
+
+    // Bulk sections stay mapped until the worker has copied them into the engine
+    CheckpointChain checkpoint;
+    std::string error_msg;
+    if (!CheckpointSeries::open(path.string(), checkpoint, error_msg)) {
+        return grpc::Status(grpc::StatusCode::DATA_LOSS, error_msg);
+    }
+
+    // The last delta in the chain holds the latest state
+    const SimulationState& saved = checkpoint.back()->metadata();
+    if (!validateSimulationParameters(saved.parameters(), error_msg)) {
+        return grpc::Status(grpc::StatusCode::DATA_LOSS,
+                          "Checkpoint parameters are invalid: " + error_msg);
+    }
+    if (!DrugTransport::validate(saved.treatment(), error_msg)) {
+        return grpc::Status(grpc::StatusCode::DATA_LOSS,
+                          "Checkpoint treatment is invalid: " + error_msg);
+    }
+
+    // A finished simulation may be resumed under its own ID; an active one may not
+    if (auto existing = registry_.find(sim_id)) {
+        if (!existing->isTerminal()) {
+            return grpc::Status(grpc::StatusCode::ALREADY_EXISTS,
+                              "Simulation is still active: " + sim_id);
+        }
+        registry_.erase(sim_id);
+    }
+
+    auto now = std::chrono::system_clock::now();
+    auto record = std::make_shared<SimulationRecord>(
+        sim_id,
+        saved.patient_id(),
+        saved.simulation_name(),
+        saved.parameters().num_steps(),
+        std::chrono::duration_cast<std::chrono::seconds>(now.time_since_epoch()).count());
+    record->setProgress(saved.current_step());
+    if (!registry_.insert(record)) {
+        return grpc::Status(grpc::StatusCode::ALREADY_EXISTS,
+                          "Simulation is still active: " + sim_id);
+    }
+
+    auto job = std::make_shared<SimulationJob>();
+    job->simulation_id = sim_id;
+    job->request.set_patient_id(saved.patient_id());
+    job->request.set_simulation_name(saved.simulation_name());
+    *job->request.mutable_params() = saved.parameters();
+    *job->request.mutable_treatment() = saved.treatment();
+    job->num_threads = scheduler_.resolveThreadCount(saved.parameters().num_threads());
+    job->run = [this, record, checkpoint](SimulationJob& j) {
+        runSimulation(j, *record, checkpoint);
+    };
+
+    if (!scheduler_.submit(job)) {
+        registry_.erase(sim_id);
+        return grpc::Status(grpc::StatusCode::RESOURCE_EXHAUSTED,
+                          "Simulation queue is full, retry later");
+    }
+
+    response->set_simulation_id(sim_id);
+    response->set_success(true);
+    response->set_message("Simulation resumed from step " +
+                          std::to_string(saved.current_step()));
+    *response->mutable_state() = saved;
+    response->mutable_state()->set_simulation_id(sim_id);
+    response->mutable_state()->set_status(SimulationStatus::QUEUED);
 
     return grpc::Status::OK;
 }
@@ -150,18 +1127,399 @@ grpc::Status SimulationServiceImpl::HealthCheck(
     const HealthCheckRequest* request,
     HealthCheckResponse* response) {
     
-    // Health check always returns SERVING if the server is running
-    if (is_serving_) {
-        response->set_status(HealthCheckResponse::SERVING);
-        response->set_message("Service is healthy");
-    } else {
+    // SERVING once the server is running and its engines are warm
+    if (!is_serving_) {
         response->set_status(HealthCheckResponse::NOT_SERVING);
         response->set_message("Service is shutting down");
+    } else if (!engine_pool_.ready()) {
+        response->set_status(HealthCheckResponse::NOT_SERVING);
+        response->set_message("Service is warming up simulation engines");
+    } else {
+        response->set_status(HealthCheckResponse::SERVING);
+        response->set_message("Service is healthy");
     }
 
     return grpc::Status::OK;
 }
 
+grpc::Status SimulationServiceImpl::ReportNodeStatus(
+    grpc::ServerContext* context,
+    const NodeStatus* request,
+    NodeStatusResponse* response) {
+
+    if (!coordinator_) {
+        return grpc::Status(grpc::StatusCode::FAILED_PRECONDITION,
+                          "This server is not a coordinator");
+    }
+    return coordinator_->reportNodeStatus(*request, response);
+}
+
+grpc::Status SimulationServiceImpl::authorizeRelease(const std::string& token) const {
+    if (release_token_.empty()) {
+        return grpc::Status(grpc::StatusCode::FAILED_PRECONDITION,
+                          "This server has not joined a coordinator");
+    }
+    if (token != release_token_) {
+        return grpc::Status(grpc::StatusCode::PERMISSION_DENIED,
+                          "Only the coordinator this node joined may release its simulations");
+    }
+    return grpc::Status::OK;
+}
+
+grpc::Status SimulationServiceImpl::ReleaseQueuedJobs(
+    grpc::ServerContext* context,
+    const ReleaseJobsRequest* request,
+    ReleaseJobsResponse* response) {
+
+    grpc::Status authorized = authorizeRelease(request->release_token());
+    if (!authorized.ok()) {
+        return authorized;
+    }
+    if (request->max_jobs() < 0 || request->hold_ms() <= 0) {
+        return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT,
+                          "max_jobs must be non-negative and hold_ms positive");
+    }
+    expireReleases();
+
+    // Held out of the queue with their records until the coordinator confirms
+    // which ones started elsewhere under the same IDs
+    PendingRelease release;
+    release.jobs = scheduler_.takeQueued(static_cast<size_t>(request->max_jobs()));
+    if (release.jobs.empty()) {
+        return grpc::Status::OK;
+    }
+    for (const auto& job : release.jobs) {
+        SimulationRequest* released = response->add_requests();
+        *released = job->request;
+        *released->mutable_data() = *job->patient;
+        released->set_simulation_id(job->simulation_id);
+    }
+    release.expires = std::chrono::steady_clock::now() +
+        std::chrono::milliseconds(std::min(request->hold_ms(), kMaxReleaseHoldMs));
+
+    const std::string release_id = generateSimulationId();
+    {
+        std::lock_guard<std::mutex> lock(releases_mutex_);
+        pending_releases_.emplace(release_id, std::move(release));
+    }
+    response->set_release_id(release_id);
+    return grpc::Status::OK;
+}
+
+grpc::Status SimulationServiceImpl::ConfirmRelease(
+    grpc::ServerContext* context,
+    const ConfirmReleaseRequest* request,
+    ConfirmReleaseResponse* response) {
+
+    grpc::Status authorized = authorizeRelease(request->release_token());
+    if (!authorized.ok()) {
+        return authorized;
+    }
+
+    PendingRelease release;
+    {
+        std::lock_guard<std::mutex> lock(releases_mutex_);
+        auto it = pending_releases_.find(request->release_id());
+        if (it == pending_releases_.end()) {
+            return grpc::Status(grpc::StatusCode::NOT_FOUND,
+                              "Release expired or unknown: " + request->release_id());
+        }
+        release = std::move(it->second);
+        pending_releases_.erase(it);
+    }
+
+    const std::unordered_set<std::string> moved(request->moved_ids().begin(),
+                                                request->moved_ids().end());
+    std::vector<std::shared_ptr<SimulationJob>> kept;
+    for (const auto& job : release.jobs) {
+        if (moved.count(job->simulation_id) == 0) {
+            kept.push_back(job);
+            continue;
+        }
+        // A stop that arrived during the handoff is passed on to the new copy
+        auto record = registry_.find(job->simulation_id);
+        if (record && record->isTerminal()) {
+            response->add_stopped_ids(job->simulation_id);
+        }
+        registry_.erase(job->simulation_id);
+    }
+    scheduler_.restore(kept);
+    return grpc::Status::OK;
+}
+
+void SimulationServiceImpl::expireReleases() {
+    std::vector<PendingRelease> expired;
+    {
+        const auto now = std::chrono::steady_clock::now();
+        std::lock_guard<std::mutex> lock(releases_mutex_);
+        for (auto it = pending_releases_.begin(); it != pending_releases_.end();) {
+            if (it->second.expires <= now) {
+                expired.push_back(std::move(it->second));
+                it = pending_releases_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+    for (const PendingRelease& release : expired) {
+        std::cerr << "Coordinator did not confirm " << release.jobs.size()
+                  << " released simulations; queueing them again" << std::endl;
+        scheduler_.restore(release.jobs);
+    }
+}
+
+void SimulationServiceImpl::warmUp(size_t engines, const SimulationParameters& params,
+                                   std::function<void()> on_ready) {
+    engine_pool_.warmUp(engines, params,
+                        static_cast<int>(scheduler_.resolveThreadCount(params.num_threads())),
+                        std::move(on_ready));
+}
+
+void SimulationServiceImpl::enableCoordinator(int heartbeat_ms) {
+    coordinator_ = std::make_unique<ClusterCoordinator>(heartbeat_ms);
+}
+
+void SimulationServiceImpl::setRetention(size_t max_finished, std::chrono::seconds ttl) {
+    registry_.setRetention(max_finished, ttl);
+}
+
+void SimulationServiceImpl::joinCluster() {
+    // Straight from the random device: the token is the node's only credential
+    std::random_device rd;
+    std::stringstream ss;
+    ss << std::hex << std::setfill('0');
+    for (int i = 0; i < 4; ++i) {
+        ss << std::setw(8) << rd();
+    }
+    release_token_ = ss.str();
+}
+
+void SimulationServiceImpl::nodeStatus(NodeStatus* status) const {
+    status->set_release_token(release_token_);
+    status->set_core_budget(static_cast<int32_t>(scheduler_.coreBudget()));
+    status->set_cores_in_use(static_cast<int32_t>(scheduler_.coresInUse()));
+    status->set_running_jobs(static_cast<int32_t>(scheduler_.runningJobs()));
+    status->set_queued_jobs(static_cast<int32_t>(scheduler_.queueDepth()));
+    status->set_queued_cost(scheduler_.queuedCost());
+    status->set_outstanding_cost(scheduler_.outstandingCost());
+}
+
+// ============================================================================
+// Simulation Execution
+// ============================================================================
+
+void SimulationServiceImpl::runSimulation(
+    SimulationJob& job, SimulationRecord& record,
+    const CheckpointChain& checkpoint, SharedInitialState* initial) {
+    if (!registry_.updateStatus(record, SimulationStatus::RUNNING, "Simulation is running")) {
+        return;  // Stopped while queued
+    }
+
+    try {
+        // A multi-rank run drives rank 0 of its own slab engines; the other ranks
+        // follow until `ranks` goes out of scope
+        std::unique_ptr<SlabRanks> ranks;
+        EnginePool::Lease lease;
+        if (job.request.params().num_mpi_ranks() > 1) {
+            ranks = std::make_unique<SlabRanks>(job.request.params(),
+                                                static_cast<int>(job.num_threads));
+        } else {
+            // An idle warm engine when there is one; it goes back to the pool when the run ends
+            lease = engine_pool_.acquire(job.request.params(), static_cast<int>(job.num_threads));
+            (lease.warm() ? warm_engine_runs_ : cold_engine_runs_)->increment();
+        }
+        SimulationEngine& engine = ranks ? ranks->engine() : *lease;
+        engine.setTreatment(job.request.treatment());
+        std::string error_msg;
+        if (initial) {
+            // Ensemble members copy the state seeded once for all of them
+            if (!initial->initialize(engine, *patient_cache_, static_cast<int>(job.num_threads),
+                                     error_msg)) {
+                registry_.updateStatus(record, SimulationStatus::FAILED,
+                                       "Failed to preprocess patient data: " + error_msg);
+                return;
+            }
+        } else if (checkpoint.empty()) {
+            // Sweeps over one patient build its model once; later runs share it
+            auto patient = patient_cache_->get(*job.patient, error_msg);
+            if (!patient) {
+                registry_.updateStatus(record, SimulationStatus::FAILED,
+                                       "Failed to preprocess patient data: " + error_msg);
+                return;
+            }
+            engine.initialize(*patient);
+        }
+        for (const auto& reader : checkpoint) {
+            if (!reader->restore(engine, error_msg)) {
+                registry_.updateStatus(record, SimulationStatus::FAILED,
+                                       "Failed to restore checkpoint: " + error_msg);
+                return;
+            }
+        }
+
+        const SimulationParameters& params = job.request.params();
+        auto compaction = params.extra_params().find(CheckpointSeries::kParamCompactionInterval);
+        CheckpointSeries series(checkpointPath(record.simulationId()),
+                                compaction != params.extra_params().end()
+                                    ? static_cast<int>(compaction->second)
+                                    : CheckpointSeries::kDefaultCompactionInterval);
+
+        // Metrics of every step and the state every snapshot interval, kept for later
+        // requests; a resumed run rewinds the history to its checkpoint
+        auto history = std::make_shared<StepHistory>(historyPath(record.simulationId()));
+        if (history->open(params, checkpoint.empty() ? -1 : engine.currentStep(), error_msg)) {
+            record.setHistory(history);
+        } else {
+            std::cerr << "History of " << record.simulationId() << " is unavailable: "
+                      << error_msg << std::endl;
+            history.reset();
+        }
+        const int snapshot_interval = StepHistory::snapshotInterval(params);
+
+        const int num_steps = params.num_steps();
+        const int interval = params.checkpoint_interval();
+        std::array<uint64_t, kNumProfilePhases> published{};
+        // A failed history write ends the history, not the simulation
+        auto historyFailed = [&] {
+            std::cerr << "History of " << record.simulationId() << " stopped at step "
+                      << engine.currentStep() << ": " << error_msg << std::endl;
+            history.reset();
+        };
+        auto recordStep = [&] {
+            // Metrics cost a pass over the agents: computed once for the history and watchers
+            if (!history && !record.hasWatchers()) {
+                return;
+            }
+            SimulationMetrics metrics;
+            engine.computeMetrics(&metrics);
+            if (record.hasWatchers()) {
+                record.setMetrics(metrics);
+            }
+            if (history) {
+                ScopedPhaseTimer timer(engine.profiler(), ProfilePhase::History);
+                const bool snapshot_due =
+                    snapshot_interval > 0 && engine.currentStep() % snapshot_interval == 0;
+                if (!history->append(metrics, error_msg) ||
+                    (snapshot_due && !history->writeSnapshot(*engine.snapshot(), error_msg))) {
+                    historyFailed();
+                }
+            }
+        };
+        auto publishSnapshot = [&] {
+            std::shared_ptr<const SimulationSnapshot> snapshot;
+            {
+                ScopedPhaseTimer timer(engine.profiler(), ProfilePhase::Snapshot);
+                snapshot = engine.snapshot();
+                record.setSnapshot(snapshot);
+            }
+            // The last state is kept whatever the interval
+            if (history && (snapshot_interval <= 0 || snapshot->step % snapshot_interval != 0)) {
+                ScopedPhaseTimer timer(engine.profiler(), ProfilePhase::History);
+                if (!history->writeSnapshot(*snapshot, error_msg)) {
+                    historyFailed();
+                }
+            }
+            // Only called as the run ends: once stored, results are loaded from the history
+            if (history) {
+                record.releaseSnapshot();
+            }
+            publishProfile(engine.profiler(), &published);
+        };
+
+        // A new history starts with the state the run starts from
+        if (history && history->rows() == 0) {
+            recordStep();
+        }
+        while (engine.currentStep() < num_steps) {
+            if (job.cancelRequested()) {
+                // The stop checkpoint is always full so it can be loaded on its own
+                if (record.checkpointRequested() &&
+                    !writeCheckpoint(job, record, engine, series, true, error_msg)) {
+                    publishSnapshot();
+                    registry_.updateStatus(record, SimulationStatus::STOPPED,
+                                           "Simulation stopped, checkpoint failed: " + error_msg);
+                    return;
+                }
+                // Partial results stay retrievable after a stop
+                publishSnapshot();
+                registry_.updateStatus(record, SimulationStatus::STOPPED, "Simulation stopped");
+                return;
+            }
+            const uint64_t step_start_ns = StepProfiler::nowNs();
+            engine.step();
+            step_seconds_->observe(static_cast<double>(StepProfiler::nowNs() - step_start_ns) *
+                                   1e-9);
+            steps_total_->increment();
+            recordStep();
+            record.setProgress(engine.currentStep());
+
+            // A failed periodic checkpoint only costs restart time, so keep going
+            if (interval > 0 && engine.currentStep() % interval == 0 &&
+                !writeCheckpoint(job, record, engine, series, false, error_msg)) {
+                std::cerr << "Checkpoint of " << record.simulationId() << " failed: "
+                          << error_msg << std::endl;
+            }
+            publishProfile(engine.profiler(), &published);
+        }
+
+        // Published before the status so COMPLETED always implies results
+        publishSnapshot();
+    } catch (const std::exception& e) {
+        registry_.updateStatus(record, SimulationStatus::FAILED,
+                               std::string("Simulation failed: ") + e.what());
+        return;
+    }
+
+    registry_.updateStatus(record, SimulationStatus::COMPLETED, "Simulation completed");
+}
+
+bool SimulationServiceImpl::writeCheckpoint(const SimulationJob& job,
+                                            const SimulationRecord& record,
+                                            SimulationEngine& engine,
+                                            CheckpointSeries& series, bool compact,
+                                            std::string& error_msg) const {
+    // Every rank would have to write its slab; the validator refuses periodic ones
+    if (engine.domain()) {
+        error_msg = "Multi-rank simulations cannot be checkpointed";
+        return false;
+    }
+    ScopedPhaseTimer timer(engine.profiler(), ProfilePhase::Checkpoint);
+    SimulationState metadata;
+    metadata.set_simulation_id(record.simulationId());
+    metadata.set_patient_id(record.patientId());
+    metadata.set_simulation_name(record.simulationName());
+    metadata.set_current_step(engine.currentStep());
+    metadata.set_current_time(engine.currentTime());
+    metadata.set_status(record.status());
+    *metadata.mutable_parameters() = engine.parameters();
+    *metadata.mutable_treatment() = job.request.treatment();
+    engine.computeMetrics(metadata.mutable_metrics());
+    metadata.set_created_at(record.createdAt());
+    metadata.set_updated_at(record.updatedAt());
+
+    return series.write(metadata, engine, compact, error_msg);
+}
+
+void SimulationServiceImpl::publishProfile(const StepProfiler& profiler,
+                                           std::array<uint64_t, kNumProfilePhases>* seen) const {
+    for (size_t p = 0; p < kNumProfilePhases; ++p) {
+        const StepProfiler::PhaseStats& stats = profiler.stats(static_cast<ProfilePhase>(p));
+        // Phases run at most once per step, so the latest call is the only new one
+        if (stats.calls != (*seen)[p]) {
+            phase_seconds_[p]->observe(static_cast<double>(stats.last_ns) * 1e-9);
+            (*seen)[p] = stats.calls;
+        }
+    }
+}
+
+std::string SimulationServiceImpl::checkpointPath(const std::string& simulation_id) const {
+    return (std::filesystem::path(checkpoint_directory_) / (simulation_id + ".ckpt")).string();
+}
+
+std::string SimulationServiceImpl::historyPath(const std::string& simulation_id) const {
+    return (std::filesystem::path(history_directory_) / simulation_id).string();
+}
+
 // ============================================================================
 // Validation Methods
 // ============================================================================
@@ -169,20 +1527,51 @@ grpc::Status SimulationServiceImpl::HealthCheck(
 bool SimulationServiceImpl::validateSimulationRequest(
     const SimulationRequest& request, 
     std::string& error_msg) {
-    
+
+    // Cheap checks first: a bad request is refused before its payloads are scanned
+    if (!validateRequestEnvelope(request, request.has_data(), error_msg)) {
+        return false;
+    }
+
+    if (request.has_data()) {
+        // Spool paths come from the server's own uploads, never from a request
+        for (const auto& entry : request.data().metadata()) {
+            if (PatientUpload::isReservedMetadataKey(entry.first)) {
+                error_msg = "Metadata key " + entry.first + " is reserved";
+                return false;
+            }
+        }
+    }
+    if (request.has_data() && !validatePatientData(request.data(), error_msg)) {
+        return false;
+    }
+
+    return true;
+}
+
+bool SimulationServiceImpl::validateRequestEnvelope(
+    const SimulationRequest& request, bool has_data,
+    std::string& error_msg) {
+
     // Validate patient ID
     if (request.patient_id().empty()) {
         error_msg = "Patient ID is required";
         return false;
     }
 
-    // Validate patient data
-    if (!request.has_data()) {
+    // Validate patient data, sent inline or uploaded before (checked in StartSimulation)
+    if (!has_data && request.upload_id().empty()) {
         error_msg = "Patient data is required";
         return false;
     }
-    
-    if (!validatePatientData(request.data(), error_msg)) {
+    if (has_data && !request.upload_id().empty()) {
+        error_msg = "Patient data and an upload ID are mutually exclusive";
+        return false;
+    }
+
+    // Chosen by a coordinator; it names the files kept for the run
+    if (!request.simulation_id().empty() && !isSafeSimulationId(request.simulation_id())) {
+        error_msg = "Simulation ID may only contain letters, digits, '-' and '_'";
         return false;
     }
 
@@ -196,6 +1585,15 @@ bool SimulationServiceImpl::validateSimulationRequest(
         return false;
     }
 
+    // Drugs are optional; a protocol that is sent must be simulable
+    if (!DrugTransport::validate(request.treatment(), error_msg)) {
+        return false;
+    }
+    if (request.params().num_mpi_ranks() > 1 && request.treatment().drugs_size() > 0) {
+        error_msg = "Multi-rank simulations do not support treatments";
+        return false;
+    }
+
     return true;
 }
 
@@ -209,7 +1607,8 @@ bool SimulationServiceImpl::validateSimulationParameters(
         return false;
     }
 
-    // Check for reasonable grid size (prevent memory exhaustion)
+    // Check for reasonable grid size (prevent memory exhaustion). Grids beyond
+    // one process are split across ranks (see below).
     const int64_t max_grid_cells = 1000LL * 1000LL * 1000LL;  // 1 billion cells
     int64_t total_cells = static_cast<int64_t>(params.grid_size_x()) * 
                          static_cast<int64_t>(params.grid_size_y()) * 
@@ -286,6 +1685,27 @@ bool SimulationServiceImpl::validateSimulationParameters(
         return false;
     }
 
+    // Each rank holds the fields of its own z slab; whether this server has
+    // that many processes is checked when the run is submitted (SlabRanks::fits)
+    const int num_ranks = std::max(1, params.num_mpi_ranks());
+    if (num_ranks > 1 && !SlabDecomposition::validate(params.grid_size_z(), num_ranks, error_msg)) {
+        return false;
+    }
+    const int64_t slab_planes = (params.grid_size_z() + num_ranks - 1) / num_ranks;
+    const int64_t slab_cells = static_cast<int64_t>(params.grid_size_x()) *
+                               static_cast<int64_t>(params.grid_size_y()) * slab_planes;
+    if (slab_cells > SimulationEngine::kMaxVoxelsPerProcess) {
+        error_msg = "Grid size too large for " + std::to_string(num_ranks) +
+                    " rank(s): a rank holds at most " +
+                    std::to_string(SimulationEngine::kMaxVoxelsPerProcess) +
+                    " cells, raise num_mpi_ranks";
+        return false;
+    }
+    if (num_ranks > 1 && params.checkpoint_interval() > 0) {
+        error_msg = "Multi-rank simulations cannot be checkpointed (checkpoint_interval must be 0)";
+        return false;
+    }
+
     return true;
 }
 
@@ -293,12 +1713,16 @@ bool SimulationServiceImpl::validatePatientData(
     const PatientData& data,
     std::string& error_msg) {
     
-    // Check if at least one data source is provided
-    bool has_dicom = data.has_dicom() && !data.dicom().dicom_archive().empty();
+    // Check if at least one data source is provided; uploads spool the bulk bytes to files
+    const auto& metadata = data.metadata();
+    bool has_dicom = (data.has_dicom() && !data.dicom().dicom_archive().empty()) ||
+                     metadata.count(PatientUpload::kMetadataDicomPath) > 0;
     bool has_vcf = data.has_vcf() && data.vcf().mutations_size() > 0;
-    bool has_genomic = data.has_genomic_sequences() && 
-                      (!data.genomic_sequences().bam_data().empty() || 
-                       !data.genomic_sequences().fastq_data().empty());
+    bool has_genomic = (data.has_genomic_sequences() &&
+                        (!data.genomic_sequences().bam_data().empty() ||
+                         !data.genomic_sequences().fastq_data().empty())) ||
+                       metadata.count(PatientUpload::kMetadataBamPath) > 0 ||
+                       metadata.count(PatientUpload::kMetadataFastqPath) > 0;
 
     if (!has_dicom && !has_vcf && !has_genomic) {
         error_msg = "At least one data source (DICOM, VCF, or genomic sequences) is required";
@@ -332,6 +1756,13 @@ bool SimulationServiceImpl::validatePatientData(
     return true;
 }
 
+bool SimulationServiceImpl::isSafeSimulationId(const std::string& simulation_id) {
+    return !simulation_id.empty() && simulation_id.size() <= 128 &&
+           std::all_of(simulation_id.begin(), simulation_id.end(), [](unsigned char c) {
+               return std::isalnum(c) || c == '-' || c == '_';
+           });
+}
+
 std::string SimulationServiceImpl::generateSimulationId() {
     // Generate a UUID-like simulation ID
     std::random_device rd;
@@ -349,13 +1780,152 @@ std::string SimulationServiceImpl::generateSimulationId() {
     return ss.str();
 }
 
+std::shared_ptr<const PatientData> SimulationServiceImpl::findUpload(
+    const std::string& upload_id) const {
+    std::lock_guard<std::mutex> lock(uploads_mutex_);
+    auto it = uploads_.find(upload_id);
+    return it != uploads_.end() ? it->second : nullptr;
+}
+
+grpc::Status SimulationServiceImpl::resolveUpload(
+    const SimulationRequest& request, std::shared_ptr<const PatientData>* upload) const {
+    upload->reset();
+    if (request.upload_id().empty()) {
+        return grpc::Status::OK;
+    }
+    *upload = findUpload(request.upload_id());
+    if (!*upload) {
+        return grpc::Status(grpc::StatusCode::NOT_FOUND,
+                          "Upload not found: " + request.upload_id());
+    }
+    if ((*upload)->patient_id() != request.patient_id()) {
+        upload->reset();
+        return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT,
+                          "Upload belongs to a different patient");
+    }
+    return grpc::Status::OK;
+}
+
 // ============================================================================
 // GrpcServer Implementation
 // ============================================================================
 
-GrpcServer::GrpcServer(const std::string& server_address)
+bool GrpcServerOptions::set(const std::string& name, const std::string& value,
+                            std::string& error_msg) {
+    if (name == "mode") {
+        if (value == "sync") {
+            mode = ServerMode::Sync;
+        } else if (value == "async") {
+            mode = ServerMode::Async;
+        } else {
+            error_msg = "Server mode must be sync or async, got " + value;
+            return false;
+        }
+        return true;
+    }
+    if (name == "pin-cqs" || name == "coordinator" || name == "warm-gpu" || name == "mpi") {
+        if (value != "true" && value != "false" && value != "1" && value != "0") {
+            error_msg = name + " must be true or false, got " + value;
+            return false;
+        }
+        bool& flag = name == "pin-cqs"       ? pin_cqs
+                     : name == "coordinator" ? coordinator
+                     : name == "warm-gpu"    ? warm_gpu
+                                             : mpi;
+        flag = value == "true" || value == "1";
+        return true;
+    }
+    if (name == "join" || name == "advertise") {
+        if (value.empty()) {
+            error_msg = name + " must be a host:port address";
+            return false;
+        }
+        (name == "join" ? join : advertise) = value;
+        return true;
+    }
+
+    int* field = nullptr;
+    int scale = 1;
+    if (name == "cqs") {
+        field = &num_cqs;
+    } else if (name == "sync-min-pollers") {
+        field = &sync_min_pollers;
+    } else if (name == "sync-max-pollers") {
+        field = &sync_max_pollers;
+    } else if (name == "sync-max-threads") {
+        field = &sync_max_threads;
+    } else if (name == "max-message-mb") {
+        field = &max_message_bytes;
+        scale = 1 << 20;
+    } else if (name == "keepalive-ms") {
+        field = &keepalive_time_ms;
+    } else if (name == "keepalive-timeout-ms") {
+        field = &keepalive_timeout_ms;
+    } else if (name == "max-streams") {
+        field = &max_concurrent_streams;
+    } else if (name == "heartbeat-ms") {
+        field = &heartbeat_ms;
+    } else if (name == "warm-engines") {
+        field = &warm_engines;
+    } else if (name == "warm-grid") {
+        field = &warm_grid;
+    } else if (name == "retain-finished") {
+        field = &retain_finished;
+    } else if (name == "retain-finished-s") {
+        field = &retain_finished_s;
+    } else {
+        error_msg = "Unknown server option " + name;
+        return false;
+    }
+
+    // Non-negative and small enough to scale without overflowing an int
+    const int max_value = std::numeric_limits<int>::max() / scale;
+    size_t parsed = 0;
+    long number = -1;
+    try {
+        number = std::stol(value, &parsed);
+    } catch (const std::exception&) {
+        parsed = 0;
+    }
+    if (parsed != value.size() || number < 0 || number > max_value) {
+        error_msg = name + " must be an integer in [0, " + std::to_string(max_value) +
+                    "], got " + value;
+        return false;
+    }
+    *field = static_cast<int>(number) * scale;
+    return true;
+}
+
+SimulationParameters GrpcServerOptions::warmParameters() const {
+    const int edge = warm_grid > 0 ? warm_grid : kDefaultWarmGrid;
+    SimulationParameters params;
+    params.set_grid_size_x(edge);
+    params.set_grid_size_y(edge);
+    params.set_grid_size_z(edge);
+    params.set_spatial_resolution(10.0);
+    params.set_num_steps(1);
+    params.set_time_step(1.0);
+    params.set_use_gpu(warm_gpu);
+    return params;
+}
+
+GrpcServer::GrpcServer(const std::string& server_address, const std::string& metrics_address,
+                       const GrpcServerOptions& options)
     : server_address_(server_address),
+      metrics_address_(metrics_address),
+      options_(options),
       service_(std::make_unique<SimulationServiceImpl>()) {
+    if (options_.coordinator) {
+        service_->enableCoordinator(options_.heartbeat_ms);
+    }
+    if (!options_.join.empty()) {
+        service_->joinCluster();
+    }
+    service_->setRetention(
+        options_.retain_finished > 0 ? static_cast<size_t>(options_.retain_finished)
+                                     : SimulationRegistry::kDefaultMaxFinished,
+        options_.retain_finished_s > 0 ? std::chrono::seconds(options_.retain_finished_s)
+                                       : SimulationRegistry::kDefaultFinishedTtl);
 }
 
 GrpcServer::~GrpcServer() {
@@ -364,10 +1934,56 @@ GrpcServer::~GrpcServer() {
     }
 }
 
+void GrpcServer::applyOptions(grpc::ServerBuilder& builder) const {
+    if (options_.max_message_bytes > 0) {
+        builder.SetMaxReceiveMessageSize(options_.max_message_bytes);
+        builder.SetMaxSendMessageSize(options_.max_message_bytes);
+    }
+    if (options_.keepalive_time_ms > 0) {
+        builder.AddChannelArgument(GRPC_ARG_KEEPALIVE_TIME_MS, options_.keepalive_time_ms);
+        builder.AddChannelArgument(GRPC_ARG_KEEPALIVE_PERMIT_WITHOUT_CALLS, 1);
+        // Accept client pings at the rate we ping ourselves
+        builder.AddChannelArgument(GRPC_ARG_HTTP2_MIN_RECV_PING_INTERVAL_WITHOUT_DATA_MS,
+                                   options_.keepalive_time_ms);
+    }
+    if (options_.keepalive_timeout_ms > 0) {
+        builder.AddChannelArgument(GRPC_ARG_KEEPALIVE_TIMEOUT_MS, options_.keepalive_timeout_ms);
+    }
+    if (options_.max_concurrent_streams > 0) {
+        builder.AddChannelArgument(GRPC_ARG_MAX_CONCURRENT_STREAMS,
+                                   options_.max_concurrent_streams);
+    }
+
+    // In async mode these only size the pool serving UploadPatientData and reflection
+    if (options_.mode == ServerMode::Sync && options_.num_cqs > 0) {
+        builder.SetSyncServerOption(grpc::ServerBuilder::SyncServerOption::NUM_CQS,
+                                    options_.num_cqs);
+    }
+    if (options_.sync_min_pollers > 0) {
+        builder.SetSyncServerOption(grpc::ServerBuilder::SyncServerOption::MIN_POLLERS,
+                                    options_.sync_min_pollers);
+    }
+    if (options_.sync_max_pollers > 0) {
+        builder.SetSyncServerOption(grpc::ServerBuilder::SyncServerOption::MAX_POLLERS,
+                                    options_.sync_max_pollers);
+    }
+    if (options_.sync_max_threads > 0) {
+        grpc::ResourceQuota quota("tumordtwin_sync_server");
+        quota.SetMaxThreads(options_.sync_max_threads);
+        builder.SetResourceQuota(quota);
+    }
+}
+
 bool GrpcServer::start() {
     if (is_running_) {
         return false;  // Already running
     }
+    // Coordinator handlers block on calls to the nodes, which would stall a completion queue
+    if (options_.coordinator && (options_.mode == ServerMode::Async || !options_.join.empty())) {
+        std::cerr << "A coordinator runs in sync mode and joins no other coordinator"
+                  << std::endl;
+        return false;
+    }
 
     grpc::EnableDefaultHealthCheckService(true);
     grpc::reflection::InitProtoReflectionServerBuilderPlugin();
@@ -376,16 +1992,73 @@ bool GrpcServer::start() {
     
     // Listen on the given address without authentication
     builder.AddListeningPort(server_address_, grpc::InsecureServerCredentials());
+    applyOptions(builder);
     
-    // Register the service
-    builder.RegisterService(service_.get());
+    // Register the service, or its completion-queue frontend in async mode
+    if (options_.mode == ServerMode::Async) {
+        async_service_ = std::make_unique<AsyncSimulationService>(
+            *service_, options_.num_cqs, options_.pin_cqs);
+        builder.RegisterService(async_service_.get());
+        async_service_->addCompletionQueues(builder);
+    } else {
+        builder.RegisterService(service_.get());
+    }
+
+    std::vector<std::unique_ptr<grpc::experimental::ServerInterceptorFactoryInterface>>
+        interceptors;
+    interceptors.push_back(std::make_unique<RpcMetricsInterceptorFactory>(service_->metrics()));
+    builder.experimental().SetInterceptorCreators(std::move(interceptors));
 
     // Build and start the server
     server_ = builder.BuildAndStart();
     
     if (!server_) {
+        async_service_.reset();
         return false;
     }
+    if (async_service_) {
+        async_service_->start();
+    }
+
+    if (!metrics_address_.empty()) {
+        exporter_ = std::make_unique<MetricsExporter>(service_->metrics(), metrics_address_);
+        std::string error_msg;
+        if (!exporter_->start(error_msg)) {
+            std::cerr << error_msg << std::endl;
+            exporter_.reset();
+            server_->Shutdown();
+            if (async_service_) {
+                async_service_->shutdown();
+            }
+            server_.reset();
+            async_service_.reset();
+            return false;
+        }
+    }
+
+    if (service_->coordinator()) {
+        service_->coordinator()->start();
+    }
+    if (!options_.join.empty()) {
+        member_ = std::make_unique<ClusterMember>(
+            *service_, options_.join,
+            options_.advertise.empty() ? server_address_ : options_.advertise,
+            options_.heartbeat_ms);
+        member_->start();
+    }
+
+    // Engines warm up behind the open port; health checks say NOT_SERVING until then
+    if (options_.warm_engines > 0 && !options_.coordinator) {
+        server_->GetHealthCheckService()->SetServingStatus(false);
+        grpc::Server* server = server_.get();
+        SimulationServiceImpl* service = service_.get();
+        service_->warmUp(static_cast<size_t>(options_.warm_engines), options_.warmParameters(),
+                         [server, service] {
+                             if (service->isServing()) {
+                                 server->GetHealthCheckService()->SetServingStatus(true);
+                             }
+                         });
+    }
 
     is_running_ = true;
     return true;
@@ -399,7 +2072,23 @@ void GrpcServer::wait() {
 
 void GrpcServer::shutdown() {
     if (server_ && is_running_) {
+        // Leave the cluster first: no more placements or steals during shutdown
+        if (member_) {
+            member_->stop();
+        }
+        if (service_->coordinator()) {
+            service_->coordinator()->stop();
+        }
+        service_->beginShutdown();
+        service_->stopWarmUp();
+        // Waits for in-flight calls, which the completion queues must keep serving
         server_->Shutdown();
+        if (async_service_) {
+            async_service_->shutdown();
+        }
+        if (exporter_) {
+            exporter_->stop();
+        }
         is_running_ = false;
     }
 }
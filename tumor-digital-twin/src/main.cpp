@@ -1,48 +1,119 @@
 #include "grpc_server.h"
+#include "simulation/slab_ranks.h"
 #include <iostream>
 #include <csignal>
 #include <memory>
+#include <string>
+#include <thread>
+#include <vector>
 
 // Global server instance for signal handling
 std::unique_ptr<tumordtwin::GrpcServer> g_server;
 
-void signalHandler(int signal) {
-    std::cout << "\nReceived signal " << signal << ", shutting down..." << std::endl;
-    if (g_server) {
-        g_server->shutdown();
-    }
-}
-
 int main(int argc, char** argv) {
-    // Default server address
+    // Default server and Prometheus metrics addresses
     std::string server_address = "0.0.0.0:50051";
-    
-    // Parse command line arguments
-    if (argc > 1) {
-        server_address = argv[1];
+    std::string metrics_address = "0.0.0.0:9464";
+    tumordtwin::GrpcServerOptions options;
+
+    // Parse command line arguments: [server_address [metrics_address]] [--option=value ...].
+    // An empty metrics address disables the endpoint.
+    std::vector<std::string> positional;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg.rfind("--", 0) != 0) {
+            positional.push_back(arg);
+            continue;
+        }
+        const size_t eq = arg.find('=');
+        const std::string name = arg.substr(2, eq == std::string::npos ? std::string::npos
+                                                                       : eq - 2);
+        // A bare flag such as --pin-cqs means true
+        const std::string value = eq == std::string::npos ? "true" : arg.substr(eq + 1);
+        std::string error_msg;
+        if (!options.set(name, value, error_msg)) {
+            std::cerr << error_msg << std::endl;
+            return 1;
+        }
+    }
+    if (positional.size() > 0) {
+        server_address = positional[0];
+    }
+    if (positional.size() > 1) {
+        metrics_address = positional[1];
+    }
+
+    // SIGINT and SIGTERM are taken by the signal thread below: shutting the
+    // server down is not async-signal-safe. Blocked here, before MPI or gRPC
+    // start any thread, so every thread inherits the mask.
+    sigset_t stop_signals;
+    sigemptyset(&stop_signals);
+    sigaddset(&stop_signals, SIGINT);
+    sigaddset(&stop_signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &stop_signals, nullptr);
+
+    // Under mpirun only rank 0 serves; the other ranks run the slabs it hands out
+    if (options.mpi) {
+        int rank = 0;
+        std::string error_msg;
+        if (!tumordtwin::SlabRanks::attachMpi(&argc, &argv, &rank, error_msg)) {
+            std::cerr << error_msg << std::endl;
+            return 1;
+        }
+        if (rank > 0) {
+            tumordtwin::SlabRanks::serveMpiRank();
+            return 0;
+        }
     }
 
     std::cout << "Tumor Digital Twin Backend Server" << std::endl;
     std::cout << "==================================" << std::endl;
-    std::cout << "Starting gRPC server on " << server_address << std::endl;
-
-    // Set up signal handlers for graceful shutdown
-    std::signal(SIGINT, signalHandler);
-    std::signal(SIGTERM, signalHandler);
+    std::cout << "Starting gRPC server on " << server_address << " ("
+              << (options.mode == tumordtwin::ServerMode::Async ? "async" : "sync")
+              << " mode)" << std::endl;
+    if (!metrics_address.empty()) {
+        std::cout << "Serving metrics on http://" << metrics_address
+                  << tumordtwin::MetricsExporter::kMetricsPath << std::endl;
+    }
+    if (options.warm_engines > 0 && !options.coordinator) {
+        std::cout << "Warming up " << options.warm_engines << " simulation engines" << std::endl;
+    }
+    if (options.mpi) {
+        std::cout << "Running multi-rank simulations on " << tumordtwin::SlabRanks::mpiRanks()
+                  << " MPI ranks" << std::endl;
+    }
+    if (options.coordinator) {
+        std::cout << "Coordinating the nodes that join it" << std::endl;
+    } else if (!options.join.empty()) {
+        std::cout << "Joining coordinator " << options.join << std::endl;
+    }
 
     // Create and start the server
-    g_server = std::make_unique<tumordtwin::GrpcServer>(server_address);
+    g_server = std::make_unique<tumordtwin::GrpcServer>(server_address, metrics_address,
+                                                        options);
     
     if (!g_server->start()) {
         std::cerr << "Failed to start server" << std::endl;
+        tumordtwin::SlabRanks::detachMpi();
         return 1;
     }
 
     std::cout << "Server started successfully" << std::endl;
     std::cout << "Press Ctrl+C to stop" << std::endl;
 
-    // Wait for the server to shutdown
+    // Shut down gracefully on the first SIGINT or SIGTERM
+    std::thread signal_thread([&stop_signals] {
+        int signal = 0;
+        sigwait(&stop_signals, &signal);
+        std::cout << "\nReceived signal " << signal << ", shutting down..." << std::endl;
+        g_server->shutdown();
+    });
+
+    // Wait for the server to shutdown; the MPI ranks are released once no run holds them
     g_server->wait();
+    signal_thread.join();
+    g_server.reset();
+    tumordtwin::SlabRanks::detachMpi();
 
     std::cout << "Server stopped" << std::endl;
     return 0;
@@ -0,0 +1,191 @@
+#include "metrics_exporter.h"
+#include <cerrno>
+#include <cstring>
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+namespace tumordtwin {
+
+namespace {
+
+// How often the accept loop checks for stop()
+constexpr int kPollIntervalMs = 100;
+// Scrape requests are a single line plus a few headers
+constexpr size_t kMaxRequestBytes = 8192;
+
+bool sendAll(int fd, const std::string& bytes) {
+    size_t sent = 0;
+    while (sent < bytes.size()) {
+        const ssize_t n = ::send(fd, bytes.data() + sent, bytes.size() - sent, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        sent += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+std::string response(const char* status, const char* content_type, const std::string& body) {
+    return std::string("HTTP/1.1 ") + status + "\r\nContent-Type: " + content_type +
+           "\r\nContent-Length: " + std::to_string(body.size()) +
+           "\r\nConnection: close\r\n\r\n" + body;
+}
+
+} // namespace
+
+// ============================================================================
+// MetricsExporter Implementation
+// ============================================================================
+
+MetricsExporter::MetricsExporter(const MetricsRegistry& registry, std::string address)
+    : registry_(registry),
+      address_(std::move(address)) {
+}
+
+MetricsExporter::~MetricsExporter() {
+    stop();
+}
+
+bool MetricsExporter::start(std::string& error_msg) {
+    if (running_) {
+        error_msg = "Metrics exporter is already running";
+        return false;
+    }
+
+    const size_t colon = address_.rfind(':');
+    if (colon == std::string::npos || colon + 1 == address_.size()) {
+        error_msg = "Metrics address must be host:port: " + address_;
+        return false;
+    }
+    std::string host = address_.substr(0, colon);
+    const std::string port = address_.substr(colon + 1);
+    if (host.size() >= 2 && host.front() == '[' && host.back() == ']') {
+        host = host.substr(1, host.size() - 2);
+    }
+    if (host == "*") {
+        host.clear();
+    }
+
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+    addrinfo* addresses = nullptr;
+    const int rc = ::getaddrinfo(host.empty() ? nullptr : host.c_str(), port.c_str(), &hints,
+                                 &addresses);
+    if (rc != 0) {
+        error_msg = "Cannot resolve metrics address " + address_ + ": " + ::gai_strerror(rc);
+        return false;
+    }
+
+    error_msg = "Cannot bind metrics address " + address_;
+    for (addrinfo* a = addresses; a; a = a->ai_next) {
+        const int fd = ::socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+        if (fd < 0) {
+            continue;
+        }
+        const int reuse = 1;
+        ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+        if (::bind(fd, a->ai_addr, a->ai_addrlen) == 0 && ::listen(fd, 16) == 0) {
+            listen_fd_ = fd;
+            break;
+        }
+        error_msg += std::string(": ") + std::strerror(errno);
+        ::close(fd);
+    }
+    ::freeaddrinfo(addresses);
+    if (listen_fd_ < 0) {
+        return false;
+    }
+    error_msg.clear();
+
+    sockaddr_storage bound{};
+    socklen_t length = sizeof(bound);
+    ::getsockname(listen_fd_, reinterpret_cast<sockaddr*>(&bound), &length);
+    port_ = bound.ss_family == AF_INET6
+                ? ntohs(reinterpret_cast<const sockaddr_in6*>(&bound)->sin6_port)
+                : ntohs(reinterpret_cast<const sockaddr_in*>(&bound)->sin_port);
+
+    running_ = true;
+    thread_ = std::thread([this] { serve(); });
+    return true;
+}
+
+void MetricsExporter::stop() {
+    if (!running_.exchange(false)) {
+        return;
+    }
+    thread_.join();
+    ::close(listen_fd_);
+    listen_fd_ = -1;
+}
+
+void MetricsExporter::serve() {
+    while (running_) {
+        pollfd listener{listen_fd_, POLLIN, 0};
+        if (::poll(&listener, 1, kPollIntervalMs) <= 0) {
+            continue;
+        }
+        const int client = ::accept(listen_fd_, nullptr, nullptr);
+        if (client < 0) {
+            continue;
+        }
+        // A stalled client may not hold up the next scrape for long
+        timeval timeout{1, 0};
+        ::setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        ::setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        handle(client);
+        ::close(client);
+    }
+}
+
+void MetricsExporter::handle(int client) const {
+    std::string request;
+    char buffer[1024];
+    while (request.find("\r\n\r\n") == std::string::npos && request.size() < kMaxRequestBytes) {
+        const ssize_t n = ::recv(client, buffer, sizeof(buffer), 0);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+        request.append(buffer, static_cast<size_t>(n));
+    }
+
+    // Request line: METHOD SP PATH[?QUERY] SP VERSION
+    const size_t line_end = request.find("\r\n");
+    const std::string line = request.substr(0, line_end);
+    const size_t method_end = line.find(' ');
+    const size_t path_end = line.find(' ', method_end + 1);
+    if (method_end == std::string::npos || path_end == std::string::npos) {
+        sendAll(client, response("400 Bad Request", "text/plain", "Bad request\n"));
+        return;
+    }
+    const std::string method = line.substr(0, method_end);
+    std::string path = line.substr(method_end + 1, path_end - method_end - 1);
+    path = path.substr(0, path.find('?'));
+
+    if (path != kMetricsPath) {
+        sendAll(client, response("404 Not Found", "text/plain", "Not found\n"));
+    } else if (method != "GET" && method != "HEAD") {
+        sendAll(client, response("405 Method Not Allowed", "text/plain", "Method not allowed\n"));
+    } else {
+        std::string reply = response("200 OK", "text/plain; version=0.0.4; charset=utf-8",
+                                     registry_.renderPrometheus());
+        if (method == "HEAD") {
+            reply.resize(reply.find("\r\n\r\n") + 4);
+        }
+        sendAll(client, reply);
+    }
+}
+
+} // namespace tumordtwin
@@ -0,0 +1,208 @@
+#include "simulation/agent_store.h"
+#include <algorithm>
+#include <vector>
+
+namespace tumordtwin {
+
+// ============================================================================
+// AgentStore Implementation
+// ============================================================================
+
+namespace {
+
+// Gather a column into a new order: column'[i] = column[order[i]]
+template <typename T>
+void permute(AlignedVector<T>& column, const std::vector<size_t>& order) {
+    AlignedVector<T> sorted(column.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+        sorted[i] = column[order[i]];
+    }
+    column.swap(sorted);
+}
+
+} // namespace
+
+size_t AgentStore::add(AgentType type, double x, double y, double z,
+                       CellState state, double age, double cycle_phase,
+                       GenotypeId genotype) {
+    resize(size() + 1);
+    bucket_begin_[kNumBuckets] = size();
+
+    // Open a hole at the end of the bucket: the first agent of every later
+    // bucket moves to that bucket's end
+    const size_t bucket = bucketOf(type);
+    size_t hole = size() - 1;
+    for (size_t b = kNumBuckets - 1; b > bucket; --b) {
+        const size_t first = bucket_begin_[b];
+        if (first != hole) {
+            moveAgent(first, hole);
+        }
+        hole = first;
+        ++bucket_begin_[b];
+    }
+
+    ids_[hole] = next_id_++;
+    x_[hole] = x;
+    y_[hole] = y;
+    z_[hole] = z;
+    types_[hole] = static_cast<uint8_t>(type);
+    states_[hole] = static_cast<uint8_t>(state);
+    ages_[hole] = age;
+    cycle_phases_[hole] = cycle_phase;
+    genotypes_[hole] = genotype;
+    return hole;
+}
+
+bool AgentStore::remove(size_t index) {
+    // Fill the hole from the end of its bucket, then pass the hole on
+    // through the later buckets until it reaches the end of the store
+    const size_t store_last = size() - 1;
+    size_t hole = index;
+    bool shifted = false;
+    for (size_t b = bucketOf(type(index)); b < kNumBuckets; ++b) {
+        const size_t last = bucket_begin_[b + 1] - 1;
+        if (hole != last) {
+            moveAgent(last, hole);
+            shifted = shifted || last != store_last;
+        }
+        hole = last;
+        --bucket_begin_[b + 1];
+    }
+
+    ids_.pop_back();
+    x_.pop_back();
+    y_.pop_back();
+    z_.pop_back();
+    types_.pop_back();
+    states_.pop_back();
+    ages_.pop_back();
+    cycle_phases_.pop_back();
+    genotypes_.pop_back();
+    return shifted;
+}
+
+void AgentStore::reserve(size_t capacity) {
+    ids_.reserve(capacity);
+    x_.reserve(capacity);
+    y_.reserve(capacity);
+    z_.reserve(capacity);
+    types_.reserve(capacity);
+    states_.reserve(capacity);
+    ages_.reserve(capacity);
+    cycle_phases_.reserve(capacity);
+    genotypes_.reserve(capacity);
+}
+
+void AgentStore::resize(size_t count) {
+    ids_.resize(count);
+    x_.resize(count);
+    y_.resize(count);
+    z_.resize(count);
+    types_.resize(count);
+    states_.resize(count);
+    ages_.resize(count);
+    cycle_phases_.resize(count);
+    genotypes_.resize(count);
+}
+
+void AgentStore::restoreBuckets() {
+    const size_t n = size();
+    std::array<size_t, kNumBuckets> counts{};
+    bool partitioned = true;
+    size_t previous = 0;
+    for (size_t a = 0; a < n; ++a) {
+        const size_t bucket = bucketOf(type(a));
+        ++counts[bucket];
+        partitioned = partitioned && bucket >= previous;
+        previous = bucket;
+    }
+
+    bucket_begin_[0] = 0;
+    for (size_t b = 0; b < kNumBuckets; ++b) {
+        bucket_begin_[b + 1] = bucket_begin_[b] + counts[b];
+    }
+    if (partitioned) {
+        return;
+    }
+
+    std::vector<size_t> order(n);
+    std::array<size_t, kNumBuckets> next;
+    std::copy(bucket_begin_.begin(), bucket_begin_.end() - 1, next.begin());
+    for (size_t a = 0; a < n; ++a) {
+        order[next[bucketOf(type(a))]++] = a;
+    }
+    permute(ids_, order);
+    permute(x_, order);
+    permute(y_, order);
+    permute(z_, order);
+    permute(types_, order);
+    permute(states_, order);
+    permute(ages_, order);
+    permute(cycle_phases_, order);
+    permute(genotypes_, order);
+}
+
+void AgentStore::clear() {
+    ids_.clear();
+    x_.clear();
+    y_.clear();
+    z_.clear();
+    types_.clear();
+    states_.clear();
+    ages_.clear();
+    cycle_phases_.clear();
+    genotypes_.clear();
+    bucket_begin_.fill(0);
+}
+
+void AgentStore::toProto(google::protobuf::RepeatedPtrField<Agent>* agents,
+                         const GenotypeTable& genotypes) const {
+    agents->Clear();
+    agents->Reserve(static_cast<int>(size()));
+
+    for (size_t i = 0; i < size(); ++i) {
+        toProto(i, agents->Add(), genotypes);
+    }
+}
+
+void AgentStore::toProto(size_t index, Agent* agent, const GenotypeTable& genotypes) const {
+    agent->set_id(ids_[index]);
+    agent->set_type(type(index));
+    auto* position = agent->mutable_position();
+    position->set_x(x_[index]);
+    position->set_y(y_[index]);
+    position->set_z(z_[index]);
+    agent->set_state(state(index));
+    agent->set_age(ages_[index]);
+    agent->set_cycle_phase(cycle_phases_[index]);
+    if (genotypes_[index] != GenotypeTable::kEmptyGenotype) {
+        agent->set_genotype_data(genotypes.get(genotypes_[index]));
+    } else {
+        agent->clear_genotype_data();
+    }
+}
+
+void AgentStore::fromProto(const google::protobuf::RepeatedPtrField<Agent>& agents,
+                           GenotypeTable& genotypes) {
+    clear();
+    reserve(static_cast<size_t>(agents.size()));
+
+    uint64_t max_id = 0;
+    for (const Agent& agent : agents) {
+        ids_.push_back(agent.id());
+        x_.push_back(agent.position().x());
+        y_.push_back(agent.position().y());
+        z_.push_back(agent.position().z());
+        types_.push_back(static_cast<uint8_t>(agent.type()));
+        states_.push_back(static_cast<uint8_t>(agent.state()));
+        ages_.push_back(agent.age());
+        cycle_phases_.push_back(agent.cycle_phase());
+        genotypes_.push_back(genotypes.intern(agent.genotype_data()));
+        max_id = std::max(max_id, agent.id());
+    }
+
+    next_id_ = max_id + 1;
+    restoreBuckets();
+}
+
+} // namespace tumordtwin
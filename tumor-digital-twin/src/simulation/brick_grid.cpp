@@ -0,0 +1,283 @@
+#include "simulation/brick_grid.h"
+#include <algorithm>
+
+namespace tumordtwin {
+
+namespace {
+
+int bricksFor(int n) {
+    return (n + BrickGrid::kBrickEdge - 1) >> BrickGrid::kBrickShift;
+}
+
+// Voxels of a brick along one axis, less than 8 for a partial brick on the high face
+int extentIn(int brick, int n) {
+    return std::min(BrickGrid::kBrickEdge, n - (brick << BrickGrid::kBrickShift));
+}
+
+} // namespace
+
+// ============================================================================
+// BrickGrid Implementation
+// ============================================================================
+
+BrickGrid::BrickGrid(int nx, int ny, int nz, double spacing, double initial_value) {
+    resize(nx, ny, nz, spacing, initial_value);
+}
+
+BrickGrid::BrickGrid(const BrickGrid& other)
+    : nx_(other.nx_), ny_(other.ny_), nz_(other.nz_),
+      bx_(other.bx_), by_(other.by_), bz_(other.bz_),
+      spacing_(other.spacing_),
+      bricks_(other.bricks_) {
+    for (Brick& brick : bricks_) {
+        if (brick.values) {
+            const double* src = brick.values;
+            brick.values = pool_.acquire();
+            std::copy(src, src + kBrickVoxels, brick.values);
+        }
+    }
+}
+
+BrickGrid& BrickGrid::operator=(const BrickGrid& other) {
+    if (this != &other) {
+        BrickGrid copy(other);
+        swap(copy);
+    }
+    return *this;
+}
+
+void BrickGrid::resize(int nx, int ny, int nz, double spacing, double initial_value) {
+    nx_ = nx;
+    ny_ = ny;
+    nz_ = nz;
+    spacing_ = spacing;
+    bx_ = bricksFor(nx);
+    by_ = bricksFor(ny);
+    bz_ = bricksFor(nz);
+    fill(initial_value);
+    bricks_.assign(static_cast<size_t>(bx_) * by_ * bz_, Brick{initial_value, nullptr});
+}
+
+void BrickGrid::fill(double value) {
+    for (Brick& brick : bricks_) {
+        brick.value = value;
+        if (brick.values) {
+            pool_.release(brick.values);
+            brick.values = nullptr;
+        }
+    }
+}
+
+double* BrickGrid::denseBrick(size_t brick) {
+    Brick& b = bricks_[brick];
+    if (!b.values) {
+        b.values = pool_.acquire();
+        std::fill(b.values, b.values + kBrickVoxels, b.value);
+    }
+    return b.values;
+}
+
+void BrickGrid::setUniform(size_t brick, double value) {
+    Brick& b = bricks_[brick];
+    b.value = value;
+    if (b.values) {
+        pool_.release(b.values);
+        b.values = nullptr;
+    }
+}
+
+bool BrickGrid::isFlat(size_t brick, double tolerance, double* value) const {
+    const Brick& b = bricks_[brick];
+    if (!b.values) {
+        *value = b.value;
+        return true;
+    }
+
+    const int bi = static_cast<int>(brick % bx_);
+    const int bj = static_cast<int>((brick / bx_) % by_);
+    const int bk = static_cast<int>(brick / (static_cast<size_t>(bx_) * by_));
+    const int ex = extentIn(bi, nx_);
+    const int ey = extentIn(bj, ny_);
+    const int ez = extentIn(bk, nz_);
+
+    double lo = b.values[0];
+    double hi = lo;
+    for (int lk = 0; lk < ez; ++lk) {
+        for (int lj = 0; lj < ey; ++lj) {
+            const double* row = b.values + localIndex(0, lj, lk);
+            for (int li = 0; li < ex; ++li) {
+                lo = std::min(lo, row[li]);
+                hi = std::max(hi, row[li]);
+            }
+        }
+    }
+    if (hi - lo > tolerance) {
+        return false;
+    }
+    // An exactly flat brick keeps its value; otherwise use the midpoint
+    *value = lo == hi ? lo : lo + 0.5 * (hi - lo);
+    return true;
+}
+
+bool BrickGrid::collapseBrick(size_t brick, double tolerance) {
+    double value;
+    if (!isFlat(brick, tolerance, &value)) {
+        return false;
+    }
+    setUniform(brick, value);
+    return true;
+}
+
+size_t BrickGrid::collapse(double tolerance) {
+    size_t collapsed = 0;
+    for (size_t b = 0; b < bricks_.size(); ++b) {
+        if (!isUniform(b) && collapseBrick(b, tolerance)) {
+            ++collapsed;
+        }
+    }
+    return collapsed;
+}
+
+size_t BrickGrid::validVoxels(size_t brick) const {
+    const int bi = static_cast<int>(brick % bx_);
+    const int bj = static_cast<int>((brick / bx_) % by_);
+    const int bk = static_cast<int>(brick / (static_cast<size_t>(bx_) * by_));
+    return static_cast<size_t>(extentIn(bi, nx_)) * extentIn(bj, ny_) * extentIn(bk, nz_);
+}
+
+size_t BrickGrid::denseBricks() const {
+    return static_cast<size_t>(std::count_if(bricks_.begin(), bricks_.end(),
+                                             [](const Brick& b) { return b.values != nullptr; }));
+}
+
+size_t BrickGrid::memoryBytes() const {
+    return bricks_.capacity() * sizeof(Brick) + pool_.capacity() * kBrickVoxels * sizeof(double);
+}
+
+double BrickGrid::mean() const {
+    const size_t count = size();
+    if (count == 0) {
+        return 0.0;
+    }
+
+    double total = 0.0;
+    for (int bk = 0; bk < bz_; ++bk) {
+        for (int bj = 0; bj < by_; ++bj) {
+            for (int bi = 0; bi < bx_; ++bi) {
+                const size_t b = brickIndex(bi, bj, bk);
+                const Brick& brick = bricks_[b];
+                if (!brick.values) {
+                    total += brick.value * static_cast<double>(validVoxels(b));
+                    continue;
+                }
+                const int ex = extentIn(bi, nx_);
+                const int ey = extentIn(bj, ny_);
+                const int ez = extentIn(bk, nz_);
+                for (int lk = 0; lk < ez; ++lk) {
+                    for (int lj = 0; lj < ey; ++lj) {
+                        const double* row = brick.values + localIndex(0, lj, lk);
+                        for (int li = 0; li < ex; ++li) {
+                            total += row[li];
+                        }
+                    }
+                }
+            }
+        }
+    }
+    return total / static_cast<double>(count);
+}
+
+void BrickGrid::fromDense(const ScalarGrid& grid, double tolerance) {
+    resize(grid.nx(), grid.ny(), grid.nz(), grid.spacing());
+    for (int bk = 0; bk < bz_; ++bk) {
+        for (int bj = 0; bj < by_; ++bj) {
+            for (int bi = 0; bi < bx_; ++bi) {
+                const size_t b = brickIndex(bi, bj, bk);
+                double* values = denseBrick(b);
+                const int ex = extentIn(bi, nx_);
+                const int ey = extentIn(bj, ny_);
+                const int ez = extentIn(bk, nz_);
+                for (int lk = 0; lk < ez; ++lk) {
+                    for (int lj = 0; lj < ey; ++lj) {
+                        const double* src = grid.data() +
+                            grid.index(bi << kBrickShift, (bj << kBrickShift) + lj,
+                                       (bk << kBrickShift) + lk);
+                        std::copy(src, src + ex, values + localIndex(0, lj, lk));
+                    }
+                }
+                collapseBrick(b, tolerance);
+            }
+        }
+    }
+}
+
+void BrickGrid::toDense(ScalarGrid& grid) const {
+    grid.resize(nx_, ny_, nz_, spacing_);
+    copyValues(0, size(), grid.data());
+}
+
+void BrickGrid::copyValues(size_t first, size_t count, double* out) const {
+    const size_t row = static_cast<size_t>(nx_);
+    while (count > 0) {
+        int i = static_cast<int>(first % row);
+        const size_t rest = first / row;
+        const int j = static_cast<int>(rest % ny_);
+        const int k = static_cast<int>(rest / ny_);
+        const size_t row_end = first + (row - i);
+
+        // Copy the rest of the row, one brick-width run at a time
+        const int bj = j >> kBrickShift;
+        const int bk = k >> kBrickShift;
+        const size_t local_row = localIndex(0, j & (kBrickEdge - 1), k & (kBrickEdge - 1));
+        while (count > 0 && first < row_end) {
+            const int bi = i >> kBrickShift;
+            const int li = i & (kBrickEdge - 1);
+            const size_t run = std::min<size_t>(
+                {count, static_cast<size_t>(kBrickEdge - li), row_end - first});
+            const Brick& brick = bricks_[brickIndex(bi, bj, bk)];
+            if (!brick.values) {
+                std::fill(out, out + run, brick.value);
+            } else {
+                const double* src = brick.values + local_row + li;
+                std::copy(src, src + run, out);
+            }
+            out += run;
+            first += run;
+            count -= run;
+            i += static_cast<int>(run);
+        }
+    }
+}
+
+void BrickGrid::toProto(GridData* grid, SubstanceType substance) const {
+    toProtoHeader(grid, substance);
+    std::string* values = grid->mutable_values();
+    values->resize(size() * sizeof(double));
+    copyValues(0, size(), reinterpret_cast<double*>(values->data()));
+}
+
+void BrickGrid::toProtoHeader(GridData* grid, SubstanceType substance) const {
+    auto* metadata = grid->mutable_metadata();
+    metadata->set_nx(nx_);
+    metadata->set_ny(ny_);
+    metadata->set_nz(nz_);
+    metadata->set_dx(spacing_);
+    metadata->set_dy(spacing_);
+    metadata->set_dz(spacing_);
+    grid->set_substance(substance);
+    grid->set_compressed(false);
+}
+
+void BrickGrid::swap(BrickGrid& other) noexcept {
+    std::swap(nx_, other.nx_);
+    std::swap(ny_, other.ny_);
+    std::swap(nz_, other.nz_);
+    std::swap(bx_, other.bx_);
+    std::swap(by_, other.by_);
+    std::swap(bz_, other.bz_);
+    std::swap(spacing_, other.spacing_);
+    bricks_.swap(other.bricks_);
+    pool_.swap(other.pool_);
+}
+
+} // namespace tumordtwin
@@ -0,0 +1,449 @@
+#include "simulation/diffusion_solver.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace tumordtwin {
+
+namespace {
+
+// Tile extents for the interior sweep. A tile covers kTileY rows of
+// kTileZ consecutive planes; the three planes touched per row stay within
+// a few hundred KB for nx up to 512, which keeps them resident in L2.
+constexpr int kTileY = 16;
+constexpr int kTileZ = 32;
+
+/**
+ * Update voxels [begin, end) of one interior row.
+ *
+ * out = center * c + r * (sum of 6 neighbours) - dt * uptake * c
+ */
+template <bool HasUptake>
+inline void stencilRow(double* __restrict out, const double* __restrict c,
+                       const double* __restrict uptake, size_t row, size_t plane,
+                       int begin, int end, double r, double center, double dt) {
+    int i = begin;
+
+#if defined(__AVX512F__)
+    const __m512d vr = _mm512_set1_pd(r);
+    const __m512d vcenter = _mm512_set1_pd(center);
+    const __m512d vneg_dt = _mm512_set1_pd(-dt);
+    for (; i + 8 <= end; i += 8) {
+        __m512d cc = _mm512_loadu_pd(c + i);
+        __m512d sum = _mm512_add_pd(_mm512_loadu_pd(c + i - 1), _mm512_loadu_pd(c + i + 1));
+        sum = _mm512_add_pd(sum, _mm512_loadu_pd(c + i - row));
+        sum = _mm512_add_pd(sum, _mm512_loadu_pd(c + i + row));
+        sum = _mm512_add_pd(sum, _mm512_loadu_pd(c + i - plane));
+        sum = _mm512_add_pd(sum, _mm512_loadu_pd(c + i + plane));
+        __m512d result = _mm512_fmadd_pd(vr, sum, _mm512_mul_pd(vcenter, cc));
+        if constexpr (HasUptake) {
+            result = _mm512_fmadd_pd(_mm512_mul_pd(vneg_dt, _mm512_loadu_pd(uptake + i)), cc, result);
+        }
+        _mm512_storeu_pd(out + i, result);
+    }
+#elif defined(__AVX2__) && defined(__FMA__)
+    const __m256d vr = _mm256_set1_pd(r);
+    const __m256d vcenter = _mm256_set1_pd(center);
+    const __m256d vneg_dt = _mm256_set1_pd(-dt);
+    for (; i + 4 <= end; i += 4) {
+        __m256d cc = _mm256_loadu_pd(c + i);
+        __m256d sum = _mm256_add_pd(_mm256_loadu_pd(c + i - 1), _mm256_loadu_pd(c + i + 1));
+        sum = _mm256_add_pd(sum, _mm256_loadu_pd(c + i - row));
+        sum = _mm256_add_pd(sum, _mm256_loadu_pd(c + i + row));
+        sum = _mm256_add_pd(sum, _mm256_loadu_pd(c + i - plane));
+        sum = _mm256_add_pd(sum, _mm256_loadu_pd(c + i + plane));
+        __m256d result = _mm256_fmadd_pd(vr, sum, _mm256_mul_pd(vcenter, cc));
+        if constexpr (HasUptake) {
+            result = _mm256_fmadd_pd(_mm256_mul_pd(vneg_dt, _mm256_loadu_pd(uptake + i)), cc, result);
+        }
+        _mm256_storeu_pd(out + i, result);
+    }
+#endif
+
+    // Remainder (and the whole row on targets without a vector kernel)
+    for (; i < end; ++i) {
+        double sum = c[i - 1] + c[i + 1] + c[i - row] + c[i + row] + c[i - plane] + c[i + plane];
+        double result = center * c[i] + r * sum;
+        if constexpr (HasUptake) {
+            result -= dt * uptake[i] * c[i];
+        }
+        out[i] = result;
+    }
+}
+
+// How a computed brick reads its uptake rate
+enum class BrickUptake { None, Uniform, PerVoxel };
+
+constexpr int kBrickEdge = BrickGrid::kBrickEdge;
+constexpr int kPaddedEdge = kBrickEdge + 2;
+using PaddedBrick = double[kPaddedEdge][kPaddedEdge][kPaddedEdge];
+
+/**
+ * Stencil over the first ex x ey x ez voxels of a brick whose one-voxel
+ * halo is already in `in`. Every voxel gets the interior update; fixed
+ * faces are overwritten by the caller.
+ */
+template <BrickUptake Uptake>
+void stencilBrick(const PaddedBrick& in, double* __restrict out, int ex, int ey, int ez,
+                  double r, double center, double dt, const double* __restrict uptake_values,
+                  double uptake_uniform) {
+    for (int lk = 0; lk < ez; ++lk) {
+        for (int lj = 0; lj < ey; ++lj) {
+            for (int li = 0; li < ex; ++li) {
+                const size_t idx = BrickGrid::localIndex(li, lj, lk);
+                const double c = in[lk + 1][lj + 1][li + 1];
+                double sum = in[lk + 1][lj + 1][li] + in[lk + 1][lj + 1][li + 2] +
+                             in[lk + 1][lj][li + 1] + in[lk + 1][lj + 2][li + 1] +
+                             in[lk][lj + 1][li + 1] + in[lk + 2][lj + 1][li + 1];
+                double result = center * c + r * sum;
+                if constexpr (Uptake == BrickUptake::Uniform) {
+                    result -= dt * uptake_uniform * c;
+                } else if constexpr (Uptake == BrickUptake::PerVoxel) {
+                    result -= dt * uptake_values[idx] * c;
+                }
+                out[idx] = result;
+            }
+        }
+    }
+}
+
+int resolveThreads(int requested) {
+#ifdef _OPENMP
+    return requested > 0 ? requested : omp_get_max_threads();
+#else
+    (void)requested;
+    return 1;
+#endif
+}
+
+} // namespace
+
+// ============================================================================
+// DiffusionSolver Implementation
+// ============================================================================
+
+DiffusionSolver::DiffusionSolver(int num_threads)
+    : num_threads_(num_threads) {
+}
+
+double DiffusionSolver::maxStableTimeStep(double diffusion_coeff, double spacing) {
+    if (diffusion_coeff <= 0.0) {
+        return std::numeric_limits<double>::infinity();
+    }
+    return spacing * spacing / (6.0 * diffusion_coeff);
+}
+
+int DiffusionSolver::subSteps(const DiffusionParams& params, double spacing, double dt,
+                              double max_uptake) {
+    const double rate = 6.0 * params.diffusion_coeff / (spacing * spacing) +
+                        std::max(params.decay_rate, 0.0) + std::max(max_uptake, 0.0);
+    const double steps = std::ceil(dt * rate);
+    if (!(steps > 1.0)) {
+        return 1;
+    }
+    return steps >= kMaxSubSteps ? kMaxSubSteps : static_cast<int>(steps);
+}
+
+void DiffusionSolver::step(ScalarGrid& field, const DiffusionParams& params, double dt,
+                           const ScalarGrid* uptake) {
+    if (field.size() == 0) {
+        return;
+    }
+    stepPlanes(field, params, dt, uptake, 0, field.nz());
+    commit(field);
+}
+
+void DiffusionSolver::step(BrickGrid& field, const DiffusionParams& params, double dt,
+                           const BrickGrid* uptake, double collapse_tolerance) {
+    if (field.size() == 0) {
+        return;
+    }
+    if (brick_scratch_.nx() != field.nx() || brick_scratch_.ny() != field.ny() ||
+        brick_scratch_.nz() != field.nz()) {
+        brick_scratch_.resize(field.nx(), field.ny(), field.nz(), field.spacing());
+    }
+
+    const double h = field.spacing();
+    const double r = params.diffusion_coeff * dt / (h * h);
+    const double center = 1.0 - 6.0 * r - dt * params.decay_rate;
+    const int bx = field.bricksX();
+    const int by = field.bricksY();
+    const auto num_bricks = static_cast<int64_t>(field.numBricks());
+    brick_values_.resize(field.numBricks());
+    brick_computed_.resize(field.numBricks());
+
+    // Brick storage is pooled and the pool is single-threaded, so the step
+    // runs in four passes: plan in parallel, expand serially, compute in
+    // parallel, collapse serially.
+    #pragma omp parallel for schedule(static) num_threads(resolveThreads(num_threads_))
+    for (int64_t b = 0; b < num_bricks; ++b) {
+        const auto brick = static_cast<size_t>(b);
+        brick_computed_[brick] = 1;
+        if (field.isUniform(brick)) {
+            // Same expression as the scalar stencil with six equal neighbours
+            const double c = field.uniformValue(brick);
+            const double next = center * c + r * (c + c + c + c + c + c);
+            const int bi = static_cast<int>(b % bx);
+            const int bj = static_cast<int>((b / bx) % by);
+            const int bk = static_cast<int>(b / (static_cast<int64_t>(bx) * by));
+            if (brickIsSteady(field, uptake, params, bi, bj, bk, next)) {
+                brick_values_[brick] = next;
+                brick_computed_[brick] = 0;
+            }
+        }
+    }
+
+    for (size_t brick = 0; brick < field.numBricks(); ++brick) {
+        if (brick_computed_[brick]) {
+            brick_scratch_.denseBrick(brick);
+        } else {
+            brick_scratch_.setUniform(brick, brick_values_[brick]);
+        }
+    }
+
+    // Computed bricks cost a full stencil, steady ones nothing; balance dynamically
+    #pragma omp parallel for schedule(dynamic, 16) num_threads(resolveThreads(num_threads_))
+    for (int64_t b = 0; b < num_bricks; ++b) {
+        const auto brick = static_cast<size_t>(b);
+        if (!brick_computed_[brick]) {
+            continue;
+        }
+        const int bi = static_cast<int>(b % bx);
+        const int bj = static_cast<int>((b / bx) % by);
+        const int bk = static_cast<int>(b / (static_cast<int64_t>(bx) * by));
+        double* out = brick_scratch_.denseBrick(brick);  // Already expanded
+        stepBrick(field, uptake, params, r, center, dt, bi, bj, bk, out);
+        // Reuse the flag for "flat enough to collapse"
+        brick_computed_[brick] =
+            brick_scratch_.isFlat(brick, collapse_tolerance, &brick_values_[brick]) ? 2 : 1;
+    }
+
+    for (size_t brick = 0; brick < field.numBricks(); ++brick) {
+        if (brick_computed_[brick] == 2) {
+            brick_scratch_.setUniform(brick, brick_values_[brick]);
+        }
+    }
+    field.swap(brick_scratch_);
+}
+
+bool DiffusionSolver::brickIsSteady(const BrickGrid& field, const BrickGrid* uptake,
+                                    const DiffusionParams& params, int bi, int bj, int bk,
+                                    double next) const {
+    const size_t brick = field.brickIndex(bi, bj, bk);
+    const double c = field.uniformValue(brick);
+    if (uptake && !(uptake->isUniform(brick) && uptake->uniformValue(brick) == 0.0)) {
+        return false;
+    }
+
+    const int neighbours[6][3] = {{bi - 1, bj, bk}, {bi + 1, bj, bk}, {bi, bj - 1, bk},
+                                  {bi, bj + 1, bk}, {bi, bj, bk - 1}, {bi, bj, bk + 1}};
+    bool on_face = false;
+    for (const auto& n : neighbours) {
+        if (n[0] < 0 || n[1] < 0 || n[2] < 0 ||
+            n[0] >= field.bricksX() || n[1] >= field.bricksY() || n[2] >= field.bricksZ()) {
+            on_face = true;
+            continue;
+        }
+        const size_t other = field.brickIndex(n[0], n[1], n[2]);
+        if (!field.isUniform(other) || field.uniformValue(other) != c) {
+            return false;
+        }
+    }
+    // Zero-flux faces mirror the brick itself; fixed faces must already hold the value
+    return !on_face || params.boundary == BoundaryCondition::Neumann ||
+           (c == params.boundary_value && next == c);
+}
+
+void DiffusionSolver::stepBrick(const BrickGrid& field, const BrickGrid* uptake,
+                                const DiffusionParams& params, double r, double center,
+                                double dt, int bi, int bj, int bk, double* out) const {
+    const int nx = field.nx();
+    const int ny = field.ny();
+    const int nz = field.nz();
+    const int i0 = bi * kBrickEdge;
+    const int j0 = bj * kBrickEdge;
+    const int k0 = bk * kBrickEdge;
+
+    // The brick plus a one-voxel halo; neighbours outside the domain mirror
+    // the voxel itself, which is the zero-flux rule of applyBoundary()
+    PaddedBrick in;
+    for (int pk = 0; pk < kPaddedEdge; ++pk) {
+        const int k = std::clamp(k0 + pk - 1, 0, nz - 1);
+        for (int pj = 0; pj < kPaddedEdge; ++pj) {
+            const int j = std::clamp(j0 + pj - 1, 0, ny - 1);
+            for (int pi = 0; pi < kPaddedEdge; ++pi) {
+                in[pk][pj][pi] = field.value(std::clamp(i0 + pi - 1, 0, nx - 1), j, k);
+            }
+        }
+    }
+
+    const size_t brick = field.brickIndex(bi, bj, bk);
+    const int ex = std::min(kBrickEdge, nx - i0);
+    const int ey = std::min(kBrickEdge, ny - j0);
+    const int ez = std::min(kBrickEdge, nz - k0);
+    const double* uptake_values = uptake ? uptake->brickData(brick) : nullptr;
+    if (!uptake) {
+        stencilBrick<BrickUptake::None>(in, out, ex, ey, ez, r, center, dt, nullptr, 0.0);
+    } else if (uptake_values) {
+        stencilBrick<BrickUptake::PerVoxel>(in, out, ex, ey, ez, r, center, dt,
+                                            uptake_values, 0.0);
+    } else {
+        stencilBrick<BrickUptake::Uniform>(in, out, ex, ey, ez, r, center, dt, nullptr,
+                                           uptake->uniformValue(brick));
+    }
+
+    // Fixed faces are set in a separate pass over the few bricks that touch one
+    const bool on_face = i0 == 0 || j0 == 0 || k0 == 0 ||
+                         i0 + ex == nx || j0 + ey == ny || k0 + ez == nz;
+    if (params.boundary != BoundaryCondition::Dirichlet || !on_face) {
+        return;
+    }
+    for (int lk = 0; lk < ez; ++lk) {
+        const bool z_face = k0 + lk == 0 || k0 + lk == nz - 1;
+        for (int lj = 0; lj < ey; ++lj) {
+            const bool y_face = j0 + lj == 0 || j0 + lj == ny - 1;
+            for (int li = 0; li < ex; ++li) {
+                if (z_face || y_face || i0 + li == 0 || i0 + li == nx - 1) {
+                    out[BrickGrid::localIndex(li, lj, lk)] = params.boundary_value;
+                }
+            }
+        }
+    }
+}
+
+void DiffusionSolver::stepPlanes(const ScalarGrid& field, const DiffusionParams& params,
+                                 double dt, const ScalarGrid* uptake, int k_begin, int k_end) {
+    if (scratch_.nx() != field.nx() || scratch_.ny() != field.ny() ||
+        scratch_.nz() != field.nz()) {
+        scratch_.resize(field.nx(), field.ny(), field.nz(), field.spacing());
+    }
+    k_begin = std::max(k_begin, 0);
+    k_end = std::min(k_end, field.nz());
+    if (field.size() == 0 || k_begin >= k_end) {
+        return;
+    }
+
+    const double h = field.spacing();
+    const double r = params.diffusion_coeff * dt / (h * h);
+    const double center = 1.0 - 6.0 * r - dt * params.decay_rate;
+    const double* uptake_data = uptake ? uptake->data() : nullptr;
+
+    if (uptake_data) {
+        applyInterior<true>(field, scratch_, r, center, dt, uptake_data, k_begin, k_end);
+    } else {
+        applyInterior<false>(field, scratch_, r, center, dt, nullptr, k_begin, k_end);
+    }
+
+    // Fixed faces ignore uptake; zero-flux faces take the full update
+    if (params.boundary == BoundaryCondition::Dirichlet) {
+        applyBoundary<BoundaryCondition::Dirichlet, false>(field, scratch_, params, r, center,
+                                                           dt, nullptr, k_begin, k_end);
+    } else if (uptake_data) {
+        applyBoundary<BoundaryCondition::Neumann, true>(field, scratch_, params, r, center,
+                                                        dt, uptake_data, k_begin, k_end);
+    } else {
+        applyBoundary<BoundaryCondition::Neumann, false>(field, scratch_, params, r, center,
+                                                         dt, nullptr, k_begin, k_end);
+    }
+}
+
+void DiffusionSolver::commit(ScalarGrid& field) {
+    if (scratch_.size() == field.size()) {
+        field.swap(scratch_);
+    }
+}
+
+template <bool HasUptake>
+void DiffusionSolver::applyInterior(const ScalarGrid& in, ScalarGrid& out, double r,
+                                    double center, double dt, const double* uptake,
+                                    int k_begin, int k_end) const {
+    const int nx = in.nx();
+    const int ny = in.ny();
+    const int nz = in.nz();
+    // Interior planes within the requested range
+    const int k_first = std::max(k_begin, 1);
+    const int k_last = std::min(k_end, nz - 1);
+    if (nx < 3 || ny < 3 || k_first >= k_last) {
+        return;
+    }
+
+    const size_t row = static_cast<size_t>(nx);
+    const size_t plane = row * static_cast<size_t>(ny);
+    const int tiles_y = (ny - 2 + kTileY - 1) / kTileY;
+    const int tiles_z = (k_last - k_first + kTileZ - 1) / kTileZ;
+    const double* src = in.data();
+    double* dst = out.data();
+
+    #pragma omp parallel for collapse(2) schedule(static) num_threads(resolveThreads(num_threads_))
+    for (int tz = 0; tz < tiles_z; ++tz) {
+        for (int ty = 0; ty < tiles_y; ++ty) {
+            const int tile_k_begin = k_first + tz * kTileZ;
+            const int tile_k_end = std::min(tile_k_begin + kTileZ, k_last);
+            const int j_begin = 1 + ty * kTileY;
+            const int j_end = std::min(j_begin + kTileY, ny - 1);
+
+            // Stream along z inside the tile so planes k-1 and k are reused
+            for (int k = tile_k_begin; k < tile_k_end; ++k) {
+                for (int j = j_begin; j < j_end; ++j) {
+                    const size_t offset = static_cast<size_t>(k) * plane + static_cast<size_t>(j) * row;
+                    stencilRow<HasUptake>(dst + offset, src + offset,
+                                          HasUptake ? uptake + offset : nullptr,
+                                          row, plane, 1, nx - 1, r, center, dt);
+                }
+            }
+        }
+    }
+}
+
+template <BoundaryCondition Boundary, bool HasUptake>
+void DiffusionSolver::applyBoundary(const ScalarGrid& in, ScalarGrid& out,
+                                    const DiffusionParams& params, double r, double center,
+                                    double dt, const double* uptake,
+                                    int k_begin, int k_end) const {
+    const int nx = in.nx();
+    const int ny = in.ny();
+    const int nz = in.nz();
+
+    auto update = [&](int i, int j, int k) {
+        const size_t idx = in.index(i, j, k);
+        if constexpr (Boundary == BoundaryCondition::Dirichlet) {
+            out.data()[idx] = params.boundary_value;
+        } else {
+            // Zero flux: a missing neighbour mirrors the voxel itself
+            const double c = in.data()[idx];
+            double sum = in.at(std::max(i - 1, 0), j, k) + in.at(std::min(i + 1, nx - 1), j, k) +
+                         in.at(i, std::max(j - 1, 0), k) + in.at(i, std::min(j + 1, ny - 1), k) +
+                         in.at(i, j, std::max(k - 1, 0)) + in.at(i, j, std::min(k + 1, nz - 1));
+            double result = center * c + r * sum;
+            if constexpr (HasUptake) {
+                result -= dt * uptake[idx] * c;
+            }
+            out.data()[idx] = result;
+        }
+    };
+
+    #pragma omp parallel for schedule(static) num_threads(resolveThreads(num_threads_))
+    for (int k = k_begin; k < k_end; ++k) {
+        const bool z_face = k == 0 || k == nz - 1;
+        for (int j = 0; j < ny; ++j) {
+            if (z_face || j == 0 || j == ny - 1 || nx < 3) {
+                for (int i = 0; i < nx; ++i) {
+                    update(i, j, k);
+                }
+            } else {
+                update(0, j, k);
+                update(nx - 1, j, k);
+            }
+        }
+    }
+}
+
+} // namespace tumordtwin
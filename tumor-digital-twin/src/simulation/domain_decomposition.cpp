@@ -0,0 +1,338 @@
+#include "simulation/domain_decomposition.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+namespace tumordtwin {
+
+namespace {
+
+template <typename T>
+void appendValue(std::string* out, T value) {
+    out->append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template <typename T>
+T readValue(const std::string& in, size_t& offset) {
+    T value;
+    std::memcpy(&value, in.data() + offset, sizeof(value));
+    offset += sizeof(value);
+    return value;
+}
+
+// Fixed-size part of one migrating agent; the genotype bytes follow it
+constexpr size_t kAgentRecordBytes = sizeof(uint64_t) + 3 * sizeof(double) +
+                                     2 * sizeof(uint8_t) + 2 * sizeof(double) +
+                                     sizeof(uint32_t);
+
+void appendAgent(const AgentStore& agents, size_t i, const GenotypeTable& genotypes,
+                 std::string* out) {
+    const std::string& genotype = genotypes.get(agents.genotypes()[i]);
+    appendValue(out, agents.ids()[i]);
+    appendValue(out, agents.x()[i]);
+    appendValue(out, agents.y()[i]);
+    appendValue(out, agents.z()[i]);
+    appendValue(out, agents.types()[i]);
+    appendValue(out, agents.states()[i]);
+    appendValue(out, agents.ages()[i]);
+    appendValue(out, agents.cyclePhases()[i]);
+    appendValue(out, static_cast<uint32_t>(genotype.size()));
+    *out += genotype;
+}
+
+// Appends the agents of a buffer; the caller restores the buckets
+void readAgents(const std::string& in, AgentStore* agents, GenotypeTable* genotypes) {
+    size_t offset = 0;
+    while (in.size() - offset >= kAgentRecordBytes) {
+        const size_t index = agents->size();
+        agents->resize(index + 1);
+        agents->ids()[index] = readValue<uint64_t>(in, offset);
+        agents->x()[index] = readValue<double>(in, offset);
+        agents->y()[index] = readValue<double>(in, offset);
+        agents->z()[index] = readValue<double>(in, offset);
+        agents->types()[index] = readValue<uint8_t>(in, offset);
+        agents->states()[index] = readValue<uint8_t>(in, offset);
+        agents->ages()[index] = readValue<double>(in, offset);
+        agents->cyclePhases()[index] = readValue<double>(in, offset);
+        const auto length = std::min<size_t>(readValue<uint32_t>(in, offset), in.size() - offset);
+        agents->genotypes()[index] = genotypes->intern(std::string_view(in.data() + offset, length));
+        offset += length;
+    }
+}
+
+} // namespace
+
+// ============================================================================
+// SlabDecomposition Implementation
+// ============================================================================
+
+bool SlabDecomposition::validate(int nz, int num_ranks, std::string& error_msg) {
+    if (num_ranks < 1) {
+        error_msg = "Number of ranks must be positive";
+        return false;
+    }
+    if (nz < num_ranks) {
+        error_msg = "Grid has fewer z planes (" + std::to_string(nz) + ") than ranks (" +
+                    std::to_string(num_ranks) + ")";
+        return false;
+    }
+    return true;
+}
+
+SlabDecomposition::SlabDecomposition(int nz, int num_ranks)
+    : nz_(nz),
+      num_ranks_(std::max(num_ranks, 1)),
+      base_planes_(nz / num_ranks_),
+      extra_planes_(nz % num_ranks_) {
+}
+
+SlabExtent SlabDecomposition::extent(int rank) const {
+    SlabExtent extent;
+    extent.z_begin = rank * base_planes_ + std::min(rank, extra_planes_);
+    extent.z_end = extent.z_begin + base_planes_ + (rank < extra_planes_ ? 1 : 0);
+    extent.ghost_below = rank > 0;
+    extent.ghost_above = rank < num_ranks_ - 1;
+    return extent;
+}
+
+int SlabDecomposition::ownerOfPlane(int k) const {
+    k = std::clamp(k, 0, nz_ - 1);
+    const int large_planes = extra_planes_ * (base_planes_ + 1);
+    if (k < large_planes) {
+        return k / (base_planes_ + 1);
+    }
+    return extra_planes_ + (k - large_planes) / base_planes_;
+}
+
+int SlabDecomposition::ownerOfZ(double z, double spacing) const {
+    const double plane = std::floor(z / spacing);
+    if (!(plane >= 0.0)) {
+        return 0;  // Below the domain (or NaN)
+    }
+    return ownerOfPlane(plane >= nz_ ? nz_ - 1 : static_cast<int>(plane));
+}
+
+// ============================================================================
+// SlabDomain Implementation
+// ============================================================================
+
+SlabDomain::SlabDomain(int nx, int ny, int nz, double spacing, SlabTransport& transport)
+    : nx_(nx),
+      ny_(ny),
+      spacing_(spacing),
+      transport_(transport),
+      decomposition_(nz, transport.numRanks()),
+      extent_(decomposition_.extent(transport.rank())) {
+}
+
+void SlabDomain::allocate(ScalarGrid& field, double initial_value) const {
+    field.resize(nx_, ny_, extent_.localPlanes(), spacing_, initial_value);
+}
+
+bool SlabDomain::ownsZ(double z) const {
+    return decomposition_.ownerOfZ(z, spacing_) == rank();
+}
+
+void SlabDomain::exchangeHalo(ScalarGrid& field) {
+    transport_.startHaloExchange(field, extent_);
+    transport_.finishHaloExchange();
+}
+
+void SlabDomain::diffuse(DiffusionSolver& solver, ScalarGrid& field,
+                         const DiffusionParams& params, double dt, const ScalarGrid* uptake) {
+    // Owned local planes [first, last); [inner_begin, inner_end) reads no ghost plane
+    const int first = extent_.firstOwnedLocal();
+    const int last = first + extent_.ownedPlanes();
+    const int inner_begin = first + (extent_.ghost_below ? 1 : 0);
+    const int inner_end = std::max(inner_begin, last - (extent_.ghost_above ? 1 : 0));
+
+    transport_.startHaloExchange(field, extent_);
+    solver.stepPlanes(field, params, dt, uptake, inner_begin, inner_end);
+    transport_.finishHaloExchange();
+
+    solver.stepPlanes(field, params, dt, uptake, first, inner_begin);
+    solver.stepPlanes(field, params, dt, uptake, inner_end, last);
+    solver.commit(field);
+}
+
+size_t SlabDomain::migrateAgents(AgentStore& agents, GenotypeTable& genotypes) {
+    std::vector<std::string> outgoing(decomposition_.numRanks());
+    std::vector<int> owner(agents.size());
+    size_t leaving = 0;
+    for (size_t i = 0; i < agents.size(); ++i) {
+        owner[i] = decomposition_.ownerOfZ(agents.z()[i], spacing_);
+        if (owner[i] != rank()) {
+            appendAgent(agents, i, genotypes, &outgoing[owner[i]]);
+            ++leaving;
+        }
+    }
+    agents.removeIf([&](size_t i) { return owner[i] != rank(); });
+
+    const std::vector<std::string> incoming = transport_.exchange(std::move(outgoing));
+    for (int source = 0; source < decomposition_.numRanks(); ++source) {
+        if (source != rank()) {
+            readAgents(incoming[source], &agents, &genotypes);
+        }
+    }
+    agents.restoreBuckets();
+    return leaving;
+}
+
+template <typename Receive>
+void SlabDomain::gatherPlanes(const ScalarGrid& local, Receive receive) {
+    // Batches of planes keep each exchange (and MPI's int counts) below kGatherBatchBytes
+    const size_t plane = static_cast<size_t>(nx_) * static_cast<size_t>(ny_);
+    const int num_ranks = decomposition_.numRanks();
+    const int batch = static_cast<int>(std::max<size_t>(
+        1, kGatherBatchBytes / (static_cast<size_t>(num_ranks) * plane * sizeof(double))));
+    int most_planes = 0;
+    for (int r = 0; r < num_ranks; ++r) {
+        most_planes = std::max(most_planes, decomposition_.extent(r).ownedPlanes());
+    }
+
+    for (int first = 0; first < most_planes; first += batch) {
+        std::vector<std::string> outgoing(num_ranks);
+        const int count = std::clamp(extent_.ownedPlanes() - first, 0, batch);
+        outgoing[0].assign(reinterpret_cast<const char*>(
+                               local.data() + (extent_.firstOwnedLocal() + first) * plane),
+                           static_cast<size_t>(count) * plane * sizeof(double));
+
+        const std::vector<std::string> incoming = transport_.exchange(std::move(outgoing));
+        if (rank() != 0) {
+            continue;
+        }
+        for (int source = 0; source < num_ranks; ++source) {
+            const SlabExtent extent = decomposition_.extent(source);
+            const std::string& in = incoming[source];
+            const int planes = std::min(std::clamp(extent.ownedPlanes() - first, 0, batch),
+                                        static_cast<int>(in.size() / (plane * sizeof(double))));
+            for (int p = 0; p < planes; ++p) {
+                receive(extent.z_begin + first + p,
+                        reinterpret_cast<const double*>(in.data()) + p * plane);
+            }
+        }
+    }
+}
+
+void SlabDomain::gatherField(const ScalarGrid& local, ScalarGrid* global) {
+    const size_t plane = static_cast<size_t>(nx_) * static_cast<size_t>(ny_);
+    const bool assemble = rank() == 0 && global;
+    if (assemble) {
+        global->resize(nx_, ny_, decomposition_.nz(), spacing_);
+    }
+    gatherPlanes(local, [&](int k, const double* values) {
+        if (assemble) {
+            std::memcpy(global->data() + static_cast<size_t>(k) * plane, values,
+                        plane * sizeof(double));
+        }
+    });
+}
+
+void SlabDomain::gatherField(const ScalarGrid& local, BrickGrid* global, double tolerance) {
+    const bool assemble = rank() == 0 && global;
+    const int edge = BrickGrid::kBrickEdge;
+    std::vector<int> layer_planes;
+    if (assemble) {
+        global->resize(nx_, ny_, decomposition_.nz(), spacing_);
+        layer_planes.assign(global->bricksZ(), 0);
+    }
+    gatherPlanes(local, [&](int k, const double* values) {
+        if (!assemble) {
+            return;
+        }
+        const int bk = k >> BrickGrid::kBrickShift;
+        for (int bj = 0; bj < global->bricksY(); ++bj) {
+            for (int bi = 0; bi < global->bricksX(); ++bi) {
+                double* brick = global->denseBrick(global->brickIndex(bi, bj, bk));
+                const int j_end = std::min(edge, ny_ - bj * edge);
+                const int i_end = std::min(edge, nx_ - bi * edge);
+                for (int lj = 0; lj < j_end; ++lj) {
+                    const double* row = values + static_cast<size_t>(bj * edge + lj) * nx_ + bi * edge;
+                    for (int li = 0; li < i_end; ++li) {
+                        brick[BrickGrid::localIndex(li, lj, k & (edge - 1))] = row[li];
+                    }
+                }
+            }
+        }
+        // A complete layer of bricks is collapsed before the next planes expand more
+        if (++layer_planes[bk] == std::min(edge, decomposition_.nz() - bk * edge)) {
+            for (int bj = 0; bj < global->bricksY(); ++bj) {
+                for (int bi = 0; bi < global->bricksX(); ++bi) {
+                    global->collapseBrick(global->brickIndex(bi, bj, bk), tolerance);
+                }
+            }
+        }
+    });
+}
+
+void SlabDomain::gatherAgents(const AgentStore& agents, const GenotypeTable& genotypes,
+                              AgentStore* global, GenotypeTable* global_genotypes) {
+    std::string outgoing;
+    if (rank() != 0) {
+        for (size_t i = 0; i < agents.size(); ++i) {
+            appendAgent(agents, i, genotypes, &outgoing);
+        }
+    }
+    const std::vector<std::string> incoming = gather(std::move(outgoing));
+    if (rank() != 0 || !global || !global_genotypes) {
+        return;
+    }
+    *global = agents;
+    *global_genotypes = genotypes;
+    for (int source = 1; source < decomposition_.numRanks(); ++source) {
+        readAgents(incoming[source], global, global_genotypes);
+    }
+    global->restoreBuckets();
+}
+
+std::string SlabDomain::broadcast(std::string data) {
+    std::vector<std::string> outgoing(decomposition_.numRanks());
+    if (rank() == 0) {
+        for (int dest = 1; dest < decomposition_.numRanks(); ++dest) {
+            outgoing[dest] = data;
+        }
+        transport_.exchange(std::move(outgoing));
+        return data;
+    }
+    std::vector<std::string> incoming = transport_.exchange(std::move(outgoing));
+    return std::move(incoming[0]);
+}
+
+std::vector<std::string> SlabDomain::gather(std::string data) {
+    std::vector<std::string> outgoing(decomposition_.numRanks());
+    outgoing[0] = std::move(data);
+    std::vector<std::string> incoming = transport_.exchange(std::move(outgoing));
+    if (rank() != 0) {
+        return {};
+    }
+    return incoming;
+}
+
+template <typename Combine>
+void SlabDomain::allReduce(std::vector<double>& values, Combine combine) {
+    std::string bytes(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(double));
+    std::vector<std::string> outgoing(decomposition_.numRanks(), bytes);
+    const std::vector<std::string> incoming = transport_.exchange(std::move(outgoing));
+
+    // Every rank combines in rank order, so all of them get bitwise the same result
+    std::fill(values.begin(), values.end(), 0.0);
+    for (int source = 0; source < decomposition_.numRanks(); ++source) {
+        const std::string& in = incoming[source];
+        for (size_t i = 0; i < values.size() && (i + 1) * sizeof(double) <= in.size(); ++i) {
+            double value;
+            std::memcpy(&value, in.data() + i * sizeof(double), sizeof(value));
+            values[i] = source == 0 ? value : combine(values[i], value);
+        }
+    }
+}
+
+void SlabDomain::allReduceSum(std::vector<double>& values) {
+    allReduce(values, [](double a, double b) { return a + b; });
+}
+
+void SlabDomain::allReduceMax(std::vector<double>& values) {
+    allReduce(values, [](double a, double b) { return std::max(a, b); });
+}
+
+} // namespace tumordtwin
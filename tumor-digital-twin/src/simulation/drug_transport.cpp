@@ -0,0 +1,444 @@
+#include "simulation/drug_transport.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace tumordtwin {
+
+namespace {
+
+constexpr double kLn2 = 0.69314718055994530942;
+
+bool parseMechanism(const std::string& name, DrugMechanism* mechanism) {
+    if (name.empty() || name == "cytotoxic") {
+        *mechanism = DrugMechanism::Cytotoxic;
+        return true;
+    }
+    if (name == "cytostatic") {
+        *mechanism = DrugMechanism::Cytostatic;
+        return true;
+    }
+    return false;
+}
+
+double property(const Drug& drug, const char* key, double default_value) {
+    auto it = drug.properties().find(key);
+    return it != drug.properties().end() ? it->second : default_value;
+}
+
+template <typename T>
+void appendRaw(std::string* out, const T& value) {
+    out->append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template <typename T>
+bool readRaw(const std::string& bytes, size_t* offset, T* value) {
+    if (bytes.size() - *offset < sizeof(T)) {
+        return false;
+    }
+    std::memcpy(value, bytes.data() + *offset, sizeof(T));
+    *offset += sizeof(T);
+    return true;
+}
+
+} // namespace
+
+// ============================================================================
+// DrugTransport Implementation
+// ============================================================================
+
+bool DrugTransport::validate(const TreatmentProtocol& protocol, std::string& error_msg) {
+    for (const auto& drug : protocol.drugs()) {
+        const std::string label = "Drug " + (drug.name().empty() ? std::string("(unnamed)")
+                                                                 : drug.name());
+        DrugMechanism mechanism;
+        if (!parseMechanism(drug.mechanism(), &mechanism)) {
+            error_msg = label + " has unknown mechanism " + drug.mechanism();
+            return false;
+        }
+        if (drug.diffusion_coefficient() < 0.0) {
+            error_msg = label + " diffusion coefficient must be non-negative";
+            return false;
+        }
+        if (!(drug.half_life() > 0.0)) {
+            error_msg = label + " half life must be positive";
+            return false;
+        }
+        const double emax = property(drug, kPropertyEmax, kDefaultEmax);
+        if (!(emax >= 0.0) ||
+            (mechanism == DrugMechanism::Cytostatic && emax > 1.0)) {
+            error_msg = label + " emax must be non-negative (at most 1 when cytostatic)";
+            return false;
+        }
+        if (!(property(drug, kPropertyEc50, kDefaultEc50) > 0.0) ||
+            !(property(drug, kPropertyVolume, kDefaultVolume) > 0.0)) {
+            error_msg = label + " ec50 and volume of distribution must be positive";
+            return false;
+        }
+    }
+
+    if (protocol.schedules_size() > 0 && protocol.drugs_size() != 1 &&
+        protocol.schedules_size() > protocol.drugs_size()) {
+        error_msg = "Dosing schedules without a drug to dose";
+        return false;
+    }
+    for (const DosingSchedule& schedule : protocol.schedules()) {
+        if (schedule.dose_amount() < 0.0 || schedule.start_time() < 0.0 ||
+            schedule.num_doses() < 0) {
+            error_msg = "Dose amounts, start times and dose counts must be non-negative";
+            return false;
+        }
+        if (schedule.num_doses() > 1 && !(schedule.interval_hours() > 0.0)) {
+            error_msg = "Repeated doses need a positive interval";
+            return false;
+        }
+    }
+    return true;
+}
+
+void DrugTransport::configure(const TreatmentProtocol& protocol, int nx, int ny, int nz,
+                              double spacing, double negligible) {
+    nx_ = nx;
+    ny_ = ny;
+    nz_ = nz;
+    spacing_ = spacing;
+    negligible_ = negligible;
+
+    drugs_.clear();
+    for (const auto& source : protocol.drugs()) {
+        Drug drug;
+        drug.name = source.name();
+        parseMechanism(source.mechanism(), &drug.mechanism);
+        drug.params.diffusion_coeff = source.diffusion_coefficient();
+        drug.params.decay_rate = kLn2 / source.half_life();
+        drug.params.boundary = BoundaryCondition::Dirichlet;
+        drug.emax = property(source, kPropertyEmax, kDefaultEmax);
+        drug.ec50 = property(source, kPropertyEc50, kDefaultEc50);
+        drug.volume = property(source, kPropertyVolume, kDefaultVolume);
+        drugs_.push_back(std::move(drug));
+    }
+
+    schedules_.clear();
+    for (int s = 0; s < protocol.schedules_size(); ++s) {
+        const DosingSchedule& source = protocol.schedules(s);
+        const int drug = protocol.drugs_size() == 1 ? 0 : s;
+        if (drug >= protocol.drugs_size()) {
+            continue;
+        }
+        Schedule schedule;
+        schedule.drug = drug;
+        schedule.start = source.start_time();
+        schedule.interval = source.interval_hours();
+        schedule.amount = source.dose_amount();
+        schedule.doses = std::max(source.num_doses(), 1);
+        schedules_.push_back(schedule);
+    }
+
+    events_ = {};
+    active_drugs_ = 0;
+}
+
+void DrugTransport::reset(double time, bool sparse) {
+    for (Drug& drug : drugs_) {
+        drug.plasma = 0.0;
+        release(drug);
+    }
+    reschedule(time, sparse);
+}
+
+void DrugTransport::reschedule(double time, bool sparse) {
+    // Fields loaded from a checkpoint are dense; convert them to this run's storage
+    if (sparse != sparse_) {
+        for (Drug& drug : drugs_) {
+            if (!drug.active) {
+                continue;
+            }
+            if (sparse) {
+                drug.sparse_field.fromDense(drug.field);
+                drug.field = ScalarGrid();
+            } else {
+                drug.sparse_field.toDense(drug.field);
+                drug.sparse_field = BrickGrid();
+            }
+        }
+        sparse_ = sparse;
+    }
+
+    // Doses before `time` were given by earlier steps
+    events_ = {};
+    for (int s = 0; s < static_cast<int>(schedules_.size()); ++s) {
+        const Schedule& schedule = schedules_[s];
+        int32_t dose = 0;
+        if (schedule.interval > 0.0 && time > schedule.start) {
+            dose = static_cast<int32_t>(std::min<double>(
+                std::ceil((time - schedule.start) / schedule.interval), schedule.doses));
+            while (dose > 0 && schedule.doseTime(dose - 1) >= time) {
+                --dose;
+            }
+        }
+        while (dose < schedule.doses && schedule.doseTime(dose) < time) {
+            ++dose;
+        }
+        if (dose < schedule.doses) {
+            events_.push(DoseEvent{schedule.doseTime(dose), schedule.amount, schedule.drug, s, dose});
+        }
+    }
+}
+
+void DrugTransport::step(DiffusionSolver& solver, double time, double dt, int min_substeps,
+                         double sparse_tolerance) {
+    // Only the earliest pending dose is looked at while none is due
+    while (!events_.empty() && events_.top().time < time + dt) {
+        const DoseEvent event = events_.top();
+        events_.pop();
+        Drug& drug = drugs_[event.drug];
+        drug.plasma += event.amount / drug.volume;
+        activate(drug);
+
+        const Schedule& schedule = schedules_[event.schedule];
+        if (event.dose + 1 < schedule.doses) {
+            events_.push(DoseEvent{schedule.doseTime(event.dose + 1), schedule.amount,
+                                   event.drug, event.schedule, event.dose + 1});
+        }
+    }
+    if (active_drugs_ == 0) {
+        return;
+    }
+
+    for (Drug& drug : drugs_) {
+        if (!drug.active) {
+            continue;
+        }
+        // The faces stay at the plasma concentration of the step start
+        drug.params.boundary_value = drug.plasma;
+        const int substeps = std::max(min_substeps,
+                                      DiffusionSolver::subSteps(drug.params, spacing_, dt));
+        for (int n = 0; n < substeps; ++n) {
+            if (sparse_) {
+                solver.step(drug.sparse_field, drug.params, dt / substeps, nullptr,
+                            sparse_tolerance);
+            } else {
+                solver.step(drug.field, drug.params, dt / substeps);
+            }
+        }
+        drug.plasma *= std::exp(-drug.params.decay_rate * dt);
+
+        if (drug.plasma < negligible_ && maxConcentration(drug) < negligible_) {
+            release(drug);
+        }
+    }
+}
+
+double DrugTransport::concentration(size_t drug, int i, int j, int k) const {
+    const Drug& d = drugs_[drug];
+    if (!d.active) {
+        return 0.0;
+    }
+    return sparse_ ? d.sparse_field.value(i, j, k) : d.field.at(i, j, k);
+}
+
+double DrugTransport::effect(const Drug& drug, int i, int j, int k) const {
+    const double u = sparse_ ? drug.sparse_field.value(i, j, k) : drug.field.at(i, j, k);
+    return u > 0.0 ? drug.emax * u / (u + drug.ec50) : 0.0;
+}
+
+double DrugTransport::killRate(int i, int j, int k) const {
+    double rate = 0.0;
+    for (const Drug& drug : drugs_) {
+        if (drug.active && drug.mechanism == DrugMechanism::Cytotoxic) {
+            rate += effect(drug, i, j, k);
+        }
+    }
+    return rate;
+}
+
+double DrugTransport::arrestFraction(int i, int j, int k) const {
+    // Independent action: each drug stops a share of the progression the others leave
+    double progression = 1.0;
+    for (const Drug& drug : drugs_) {
+        if (drug.active && drug.mechanism == DrugMechanism::Cytostatic) {
+            progression *= 1.0 - effect(drug, i, j, k);
+        }
+    }
+    return 1.0 - progression;
+}
+
+double DrugTransport::meanConcentration(size_t drug) const {
+    const Drug& d = drugs_[drug];
+    if (!d.active) {
+        return 0.0;
+    }
+    return sparse_ ? d.sparse_field.mean() : d.field.mean();
+}
+
+void DrugTransport::totalField(ScalarGrid* dense, BrickGrid* sparse) const {
+    *dense = ScalarGrid();
+    *sparse = BrickGrid();
+    if (active_drugs_ == 0) {
+        return;
+    }
+
+    if (!sparse_) {
+        dense->resize(nx_, ny_, nz_, spacing_, 0.0);
+        for (const Drug& drug : drugs_) {
+            if (drug.active) {
+                const double* in = drug.field.data();
+                double* out = dense->data();
+                for (size_t v = 0; v < dense->size(); ++v) {
+                    out[v] += in[v];
+                }
+            }
+        }
+        return;
+    }
+
+    // Brick by brick, so bricks uniform in every field stay uniform in the sum
+    sparse->resize(nx_, ny_, nz_, spacing_, 0.0);
+    for (size_t b = 0; b < sparse->numBricks(); ++b) {
+        bool uniform = true;
+        double value = 0.0;
+        for (const Drug& drug : drugs_) {
+            if (drug.active) {
+                uniform = uniform && drug.sparse_field.isUniform(b);
+                value += drug.sparse_field.uniformValue(b);
+            }
+        }
+        if (uniform) {
+            sparse->setUniform(b, value);
+            continue;
+        }
+        double* out = sparse->denseBrick(b);
+        std::fill(out, out + BrickGrid::kBrickVoxels, 0.0);
+        for (const Drug& drug : drugs_) {
+            if (!drug.active) {
+                continue;
+            }
+            const double* in = drug.sparse_field.brickData(b);
+            for (size_t v = 0; v < BrickGrid::kBrickVoxels; ++v) {
+                out[v] += in ? in[v] : drug.sparse_field.uniformValue(b);
+            }
+        }
+    }
+}
+
+std::string DrugTransport::saveState() const {
+    std::string bytes;
+    appendRaw(&bytes, static_cast<uint32_t>(drugs_.size()));
+    ScalarGrid expanded;
+    for (const Drug& drug : drugs_) {
+        appendRaw(&bytes, drug.plasma);
+        appendRaw(&bytes, static_cast<uint8_t>(drug.active));
+        if (!drug.active) {
+            continue;
+        }
+        const ScalarGrid* field = &drug.field;
+        if (sparse_) {
+            drug.sparse_field.toDense(expanded);
+            field = &expanded;
+        }
+        bytes.append(reinterpret_cast<const char*>(field->data()), field->size() * sizeof(double));
+    }
+    return bytes;
+}
+
+bool DrugTransport::loadState(const std::string& bytes, std::string& error_msg) {
+    for (Drug& drug : drugs_) {
+        drug.plasma = 0.0;
+        release(drug);
+    }
+    // Loaded fields are dense until reschedule() converts them
+    sparse_ = false;
+    if (bytes.empty()) {
+        return true;
+    }
+
+    size_t offset = 0;
+    uint32_t count = 0;
+    if (!readRaw(bytes, &offset, &count) || count != drugs_.size()) {
+        error_msg = "Drug state does not match the treatment protocol";
+        return false;
+    }
+    const size_t field_bytes = static_cast<size_t>(nx_) * ny_ * nz_ * sizeof(double);
+    for (Drug& drug : drugs_) {
+        uint8_t active = 0;
+        if (!readRaw(bytes, &offset, &drug.plasma) || !readRaw(bytes, &offset, &active)) {
+            error_msg = "Truncated drug state";
+            return false;
+        }
+        if (!active) {
+            continue;
+        }
+        if (bytes.size() - offset < field_bytes) {
+            error_msg = "Truncated drug state";
+            return false;
+        }
+        activate(drug);
+        std::memcpy(drug.field.data(), bytes.data() + offset, field_bytes);
+        offset += field_bytes;
+    }
+    if (offset != bytes.size()) {
+        error_msg = "Drug state does not match the treatment protocol";
+        return false;
+    }
+    return true;
+}
+
+void DrugTransport::activate(Drug& drug) {
+    if (drug.active) {
+        return;
+    }
+    if (sparse_) {
+        drug.sparse_field.resize(nx_, ny_, nz_, spacing_, 0.0);
+    } else {
+        drug.field.resize(nx_, ny_, nz_, spacing_, 0.0);
+    }
+    drug.active = true;
+    ++active_drugs_;
+}
+
+void DrugTransport::release(Drug& drug) {
+    if (!drug.active) {
+        return;
+    }
+    drug.field = ScalarGrid();
+    drug.sparse_field = BrickGrid();
+    drug.active = false;
+    --active_drugs_;
+}
+
+double DrugTransport::maxConcentration(const Drug& drug) const {
+    double most = 0.0;
+    if (!sparse_) {
+        const double* values = drug.field.data();
+        for (size_t v = 0; v < drug.field.size(); ++v) {
+            most = std::max(most, std::abs(values[v]));
+        }
+        return most;
+    }
+
+    const BrickGrid& field = drug.sparse_field;
+    for (size_t b = 0; b < field.numBricks(); ++b) {
+        if (field.isUniform(b)) {
+            most = std::max(most, std::abs(field.uniformValue(b)));
+            continue;
+        }
+        // Partial bricks on the high faces are only read inside the domain
+        const int bi = static_cast<int>(b % field.bricksX());
+        const int bj = static_cast<int>((b / field.bricksX()) % field.bricksY());
+        const int bk = static_cast<int>(b / (static_cast<size_t>(field.bricksX()) * field.bricksY()));
+        const int ei = std::min(BrickGrid::kBrickEdge, nx_ - bi * BrickGrid::kBrickEdge);
+        const int ej = std::min(BrickGrid::kBrickEdge, ny_ - bj * BrickGrid::kBrickEdge);
+        const int ek = std::min(BrickGrid::kBrickEdge, nz_ - bk * BrickGrid::kBrickEdge);
+        const double* values = field.brickData(b);
+        for (int lk = 0; lk < ek; ++lk) {
+            for (int lj = 0; lj < ej; ++lj) {
+                for (int li = 0; li < ei; ++li) {
+                    most = std::max(most, std::abs(values[BrickGrid::localIndex(li, lj, lk)]));
+                }
+            }
+        }
+    }
+    return most;
+}
+
+} // namespace tumordtwin
@@ -0,0 +1,152 @@
+#include "simulation/engine_pool.h"
+#include <iostream>
+
+namespace tumordtwin {
+
+// ============================================================================
+// EnginePool::Lease Implementation
+// ============================================================================
+
+EnginePool::Lease::~Lease() {
+    if (pool_ && engine_) {
+        pool_->release(std::move(engine_));
+    }
+}
+
+EnginePool::Lease& EnginePool::Lease::operator=(Lease&& other) noexcept {
+    if (this != &other) {
+        if (pool_ && engine_) {
+            pool_->release(std::move(engine_));
+        }
+        pool_ = other.pool_;
+        engine_ = std::move(other.engine_);
+        warm_ = other.warm_;
+    }
+    return *this;
+}
+
+// ============================================================================
+// EnginePool Implementation
+// ============================================================================
+
+EnginePool::~EnginePool() {
+    stop();
+}
+
+void EnginePool::warmUp(size_t engines, const SimulationParameters& params, int num_threads,
+                        std::function<void()> on_ready) {
+    if (warm_thread_.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        capacity_ = engines;
+        idle_.reserve(engines);
+    }
+    if (engines == 0) {
+        if (on_ready) {
+            on_ready();
+        }
+        return;
+    }
+    ready_ = false;
+    warm_thread_ = std::thread(&EnginePool::warmLoop, this, engines, params, num_threads,
+                               std::move(on_ready));
+}
+
+void EnginePool::warmLoop(size_t engines, SimulationParameters params, int num_threads,
+                          std::function<void()> on_ready) {
+    // No cells: the step only exercises the fields, the solver and the thread pool
+    (*params.mutable_extra_params())[SimulationEngine::kParamInitialTumorCells] = 0.0;
+    (*params.mutable_extra_params())[SimulationEngine::kParamInitialTCells] = 0.0;
+    if (params.num_steps() <= 0) {
+        params.set_num_steps(1);
+    }
+
+    for (size_t built = 0; built < engines && !stopping_; ++built) {
+        try {
+            auto engine = std::make_unique<SimulationEngine>(params, num_threads);
+            engine->initialize();
+            engine->step();
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (idle_.size() >= capacity_) {
+                break;  // Returned engines filled the pool first
+            }
+            idle_.push_back(std::move(engine));
+        } catch (const std::exception& e) {
+            std::cerr << "Engine warm-up failed: " << e.what() << std::endl;
+            break;
+        }
+    }
+
+    if (on_ready) {
+        on_ready();
+    }
+    ready_.store(true, std::memory_order_release);
+}
+
+void EnginePool::stop() {
+    stopping_ = true;
+    if (warm_thread_.joinable()) {
+        warm_thread_.join();
+    }
+}
+
+bool EnginePool::fits(const SimulationEngine& engine, const SimulationParameters& params) {
+    const SimulationParameters& bound = engine.parameters();
+    return bound.grid_size_x() == params.grid_size_x() &&
+           bound.grid_size_y() == params.grid_size_y() &&
+           bound.grid_size_z() == params.grid_size_z() &&
+           bound.spatial_resolution() == params.spatial_resolution() &&
+           bound.use_gpu() == params.use_gpu();
+}
+
+EnginePool::Lease EnginePool::acquire(const SimulationParameters& params, int num_threads) {
+    std::unique_ptr<SimulationEngine> engine;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!idle_.empty()) {
+            // The latest idle engine of the same lattice, else the latest one
+            size_t pick = idle_.size() - 1;
+            for (size_t i = idle_.size(); i-- > 0;) {
+                if (fits(*idle_[i], params)) {
+                    pick = i;
+                    break;
+                }
+            }
+            engine = std::move(idle_[pick]);
+            idle_[pick] = std::move(idle_.back());
+            idle_.pop_back();
+        }
+    }
+
+    if (engine) {
+        engine->rebind(params, num_threads);
+        return Lease(this, std::move(engine), true);
+    }
+    return Lease(this, std::make_unique<SimulationEngine>(params, num_threads), false);
+}
+
+void EnginePool::release(std::unique_ptr<SimulationEngine> engine) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (idle_.size() < capacity_) {
+            idle_.push_back(std::move(engine));
+            return;
+        }
+    }
+    // A full pool frees the engine outside the lock
+    engine.reset();
+}
+
+size_t EnginePool::capacity() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return capacity_;
+}
+
+size_t EnginePool::idle() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return idle_.size();
+}
+
+} // namespace tumordtwin
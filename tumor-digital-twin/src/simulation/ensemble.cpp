@@ -0,0 +1,298 @@
+#include "simulation/ensemble.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <map>
+#include <sstream>
+#include <unordered_set>
+
+#include <google/protobuf/descriptor.h>
+
+namespace tumordtwin {
+
+namespace {
+
+std::string formatValue(double value) {
+    std::ostringstream stream;
+    stream << value;
+    return stream.str();
+}
+
+bool isTerminal(SimulationStatus status) {
+    return status == SimulationStatus::COMPLETED || status == SimulationStatus::FAILED ||
+           status == SimulationStatus::STOPPED;
+}
+
+void addMetric(std::map<std::string, std::vector<double>>& values, const std::string& name,
+               double value) {
+    values[name].push_back(value);
+}
+
+} // namespace
+
+// ============================================================================
+// EnsemblePlan Implementation
+// ============================================================================
+
+bool EnsemblePlan::expand(const EnsembleRequest& request, std::vector<EnsembleMemberSpec>* members,
+                          std::string& error_msg) {
+    members->clear();
+
+    size_t grid_points = 1;
+    std::unordered_set<std::string> axes;
+    for (const ParameterAxis& axis : request.grid()) {
+        if (axis.values().empty()) {
+            error_msg = "Parameter axis " + axis.parameter() + " has no values";
+            return false;
+        }
+        if (!axes.insert(axis.parameter()).second) {
+            error_msg = "Parameter " + axis.parameter() + " appears in the grid twice";
+            return false;
+        }
+        if (grid_points > kMaxMembers / static_cast<size_t>(axis.values_size())) {
+            error_msg = "Ensemble has more than " + std::to_string(kMaxMembers) + " members";
+            return false;
+        }
+        grid_points *= static_cast<size_t>(axis.values_size());
+    }
+    const size_t variants = std::max(request.members_size(), 1);
+    if (grid_points > kMaxMembers / variants) {
+        error_msg = "Ensemble has more than " + std::to_string(kMaxMembers) + " members";
+        return false;
+    }
+
+    const SimulationRequest& base = request.base();
+    members->reserve(variants * grid_points);
+    for (size_t v = 0; v < variants; ++v) {
+        EnsembleMemberSpec variant;
+        variant.params = base.params();
+        variant.treatment = base.treatment();
+        std::string label;
+        if (request.members_size() > 0) {
+            const EnsembleMember& member = request.members(static_cast<int>(v));
+            // Sorted so the same overrides always apply, and fail, in the same order
+            std::map<std::string, double> overrides(member.overrides().begin(),
+                                                    member.overrides().end());
+            for (const auto& [name, value] : overrides) {
+                if (!applyOverride(&variant.params, name, value, error_msg)) {
+                    error_msg = "Member " + std::to_string(v) + ": " + error_msg;
+                    return false;
+                }
+            }
+            if (member.has_treatment()) {
+                variant.treatment = member.treatment();
+            }
+            label = member.name();
+        }
+
+        // Odometer over the grid, last axis fastest
+        std::vector<int> index(request.grid_size(), 0);
+        for (size_t point = 0; point < grid_points; ++point) {
+            EnsembleMemberSpec spec = variant;
+            std::string point_label = label;
+            for (int a = 0; a < request.grid_size(); ++a) {
+                const ParameterAxis& axis = request.grid(a);
+                const double value = axis.values(index[a]);
+                if (!applyOverride(&spec.params, axis.parameter(), value, error_msg)) {
+                    return false;
+                }
+                point_label += (point_label.empty() ? "" : ", ") + axis.parameter() + "=" +
+                               formatValue(value);
+            }
+            spec.name = point_label.empty() ? base.simulation_name()
+                                            : base.simulation_name() + " [" + point_label + "]";
+            members->push_back(std::move(spec));
+
+            for (int a = request.grid_size() - 1; a >= 0; --a) {
+                if (++index[a] < request.grid(a).values_size()) {
+                    break;
+                }
+                index[a] = 0;
+            }
+        }
+    }
+    return true;
+}
+
+bool EnsemblePlan::applyOverride(SimulationParameters* params, const std::string& name,
+                                 double value, std::string& error_msg) {
+    const std::string prefix = kExtraParamsPrefix;
+    if (name.compare(0, prefix.size(), prefix) == 0) {
+        if (name.size() == prefix.size()) {
+            error_msg = "Extra parameter name is empty";
+            return false;
+        }
+        (*params->mutable_extra_params())[name.substr(prefix.size())] = value;
+        return true;
+    }
+
+    using google::protobuf::FieldDescriptor;
+    const FieldDescriptor* field = SimulationParameters::descriptor()->FindFieldByName(name);
+    if (!field || field->is_repeated()) {
+        error_msg = "Unknown parameter " + name;
+        return false;
+    }
+    const auto* reflection = params->GetReflection();
+    switch (field->cpp_type()) {
+        case FieldDescriptor::CPPTYPE_DOUBLE:
+            reflection->SetDouble(params, field, value);
+            return true;
+        case FieldDescriptor::CPPTYPE_INT32:
+            if (value != std::trunc(value) ||
+                value < static_cast<double>(std::numeric_limits<int32_t>::min()) ||
+                value > static_cast<double>(std::numeric_limits<int32_t>::max())) {
+                error_msg = "Parameter " + name + " must be an integer";
+                return false;
+            }
+            reflection->SetInt32(params, field, static_cast<int32_t>(value));
+            return true;
+        case FieldDescriptor::CPPTYPE_BOOL:
+            reflection->SetBool(params, field, value != 0.0);
+            return true;
+        default:
+            error_msg = "Unknown parameter " + name;
+            return false;
+    }
+}
+
+// ============================================================================
+// SharedInitialState Implementation
+// ============================================================================
+
+SharedInitialState::SharedInitialState(std::shared_ptr<const PatientData> patient,
+                                       const SimulationParameters& params, size_t members)
+    : patient_(std::move(patient)),
+      params_(params),
+      remaining_(members) {
+    // The base only ever seeds other engines, so it stays on the host
+    params_.set_use_gpu(false);
+}
+
+bool SharedInitialState::initialize(SimulationEngine& engine, PatientCache& cache,
+                                    int num_threads, std::string& error_msg) {
+    std::shared_ptr<const SimulationEngine> base;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (failed_) {
+            error_msg = error_msg_;
+            return false;
+        }
+        if (remaining_ > 0) {
+            --remaining_;
+        }
+        if (!base_) {
+            auto patient = cache.get(*patient_, error_msg_);
+            if (!patient) {
+                failed_ = true;
+                error_msg = error_msg_;
+                return false;
+            }
+            if (remaining_ == 0) {
+                engine.initialize(*patient);  // Nobody left to share with
+                return true;
+            }
+            auto built = std::make_shared<SimulationEngine>(params_, num_threads);
+            built->initialize(*patient);
+            base_ = std::move(built);
+        }
+        base = base_;
+        if (remaining_ == 0) {
+            base_.reset();
+        }
+    }
+    engine.initialize(*base);
+    return true;
+}
+
+bool SharedInitialState::holdsBase() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return base_ != nullptr;
+}
+
+// ============================================================================
+// EnsembleRecord Implementation
+// ============================================================================
+
+EnsembleRecord::EnsembleRecord(std::string ensemble_id, std::string ensemble_name,
+                               std::vector<std::shared_ptr<SimulationRecord>> members)
+    : ensemble_id_(std::move(ensemble_id)),
+      ensemble_name_(std::move(ensemble_name)),
+      members_(std::move(members)) {
+}
+
+SimulationStatus EnsembleRecord::status() const {
+    bool all_terminal = true;
+    bool any_started = false;
+    bool any_failed = false;
+    bool any_stopped = false;
+    for (const auto& member : members_) {
+        const SimulationStatus status = member->status();
+        all_terminal = all_terminal && isTerminal(status);
+        any_started = any_started || status != SimulationStatus::QUEUED;
+        any_failed = any_failed || status == SimulationStatus::FAILED;
+        any_stopped = any_stopped || status == SimulationStatus::STOPPED;
+    }
+    if (!all_terminal) {
+        return any_started ? SimulationStatus::RUNNING : SimulationStatus::QUEUED;
+    }
+    if (any_failed) {
+        return SimulationStatus::FAILED;
+    }
+    return any_stopped ? SimulationStatus::STOPPED : SimulationStatus::COMPLETED;
+}
+
+void EnsembleRecord::toStatusResponse(EnsembleStatusResponse* response) const {
+    response->set_ensemble_id(ensemble_id_);
+    response->set_ensemble_name(ensemble_name_);
+    response->set_status(status());
+    response->set_total_members(static_cast<int32_t>(members_.size()));
+
+    double progress = 0.0;
+    std::map<std::string, std::vector<double>> values;
+    auto& by_status = *response->mutable_members_by_status();
+    for (const auto& member : members_) {
+        ++by_status[member->status()];
+        progress += member->progressPercentage();
+        member->toSummary(response->add_members());
+
+        // Results of completed and stopped members
+        SimulationMetrics metrics;
+        if (!member->resultMetrics(&metrics)) {
+            continue;
+        }
+        addMetric(values, "total_cancer_cells", static_cast<double>(metrics.total_cancer_cells()));
+        addMetric(values, "total_immune_cells", static_cast<double>(metrics.total_immune_cells()));
+        addMetric(values, "total_cells", static_cast<double>(metrics.total_cells()));
+        addMetric(values, "tumor_volume", metrics.tumor_volume());
+        addMetric(values, "tumor_radius", metrics.tumor_radius());
+        addMetric(values, "avg_oxygen", metrics.avg_oxygen());
+        addMetric(values, "avg_glucose", metrics.avg_glucose());
+        addMetric(values, "avg_drug_concentration", metrics.avg_drug_concentration());
+        addMetric(values, "subclones", static_cast<double>(metrics.subclones_size()));
+        for (const auto& [name, value] : metrics.extra_metrics()) {
+            addMetric(values, name, value);
+        }
+    }
+    response->set_progress_percentage(members_.empty() ? 0.0 : progress / members_.size());
+
+    for (const auto& [name, samples] : values) {
+        double sum = 0.0;
+        for (double sample : samples) {
+            sum += sample;
+        }
+        const double mean = sum / static_cast<double>(samples.size());
+        double squares = 0.0;
+        for (double sample : samples) {
+            squares += (sample - mean) * (sample - mean);
+        }
+
+        MetricSummary& summary = (*response->mutable_metrics())[name];
+        summary.set_count(static_cast<int32_t>(samples.size()));
+        summary.set_mean(mean);
+        summary.set_stddev(std::sqrt(squares / static_cast<double>(samples.size())));
+        summary.set_min(*std::min_element(samples.begin(), samples.end()));
+        summary.set_max(*std::max_element(samples.begin(), samples.end()));
+    }
+}
+
+} // namespace tumordtwin
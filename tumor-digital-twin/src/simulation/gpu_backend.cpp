@@ -0,0 +1,259 @@
+#include "simulation/gpu_backend.h"
+#include <algorithm>
+#include <stdexcept>
+
+#ifdef TUMORDTWIN_HAVE_CUDA
+#include <cuda_runtime.h>
+#include "simulation/gpu_kernels.h"
+#endif
+
+namespace tumordtwin {
+
+#ifdef TUMORDTWIN_HAVE_CUDA
+
+namespace {
+
+// Owning device allocation of `count` elements
+template <typename T>
+class DeviceArray {
+public:
+    DeviceArray() = default;
+    ~DeviceArray() { release(); }
+
+    DeviceArray(const DeviceArray&) = delete;
+    DeviceArray& operator=(const DeviceArray&) = delete;
+
+    bool allocate(size_t count) {
+        release();
+        if (count > 0 && cudaMalloc(reinterpret_cast<void**>(&data_), count * sizeof(T)) != cudaSuccess) {
+            data_ = nullptr;
+            return false;
+        }
+        capacity_ = count;
+        return true;
+    }
+
+    // Grow geometrically so per-step agent uploads rarely reallocate
+    bool reserve(size_t count) {
+        return count <= capacity_ || allocate(std::max(count, capacity_ + capacity_ / 2));
+    }
+
+    void release() {
+        if (data_) {
+            cudaFree(data_);
+            data_ = nullptr;
+        }
+        capacity_ = 0;
+    }
+
+    T* get() const { return data_; }
+
+private:
+    T* data_ = nullptr;
+    size_t capacity_ = 0;
+};
+
+} // namespace
+
+struct GpuBackend::Device {
+    gpu::LatticeShape shape{};
+    double spacing = 1.0;
+    size_t voxels = 0;
+    cudaStream_t stream = nullptr;
+
+    DeviceArray<double> oxygen, glucose;
+    DeviceArray<double> oxygen_uptake, glucose_uptake;
+    DeviceArray<double> scratch;  // Output field of the step, swapped in afterwards
+
+    // Agent columns uploaded each step
+    DeviceArray<double> x, y, z;
+    DeviceArray<uint8_t> states;
+    DeviceArray<double> sampled;
+
+    DeviceArray<double> sum;
+
+    ~Device() {
+        if (stream) {
+            cudaStreamDestroy(stream);
+        }
+    }
+
+    gpu::StencilCoefficients coefficients(const DiffusionParams& params, double dt) const {
+        const double r = params.diffusion_coeff * dt / (spacing * spacing);
+        return {r, 1.0 - 6.0 * r - dt * params.decay_rate, dt, params.boundary_value,
+                params.boundary == BoundaryCondition::Dirichlet};
+    }
+
+    void diffuse(DeviceArray<double>& field, const DeviceArray<double>& uptake,
+                 const DiffusionParams& params, double dt) {
+        gpu::launchDiffusion(field.get(), scratch.get(), uptake.get(), shape,
+                             coefficients(params, dt), stream);
+        // Device-to-device copy keeps the field's buffer identity stable
+        cudaMemcpyAsync(field.get(), scratch.get(), voxels * sizeof(double),
+                        cudaMemcpyDeviceToDevice, stream);
+    }
+
+    double mean(const DeviceArray<double>& field) {
+        if (voxels == 0) {
+            return 0.0;
+        }
+        double total = 0.0;
+        cudaMemsetAsync(sum.get(), 0, sizeof(double), stream);
+        gpu::launchSum(field.get(), voxels, sum.get(), stream);
+        cudaMemcpyAsync(&total, sum.get(), sizeof(double), cudaMemcpyDeviceToHost, stream);
+        cudaStreamSynchronize(stream);
+        return total / static_cast<double>(voxels);
+    }
+};
+
+bool GpuBackend::isAvailable() {
+    int count = 0;
+    return cudaGetDeviceCount(&count) == cudaSuccess && count > 0;
+}
+
+std::unique_ptr<GpuBackend> GpuBackend::create(int nx, int ny, int nz, double spacing,
+                                               std::string& error_msg) {
+    if (!isAvailable()) {
+        error_msg = "No CUDA device is available";
+        return nullptr;
+    }
+
+    auto device = std::make_unique<Device>();
+    device->shape = {nx, ny, nz, 1.0 / spacing};
+    device->spacing = spacing;
+    device->voxels = static_cast<size_t>(nx) * ny * nz;
+    const bool ok = cudaStreamCreate(&device->stream) == cudaSuccess &&
+                    device->oxygen.allocate(device->voxels) &&
+                    device->glucose.allocate(device->voxels) &&
+                    device->oxygen_uptake.allocate(device->voxels) &&
+                    device->glucose_uptake.allocate(device->voxels) &&
+                    device->scratch.allocate(device->voxels) &&
+                    device->sum.allocate(1);
+    if (!ok) {
+        error_msg = std::string("Cannot allocate device fields: ") +
+                    cudaGetErrorString(cudaGetLastError());
+        return nullptr;
+    }
+    return std::unique_ptr<GpuBackend>(new GpuBackend(std::move(device)));
+}
+
+bool GpuBackend::fits(int nx, int ny, int nz, double spacing) const {
+    return device_->shape.nx == nx && device_->shape.ny == ny && device_->shape.nz == nz &&
+           device_->spacing == spacing;
+}
+
+void GpuBackend::upload(const ScalarGrid& oxygen, const ScalarGrid& glucose) {
+    const size_t bytes = device_->voxels * sizeof(double);
+    cudaMemcpyAsync(device_->oxygen.get(), oxygen.data(), bytes, cudaMemcpyHostToDevice,
+                    device_->stream);
+    cudaMemcpyAsync(device_->glucose.get(), glucose.data(), bytes, cudaMemcpyHostToDevice,
+                    device_->stream);
+    cudaStreamSynchronize(device_->stream);
+}
+
+void GpuBackend::download(ScalarGrid& oxygen, ScalarGrid& glucose) {
+    const size_t bytes = device_->voxels * sizeof(double);
+    cudaMemcpyAsync(oxygen.data(), device_->oxygen.get(), bytes, cudaMemcpyDeviceToHost,
+                    device_->stream);
+    cudaMemcpyAsync(glucose.data(), device_->glucose.get(), bytes, cudaMemcpyDeviceToHost,
+                    device_->stream);
+    cudaStreamSynchronize(device_->stream);
+}
+
+void GpuBackend::step(const AgentStore& agents,
+                      const DiffusionParams& oxygen, double oxygen_uptake_rate,
+                      const DiffusionParams& glucose, double glucose_uptake_rate,
+                      double dt, int oxygen_substeps, int glucose_substeps,
+                      double outside_value, AlignedVector<double>* agent_oxygen) {
+    Device& d = *device_;
+    const size_t n = agents.size();
+    cudaStream_t stream = d.stream;
+
+    if (!d.x.reserve(n) || !d.y.reserve(n) || !d.z.reserve(n) ||
+        !d.states.reserve(n) || !d.sampled.reserve(n)) {
+        throw std::runtime_error("Cannot allocate device agent columns");
+    }
+    cudaMemcpyAsync(d.x.get(), agents.x().data(), n * sizeof(double), cudaMemcpyHostToDevice, stream);
+    cudaMemcpyAsync(d.y.get(), agents.y().data(), n * sizeof(double), cudaMemcpyHostToDevice, stream);
+    cudaMemcpyAsync(d.z.get(), agents.z().data(), n * sizeof(double), cudaMemcpyHostToDevice, stream);
+    cudaMemcpyAsync(d.states.get(), agents.states().data(), n, cudaMemcpyHostToDevice, stream);
+
+    const size_t bytes = d.voxels * sizeof(double);
+    cudaMemsetAsync(d.oxygen_uptake.get(), 0, bytes, stream);
+    cudaMemsetAsync(d.glucose_uptake.get(), 0, bytes, stream);
+    gpu::launchDepositUptake(d.x.get(), d.y.get(), d.z.get(), d.states.get(), n, d.shape,
+                             static_cast<uint8_t>(CellState::PROLIFERATING),
+                             static_cast<uint8_t>(CellState::QUIESCENT),
+                             oxygen_uptake_rate, glucose_uptake_rate,
+                             d.oxygen_uptake.get(), d.glucose_uptake.get(), stream);
+
+    for (int n = 0; n < oxygen_substeps; ++n) {
+        d.diffuse(d.oxygen, d.oxygen_uptake, oxygen, dt / oxygen_substeps);
+    }
+    for (int n = 0; n < glucose_substeps; ++n) {
+        d.diffuse(d.glucose, d.glucose_uptake, glucose, dt / glucose_substeps);
+    }
+
+    gpu::launchSample(d.oxygen.get(), d.x.get(), d.y.get(), d.z.get(), n, d.shape,
+                      outside_value, d.sampled.get(), stream);
+    agent_oxygen->resize(n);
+    cudaMemcpyAsync(agent_oxygen->data(), d.sampled.get(), n * sizeof(double),
+                    cudaMemcpyDeviceToHost, stream);
+    if (cudaStreamSynchronize(stream) != cudaSuccess) {
+        throw std::runtime_error(std::string("GPU step failed: ") +
+                                 cudaGetErrorString(cudaGetLastError()));
+    }
+}
+
+double GpuBackend::oxygenMean() {
+    return device_->mean(device_->oxygen);
+}
+
+double GpuBackend::glucoseMean() {
+    return device_->mean(device_->glucose);
+}
+
+#else  // Built without CUDA: the engine always takes the CPU path
+
+struct GpuBackend::Device {};
+
+bool GpuBackend::isAvailable() {
+    return false;
+}
+
+std::unique_ptr<GpuBackend> GpuBackend::create(int, int, int, double, std::string& error_msg) {
+    error_msg = "Built without CUDA support";
+    return nullptr;
+}
+
+bool GpuBackend::fits(int, int, int, double) const {
+    return false;
+}
+
+void GpuBackend::upload(const ScalarGrid&, const ScalarGrid&) {}
+
+void GpuBackend::download(ScalarGrid&, ScalarGrid&) {}
+
+void GpuBackend::step(const AgentStore&, const DiffusionParams&, double,
+                      const DiffusionParams&, double, double, int, int, double,
+                      AlignedVector<double>* agent_oxygen) {
+    agent_oxygen->clear();
+}
+
+double GpuBackend::oxygenMean() {
+    return 0.0;
+}
+
+double GpuBackend::glucoseMean() {
+    return 0.0;
+}
+
+#endif
+
+GpuBackend::GpuBackend(std::unique_ptr<Device> device)
+    : device_(std::move(device)) {
+}
+
+GpuBackend::~GpuBackend() = default;
+
+} // namespace tumordtwin
@@ -0,0 +1,156 @@
+#include "simulation/gpu_kernels.h"
+
+namespace tumordtwin {
+namespace gpu {
+
+namespace {
+
+constexpr int kThreadsPerBlock = 256;
+
+// Diffusion blocks cover a 32 x 8 patch of one plane
+constexpr int kBlockX = 32;
+constexpr int kBlockY = 8;
+
+unsigned int blocksFor(size_t count) {
+    return static_cast<unsigned int>((count + kThreadsPerBlock - 1) / kThreadsPerBlock);
+}
+
+__device__ inline int64_t voxelOf(double x, double y, double z, LatticeShape shape) {
+    const auto i = static_cast<int64_t>(floor(x * shape.inv_spacing));
+    const auto j = static_cast<int64_t>(floor(y * shape.inv_spacing));
+    const auto k = static_cast<int64_t>(floor(z * shape.inv_spacing));
+    if (i < 0 || j < 0 || k < 0 || i >= shape.nx || j >= shape.ny || k >= shape.nz) {
+        return -1;
+    }
+    return (k * shape.ny + j) * shape.nx + i;
+}
+
+__global__ void depositUptakeKernel(const double* __restrict__ x, const double* __restrict__ y,
+                                    const double* __restrict__ z,
+                                    const uint8_t* __restrict__ states, size_t num_agents,
+                                    LatticeShape shape, uint8_t state_a, uint8_t state_b,
+                                    double oxygen_rate, double glucose_rate,
+                                    double* oxygen_uptake, double* glucose_uptake) {
+    const size_t a = blockIdx.x * static_cast<size_t>(blockDim.x) + threadIdx.x;
+    if (a >= num_agents || (states[a] != state_a && states[a] != state_b)) {
+        return;
+    }
+    const int64_t v = voxelOf(x[a], y[a], z[a], shape);
+    if (v < 0) {
+        return;
+    }
+    atomicAdd(oxygen_uptake + v, oxygen_rate);
+    atomicAdd(glucose_uptake + v, glucose_rate);
+}
+
+__global__ void diffusionKernel(const double* __restrict__ in, double* __restrict__ out,
+                                const double* __restrict__ uptake, LatticeShape shape,
+                                StencilCoefficients c) {
+    const int i = blockIdx.x * blockDim.x + threadIdx.x;
+    const int j = blockIdx.y * blockDim.y + threadIdx.y;
+    const int k = blockIdx.z;
+    if (i >= shape.nx || j >= shape.ny) {
+        return;
+    }
+
+    const size_t row = static_cast<size_t>(shape.nx);
+    const size_t plane = row * static_cast<size_t>(shape.ny);
+    const size_t idx = static_cast<size_t>(k) * plane + static_cast<size_t>(j) * row + i;
+    const bool face = i == 0 || j == 0 || k == 0 ||
+                      i == shape.nx - 1 || j == shape.ny - 1 || k == shape.nz - 1;
+    if (face && c.dirichlet) {
+        out[idx] = c.boundary_value;
+        return;
+    }
+
+    // Zero flux: a missing neighbour mirrors the voxel itself
+    const double center = in[idx];
+    const double sum = (i > 0 ? in[idx - 1] : center) +
+                       (i < shape.nx - 1 ? in[idx + 1] : center) +
+                       (j > 0 ? in[idx - row] : center) +
+                       (j < shape.ny - 1 ? in[idx + row] : center) +
+                       (k > 0 ? in[idx - plane] : center) +
+                       (k < shape.nz - 1 ? in[idx + plane] : center);
+    double result = c.center * center + c.r * sum;
+    if (uptake) {
+        result -= c.dt * uptake[idx] * center;
+    }
+    out[idx] = result;
+}
+
+__global__ void sampleKernel(const double* __restrict__ field, const double* __restrict__ x,
+                             const double* __restrict__ y, const double* __restrict__ z,
+                             size_t num_agents, LatticeShape shape, double outside_value,
+                             double* __restrict__ values) {
+    const size_t a = blockIdx.x * static_cast<size_t>(blockDim.x) + threadIdx.x;
+    if (a >= num_agents) {
+        return;
+    }
+    const int64_t v = voxelOf(x[a], y[a], z[a], shape);
+    values[a] = v >= 0 ? field[v] : outside_value;
+}
+
+__global__ void sumKernel(const double* __restrict__ values, size_t count, double* result) {
+    __shared__ double partial[kThreadsPerBlock];
+    double sum = 0.0;
+    for (size_t n = blockIdx.x * static_cast<size_t>(blockDim.x) + threadIdx.x; n < count;
+         n += static_cast<size_t>(gridDim.x) * blockDim.x) {
+        sum += values[n];
+    }
+    partial[threadIdx.x] = sum;
+    __syncthreads();
+    for (int stride = kThreadsPerBlock / 2; stride > 0; stride /= 2) {
+        if (threadIdx.x < stride) {
+            partial[threadIdx.x] += partial[threadIdx.x + stride];
+        }
+        __syncthreads();
+    }
+    if (threadIdx.x == 0) {
+        atomicAdd(result, partial[0]);
+    }
+}
+
+} // namespace
+
+void launchDepositUptake(const double* x, const double* y, const double* z,
+                         const uint8_t* states, size_t num_agents, LatticeShape shape,
+                         uint8_t consuming_state_a, uint8_t consuming_state_b,
+                         double oxygen_rate, double glucose_rate,
+                         double* oxygen_uptake, double* glucose_uptake, cudaStream_t stream) {
+    if (num_agents == 0) {
+        return;
+    }
+    depositUptakeKernel<<<blocksFor(num_agents), kThreadsPerBlock, 0, stream>>>(
+        x, y, z, states, num_agents, shape, consuming_state_a, consuming_state_b,
+        oxygen_rate, glucose_rate, oxygen_uptake, glucose_uptake);
+}
+
+void launchDiffusion(const double* in, double* out, const double* uptake, LatticeShape shape,
+                     StencilCoefficients coefficients, cudaStream_t stream) {
+    const dim3 block(kBlockX, kBlockY, 1);
+    const dim3 grid((shape.nx + kBlockX - 1) / kBlockX, (shape.ny + kBlockY - 1) / kBlockY,
+                    shape.nz);
+    diffusionKernel<<<grid, block, 0, stream>>>(in, out, uptake, shape, coefficients);
+}
+
+void launchSample(const double* field, const double* x, const double* y, const double* z,
+                  size_t num_agents, LatticeShape shape, double outside_value,
+                  double* values, cudaStream_t stream) {
+    if (num_agents == 0) {
+        return;
+    }
+    sampleKernel<<<blocksFor(num_agents), kThreadsPerBlock, 0, stream>>>(
+        field, x, y, z, num_agents, shape, outside_value, values);
+}
+
+void launchSum(const double* values, size_t count, double* result, cudaStream_t stream) {
+    // Enough blocks to fill the device; each thread strides over the rest
+    const unsigned int blocks = blocksFor(count) < 1024 ? blocksFor(count) : 1024;
+    if (blocks == 0) {
+        return;
+    }
+    sumKernel<<<blocks, kThreadsPerBlock, 0, stream>>>(values, count, result);
+}
+
+} // namespace gpu
+} // namespace tumordtwin
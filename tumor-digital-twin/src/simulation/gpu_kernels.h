@@ -0,0 +1,58 @@
+#pragma once
+
+// Kernel launchers for GpuBackend. Kept free of protobuf and engine types
+// so that only this interface is compiled by nvcc.
+
+#include <cstddef>
+#include <cstdint>
+
+#include <cuda_runtime_api.h>
+
+namespace tumordtwin {
+namespace gpu {
+
+struct LatticeShape {
+    int nx;
+    int ny;
+    int nz;
+    double inv_spacing;
+};
+
+struct StencilCoefficients {
+    double r;               // D * dt / h^2
+    double center;          // 1 - 6r - dt * decay
+    double dt;
+    double boundary_value;
+    bool dirichlet;
+};
+
+/**
+ * Add `rate` to both uptake fields at the voxel of every agent whose state
+ * is one of the two consuming states. The uptake fields must be zeroed.
+ */
+void launchDepositUptake(const double* x, const double* y, const double* z,
+                         const uint8_t* states, size_t num_agents, LatticeShape shape,
+                         uint8_t consuming_state_a, uint8_t consuming_state_b,
+                         double oxygen_rate, double glucose_rate,
+                         double* oxygen_uptake, double* glucose_uptake, cudaStream_t stream);
+
+/**
+ * One explicit reaction-diffusion step from `in` into `out`
+ */
+void launchDiffusion(const double* in, double* out, const double* uptake, LatticeShape shape,
+                     StencilCoefficients coefficients, cudaStream_t stream);
+
+/**
+ * Field value at the voxel of each agent, or outside_value off the lattice
+ */
+void launchSample(const double* field, const double* x, const double* y, const double* z,
+                  size_t num_agents, LatticeShape shape, double outside_value,
+                  double* values, cudaStream_t stream);
+
+/**
+ * Sum of `count` values into *result (device memory, zeroed by the caller)
+ */
+void launchSum(const double* values, size_t count, double* result, cudaStream_t stream);
+
+} // namespace gpu
+} // namespace tumordtwin
@@ -0,0 +1,84 @@
+#include "simulation/grid_pyramid.h"
+#include <algorithm>
+#include <vector>
+
+namespace tumordtwin {
+
+namespace {
+
+// Sum each z plane handed out by `plane` into its block, then divide by the block sizes
+template <typename PlaneReader>
+void averageBlocks(int nx, int ny, int nz, double spacing, int level, PlaneReader plane,
+                   ScalarGrid& out) {
+    const int factor = 1 << level;
+    out.resize(GridPyramid::levelExtent(nx, level), GridPyramid::levelExtent(ny, level),
+               GridPyramid::levelExtent(nz, level), spacing * factor);
+
+    for (int k = 0; k < nz; ++k) {
+        const double* values = plane(k);
+        const int ok = k >> level;
+        for (int j = 0; j < ny; ++j) {
+            double* row = &out.at(0, j >> level, ok);
+            const double* in = values + static_cast<size_t>(j) * nx;
+            for (int i = 0; i < nx; ++i) {
+                row[i >> level] += in[i];
+            }
+        }
+    }
+
+    // Edge blocks are cut short by the lattice
+    auto blockSize = [factor](int index, int extent) {
+        return std::min(factor, extent - index * factor);
+    };
+    for (int k = 0; k < out.nz(); ++k) {
+        const int bz = blockSize(k, nz);
+        for (int j = 0; j < out.ny(); ++j) {
+            const int bzy = bz * blockSize(j, ny);
+            double* row = &out.at(0, j, k);
+            for (int i = 0; i < out.nx(); ++i) {
+                row[i] /= static_cast<double>(bzy * blockSize(i, nx));
+            }
+        }
+    }
+}
+
+} // namespace
+
+// ============================================================================
+// GridPyramid Implementation
+// ============================================================================
+
+const ScalarGrid& GridPyramid::level(int key, int level, const ScalarGrid* dense,
+                                     const BrickGrid* sparse) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::unique_ptr<ScalarGrid>& grid = levels_[{key, level}];
+    if (!grid) {
+        grid = std::make_unique<ScalarGrid>();
+        if (dense) {
+            downsample(*dense, level, *grid);
+        } else {
+            downsample(*sparse, level, *grid);
+        }
+    }
+    return *grid;
+}
+
+void GridPyramid::downsample(const ScalarGrid& field, int level, ScalarGrid& out) {
+    const size_t plane_size = static_cast<size_t>(field.nx()) * field.ny();
+    averageBlocks(field.nx(), field.ny(), field.nz(), field.spacing(), level,
+                  [&field, plane_size](int k) { return field.data() + k * plane_size; }, out);
+}
+
+void GridPyramid::downsample(const BrickGrid& field, int level, ScalarGrid& out) {
+    // Planes are expanded one at a time; the dense field is never built
+    const size_t plane_size = static_cast<size_t>(field.nx()) * field.ny();
+    std::vector<double> plane(plane_size);
+    averageBlocks(field.nx(), field.ny(), field.nz(), field.spacing(), level,
+                  [&field, &plane, plane_size](int k) {
+                      field.copyValues(k * plane_size, plane_size, plane.data());
+                      return plane.data();
+                  },
+                  out);
+}
+
+} // namespace tumordtwin
@@ -0,0 +1,228 @@
+#include "simulation/job_scheduler.h"
+#include <algorithm>
+
+namespace tumordtwin {
+
+// ============================================================================
+// JobScheduler Implementation
+// ============================================================================
+
+namespace {
+
+unsigned detectCoreBudget() {
+    unsigned cores = std::thread::hardware_concurrency();
+    return cores > 0 ? cores : 1;
+}
+
+} // namespace
+
+JobScheduler::JobScheduler(size_t max_queue_depth, unsigned core_budget)
+    : max_queue_depth_(max_queue_depth),
+      core_budget_(core_budget > 0 ? core_budget : detectCoreBudget()) {
+    // A job reserves at least one core, so more workers than cores could
+    // never all be busy at the same time.
+    workers_.reserve(core_budget_);
+    for (unsigned i = 0; i < core_budget_; ++i) {
+        workers_.emplace_back(&JobScheduler::workerLoop, this);
+    }
+}
+
+JobScheduler::~JobScheduler() {
+    shutdown();
+}
+
+bool JobScheduler::submit(std::shared_ptr<SimulationJob> job) {
+    return submitBatch({std::move(job)});
+}
+
+bool JobScheduler::submitBatch(const std::vector<std::shared_ptr<SimulationJob>>& jobs) {
+    if (jobs.empty()) {
+        return false;
+    }
+    for (const auto& job : jobs) {
+        if (!job || !job->run) {
+            return false;
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopping_ || queue_.size() + jobs.size() > max_queue_depth_) {
+            return false;
+        }
+        for (const auto& job : jobs) {
+            job->num_threads = std::clamp(job->num_threads, 1u, core_budget_);
+            queue_.push_back(job);
+        }
+    }
+
+    cv_.notify_all();
+    return true;
+}
+
+bool JobScheduler::cancel(const std::string& simulation_id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto queued = std::find_if(queue_.begin(), queue_.end(),
+        [&](const auto& job) { return job->simulation_id == simulation_id; });
+    if (queued != queue_.end()) {
+        (*queued)->cancel_requested = true;
+        queue_.erase(queued);
+        // The head of the queue may have changed
+        cv_.notify_all();
+        return true;
+    }
+
+    for (const auto& job : running_) {
+        if (job->simulation_id == simulation_id) {
+            job->cancel_requested = true;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+std::vector<std::shared_ptr<SimulationJob>> JobScheduler::takeQueued(size_t max_jobs) {
+    std::vector<std::shared_ptr<SimulationJob>> taken;
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto it = queue_.end(); it != queue_.begin() && taken.size() < max_jobs;) {
+        --it;
+        if ((*it)->movable) {
+            taken.push_back(std::move(*it));
+            it = queue_.erase(it);
+        }
+    }
+    if (!taken.empty()) {
+        cv_.notify_all();
+    }
+    return taken;
+}
+
+void JobScheduler::restore(const std::vector<std::shared_ptr<SimulationJob>>& jobs) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopping_) {
+            return;
+        }
+        // takeQueued() hands them out latest first
+        for (auto it = jobs.rbegin(); it != jobs.rend(); ++it) {
+            if (!(*it)->cancelRequested()) {
+                queue_.push_back(*it);
+            }
+        }
+    }
+    cv_.notify_all();
+}
+
+void JobScheduler::shutdown() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopping_ && workers_.empty()) {
+            return;
+        }
+        stopping_ = true;
+        for (const auto& job : queue_) {
+            job->cancel_requested = true;
+        }
+        queue_.clear();
+        for (const auto& job : running_) {
+            job->cancel_requested = true;
+        }
+    }
+
+    cv_.notify_all();
+    for (auto& worker : workers_) {
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+    workers_.clear();
+}
+
+unsigned JobScheduler::resolveThreadCount(int requested) const {
+    if (requested <= 0) {
+        return 1;
+    }
+    return std::min(static_cast<unsigned>(requested), core_budget_);
+}
+
+double JobScheduler::estimateCost(const SimulationParameters& params) {
+    return static_cast<double>(std::max(params.grid_size_x(), 1)) *
+           std::max(params.grid_size_y(), 1) * std::max(params.grid_size_z(), 1) *
+           std::max(params.num_steps(), 1);
+}
+
+size_t JobScheduler::queueDepth() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return queue_.size();
+}
+
+size_t JobScheduler::runningJobs() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return running_.size();
+}
+
+unsigned JobScheduler::coresInUse() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return cores_in_use_;
+}
+
+double JobScheduler::queuedCost() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    double cost = 0.0;
+    for (const auto& job : queue_) {
+        cost += job->cost;
+    }
+    return cost;
+}
+
+double JobScheduler::outstandingCost() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    double cost = 0.0;
+    for (const auto& job : queue_) {
+        cost += job->cost;
+    }
+    for (const auto& job : running_) {
+        cost += job->cost;
+    }
+    return cost;
+}
+
+bool JobScheduler::canDispatchLocked() const {
+    // Strict FIFO: a wide job at the head is not overtaken by narrower ones,
+    // which keeps queueing delay predictable.
+    return !queue_.empty() &&
+           cores_in_use_ + queue_.front()->num_threads <= core_budget_;
+}
+
+void JobScheduler::workerLoop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    while (true) {
+        cv_.wait(lock, [this] { return stopping_ || canDispatchLocked(); });
+        if (stopping_) {
+            return;
+        }
+
+        std::shared_ptr<SimulationJob> job = std::move(queue_.front());
+        queue_.pop_front();
+        cores_in_use_ += job->num_threads;
+        running_.push_back(job);
+
+        lock.unlock();
+        try {
+            job->run(*job);
+        } catch (...) {
+            // A failing job must not take the worker down with it; the job
+            // body is responsible for recording its own failure.
+        }
+        lock.lock();
+
+        cores_in_use_ -= job->num_threads;
+        running_.erase(std::find(running_.begin(), running_.end(), job));
+        cv_.notify_all();
+    }
+}
+
+} // namespace tumordtwin
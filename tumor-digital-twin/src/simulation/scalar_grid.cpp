@@ -0,0 +1,78 @@
+#include "simulation/scalar_grid.h"
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+
+namespace tumordtwin {
+
+// ============================================================================
+// ScalarGrid Implementation
+// ============================================================================
+
+ScalarGrid::ScalarGrid(int nx, int ny, int nz, double spacing, double initial_value) {
+    resize(nx, ny, nz, spacing, initial_value);
+}
+
+void ScalarGrid::resize(int nx, int ny, int nz, double spacing, double initial_value) {
+    nx_ = nx;
+    ny_ = ny;
+    nz_ = nz;
+    spacing_ = spacing;
+    values_.assign(static_cast<size_t>(nx) * ny * nz, initial_value);
+}
+
+void ScalarGrid::fill(double value) {
+    std::fill(values_.begin(), values_.end(), value);
+}
+
+double ScalarGrid::mean() const {
+    if (values_.empty()) {
+        return 0.0;
+    }
+    return std::accumulate(values_.begin(), values_.end(), 0.0) /
+           static_cast<double>(values_.size());
+}
+
+void ScalarGrid::swap(ScalarGrid& other) noexcept {
+    std::swap(nx_, other.nx_);
+    std::swap(ny_, other.ny_);
+    std::swap(nz_, other.nz_);
+    std::swap(spacing_, other.spacing_);
+    values_.swap(other.values_);
+}
+
+void ScalarGrid::toProto(GridData* grid, SubstanceType substance) const {
+    toProtoHeader(grid, substance);
+    grid->set_values(reinterpret_cast<const char*>(values_.data()),
+                     values_.size() * sizeof(double));
+}
+
+void ScalarGrid::toProtoHeader(GridData* grid, SubstanceType substance) const {
+    auto* metadata = grid->mutable_metadata();
+    metadata->set_nx(nx_);
+    metadata->set_ny(ny_);
+    metadata->set_nz(nz_);
+    metadata->set_dx(spacing_);
+    metadata->set_dy(spacing_);
+    metadata->set_dz(spacing_);
+    grid->set_substance(substance);
+    grid->set_compressed(false);
+}
+
+bool ScalarGrid::fromProto(const GridData& grid) {
+    const auto& metadata = grid.metadata();
+    if (grid.compressed() || metadata.nx() <= 0 || metadata.ny() <= 0 || metadata.nz() <= 0) {
+        return false;
+    }
+
+    size_t count = static_cast<size_t>(metadata.nx()) * metadata.ny() * metadata.nz();
+    if (grid.values().size() != count * sizeof(double)) {
+        return false;
+    }
+
+    resize(metadata.nx(), metadata.ny(), metadata.nz(), metadata.dx());
+    std::memcpy(values_.data(), grid.values().data(), grid.values().size());
+    return true;
+}
+
+} // namespace tumordtwin
@@ -0,0 +1,1203 @@
+#include "simulation/simulation_engine.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <unordered_map>
+
+namespace tumordtwin {
+
+namespace {
+
+constexpr double kPi = 3.14159265358979323846;
+
+// Normalized far-field concentration supplied by the surrounding vasculature
+constexpr double kFarFieldConcentration = 1.0;
+
+constexpr double kDefaultInitialTumorCells = 1000.0;
+constexpr double kDefaultRandomSeed = 42.0;
+constexpr double kDefaultOxygenUptake = 0.5;
+constexpr double kDefaultGlucoseUptake = 0.3;
+constexpr double kDefaultHypoxiaThreshold = 0.2;
+constexpr double kDefaultNecrosisThreshold = 0.05;
+constexpr double kDefaultMaxCellsPerVoxel = 2.0;
+constexpr double kDefaultInitialTCells = 0.0;
+constexpr double kDefaultTCellKillRate = 0.5;
+constexpr double kDefaultSparseTolerance = 1e-12;
+
+bool consumesNutrients(CellState state) {
+    return state == CellState::PROLIFERATING || state == CellState::QUIESCENT;
+}
+
+// Whether a run keeps its fields in BrickGrids (kParamSparseGrid, else by lattice size)
+bool sparseFields(const SimulationParameters& params) {
+    const auto it = params.extra_params().find(SimulationEngine::kParamSparseGrid);
+    if (it != params.extra_params().end()) {
+        return it->second > 0.0;
+    }
+    return static_cast<int64_t>(params.grid_size_x()) * params.grid_size_y() *
+               params.grid_size_z() >=
+           SimulationEngine::kAutoSparseVoxels;
+}
+
+void addSubclone(SimulationMetrics* metrics, uint64_t hash, int64_t cells, int64_t cancer) {
+    // Little-endian bytes of the 64-bit genotype hash
+    char hash_bytes[sizeof(hash)];
+    for (size_t b = 0; b < sizeof(hash); ++b) {
+        hash_bytes[b] = static_cast<char>(hash >> (8 * b));
+    }
+    SubcloneInfo* subclone = metrics->add_subclones();
+    subclone->set_genotype_hash(hash_bytes, sizeof(hash_bytes));
+    subclone->set_cell_count(static_cast<int32_t>(cells));
+    subclone->set_frequency(static_cast<double>(cells) / static_cast<double>(cancer));
+}
+
+} // namespace
+
+// ============================================================================
+// SimulationEngine Implementation
+// ============================================================================
+
+SimulationEngine::SimulationEngine(const SimulationParameters& params, int num_threads)
+    : params_(params),
+      num_threads_(num_threads),
+      solver_(num_threads) {
+    setTreatment(TreatmentProtocol());
+}
+
+void SimulationEngine::rebind(const SimulationParameters& params, int num_threads) {
+    params_ = params;
+    num_threads_ = num_threads;
+    solver_.setNumThreads(num_threads);
+    current_step_ = 0;
+    profiler_.reset();
+    setTreatment(TreatmentProtocol());
+
+    // Columns keep their capacity; IDs restart as in a new engine
+    agents_.clear();
+    agents_.setNextId(1);
+    genotypes_.clear();
+    clone_counts_current_ = false;
+}
+
+void SimulationEngine::attachDomain(SlabTransport& transport) {
+    domain_ = std::make_unique<SlabDomain>(params_.grid_size_x(), params_.grid_size_y(),
+                                           params_.grid_size_z(), params_.spatial_resolution(),
+                                           transport);
+}
+
+void SimulationEngine::leadRanks(RankCommand command) const {
+    if (domain_ && domain_->rank() == 0) {
+        domain_->broadcast(std::string(1, static_cast<char>(command)));
+    }
+}
+
+void SimulationEngine::followRank0() {
+    while (true) {
+        const std::string command = domain_->broadcast(std::string());
+        switch (command.empty() ? RankCommand::Release : static_cast<RankCommand>(command[0])) {
+            case RankCommand::Initialize:
+                initialize();
+                break;
+            case RankCommand::Step:
+                step();
+                break;
+            case RankCommand::Snapshot:
+                snapshot();
+                break;
+            case RankCommand::Release:
+                return;
+        }
+    }
+}
+
+void SimulationEngine::releaseRanks() {
+    leadRanks(RankCommand::Release);
+}
+
+void SimulationEngine::setTreatment(const TreatmentProtocol& protocol) {
+    treatment_ = protocol;
+    drugs_.configure(treatment_, params_.grid_size_x(), params_.grid_size_y(),
+                     params_.grid_size_z(), params_.spatial_resolution(),
+                     extraParam(kParamDrugNegligible,
+                                DrugTransport::kDefaultNegligibleConcentration));
+}
+
+double SimulationEngine::extraParam(const char* key, double default_value) const {
+    auto it = params_.extra_params().find(key);
+    return it != params_.extra_params().end() ? it->second : default_value;
+}
+
+ScalarGrid& SimulationEngine::oxygen() {
+    syncHostFields();
+    resident_fields_current_ = false;
+    return oxygen_;
+}
+
+ScalarGrid& SimulationEngine::glucose() {
+    syncHostFields();
+    resident_fields_current_ = false;
+    return glucose_;
+}
+
+const ScalarGrid& SimulationEngine::oxygen() const {
+    syncHostFields();
+    return oxygen_;
+}
+
+const ScalarGrid& SimulationEngine::glucose() const {
+    syncHostFields();
+    return glucose_;
+}
+
+void SimulationEngine::syncHostFields() const {
+    if (host_fields_current_) {
+        return;
+    }
+    if (gpu_) {
+        gpu_->download(oxygen_, glucose_);
+    } else if (sparse_) {
+        sparse_oxygen_.toDense(oxygen_);
+        sparse_glucose_.toDense(glucose_);
+    }
+    host_fields_current_ = true;
+}
+
+void SimulationEngine::initFieldStorage() {
+    const int nx = params_.grid_size_x();
+    const int ny = params_.grid_size_y();
+    const int nz = params_.grid_size_z();
+    const double h = params_.spatial_resolution();
+
+    host_fields_current_ = true;
+    resident_fields_current_ = false;
+
+    // A rank's slab is a fraction of the lattice, so it stays dense
+    sparse_ = !domain_ && sparseFields(params_);
+    sparse_tolerance_ = std::max(0.0, extraParam(kParamSparseTolerance, kDefaultSparseTolerance));
+
+    // Device fields of the same lattice are reused; they are reloaded at the next step()
+    if (gpu_ && (sparse_ || domain_ || !params_.use_gpu() || !gpu_->fits(nx, ny, nz, h))) {
+        gpu_.reset();
+    }
+    if (sparse_) {
+        sparse_oxygen_uptake_.resize(nx, ny, nz, h);
+        sparse_glucose_uptake_.resize(nx, ny, nz, h);
+        oxygen_uptake_ = ScalarGrid();
+        glucose_uptake_ = ScalarGrid();
+        return;
+    }
+
+    if (domain_) {
+        domain_->allocate(oxygen_uptake_);
+        domain_->allocate(glucose_uptake_);
+        return;
+    }
+    if (params_.use_gpu() && !gpu_) {
+        // No device (or a CPU-only build) falls back to the CPU path
+        std::string error_msg;
+        gpu_ = GpuBackend::create(nx, ny, nz, h, error_msg);
+    }
+    if (!gpu_) {
+        oxygen_uptake_.resize(nx, ny, nz, h);
+        glucose_uptake_.resize(nx, ny, nz, h);
+    }
+}
+
+void SimulationEngine::initialize() {
+    initialize(PatientModel());
+}
+
+void SimulationEngine::initialize(const PatientModel& patient) {
+    const int nx = params_.grid_size_x();
+    const int ny = params_.grid_size_y();
+    const int nz = params_.grid_size_z();
+    const double h = params_.spatial_resolution();
+
+    leadRanks(RankCommand::Initialize);
+    initFieldStorage();
+    if (sparse_) {
+        // The dense fields are only expanded when someone asks for them
+        sparse_oxygen_.resize(nx, ny, nz, h, kFarFieldConcentration);
+        sparse_glucose_.resize(nx, ny, nz, h, kFarFieldConcentration);
+        oxygen_ = ScalarGrid();
+        glucose_ = ScalarGrid();
+        host_fields_current_ = false;
+        resident_fields_current_ = true;
+    } else if (domain_) {
+        domain_->allocate(oxygen_, kFarFieldConcentration);
+        domain_->allocate(glucose_, kFarFieldConcentration);
+    } else {
+        oxygen_.resize(nx, ny, nz, h, kFarFieldConcentration);
+        glucose_.resize(nx, ny, nz, h, kFarFieldConcentration);
+    }
+
+    current_step_ = 0;
+    drugs_.reset(0.0, sparse_);
+    if (patient.clone_fractions.empty()) {
+        genotypes_.clear();
+    } else {
+        genotypes_ = patient.genotypes;
+    }
+    rng_.seed(static_cast<uint64_t>(extraParam(kParamRandomSeed, kDefaultRandomSeed)));
+    if (!domain_ || domain_->rank() == 0) {
+        seedTumor(patient);
+        seedImmuneCells();
+    } else {
+        agents_.clear();
+    }
+    if (domain_) {
+        distributeSeededAgents();
+    }
+    countClones();
+
+    index_.reset(nx, ny, nz, h);
+    index_.rebuild(agents_);
+    if (domain_) {
+        reduceMetrics();
+    }
+}
+
+void SimulationEngine::distributeSeededAgents() {
+    domain_->migrateAgents(agents_, genotypes_);
+
+    // Rank 0 continues the seeding stream; the others draw their own and
+    // number their cells from their own 2^48 IDs
+    const auto rank = static_cast<uint64_t>(domain_->rank());
+    if (rank > 0) {
+        std::seed_seq sequence{
+            static_cast<uint64_t>(extraParam(kParamRandomSeed, kDefaultRandomSeed)), rank};
+        rng_.seed(sequence);
+        agents_.setNextId((rank << 48) + 1);
+    }
+}
+
+void SimulationEngine::initialize(const SimulationEngine& initial) {
+    const int nx = params_.grid_size_x();
+    const int ny = params_.grid_size_y();
+    const int nz = params_.grid_size_z();
+    const double h = params_.spatial_resolution();
+
+    // Storage follows this engine's parameters; the fields are loaded into it at the next step()
+    initFieldStorage();
+    if (sparse_ && initial.sparse_ && initial.resident_fields_current_) {
+        sparse_oxygen_ = initial.sparse_oxygen_;
+        sparse_glucose_ = initial.sparse_glucose_;
+        oxygen_ = ScalarGrid();
+        glucose_ = ScalarGrid();
+        host_fields_current_ = false;
+        resident_fields_current_ = true;
+    } else {
+        oxygen_ = initial.oxygen();
+        glucose_ = initial.glucose();
+    }
+
+    current_step_ = initial.current_step_;
+    drugs_.reset(currentTime(), sparse_);
+    agents_ = initial.agents_;
+    genotypes_ = initial.genotypes_;
+    clone_counts_ = initial.cloneCounts();
+    clone_counts_current_ = true;
+    rng_ = initial.rng_;
+
+    index_.reset(nx, ny, nz, h);
+    index_.rebuild(agents_);
+}
+
+std::string SimulationEngine::initialStateKey(const SimulationParameters& params) {
+    auto extra = [&params](const char* key, double default_value) {
+        auto it = params.extra_params().find(key);
+        return it != params.extra_params().end() ? it->second : default_value;
+    };
+    std::ostringstream key;
+    key << std::hexfloat << params.grid_size_x() << ' ' << params.grid_size_y() << ' '
+        << params.grid_size_z() << ' ' << params.spatial_resolution() << ' '
+        << sparseFields(params) << ' '
+        << extra(kParamRandomSeed, kDefaultRandomSeed) << ' '
+        << extra(kParamInitialTumorCells, kDefaultInitialTumorCells) << ' '
+        << extra(kParamInitialTCells, kDefaultInitialTCells);
+    return key.str();
+}
+
+bool SimulationEngine::resume(int32_t step, const std::string& rng_state,
+                              std::string& error_msg) {
+    const int nx = params_.grid_size_x();
+    const int ny = params_.grid_size_y();
+    const int nz = params_.grid_size_z();
+    const double h = params_.spatial_resolution();
+
+    if (domain_) {
+        error_msg = "A slab-decomposed run cannot be resumed";
+        return false;
+    }
+    for (const ScalarGrid* field : {&oxygen_, &glucose_}) {
+        if (field->nx() != nx || field->ny() != ny || field->nz() != nz) {
+            error_msg = "Restored grid does not match the simulation parameters";
+            return false;
+        }
+    }
+    if (step < 0) {
+        error_msg = "Restored step must be non-negative";
+        return false;
+    }
+
+    std::istringstream stream(rng_state);
+    stream >> rng_;
+    if (!stream) {
+        error_msg = "Invalid random engine state";
+        return false;
+    }
+
+    // The restored dense fields are loaded into resident storage at the next step
+    initFieldStorage();
+    current_step_ = step;
+    drugs_.reschedule(currentTime(), sparse_);
+    countClones();
+
+    index_.reset(nx, ny, nz, h);
+    index_.rebuild(agents_);
+    return true;
+}
+
+std::string SimulationEngine::rngState() const {
+    std::ostringstream stream;
+    stream << rng_;
+    return stream.str();
+}
+
+void SimulationEngine::seedTumor(const PatientModel& patient) {
+    agents_.clear();
+
+    const auto count = static_cast<size_t>(
+        std::max(0.0, extraParam(kParamInitialTumorCells, kDefaultInitialTumorCells)));
+    agents_.reserve(count);
+    if (patient.geometry.empty() || !seedGeometry(patient.geometry, count)) {
+        const double h = params_.spatial_resolution();
+        const double cx = 0.5 * params_.grid_size_x() * h;
+        const double cy = 0.5 * params_.grid_size_y() * h;
+        const double cz = 0.5 * params_.grid_size_z() * h;
+
+        // One cell per voxel volume on average inside a sphere, clipped to the domain
+        double radius = h * std::cbrt(3.0 * static_cast<double>(count) / (4.0 * kPi));
+        radius = std::min({radius, cx, cy, cz});
+
+        std::uniform_real_distribution<double> unit(-1.0, 1.0);
+        std::uniform_real_distribution<double> phase(0.0, 1.0);
+
+        while (agents_.size() < count) {
+            double dx = unit(rng_), dy = unit(rng_), dz = unit(rng_);
+            if (dx * dx + dy * dy + dz * dz > 1.0) {
+                continue;
+            }
+            agents_.add(AgentType::CANCER_CELL,
+                        cx + radius * dx, cy + radius * dy, cz + radius * dz,
+                        CellState::PROLIFERATING, 0.0, phase(rng_));
+        }
+    }
+
+    // Each cell founds from one of the patient's clones, in proportion to its fraction
+    if (!patient.clone_fractions.empty()) {
+        std::discrete_distribution<GenotypeTable::GenotypeId> clone(
+            patient.clone_fractions.begin(), patient.clone_fractions.end());
+        for (GenotypeTable::GenotypeId& genotype : agents_.genotypes()) {
+            genotype = clone(rng_);
+        }
+    }
+}
+
+bool SimulationEngine::seedGeometry(const TumorGeometry& geometry, size_t count) {
+    const size_t nx = static_cast<size_t>(geometry.nx);
+    const size_t plane = nx * static_cast<size_t>(geometry.ny);
+    auto coords = [&](uint32_t voxel, double* i, double* j, double* k) {
+        *i = static_cast<double>(voxel % nx);
+        *j = static_cast<double>((voxel % plane) / nx);
+        *k = static_cast<double>(voxel / plane);
+    };
+
+    // Centroid and half extents of the tumor in millimeters
+    double sum[3] = {0.0, 0.0, 0.0};
+    for (uint32_t voxel : geometry.voxels) {
+        double i, j, k;
+        coords(voxel, &i, &j, &k);
+        sum[0] += (i + 0.5) * geometry.dx;
+        sum[1] += (j + 0.5) * geometry.dy;
+        sum[2] += (k + 0.5) * geometry.dz;
+    }
+    const double n = static_cast<double>(geometry.voxels.size());
+    const double center[3] = {sum[0] / n, sum[1] / n, sum[2] / n};
+    double extent[3] = {0.0, 0.0, 0.0};
+    for (uint32_t voxel : geometry.voxels) {
+        double i, j, k;
+        coords(voxel, &i, &j, &k);
+        extent[0] = std::max({extent[0], std::abs(i * geometry.dx - center[0]),
+                              std::abs((i + 1.0) * geometry.dx - center[0])});
+        extent[1] = std::max({extent[1], std::abs(j * geometry.dy - center[1]),
+                              std::abs((j + 1.0) * geometry.dy - center[1])});
+        extent[2] = std::max({extent[2], std::abs(k * geometry.dz - center[2]),
+                              std::abs((k + 1.0) * geometry.dz - center[2])});
+    }
+
+    // One cell per voxel volume on average, as in the sphere, clipped to the domain
+    const double h = params_.spatial_resolution();
+    const double half[3] = {0.5 * params_.grid_size_x() * h, 0.5 * params_.grid_size_y() * h,
+                            0.5 * params_.grid_size_z() * h};
+    const double tumor_volume = n * geometry.dx * geometry.dy * geometry.dz;
+    double scale = h * std::cbrt(static_cast<double>(count) / tumor_volume);
+    for (int a = 0; a < 3; ++a) {
+        scale = std::min(scale, half[a] / extent[a]);
+    }
+    if (!std::isfinite(scale) || scale <= 0.0) {
+        return false;
+    }
+
+    std::uniform_int_distribution<size_t> pick(0, geometry.voxels.size() - 1);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    for (size_t c = 0; c < count; ++c) {
+        double i, j, k;
+        coords(geometry.voxels[pick(rng_)], &i, &j, &k);
+        const double x = (i + unit(rng_)) * geometry.dx - center[0];
+        const double y = (j + unit(rng_)) * geometry.dy - center[1];
+        const double z = (k + unit(rng_)) * geometry.dz - center[2];
+        agents_.add(AgentType::CANCER_CELL,
+                    half[0] + scale * x, half[1] + scale * y, half[2] + scale * z,
+                    CellState::PROLIFERATING, 0.0, unit(rng_));
+    }
+    return true;
+}
+
+void SimulationEngine::seedImmuneCells() {
+    const auto count = static_cast<size_t>(
+        std::max(0.0, extraParam(kParamInitialTCells, kDefaultInitialTCells)));
+    const double h = params_.spatial_resolution();
+    std::uniform_real_distribution<double> ux(0.0, params_.grid_size_x() * h);
+    std::uniform_real_distribution<double> uy(0.0, params_.grid_size_y() * h);
+    std::uniform_real_distribution<double> uz(0.0, params_.grid_size_z() * h);
+
+    for (size_t n = 0; n < count; ++n) {
+        agents_.add(AgentType::T_CELL, ux(rng_), uy(rng_), uz(rng_), CellState::QUIESCENT);
+    }
+}
+
+void SimulationEngine::clampToDomain(double& x, double& y, double& z) const {
+    // Keep cells strictly inside the last voxel
+    const double h = params_.spatial_resolution();
+    const double eps = 1e-9 * h;
+    x = std::clamp(x, 0.0, params_.grid_size_x() * h - eps);
+    y = std::clamp(y, 0.0, params_.grid_size_y() * h - eps);
+    z = std::clamp(z, 0.0, params_.grid_size_z() * h - eps);
+}
+
+int64_t SimulationEngine::voxelIndex(double x, double y, double z) const {
+    int i, j, k;
+    if (!voxelCoords(x, y, z, &i, &j, &k)) {
+        return -1;
+    }
+    return (static_cast<int64_t>(k) * params_.grid_size_y() + j) * params_.grid_size_x() + i;
+}
+
+bool SimulationEngine::voxelCoords(double x, double y, double z, int* i, int* j, int* k) const {
+    const double inv_h = 1.0 / params_.spatial_resolution();
+    const auto vi = static_cast<int64_t>(std::floor(x * inv_h));
+    const auto vj = static_cast<int64_t>(std::floor(y * inv_h));
+    const auto vk = static_cast<int64_t>(std::floor(z * inv_h));
+    if (vi < 0 || vj < 0 || vk < 0 ||
+        vi >= params_.grid_size_x() || vj >= params_.grid_size_y() || vk >= params_.grid_size_z()) {
+        return false;
+    }
+    *i = static_cast<int>(vi);
+    *j = static_cast<int>(vj);
+    *k = static_cast<int>(vk);
+    return true;
+}
+
+int64_t SimulationEngine::fieldIndex(double x, double y, double z) const {
+    if (!domain_) {
+        return voxelIndex(x, y, z);
+    }
+    int i, j, k;
+    const SlabExtent& extent = domain_->extent();
+    if (!voxelCoords(x, y, z, &i, &j, &k) || k < extent.z_begin || k >= extent.z_end) {
+        return -1;
+    }
+    const int local_k = k - extent.z_begin + extent.firstOwnedLocal();
+    return (static_cast<int64_t>(local_k) * params_.grid_size_y() + j) * params_.grid_size_x() + i;
+}
+
+void SimulationEngine::depositUptake() {
+    const double oxygen_rate = extraParam(kParamOxygenUptake, kDefaultOxygenUptake);
+    const double glucose_rate = extraParam(kParamGlucoseUptake, kDefaultGlucoseUptake);
+    const auto& x = agents_.x();
+    const auto& y = agents_.y();
+    const auto& z = agents_.z();
+
+    if (sparse_) {
+        // Only the bricks holding consuming cells are expanded
+        sparse_oxygen_uptake_.fill(0.0);
+        sparse_glucose_uptake_.fill(0.0);
+        int i, j, k;
+        for (size_t a = 0; a < agents_.size(); ++a) {
+            if (consumesNutrients(agents_.state(a)) && voxelCoords(x[a], y[a], z[a], &i, &j, &k)) {
+                sparse_oxygen_uptake_.at(i, j, k) += oxygen_rate;
+                sparse_glucose_uptake_.at(i, j, k) += glucose_rate;
+            }
+        }
+        return;
+    }
+
+    oxygen_uptake_.fill(0.0);
+    glucose_uptake_.fill(0.0);
+
+    for (size_t a = 0; a < agents_.size(); ++a) {
+        if (!consumesNutrients(agents_.state(a))) {
+            continue;
+        }
+        int64_t v = fieldIndex(x[a], y[a], z[a]);
+        if (v < 0) {
+            continue;
+        }
+        oxygen_uptake_.data()[v] += oxygen_rate;
+        glucose_uptake_.data()[v] += glucose_rate;
+    }
+}
+
+template <SimulationEngine::FieldStorage kStorage, bool kDrugs>
+void SimulationEngine::updateCancerCells() {
+    const double dt = params_.time_step();
+    const double hypoxia = extraParam(kParamHypoxiaThreshold, kDefaultHypoxiaThreshold);
+    const double necrosis = extraParam(kParamNecrosisThreshold, kDefaultNecrosisThreshold);
+    const double cycle_rate = params_.division_rate();
+
+    const auto& x = agents_.x();
+    const auto& y = agents_.y();
+    const auto& z = agents_.z();
+    auto& states = agents_.states();
+    auto& phases = agents_.cyclePhases();
+
+    const size_t end = agents_.bucketEnd(AgentType::CANCER_CELL);
+    for (size_t a = agents_.bucketBegin(AgentType::CANCER_CELL); a < end; ++a) {
+        auto state = static_cast<CellState>(states[a]);
+        if (state == CellState::APOPTOTIC || state == CellState::NECROTIC) {
+            continue;
+        }
+
+        double o2;
+        if constexpr (kStorage == FieldStorage::Resident) {
+            o2 = agent_oxygen_[a];
+        } else if constexpr (kStorage == FieldStorage::Sparse) {
+            int i, j, k;
+            o2 = voxelCoords(x[a], y[a], z[a], &i, &j, &k) ? sparse_oxygen_.value(i, j, k)
+                                                           : kFarFieldConcentration;
+        } else {
+            int64_t v = fieldIndex(x[a], y[a], z[a]);
+            o2 = v >= 0 ? oxygen_.data()[v] : kFarFieldConcentration;
+        }
+        if (o2 < necrosis) {
+            states[a] = CellState::NECROTIC;
+        } else if (o2 < hypoxia) {
+            states[a] = CellState::QUIESCENT;
+        } else {
+            states[a] = CellState::PROLIFERATING;
+            double rate = cycle_rate;
+            if constexpr (kDrugs) {
+                int i, j, k;
+                if (voxelCoords(x[a], y[a], z[a], &i, &j, &k)) {
+                    rate *= 1.0 - drugs_.arrestFraction(i, j, k);
+                }
+            }
+            phases[a] = std::min(1.0, phases[a] + rate * dt);
+        }
+    }
+}
+
+void SimulationEngine::updateAgents() {
+    const double dt = params_.time_step();
+    auto& ages = agents_.ages();
+    for (size_t a = 0; a < agents_.size(); ++a) {
+        ages[a] += dt;
+    }
+
+    // Only cancer cells react to their surroundings; storage and drugs are
+    // fixed for the step, so each combination gets its own loop
+    const bool drugs = drugs_.active();
+    if (gpu_) {
+        drugs ? updateCancerCells<FieldStorage::Resident, true>()
+              : updateCancerCells<FieldStorage::Resident, false>();
+    } else if (sparse_) {
+        drugs ? updateCancerCells<FieldStorage::Sparse, true>()
+              : updateCancerCells<FieldStorage::Sparse, false>();
+    } else {
+        drugs ? updateCancerCells<FieldStorage::Dense, true>()
+              : updateCancerCells<FieldStorage::Dense, false>();
+    }
+}
+
+void SimulationEngine::step() {
+    leadRanks(RankCommand::Step);
+    const double dt = params_.time_step();
+    stepNutrients(dt);
+
+    if (drugs_.numDrugs() > 0) {
+        ScopedPhaseTimer timer(profiler_, ProfilePhase::DrugTransport);
+        drugs_.step(solver_, currentTime(), dt, minSubSteps(), sparse_tolerance_);
+    }
+
+    {
+        ScopedPhaseTimer timer(profiler_, ProfilePhase::AgentUpdate);
+        updateAgents();
+    }
+    applyLifecycle();
+    ++current_step_;
+    if (domain_) {
+        reduceMetrics();
+    }
+}
+
+void SimulationEngine::stepNutrients(double dt) {
+    ScopedPhaseTimer timer(profiler_, ProfilePhase::Diffusion);
+
+    DiffusionParams oxygen_params;
+    oxygen_params.diffusion_coeff = params_.oxygen_diffusion_coeff();
+    oxygen_params.boundary_value = kFarFieldConcentration;
+
+    DiffusionParams glucose_params;
+    glucose_params.diffusion_coeff = params_.glucose_diffusion_coeff();
+    glucose_params.boundary_value = kFarFieldConcentration;
+
+    size_t crowding = maxConsumersPerVoxel();
+    if (domain_) {
+        // Every rank must take the same sub-steps, or the halo exchanges fall out of step
+        std::vector<double> most{static_cast<double>(crowding)};
+        domain_->allReduceMax(most);
+        crowding = static_cast<size_t>(most[0]);
+    }
+    planSubSteps(oxygen_params, crowding * extraParam(kParamOxygenUptake, kDefaultOxygenUptake),
+                 glucose_params, crowding * extraParam(kParamGlucoseUptake, kDefaultGlucoseUptake),
+                 dt);
+
+    if (sparse_) {
+        stepSparse(oxygen_params, glucose_params, dt);
+    } else if (gpu_) {
+        if (!resident_fields_current_) {
+            syncHostFields();
+            gpu_->upload(oxygen_, glucose_);
+            resident_fields_current_ = true;
+        }
+        gpu_->step(agents_,
+                   oxygen_params, extraParam(kParamOxygenUptake, kDefaultOxygenUptake),
+                   glucose_params, extraParam(kParamGlucoseUptake, kDefaultGlucoseUptake),
+                   dt, oxygen_substeps_, glucose_substeps_, kFarFieldConcentration,
+                   &agent_oxygen_);
+        host_fields_current_ = false;
+    } else {
+        depositUptake();
+        auto diffuse = [&](ScalarGrid& field, const DiffusionParams& params, double sub_dt,
+                           const ScalarGrid& uptake) {
+            if (domain_) {
+                domain_->diffuse(solver_, field, params, sub_dt, &uptake);
+            } else {
+                solver_.step(field, params, sub_dt, &uptake);
+            }
+        };
+        // Operator splitting: uptake stays fixed over the sub-steps of one agent step
+        for (int n = 0; n < oxygen_substeps_; ++n) {
+            diffuse(oxygen_, oxygen_params, dt / oxygen_substeps_, oxygen_uptake_);
+        }
+        for (int n = 0; n < glucose_substeps_; ++n) {
+            diffuse(glucose_, glucose_params, dt / glucose_substeps_, glucose_uptake_);
+        }
+    }
+}
+
+void SimulationEngine::stepSparse(const DiffusionParams& oxygen_params,
+                                  const DiffusionParams& glucose_params, double dt) {
+    if (!resident_fields_current_) {
+        sparse_oxygen_.fromDense(oxygen_, sparse_tolerance_);
+        sparse_glucose_.fromDense(glucose_, sparse_tolerance_);
+        resident_fields_current_ = true;
+    }
+    // The dense copies would be stale after this step; free them
+    oxygen_ = ScalarGrid();
+    glucose_ = ScalarGrid();
+
+    depositUptake();
+    for (int n = 0; n < oxygen_substeps_; ++n) {
+        solver_.step(sparse_oxygen_, oxygen_params, dt / oxygen_substeps_,
+                     &sparse_oxygen_uptake_, sparse_tolerance_);
+    }
+    for (int n = 0; n < glucose_substeps_; ++n) {
+        solver_.step(sparse_glucose_, glucose_params, dt / glucose_substeps_,
+                     &sparse_glucose_uptake_, sparse_tolerance_);
+    }
+    host_fields_current_ = false;
+}
+
+int SimulationEngine::minSubSteps() const {
+    return static_cast<int>(std::clamp(extraParam(kParamMinDiffusionSubSteps, 1.0), 1.0,
+                                       static_cast<double>(DiffusionSolver::kMaxSubSteps)));
+}
+
+void SimulationEngine::planSubSteps(const DiffusionParams& oxygen_params, double max_oxygen_uptake,
+                                    const DiffusionParams& glucose_params,
+                                    double max_glucose_uptake, double dt) {
+    const double h = params_.spatial_resolution();
+    const int min_steps = minSubSteps();
+    oxygen_substeps_ = std::max(
+        min_steps, DiffusionSolver::subSteps(oxygen_params, h, dt, max_oxygen_uptake));
+    glucose_substeps_ = std::max(
+        min_steps, DiffusionSolver::subSteps(glucose_params, h, dt, max_glucose_uptake));
+}
+
+size_t SimulationEngine::maxConsumersPerVoxel() const {
+    const auto& x = agents_.x();
+    const auto& y = agents_.y();
+    const auto& z = agents_.z();
+    size_t most = 0;
+    for (size_t a = 0; a < agents_.size(); ++a) {
+        if (consumesNutrients(agents_.state(a))) {
+            most = std::max(most, index_.countInVoxel(index_.voxelKey(x[a], y[a], z[a])));
+        }
+    }
+    return most;
+}
+
+void SimulationEngine::applyLifecycle() {
+    // The phases below keep the index in sync as they go; this only relinks
+    // agents moved by code outside the engine (e.g. after a state import)
+    {
+        ScopedPhaseTimer timer(profiler_, ProfilePhase::NeighborRebuild);
+        index_.update(agents_);
+    }
+
+    ScopedPhaseTimer timer(profiler_, ProfilePhase::Lifecycle);
+    clearDeadCells();
+    applyDeathAndKilling();
+    applyDivision();
+    applyMigration();
+
+    // Cells that divided or migrated out of this rank's slab move to their owner
+    if (domain_) {
+        domain_->migrateAgents(agents_, genotypes_);
+        index_.rebuild(agents_);
+        clone_counts_current_ = false;
+    }
+}
+
+void SimulationEngine::clearDeadCells() {
+    // Apoptotic cells are cleared one step after they die. Walking backwards
+    // keeps swap-removal from moving an unvisited agent into a visited slot.
+    // Cancer cells are the last bucket, so removing one only swaps in the
+    // last agent and the index can mirror it.
+    const size_t cancer_begin = agents_.bucketBegin(AgentType::CANCER_CELL);
+    for (size_t a = agents_.size(); a-- > cancer_begin;) {
+        if (agents_.state(a) == CellState::APOPTOTIC) {
+            addToClone(agents_.genotypes()[a], -1);
+            agents_.remove(a);
+            index_.remove(a);
+        }
+    }
+
+    // Other removals shift the later buckets down; relink those agents once
+    bool shifted = false;
+    for (size_t a = cancer_begin; a-- > 0;) {
+        if (agents_.state(a) == CellState::APOPTOTIC) {
+            shifted = agents_.remove(a) || shifted;
+            index_.remove(a);
+        }
+    }
+    if (shifted) {
+        index_.update(agents_);
+    }
+}
+
+template <bool kDrugs>
+void SimulationEngine::applyCancerDeath() {
+    const double dt = params_.time_step();
+    const double death_p = params_.death_rate() * dt;
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    auto& states = agents_.states();
+
+    const size_t end = agents_.bucketEnd(AgentType::CANCER_CELL);
+    for (size_t a = agents_.bucketBegin(AgentType::CANCER_CELL); a < end; ++a) {
+        CellState state = agents_.state(a);
+        if (state != CellState::PROLIFERATING && state != CellState::QUIESCENT) {
+            continue;
+        }
+        double p = death_p;
+        if constexpr (kDrugs) {
+            int i, j, k;
+            if (voxelCoords(agents_.x()[a], agents_.y()[a], agents_.z()[a], &i, &j, &k)) {
+                p += drugs_.killRate(i, j, k) * dt;
+            }
+        }
+        if (uniform(rng_) < p) {
+            states[a] = CellState::APOPTOTIC;
+        }
+    }
+}
+
+void SimulationEngine::applyTCellKilling() {
+    const double dt = params_.time_step();
+    const double kill_p = extraParam(kParamTCellKillRate, kDefaultTCellKillRate) * dt;
+    const double radius = params_.spatial_resolution();
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    auto& states = agents_.states();
+    const size_t cancer_begin = agents_.bucketBegin(AgentType::CANCER_CELL);
+
+    const size_t end = agents_.bucketEnd(AgentType::T_CELL);
+    for (size_t a = agents_.bucketBegin(AgentType::T_CELL); a < end; ++a) {
+        // Each T cell engages at most one live cancer cell in contact range
+        bool engaged = false;
+        index_.forEachNeighbor(agents_, agents_.x()[a], agents_.y()[a], agents_.z()[a],
+                               radius, [&](size_t b) {
+            if (engaged || b < cancer_begin) {
+                return;
+            }
+            CellState target = agents_.state(b);
+            if (target == CellState::APOPTOTIC || target == CellState::NECROTIC) {
+                return;
+            }
+            engaged = true;
+            if (uniform(rng_) < kill_p) {
+                states[b] = CellState::APOPTOTIC;
+            }
+        });
+    }
+}
+
+void SimulationEngine::applyDeathAndKilling() {
+    // T cells only engage cells that survived this step's natural death
+    drugs_.active() ? applyCancerDeath<true>() : applyCancerDeath<false>();
+    applyTCellKilling();
+}
+
+void SimulationEngine::applyDivision() {
+    const double h = params_.spatial_resolution();
+    const auto max_per_voxel = static_cast<size_t>(
+        extraParam(kParamMaxCellsPerVoxel, kDefaultMaxCellsPerVoxel));
+    const double mutation_p = params_.mutation_rate();
+    std::normal_distribution<double> normal(0.0, 1.0);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    // Infinite-sites model: every mutation hits a new position
+    std::uniform_int_distribution<int32_t> position(0, std::numeric_limits<int32_t>::max());
+    auto& phases = agents_.cyclePhases();
+
+    // Daughters are appended to the cancer bucket behind the current cells
+    const size_t n = agents_.bucketEnd(AgentType::CANCER_CELL);
+    for (size_t a = agents_.bucketBegin(AgentType::CANCER_CELL); a < n; ++a) {
+        if (agents_.state(a) != CellState::PROLIFERATING || phases[a] < 1.0) {
+            continue;
+        }
+
+        // Place the daughter one voxel away in a random direction
+        double dx = normal(rng_), dy = normal(rng_), dz = normal(rng_);
+        double norm = std::sqrt(dx * dx + dy * dy + dz * dz);
+        if (norm == 0.0) {
+            continue;
+        }
+        double x = agents_.x()[a] + h * dx / norm;
+        double y = agents_.y()[a] + h * dy / norm;
+        double z = agents_.z()[a] + h * dz / norm;
+        clampToDomain(x, y, z);
+
+        // Contact inhibition: a full target voxel holds the cell at the checkpoint
+        if (index_.countInVoxel(index_.voxelKey(x, y, z)) >= max_per_voxel) {
+            continue;
+        }
+
+        // No draw without mutations, so mutation_rate 0 keeps the random stream
+        GenotypeTable::GenotypeId genotype = agents_.genotypes()[a];
+        if (mutation_p > 0.0 && uniform(rng_) < mutation_p) {
+            genotype = genotypes_.fork(genotype, position(rng_));
+        }
+
+        phases[a] = 0.0;
+        agents_.add(AgentType::CANCER_CELL, x, y, z, CellState::PROLIFERATING,
+                    0.0, 0.0, genotype);
+        index_.insertAppended(agents_);
+        addToClone(genotype, 1);
+    }
+}
+
+void SimulationEngine::applyMigration() {
+    const double rate = params_.migration_rate();
+    if (rate <= 0.0) {
+        return;
+    }
+
+    // Random walk with diffusivity migration_rate (voxels^2 per time unit)
+    const double h = params_.spatial_resolution();
+    const double sigma = h * std::sqrt(2.0 * rate * params_.time_step());
+    const auto max_per_voxel = static_cast<size_t>(
+        extraParam(kParamMaxCellsPerVoxel, kDefaultMaxCellsPerVoxel));
+    std::normal_distribution<double> normal(0.0, sigma);
+    auto& x = agents_.x();
+    auto& y = agents_.y();
+    auto& z = agents_.z();
+
+    for (size_t a = 0; a < agents_.size(); ++a) {
+        CellState state = agents_.state(a);
+        if (state == CellState::APOPTOTIC || state == CellState::NECROTIC) {
+            continue;
+        }
+
+        double nx = x[a] + normal(rng_);
+        double ny = y[a] + normal(rng_);
+        double nz = z[a] + normal(rng_);
+        clampToDomain(nx, ny, nz);
+
+        int64_t from = index_.voxelKey(x[a], y[a], z[a]);
+        int64_t to = index_.voxelKey(nx, ny, nz);
+        if (to != from && index_.countInVoxel(to) >= max_per_voxel) {
+            continue;
+        }
+        x[a] = nx;
+        y[a] = ny;
+        z[a] = nz;
+        // Keep counts exact for the agents that move after this one
+        index_.relocate(a, nx, ny, nz);
+    }
+}
+
+void SimulationEngine::countClones() const {
+    clone_counts_.assign(genotypes_.size(), 0);
+    const size_t end = agents_.bucketEnd(AgentType::CANCER_CELL);
+    for (size_t a = agents_.bucketBegin(AgentType::CANCER_CELL); a < end; ++a) {
+        const GenotypeTable::GenotypeId genotype = agents_.genotypes()[a];
+        if (genotype >= clone_counts_.size()) {
+            clone_counts_.resize(genotype + 1, 0);
+        }
+        ++clone_counts_[genotype];
+    }
+    clone_counts_current_ = true;
+}
+
+void SimulationEngine::addToClone(GenotypeTable::GenotypeId genotype, int64_t cells) {
+    if (!clone_counts_current_) {
+        return;  // Recounted from scratch at the next computeMetrics()
+    }
+    if (genotype >= clone_counts_.size()) {
+        clone_counts_.resize(std::max<size_t>(genotype + 1, genotypes_.size()), 0);
+    }
+    clone_counts_[genotype] += cells;
+}
+
+const std::vector<int64_t>& SimulationEngine::cloneCounts() const {
+    if (!clone_counts_current_) {
+        countClones();
+    } else if (clone_counts_.size() < genotypes_.size()) {
+        clone_counts_.resize(genotypes_.size(), 0);  // Clones interned since, with no cells yet
+    }
+    return clone_counts_;
+}
+
+void SimulationEngine::computeMetrics(SimulationMetrics* metrics) const {
+    if (domain_) {
+        metrics->CopyFrom(run_metrics_);
+        metrics->set_step_number(current_step_);
+        metrics->set_simulation_time(currentTime());
+        profiler_.toExtraMetrics(metrics->mutable_extra_metrics());
+        return;
+    }
+    metrics->set_step_number(current_step_);
+    metrics->set_simulation_time(currentTime());
+
+    const size_t cancer_begin = agents_.bucketBegin(AgentType::CANCER_CELL);
+    const size_t cancer_end = agents_.bucketEnd(AgentType::CANCER_CELL);
+    const auto cancer = static_cast<int64_t>(cancer_end - cancer_begin);
+    const auto immune = static_cast<int64_t>(agents_.countType(AgentType::T_CELL) +
+                                             agents_.countType(AgentType::MACROPHAGE));
+    double sx = 0.0, sy = 0.0, sz = 0.0;
+    for (size_t a = cancer_begin; a < cancer_end; ++a) {
+        sx += agents_.x()[a];
+        sy += agents_.y()[a];
+        sz += agents_.z()[a];
+    }
+
+    double radius = 0.0;
+    if (cancer > 0) {
+        sx /= cancer;
+        sy /= cancer;
+        sz /= cancer;
+        for (size_t a = cancer_begin; a < cancer_end; ++a) {
+            double dx = agents_.x()[a] - sx;
+            double dy = agents_.y()[a] - sy;
+            double dz = agents_.z()[a] - sz;
+            radius = std::max(radius, std::sqrt(dx * dx + dy * dy + dz * dz));
+        }
+    }
+
+    const double h = params_.spatial_resolution();
+    metrics->set_total_cancer_cells(cancer);
+    metrics->set_total_immune_cells(immune);
+    metrics->set_total_cells(static_cast<int64_t>(agents_.size()));
+    metrics->set_tumor_volume(static_cast<double>(cancer) * h * h * h);
+    metrics->set_tumor_radius(radius);
+
+    const std::vector<int64_t>& clones = cloneCounts();
+    for (size_t id = 0; id < clones.size(); ++id) {
+        if (clones[id] > 0) {
+            addSubclone(metrics, genotypes_.hash(static_cast<GenotypeTable::GenotypeId>(id)),
+                        clones[id], cancer);
+        }
+    }
+    if (gpu_ && !host_fields_current_) {
+        // Reduce on the device rather than copying both fields back
+        metrics->set_avg_oxygen(gpu_->oxygenMean());
+        metrics->set_avg_glucose(gpu_->glucoseMean());
+    } else if (sparse_ && !host_fields_current_) {
+        metrics->set_avg_oxygen(sparse_oxygen_.mean());
+        metrics->set_avg_glucose(sparse_glucose_.mean());
+    } else {
+        metrics->set_avg_oxygen(oxygen_.mean());
+        metrics->set_avg_glucose(glucose_.mean());
+    }
+
+    double drug_total = 0.0;
+    auto& extra = *metrics->mutable_extra_metrics();
+    for (size_t d = 0; d < drugs_.numDrugs(); ++d) {
+        const double mean = drugs_.meanConcentration(d);
+        drug_total += mean;
+        extra["drug." + drugs_.drugName(d)] = mean;
+        extra["plasma." + drugs_.drugName(d)] = drugs_.plasmaConcentration(d);
+    }
+    metrics->set_avg_drug_concentration(drug_total);
+
+    profiler_.toExtraMetrics(&extra);
+}
+
+void SimulationEngine::reduceMetrics() {
+    const size_t cancer_begin = agents_.bucketBegin(AgentType::CANCER_CELL);
+    const size_t cancer_end = agents_.bucketEnd(AgentType::CANCER_CELL);
+    const auto& x = agents_.x();
+    const auto& y = agents_.y();
+    const auto& z = agents_.z();
+
+    // Ghost planes belong to the neighbouring ranks, so only owned planes are summed
+    const SlabExtent& extent = domain_->extent();
+    const size_t plane = static_cast<size_t>(params_.grid_size_x()) * params_.grid_size_y();
+    const size_t first = static_cast<size_t>(extent.firstOwnedLocal()) * plane;
+    const size_t last = first + static_cast<size_t>(extent.ownedPlanes()) * plane;
+    double oxygen_sum = 0.0, glucose_sum = 0.0;
+    for (size_t v = first; v < last; ++v) {
+        oxygen_sum += oxygen_.data()[v];
+        glucose_sum += glucose_.data()[v];
+    }
+
+    std::vector<double> sums{
+        static_cast<double>(cancer_end - cancer_begin),
+        static_cast<double>(agents_.countType(AgentType::T_CELL) +
+                            agents_.countType(AgentType::MACROPHAGE)),
+        static_cast<double>(agents_.size()), 0.0, 0.0, 0.0, oxygen_sum, glucose_sum};
+    for (size_t a = cancer_begin; a < cancer_end; ++a) {
+        sums[3] += x[a];
+        sums[4] += y[a];
+        sums[5] += z[a];
+    }
+    domain_->allReduceSum(sums);
+    const auto cancer = static_cast<int64_t>(sums[0]);
+
+    std::vector<double> radius{0.0};
+    if (cancer > 0) {
+        const double cx = sums[3] / sums[0], cy = sums[4] / sums[0], cz = sums[5] / sums[0];
+        for (size_t a = cancer_begin; a < cancer_end; ++a) {
+            const double dx = x[a] - cx, dy = y[a] - cy, dz = z[a] - cz;
+            radius[0] = std::max(radius[0], std::sqrt(dx * dx + dy * dy + dz * dz));
+        }
+    }
+    domain_->allReduceMax(radius);
+
+    // (hash, cells) of each local clone; rank 0 merges clones of equal genotype
+    std::string clones_out;
+    const std::vector<int64_t>& clones = cloneCounts();
+    for (size_t id = 0; id < clones.size(); ++id) {
+        if (clones[id] > 0) {
+            const uint64_t hash = genotypes_.hash(static_cast<GenotypeTable::GenotypeId>(id));
+            clones_out.append(reinterpret_cast<const char*>(&hash), sizeof(hash));
+            clones_out.append(reinterpret_cast<const char*>(&clones[id]), sizeof(clones[id]));
+        }
+    }
+    const std::vector<std::string> all_clones = domain_->gather(std::move(clones_out));
+
+    const double h = params_.spatial_resolution();
+    const double voxels = static_cast<double>(plane) * params_.grid_size_z();
+    run_metrics_.Clear();
+    run_metrics_.set_total_cancer_cells(cancer);
+    run_metrics_.set_total_immune_cells(static_cast<int64_t>(sums[1]));
+    run_metrics_.set_total_cells(static_cast<int64_t>(sums[2]));
+    run_metrics_.set_tumor_volume(static_cast<double>(cancer) * h * h * h);
+    run_metrics_.set_tumor_radius(radius[0]);
+    run_metrics_.set_avg_oxygen(sums[6] / voxels);
+    run_metrics_.set_avg_glucose(sums[7] / voxels);
+
+    // Listed in order of first appearance, rank 0's clones first
+    std::vector<std::pair<uint64_t, int64_t>> merged;
+    std::unordered_map<uint64_t, size_t> slot;
+    constexpr size_t kEntryBytes = sizeof(uint64_t) + sizeof(int64_t);
+    for (const std::string& in : all_clones) {
+        for (size_t offset = 0; offset + kEntryBytes <= in.size(); offset += kEntryBytes) {
+            uint64_t hash;
+            int64_t cells;
+            std::memcpy(&hash, in.data() + offset, sizeof(hash));
+            std::memcpy(&cells, in.data() + offset + sizeof(hash), sizeof(cells));
+            auto [it, added] = slot.emplace(hash, merged.size());
+            if (added) {
+                merged.emplace_back(hash, 0);
+            }
+            merged[it->second].second += cells;
+        }
+    }
+    for (const auto& [hash, cells] : merged) {
+        addSubclone(&run_metrics_, hash, cells, cancer);
+    }
+}
+
+std::shared_ptr<const SimulationSnapshot> SimulationEngine::gatherSnapshot() const {
+    std::shared_ptr<SimulationSnapshot> snapshot;
+    if (domain_->rank() == 0) {
+        snapshot = std::make_shared<SimulationSnapshot>();
+        snapshot->step = current_step_;
+        snapshot->time = currentTime();
+        snapshot->parameters = params_;
+        computeMetrics(&snapshot->metrics);
+    }
+    SimulationSnapshot* out = snapshot.get();
+
+    // The snapshot a single engine would take: dense, or BrickGrids for large lattices
+    if (sparseFields(params_)) {
+        domain_->gatherField(oxygen_, out ? &out->sparse_oxygen : nullptr, sparse_tolerance_);
+        domain_->gatherField(glucose_, out ? &out->sparse_glucose : nullptr, sparse_tolerance_);
+    } else {
+        domain_->gatherField(oxygen_, out ? &out->oxygen : nullptr);
+        domain_->gatherField(glucose_, out ? &out->glucose : nullptr);
+    }
+    domain_->gatherAgents(agents_, genotypes_, out ? &out->agents : nullptr,
+                          out ? &out->genotypes : nullptr);
+    return snapshot;
+}
+
+std::shared_ptr<const SimulationSnapshot> SimulationEngine::snapshot() const {
+    if (domain_) {
+        leadRanks(RankCommand::Snapshot);
+        return gatherSnapshot();
+    }
+    auto snapshot = std::make_shared<SimulationSnapshot>();
+    snapshot->step = current_step_;
+    snapshot->time = currentTime();
+    snapshot->parameters = params_;
+    computeMetrics(&snapshot->metrics);
+    if (sparse_ && resident_fields_current_) {
+        snapshot->sparse_oxygen = sparse_oxygen_;
+        snapshot->sparse_glucose = sparse_glucose_;
+    } else {
+        snapshot->oxygen = oxygen();
+        snapshot->glucose = glucose();
+    }
+    drugs_.totalField(&snapshot->drug, &snapshot->sparse_drug);
+    snapshot->agents = agents_;
+    snapshot->genotypes = genotypes_;
+    return snapshot;
+}
+
+} // namespace tumordtwin
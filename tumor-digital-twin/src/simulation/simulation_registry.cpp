@@ -0,0 +1,453 @@
+#include "simulation/simulation_registry.h"
+#include "simulation/simulation_snapshot.h"
+#include <algorithm>
+#include <chrono>
+#include <functional>
+
+namespace tumordtwin {
+
+namespace {
+
+int64_t nowSeconds() {
+    return std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+int64_t nowMillis() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// Treap priority: a mix of the sequence keeps the tree balanced in expectation
+uint64_t mixSequence(uint64_t x) {
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+bool isTerminalStatus(SimulationStatus status) {
+    return status == SimulationStatus::COMPLETED ||
+           status == SimulationStatus::FAILED ||
+           status == SimulationStatus::STOPPED;
+}
+
+} // namespace
+
+// ============================================================================
+// SimulationRecord Implementation
+// ============================================================================
+
+SimulationRecord::SimulationRecord(std::string simulation_id,
+                                   std::string patient_id,
+                                   std::string simulation_name,
+                                   int32_t total_steps,
+                                   int64_t created_at)
+    : simulation_id_(std::move(simulation_id)),
+      patient_id_(std::move(patient_id)),
+      simulation_name_(std::move(simulation_name)),
+      total_steps_(total_steps),
+      created_at_(created_at),
+      updated_at_(created_at),
+      message_("Simulation is queued") {
+}
+
+double SimulationRecord::progressPercentage() const {
+    if (total_steps_ <= 0) {
+        return 0.0;
+    }
+    return 100.0 * static_cast<double>(currentStep()) / static_cast<double>(total_steps_);
+}
+
+int64_t SimulationRecord::estimatedTimeRemaining() const {
+    SimulationStatus s = status();
+    if (isTerminalStatus(s)) {
+        return 0;
+    }
+
+    int64_t started = started_at_ms_.load(std::memory_order_relaxed);
+    int32_t done = currentStep();
+    if (s != SimulationStatus::RUNNING || started == 0 || done <= 0) {
+        return -1;
+    }
+
+    double elapsed_ms = static_cast<double>(nowMillis() - started);
+    double ms_per_step = elapsed_ms / static_cast<double>(done);
+    return static_cast<int64_t>(ms_per_step * (total_steps_ - done) / 1000.0);
+}
+
+std::string SimulationRecord::message() const {
+    std::lock_guard<std::mutex> lock(message_mutex_);
+    return message_;
+}
+
+void SimulationRecord::setProgress(int32_t current_step) {
+    current_step_.store(current_step, std::memory_order_relaxed);
+    updated_at_.store(nowSeconds(), std::memory_order_relaxed);
+    notifyChange();
+}
+
+void SimulationRecord::setMetrics(const SimulationMetrics& metrics) {
+    {
+        std::lock_guard<std::mutex> lock(metrics_mutex_);
+        metrics_ = metrics;
+        has_metrics_ = true;
+    }
+    notifyChange();
+}
+
+void SimulationRecord::notifyChange() {
+    version_.fetch_add(1, std::memory_order_acq_rel);
+    if (hasWatchers()) {
+        // Taking the mutex orders the bump before a watcher's predicate check
+        { std::lock_guard<std::mutex> lock(watch_mutex_); }
+        watch_cv_.notify_all();
+    }
+}
+
+bool SimulationRecord::waitForChange(uint64_t seen, std::chrono::milliseconds timeout) const {
+    std::unique_lock<std::mutex> lock(watch_mutex_);
+    return watch_cv_.wait_for(lock, timeout, [&] { return version() != seen; });
+}
+
+void SimulationRecord::setSnapshot(std::shared_ptr<const SimulationSnapshot> snapshot) {
+    // Status readers see the metrics of the state results are served from
+    if (snapshot) {
+        setMetrics(snapshot->metrics);
+    }
+    std::lock_guard<std::mutex> lock(snapshot_mutex_);
+    results_step_.store(snapshot ? snapshot->step : -1, std::memory_order_release);
+    snapshot_ = std::move(snapshot);
+}
+
+void SimulationRecord::releaseSnapshot() {
+    std::shared_ptr<const SimulationSnapshot> released;
+    std::lock_guard<std::mutex> lock(snapshot_mutex_);
+    released.swap(snapshot_);
+}
+
+bool SimulationRecord::resultMetrics(SimulationMetrics* metrics) const {
+    if (resultsStep() < 0) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(metrics_mutex_);
+    *metrics = metrics_;
+    return true;
+}
+
+std::shared_ptr<const SimulationSnapshot> SimulationRecord::snapshot() const {
+    std::lock_guard<std::mutex> lock(snapshot_mutex_);
+    return snapshot_;
+}
+
+void SimulationRecord::setHistory(std::shared_ptr<const StepHistory> history) {
+    std::lock_guard<std::mutex> lock(snapshot_mutex_);
+    history_ = std::move(history);
+}
+
+std::shared_ptr<const StepHistory> SimulationRecord::history() const {
+    std::lock_guard<std::mutex> lock(snapshot_mutex_);
+    return history_;
+}
+
+void SimulationRecord::setStatus(SimulationStatus status, const std::string& message) {
+    if (status == SimulationStatus::RUNNING) {
+        started_at_ms_.store(nowMillis(), std::memory_order_relaxed);
+    }
+    {
+        std::lock_guard<std::mutex> lock(message_mutex_);
+        message_ = message;
+    }
+    updated_at_.store(nowSeconds(), std::memory_order_relaxed);
+    status_.store(status, std::memory_order_release);
+    notifyChange();
+}
+
+bool SimulationRecord::isTerminal() const {
+    return isTerminalStatus(status());
+}
+
+void SimulationRecord::toStatusResponse(StatusResponse* response) const {
+    response->set_simulation_id(simulation_id_);
+    response->set_status(status());
+    response->set_current_step(currentStep());
+    response->set_total_steps(total_steps_);
+    response->set_progress_percentage(progressPercentage());
+    response->set_estimated_time_remaining(estimatedTimeRemaining());
+    response->set_message(message());
+
+    std::lock_guard<std::mutex> lock(metrics_mutex_);
+    if (has_metrics_) {
+        *response->mutable_current_metrics() = metrics_;
+    }
+}
+
+void SimulationRecord::toSummary(SimulationSummary* summary) const {
+    summary->set_simulation_id(simulation_id_);
+    summary->set_patient_id(patient_id_);
+    summary->set_simulation_name(simulation_name_);
+    summary->set_status(status());
+    summary->set_created_at(created_at_);
+    summary->set_updated_at(updatedAt());
+    summary->set_current_step(currentStep());
+    summary->set_total_steps(total_steps_);
+    summary->set_progress_percentage(progressPercentage());
+}
+
+// ============================================================================
+// SimulationRegistry::OrderedIndex Implementation
+// ============================================================================
+
+void SimulationRegistry::OrderedIndex::split(NodePtr node, uint64_t sequence,
+                                             NodePtr& less, NodePtr& rest) {
+    if (!node) {
+        less.reset();
+        rest.reset();
+        return;
+    }
+    if (node->sequence < sequence) {
+        NodePtr right = std::move(node->right);
+        split(std::move(right), sequence, node->right, rest);
+        update(*node);
+        less = std::move(node);
+    } else {
+        NodePtr left = std::move(node->left);
+        split(std::move(left), sequence, less, node->left);
+        update(*node);
+        rest = std::move(node);
+    }
+}
+
+SimulationRegistry::OrderedIndex::NodePtr SimulationRegistry::OrderedIndex::merge(
+    NodePtr left, NodePtr right) {
+    if (!left || !right) {
+        return left ? std::move(left) : std::move(right);
+    }
+    if (left->priority > right->priority) {
+        left->right = merge(std::move(left->right), std::move(right));
+        update(*left);
+        return left;
+    }
+    right->left = merge(std::move(left), std::move(right->left));
+    update(*right);
+    return right;
+}
+
+void SimulationRegistry::OrderedIndex::insert(uint64_t sequence,
+                                              std::shared_ptr<SimulationRecord> record) {
+    auto node = std::make_unique<Node>();
+    node->sequence = sequence;
+    node->priority = mixSequence(sequence);
+    node->record = std::move(record);
+
+    NodePtr less;
+    NodePtr rest;
+    split(std::move(root_), sequence, less, rest);
+    root_ = merge(merge(std::move(less), std::move(node)), std::move(rest));
+}
+
+std::shared_ptr<SimulationRecord> SimulationRegistry::OrderedIndex::erase(uint64_t sequence) {
+    NodePtr less;
+    NodePtr rest;
+    NodePtr match;
+    NodePtr greater;
+    split(std::move(root_), sequence, less, rest);
+    split(std::move(rest), sequence + 1, match, greater);
+    root_ = merge(std::move(less), std::move(greater));
+    return match ? std::move(match->record) : nullptr;
+}
+
+// ============================================================================
+// SimulationRegistry Implementation
+// ============================================================================
+
+SimulationRegistry::Shard& SimulationRegistry::shardFor(const std::string& simulation_id) {
+    return shards_[std::hash<std::string>{}(simulation_id) % kNumShards];
+}
+
+const SimulationRegistry::Shard& SimulationRegistry::shardFor(
+    const std::string& simulation_id) const {
+    return shards_[std::hash<std::string>{}(simulation_id) % kNumShards];
+}
+
+void SimulationRegistry::setRetention(size_t max_finished, std::chrono::seconds ttl) {
+    std::unique_lock<std::shared_mutex> lock(index_mutex_);
+    max_finished_ = max_finished;
+    finished_ttl_ = ttl;
+    evictFinished(std::chrono::steady_clock::now());
+}
+
+bool SimulationRegistry::insert(const std::shared_ptr<SimulationRecord>& record) {
+    Shard& shard = shardFor(record->simulationId());
+
+    // The record gets its sequence before it is published in the shard, and
+    // erase()/updateStatus() wait on the index lock until it is indexed.
+    // The only nested locking: index, then shard.
+    std::unique_lock<std::shared_mutex> lock(index_mutex_);
+    record->sequence_ = next_sequence_++;
+    {
+        std::unique_lock<std::shared_mutex> shard_lock(shard.mutex);
+        if (!shard.records.emplace(record->simulationId(), record).second) {
+            return false;
+        }
+    }
+    all_.insert(record->sequence_, record);
+    by_patient_[record->patientId()].insert(record->sequence_, record);
+    by_status_[record->status()].insert(record->sequence_, record);
+    evictFinished(std::chrono::steady_clock::now());
+    return true;
+}
+
+void SimulationRegistry::erase(const std::string& simulation_id) {
+    std::shared_ptr<SimulationRecord> record;
+    Shard& shard = shardFor(simulation_id);
+    {
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        auto it = shard.records.find(simulation_id);
+        if (it == shard.records.end()) {
+            return;
+        }
+        record = std::move(it->second);
+        shard.records.erase(it);
+    }
+
+    std::unique_lock<std::shared_mutex> lock(index_mutex_);
+    unindex(*record);
+}
+
+void SimulationRegistry::unindex(const SimulationRecord& record) {
+    all_.erase(record.sequence_);
+    by_status_[record.status()].erase(record.sequence_);
+    auto patient = by_patient_.find(record.patientId());
+    if (patient != by_patient_.end()) {
+        patient->second.erase(record.sequence_);
+        if (patient->second.empty()) {
+            by_patient_.erase(patient);
+        }
+    }
+}
+
+void SimulationRegistry::evictFinished(std::chrono::steady_clock::time_point now) {
+    auto finishedCount = [this] {
+        return by_status_[SimulationStatus::COMPLETED].size() +
+               by_status_[SimulationStatus::FAILED].size() +
+               by_status_[SimulationStatus::STOPPED].size();
+    };
+    while (!finished_.empty() &&
+           (finishedCount() > max_finished_ ||
+            (finished_ttl_.count() > 0 && now - finished_.front().at > finished_ttl_))) {
+        const uint64_t sequence = finished_.front().sequence;
+        finished_.pop_front();
+        std::shared_ptr<SimulationRecord> record = all_.erase(sequence);
+        if (!record) {
+            continue;  // Erased already
+        }
+        {
+            Shard& shard = shardFor(record->simulationId());
+            std::unique_lock<std::shared_mutex> shard_lock(shard.mutex);
+            auto it = shard.records.find(record->simulationId());
+            if (it != shard.records.end() && it->second == record) {
+                shard.records.erase(it);
+            }
+        }
+        unindex(*record);
+    }
+}
+
+std::shared_ptr<SimulationRecord> SimulationRegistry::find(
+    const std::string& simulation_id) const {
+    const Shard& shard = shardFor(simulation_id);
+    std::shared_lock<std::shared_mutex> lock(shard.mutex);
+    auto it = shard.records.find(simulation_id);
+    return it != shard.records.end() ? it->second : nullptr;
+}
+
+bool SimulationRegistry::updateStatus(SimulationRecord& record,
+                                      SimulationStatus status,
+                                      const std::string& message) {
+    std::unique_lock<std::shared_mutex> lock(index_mutex_);
+
+    SimulationStatus previous = record.status();
+    if (isTerminalStatus(previous)) {
+        return false;
+    }
+
+    if (previous != status) {
+        auto indexed = by_status_[previous].erase(record.sequence_);
+        if (indexed) {
+            by_status_[status].insert(record.sequence_, std::move(indexed));
+        }
+    }
+    record.setStatus(status, message);
+    if (isTerminalStatus(status)) {
+        const auto now = std::chrono::steady_clock::now();
+        finished_.push_back({now, record.sequence_});
+        evictFinished(now);
+    }
+    return true;
+}
+
+std::vector<std::shared_ptr<SimulationRecord>> SimulationRegistry::list(
+    const std::string& patient_id,
+    SimulationStatus status,
+    size_t offset,
+    size_t limit,
+    size_t& total_count) const {
+
+    std::vector<std::shared_ptr<SimulationRecord>> result;
+    std::shared_lock<std::shared_mutex> lock(index_mutex_);
+
+    const bool by_patient = !patient_id.empty();
+    const bool by_status = status != SimulationStatus::SIMULATION_STATUS_UNSPECIFIED;
+
+    static const OrderedIndex kEmpty;
+    const OrderedIndex* patient_index = &all_;
+    if (by_patient) {
+        auto it = by_patient_.find(patient_id);
+        patient_index = it != by_patient_.end() ? &it->second : &kEmpty;
+    }
+    const OrderedIndex* status_index =
+        by_status && status >= 0 && static_cast<size_t>(status) < kNumStatuses
+            ? &by_status_[status] : (by_status ? &kEmpty : &all_);
+
+    // Walk the most selective index; only a combined filter needs a check per entry
+    const OrderedIndex* index = patient_index->size() <= status_index->size()
+        ? patient_index : status_index;
+    const bool filter_patient = by_patient && index != patient_index;
+    const bool filter_status = by_status && index != status_index;
+
+    if (!filter_patient && !filter_status) {
+        total_count = index->size();
+        if (limit == 0) {
+            return result;
+        }
+        index->forEachFrom(offset, [&](const std::shared_ptr<SimulationRecord>& record) {
+            result.push_back(record);
+            return result.size() < limit;
+        });
+        return result;
+    }
+
+    total_count = 0;
+    index->forEachFrom(0, [&](const std::shared_ptr<SimulationRecord>& record) {
+        if (filter_patient && record->patientId() != patient_id) {
+            return true;
+        }
+        if (filter_status && record->status() != status) {
+            return true;
+        }
+        if (total_count >= offset && result.size() < limit) {
+            result.push_back(record);
+        }
+        ++total_count;
+        return true;
+    });
+    return result;
+}
+
+size_t SimulationRegistry::size() const {
+    std::shared_lock<std::shared_mutex> lock(index_mutex_);
+    return all_.size();
+}
+
+} // namespace tumordtwin
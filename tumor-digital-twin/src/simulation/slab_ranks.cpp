@@ -0,0 +1,175 @@
+#include "simulation/slab_ranks.h"
+#include <algorithm>
+#include <cstdint>
+
+namespace tumordtwin {
+
+namespace {
+
+// The MPI job attached by attachMpi(), shared by every run of this process
+struct MpiJob {
+    bool attached = false;
+    int size = 0;
+    std::mutex mutex;  // Held by the run using the MPI ranks
+};
+
+MpiJob& mpiJob() {
+    static MpiJob job;
+    return job;
+}
+
+#ifdef TUMORDTWIN_HAVE_MPI
+// Rank 0's string on every rank of comm
+void broadcastString(std::string* data, MPI_Comm comm) {
+    uint64_t size = data->size();
+    MPI_Bcast(&size, 1, MPI_UINT64_T, 0, comm);
+    data->resize(size);
+    MPI_Bcast(data->data(), static_cast<int>(size), MPI_BYTE, 0, comm);
+}
+#endif
+
+} // namespace
+
+// ============================================================================
+// SlabRanks Implementation
+// ============================================================================
+
+SlabRanks::SlabRanks(const SimulationParameters& params, int num_threads) {
+    const int num_ranks = std::max(1, params.num_mpi_ranks());
+    MpiJob& job = mpiJob();
+    mpi_ = job.attached && job.size >= num_ranks;
+
+#ifdef TUMORDTWIN_HAVE_MPI
+    if (mpi_) {
+        // Ranks not in this run wait for the next one in serveMpiRank()
+        mpi_lock_ = std::unique_lock<std::mutex>(job.mutex);
+        std::string header = params.SerializeAsString();
+        broadcastString(&header, MPI_COMM_WORLD);
+        MPI_Comm_split(MPI_COMM_WORLD, 0, 0, &comm_);
+        mpi_transport_ = std::make_unique<MpiSlabTransport>(comm_);
+        engine_ = std::make_unique<SimulationEngine>(params, num_threads);
+        engine_->attachDomain(*mpi_transport_);
+        return;
+    }
+#endif
+
+    // Each in-process rank gets its share of the threads
+    const int rank_threads = num_threads > 0 ? std::max(1, num_threads / num_ranks) : 0;
+    fabric_ = std::make_unique<LocalSlabFabric>(num_ranks);
+    for (int rank = 1; rank < num_ranks; ++rank) {
+        followers_.emplace_back([this, params, rank, rank_threads] {
+            SimulationEngine follower(params, rank_threads);
+            follower.attachDomain(fabric_->transport(rank));
+            follower.followRank0();
+        });
+    }
+    engine_ = std::make_unique<SimulationEngine>(params, rank_threads);
+    engine_->attachDomain(fabric_->transport(0));
+}
+
+SlabRanks::~SlabRanks() {
+    engine_->releaseRanks();
+    for (std::thread& follower : followers_) {
+        follower.join();
+    }
+    engine_.reset();
+#ifdef TUMORDTWIN_HAVE_MPI
+    if (mpi_) {
+        mpi_transport_.reset();
+        MPI_Comm_free(&comm_);
+    }
+#endif
+}
+
+bool SlabRanks::fits(const SimulationParameters& params, std::string& error_msg) {
+    const int num_ranks = std::max(1, params.num_mpi_ranks());
+    if (num_ranks <= mpiRanks()) {
+        return true;  // Each slab was checked against the limit by the validator
+    }
+    const int64_t voxels = static_cast<int64_t>(params.grid_size_x()) * params.grid_size_y() *
+                           params.grid_size_z();
+    if (voxels > SimulationEngine::kMaxVoxelsPerProcess) {
+        error_msg = "Grid of " + std::to_string(voxels) + " voxels needs " +
+                    std::to_string(num_ranks) + " MPI ranks, and this server has " +
+                    std::to_string(mpiRanks()) + "; ranks run in one process hold at most " +
+                    std::to_string(SimulationEngine::kMaxVoxelsPerProcess) + " voxels";
+        return false;
+    }
+    return true;
+}
+
+int SlabRanks::mpiRanks() {
+    const MpiJob& job = mpiJob();
+    return job.attached ? job.size : 0;
+}
+
+bool SlabRanks::attachMpi(int* argc, char*** argv, int* rank, std::string& error_msg) {
+#ifdef TUMORDTWIN_HAVE_MPI
+    // Rank 0 calls MPI from whichever worker runs the simulation, one at a time
+    int provided = 0;
+    MPI_Init_thread(argc, argv, MPI_THREAD_SERIALIZED, &provided);
+    if (provided < MPI_THREAD_SERIALIZED) {
+        MPI_Finalize();
+        error_msg = "MPI library does not support MPI_THREAD_SERIALIZED";
+        return false;
+    }
+    MpiJob& job = mpiJob();
+    MPI_Comm_rank(MPI_COMM_WORLD, rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &job.size);
+    job.attached = true;
+    return true;
+#else
+    (void)argc;
+    (void)argv;
+    (void)rank;
+    error_msg = "This build has no MPI support (TUMORDTWIN_ENABLE_MPI)";
+    return false;
+#endif
+}
+
+void SlabRanks::serveMpiRank() {
+#ifdef TUMORDTWIN_HAVE_MPI
+    int rank = 0;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    while (true) {
+        // The parameters of rank 0's next run; empty once it detaches
+        std::string header;
+        broadcastString(&header, MPI_COMM_WORLD);
+        SimulationParameters params;
+        if (header.empty() || !params.ParseFromString(header)) {
+            break;
+        }
+        MPI_Comm comm = MPI_COMM_NULL;
+        MPI_Comm_split(MPI_COMM_WORLD, rank < params.num_mpi_ranks() ? 0 : MPI_UNDEFINED, rank,
+                       &comm);
+        if (comm == MPI_COMM_NULL) {
+            continue;
+        }
+        {
+            MpiSlabTransport transport(comm);
+            SimulationEngine engine(params);
+            engine.attachDomain(transport);
+            engine.followRank0();
+        }
+        MPI_Comm_free(&comm);
+    }
+    mpiJob().attached = false;
+    MPI_Finalize();
+#endif
+}
+
+void SlabRanks::detachMpi() {
+#ifdef TUMORDTWIN_HAVE_MPI
+    MpiJob& job = mpiJob();
+    std::lock_guard<std::mutex> lock(job.mutex);
+    if (!job.attached) {
+        return;
+    }
+    std::string header;
+    broadcastString(&header, MPI_COMM_WORLD);
+    job.attached = false;
+    MPI_Finalize();
+#endif
+}
+
+} // namespace tumordtwin
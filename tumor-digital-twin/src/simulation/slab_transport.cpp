@@ -0,0 +1,201 @@
+#include "simulation/slab_transport.h"
+#include "simulation/domain_decomposition.h"
+#include <algorithm>
+#include <cstring>
+
+namespace tumordtwin {
+
+namespace {
+
+// Message tags; halo planes are named after the direction they travel
+constexpr int kTagHaloUp = 1;
+constexpr int kTagHaloDown = 2;
+constexpr int kTagExchange = 3;
+
+size_t planeSize(const ScalarGrid& field) {
+    return static_cast<size_t>(field.nx()) * static_cast<size_t>(field.ny());
+}
+
+} // namespace
+
+// ============================================================================
+// LocalSlabFabric Implementation
+// ============================================================================
+
+class LocalSlabFabric::Endpoint : public SlabTransport {
+public:
+    Endpoint(LocalSlabFabric& fabric, int rank) : fabric_(fabric), rank_(rank) {}
+
+    int rank() const override { return rank_; }
+    int numRanks() const override { return fabric_.numRanks(); }
+
+    void startHaloExchange(ScalarGrid& field, const SlabExtent& extent) override {
+        const size_t plane = planeSize(field);
+        auto planeBytes = [&](int local_k) {
+            const char* data = reinterpret_cast<const char*>(field.data() + local_k * plane);
+            return std::string(data, plane * sizeof(double));
+        };
+        const int first = extent.firstOwnedLocal();
+        if (extent.ghost_below) {
+            fabric_.send(rank_, rank_ - 1, kTagHaloDown, planeBytes(first));
+        }
+        if (extent.ghost_above) {
+            fabric_.send(rank_, rank_ + 1, kTagHaloUp, planeBytes(first + extent.ownedPlanes() - 1));
+        }
+        pending_field_ = &field;
+        pending_extent_ = extent;
+    }
+
+    void finishHaloExchange() override {
+        if (!pending_field_) {
+            return;
+        }
+        ScalarGrid& field = *pending_field_;
+        const size_t plane = planeSize(field);
+        auto receivePlane = [&](int source, int tag, int local_k) {
+            const std::string data = fabric_.receive(source, rank_, tag);
+            std::memcpy(field.data() + local_k * plane, data.data(),
+                        std::min(data.size(), plane * sizeof(double)));
+        };
+        if (pending_extent_.ghost_below) {
+            receivePlane(rank_ - 1, kTagHaloUp, 0);
+        }
+        if (pending_extent_.ghost_above) {
+            receivePlane(rank_ + 1, kTagHaloDown, pending_extent_.localPlanes() - 1);
+        }
+        pending_field_ = nullptr;
+    }
+
+    std::vector<std::string> exchange(std::vector<std::string> outgoing) override {
+        const int n = numRanks();
+        outgoing.resize(n);
+        std::vector<std::string> incoming(n);
+        for (int dest = 0; dest < n; ++dest) {
+            if (dest != rank_) {
+                fabric_.send(rank_, dest, kTagExchange, std::move(outgoing[dest]));
+            }
+        }
+        incoming[rank_] = std::move(outgoing[rank_]);
+        for (int source = 0; source < n; ++source) {
+            if (source != rank_) {
+                incoming[source] = fabric_.receive(source, rank_, kTagExchange);
+            }
+        }
+        return incoming;
+    }
+
+private:
+    LocalSlabFabric& fabric_;
+    const int rank_;
+    ScalarGrid* pending_field_ = nullptr;
+    SlabExtent pending_extent_;
+};
+
+LocalSlabFabric::LocalSlabFabric(int num_ranks) {
+    for (int rank = 0; rank < num_ranks; ++rank) {
+        endpoints_.push_back(std::make_unique<Endpoint>(*this, rank));
+    }
+}
+
+LocalSlabFabric::~LocalSlabFabric() = default;
+
+SlabTransport& LocalSlabFabric::transport(int rank) {
+    return *endpoints_[rank];
+}
+
+void LocalSlabFabric::send(int source, int dest, int tag, std::string data) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        mailboxes_[{source, dest, tag}].push_back(std::move(data));
+    }
+    cv_.notify_all();
+}
+
+std::string LocalSlabFabric::receive(int source, int dest, int tag) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto& mailbox = mailboxes_[{source, dest, tag}];
+    cv_.wait(lock, [&] { return !mailbox.empty(); });
+    std::string data = std::move(mailbox.front());
+    mailbox.pop_front();
+    return data;
+}
+
+#ifdef TUMORDTWIN_HAVE_MPI
+// ============================================================================
+// MpiSlabTransport Implementation
+// ============================================================================
+
+MpiSlabTransport::MpiSlabTransport(MPI_Comm comm)
+    : comm_(comm) {
+    MPI_Comm_rank(comm_, &rank_);
+    MPI_Comm_size(comm_, &size_);
+}
+
+void MpiSlabTransport::startHaloExchange(ScalarGrid& field, const SlabExtent& extent) {
+    const int plane = static_cast<int>(planeSize(field));
+    const int first = extent.firstOwnedLocal();
+    const int last = first + extent.ownedPlanes() - 1;
+    requests_.clear();
+    requests_.reserve(4);
+
+    auto post = [&](bool receive, int local_k, int peer, int tag) {
+        MPI_Request request;
+        double* data = field.data() + static_cast<size_t>(local_k) * static_cast<size_t>(plane);
+        if (receive) {
+            MPI_Irecv(data, plane, MPI_DOUBLE, peer, tag, comm_, &request);
+        } else {
+            MPI_Isend(data, plane, MPI_DOUBLE, peer, tag, comm_, &request);
+        }
+        requests_.push_back(request);
+    };
+    if (extent.ghost_below) {
+        post(true, 0, rank_ - 1, kTagHaloUp);
+        post(false, first, rank_ - 1, kTagHaloDown);
+    }
+    if (extent.ghost_above) {
+        post(true, extent.localPlanes() - 1, rank_ + 1, kTagHaloDown);
+        post(false, last, rank_ + 1, kTagHaloUp);
+    }
+}
+
+void MpiSlabTransport::finishHaloExchange() {
+    if (!requests_.empty()) {
+        MPI_Waitall(static_cast<int>(requests_.size()), requests_.data(), MPI_STATUSES_IGNORE);
+        requests_.clear();
+    }
+}
+
+std::vector<std::string> MpiSlabTransport::exchange(std::vector<std::string> outgoing) {
+    outgoing.resize(size_);
+    std::vector<int> send_counts(size_);
+    std::vector<int> send_offsets(size_);
+    std::string send_buffer;
+    for (int r = 0; r < size_; ++r) {
+        send_offsets[r] = static_cast<int>(send_buffer.size());
+        send_counts[r] = static_cast<int>(outgoing[r].size());
+        send_buffer += outgoing[r];
+    }
+
+    std::vector<int> receive_counts(size_);
+    MPI_Alltoall(send_counts.data(), 1, MPI_INT, receive_counts.data(), 1, MPI_INT, comm_);
+    std::vector<int> receive_offsets(size_);
+    int total = 0;
+    for (int r = 0; r < size_; ++r) {
+        receive_offsets[r] = total;
+        total += receive_counts[r];
+    }
+
+    std::string receive_buffer(static_cast<size_t>(total), '\0');
+    MPI_Alltoallv(send_buffer.data(), send_counts.data(), send_offsets.data(), MPI_BYTE,
+                  receive_buffer.data(), receive_counts.data(), receive_offsets.data(), MPI_BYTE,
+                  comm_);
+
+    std::vector<std::string> incoming(size_);
+    for (int r = 0; r < size_; ++r) {
+        incoming[r] = receive_buffer.substr(receive_offsets[r], receive_counts[r]);
+    }
+    return incoming;
+}
+#endif
+
+} // namespace tumordtwin
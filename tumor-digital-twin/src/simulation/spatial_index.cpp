@@ -0,0 +1,190 @@
+#include "simulation/spatial_index.h"
+
+namespace tumordtwin {
+
+namespace {
+
+constexpr size_t kMinTableSize = 1024;
+
+// Keep at least two slots per agent so chains stay short
+size_t tableSizeFor(size_t population) {
+    size_t size = kMinTableSize;
+    while (size < 2 * population) {
+        size *= 2;
+    }
+    return size;
+}
+
+} // namespace
+
+// ============================================================================
+// SpatialIndex Implementation
+// ============================================================================
+
+void SpatialIndex::reset(int nx, int ny, int nz, double spacing) {
+    nx_ = std::max(nx, 1);
+    ny_ = std::max(ny, 1);
+    nz_ = std::max(nz, 1);
+    inv_spacing_ = 1.0 / spacing;
+
+    head_.assign(kMinTableSize, kNone);
+    mask_ = kMinTableSize - 1;
+    next_.clear();
+    prev_.clear();
+    voxel_.clear();
+}
+
+size_t SpatialIndex::slotFor(int64_t key) const {
+    // Fibonacci hashing spreads neighbouring voxels across the table
+    const uint64_t hash = static_cast<uint64_t>(key) * 0x9E3779B97F4A7C15ULL;
+    return static_cast<size_t>(hash >> 32) & mask_;
+}
+
+int64_t SpatialIndex::voxelKey(double x, double y, double z) const {
+    const int i = std::clamp(static_cast<int>(std::floor(x * inv_spacing_)), 0, nx_ - 1);
+    const int j = std::clamp(static_cast<int>(std::floor(y * inv_spacing_)), 0, ny_ - 1);
+    const int k = std::clamp(static_cast<int>(std::floor(z * inv_spacing_)), 0, nz_ - 1);
+    return (static_cast<int64_t>(k) * ny_ + j) * nx_ + i;
+}
+
+void SpatialIndex::link(int32_t index, int64_t key) {
+    int32_t& head = head_[slotFor(key)];
+    voxel_[index] = key;
+    prev_[index] = kNone;
+    next_[index] = head;
+    if (head != kNone) {
+        prev_[head] = index;
+    }
+    head = index;
+}
+
+void SpatialIndex::unlink(int32_t index) {
+    const int32_t prev = prev_[index];
+    const int32_t next = next_[index];
+    if (prev != kNone) {
+        next_[prev] = next;
+    } else {
+        head_[slotFor(voxel_[index])] = next;
+    }
+    if (next != kNone) {
+        prev_[next] = prev;
+    }
+}
+
+void SpatialIndex::growTable(size_t population) {
+    const size_t size = tableSizeFor(population);
+    head_.assign(size, kNone);
+    mask_ = size - 1;
+}
+
+void SpatialIndex::rebuild(const AgentStore& agents) {
+    const size_t n = agents.size();
+    growTable(n);
+    next_.resize(n);
+    prev_.resize(n);
+    voxel_.resize(n);
+
+    const auto& x = agents.x();
+    const auto& y = agents.y();
+    const auto& z = agents.z();
+    for (size_t a = 0; a < n; ++a) {
+        link(static_cast<int32_t>(a), voxelKey(x[a], y[a], z[a]));
+    }
+}
+
+void SpatialIndex::update(const AgentStore& agents) {
+    const size_t n = agents.size();
+    // Shrinking behind our back means removals were not mirrored
+    if (n < voxel_.size() || 2 * n > head_.size()) {
+        rebuild(agents);
+        return;
+    }
+
+    const auto& x = agents.x();
+    const auto& y = agents.y();
+    const auto& z = agents.z();
+    const size_t tracked = voxel_.size();
+
+    for (size_t a = 0; a < tracked; ++a) {
+        const int64_t key = voxelKey(x[a], y[a], z[a]);
+        if (key != voxel_[a]) {
+            unlink(static_cast<int32_t>(a));
+            link(static_cast<int32_t>(a), key);
+        }
+    }
+
+    insertAppended(agents);
+}
+
+void SpatialIndex::insertAppended(const AgentStore& agents) {
+    const size_t n = agents.size();
+    const size_t tracked = voxel_.size();
+    if (n <= tracked) {
+        return;
+    }
+    if (2 * n > head_.size()) {
+        rebuild(agents);
+        return;
+    }
+
+    const auto& x = agents.x();
+    const auto& y = agents.y();
+    const auto& z = agents.z();
+    next_.resize(n);
+    prev_.resize(n);
+    voxel_.resize(n);
+    for (size_t a = tracked; a < n; ++a) {
+        link(static_cast<int32_t>(a), voxelKey(x[a], y[a], z[a]));
+    }
+}
+
+void SpatialIndex::relocate(size_t index, double x, double y, double z) {
+    const int64_t key = voxelKey(x, y, z);
+    const auto a = static_cast<int32_t>(index);
+    if (key != voxel_[a]) {
+        unlink(a);
+        link(a, key);
+    }
+}
+
+void SpatialIndex::remove(size_t index) {
+    const auto removed = static_cast<int32_t>(index);
+    const auto last = static_cast<int32_t>(voxel_.size() - 1);
+
+    unlink(removed);
+    if (removed != last) {
+        // Relabel the last agent as `removed`, keeping its list position
+        const int32_t prev = prev_[last];
+        const int32_t next = next_[last];
+        voxel_[removed] = voxel_[last];
+        prev_[removed] = prev;
+        next_[removed] = next;
+        if (prev != kNone) {
+            next_[prev] = removed;
+        } else {
+            head_[slotFor(voxel_[last])] = removed;
+        }
+        if (next != kNone) {
+            prev_[next] = removed;
+        }
+    }
+
+    next_.pop_back();
+    prev_.pop_back();
+    voxel_.pop_back();
+}
+
+size_t SpatialIndex::countInVoxel(int64_t key) const {
+    if (head_.empty()) {
+        return 0;
+    }
+    size_t count = 0;
+    for (int32_t a = head_[slotFor(key)]; a != kNone; a = next_[a]) {
+        if (voxel_[a] == key) {
+            ++count;
+        }
+    }
+    return count;
+}
+
+} // namespace tumordtwin
@@ -0,0 +1,804 @@
+#include "storage/checkpoint.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+#include <type_traits>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace tumordtwin {
+
+namespace {
+
+constexpr char kMagic[8] = {'T', 'D', 'T', 'C', 'K', 'P', 'T', '\0'};
+constexpr uint32_t kFormatVersion = 3;
+constexpr uint32_t kByteOrderMark = 0x01020304;
+constexpr size_t kSectionAlignment = 64;
+constexpr uint32_t kMaxSections = 32;
+
+// Granularity of dirty tracking in delta checkpoints
+constexpr int kTileEdge = 16;
+constexpr size_t kAgentsPerBlock = 1024;
+
+enum SectionKind : uint32_t {
+    kSectionMetadata = 1,
+    kSectionOxygen,
+    kSectionGlucose,
+    kSectionAgentIds,
+    kSectionAgentX,
+    kSectionAgentY,
+    kSectionAgentZ,
+    kSectionAgentTypes,
+    kSectionAgentStates,
+    kSectionAgentAges,
+    kSectionAgentPhases,
+    kSectionAgentGenotypes,
+    kSectionGenotypeTable,
+    kSectionRngState,
+    // DrugTransport::saveState(), whole in every checkpoint; absent means no drug given
+    kSectionDrugs,
+};
+
+// In deltas, the data section of a field is paired with a list of the
+// uint32 tile or block numbers it contains
+constexpr uint32_t kIndexSection = 0x100;
+
+struct SectionEntry {
+    uint32_t kind;
+    uint32_t reserved;
+    uint64_t offset;
+    uint64_t size;
+};
+
+struct FileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint64_t file_size;
+    uint64_t num_agents;
+    uint64_t next_agent_id;
+    int32_t step;
+    int32_t nx;
+    int32_t ny;
+    int32_t nz;
+    uint32_t kind;         // CheckpointKind
+    int32_t parent_step;   // Delta: step of the checkpoint it applies to
+    uint32_t section_count;
+    uint32_t reserved;
+    SectionEntry sections[kMaxSections];
+};
+
+static_assert(std::is_trivially_copyable<FileHeader>::value, "FileHeader is written verbatim");
+
+uint64_t alignUp(uint64_t value) {
+    return (value + kSectionAlignment - 1) / kSectionAlignment * kSectionAlignment;
+}
+
+// A section still to be written: borrowed bytes from the engine or an owned buffer
+struct PendingSection {
+    uint32_t kind;
+    const void* data;
+    size_t size;
+};
+
+template <typename Column>
+PendingSection columnSection(uint32_t kind, const Column& column) {
+    return {kind, column.data(), column.size() * sizeof(typename Column::value_type)};
+}
+
+// Visit every AgentStore column with its section kind
+template <typename Store, typename F>
+void forEachColumn(Store& agents, F&& f) {
+    f(kSectionAgentIds, agents.ids());
+    f(kSectionAgentX, agents.x());
+    f(kSectionAgentY, agents.y());
+    f(kSectionAgentZ, agents.z());
+    f(kSectionAgentTypes, agents.types());
+    f(kSectionAgentStates, agents.states());
+    f(kSectionAgentAges, agents.ages());
+    f(kSectionAgentPhases, agents.cyclePhases());
+    f(kSectionAgentGenotypes, agents.genotypes());
+}
+
+void appendU32(std::string* out, uint32_t value) {
+    out->append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+bool writeAll(int fd, const void* data, size_t size) {
+    const char* bytes = static_cast<const char*>(data);
+    while (size > 0) {
+        const ssize_t written = ::write(fd, bytes, size);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        bytes += written;
+        size -= static_cast<size_t>(written);
+    }
+    return true;
+}
+
+// Lay out the sections after the header, then write, sync and rename into place
+bool writeFile(const std::string& path, FileHeader& header,
+               const std::vector<PendingSection>& sections, std::string& error_msg) {
+    if (sections.size() > kMaxSections) {
+        error_msg = "Too many checkpoint sections";
+        return false;
+    }
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kFormatVersion;
+    header.byte_order = kByteOrderMark;
+    header.section_count = static_cast<uint32_t>(sections.size());
+
+    uint64_t offset = alignUp(sizeof(FileHeader));
+    for (size_t i = 0; i < sections.size(); ++i) {
+        header.sections[i] = {sections[i].kind, 0, offset, sections[i].size};
+        offset = alignUp(offset + sections[i].size);
+    }
+    header.file_size = offset;
+
+    std::error_code ec;
+    const std::filesystem::path target(path);
+    if (target.has_parent_path()) {
+        std::filesystem::create_directories(target.parent_path(), ec);
+    }
+
+    const std::string temp_path = path + ".tmp";
+    const int fd = ::open(temp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        error_msg = "Cannot create checkpoint " + temp_path + ": " + std::strerror(errno);
+        return false;
+    }
+
+    static const char kPadding[kSectionAlignment] = {};
+    bool ok = writeAll(fd, &header, sizeof(header));
+    uint64_t position = sizeof(header);
+    for (size_t i = 0; ok && i < sections.size(); ++i) {
+        ok = writeAll(fd, kPadding, header.sections[i].offset - position) &&
+             writeAll(fd, sections[i].data, sections[i].size);
+        position = header.sections[i].offset + sections[i].size;
+    }
+    ok = ok && writeAll(fd, kPadding, header.file_size - position);
+    // Data must be on disk before the rename makes it the current checkpoint
+    ok = ok && ::fsync(fd) == 0;
+    ok = (::close(fd) == 0) && ok;
+
+    if (!ok || std::rename(temp_path.c_str(), path.c_str()) != 0) {
+        error_msg = "Failed to write checkpoint " + path + ": " + std::strerror(errno);
+        std::remove(temp_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+void fillStateHeader(FileHeader& header, const SimulationEngine& engine) {
+    header.num_agents = engine.agents().size();
+    header.next_agent_id = engine.agents().nextId();
+    header.step = engine.currentStep();
+    header.nx = engine.oxygen().nx();
+    header.ny = engine.oxygen().ny();
+    header.nz = engine.oxygen().nz();
+}
+
+std::string serializeMetadata(const SimulationState& metadata) {
+    SimulationState scalars = metadata;
+    scalars.clear_agents();
+    scalars.clear_grids();
+    return scalars.SerializeAsString();
+}
+
+// Genotypes with IDs from first_id on, in ID order, each with the ID of its
+// parent clone; ID 0 is the implicit empty genotype
+std::string encodeGenotypes(const GenotypeTable& table, size_t first_id) {
+    std::string out;
+    first_id = std::max<size_t>(first_id, 1);
+    appendU32(&out, static_cast<uint32_t>(first_id));
+    appendU32(&out, static_cast<uint32_t>(table.size() > first_id ? table.size() - first_id : 0));
+    for (size_t id = first_id; id < table.size(); ++id) {
+        const auto genotype_id = static_cast<GenotypeTable::GenotypeId>(id);
+        const std::string& genotype = table.get(genotype_id);
+        appendU32(&out, table.parent(genotype_id));
+        appendU32(&out, static_cast<uint32_t>(genotype.size()));
+        out += genotype;
+    }
+    return out;
+}
+
+bool decodeGenotypes(const char* data, size_t size, GenotypeTable& table) {
+    uint32_t first_id = 0;
+    uint32_t count = 0;
+    if (size < sizeof(first_id) + sizeof(count)) {
+        return false;
+    }
+    std::memcpy(&first_id, data, sizeof(first_id));
+    std::memcpy(&count, data + sizeof(first_id), sizeof(count));
+    if (first_id != table.size()) {
+        return false;  // Not the continuation of the table we have
+    }
+    size_t offset = sizeof(first_id) + sizeof(count);
+    for (uint32_t i = 0; i < count; ++i) {
+        uint32_t parent = 0;
+        uint32_t length = 0;
+        if (size - offset < sizeof(parent) + sizeof(length)) {
+            return false;
+        }
+        std::memcpy(&parent, data + offset, sizeof(parent));
+        std::memcpy(&length, data + offset + sizeof(parent), sizeof(length));
+        offset += sizeof(parent) + sizeof(length);
+        if (size - offset < length || parent >= first_id + i) {
+            return false;
+        }
+        if (table.intern(std::string_view(data + offset, length), parent) != first_id + i) {
+            return false;  // Duplicate entry: IDs would no longer line up
+        }
+        offset += length;
+    }
+    return offset == size;
+}
+
+// ----------------------------------------------------------------------------
+// Dirty tracking
+// ----------------------------------------------------------------------------
+
+struct TileBounds {
+    int i0, i1, j0, j1, k0, k1;
+};
+
+struct TileGrid {
+    int tiles_x, tiles_y, tiles_z;
+
+    explicit TileGrid(const ScalarGrid& grid)
+        : tiles_x((grid.nx() + kTileEdge - 1) / kTileEdge),
+          tiles_y((grid.ny() + kTileEdge - 1) / kTileEdge),
+          tiles_z((grid.nz() + kTileEdge - 1) / kTileEdge) {}
+
+    size_t count() const { return static_cast<size_t>(tiles_x) * tiles_y * tiles_z; }
+
+    TileBounds bounds(const ScalarGrid& grid, size_t tile) const {
+        const int tx = static_cast<int>(tile % tiles_x);
+        const int ty = static_cast<int>((tile / tiles_x) % tiles_y);
+        const int tz = static_cast<int>(tile / (static_cast<size_t>(tiles_x) * tiles_y));
+        return {tx * kTileEdge, std::min((tx + 1) * kTileEdge, grid.nx()),
+                ty * kTileEdge, std::min((ty + 1) * kTileEdge, grid.ny()),
+                tz * kTileEdge, std::min((tz + 1) * kTileEdge, grid.nz())};
+    }
+};
+
+// Append the tiles of `current` whose bytes differ from `base`
+void diffGrid(const ScalarGrid& current, const ScalarGrid& base,
+              std::string* index, std::string* data) {
+    const TileGrid tiles(current);
+    for (size_t tile = 0; tile < tiles.count(); ++tile) {
+        const TileBounds b = tiles.bounds(current, tile);
+        const size_t row_bytes = static_cast<size_t>(b.i1 - b.i0) * sizeof(double);
+
+        bool dirty = false;
+        for (int k = b.k0; k < b.k1 && !dirty; ++k) {
+            for (int j = b.j0; j < b.j1 && !dirty; ++j) {
+                const size_t offset = current.index(b.i0, j, k);
+                dirty = std::memcmp(current.data() + offset, base.data() + offset, row_bytes) != 0;
+            }
+        }
+        if (!dirty) {
+            continue;
+        }
+
+        appendU32(index, static_cast<uint32_t>(tile));
+        for (int k = b.k0; k < b.k1; ++k) {
+            for (int j = b.j0; j < b.j1; ++j) {
+                data->append(reinterpret_cast<const char*>(current.data() + current.index(b.i0, j, k)),
+                             row_bytes);
+            }
+        }
+    }
+}
+
+bool applyGrid(ScalarGrid& grid, const char* index, size_t index_size,
+               const char* data, size_t data_size) {
+    const TileGrid tiles(grid);
+    size_t consumed = 0;
+    for (size_t n = 0; n < index_size / sizeof(uint32_t); ++n) {
+        uint32_t tile;
+        std::memcpy(&tile, index + n * sizeof(uint32_t), sizeof(tile));
+        if (tile >= tiles.count()) {
+            return false;
+        }
+        const TileBounds b = tiles.bounds(grid, tile);
+        const size_t row_bytes = static_cast<size_t>(b.i1 - b.i0) * sizeof(double);
+        for (int k = b.k0; k < b.k1; ++k) {
+            for (int j = b.j0; j < b.j1; ++j) {
+                if (data_size - consumed < row_bytes) {
+                    return false;
+                }
+                std::memcpy(grid.data() + grid.index(b.i0, j, k), data + consumed, row_bytes);
+                consumed += row_bytes;
+            }
+        }
+    }
+    return index_size % sizeof(uint32_t) == 0 && consumed == data_size;
+}
+
+// Append the blocks of a column that differ from `base` or lie beyond its end
+template <typename T>
+void diffColumn(const AlignedVector<T>& current, const AlignedVector<T>& base,
+                std::string* index, std::string* data) {
+    for (size_t begin = 0; begin < current.size(); begin += kAgentsPerBlock) {
+        const size_t end = std::min(begin + kAgentsPerBlock, current.size());
+        const bool dirty = end > base.size() ||
+            std::memcmp(current.data() + begin, base.data() + begin, (end - begin) * sizeof(T)) != 0;
+        if (dirty) {
+            appendU32(index, static_cast<uint32_t>(begin / kAgentsPerBlock));
+            data->append(reinterpret_cast<const char*>(current.data() + begin),
+                         (end - begin) * sizeof(T));
+        }
+    }
+}
+
+// `column` is already resized; blocks past parent_size must all be present
+template <typename T>
+bool applyColumn(AlignedVector<T>& column, size_t parent_size, const char* index,
+                 size_t index_size, const char* data, size_t data_size) {
+    if (index_size % sizeof(uint32_t) != 0) {
+        return false;
+    }
+    size_t consumed = 0;
+    size_t next_new_block = parent_size / kAgentsPerBlock;
+    int64_t previous = -1;
+    for (size_t n = 0; n < index_size / sizeof(uint32_t); ++n) {
+        uint32_t block;
+        std::memcpy(&block, index + n * sizeof(uint32_t), sizeof(block));
+        const size_t begin = static_cast<size_t>(block) * kAgentsPerBlock;
+        if (static_cast<int64_t>(block) <= previous || begin >= column.size()) {
+            return false;
+        }
+        previous = block;
+        if (begin + kAgentsPerBlock > parent_size) {
+            if (block != next_new_block) {
+                return false;  // A block overlapping the appended range is missing
+            }
+            ++next_new_block;
+        }
+        const size_t bytes = (std::min(begin + kAgentsPerBlock, column.size()) - begin) * sizeof(T);
+        if (data_size - consumed < bytes) {
+            return false;
+        }
+        std::memcpy(column.data() + begin, data + consumed, bytes);
+        consumed += bytes;
+    }
+    const size_t required_blocks = column.size() > parent_size
+        ? (column.size() + kAgentsPerBlock - 1) / kAgentsPerBlock
+        : 0;
+    return consumed == data_size && next_new_block >= required_blocks;
+}
+
+} // namespace
+
+// ============================================================================
+// CheckpointBaseline Implementation
+// ============================================================================
+
+void CheckpointBaseline::capture(const SimulationEngine& engine) {
+    step = engine.currentStep();
+    oxygen = engine.oxygen();
+    glucose = engine.glucose();
+    agents = engine.agents();
+    num_genotypes = engine.genotypes().size();
+}
+
+// ============================================================================
+// CheckpointWriter Implementation
+// ============================================================================
+
+bool CheckpointWriter::write(const std::string& path, const SimulationState& metadata,
+                             const SimulationEngine& engine, std::string& error_msg) {
+    const std::string metadata_bytes = serializeMetadata(metadata);
+    const std::string genotype_bytes = encodeGenotypes(engine.genotypes(), 1);
+    const std::string rng_bytes = engine.rngState();
+    const std::string drug_bytes = engine.drugs().saveState();
+
+    std::vector<PendingSection> sections = {
+        {kSectionMetadata, metadata_bytes.data(), metadata_bytes.size()},
+        {kSectionOxygen, engine.oxygen().data(), engine.oxygen().size() * sizeof(double)},
+        {kSectionGlucose, engine.glucose().data(), engine.glucose().size() * sizeof(double)},
+    };
+    forEachColumn(engine.agents(), [&](uint32_t kind, const auto& column) {
+        sections.push_back(columnSection(kind, column));
+    });
+    sections.push_back({kSectionGenotypeTable, genotype_bytes.data(), genotype_bytes.size()});
+    sections.push_back({kSectionRngState, rng_bytes.data(), rng_bytes.size()});
+    sections.push_back({kSectionDrugs, drug_bytes.data(), drug_bytes.size()});
+
+    FileHeader header{};
+    fillStateHeader(header, engine);
+    header.kind = static_cast<uint32_t>(CheckpointKind::Full);
+    header.parent_step = -1;
+    return writeFile(path, header, sections, error_msg);
+}
+
+bool CheckpointWriter::writeDelta(const std::string& path, const SimulationState& metadata,
+                                  const SimulationEngine& engine,
+                                  const CheckpointBaseline& baseline, std::string& error_msg) {
+    if (baseline.empty() || baseline.oxygen.size() != engine.oxygen().size() ||
+        baseline.glucose.size() != engine.glucose().size()) {
+        error_msg = "Delta checkpoint needs a baseline of the same grid";
+        return false;
+    }
+
+    const std::string metadata_bytes = serializeMetadata(metadata);
+    const std::string genotype_bytes = encodeGenotypes(engine.genotypes(), baseline.num_genotypes);
+    const std::string rng_bytes = engine.rngState();
+    const std::string drug_bytes = engine.drugs().saveState();
+
+    // Index and data buffers must outlive the section list that points at them
+    struct Diff {
+        uint32_t kind;
+        std::string index;
+        std::string data;
+    };
+    std::vector<Diff> diffs;
+    diffs.push_back({kSectionOxygen, {}, {}});
+    diffGrid(engine.oxygen(), baseline.oxygen, &diffs.back().index, &diffs.back().data);
+    diffs.push_back({kSectionGlucose, {}, {}});
+    diffGrid(engine.glucose(), baseline.glucose, &diffs.back().index, &diffs.back().data);
+
+    // Pair each live column with the same column of the baseline
+    std::vector<std::pair<uint32_t, const void*>> base_columns;
+    forEachColumn(baseline.agents, [&](uint32_t kind, const auto& column) {
+        base_columns.emplace_back(kind, &column);
+    });
+    size_t column = 0;
+    forEachColumn(engine.agents(), [&](uint32_t kind, const auto& current) {
+        using Column = std::decay_t<decltype(current)>;
+        const auto& base = *static_cast<const Column*>(base_columns[column++].second);
+        diffs.push_back({kind, {}, {}});
+        diffColumn(current, base, &diffs.back().index, &diffs.back().data);
+    });
+
+    std::vector<PendingSection> sections = {
+        {kSectionMetadata, metadata_bytes.data(), metadata_bytes.size()},
+    };
+    for (const Diff& diff : diffs) {
+        sections.push_back({diff.kind | kIndexSection, diff.index.data(), diff.index.size()});
+        sections.push_back({diff.kind, diff.data.data(), diff.data.size()});
+    }
+    sections.push_back({kSectionGenotypeTable, genotype_bytes.data(), genotype_bytes.size()});
+    sections.push_back({kSectionRngState, rng_bytes.data(), rng_bytes.size()});
+    sections.push_back({kSectionDrugs, drug_bytes.data(), drug_bytes.size()});
+
+    FileHeader header{};
+    fillStateHeader(header, engine);
+    header.kind = static_cast<uint32_t>(CheckpointKind::Delta);
+    header.parent_step = baseline.step;
+    return writeFile(path, header, sections, error_msg);
+}
+
+// ============================================================================
+// CheckpointReader Implementation
+// ============================================================================
+
+CheckpointReader::~CheckpointReader() {
+    close();
+}
+
+void CheckpointReader::close() {
+    if (data_) {
+        ::munmap(const_cast<char*>(data_), size_);
+        data_ = nullptr;
+        size_ = 0;
+    }
+}
+
+bool CheckpointReader::open(const std::string& path, std::string& error_msg) {
+    close();
+
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        error_msg = "Cannot open checkpoint " + path + ": " + std::strerror(errno);
+        return false;
+    }
+    struct stat info {};
+    if (::fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(FileHeader)) {
+        ::close(fd);
+        error_msg = "Checkpoint is truncated: " + path;
+        return false;
+    }
+
+    const auto size = static_cast<size_t>(info.st_size);
+    void* mapping = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);  // The mapping keeps the file alive
+    if (mapping == MAP_FAILED) {
+        error_msg = "Cannot map checkpoint " + path + ": " + std::strerror(errno);
+        return false;
+    }
+    data_ = static_cast<const char*>(mapping);
+    size_ = size;
+
+    FileHeader header;
+    std::memcpy(&header, data_, sizeof(header));
+    if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0) {
+        error_msg = "Not a checkpoint file: " + path;
+    } else if (header.version != kFormatVersion || header.byte_order != kByteOrderMark) {
+        error_msg = "Unsupported checkpoint version or byte order: " + path;
+    } else if (header.file_size != size || header.section_count > kMaxSections) {
+        error_msg = "Checkpoint is truncated: " + path;
+    } else if (header.kind != static_cast<uint32_t>(CheckpointKind::Full) &&
+               header.kind != static_cast<uint32_t>(CheckpointKind::Delta)) {
+        error_msg = "Unknown checkpoint kind: " + path;
+    }
+    for (uint32_t i = 0; error_msg.empty() && i < header.section_count; ++i) {
+        const SectionEntry& entry = header.sections[i];
+        if (entry.offset % kSectionAlignment != 0 || entry.offset > size ||
+            entry.size > size - entry.offset) {
+            error_msg = "Checkpoint section table is corrupt: " + path;
+        }
+    }
+
+    const Section metadata = error_msg.empty() ? section(kSectionMetadata) : Section{};
+    if (error_msg.empty() &&
+        (metadata.size > static_cast<size_t>(std::numeric_limits<int>::max()) ||
+         !metadata_.ParseFromArray(metadata.data, static_cast<int>(metadata.size)))) {
+        error_msg = "Checkpoint metadata is corrupt: " + path;
+    }
+
+    if (!error_msg.empty()) {
+        close();
+        return false;
+    }
+    kind_ = static_cast<CheckpointKind>(header.kind);
+    step_ = header.step;
+    parent_step_ = header.parent_step;
+    return true;
+}
+
+CheckpointReader::Section CheckpointReader::section(uint32_t kind) const {
+    FileHeader header;
+    std::memcpy(&header, data_, sizeof(header));
+    for (uint32_t i = 0; i < header.section_count; ++i) {
+        if (header.sections[i].kind == kind) {
+            return {data_ + header.sections[i].offset,
+                    static_cast<size_t>(header.sections[i].size)};
+        }
+    }
+    return {};
+}
+
+bool CheckpointReader::restore(SimulationEngine& engine, std::string& error_msg) const {
+    if (!data_) {
+        error_msg = "No checkpoint is open";
+        return false;
+    }
+
+    FileHeader header;
+    std::memcpy(&header, data_, sizeof(header));
+    const SimulationParameters& params = engine.parameters();
+    if (header.nx != params.grid_size_x() || header.ny != params.grid_size_y() ||
+        header.nz != params.grid_size_z()) {
+        error_msg = "Checkpoint grid does not match the simulation parameters";
+        return false;
+    }
+
+    // Sections are read front to back exactly once
+    ::madvise(const_cast<char*>(data_), size_, MADV_SEQUENTIAL);
+
+    if (!(kind_ == CheckpointKind::Full ? restoreFull(engine, error_msg)
+                                        : applyDelta(engine, error_msg))) {
+        return false;
+    }
+    engine.agents().setNextId(header.next_agent_id);
+
+    const Section drugs = section(kSectionDrugs);
+    if (!engine.drugs().loadState(std::string(drugs.data ? drugs.data : "", drugs.size),
+                                  error_msg)) {
+        return false;
+    }
+
+    const Section rng = section(kSectionRngState);
+    return engine.resume(header.step, std::string(rng.data ? rng.data : "", rng.size), error_msg);
+}
+
+bool CheckpointReader::restoreFull(SimulationEngine& engine, std::string& error_msg) const {
+    FileHeader header;
+    std::memcpy(&header, data_, sizeof(header));
+
+    auto load = [&](uint32_t kind, void* dest, size_t bytes) {
+        const Section s = section(kind);
+        if (s.size != bytes || (bytes > 0 && !s.data)) {
+            error_msg = "Checkpoint section " + std::to_string(kind) + " has the wrong size";
+            return false;
+        }
+        if (bytes > 0) {
+            std::memcpy(dest, s.data, bytes);
+        }
+        return true;
+    };
+
+    const double h = engine.parameters().spatial_resolution();
+    engine.oxygen().resize(header.nx, header.ny, header.nz, h);
+    engine.glucose().resize(header.nx, header.ny, header.nz, h);
+    if (!load(kSectionOxygen, engine.oxygen().data(), engine.oxygen().size() * sizeof(double)) ||
+        !load(kSectionGlucose, engine.glucose().data(), engine.glucose().size() * sizeof(double))) {
+        return false;
+    }
+
+    AgentStore& agents = engine.agents();
+    agents.resize(static_cast<size_t>(header.num_agents));
+    bool ok = true;
+    forEachColumn(agents, [&](uint32_t kind, auto& column) {
+        using Value = typename std::decay_t<decltype(column)>::value_type;
+        ok = ok && load(kind, column.data(), column.size() * sizeof(Value));
+    });
+    if (!ok) {
+        return false;
+    }
+    agents.restoreBuckets();
+
+    const Section genotypes = section(kSectionGenotypeTable);
+    engine.genotypes().clear();
+    if (!decodeGenotypes(genotypes.data, genotypes.size, engine.genotypes())) {
+        error_msg = "Checkpoint genotype table is corrupt";
+        return false;
+    }
+    for (GenotypeTable::GenotypeId id : agents.genotypes()) {
+        if (id >= engine.genotypes().size()) {
+            error_msg = "Checkpoint agent refers to an unknown genotype";
+            return false;
+        }
+    }
+    return true;
+}
+
+bool CheckpointReader::applyDelta(SimulationEngine& engine, std::string& error_msg) const {
+    FileHeader header;
+    std::memcpy(&header, data_, sizeof(header));
+    if (engine.currentStep() != header.parent_step ||
+        engine.oxygen().nx() != header.nx || engine.oxygen().ny() != header.ny ||
+        engine.oxygen().nz() != header.nz) {
+        error_msg = "Delta checkpoint for step " + std::to_string(header.step) +
+                    " does not apply to step " + std::to_string(engine.currentStep());
+        return false;
+    }
+
+    for (auto [kind, grid] : {std::make_pair(kSectionOxygen, &engine.oxygen()),
+                              std::make_pair(kSectionGlucose, &engine.glucose())}) {
+        const Section index = section(kind | kIndexSection);
+        const Section data = section(kind);
+        if (!applyGrid(*grid, index.data, index.size, data.data, data.size)) {
+            error_msg = "Delta checkpoint grid section is corrupt";
+            return false;
+        }
+    }
+
+    AgentStore& agents = engine.agents();
+    const size_t parent_size = agents.size();
+    agents.resize(static_cast<size_t>(header.num_agents));
+    bool ok = true;
+    forEachColumn(agents, [&](uint32_t kind, auto& column) {
+        const Section index = section(kind | kIndexSection);
+        const Section data = section(kind);
+        ok = ok && applyColumn(column, parent_size, index.data, index.size, data.data, data.size);
+    });
+    if (!ok) {
+        error_msg = "Delta checkpoint agent section is corrupt";
+        return false;
+    }
+    agents.restoreBuckets();
+
+    const Section genotypes = section(kSectionGenotypeTable);
+    if (!decodeGenotypes(genotypes.data, genotypes.size, engine.genotypes())) {
+        error_msg = "Delta checkpoint genotype table does not continue the parent's";
+        return false;
+    }
+    return true;
+}
+
+// ============================================================================
+// CheckpointSeries Implementation
+// ============================================================================
+
+CheckpointSeries::CheckpointSeries(std::string full_path, int compaction_interval)
+    : full_path_(std::move(full_path)),
+      compaction_interval_(std::max(compaction_interval, 0)) {
+}
+
+bool CheckpointSeries::write(const SimulationState& metadata, const SimulationEngine& engine,
+                             bool compact, std::string& error_msg) {
+    const bool full = compact || baseline_.empty() || deltas_since_full_ >= compaction_interval_;
+    if (full) {
+        if (!CheckpointWriter::write(full_path_, metadata, engine, error_msg)) {
+            return false;
+        }
+        // The new full checkpoint supersedes the whole old chain
+        removeDeltas(full_path_);
+        deltas_since_full_ = 0;
+    } else {
+        if (!CheckpointWriter::writeDelta(deltaPath(full_path_, engine.currentStep()),
+                                          metadata, engine, baseline_, error_msg)) {
+            return false;
+        }
+        ++deltas_since_full_;
+    }
+    baseline_.capture(engine);
+    return true;
+}
+
+std::string CheckpointSeries::deltaPath(const std::string& full_path, int32_t step) {
+    std::ostringstream name;
+    name << full_path << '.' << std::setw(10) << std::setfill('0') << step << ".delta";
+    return name.str();
+}
+
+namespace {
+
+// Delta files written next to a full checkpoint
+std::vector<std::string> listDeltas(const std::string& full_path) {
+    std::vector<std::string> paths;
+    const std::filesystem::path full(full_path);
+    const std::string prefix = full.filename().string() + ".";
+    const std::string suffix = ".delta";
+
+    std::error_code ec;
+    const auto directory = full.has_parent_path() ? full.parent_path() : std::filesystem::path(".");
+    for (const auto& entry : std::filesystem::directory_iterator(directory, ec)) {
+        const std::string name = entry.path().filename().string();
+        if (name.size() > prefix.size() + suffix.size() &&
+            name.compare(0, prefix.size(), prefix) == 0 &&
+            name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0) {
+            paths.push_back(entry.path().string());
+        }
+    }
+    std::sort(paths.begin(), paths.end());
+    return paths;
+}
+
+} // namespace
+
+void CheckpointSeries::removeDeltas(const std::string& full_path) {
+    for (const std::string& path : listDeltas(full_path)) {
+        std::remove(path.c_str());
+    }
+}
+
+bool CheckpointSeries::open(const std::string& full_path, CheckpointChain& chain,
+                            std::string& error_msg) {
+    chain.clear();
+    auto full = std::make_shared<CheckpointReader>();
+    if (!full->open(full_path, error_msg)) {
+        return false;
+    }
+    if (full->kind() != CheckpointKind::Full) {
+        error_msg = "Not a full checkpoint: " + full_path;
+        return false;
+    }
+    int32_t step = full->step();
+    chain.push_back(full);
+
+    // Zero-padded names sort by step; follow parent links and skip stale or broken files
+    for (const std::string& path : listDeltas(full_path)) {
+        auto delta = std::make_shared<CheckpointReader>();
+        std::string delta_error;
+        if (!delta->open(path, delta_error) || delta->kind() != CheckpointKind::Delta) {
+            break;
+        }
+        if (delta->step() <= step) {
+            continue;
+        }
+        if (delta->parentStep() != step) {
+            break;
+        }
+        step = delta->step();
+        chain.push_back(delta);
+    }
+    return true;
+}
+
+} // namespace tumordtwin
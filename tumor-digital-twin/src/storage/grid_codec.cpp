@@ -0,0 +1,398 @@
+#include "storage/grid_codec.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+
+#include <zlib.h>
+#ifdef TUMORDTWIN_HAVE_ZSTD
+#include <zstd.h>
+#endif
+#ifdef TUMORDTWIN_HAVE_LZ4
+#include <lz4.h>
+#endif
+
+namespace tumordtwin {
+
+namespace {
+
+// Speed matters more than the last few percent: grids are encoded per request
+constexpr int kDeflateLevel = 1;
+constexpr int kZstdLevel = 3;
+
+size_t wordSize(GridPrecision precision) {
+    return precision == GridPrecision::FLOAT64 ? sizeof(uint64_t) : sizeof(uint32_t);
+}
+
+template <typename Word>
+void deltaEncode(char* bytes, size_t count) {
+    Word previous = 0;
+    for (size_t i = 0; i < count; ++i) {
+        Word word;
+        std::memcpy(&word, bytes + i * sizeof(Word), sizeof(Word));
+        const Word delta = static_cast<Word>(word - previous);
+        std::memcpy(bytes + i * sizeof(Word), &delta, sizeof(Word));
+        previous = word;
+    }
+}
+
+template <typename Word>
+void deltaDecode(char* bytes, size_t count) {
+    Word previous = 0;
+    for (size_t i = 0; i < count; ++i) {
+        Word delta;
+        std::memcpy(&delta, bytes + i * sizeof(Word), sizeof(Word));
+        previous = static_cast<Word>(previous + delta);
+        std::memcpy(bytes + i * sizeof(Word), &previous, sizeof(Word));
+    }
+}
+
+// Group byte k of every word together so the codec sees long runs of
+// near-constant high bytes
+std::string shuffle(const std::string& in, size_t word_size) {
+    const size_t count = in.size() / word_size;
+    std::string out(in.size(), '\0');
+    for (size_t i = 0; i < count; ++i) {
+        for (size_t b = 0; b < word_size; ++b) {
+            out[b * count + i] = in[i * word_size + b];
+        }
+    }
+    return out;
+}
+
+std::string unshuffle(const std::string& in, size_t word_size) {
+    const size_t count = in.size() / word_size;
+    std::string out(in.size(), '\0');
+    for (size_t i = 0; i < count; ++i) {
+        for (size_t b = 0; b < word_size; ++b) {
+            out[i * word_size + b] = in[b * count + i];
+        }
+    }
+    return out;
+}
+
+bool compress(GridCompression compression, const std::string& in, std::string* out,
+              std::string& error_msg) {
+    switch (compression) {
+        case GridCompression::COMPRESSION_DEFLATE: {
+            uLongf size = compressBound(static_cast<uLong>(in.size()));
+            out->resize(size);
+            if (compress2(reinterpret_cast<Bytef*>(&(*out)[0]), &size,
+                          reinterpret_cast<const Bytef*>(in.data()),
+                          static_cast<uLong>(in.size()), kDeflateLevel) != Z_OK) {
+                error_msg = "DEFLATE compression failed";
+                return false;
+            }
+            out->resize(size);
+            return true;
+        }
+#ifdef TUMORDTWIN_HAVE_ZSTD
+        case GridCompression::COMPRESSION_ZSTD: {
+            out->resize(ZSTD_compressBound(in.size()));
+            const size_t size = ZSTD_compress(&(*out)[0], out->size(), in.data(), in.size(),
+                                              kZstdLevel);
+            if (ZSTD_isError(size)) {
+                error_msg = std::string("zstd compression failed: ") + ZSTD_getErrorName(size);
+                return false;
+            }
+            out->resize(size);
+            return true;
+        }
+#endif
+#ifdef TUMORDTWIN_HAVE_LZ4
+        case GridCompression::COMPRESSION_LZ4: {
+            if (in.size() > static_cast<size_t>(LZ4_MAX_INPUT_SIZE)) {
+                error_msg = "Grid is too large for LZ4";
+                return false;
+            }
+            const int source_size = static_cast<int>(in.size());
+            out->resize(static_cast<size_t>(LZ4_compressBound(source_size)));
+            const int size = LZ4_compress_default(in.data(), &(*out)[0], source_size,
+                                                  static_cast<int>(out->size()));
+            if (size <= 0) {
+                error_msg = "LZ4 compression failed";
+                return false;
+            }
+            out->resize(static_cast<size_t>(size));
+            return true;
+        }
+#endif
+        default:
+            error_msg = "Unsupported grid compression";
+            return false;
+    }
+}
+
+bool decompress(GridCompression compression, const std::string& in, size_t expected_size,
+                std::string* out, std::string& error_msg) {
+    out->resize(expected_size);
+    switch (compression) {
+        case GridCompression::COMPRESSION_DEFLATE: {
+            uLongf size = static_cast<uLongf>(expected_size);
+            if (uncompress(reinterpret_cast<Bytef*>(&(*out)[0]), &size,
+                           reinterpret_cast<const Bytef*>(in.data()),
+                           static_cast<uLong>(in.size())) != Z_OK ||
+                size != expected_size) {
+                error_msg = "Corrupt DEFLATE grid data";
+                return false;
+            }
+            return true;
+        }
+#ifdef TUMORDTWIN_HAVE_ZSTD
+        case GridCompression::COMPRESSION_ZSTD: {
+            const size_t size = ZSTD_decompress(&(*out)[0], expected_size, in.data(), in.size());
+            if (ZSTD_isError(size) || size != expected_size) {
+                error_msg = "Corrupt zstd grid data";
+                return false;
+            }
+            return true;
+        }
+#endif
+#ifdef TUMORDTWIN_HAVE_LZ4
+        case GridCompression::COMPRESSION_LZ4: {
+            if (expected_size > static_cast<size_t>(LZ4_MAX_INPUT_SIZE) ||
+                in.size() > static_cast<size_t>(std::numeric_limits<int>::max())) {
+                error_msg = "Grid is too large for LZ4";
+                return false;
+            }
+            const int size = LZ4_decompress_safe(in.data(), &(*out)[0],
+                                                 static_cast<int>(in.size()),
+                                                 static_cast<int>(expected_size));
+            if (size < 0 || static_cast<size_t>(size) != expected_size) {
+                error_msg = "Corrupt LZ4 grid data";
+                return false;
+            }
+            return true;
+        }
+#endif
+        default:
+            error_msg = "Unsupported grid compression";
+            return false;
+    }
+}
+
+} // namespace
+
+// ============================================================================
+// GridCodec Implementation
+// ============================================================================
+
+bool GridCodec::isAvailable(GridCompression compression) {
+    switch (compression) {
+        case GridCompression::COMPRESSION_NONE:
+        case GridCompression::COMPRESSION_DEFLATE:
+            return true;
+        case GridCompression::COMPRESSION_ZSTD:
+#ifdef TUMORDTWIN_HAVE_ZSTD
+            return true;
+#else
+            return false;
+#endif
+        case GridCompression::COMPRESSION_LZ4:
+#ifdef TUMORDTWIN_HAVE_LZ4
+            return true;
+#else
+            return false;
+#endif
+        default:
+            return false;
+    }
+}
+
+GridEncoding GridCodec::negotiate(const GridEncoding& requested) {
+    GridEncoding encoding = requested;
+    encoding.clear_quantization_step();
+    encoding.clear_quantization_offset();
+    if (!isAvailable(encoding.compression())) {
+        encoding.set_compression(GridCompression::COMPRESSION_DEFLATE);
+    }
+    return encoding;
+}
+
+bool GridCodec::validate(const GridEncoding& encoding, std::string& error_msg) {
+    if (!GridPrecision_IsValid(encoding.precision())) {
+        error_msg = "Unknown grid precision";
+        return false;
+    }
+    if (!isAvailable(encoding.compression())) {
+        error_msg = "Grid compression is not available in this build";
+        return false;
+    }
+    if (encoding.precision() == GridPrecision::QUANTIZED_INT32 &&
+        !(encoding.max_error() > 0.0 && std::isfinite(encoding.max_error()))) {
+        error_msg = "Quantized grids require a positive max_error";
+        return false;
+    }
+    return true;
+}
+
+bool GridCodec::isRaw(const GridEncoding& encoding) {
+    return encoding.precision() == GridPrecision::FLOAT64 && !encoding.delta() &&
+           encoding.compression() == GridCompression::COMPRESSION_NONE;
+}
+
+bool GridCodec::encode(const ScalarGrid& grid, GridEncoding& encoding,
+                       std::string* out, std::string& error_msg) {
+    if (!validate(encoding, error_msg)) {
+        return false;
+    }
+
+    const size_t count = grid.size();
+    const double* values = grid.data();
+    const size_t word_size = wordSize(encoding.precision());
+    std::string words(count * word_size, '\0');
+
+    switch (encoding.precision()) {
+        case GridPrecision::FLOAT64:
+            std::memcpy(&words[0], values, words.size());
+            break;
+        case GridPrecision::FLOAT32:
+            for (size_t i = 0; i < count; ++i) {
+                const float value = static_cast<float>(values[i]);
+                std::memcpy(&words[i * sizeof(float)], &value, sizeof(float));
+            }
+            break;
+        case GridPrecision::QUANTIZED_INT32: {
+            double min_value = 0.0;
+            double max_value = 0.0;
+            if (count > 0) {
+                const auto [lo, hi] = std::minmax_element(values, values + count);
+                min_value = *lo;
+                max_value = *hi;
+            }
+            if (!std::isfinite(min_value) || !std::isfinite(max_value)) {
+                error_msg = "Cannot quantize non-finite grid values";
+                return false;
+            }
+            // Rounding to the nearest step keeps the error within step / 2
+            const double step = 2.0 * encoding.max_error();
+            if ((max_value - min_value) / step >=
+                static_cast<double>(std::numeric_limits<uint32_t>::max())) {
+                error_msg = "max_error is too small for the grid's value range";
+                return false;
+            }
+            encoding.set_quantization_step(step);
+            encoding.set_quantization_offset(min_value);
+            for (size_t i = 0; i < count; ++i) {
+                const auto q = static_cast<uint32_t>(std::llround((values[i] - min_value) / step));
+                std::memcpy(&words[i * sizeof(uint32_t)], &q, sizeof(uint32_t));
+            }
+            break;
+        }
+        default:
+            error_msg = "Unknown grid precision";
+            return false;
+    }
+
+    if (encoding.delta()) {
+        if (word_size == sizeof(uint64_t)) {
+            deltaEncode<uint64_t>(&words[0], count);
+        } else {
+            deltaEncode<uint32_t>(&words[0], count);
+        }
+    }
+
+    if (encoding.compression() == GridCompression::COMPRESSION_NONE) {
+        *out = std::move(words);
+        return true;
+    }
+    return compress(encoding.compression(), shuffle(words, word_size), out, error_msg);
+}
+
+bool GridCodec::decode(const std::string& bytes, const GridEncoding& encoding,
+                       ScalarGrid& grid, std::string& error_msg) {
+    if (!GridPrecision_IsValid(encoding.precision())) {
+        error_msg = "Unknown grid precision";
+        return false;
+    }
+
+    const size_t count = grid.size();
+    const size_t word_size = wordSize(encoding.precision());
+    std::string words;
+    if (encoding.compression() == GridCompression::COMPRESSION_NONE) {
+        words = bytes;
+    } else {
+        std::string shuffled;
+        if (!decompress(encoding.compression(), bytes, count * word_size, &shuffled, error_msg)) {
+            return false;
+        }
+        words = unshuffle(shuffled, word_size);
+    }
+    if (words.size() != count * word_size) {
+        error_msg = "Grid value buffer does not match the grid size";
+        return false;
+    }
+
+    if (encoding.delta()) {
+        if (word_size == sizeof(uint64_t)) {
+            deltaDecode<uint64_t>(&words[0], count);
+        } else {
+            deltaDecode<uint32_t>(&words[0], count);
+        }
+    }
+
+    double* values = grid.data();
+    switch (encoding.precision()) {
+        case GridPrecision::FLOAT64:
+            std::memcpy(values, words.data(), words.size());
+            break;
+        case GridPrecision::FLOAT32:
+            for (size_t i = 0; i < count; ++i) {
+                float value;
+                std::memcpy(&value, &words[i * sizeof(float)], sizeof(float));
+                values[i] = value;
+            }
+            break;
+        case GridPrecision::QUANTIZED_INT32:
+            for (size_t i = 0; i < count; ++i) {
+                uint32_t q;
+                std::memcpy(&q, &words[i * sizeof(uint32_t)], sizeof(uint32_t));
+                values[i] = encoding.quantization_offset() + q * encoding.quantization_step();
+            }
+            break;
+        default:
+            break;
+    }
+    return true;
+}
+
+bool GridCodec::toProto(const ScalarGrid& grid, SubstanceType substance,
+                        const GridEncoding& encoding, GridData* data,
+                        std::string& error_msg) {
+    if (isRaw(encoding)) {
+        grid.toProto(data, substance);
+        return true;
+    }
+
+    GridEncoding applied = encoding;
+    std::string bytes;
+    if (!encode(grid, applied, &bytes, error_msg)) {
+        return false;
+    }
+    grid.toProtoHeader(data, substance);
+    data->set_values(std::move(bytes));
+    data->set_compressed(true);
+    *data->mutable_encoding() = applied;
+    return true;
+}
+
+bool GridCodec::fromProto(const GridData& data, ScalarGrid& grid, std::string& error_msg) {
+    if (!data.compressed()) {
+        if (!grid.fromProto(data)) {
+            error_msg = "Grid metadata and value buffer disagree";
+            return false;
+        }
+        return true;
+    }
+
+    const auto& metadata = data.metadata();
+    if (metadata.nx() <= 0 || metadata.ny() <= 0 || metadata.nz() <= 0) {
+        error_msg = "Grid dimensions must be positive";
+        return false;
+    }
+    grid.resize(metadata.nx(), metadata.ny(), metadata.nz(), metadata.dx());
+    return decode(data.values(), data.encoding(), grid, error_msg);
+}
+
+} // namespace tumordtwin
@@ -0,0 +1,486 @@
+#include "storage/results_stream.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <utility>
+
+namespace tumordtwin {
+
+namespace {
+
+// Agents encoded per batch when the cursor enters an agent segment
+constexpr size_t kAgentsPerBatch = 4096;
+
+// Values expanded per batch when the cursor enters a sparse grid segment (1 MB)
+constexpr size_t kValuesPerBatch = 1 << 17;
+
+constexpr uint32_t kWireTypeLengthDelimited = 2;
+
+size_t varintSize(uint64_t value) {
+    size_t size = 1;
+    while (value >= 0x80) {
+        value >>= 7;
+        ++size;
+    }
+    return size;
+}
+
+void appendVarint(std::string* out, uint64_t value) {
+    while (value >= 0x80) {
+        out->push_back(static_cast<char>(value | 0x80));
+        value >>= 7;
+    }
+    out->push_back(static_cast<char>(value));
+}
+
+uint32_t lengthDelimitedTag(int field_number) {
+    return (static_cast<uint32_t>(field_number) << 3) | kWireTypeLengthDelimited;
+}
+
+// Bytes taken by a length-delimited field carrying `length` payload bytes
+size_t fieldSize(int field_number, size_t length) {
+    return varintSize(lengthDelimitedTag(field_number)) + varintSize(length) + length;
+}
+
+void appendFieldHeader(std::string* out, int field_number, size_t length) {
+    appendVarint(out, lengthDelimitedTag(field_number));
+    appendVarint(out, length);
+}
+
+// Every `stride`-th voxel of [lo, hi) along each axis, read through `value(i, j, k)`
+template <typename ValueAt>
+void cutOut(const int lo[3], const int hi[3], int stride, double spacing, ValueAt value,
+            ScalarGrid& out) {
+    auto samples = [stride](int begin, int end) { return (end - begin + stride - 1) / stride; };
+    out.resize(samples(lo[0], hi[0]), samples(lo[1], hi[1]), samples(lo[2], hi[2]),
+               spacing * stride);
+    for (int k = 0; k < out.nz(); ++k) {
+        for (int j = 0; j < out.ny(); ++j) {
+            double* row = &out.at(0, j, k);
+            for (int i = 0; i < out.nx(); ++i) {
+                row[i] = value(lo[0] + i * stride, lo[1] + j * stride, lo[2] + k * stride);
+            }
+        }
+    }
+}
+
+} // namespace
+
+// ============================================================================
+// ResultsStream Implementation
+// ============================================================================
+
+ResultsStream::ResultsStream(const SimulationState& header,
+                             std::shared_ptr<const SimulationSnapshot> snapshot,
+                             size_t chunk_bytes)
+    : snapshot_(std::move(snapshot)),
+      simulation_id_(header.simulation_id()),
+      chunk_bytes_(std::max<size_t>(chunk_bytes, 1)) {
+    // Serialize once; only copy the header when there is something to strip
+    if (header.agents_size() == 0 && header.grids_size() == 0) {
+        header_bytes_ = header.SerializeAsString();
+    } else {
+        SimulationState scalars(header);
+        scalars.clear_agents();
+        scalars.clear_grids();
+        header_bytes_ = scalars.SerializeAsString();
+    }
+}
+
+bool ResultsStream::init(const ResultsRequest& request, std::string& error_msg) {
+    segments_.clear();
+    total_bytes_ = 0;
+    next_chunk_ = 0;
+    segment_ = 0;
+    offset_ = 0;
+    batch_buffer_segment_ = SIZE_MAX;
+    selected_grids_.clear();
+    addOwned(header_bytes_);
+
+    if (!resolveSelection(request, error_msg)) {
+        return false;
+    }
+
+    if (request.include_grid_data()) {
+        const GridEncoding encoding = GridCodec::negotiate(request.grid_encoding());
+        if (!GridCodec::validate(encoding, error_msg)) {
+            return false;
+        }
+
+        std::vector<SubstanceType> substances;
+        if (request.substances_size() == 0) {
+            for (int s = SubstanceType_MIN; s <= SubstanceType_MAX; ++s) {
+                substances.push_back(static_cast<SubstanceType>(s));
+            }
+        } else {
+            for (int s : request.substances()) {
+                auto substance = static_cast<SubstanceType>(s);
+                if (std::find(substances.begin(), substances.end(), substance) == substances.end()) {
+                    substances.push_back(substance);
+                }
+            }
+        }
+        // Substances the model does not track are skipped rather than rejected
+        for (SubstanceType substance : substances) {
+            if (!addSelectedGrid(substance, encoding, error_msg)) {
+                return false;
+            }
+        }
+    }
+
+    if (request.include_agents()) {
+        selectAgents(request);
+        addAgents();
+    }
+
+    total_chunks_ = static_cast<int32_t>(
+        std::max<size_t>((total_bytes_ + chunk_bytes_ - 1) / chunk_bytes_, 1));
+    return true;
+}
+
+bool ResultsStream::resolveSelection(const ResultsRequest& request, std::string& error_msg) {
+    level_ = request.level();
+    stride_ = std::max(request.stride(), 1);
+    if (level_ < 0 || level_ > GridPyramid::kMaxLevel) {
+        error_msg = "Level must be between 0 and " + std::to_string(GridPyramid::kMaxLevel);
+        return false;
+    }
+    if (request.stride() < 0) {
+        error_msg = "Stride must be non-negative";
+        return false;
+    }
+
+    // Every field shares the lattice; the parameters describe it when no field is kept
+    const SimulationParameters& params = snapshot_->parameters;
+    int dims[3] = {params.grid_size_x(), params.grid_size_y(), params.grid_size_z()};
+    lattice_spacing_ = params.spatial_resolution();
+    for (int s = SubstanceType_MIN; s <= SubstanceType_MAX; ++s) {
+        const auto substance = static_cast<SubstanceType>(s);
+        const ScalarGrid* grid = snapshot_->grid(substance);
+        const BrickGrid* sparse = snapshot_->sparseGrid(substance);
+        if (grid || sparse) {
+            dims[0] = grid ? grid->nx() : sparse->nx();
+            dims[1] = grid ? grid->ny() : sparse->ny();
+            dims[2] = grid ? grid->nz() : sparse->nz();
+            lattice_spacing_ = grid ? grid->spacing() : sparse->spacing();
+            break;
+        }
+    }
+    for (int a = 0; a < 3; ++a) {
+        lattice_[a] = dims[a];
+        lo_[a] = 0;
+        hi_[a] = dims[a];
+    }
+
+    if (request.has_region()) {
+        const GridRegion& region = request.region();
+        const int lo[3] = {region.x_min(), region.y_min(), region.z_min()};
+        const int hi[3] = {region.x_max(), region.y_max(), region.z_max()};
+        for (int a = 0; a < 3; ++a) {
+            const int end = hi[a] == 0 ? lattice_[a] : hi[a];
+            if (lo[a] < 0 || end > lattice_[a] || lo[a] >= end) {
+                error_msg = "Region must be a non-empty box inside the " +
+                            std::to_string(lattice_[0]) + "x" + std::to_string(lattice_[1]) +
+                            "x" + std::to_string(lattice_[2]) + " grid";
+                return false;
+            }
+            lo_[a] = lo[a];
+            hi_[a] = end;
+        }
+    }
+    if (request.has_slice()) {
+        const GridSlice& slice = request.slice();
+        if (slice.axis() == SliceAxis::SLICE_AXIS_UNSPECIFIED) {
+            error_msg = "Slice axis is required";
+            return false;
+        }
+        const int a = static_cast<int>(slice.axis()) - 1;
+        if (slice.index() < lo_[a] || slice.index() >= hi_[a]) {
+            error_msg = "Slice index " + std::to_string(slice.index()) +
+                        " is outside the grid or region";
+            return false;
+        }
+        lo_[a] = slice.index();
+        hi_[a] = slice.index() + 1;
+    }
+
+    region_selected_ = false;
+    for (int a = 0; a < 3; ++a) {
+        region_selected_ = region_selected_ || lo_[a] != 0 || hi_[a] != lattice_[a];
+    }
+    return true;
+}
+
+void ResultsStream::selectAgents(const ResultsRequest& request) {
+    agent_indices_.clear();
+    agents_filtered_ = region_selected_ || request.agent_types_size() > 0 ||
+                       request.cell_states_size() > 0;
+    if (!agents_filtered_) {
+        return;
+    }
+
+    // Columns store types and states as bytes
+    std::array<bool, 256> type_selected;
+    std::array<bool, 256> state_selected;
+    type_selected.fill(request.agent_types_size() == 0);
+    state_selected.fill(request.cell_states_size() == 0);
+    for (int type : request.agent_types()) {
+        type_selected[static_cast<uint8_t>(type)] = true;
+    }
+    for (int state : request.cell_states()) {
+        state_selected[static_cast<uint8_t>(state)] = true;
+    }
+
+    const AgentStore& agents = snapshot_->agents;
+    const double inv_h = lattice_spacing_ > 0.0 ? 1.0 / lattice_spacing_ : 0.0;
+    auto inside = [&](double position, int a) {
+        const double voxel = std::floor(position * inv_h);
+        return voxel >= lo_[a] && voxel < hi_[a];
+    };
+    for (size_t a = 0; a < agents.size(); ++a) {
+        if (!type_selected[agents.types()[a]] || !state_selected[agents.states()[a]]) {
+            continue;
+        }
+        if (region_selected_ && !(inside(agents.x()[a], 0) && inside(agents.y()[a], 1) &&
+                                  inside(agents.z()[a], 2))) {
+            continue;
+        }
+        agent_indices_.push_back(a);
+    }
+}
+
+size_t ResultsStream::numAgents() const {
+    return agents_filtered_ ? agent_indices_.size() : snapshot_->agents.size();
+}
+
+void ResultsStream::addOwned(std::string bytes) {
+    if (bytes.empty()) {
+        return;
+    }
+    Segment segment;
+    segment.kind = Segment::Kind::Owned;
+    segment.size = bytes.size();
+    segment.bytes = std::move(bytes);
+    total_bytes_ += segment.size;
+    segments_.push_back(std::move(segment));
+}
+
+void ResultsStream::addView(const char* data, size_t size) {
+    if (size == 0) {
+        return;
+    }
+    Segment segment;
+    segment.kind = Segment::Kind::View;
+    segment.size = size;
+    segment.view = data;
+    total_bytes_ += segment.size;
+    segments_.push_back(std::move(segment));
+}
+
+bool ResultsStream::addSelectedGrid(SubstanceType substance, const GridEncoding& encoding,
+                                    std::string& error_msg) {
+    const ScalarGrid* grid = snapshot_->grid(substance);
+    const BrickGrid* sparse = snapshot_->sparseGrid(substance);
+    if (!grid && !sparse) {
+        return true;
+    }
+    if (!region_selected_ && level_ == 0 && stride_ == 1) {
+        return grid ? addGrid(substance, *grid, encoding, error_msg)
+                    : addSparseGrid(substance, *sparse, encoding, error_msg);
+    }
+
+    // The selection in voxels of the level, widened to whole coarse voxels
+    int lo[3];
+    int hi[3];
+    bool whole_level = stride_ == 1;
+    for (int a = 0; a < 3; ++a) {
+        lo[a] = lo_[a] >> level_;
+        hi[a] = GridPyramid::levelExtent(hi_[a], level_);
+        whole_level = whole_level && lo[a] == 0 &&
+                      hi[a] == GridPyramid::levelExtent(lattice_[a], level_);
+    }
+
+    GridData extent;
+    if (!whole_level || region_selected_) {
+        GridRegion* region = extent.mutable_region();
+        region->set_x_min(lo[0] << level_);
+        region->set_x_max(std::min(hi[0] << level_, lattice_[0]));
+        region->set_y_min(lo[1] << level_);
+        region->set_y_max(std::min(hi[1] << level_, lattice_[1]));
+        region->set_z_min(lo[2] << level_);
+        region->set_z_max(std::min(hi[2] << level_, lattice_[2]));
+    }
+    extent.set_level(level_);
+    extent.set_stride(stride_ > 1 ? stride_ : 0);
+
+    // Coarse levels come from the pyramid, never from the full-resolution field
+    const ScalarGrid* source = level_ > 0 ? snapshot_->levelGrid(substance, level_) : grid;
+    if (whole_level) {
+        return addGrid(substance, *source, encoding, error_msg, &extent);
+    }
+    selected_grids_.emplace_back();
+    ScalarGrid& selected = selected_grids_.back();
+    if (source) {
+        cutOut(lo, hi, stride_, source->spacing(),
+               [source](int i, int j, int k) { return source->at(i, j, k); }, selected);
+    } else {
+        cutOut(lo, hi, stride_, sparse->spacing(),
+               [sparse](int i, int j, int k) { return sparse->value(i, j, k); }, selected);
+    }
+    return addGrid(substance, selected, encoding, error_msg, &extent);
+}
+
+bool ResultsStream::addGrid(SubstanceType substance, const ScalarGrid& grid,
+                            const GridEncoding& encoding, std::string& error_msg,
+                            const GridData* extent) {
+    GridData message;
+    grid.toProtoHeader(&message, substance);
+    if (extent) {
+        message.MergeFrom(*extent);
+    }
+
+    // Raw values are served straight from the snapshot; anything else is encoded now
+    std::string encoded;
+    const bool raw = GridCodec::isRaw(encoding);
+    if (!raw) {
+        GridEncoding applied = encoding;
+        if (!GridCodec::encode(grid, applied, &encoded, error_msg)) {
+            return false;
+        }
+        message.set_compressed(true);
+        *message.mutable_encoding() = applied;
+    }
+
+    const size_t value_bytes = raw ? grid.size() * sizeof(double) : encoded.size();
+    addGridPrefix(message, value_bytes);
+
+    if (raw) {
+        addView(reinterpret_cast<const char*>(grid.data()), value_bytes);
+    } else {
+        addOwned(std::move(encoded));
+    }
+    return true;
+}
+
+bool ResultsStream::addSparseGrid(SubstanceType substance, const BrickGrid& grid,
+                                  const GridEncoding& encoding, std::string& error_msg) {
+    // Encoders work on the flat layout; the expanded copy lives only until encoded
+    if (!GridCodec::isRaw(encoding)) {
+        ScalarGrid dense;
+        grid.toDense(dense);
+        return addGrid(substance, dense, encoding, error_msg);
+    }
+
+    GridData message;
+    grid.toProtoHeader(&message, substance);
+    addGridPrefix(message, grid.size() * sizeof(double));
+
+    for (size_t begin = 0; begin < grid.size(); begin += kValuesPerBatch) {
+        Segment segment;
+        segment.kind = Segment::Kind::Bricks;
+        segment.begin = begin;
+        segment.end = std::min(begin + kValuesPerBatch, grid.size());
+        segment.size = (segment.end - segment.begin) * sizeof(double);
+        segment.bricks = &grid;
+        total_bytes_ += segment.size;
+        segments_.push_back(std::move(segment));
+    }
+    return true;
+}
+
+void ResultsStream::addGridPrefix(const GridData& message, size_t value_bytes) {
+    const std::string grid_header = message.SerializeAsString();
+    const size_t grid_bytes =
+        grid_header.size() + fieldSize(GridData::kValuesFieldNumber, value_bytes);
+
+    // SimulationState.grids entry, then the GridData.values header; the values follow
+    std::string prefix;
+    appendFieldHeader(&prefix, SimulationState::kGridsFieldNumber, grid_bytes);
+    prefix += grid_header;
+    appendFieldHeader(&prefix, GridData::kValuesFieldNumber, value_bytes);
+    addOwned(std::move(prefix));
+}
+
+void ResultsStream::addAgents() {
+    const AgentStore& agents = snapshot_->agents;
+    const size_t count = numAgents();
+    Agent agent;
+    for (size_t begin = 0; begin < count; begin += kAgentsPerBatch) {
+        Segment segment;
+        segment.kind = Segment::Kind::Agents;
+        segment.begin = begin;
+        segment.end = std::min(begin + kAgentsPerBatch, count);
+        for (size_t a = segment.begin; a < segment.end; ++a) {
+            agents.toProto(agentIndex(a), &agent, snapshot_->genotypes);
+            segment.size += fieldSize(SimulationState::kAgentsFieldNumber, agent.ByteSizeLong());
+        }
+        total_bytes_ += segment.size;
+        segments_.push_back(std::move(segment));
+    }
+}
+
+void ResultsStream::encodeAgents(size_t begin, size_t end, std::string* out) const {
+    out->clear();
+    Agent agent;
+    for (size_t a = begin; a < end; ++a) {
+        snapshot_->agents.toProto(agentIndex(a), &agent, snapshot_->genotypes);
+        appendFieldHeader(out, SimulationState::kAgentsFieldNumber, agent.ByteSizeLong());
+        agent.AppendToString(out);
+    }
+}
+
+const char* ResultsStream::segmentData(size_t index) {
+    const Segment& segment = segments_[index];
+    switch (segment.kind) {
+        case Segment::Kind::Owned:
+            return segment.bytes.data();
+        case Segment::Kind::View:
+            return segment.view;
+        case Segment::Kind::Agents:
+            if (batch_buffer_segment_ != index) {
+                encodeAgents(segment.begin, segment.end, &batch_buffer_);
+                batch_buffer_segment_ = index;
+            }
+            return batch_buffer_.data();
+        case Segment::Kind::Bricks:
+            if (batch_buffer_segment_ != index) {
+                batch_buffer_.resize(segment.size);
+                segment.bricks->copyValues(segment.begin, segment.end - segment.begin,
+                                           reinterpret_cast<double*>(&batch_buffer_[0]));
+                batch_buffer_segment_ = index;
+            }
+            return batch_buffer_.data();
+    }
+    return nullptr;
+}
+
+bool ResultsStream::next(ResultsChunk* chunk) {
+    if (next_chunk_ >= total_chunks_) {
+        return false;
+    }
+
+    chunk->Clear();
+    chunk->set_simulation_id(simulation_id_);
+    chunk->set_chunk_number(next_chunk_);
+    chunk->set_total_chunks(total_chunks_);
+
+    std::string* data = chunk->mutable_data();
+    // Every chunk but the last is full
+    data->reserve(std::min(chunk_bytes_, total_bytes_ - next_chunk_ * chunk_bytes_));
+    while (data->size() < chunk_bytes_ && segment_ < segments_.size()) {
+        const size_t segment_size = segments_[segment_].size;
+        const size_t take = std::min(segment_size - offset_, chunk_bytes_ - data->size());
+        data->append(segmentData(segment_) + offset_, take);
+        offset_ += take;
+        if (offset_ == segment_size) {
+            ++segment_;
+            offset_ = 0;
+        }
+    }
+
+    ++next_chunk_;
+    chunk->set_is_final(next_chunk_ == total_chunks_);
+    return true;
+}
+
+} // namespace tumordtwin
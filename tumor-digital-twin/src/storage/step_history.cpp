@@ -0,0 +1,574 @@
+#include "storage/step_history.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "storage/grid_codec.h"
+
+namespace tumordtwin {
+
+namespace {
+
+using google::protobuf::FieldDescriptor;
+
+constexpr const char* kParametersFile = "parameters.pb";
+constexpr const char* kOffsetsFile = "details.idx";
+constexpr const char* kDetailsFile = "details.dat";
+constexpr const char* kSnapshotPrefix = "snapshot_";
+constexpr const char* kSnapshotSuffix = ".pb";
+
+// Agents per record of a snapshot file, which keeps every record far below
+// the protobuf message size limit
+constexpr size_t kAgentsPerRecord = 65536;
+
+// Singular numeric fields of SimulationMetrics, each stored as a column; the
+// rest of a step goes to the details column
+const std::vector<const FieldDescriptor*>& scalarFields() {
+    static const std::vector<const FieldDescriptor*> fields = [] {
+        std::vector<const FieldDescriptor*> result;
+        const auto* descriptor = SimulationMetrics::descriptor();
+        for (int f = 0; f < descriptor->field_count(); ++f) {
+            const FieldDescriptor* field = descriptor->field(f);
+            if (field->is_repeated()) {
+                continue;
+            }
+            switch (field->cpp_type()) {
+                case FieldDescriptor::CPPTYPE_INT32:
+                case FieldDescriptor::CPPTYPE_INT64:
+                case FieldDescriptor::CPPTYPE_DOUBLE:
+                    result.push_back(field);
+                    break;
+                default:
+                    break;
+            }
+        }
+        return result;
+    }();
+    return fields;
+}
+
+size_t columnWidth(const FieldDescriptor* field) {
+    return field->cpp_type() == FieldDescriptor::CPPTYPE_INT32 ? sizeof(int32_t) : 8;
+}
+
+void storeValue(const SimulationMetrics& metrics, const FieldDescriptor* field, char* out) {
+    const auto* reflection = SimulationMetrics::GetReflection();
+    if (field->cpp_type() == FieldDescriptor::CPPTYPE_INT32) {
+        const int32_t value = reflection->GetInt32(metrics, field);
+        std::memcpy(out, &value, sizeof(value));
+    } else if (field->cpp_type() == FieldDescriptor::CPPTYPE_INT64) {
+        const int64_t value = reflection->GetInt64(metrics, field);
+        std::memcpy(out, &value, sizeof(value));
+    } else {
+        const double value = reflection->GetDouble(metrics, field);
+        std::memcpy(out, &value, sizeof(value));
+    }
+}
+
+template <typename T>
+T loadValue(const char* in) {
+    T value;
+    std::memcpy(&value, in, sizeof(value));
+    return value;
+}
+
+void setValue(const char* in, const FieldDescriptor* field, SimulationMetrics* metrics) {
+    const auto* reflection = SimulationMetrics::GetReflection();
+    if (field->cpp_type() == FieldDescriptor::CPPTYPE_INT32) {
+        reflection->SetInt32(metrics, field, loadValue<int32_t>(in));
+    } else if (field->cpp_type() == FieldDescriptor::CPPTYPE_INT64) {
+        reflection->SetInt64(metrics, field, loadValue<int64_t>(in));
+    } else {
+        reflection->SetDouble(metrics, field, loadValue<double>(in));
+    }
+}
+
+// Columns MetricHistory does not list are only returned through metrics()
+void addValue(const char* in, const FieldDescriptor* field, MetricHistory* history) {
+    const FieldDescriptor* column = MetricHistory::descriptor()->FindFieldByName(field->name());
+    if (!column || !column->is_repeated() || column->cpp_type() != field->cpp_type()) {
+        return;
+    }
+    const auto* reflection = MetricHistory::GetReflection();
+    if (field->cpp_type() == FieldDescriptor::CPPTYPE_INT32) {
+        reflection->AddInt32(history, column, loadValue<int32_t>(in));
+    } else if (field->cpp_type() == FieldDescriptor::CPPTYPE_INT64) {
+        reflection->AddInt64(history, column, loadValue<int64_t>(in));
+    } else {
+        reflection->AddDouble(history, column, loadValue<double>(in));
+    }
+}
+
+bool preadAll(int fd, void* out, size_t size, uint64_t offset) {
+    char* bytes = static_cast<char*>(out);
+    while (size > 0) {
+        const ssize_t count = ::pread(fd, bytes, size, static_cast<off_t>(offset));
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count <= 0) {
+            return false;
+        }
+        bytes += count;
+        size -= static_cast<size_t>(count);
+        offset += static_cast<uint64_t>(count);
+    }
+    return true;
+}
+
+bool pwriteAll(int fd, const void* data, size_t size, uint64_t offset) {
+    const char* bytes = static_cast<const char*>(data);
+    while (size > 0) {
+        const ssize_t count = ::pwrite(fd, bytes, size, static_cast<off_t>(offset));
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        bytes += count;
+        size -= static_cast<size_t>(count);
+        offset += static_cast<uint64_t>(count);
+    }
+    return true;
+}
+
+uint64_t fileSize(int fd) {
+    struct stat info {};
+    return ::fstat(fd, &info) == 0 ? static_cast<uint64_t>(info.st_size) : 0;
+}
+
+// Write to a temporary name and rename, so readers never see a partial file
+bool writeFileAtomically(const std::string& path, const std::string& contents,
+                         std::string& error_msg) {
+    const std::string temp_path = path + ".tmp";
+    {
+        std::ofstream out(temp_path, std::ios::binary | std::ios::trunc);
+        out.write(contents.data(), static_cast<std::streamsize>(contents.size()));
+        if (!out) {
+            error_msg = "Cannot write " + temp_path;
+            std::remove(temp_path.c_str());
+            return false;
+        }
+    }
+    if (std::rename(temp_path.c_str(), path.c_str()) != 0) {
+        error_msg = "Cannot rename " + temp_path + ": " + std::strerror(errno);
+        std::remove(temp_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+// Snapshot files are a sequence of SimulationState records, each preceded by its size
+void appendRecord(const SimulationState& record, std::string* out) {
+    const uint64_t size = record.ByteSizeLong();
+    out->append(reinterpret_cast<const char*>(&size), sizeof(size));
+    record.AppendToString(out);
+}
+
+} // namespace
+
+// ============================================================================
+// StepHistory Implementation
+// ============================================================================
+
+StepHistory::StepHistory(std::string directory) : directory_(std::move(directory)) {}
+
+StepHistory::~StepHistory() {
+    close();
+}
+
+void StepHistory::close() {
+    for (int fd : column_fds_) {
+        ::close(fd);
+    }
+    column_fds_.clear();
+    for (int* fd : {&offsets_fd_, &details_fd_}) {
+        if (*fd >= 0) {
+            ::close(*fd);
+            *fd = -1;
+        }
+    }
+}
+
+int StepHistory::snapshotInterval(const SimulationParameters& parameters) {
+    auto it = parameters.extra_params().find(kParamSnapshotInterval);
+    return it != parameters.extra_params().end() ? static_cast<int>(it->second)
+                                                 : parameters.checkpoint_interval();
+}
+
+std::string StepHistory::snapshotPath(int32_t step) const {
+    return (std::filesystem::path(directory_) /
+            (kSnapshotPrefix + std::to_string(step) + kSnapshotSuffix)).string();
+}
+
+bool StepHistory::open(const SimulationParameters& parameters, int32_t last_step,
+                       std::string& error_msg) {
+    close();
+    parameters_ = parameters;
+    const std::filesystem::path directory(directory_);
+    std::error_code ec;
+    if (last_step < 0) {
+        std::filesystem::remove_all(directory, ec);
+    }
+    std::filesystem::create_directories(directory, ec);
+    if (!writeFileAtomically((directory / kParametersFile).string(),
+                             parameters.SerializeAsString(), error_msg)) {
+        return false;
+    }
+
+    auto openColumn = [&](const std::string& name, int* fd) {
+        const std::string path = (directory / name).string();
+        *fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+        if (*fd < 0) {
+            error_msg = "Cannot open history column " + path + ": " + std::strerror(errno);
+            return false;
+        }
+        return true;
+    };
+
+    // Whole rows only: a crash may have cut the last one short in some columns
+    const auto& fields = scalarFields();
+    uint64_t rows = UINT64_MAX;
+    for (const FieldDescriptor* field : fields) {
+        int fd = -1;
+        if (!openColumn(field->name() + ".col", &fd)) {
+            close();
+            return false;
+        }
+        column_fds_.push_back(fd);
+        rows = std::min(rows, fileSize(fd) / columnWidth(field));
+    }
+    if (!openColumn(kOffsetsFile, &offsets_fd_) || !openColumn(kDetailsFile, &details_fd_)) {
+        close();
+        return false;
+    }
+    rows = std::min(rows, fileSize(offsets_fd_) / sizeof(uint64_t));
+
+    // Rewind to last_step; a history that stops short of it has a gap and starts over
+    const auto step_column = std::find_if(fields.begin(), fields.end(), [](const auto* field) {
+        return field->number() == SimulationMetrics::kStepNumberFieldNumber;
+    }) - fields.begin();
+    int32_t first_step = -1;
+    if (rows > 0 && !preadAll(column_fds_[step_column], &first_step, sizeof(first_step), 0)) {
+        rows = 0;
+    }
+    if (rows > 0) {
+        const int64_t last_recorded = first_step + static_cast<int64_t>(rows) - 1;
+        if (last_step < first_step || last_recorded < last_step) {
+            rows = 0;
+        } else {
+            rows = static_cast<uint64_t>(last_step - first_step + 1);
+        }
+    }
+
+    details_size_ = 0;
+    if (rows > 0 && !preadAll(offsets_fd_, &details_size_, sizeof(details_size_),
+                              (rows - 1) * sizeof(uint64_t))) {
+        error_msg = "Cannot read history details index";
+        close();
+        return false;
+    }
+    bool ok = true;
+    for (size_t c = 0; c < fields.size(); ++c) {
+        const auto size = static_cast<off_t>(rows * columnWidth(fields[c]));
+        ok = ok && ::ftruncate(column_fds_[c], size) == 0;
+    }
+    ok = ok && ::ftruncate(offsets_fd_, static_cast<off_t>(rows * sizeof(uint64_t))) == 0;
+    ok = ok && ::ftruncate(details_fd_, static_cast<off_t>(details_size_)) == 0;
+    if (!ok) {
+        error_msg = "Cannot rewind history " + directory_ + ": " + std::strerror(errno);
+        close();
+        return false;
+    }
+
+    // The snapshot files are their own index; listed once here
+    std::vector<int32_t> snapshot_steps;
+    for (const auto& entry : std::filesystem::directory_iterator(directory, ec)) {
+        const std::string name = entry.path().filename().string();
+        if (name.rfind(kSnapshotPrefix, 0) != 0 ||
+            entry.path().extension() != kSnapshotSuffix) {
+            continue;
+        }
+        const int32_t step = std::atoi(name.c_str() + std::strlen(kSnapshotPrefix));
+        if (step > last_step) {
+            std::filesystem::remove(entry.path(), ec);
+        } else {
+            snapshot_steps.push_back(step);
+        }
+    }
+    std::sort(snapshot_steps.begin(), snapshot_steps.end());
+    {
+        std::lock_guard<std::mutex> lock(snapshots_mutex_);
+        snapshot_steps_ = std::move(snapshot_steps);
+    }
+
+    first_step_.store(rows > 0 ? first_step : -1, std::memory_order_release);
+    rows_.store(static_cast<size_t>(rows), std::memory_order_release);
+    return true;
+}
+
+bool StepHistory::append(const SimulationMetrics& metrics, std::string& error_msg) {
+    if (column_fds_.empty()) {
+        error_msg = "History is not open";
+        return false;
+    }
+    const size_t row = rows();
+    if (row > 0 && metrics.step_number() != firstStep() + static_cast<int64_t>(row)) {
+        error_msg = "Step " + std::to_string(metrics.step_number()) + " does not follow step " +
+                    std::to_string(firstStep() + static_cast<int64_t>(row) - 1);
+        return false;
+    }
+
+    // Everything the scalar columns do not hold
+    SimulationMetrics details = metrics;
+    const auto& fields = scalarFields();
+    for (const FieldDescriptor* field : fields) {
+        SimulationMetrics::GetReflection()->ClearField(&details, field);
+    }
+    const std::string detail_bytes = details.SerializeAsString();
+    const uint64_t details_end = details_size_ + detail_bytes.size();
+
+    bool ok = pwriteAll(details_fd_, detail_bytes.data(), detail_bytes.size(), details_size_) &&
+              pwriteAll(offsets_fd_, &details_end, sizeof(details_end), row * sizeof(uint64_t));
+    char value[8];
+    for (size_t c = 0; ok && c < fields.size(); ++c) {
+        const size_t width = columnWidth(fields[c]);
+        storeValue(metrics, fields[c], value);
+        ok = pwriteAll(column_fds_[c], value, width, row * width);
+    }
+    if (!ok) {
+        // Nothing was published; the next append overwrites the partial row
+        error_msg = "Cannot append to history " + directory_ + ": " + std::strerror(errno);
+        return false;
+    }
+    details_size_ = details_end;
+
+    if (row == 0) {
+        first_step_.store(metrics.step_number(), std::memory_order_release);
+    }
+    rows_.store(row + 1, std::memory_order_release);
+    return true;
+}
+
+bool StepHistory::hasStep(int32_t step) const {
+    const size_t published = rows();
+    const int32_t first = firstStep();
+    return published > 0 && step >= first &&
+           static_cast<int64_t>(step) - first < static_cast<int64_t>(published);
+}
+
+bool StepHistory::metrics(int32_t step, SimulationMetrics* metrics,
+                          std::string& error_msg) const {
+    if (!hasStep(step)) {
+        error_msg = "No metrics recorded for step " + std::to_string(step);
+        return false;
+    }
+    const size_t row = static_cast<size_t>(step - firstStep());
+    metrics->Clear();
+    if (!readDetails(row, metrics, error_msg)) {
+        return false;
+    }
+    const auto& fields = scalarFields();
+    char value[8];
+    for (size_t c = 0; c < fields.size(); ++c) {
+        const size_t width = columnWidth(fields[c]);
+        if (!preadAll(column_fds_[c], value, width, row * width)) {
+            error_msg = "History of step " + std::to_string(step) + " is truncated";
+            return false;
+        }
+        setValue(value, fields[c], metrics);
+    }
+    return true;
+}
+
+bool StepHistory::readDetails(size_t row, SimulationMetrics* metrics,
+                              std::string& error_msg) const {
+    uint64_t bounds[2] = {0, 0};
+    const bool ok = row == 0
+        ? preadAll(offsets_fd_, &bounds[1], sizeof(uint64_t), 0)
+        : preadAll(offsets_fd_, bounds, sizeof(bounds), (row - 1) * sizeof(uint64_t));
+    std::string bytes(ok && bounds[1] >= bounds[0] ? bounds[1] - bounds[0] : 0, '\0');
+    if (!ok || bounds[1] < bounds[0] ||
+        (!bytes.empty() && !preadAll(details_fd_, &bytes[0], bytes.size(), bounds[0])) ||
+        !metrics->MergeFromString(bytes)) {
+        error_msg = "History details of row " + std::to_string(row) + " are corrupt";
+        return false;
+    }
+    return true;
+}
+
+bool StepHistory::read(int32_t from_step, int32_t to_step, int32_t stride, bool details,
+                       MetricHistory* history, std::string& error_msg) const {
+    const size_t published = rows();
+    const int32_t first = firstStep();
+    if (published == 0) {
+        return true;
+    }
+    const int64_t last = first + static_cast<int64_t>(published) - 1;
+    const int64_t from = std::max<int64_t>(from_step, first);
+    const int64_t to = std::min<int64_t>(to_step, last);
+    if (from > to) {
+        return true;
+    }
+    stride = std::max(stride, 1);
+    const size_t first_row = static_cast<size_t>(from - first);
+    const size_t span = static_cast<size_t>(to - from) + 1;
+
+    // One positioned read per column covers the whole range
+    const auto& fields = scalarFields();
+    std::vector<char> block;
+    for (size_t c = 0; c < fields.size(); ++c) {
+        const size_t width = columnWidth(fields[c]);
+        block.resize(span * width);
+        if (!preadAll(column_fds_[c], block.data(), block.size(), first_row * width)) {
+            error_msg = "History column " + fields[c]->name() + " is truncated";
+            return false;
+        }
+        for (size_t r = 0; r < span; r += static_cast<size_t>(stride)) {
+            addValue(block.data() + r * width, fields[c], history);
+        }
+    }
+    if (details) {
+        for (size_t r = 0; r < span; r += static_cast<size_t>(stride)) {
+            if (!readDetails(first_row + r, history->add_details(), error_msg)) {
+                return false;
+            }
+        }
+    }
+
+    for (int32_t step : snapshotSteps()) {
+        if (step >= from && step <= to) {
+            history->add_snapshot_steps(step);
+        }
+    }
+    return true;
+}
+
+bool StepHistory::writeSnapshot(const SimulationSnapshot& snapshot, std::string& error_msg) {
+    std::string contents;
+    SimulationState record;
+    record.set_current_step(snapshot.step);
+    record.set_current_time(snapshot.time);
+    *record.mutable_metrics() = snapshot.metrics;
+    appendRecord(record, &contents);
+
+    // Lossless, so a past step is served exactly as it was simulated
+    GridEncoding encoding;
+    encoding.set_precision(GridPrecision::FLOAT64);
+    encoding.set_compression(GridCompression::COMPRESSION_DEFLATE);
+    for (int s = SubstanceType_MIN; s <= SubstanceType_MAX; ++s) {
+        const auto substance = static_cast<SubstanceType>(s);
+        const ScalarGrid* grid = snapshot.grid(substance);
+        ScalarGrid expanded;
+        if (!grid && snapshot.sparseGrid(substance)) {
+            snapshot.sparseGrid(substance)->toDense(expanded);
+            grid = &expanded;
+        }
+        if (!grid) {
+            continue;
+        }
+        record.Clear();
+        if (!GridCodec::toProto(*grid, substance, encoding, record.add_grids(), error_msg)) {
+            return false;
+        }
+        appendRecord(record, &contents);
+    }
+    for (size_t first = 0; first < snapshot.agents.size(); first += kAgentsPerRecord) {
+        record.Clear();
+        const size_t end = std::min(snapshot.agents.size(), first + kAgentsPerRecord);
+        for (size_t i = first; i < end; ++i) {
+            snapshot.agents.toProto(i, record.add_agents(), snapshot.genotypes);
+        }
+        appendRecord(record, &contents);
+    }
+
+    if (!writeFileAtomically(snapshotPath(snapshot.step), contents, error_msg)) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(snapshots_mutex_);
+    auto it = std::lower_bound(snapshot_steps_.begin(), snapshot_steps_.end(), snapshot.step);
+    if (it == snapshot_steps_.end() || *it != snapshot.step) {
+        snapshot_steps_.insert(it, snapshot.step);
+    }
+    return true;
+}
+
+std::vector<int32_t> StepHistory::snapshotSteps() const {
+    std::lock_guard<std::mutex> lock(snapshots_mutex_);
+    return snapshot_steps_;
+}
+
+std::shared_ptr<const SimulationSnapshot> StepHistory::loadSnapshot(
+    int32_t step, std::string& error_msg) const {
+    {
+        std::lock_guard<std::mutex> lock(snapshots_mutex_);
+        if (!std::binary_search(snapshot_steps_.begin(), snapshot_steps_.end(), step)) {
+            error_msg = "No grids or agents stored for step " + std::to_string(step);
+            return nullptr;
+        }
+    }
+
+    const std::string path = snapshotPath(step);
+    std::ifstream in(path, std::ios::binary);
+    const std::string contents((std::istreambuf_iterator<char>(in)),
+                               std::istreambuf_iterator<char>());
+    if (!in.good() && !in.eof()) {
+        error_msg = "Cannot read history snapshot " + path;
+        return nullptr;
+    }
+
+    auto snapshot = std::make_shared<SimulationSnapshot>();
+    snapshot->parameters = parameters_;
+    SimulationState agents;
+    SimulationState record;
+    size_t offset = 0;
+    for (bool header = true; offset < contents.size(); header = false) {
+        uint64_t size = 0;
+        if (contents.size() - offset < sizeof(size)) {
+            break;
+        }
+        std::memcpy(&size, contents.data() + offset, sizeof(size));
+        offset += sizeof(size);
+        if (size > contents.size() - offset ||
+            !record.ParseFromArray(contents.data() + offset, static_cast<int>(size))) {
+            break;
+        }
+        offset += size;
+
+        if (header) {
+            snapshot->step = record.current_step();
+            snapshot->time = record.current_time();
+            snapshot->metrics = record.metrics();
+        }
+        for (const GridData& data : record.grids()) {
+            ScalarGrid* grid = data.substance() == SubstanceType::OXYGEN    ? &snapshot->oxygen
+                               : data.substance() == SubstanceType::GLUCOSE ? &snapshot->glucose
+                               : data.substance() == SubstanceType::DRUG    ? &snapshot->drug
+                                                                            : nullptr;
+            if (grid && !GridCodec::fromProto(data, *grid, error_msg)) {
+                return nullptr;
+            }
+        }
+        for (Agent& agent : *record.mutable_agents()) {
+            agents.add_agents()->Swap(&agent);
+        }
+    }
+    if (offset != contents.size() || snapshot->step != step) {
+        error_msg = "History snapshot " + path + " is corrupt";
+        return nullptr;
+    }
+    snapshot->agents.fromProto(agents.agents(), snapshot->genotypes);
+    return snapshot;
+}
+
+} // namespace tumordtwin
@@ -0,0 +1,196 @@
+#include "utils/metrics_registry.h"
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <stdexcept>
+
+namespace tumordtwin {
+
+namespace {
+
+std::string escapeLabelValue(const std::string& value) {
+    std::string escaped;
+    escaped.reserve(value.size());
+    for (char c : value) {
+        if (c == '\\' || c == '"') {
+            escaped += '\\';
+            escaped += c;
+        } else if (c == '\n') {
+            escaped += "\\n";
+        } else {
+            escaped += c;
+        }
+    }
+    return escaped;
+}
+
+// {a="1",b="2"}, or "" without labels; `extra` is appended last (the histogram le label)
+std::string renderLabels(const MetricLabels& labels, const std::string& extra = "") {
+    if (labels.empty() && extra.empty()) {
+        return "";
+    }
+    std::string rendered = "{";
+    for (const auto& [name, value] : labels) {
+        if (rendered.size() > 1) {
+            rendered += ',';
+        }
+        rendered += name + "=\"" + escapeLabelValue(value) + "\"";
+    }
+    if (!extra.empty()) {
+        if (rendered.size() > 1) {
+            rendered += ',';
+        }
+        rendered += extra;
+    }
+    return rendered + "}";
+}
+
+std::string formatNumber(double value) {
+    if (std::isinf(value)) {
+        return value > 0 ? "+Inf" : "-Inf";
+    }
+    if (std::isnan(value)) {
+        return "NaN";
+    }
+    std::ostringstream stream;
+    stream.precision(15);
+    stream << value;
+    return stream.str();
+}
+
+} // namespace
+
+// ============================================================================
+// Histogram Implementation
+// ============================================================================
+
+Histogram::Histogram(std::vector<double> upper_bounds)
+    : upper_bounds_(std::move(upper_bounds)),
+      buckets_(new std::atomic<uint64_t>[upper_bounds_.size() + 1]) {
+    for (size_t i = 0; i <= upper_bounds_.size(); ++i) {
+        buckets_[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+void Histogram::observe(double value) {
+    // The first bucket whose bound is >= value (Prometheus buckets are inclusive)
+    const size_t bucket = static_cast<size_t>(
+        std::lower_bound(upper_bounds_.begin(), upper_bounds_.end(), value) -
+        upper_bounds_.begin());
+    buckets_[bucket].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    double sum = sum_.load(std::memory_order_relaxed);
+    while (!sum_.compare_exchange_weak(sum, sum + value, std::memory_order_relaxed)) {
+    }
+}
+
+std::vector<double> Histogram::exponentialBuckets(double start, double factor, size_t count) {
+    std::vector<double> bounds;
+    bounds.reserve(count);
+    double bound = start;
+    for (size_t i = 0; i < count; ++i) {
+        bounds.push_back(bound);
+        bound *= factor;
+    }
+    return bounds;
+}
+
+// ============================================================================
+// MetricsRegistry Implementation
+// ============================================================================
+
+std::vector<double> MetricsRegistry::latencyBuckets() {
+    return Histogram::exponentialBuckets(50e-6, 2.0, 22);
+}
+
+MetricsRegistry::Family& MetricsRegistry::family(const std::string& name,
+                                                 const std::string& help, Type type) {
+    auto [it, inserted] = families_.try_emplace(name);
+    if (inserted) {
+        it->second.help = help;
+        it->second.type = type;
+    } else if (it->second.type != type) {
+        throw std::logic_error("Metric " + name + " is registered with another type");
+    }
+    return it->second;
+}
+
+Counter& MetricsRegistry::counter(const std::string& name, const std::string& help,
+                                  const MetricLabels& labels) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Series& series = family(name, help, Type::Counter).series[renderLabels(labels)];
+    if (!series.counter) {
+        series.labels = labels;
+        series.counter = std::make_unique<Counter>();
+    }
+    return *series.counter;
+}
+
+Histogram& MetricsRegistry::histogram(const std::string& name, const std::string& help,
+                                      const MetricLabels& labels,
+                                      const std::vector<double>& upper_bounds) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Family& f = family(name, help, Type::Histogram);
+    if (f.series.empty()) {
+        f.upper_bounds = upper_bounds;
+    }
+    Series& series = f.series[renderLabels(labels)];
+    if (!series.histogram) {
+        // Every series of a family shares its buckets so they can be aggregated
+        series.labels = labels;
+        series.histogram = std::make_unique<Histogram>(f.upper_bounds);
+    }
+    return *series.histogram;
+}
+
+void MetricsRegistry::gauge(const std::string& name, const std::string& help,
+                            const MetricLabels& labels, std::function<double()> read) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Series& series = family(name, help, Type::Gauge).series[renderLabels(labels)];
+    series.labels = labels;
+    series.gauge = std::move(read);
+}
+
+std::string MetricsRegistry::renderPrometheus() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::ostringstream out;
+    for (const auto& [name, f] : families_) {
+        out << "# HELP " << name << ' ' << f.help << '\n';
+        switch (f.type) {
+            case Type::Counter:
+                out << "# TYPE " << name << " counter\n";
+                for (const auto& [labels, series] : f.series) {
+                    out << name << labels << ' ' << series.counter->value() << '\n';
+                }
+                break;
+            case Type::Gauge:
+                out << "# TYPE " << name << " gauge\n";
+                for (const auto& [labels, series] : f.series) {
+                    out << name << labels << ' ' << formatNumber(series.gauge()) << '\n';
+                }
+                break;
+            case Type::Histogram:
+                out << "# TYPE " << name << " histogram\n";
+                for (const auto& [labels, series] : f.series) {
+                    const Histogram& h = *series.histogram;
+                    const size_t num_bounds = h.upperBounds().size();
+                    // _count is the +Inf bucket, so it agrees with the buckets even
+                    // while observe() runs concurrently
+                    uint64_t cumulative = 0;
+                    for (size_t b = 0; b <= num_bounds; ++b) {
+                        cumulative += h.bucketCount(b);
+                        const std::string le =
+                            b < num_bounds ? formatNumber(h.upperBounds()[b]) : "+Inf";
+                        out << name << "_bucket" << renderLabels(series.labels, "le=\"" + le + "\"")
+                            << ' ' << cumulative << '\n';
+                    }
+                    out << name << "_sum" << labels << ' ' << formatNumber(h.sum()) << '\n';
+                    out << name << "_count" << labels << ' ' << cumulative << '\n';
+                }
+                break;
+        }
+    }
+    return out.str();
+}
+
+} // namespace tumordtwin
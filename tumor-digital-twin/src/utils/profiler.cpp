@@ -0,0 +1,44 @@
+#include "utils/profiler.h"
+
+namespace tumordtwin {
+
+const char* profilePhaseName(ProfilePhase phase) {
+    switch (phase) {
+        case ProfilePhase::Diffusion:
+            return "diffusion";
+        case ProfilePhase::DrugTransport:
+            return "drug_transport";
+        case ProfilePhase::AgentUpdate:
+            return "agent_update";
+        case ProfilePhase::NeighborRebuild:
+            return "neighbor_rebuild";
+        case ProfilePhase::Lifecycle:
+            return "lifecycle";
+        case ProfilePhase::Checkpoint:
+            return "checkpoint";
+        case ProfilePhase::Snapshot:
+            return "snapshot";
+        case ProfilePhase::History:
+            return "history";
+        default:
+            return "unknown";
+    }
+}
+
+// ============================================================================
+// StepProfiler Implementation
+// ============================================================================
+
+void StepProfiler::toExtraMetrics(google::protobuf::Map<std::string, double>* metrics) const {
+    for (size_t p = 0; p < kNumProfilePhases; ++p) {
+        const PhaseStats& stats = phases_[p];
+        if (stats.calls == 0) {
+            continue;
+        }
+        const std::string name = profilePhaseName(static_cast<ProfilePhase>(p));
+        (*metrics)["profile." + name + "_ms"] =
+            static_cast<double>(stats.total_ns) / static_cast<double>(stats.calls) * 1e-6;
+    }
+}
+
+} // namespace tumordtwin
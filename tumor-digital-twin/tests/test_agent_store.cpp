@@ -0,0 +1,264 @@
+#include <catch2/catch_test_macros.hpp>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "simulation/agent_store.h"
+#include "simulation/simulation_engine.h"
+#include "simulation.pb.h"
+
+using namespace tumordtwin;
+
+TEST_CASE("GenotypeTable interns genotypes", "[agents][genotype]") {
+    GenotypeTable table;
+    REQUIRE(table.size() == 1);
+    REQUIRE(table.intern("") == GenotypeTable::kEmptyGenotype);
+
+    auto a = table.intern("KRAS:G12D");
+    auto b = table.intern("TP53:R175H");
+    REQUIRE(a != b);
+    REQUIRE(table.intern("KRAS:G12D") == a);
+    REQUIRE(table.get(b) == "TP53:R175H");
+    REQUIRE(table.get(9999).empty());
+
+    SECTION("Copies keep their own index") {
+        GenotypeTable copy = table;
+        table.clear();
+        REQUIRE(copy.intern("TP53:R175H") == b);
+        REQUIRE(copy.size() == 3);
+    }
+}
+
+TEST_CASE("GenotypeTable forks clones into a phylogeny", "[agents][genotype]") {
+    GenotypeTable table;
+    auto child = table.fork(GenotypeTable::kEmptyGenotype, 17);
+    auto grandchild = table.fork(child, 99);
+    REQUIRE(table.size() == 3);
+    REQUIRE(table.parent(child) == GenotypeTable::kEmptyGenotype);
+    REQUIRE(table.parent(grandchild) == child);
+    REQUIRE(table.fork(child, 99) == grandchild);
+
+    Genotype genotype;
+    REQUIRE(genotype.ParseFromString(table.get(grandchild)));
+    REQUIRE(genotype.mutation_positions_size() == 2);
+    REQUIRE(genotype.mutation_positions(0) == 17);
+    REQUIRE(genotype.mutation_positions(1) == 99);
+
+    // Hashes depend only on the bytes
+    GenotypeTable other;
+    REQUIRE(other.hash(other.intern(table.get(grandchild))) == table.hash(grandchild));
+    REQUIRE(table.hash(child) != table.hash(grandchild));
+
+    GenotypeTable copy = table;
+    REQUIRE(copy.parent(grandchild) == child);
+    REQUIRE(copy.hash(grandchild) == table.hash(grandchild));
+}
+
+TEST_CASE("SimulationEngine tracks subclones incrementally", "[agents][genotype][engine]") {
+    SimulationParameters params;
+    params.set_grid_size_x(24);
+    params.set_grid_size_y(24);
+    params.set_grid_size_z(24);
+    params.set_spatial_resolution(10.0);
+    params.set_time_step(0.1);
+    params.set_division_rate(0.5);
+    params.set_death_rate(0.05);
+    params.set_mutation_rate(0.2);
+    params.set_oxygen_diffusion_coeff(100.0);
+    params.set_glucose_diffusion_coeff(80.0);
+    (*params.mutable_extra_params())[SimulationEngine::kParamInitialTumorCells] = 300;
+    (*params.mutable_extra_params())[SimulationEngine::kParamInitialTCells] = 20;
+
+    SimulationEngine engine(params, 1);
+    engine.initialize();
+    const SimulationEngine& view = engine;
+    for (int step = 0; step < 30; ++step) {
+        engine.step();
+    }
+    REQUIRE(view.genotypes().size() > 1);
+
+    // The incremental counts match a scan of the population
+    std::vector<int64_t> scanned(view.genotypes().size(), 0);
+    for (size_t a = 0; a < view.agents().size(); ++a) {
+        if (view.agents().type(a) == CANCER_CELL) {
+            ++scanned[view.agents().genotypes()[a]];
+        }
+    }
+    std::vector<int64_t> counted = view.cloneCounts();
+    counted.resize(scanned.size(), 0);
+    REQUIRE(counted == scanned);
+
+    SimulationMetrics metrics;
+    view.computeMetrics(&metrics);
+    REQUIRE(metrics.subclones_size() > 1);
+    int64_t total = 0;
+    double frequency = 0.0;
+    for (const SubcloneInfo& subclone : metrics.subclones()) {
+        REQUIRE(subclone.genotype_hash().size() == 8);
+        REQUIRE(subclone.cell_count() > 0);
+        total += subclone.cell_count();
+        frequency += subclone.frequency();
+    }
+    REQUIRE(total == metrics.total_cancer_cells());
+    REQUIRE(std::abs(frequency - 1.0) < 1e-9);
+
+    // Every clone descends from the founding clone
+    for (GenotypeTable::GenotypeId id = 1; id < view.genotypes().size(); ++id) {
+        REQUIRE(view.genotypes().parent(id) < id);
+    }
+
+    SECTION("Mutable agent access recounts") {
+        engine.agents().genotypes()[0] = engine.genotypes().intern("TP53:R175H");
+        std::vector<int64_t> recounted = view.cloneCounts();
+        REQUIRE(recounted.back() == (view.agents().type(0) == CANCER_CELL ? 1 : 0));
+    }
+}
+
+TEST_CASE("AgentStore keeps columns consistent", "[agents][store]") {
+    AgentStore store;
+    for (int i = 0; i < 5; ++i) {
+        store.add(CANCER_CELL, i, 2.0 * i, 3.0 * i);
+    }
+    store.add(T_CELL, 10, 20, 30, QUIESCENT);
+
+    REQUIRE(store.size() == 6);
+    REQUIRE(store.countType(CANCER_CELL) == 5);
+    REQUIRE(store.countType(T_CELL) == 1);
+    REQUIRE(reinterpret_cast<uintptr_t>(store.x().data()) % 64 == 0);
+
+    // The T cell bucket precedes the cancer cells; the first cancer cell made room
+    REQUIRE(store.type(0) == T_CELL);
+    REQUIRE(store.x()[0] == 10.0);
+    REQUIRE(store.x()[5] == 0.0);
+
+    SECTION("Remove swaps the last agent into the hole") {
+        uint64_t last_id = store.ids().back();
+        REQUIRE_FALSE(store.remove(1));
+        REQUIRE(store.size() == 5);
+        REQUIRE(store.ids()[1] == last_id);
+        REQUIRE(store.type(1) == CANCER_CELL);
+        REQUIRE(store.x()[1] == 0.0);
+    }
+
+    SECTION("RemoveIf preserves order of survivors") {
+        size_t removed = store.removeIf([&](size_t i) { return store.x()[i] < 2.0; });
+        REQUIRE(removed == 2);
+        REQUIRE(store.size() == 4);
+        REQUIRE(store.type(0) == T_CELL);
+        REQUIRE(store.x()[1] == 2.0);
+        REQUIRE(store.y()[1] == 4.0);
+        REQUIRE(store.countType(CANCER_CELL) == 3);
+    }
+
+    SECTION("IDs are never reused") {
+        uint64_t next = store.nextId();
+        store.remove(0);
+        size_t index = store.add(MACROPHAGE, 0, 0, 0);
+        REQUIRE(store.ids()[index] == next);
+    }
+}
+
+namespace {
+
+// Every bucket is contiguous, in bucket order, and holds only its type
+void requirePartitioned(const AgentStore& store) {
+    size_t expected_begin = 0;
+    for (AgentType type : {AGENT_TYPE_UNSPECIFIED, T_CELL, MACROPHAGE, FIBROBLAST,
+                           ENDOTHELIAL, CANCER_CELL}) {
+        REQUIRE(store.bucketBegin(type) == expected_begin);
+        for (size_t a = store.bucketBegin(type); a < store.bucketEnd(type); ++a) {
+            REQUIRE(store.type(a) == type);
+        }
+        expected_begin = store.bucketEnd(type);
+    }
+    REQUIRE(expected_begin == store.size());
+}
+
+} // namespace
+
+TEST_CASE("AgentStore keeps agents partitioned by type", "[agents][store][buckets]") {
+    AgentStore store;
+    const AgentType pattern[] = {CANCER_CELL, T_CELL, CANCER_CELL, FIBROBLAST,
+                                 MACROPHAGE, CANCER_CELL, ENDOTHELIAL, T_CELL};
+    for (int i = 0; i < 40; ++i) {
+        store.add(pattern[i % 8], i, 0.0, 0.0);
+    }
+    requirePartitioned(store);
+    REQUIRE(store.countType(CANCER_CELL) == 15);
+    REQUIRE(store.countType(T_CELL) == 10);
+    REQUIRE(store.countType(AGENT_TYPE_UNSPECIFIED) == 0);
+
+    SECTION("Cancer cells are appended at the end of the store") {
+        size_t index = store.add(CANCER_CELL, 99.0, 0.0, 0.0);
+        REQUIRE(index == store.size() - 1);
+        requirePartitioned(store);
+    }
+
+    SECTION("Removing outside the last bucket moves later buckets down") {
+        const uint64_t removed = store.ids()[store.bucketBegin(T_CELL)];
+        REQUIRE(store.remove(store.bucketBegin(T_CELL)));
+        requirePartitioned(store);
+        REQUIRE(store.countType(T_CELL) == 9);
+        REQUIRE(store.size() == 39);
+        for (uint64_t id : store.ids()) {
+            REQUIRE(id != removed);
+        }
+    }
+
+    SECTION("RemoveIf keeps the partition") {
+        store.removeIf([&](size_t i) { return static_cast<int>(store.x()[i]) % 3 == 0; });
+        requirePartitioned(store);
+    }
+
+    SECTION("Columns written directly are re-partitioned stably") {
+        const size_t base = store.size();
+        store.resize(base + 3);
+        const AgentType appended[] = {T_CELL, CANCER_CELL, T_CELL};
+        for (size_t n = 0; n < 3; ++n) {
+            store.ids()[base + n] = 1000 + n;
+            store.types()[base + n] = static_cast<uint8_t>(appended[n]);
+        }
+        store.restoreBuckets();
+        requirePartitioned(store);
+        REQUIRE(store.ids()[store.bucketEnd(T_CELL) - 2] == 1000);
+        REQUIRE(store.ids()[store.bucketEnd(T_CELL) - 1] == 1002);
+        REQUIRE(store.ids().back() == 1001);
+    }
+}
+
+TEST_CASE("AgentStore round-trips through SimulationState", "[agents][proto]") {
+    GenotypeTable genotypes;
+    AgentStore store;
+    auto clone = genotypes.intern("EGFR:L858R");
+    store.add(MACROPHAGE, 7.0, 8.0, 9.0, QUIESCENT);
+    store.add(CANCER_CELL, 1.5, 2.5, 3.5, PROLIFERATING, 12.0, 0.25, clone);
+    store.add(CANCER_CELL, 4.0, 5.0, 6.0, APOPTOTIC, 30.0, 0.9, clone);
+
+    SimulationState state;
+    store.toProto(state.mutable_agents(), genotypes);
+
+    REQUIRE(state.agents_size() == 3);
+    REQUIRE(state.agents(0).genotype_data().empty());
+    REQUIRE(state.agents(1).genotype_data() == "EGFR:L858R");
+    REQUIRE(state.agents(2).state() == APOPTOTIC);
+    REQUIRE(state.agents(1).position().y() == 2.5);
+
+    GenotypeTable restored_genotypes;
+    AgentStore restored;
+    restored.fromProto(state.agents(), restored_genotypes);
+
+    REQUIRE(restored.size() == 3);
+    REQUIRE(restored.ids() == store.ids());
+    REQUIRE(restored.cyclePhases()[1] == 0.25);
+    REQUIRE(restored.genotypes()[1] == restored.genotypes()[2]);
+    REQUIRE(restored_genotypes.size() == 2);
+    REQUIRE(restored.nextId() == store.nextId());
+
+    SECTION("Agents from an unpartitioned state are sorted by type") {
+        state.mutable_agents()->SwapElements(0, 2);
+        restored.fromProto(state.agents(), restored_genotypes);
+        REQUIRE(restored.type(0) == MACROPHAGE);
+        REQUIRE(restored.ids()[1] == store.ids()[2]);
+        REQUIRE(restored.ids()[2] == store.ids()[1]);
+    }
+}
@@ -0,0 +1,214 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/catch_approx.hpp>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "simulation/brick_grid.h"
+#include "simulation/diffusion_solver.h"
+#include "simulation/simulation_engine.h"
+
+using namespace tumordtwin;
+using Catch::Approx;
+
+TEST_CASE("BrickGrid expands and collapses bricks on demand", "[brick_grid]") {
+    // 19 is not a multiple of 8, so the high bricks are partial
+    BrickGrid grid(19, 10, 9, 2.0, 1.0);
+    REQUIRE(grid.numBricks() == 3 * 2 * 2);
+    REQUIRE(grid.denseBricks() == 0);
+    REQUIRE(grid.value(18, 9, 8) == 1.0);
+    REQUIRE(grid.mean() == 1.0);
+
+    grid.at(17, 9, 8) = 4.0;
+    REQUIRE(grid.denseBricks() == 1);
+    REQUIRE(grid.value(17, 9, 8) == 4.0);
+    REQUIRE(grid.value(16, 9, 8) == 1.0);
+    REQUIRE(grid.mean() == Approx(1.0 + 3.0 / grid.size()));
+
+    SECTION("round trip through the flat layout") {
+        ScalarGrid dense;
+        grid.toDense(dense);
+        REQUIRE(dense.nx() == 19);
+        for (int k = 0; k < 9; ++k) {
+            for (int j = 0; j < 10; ++j) {
+                for (int i = 0; i < 19; ++i) {
+                    REQUIRE(dense.at(i, j, k) == grid.value(i, j, k));
+                }
+            }
+        }
+
+        // Ranges that start and end inside rows and bricks
+        std::vector<double> values(101);
+        const size_t first = dense.index(13, 9, 7);
+        grid.copyValues(first, values.size(), values.data());
+        for (size_t n = 0; n < values.size(); ++n) {
+            REQUIRE(values[n] == dense.data()[first + n]);
+        }
+
+        BrickGrid copy;
+        copy.fromDense(dense);
+        REQUIRE(copy.denseBricks() == 1);
+        REQUIRE(copy.value(17, 9, 8) == 4.0);
+
+        GridData proto;
+        grid.toProto(&proto, SubstanceType::OXYGEN);
+        ScalarGrid parsed;
+        REQUIRE(parsed.fromProto(proto));
+        REQUIRE(std::equal(parsed.data(), parsed.data() + parsed.size(), dense.data()));
+    }
+
+    SECTION("collapse respects the tolerance") {
+        grid.at(17, 9, 8) = 1.0 + 1e-9;
+        REQUIRE(grid.collapse(1e-12) == 0);
+        REQUIRE(grid.collapse(1e-6) == 1);
+        REQUIRE(grid.denseBricks() == 0);
+        REQUIRE(grid.value(17, 9, 8) == Approx(1.0));
+    }
+
+    SECTION("memory is dominated by dense bricks") {
+        const BrickGrid uniform(19, 10, 9, 2.0, 1.0);
+        REQUIRE(uniform.memoryBytes() < 64 * sizeof(double));
+        REQUIRE(grid.memoryBytes() >= uniform.memoryBytes() + BrickGrid::kBrickVoxels * sizeof(double));
+        grid.at(0, 0, 0) = 2.0;
+        grid.fill(0.5);
+        REQUIRE(grid.denseBricks() == 0);
+        REQUIRE(grid.value(0, 0, 0) == 0.5);
+    }
+}
+
+TEST_CASE("Sparse diffusion matches the dense solver", "[brick_grid][diffusion]") {
+    const int nx = 37, ny = 29, nz = 21;
+    const double h = 5.0;
+
+    DiffusionParams params;
+    params.diffusion_coeff = 20.0;
+    params.boundary_value = 1.0;
+    const double dt = 0.8 * DiffusionSolver::maxStableTimeStep(params.diffusion_coeff, h);
+
+    SECTION("Dirichlet with a local sink") {
+        params.boundary = BoundaryCondition::Dirichlet;
+    }
+    SECTION("Neumann with decay") {
+        params.boundary = BoundaryCondition::Neumann;
+        params.decay_rate = 0.01;
+    }
+
+    ScalarGrid dense(nx, ny, nz, h, 1.0);
+    ScalarGrid dense_uptake(nx, ny, nz, h);
+    BrickGrid sparse(nx, ny, nz, h, 1.0);
+    BrickGrid sparse_uptake(nx, ny, nz, h);
+    for (int k = 9; k < 12; ++k) {
+        for (int j = 13; j < 16; ++j) {
+            dense_uptake.at(18, j, k) = 0.4;
+            sparse_uptake.at(18, j, k) = 0.4;
+        }
+    }
+
+    DiffusionSolver dense_solver(1);
+    DiffusionSolver sparse_solver(1);
+    for (int step = 0; step < 12; ++step) {
+        dense_solver.step(dense, params, dt, &dense_uptake);
+        sparse_solver.step(sparse, params, dt, &sparse_uptake);
+    }
+
+    for (int k = 0; k < nz; ++k) {
+        for (int j = 0; j < ny; ++j) {
+            for (int i = 0; i < nx; ++i) {
+                REQUIRE(sparse.value(i, j, k) == Approx(dense.at(i, j, k)).margin(1e-13));
+            }
+        }
+    }
+    // The disturbance has spread only a few bricks after 12 steps
+    REQUIRE(sparse.denseBricks() < sparse.numBricks());
+    REQUIRE(sparse.denseBricks() > 0);
+}
+
+TEST_CASE("SimulationEngine runs on sparse fields", "[brick_grid][engine]") {
+    SimulationParameters params;
+    params.set_grid_size_x(48);
+    params.set_grid_size_y(48);
+    params.set_grid_size_z(48);
+    params.set_spatial_resolution(10.0);
+    params.set_time_step(0.1);
+    params.set_division_rate(0.5);
+    params.set_death_rate(0.05);
+    params.set_oxygen_diffusion_coeff(100.0);
+    params.set_glucose_diffusion_coeff(80.0);
+    (*params.mutable_extra_params())[SimulationEngine::kParamInitialTumorCells] = 100;
+    (*params.mutable_extra_params())[SimulationEngine::kParamSparseTolerance] = 0.0;
+
+    (*params.mutable_extra_params())[SimulationEngine::kParamSparseGrid] = 0;
+    SimulationEngine dense(params, 1);
+    (*params.mutable_extra_params())[SimulationEngine::kParamSparseGrid] = 1;
+    SimulationEngine sparse(params, 1);
+    dense.initialize();
+    sparse.initialize();
+    REQUIRE_FALSE(dense.usingSparseGrid());
+    REQUIRE(sparse.usingSparseGrid());
+
+    for (int step = 0; step < 8; ++step) {
+        dense.step();
+        sparse.step();
+    }
+
+    SimulationMetrics dense_metrics, sparse_metrics;
+    dense.computeMetrics(&dense_metrics);
+    sparse.computeMetrics(&sparse_metrics);
+    REQUIRE(sparse_metrics.total_cancer_cells() == dense_metrics.total_cancer_cells());
+    REQUIRE(sparse_metrics.avg_oxygen() == Approx(dense_metrics.avg_oxygen()).epsilon(1e-12));
+
+    // Snapshots carry the bricks, not an expanded copy
+    auto snapshot = sparse.snapshot();
+    REQUIRE(snapshot->oxygen.size() == 0);
+    REQUIRE(snapshot->grid(SubstanceType::OXYGEN) == nullptr);
+    const BrickGrid* oxygen = snapshot->sparseGrid(SubstanceType::OXYGEN);
+    REQUIRE(oxygen != nullptr);
+    REQUIRE(oxygen->denseBricks() < oxygen->numBricks());
+
+    // Dense access expands on demand; edits are picked up by the next step
+    const ScalarGrid& expanded = static_cast<const SimulationEngine&>(sparse).oxygen();
+    REQUIRE(expanded.at(24, 24, 24) == Approx(dense.oxygen().at(24, 24, 24)).margin(1e-13));
+    sparse.oxygen().at(1, 1, 1) = 0.5;
+    dense.oxygen().at(1, 1, 1) = 0.5;
+    dense.step();
+    sparse.step();
+    REQUIRE(sparse.snapshot()->sparse_oxygen.value(1, 1, 2) ==
+            Approx(dense.oxygen().at(1, 1, 2)).margin(1e-13));
+}
+
+TEST_CASE("BrickGrid reuses pooled brick storage", "[brick_grid][pool]") {
+    BrickGrid grid(64, 64, 64, 1.0);
+    for (int i = 0; i < 64; i += 8) {
+        grid.at(i, 0, 0) = 1.0;
+    }
+    REQUIRE(grid.denseBricks() == 8);
+    const size_t bytes = grid.memoryBytes();
+
+    // Expanding after a release takes blocks from the pool, not the heap
+    for (int round = 0; round < 10; ++round) {
+        grid.fill(0.0);
+        REQUIRE(grid.denseBricks() == 0);
+        for (int i = 0; i < 64; i += 8) {
+            grid.at(i, 8, 8) += 1.0;
+        }
+        REQUIRE(grid.memoryBytes() == bytes);
+    }
+
+    // Copies own their bricks
+    BrickGrid copy = grid;
+    copy.at(0, 8, 8) = 5.0;
+    REQUIRE(grid.value(0, 8, 8) == 1.0);
+    REQUIRE(copy.value(0, 8, 8) == 5.0);
+    REQUIRE(copy.value(56, 8, 8) == 1.0);
+
+    BlockPool<double, 4, 2> pool;
+    double* a = pool.acquire();
+    double* b = pool.acquire();
+    REQUIRE(pool.capacity() == 2);
+    pool.release(a);
+    REQUIRE(pool.acquire() == a);
+    REQUIRE(pool.inUse() == 2);
+    pool.acquire();
+    REQUIRE(pool.capacity() == 4);
+    (void)b;
+}
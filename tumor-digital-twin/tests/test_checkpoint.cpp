@@ -0,0 +1,314 @@
+#include <catch2/catch_test_macros.hpp>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+#include "storage/checkpoint.h"
+
+using namespace tumordtwin;
+
+namespace {
+
+SimulationParameters smallParameters() {
+    SimulationParameters params;
+    params.set_grid_size_x(24);
+    params.set_grid_size_y(20);
+    params.set_grid_size_z(16);
+    params.set_spatial_resolution(10.0);
+    params.set_num_steps(40);
+    params.set_time_step(0.1);
+    params.set_division_rate(0.5);
+    params.set_death_rate(0.05);
+    params.set_migration_rate(0.1);
+    params.set_mutation_rate(0.1);
+    params.set_oxygen_diffusion_coeff(100.0);
+    params.set_glucose_diffusion_coeff(80.0);
+    (*params.mutable_extra_params())[SimulationEngine::kParamInitialTumorCells] = 300;
+    (*params.mutable_extra_params())[SimulationEngine::kParamInitialTCells] = 20;
+    return params;
+}
+
+std::string tempPath(const std::string& name) {
+    return (std::filesystem::temp_directory_path() / ("tumordtwin_test_" + name)).string();
+}
+
+void requireSameState(const SimulationEngine& a, const SimulationEngine& b) {
+    REQUIRE(a.currentStep() == b.currentStep());
+    REQUIRE(a.oxygen().size() == b.oxygen().size());
+    for (size_t i = 0; i < a.oxygen().size(); ++i) {
+        REQUIRE(a.oxygen().data()[i] == b.oxygen().data()[i]);
+        REQUIRE(a.glucose().data()[i] == b.glucose().data()[i]);
+    }
+    REQUIRE(a.genotypes().size() == b.genotypes().size());
+    for (GenotypeTable::GenotypeId id = 0; id < a.genotypes().size(); ++id) {
+        REQUIRE(a.genotypes().parent(id) == b.genotypes().parent(id));
+    }
+    REQUIRE(a.cloneCounts() == b.cloneCounts());
+    REQUIRE(a.agents().size() == b.agents().size());
+    REQUIRE(a.agents().nextId() == b.agents().nextId());
+    for (size_t i = 0; i < a.agents().size(); ++i) {
+        REQUIRE(a.agents().ids()[i] == b.agents().ids()[i]);
+        REQUIRE(a.agents().x()[i] == b.agents().x()[i]);
+        REQUIRE(a.agents().states()[i] == b.agents().states()[i]);
+        REQUIRE(a.agents().cyclePhases()[i] == b.agents().cyclePhases()[i]);
+        REQUIRE(a.genotypes().get(a.agents().genotypes()[i]) ==
+                b.genotypes().get(b.agents().genotypes()[i]));
+    }
+}
+
+} // namespace
+
+TEST_CASE("Checkpoints restore the engine exactly", "[checkpoint]") {
+    const SimulationParameters params = smallParameters();
+    SimulationEngine original(params, 1);
+    original.initialize();
+    original.genotypes().intern("KRAS:G12D");
+    original.agents().genotypes()[0] = original.genotypes().intern("TP53:R175H");
+    for (int step = 0; step < 10; ++step) {
+        original.step();
+    }
+
+    SimulationState metadata;
+    metadata.set_simulation_id("sim-ckpt");
+    metadata.set_patient_id("patient-7");
+    metadata.set_current_step(original.currentStep());
+    *metadata.mutable_parameters() = params;
+
+    const std::string path = tempPath("restore.ckpt");
+    std::string error_msg;
+    REQUIRE(CheckpointWriter::write(path, metadata, original, error_msg));
+    REQUIRE(!std::filesystem::exists(path + ".tmp"));
+
+    CheckpointReader reader;
+    REQUIRE(reader.open(path, error_msg));
+    REQUIRE(reader.fileSize() % 64 == 0);
+    REQUIRE(reader.metadata().simulation_id() == "sim-ckpt");
+    REQUIRE(reader.metadata().patient_id() == "patient-7");
+    REQUIRE(reader.metadata().parameters().grid_size_x() == 24);
+
+    SimulationEngine restored(reader.metadata().parameters(), 1);
+    REQUIRE(reader.restore(restored, error_msg));
+    requireSameState(original, restored);
+
+    // The random stream continues where it left off, so both runs stay identical
+    for (int step = 0; step < 5; ++step) {
+        original.step();
+        restored.step();
+    }
+    requireSameState(original, restored);
+
+    SECTION("Parameters must match the stored grid") {
+        SimulationParameters other = params;
+        other.set_grid_size_x(12);
+        SimulationEngine mismatched(other, 1);
+        REQUIRE(!reader.restore(mismatched, error_msg));
+    }
+
+    std::remove(path.c_str());
+}
+
+TEST_CASE("Checkpoints carry the drug state", "[checkpoint][drug]") {
+    const SimulationParameters params = smallParameters();
+    TreatmentProtocol protocol;
+    Drug* drug = protocol.add_drugs();
+    drug->set_name("cisplatin");
+    drug->set_diffusion_coefficient(200.0);
+    drug->set_half_life(2.0);
+    DosingSchedule* schedule = protocol.add_schedules();
+    schedule->set_dose_amount(5.0);
+    schedule->set_start_time(0.5);
+    schedule->set_interval_hours(1.0);
+    schedule->set_num_doses(3);
+
+    SimulationEngine original(params, 1);
+    original.setTreatment(protocol);
+    original.initialize();
+    for (int step = 0; step < 10; ++step) {
+        original.step();
+    }
+    REQUIRE(original.drugs().active());
+
+    SimulationState metadata;
+    *metadata.mutable_parameters() = params;
+    *metadata.mutable_treatment() = protocol;
+    const std::string full_path = tempPath("drug.ckpt");
+    const std::string delta_path = tempPath("drug.ckpt.delta");
+    std::string error_msg;
+    REQUIRE(CheckpointWriter::write(full_path, metadata, original, error_msg));
+    CheckpointBaseline baseline;
+    baseline.capture(original);
+    for (int step = 0; step < 4; ++step) {
+        original.step();
+    }
+    REQUIRE(CheckpointWriter::writeDelta(delta_path, metadata, original, baseline, error_msg));
+
+    CheckpointReader full;
+    CheckpointReader delta;
+    REQUIRE(full.open(full_path, error_msg));
+    REQUIRE(delta.open(delta_path, error_msg));
+    SimulationEngine restored(params, 1);
+    restored.setTreatment(full.metadata().treatment());
+    REQUIRE(full.restore(restored, error_msg));
+    REQUIRE(delta.restore(restored, error_msg));
+    requireSameState(original, restored);
+    REQUIRE(restored.drugs().plasmaConcentration(0) == original.drugs().plasmaConcentration(0));
+    REQUIRE(restored.drugs().nextDoseTime() == original.drugs().nextDoseTime());
+
+    // The remaining dose is given once, at the same step, in both runs
+    for (int step = 0; step < 10; ++step) {
+        original.step();
+        restored.step();
+    }
+    requireSameState(original, restored);
+    REQUIRE(restored.drugs().plasmaConcentration(0) == original.drugs().plasmaConcentration(0));
+    REQUIRE(restored.drugs().concentration(0, 12, 10, 8) ==
+            original.drugs().concentration(0, 12, 10, 8));
+
+    SECTION("A checkpoint with drug state needs the same treatment") {
+        SimulationEngine untreated(params, 1);
+        REQUIRE(!full.restore(untreated, error_msg));
+    }
+
+    std::remove(full_path.c_str());
+    std::remove(delta_path.c_str());
+}
+
+TEST_CASE("CheckpointReader rejects damaged files", "[checkpoint][corrupt]") {
+    std::string error_msg;
+    CheckpointReader reader;
+
+    SECTION("Missing file") {
+        REQUIRE(!reader.open(tempPath("missing.ckpt"), error_msg));
+    }
+
+    SECTION("Not a checkpoint") {
+        const std::string path = tempPath("garbage.ckpt");
+        {
+            std::ofstream out(path, std::ios::binary);
+            out << std::string(4096, 'x');
+        }
+        REQUIRE(!reader.open(path, error_msg));
+        std::remove(path.c_str());
+    }
+
+    SECTION("Truncated checkpoint") {
+        SimulationEngine engine(smallParameters(), 1);
+        engine.initialize();
+        SimulationState metadata;
+        *metadata.mutable_parameters() = smallParameters();
+
+        const std::string path = tempPath("truncated.ckpt");
+        REQUIRE(CheckpointWriter::write(path, metadata, engine, error_msg));
+        std::filesystem::resize_file(path, std::filesystem::file_size(path) - 64);
+        REQUIRE(!reader.open(path, error_msg));
+        REQUIRE(!error_msg.empty());
+        std::remove(path.c_str());
+    }
+}
+
+TEST_CASE("Delta checkpoints store only what changed", "[checkpoint][delta]") {
+    const SimulationParameters params = smallParameters();
+    SimulationEngine engine(params, 1);
+    engine.initialize();
+    for (int step = 0; step < 3; ++step) {
+        engine.step();
+    }
+    SimulationState metadata;
+    *metadata.mutable_parameters() = params;
+
+    const std::string full_path = tempPath("delta_base.ckpt");
+    const std::string delta_path = tempPath("delta_base.ckpt.delta");
+    std::string error_msg;
+    REQUIRE(CheckpointWriter::write(full_path, metadata, engine, error_msg));
+    CheckpointBaseline baseline;
+    baseline.capture(engine);
+
+    // One changed voxel and one new genotype on an otherwise identical state
+    engine.oxygen().at(20, 3, 9) += 1.0;
+    engine.agents().genotypes()[0] = engine.genotypes().intern("EGFR:L858R");
+    REQUIRE(CheckpointWriter::writeDelta(delta_path, metadata, engine, baseline, error_msg));
+
+    CheckpointReader full;
+    CheckpointReader delta;
+    REQUIRE(full.open(full_path, error_msg));
+    REQUIRE(delta.open(delta_path, error_msg));
+    REQUIRE(delta.kind() == CheckpointKind::Delta);
+    REQUIRE(delta.parentStep() == full.step());
+    REQUIRE(delta.fileSize() * 4 < full.fileSize());
+
+    SimulationEngine restored(params, 1);
+    REQUIRE(full.restore(restored, error_msg));
+    REQUIRE(delta.restore(restored, error_msg));
+    requireSameState(engine, restored);
+
+    SECTION("A delta only applies on top of its parent") {
+        SimulationEngine fresh(params, 1);
+        fresh.initialize();
+        REQUIRE(!delta.restore(fresh, error_msg));
+    }
+
+    std::remove(full_path.c_str());
+    std::remove(delta_path.c_str());
+}
+
+TEST_CASE("CheckpointSeries replays deltas between full checkpoints", "[checkpoint][delta]") {
+    const SimulationParameters params = smallParameters();
+    SimulationEngine original(params, 1);
+    original.initialize();
+    SimulationState metadata;
+    *metadata.mutable_parameters() = params;
+
+    const std::string full_path = tempPath("series.ckpt");
+    CheckpointSeries::removeDeltas(full_path);
+    CheckpointSeries series(full_path, 3);
+    std::string error_msg;
+
+    // Full at step 2, then deltas at steps 4, 6 and 8
+    for (int checkpoint = 0; checkpoint < 4; ++checkpoint) {
+        original.step();
+        original.step();
+        metadata.set_current_step(original.currentStep());
+        REQUIRE(series.write(metadata, original, false, error_msg));
+    }
+    REQUIRE(series.deltasSinceFull() == 3);
+    REQUIRE(std::filesystem::exists(CheckpointSeries::deltaPath(full_path, 8)));
+
+    CheckpointChain chain;
+    REQUIRE(CheckpointSeries::open(full_path, chain, error_msg));
+    REQUIRE(chain.size() == 4);
+    REQUIRE(chain.back()->metadata().current_step() == 8);
+
+    SimulationEngine restored(params, 1);
+    for (const auto& reader : chain) {
+        REQUIRE(reader->restore(restored, error_msg));
+    }
+    requireSameState(original, restored);
+
+    // Continuing from the replayed chain matches the uninterrupted run
+    for (int step = 0; step < 5; ++step) {
+        original.step();
+        restored.step();
+    }
+    requireSameState(original, restored);
+
+    SECTION("Replay stops at a missing delta") {
+        std::remove(CheckpointSeries::deltaPath(full_path, 6).c_str());
+        REQUIRE(CheckpointSeries::open(full_path, chain, error_msg));
+        REQUIRE(chain.size() == 2);
+        REQUIRE(chain.back()->step() == 4);
+    }
+
+    SECTION("The compaction interval forces a full checkpoint") {
+        REQUIRE(series.write(metadata, original, false, error_msg));
+        REQUIRE(series.deltasSinceFull() == 0);
+        REQUIRE(!std::filesystem::exists(CheckpointSeries::deltaPath(full_path, 8)));
+
+        REQUIRE(CheckpointSeries::open(full_path, chain, error_msg));
+        REQUIRE(chain.size() == 1);
+        REQUIRE(chain.front()->step() == original.currentStep());
+    }
+
+    CheckpointSeries::removeDeltas(full_path);
+    std::remove(full_path.c_str());
+}
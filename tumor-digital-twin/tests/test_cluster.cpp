@@ -0,0 +1,514 @@
+#include <catch2/catch_test_macros.hpp>
+#include <grpcpp/grpcpp.h>
+#include <algorithm>
+#include <chrono>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "cluster.h"
+#include "grpc_server.h"
+#include "service.grpc.pb.h"
+#include "simulation/simulation_engine.h"
+
+using namespace tumordtwin;
+
+namespace {
+
+NodeStatus nodeLoad(const std::string& node_id, int core_budget, int cores_in_use,
+                    int queued_jobs, double queued_cost, double outstanding_cost) {
+    NodeStatus node;
+    node.set_node_id(node_id);
+    node.set_core_budget(core_budget);
+    node.set_cores_in_use(cores_in_use);
+    node.set_queued_jobs(queued_jobs);
+    node.set_queued_cost(queued_cost);
+    node.set_outstanding_cost(outstanding_cost);
+    return node;
+}
+
+SimulationRequest smallRequest(int num_steps, int num_threads) {
+    SimulationRequest request;
+    request.set_patient_id("cluster_patient");
+    request.set_simulation_name("Cluster Simulation");
+    auto* dicom = request.mutable_data()->mutable_dicom();
+    request.mutable_data()->set_patient_id("cluster_patient");
+    dicom->set_patient_id("cluster_patient");
+    dicom->set_dicom_archive("dummy_dicom_data");
+    dicom->set_modality("CT");
+
+    SimulationParameters* params = request.mutable_params();
+    params->set_grid_size_x(24);
+    params->set_grid_size_y(24);
+    params->set_grid_size_z(24);
+    params->set_spatial_resolution(10.0);
+    params->set_num_steps(num_steps);
+    params->set_time_step(0.1);
+    params->set_mutation_rate(0.001);
+    params->set_division_rate(0.1);
+    params->set_death_rate(0.05);
+    params->set_migration_rate(0.01);
+    params->set_oxygen_diffusion_coeff(1.0);
+    params->set_glucose_diffusion_coeff(0.8);
+    params->set_checkpoint_interval(0);
+    params->set_num_threads(num_threads);
+    (*params->mutable_extra_params())[SimulationEngine::kParamInitialTumorCells] = 100;
+    return request;
+}
+
+// Upload a small VCF for cluster_patient; empty on failure
+std::string upload(SimulationService::Stub& stub) {
+    grpc::ClientContext context;
+    UploadResponse response;
+    auto writer = stub.UploadPatientData(&context, &response);
+    PatientDataChunk chunk;
+    chunk.mutable_header()->set_patient_id("cluster_patient");
+    writer->Write(chunk);
+    chunk.Clear();
+    chunk.set_payload(UPLOAD_VCF);
+    chunk.set_data("##fileformat=VCFv4.2\n"
+                   "#CHROM\tPOS\tID\tREF\tALT\tQUAL\tFILTER\tINFO\tFORMAT\ttumor\n"
+                   "chr12\t25245350\t.\tC\tT\t60\tPASS\tAF=0.4\tGT\t0/1\n");
+    writer->Write(chunk);
+    writer->WritesDone();
+    return writer->Finish().ok() ? response.upload_id() : std::string();
+}
+
+std::unique_ptr<SimulationService::Stub> connect(const std::string& address) {
+    return SimulationService::NewStub(
+        grpc::CreateChannel(address, grpc::InsecureChannelCredentials()));
+}
+
+std::string start(SimulationService::Stub& stub, const SimulationRequest& request) {
+    grpc::ClientContext context;
+    SimulationResponse response;
+    return stub.StartSimulation(&context, request, &response).ok() ? response.simulation_id()
+                                                                   : std::string();
+}
+
+grpc::Status status(SimulationService::Stub& stub, const std::string& simulation_id,
+                    StatusResponse* response) {
+    grpc::ClientContext context;
+    StatusRequest request;
+    request.set_simulation_id(simulation_id);
+    return stub.GetSimulationStatus(&context, request, response);
+}
+
+template <typename Pred>
+bool waitFor(Pred pred, std::chrono::seconds timeout = std::chrono::seconds(30)) {
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (!pred()) {
+        if (std::chrono::steady_clock::now() > deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    return true;
+}
+
+// A coordinator and two nodes in this process
+struct TestCluster {
+    static constexpr const char* kCoordinator = "localhost:50061";
+    static constexpr const char* kNodeA = "localhost:50062";
+    static constexpr const char* kNodeB = "localhost:50063";
+
+    std::unique_ptr<GrpcServer> coordinator;
+    std::unique_ptr<GrpcServer> node_a;
+    std::unique_ptr<GrpcServer> node_b;
+
+    TestCluster() {
+        GrpcServerOptions coordinator_options;
+        coordinator_options.coordinator = true;
+        coordinator_options.heartbeat_ms = 100;
+        coordinator = std::make_unique<GrpcServer>(kCoordinator, "", coordinator_options);
+
+        GrpcServerOptions node_options;
+        node_options.join = kCoordinator;
+        node_options.heartbeat_ms = 100;
+        node_a = std::make_unique<GrpcServer>(kNodeA, "", node_options);
+        node_b = std::make_unique<GrpcServer>(kNodeB, "", node_options);
+    }
+
+    ~TestCluster() {
+        node_a->shutdown();
+        node_b->shutdown();
+        coordinator->shutdown();
+    }
+
+    bool start() {
+        return coordinator->start() && node_a->start() && node_b->start() &&
+               waitFor([this] {
+                   return coordinator->service().coordinator()->liveNodes().size() == 2;
+               });
+    }
+};
+
+} // namespace
+
+TEST_CASE("Coordinator places simulations on the least loaded node", "[cluster]") {
+    std::vector<NodeStatus> nodes = {
+        nodeLoad("small", 4, 4, 2, 200.0, 400.0),
+        nodeLoad("large", 16, 8, 0, 0.0, 800.0),
+    };
+
+    // 500 / 4 = 125 against 900 / 16 = 56.25 per core
+    REQUIRE(ClusterCoordinator::pickNode(nodes, 100.0) == 1);
+
+    // A node with the smaller backlog wins however much work is added
+    nodes[1].set_outstanding_cost(8000.0);
+    REQUIRE(ClusterCoordinator::pickNode(nodes, 100.0) == 0);
+
+    nodes[0].set_core_budget(0);
+    REQUIRE(ClusterCoordinator::pickNode(nodes, 100.0) == 1);
+    REQUIRE(ClusterCoordinator::pickNode({}, 100.0) == -1);
+}
+
+TEST_CASE("Idle nodes steal from the largest queue", "[cluster]") {
+    std::vector<NodeStatus> nodes = {
+        nodeLoad("busy", 4, 4, 3, 300.0, 700.0),
+        nodeLoad("busier", 4, 4, 5, 2000.0, 2400.0),
+        nodeLoad("idle", 8, 6, 0, 0.0, 600.0),
+    };
+
+    int thief = -1;
+    int victim = -1;
+    int max_jobs = 0;
+    REQUIRE(ClusterCoordinator::pickSteal(nodes, &thief, &victim, &max_jobs));
+    REQUIRE(thief == 2);
+    REQUIRE(victim == 1);
+    REQUIRE(max_jobs == 2);  // As many as it has idle cores
+
+    // A node with a queue is not idle, whatever its cores do
+    nodes[2].set_queued_jobs(1);
+    REQUIRE_FALSE(ClusterCoordinator::pickSteal(nodes, &thief, &victim, &max_jobs));
+
+    nodes[2].set_queued_jobs(0);
+    nodes[2].set_cores_in_use(8);
+    REQUIRE_FALSE(ClusterCoordinator::pickSteal(nodes, &thief, &victim, &max_jobs));
+}
+
+TEST_CASE("Cluster options are set by name", "[cluster]") {
+    GrpcServerOptions options;
+    std::string error;
+    REQUIRE(options.set("coordinator", "true", error));
+    REQUIRE(options.coordinator);
+    REQUIRE(options.set("join", "coord:50050", error));
+    REQUIRE(options.join == "coord:50050");
+    REQUIRE(options.set("advertise", "node1:50051", error));
+    REQUIRE(options.advertise == "node1:50051");
+    REQUIRE(options.set("heartbeat-ms", "250", error));
+    REQUIRE(options.heartbeat_ms == 250);
+
+    REQUIRE_FALSE(options.set("coordinator", "maybe", error));
+    REQUIRE_FALSE(options.set("join", "", error));
+    REQUIRE_FALSE(options.set("heartbeat-ms", "-1", error));
+
+    // Coordinator handlers block, so completion queues cannot serve them
+    options.join.clear();
+    options.mode = ServerMode::Async;
+    GrpcServer server("localhost:50064", "", options);
+    REQUIRE_FALSE(server.start());
+}
+
+TEST_CASE("Coordinator proxies requests to the node that owns a simulation", "[cluster]") {
+    TestCluster cluster;
+    REQUIRE(cluster.start());
+    auto coordinator = connect(TestCluster::kCoordinator);
+    ClusterCoordinator& placement = *cluster.coordinator->service().coordinator();
+
+    const std::string sim_id = start(*coordinator, smallRequest(20, 1));
+    REQUIRE_FALSE(sim_id.empty());
+    const std::string owner = placement.owner(sim_id);
+    REQUIRE((owner == TestCluster::kNodeA || owner == TestCluster::kNodeB));
+
+    // The owning node knows the simulation under the coordinator's ID
+    StatusResponse node_status;
+    REQUIRE(status(*connect(owner), sim_id, &node_status).ok());
+
+    REQUIRE(waitFor([&] {
+        StatusResponse response;
+        return status(*coordinator, sim_id, &response).ok() &&
+               response.status() == SimulationStatus::COMPLETED;
+    }));
+
+    SECTION("Lists are merged from every node") {
+        const std::string other_id = start(*connect(TestCluster::kNodeA), smallRequest(5, 1));
+        REQUIRE_FALSE(other_id.empty());
+
+        grpc::ClientContext context;
+        ListRequest request;
+        request.set_patient_id("cluster_patient");
+        SimulationList list;
+        REQUIRE(coordinator->ListSimulations(&context, request, &list).ok());
+        REQUIRE(list.total_count() == 2);
+        std::vector<std::string> ids;
+        for (const auto& summary : list.simulations()) {
+            ids.push_back(summary.simulation_id());
+        }
+        REQUIRE(std::count(ids.begin(), ids.end(), sim_id) == 1);
+        REQUIRE(std::count(ids.begin(), ids.end(), other_id) == 1);
+
+        // Simulations started on a node directly are found too
+        StatusResponse response;
+        REQUIRE(status(*coordinator, other_id, &response).ok());
+        REQUIRE(placement.owner(other_id) == TestCluster::kNodeA);
+    }
+
+    SECTION("Unknown simulations and uploads are refused") {
+        StatusResponse response;
+        REQUIRE(status(*coordinator, "missing", &response).error_code() ==
+                grpc::StatusCode::NOT_FOUND);
+
+        SimulationRequest request = smallRequest(5, 1);
+        request.clear_data();
+        request.set_upload_id("upload");
+        grpc::ClientContext context;
+        SimulationResponse started;
+        REQUIRE(coordinator->StartSimulation(&context, request, &started).error_code() ==
+                grpc::StatusCode::FAILED_PRECONDITION);
+    }
+
+    SECTION("A node refuses an ID it already has") {
+        SimulationRequest request = smallRequest(5, 1);
+        request.set_simulation_id(sim_id);
+        grpc::ClientContext context;
+        SimulationResponse started;
+        REQUIRE(connect(owner)->StartSimulation(&context, request, &started).error_code() ==
+                grpc::StatusCode::ALREADY_EXISTS);
+    }
+}
+
+TEST_CASE("Coordinator pages lists beyond one node page", "[cluster]") {
+    TestCluster cluster;
+    REQUIRE(cluster.start());
+    auto coordinator = connect(TestCluster::kCoordinator);
+    auto node_a = connect(TestCluster::kNodeA);
+    auto node_b = connect(TestCluster::kNodeB);
+
+    // More matches on one node than it serves in a page
+    SimulationRequest request = smallRequest(1, 1);
+    request.mutable_params()->set_grid_size_x(4);
+    request.mutable_params()->set_grid_size_y(4);
+    request.mutable_params()->set_grid_size_z(4);
+    (*request.mutable_params()->mutable_extra_params())[
+        SimulationEngine::kParamInitialTumorCells] = 1;
+    const int per_node[] = {SimulationServiceImpl::kMaxListLimit + 20, 10};
+    for (int node = 0; node < 2; ++node) {
+        for (int i = 0; i < per_node[node]; ++i) {
+            // A full queue drains quickly
+            REQUIRE(waitFor([&] { return !start(node == 0 ? *node_a : *node_b, request).empty(); }));
+        }
+    }
+    const int total = per_node[0] + per_node[1];
+
+    std::vector<std::string> ids;
+    for (int offset = 0; offset < total; offset += SimulationServiceImpl::kMaxListLimit) {
+        grpc::ClientContext context;
+        ListRequest list_request;
+        list_request.set_offset(offset);
+        list_request.set_limit(SimulationServiceImpl::kMaxListLimit);
+        SimulationList list;
+        REQUIRE(coordinator->ListSimulations(&context, list_request, &list).ok());
+        REQUIRE(list.total_count() == total);
+        REQUIRE(list.simulations_size() ==
+                std::min(total - offset, int{SimulationServiceImpl::kMaxListLimit}));
+        for (const auto& summary : list.simulations()) {
+            ids.push_back(summary.simulation_id());
+        }
+    }
+    std::sort(ids.begin(), ids.end());
+    REQUIRE(std::unique(ids.begin(), ids.end()) == ids.end());
+    REQUIRE(ids.size() == static_cast<size_t>(total));
+}
+
+TEST_CASE("Idle nodes take queued simulations from busy ones", "[cluster]") {
+    TestCluster cluster;
+    REQUIRE(cluster.start());
+    auto coordinator = connect(TestCluster::kCoordinator);
+    auto node_a = connect(TestCluster::kNodeA);
+    auto node_b = connect(TestCluster::kNodeB);
+
+    // Node A is filled by one wide run, so the ones after it queue up
+    const int cores = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    const std::string wide_id = start(*node_a, smallRequest(1000000, cores));
+    REQUIRE_FALSE(wide_id.empty());
+    REQUIRE(waitFor([&] {
+        StatusResponse response;
+        return status(*node_a, wide_id, &response).ok() &&
+               response.status() == SimulationStatus::RUNNING;
+    }));
+    std::vector<std::string> queued_ids;
+    for (int i = 0; i < 2; ++i) {
+        queued_ids.push_back(start(*node_a, smallRequest(1000000, 1)));
+        REQUIRE_FALSE(queued_ids.back().empty());
+    }
+
+    // Node B has every core idle and takes over as many under the same IDs
+    const auto moved = std::min<std::ptrdiff_t>(cores, 2);
+    std::vector<std::string> moved_ids;
+    REQUIRE(waitFor([&] {
+        moved_ids.clear();
+        StatusResponse response;
+        std::copy_if(queued_ids.begin(), queued_ids.end(), std::back_inserter(moved_ids),
+                     [&](const std::string& id) { return status(*node_b, id, &response).ok(); });
+        return static_cast<std::ptrdiff_t>(moved_ids.size()) == moved;
+    }));
+    for (const std::string& id : moved_ids) {
+        // Node A drops them once the coordinator confirms the move
+        StatusResponse response;
+        REQUIRE(waitFor([&] {
+            return status(*node_a, id, &response).error_code() == grpc::StatusCode::NOT_FOUND;
+        }));
+        REQUIRE(status(*coordinator, id, &response).ok());
+        REQUIRE(cluster.coordinator->service().coordinator()->owner(id) ==
+                TestCluster::kNodeB);
+    }
+
+    // Stops reach both nodes through the coordinator
+    queued_ids.push_back(wide_id);
+    for (const std::string& id : queued_ids) {
+        grpc::ClientContext context;
+        StopRequest request;
+        request.set_simulation_id(id);
+        StopResponse response;
+        REQUIRE(coordinator->StopSimulation(&context, request, &response).ok());
+        REQUIRE(response.success());
+    }
+    for (const std::string& id : queued_ids) {
+        REQUIRE(waitFor([&] {
+            StatusResponse response;
+            return status(*coordinator, id, &response).ok() &&
+                   response.status() == SimulationStatus::STOPPED;
+        }));
+    }
+}
+
+TEST_CASE("Simulations started from an upload stay on their node", "[cluster]") {
+    TestCluster cluster;
+    REQUIRE(cluster.start());
+    auto node_a = connect(TestCluster::kNodeA);
+    auto node_b = connect(TestCluster::kNodeB);
+
+    const int cores = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    const std::string wide_id = start(*node_a, smallRequest(1000000, cores));
+    REQUIRE_FALSE(wide_id.empty());
+    REQUIRE(waitFor([&] {
+        StatusResponse response;
+        return status(*node_a, wide_id, &response).ok() &&
+               response.status() == SimulationStatus::RUNNING;
+    }));
+
+    const std::string upload_id = upload(*node_a);
+    REQUIRE_FALSE(upload_id.empty());
+    SimulationRequest from_upload = smallRequest(1000000, 1);
+    from_upload.clear_data();
+    from_upload.set_upload_id(upload_id);
+    const std::string upload_sim = start(*node_a, from_upload);
+    REQUIRE_FALSE(upload_sim.empty());
+    const std::string inline_sim = start(*node_a, smallRequest(1000000, 1));
+    REQUIRE_FALSE(inline_sim.empty());
+
+    // The inline run moves; the one behind the upload keeps its place
+    REQUIRE(waitFor([&] {
+        StatusResponse response;
+        return status(*node_b, inline_sim, &response).ok();
+    }));
+    StatusResponse response;
+    REQUIRE(status(*node_a, upload_sim, &response).ok());
+    REQUIRE(response.status() == SimulationStatus::QUEUED);
+    REQUIRE(status(*node_b, upload_sim, &response).error_code() == grpc::StatusCode::NOT_FOUND);
+
+    for (const std::string& id : {wide_id, upload_sim, inline_sim}) {
+        grpc::ClientContext context;
+        StopRequest request;
+        request.set_simulation_id(id);
+        StopResponse stopped;
+        REQUIRE(connect(TestCluster::kCoordinator)->StopSimulation(&context, request, &stopped).ok());
+    }
+}
+
+TEST_CASE("Only the joined coordinator releases a node's queue", "[cluster]") {
+    // Nothing answers at the coordinator address; the test releases in its place
+    GrpcServerOptions options;
+    options.join = "localhost:50066";
+    options.heartbeat_ms = 100;
+    GrpcServer server("localhost:50065", "", options);
+    REQUIRE(server.start());
+    auto node = connect("localhost:50065");
+
+    const int cores = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    const std::string wide_id = start(*node, smallRequest(1000000, cores));
+    REQUIRE_FALSE(wide_id.empty());
+    REQUIRE(waitFor([&] {
+        StatusResponse response;
+        return status(*node, wide_id, &response).ok() &&
+               response.status() == SimulationStatus::RUNNING;
+    }));
+    std::vector<std::string> queued_ids;
+    for (int i = 0; i < 2; ++i) {
+        queued_ids.push_back(start(*node, smallRequest(1000000, 1)));
+        REQUIRE_FALSE(queued_ids.back().empty());
+    }
+
+    NodeStatus load;
+    server.service().nodeStatus(&load);
+    const std::string token = load.release_token();
+    REQUIRE_FALSE(token.empty());
+    auto queued = [&] {
+        NodeStatus current;
+        server.service().nodeStatus(&current);
+        return current.queued_jobs();
+    };
+    auto release = [&](const std::string& release_token, int hold_ms,
+                       ReleaseJobsResponse* response) {
+        grpc::ClientContext context;
+        ReleaseJobsRequest request;
+        request.set_max_jobs(2);
+        request.set_release_token(release_token);
+        request.set_hold_ms(hold_ms);
+        return node->ReleaseQueuedJobs(&context, request, response);
+    };
+    auto confirm = [&](const std::string& release_id, const std::string& moved_id) {
+        grpc::ClientContext context;
+        ConfirmReleaseRequest request;
+        request.set_release_token(token);
+        request.set_release_id(release_id);
+        request.add_moved_ids(moved_id);
+        ConfirmReleaseResponse response;
+        return node->ConfirmRelease(&context, request, &response);
+    };
+
+    ReleaseJobsResponse released;
+    REQUIRE(release("guessed", 60000, &released).error_code() ==
+            grpc::StatusCode::PERMISSION_DENIED);
+    REQUIRE(queued() == 2);
+
+    SECTION("Confirmed simulations are dropped, the others queued again") {
+        REQUIRE(release(token, 60000, &released).ok());
+        REQUIRE(released.requests_size() == 2);
+        REQUIRE(queued() == 0);
+
+        // The node answers for them until the move is confirmed
+        StatusResponse response;
+        REQUIRE(status(*node, queued_ids[1], &response).ok());
+        REQUIRE(response.status() == SimulationStatus::QUEUED);
+
+        REQUIRE(confirm(released.release_id(), queued_ids[1]).ok());
+        REQUIRE(status(*node, queued_ids[1], &response).error_code() ==
+                grpc::StatusCode::NOT_FOUND);
+        REQUIRE(status(*node, queued_ids[0], &response).ok());
+        REQUIRE(queued() == 1);
+    }
+
+    SECTION("Unconfirmed simulations return to the queue") {
+        REQUIRE(release(token, 200, &released).ok());
+        REQUIRE(queued() == 0);
+        REQUIRE(waitFor([&] { return queued() == 2; }));
+        REQUIRE(confirm(released.release_id(), queued_ids[1]).error_code() ==
+                grpc::StatusCode::NOT_FOUND);
+    }
+
+    server.shutdown();
+}
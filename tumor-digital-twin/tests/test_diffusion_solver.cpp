@@ -0,0 +1,290 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/catch_approx.hpp>
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <random>
+
+#include "simulation/diffusion_solver.h"
+#include "simulation/simulation_engine.h"
+
+using namespace tumordtwin;
+using Catch::Approx;
+
+namespace {
+
+// Straightforward reference implementation of one explicit step
+ScalarGrid referenceStep(const ScalarGrid& in, const DiffusionParams& params, double dt,
+                         const ScalarGrid* uptake) {
+    ScalarGrid out(in.nx(), in.ny(), in.nz(), in.spacing());
+    const double r = params.diffusion_coeff * dt / (in.spacing() * in.spacing());
+    for (int k = 0; k < in.nz(); ++k) {
+        for (int j = 0; j < in.ny(); ++j) {
+            for (int i = 0; i < in.nx(); ++i) {
+                bool face = i == 0 || j == 0 || k == 0 ||
+                            i == in.nx() - 1 || j == in.ny() - 1 || k == in.nz() - 1;
+                if (face && params.boundary == BoundaryCondition::Dirichlet) {
+                    out.at(i, j, k) = params.boundary_value;
+                    continue;
+                }
+                auto v = [&](int a, int b, int c) {
+                    a = std::clamp(a, 0, in.nx() - 1);
+                    b = std::clamp(b, 0, in.ny() - 1);
+                    c = std::clamp(c, 0, in.nz() - 1);
+                    return in.at(a, b, c);
+                };
+                double c = in.at(i, j, k);
+                double lap = v(i - 1, j, k) + v(i + 1, j, k) + v(i, j - 1, k) +
+                             v(i, j + 1, k) + v(i, j, k - 1) + v(i, j, k + 1) - 6.0 * c;
+                double sink = params.decay_rate + (uptake ? uptake->at(i, j, k) : 0.0);
+                out.at(i, j, k) = c + r * lap - dt * sink * c;
+            }
+        }
+    }
+    return out;
+}
+
+ScalarGrid randomGrid(int nx, int ny, int nz, unsigned seed) {
+    ScalarGrid grid(nx, ny, nz, 10.0);
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<double> dist(0.0, 1.0);
+    std::generate(grid.data(), grid.data() + grid.size(), [&] { return dist(rng); });
+    return grid;
+}
+
+double total(const ScalarGrid& grid) {
+    return std::accumulate(grid.data(), grid.data() + grid.size(), 0.0);
+}
+
+} // namespace
+
+TEST_CASE("DiffusionSolver matches the reference stencil", "[diffusion]") {
+    // Odd sizes exercise the vector remainder and partial tiles
+    const int nx = 37, ny = 21, nz = 40;
+    DiffusionParams params;
+    params.diffusion_coeff = 50.0;
+    params.decay_rate = 0.01;
+    params.boundary_value = 0.5;
+    const double dt = 0.2;
+
+    ScalarGrid uptake = randomGrid(nx, ny, nz, 7);
+
+    for (auto boundary : {BoundaryCondition::Dirichlet, BoundaryCondition::Neumann}) {
+        params.boundary = boundary;
+        for (const ScalarGrid* u : {static_cast<const ScalarGrid*>(nullptr),
+                                    static_cast<const ScalarGrid*>(&uptake)}) {
+            ScalarGrid field = randomGrid(nx, ny, nz, 3);
+            ScalarGrid expected = referenceStep(field, params, dt, u);
+
+            DiffusionSolver solver(2);
+            solver.step(field, params, dt, u);
+
+            for (size_t i = 0; i < field.size(); ++i) {
+                REQUIRE(field.data()[i] == Approx(expected.data()[i]).margin(1e-12));
+            }
+        }
+    }
+}
+
+TEST_CASE("DiffusionSolver conserves mass with zero-flux boundaries", "[diffusion][neumann]") {
+    ScalarGrid field(24, 24, 24, 5.0, 0.0);
+    field.at(12, 12, 12) = 1000.0;
+
+    DiffusionParams params;
+    params.diffusion_coeff = 1.0;
+    params.boundary = BoundaryCondition::Neumann;
+    const double dt = 0.9 * DiffusionSolver::maxStableTimeStep(params.diffusion_coeff, 5.0);
+
+    DiffusionSolver solver;
+    for (int step = 0; step < 50; ++step) {
+        solver.step(field, params, dt);
+    }
+
+    REQUIRE(total(field) == Approx(1000.0).epsilon(1e-10));
+    REQUIRE(field.at(12, 12, 12) < 1000.0);
+    REQUIRE(field.at(14, 12, 12) > 0.0);
+    REQUIRE(*std::min_element(field.data(), field.data() + field.size()) >= 0.0);
+}
+
+TEST_CASE("DiffusionSolver keeps a uniform Dirichlet field steady", "[diffusion][dirichlet]") {
+    ScalarGrid field(16, 16, 16, 10.0, 1.0);
+    DiffusionParams params;
+    params.diffusion_coeff = 2.0;
+    params.boundary_value = 1.0;
+
+    DiffusionSolver solver;
+    solver.step(field, params, 0.5);
+
+    for (size_t i = 0; i < field.size(); ++i) {
+        REQUIRE(field.data()[i] == Approx(1.0));
+    }
+}
+
+TEST_CASE("DiffusionSolver handles thin domains", "[diffusion][edge]") {
+    ScalarGrid field(32, 32, 1, 1.0, 0.0);
+    field.at(16, 16, 0) = 1.0;
+
+    DiffusionParams params;
+    params.diffusion_coeff = 0.1;
+    params.boundary = BoundaryCondition::Neumann;
+
+    DiffusionSolver solver;
+    solver.step(field, params, 1.0);
+
+    REQUIRE(total(field) == Approx(1.0));
+    REQUIRE(field.at(15, 16, 0) == Approx(0.1));
+}
+
+TEST_CASE("SimulationEngine couples uptake and diffusion", "[engine]") {
+    SimulationParameters params;
+    params.set_grid_size_x(40);
+    params.set_grid_size_y(40);
+    params.set_grid_size_z(40);
+    params.set_spatial_resolution(10.0);
+    params.set_num_steps(10);
+    params.set_time_step(0.1);
+    params.set_division_rate(0.1);
+    params.set_oxygen_diffusion_coeff(100.0);
+    params.set_glucose_diffusion_coeff(80.0);
+    (*params.mutable_extra_params())[SimulationEngine::kParamInitialTumorCells] = 200;
+
+    SimulationEngine engine(params, 1);
+    engine.initialize();
+    REQUIRE(engine.agents().size() == 200);
+
+    for (int step = 0; step < 10; ++step) {
+        engine.step();
+    }
+    REQUIRE(engine.currentStep() == 10);
+    REQUIRE(engine.currentTime() == Approx(1.0));
+
+    // Consumption at the tumor draws oxygen below the far-field value
+    REQUIRE(engine.oxygen().at(20, 20, 20) < 1.0);
+    REQUIRE(engine.oxygen().at(0, 0, 0) == 1.0);
+
+    SimulationMetrics metrics;
+    engine.computeMetrics(&metrics);
+    REQUIRE(metrics.step_number() == 10);
+    REQUIRE(metrics.total_cancer_cells() >= 200);  // No death, some divisions
+    REQUIRE(metrics.avg_oxygen() < 1.0);
+    REQUIRE(metrics.tumor_radius() > 0.0);
+}
+
+TEST_CASE("SimulationEngine gives the same results with use_gpu", "[engine][gpu]") {
+    SimulationParameters params;
+    params.set_grid_size_x(24);
+    params.set_grid_size_y(24);
+    params.set_grid_size_z(24);
+    params.set_spatial_resolution(10.0);
+    params.set_time_step(0.1);
+    params.set_division_rate(0.5);
+    params.set_death_rate(0.05);
+    params.set_oxygen_diffusion_coeff(100.0);
+    params.set_glucose_diffusion_coeff(80.0);
+    (*params.mutable_extra_params())[SimulationEngine::kParamInitialTumorCells] = 300;
+
+    SimulationEngine cpu(params, 1);
+    params.set_use_gpu(true);
+    SimulationEngine gpu(params, 1);
+    cpu.initialize();
+    gpu.initialize();
+    REQUIRE(gpu.usingGpu() == GpuBackend::isAvailable());
+
+    for (int step = 0; step < 10; ++step) {
+        cpu.step();
+        gpu.step();
+    }
+
+    SimulationMetrics cpu_metrics, gpu_metrics;
+    cpu.computeMetrics(&cpu_metrics);
+    gpu.computeMetrics(&gpu_metrics);
+    REQUIRE(gpu_metrics.avg_oxygen() == Approx(cpu_metrics.avg_oxygen()).epsilon(1e-12));
+    REQUIRE(gpu_metrics.avg_glucose() == Approx(cpu_metrics.avg_glucose()).epsilon(1e-12));
+
+    if (!gpu.usingGpu()) {
+        // The CPU fallback is the CPU path
+        REQUIRE(gpu.agents().size() == cpu.agents().size());
+        const auto& a = cpu.oxygen();
+        const auto& b = gpu.oxygen();
+        REQUIRE(std::equal(a.data(), a.data() + a.size(), b.data()));
+        return;
+    }
+
+    // Rounding differences may flip a threshold decision, so compare fields only
+    const auto& a = cpu.oxygen();
+    const auto& b = gpu.oxygen();
+    for (size_t n = 0; n < a.size(); ++n) {
+        REQUIRE(b.data()[n] == Approx(a.data()[n]).margin(1e-9));
+    }
+}
+
+TEST_CASE("DiffusionSolver::subSteps keeps explicit steps stable", "[diffusion][substeps]") {
+    DiffusionParams params;
+    params.diffusion_coeff = 100.0;
+    const double h = 10.0;
+
+    // 6 D / h^2 = 6 per time unit
+    REQUIRE(DiffusionSolver::subSteps(params, h, 0.1) == 1);
+    REQUIRE(DiffusionSolver::subSteps(params, h, 0.5) == 3);
+    REQUIRE(DiffusionSolver::subSteps(params, h, 0.5, 4.0) == 5);
+    params.decay_rate = 2.0;
+    REQUIRE(DiffusionSolver::subSteps(params, h, 0.5, 4.0) == 6);
+    REQUIRE(DiffusionSolver::subSteps(params, h, 1e9) == DiffusionSolver::kMaxSubSteps);
+
+    // Sub-cycling keeps a point sink bounded where one long step overshoots
+    params.decay_rate = 0.0;
+    params.boundary_value = 1.0;
+    const double dt = 1.0;
+    ScalarGrid uptake(12, 12, 12, h);
+    uptake.at(6, 6, 6) = 3.0;
+    ScalarGrid single(12, 12, 12, h, 1.0);
+    ScalarGrid cycled(12, 12, 12, h, 1.0);
+
+    DiffusionSolver solver(1);
+    solver.step(single, params, dt, &uptake);
+    const int n = DiffusionSolver::subSteps(params, h, dt, 3.0);
+    REQUIRE(n == 9);
+    for (int s = 0; s < n; ++s) {
+        solver.step(cycled, params, dt / n, &uptake);
+    }
+    REQUIRE(single.at(6, 6, 6) < 0.0);
+    REQUIRE(*std::min_element(cycled.data(), cycled.data() + cycled.size()) >= 0.0);
+    REQUIRE(*std::max_element(cycled.data(), cycled.data() + cycled.size()) <= 1.0);
+}
+
+TEST_CASE("SimulationEngine sub-cycles diffusion for long agent steps", "[engine][substeps]") {
+    SimulationParameters params;
+    params.set_grid_size_x(24);
+    params.set_grid_size_y(24);
+    params.set_grid_size_z(24);
+    params.set_spatial_resolution(10.0);
+    params.set_time_step(2.0);  // 12x the explicit limit for D = 100
+    params.set_division_rate(0.1);
+    params.set_oxygen_diffusion_coeff(100.0);
+    params.set_glucose_diffusion_coeff(80.0);
+    (*params.mutable_extra_params())[SimulationEngine::kParamInitialTumorCells] = 300;
+
+    SimulationEngine engine(params, 1);
+    engine.initialize();
+    for (int step = 0; step < 5; ++step) {
+        engine.step();
+    }
+    REQUIRE(engine.oxygenSubSteps() >= 12);
+    REQUIRE(engine.glucoseSubSteps() >= 10);
+
+    const ScalarGrid& oxygen = engine.oxygen();
+    for (size_t n = 0; n < oxygen.size(); ++n) {
+        REQUIRE(std::isfinite(oxygen.data()[n]));
+        REQUIRE(oxygen.data()[n] >= 0.0);
+        REQUIRE(oxygen.data()[n] <= 1.0);
+    }
+    REQUIRE(oxygen.at(12, 12, 12) < 1.0);
+
+    SECTION("a minimum can be requested") {
+        (*params.mutable_extra_params())[SimulationEngine::kParamMinDiffusionSubSteps] = 40;
+        SimulationEngine finer(params, 1);
+        finer.initialize();
+        finer.step();
+        REQUIRE(finer.oxygenSubSteps() == 40);
+    }
+}
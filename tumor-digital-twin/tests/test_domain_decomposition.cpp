@@ -0,0 +1,343 @@
+#include <catch2/catch_approx.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <map>
+#include <random>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "simulation/domain_decomposition.h"
+#include "simulation/simulation_engine.h"
+#include "simulation/slab_ranks.h"
+
+using namespace tumordtwin;
+
+namespace {
+
+// Run one callable per rank on its own thread, like ranks of an MPI job
+template <typename F>
+void runRanks(LocalSlabFabric& fabric, F&& body) {
+    std::vector<std::thread> threads;
+    for (int rank = 0; rank < fabric.numRanks(); ++rank) {
+        threads.emplace_back([&, rank] { body(rank, fabric.transport(rank)); });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+ScalarGrid randomField(int nx, int ny, int nz, double lo, double hi, unsigned seed) {
+    ScalarGrid field(nx, ny, nz, 10.0);
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<double> dist(lo, hi);
+    for (size_t i = 0; i < field.size(); ++i) {
+        field.data()[i] = dist(rng);
+    }
+    return field;
+}
+
+// Copy the planes a rank holds (owned and ghost) out of a global field
+void copySlab(const ScalarGrid& global, const SlabDomain& domain, ScalarGrid& local) {
+    domain.allocate(local);
+    for (int k = 0; k < local.nz(); ++k) {
+        const int global_k = domain.globalPlane(k);
+        for (int j = 0; j < local.ny(); ++j) {
+            for (int i = 0; i < local.nx(); ++i) {
+                local.at(i, j, k) = global.at(i, j, global_k);
+            }
+        }
+    }
+}
+
+SimulationParameters engineParameters(int num_ranks) {
+    SimulationParameters params;
+    params.set_grid_size_x(12);
+    params.set_grid_size_y(10);
+    params.set_grid_size_z(14);
+    params.set_spatial_resolution(10.0);
+    params.set_num_steps(6);
+    params.set_time_step(0.1);
+    params.set_oxygen_diffusion_coeff(1.0);
+    params.set_glucose_diffusion_coeff(0.8);
+    params.set_num_mpi_ranks(num_ranks);
+    (*params.mutable_extra_params())[SimulationEngine::kParamInitialTumorCells] = 300;
+    return params;
+}
+
+} // namespace
+
+TEST_CASE("SlabDecomposition balances planes across ranks", "[decomposition]") {
+    SlabDecomposition decomposition(10, 3);
+    REQUIRE(decomposition.extent(0).z_begin == 0);
+    REQUIRE(decomposition.extent(0).z_end == 4);
+    REQUIRE(decomposition.extent(1).z_end == 7);
+    REQUIRE(decomposition.extent(2).z_end == 10);
+
+    REQUIRE_FALSE(decomposition.extent(0).ghost_below);
+    REQUIRE(decomposition.extent(0).ghost_above);
+    REQUIRE(decomposition.extent(1).localPlanes() == 5);
+    REQUIRE(decomposition.extent(2).firstOwnedLocal() == 1);
+    REQUIRE_FALSE(decomposition.extent(2).ghost_above);
+
+    for (int rank = 0; rank < 3; ++rank) {
+        const SlabExtent extent = decomposition.extent(rank);
+        for (int k = extent.z_begin; k < extent.z_end; ++k) {
+            REQUIRE(decomposition.ownerOfPlane(k) == rank);
+        }
+    }
+    REQUIRE(decomposition.ownerOfZ(-5.0, 10.0) == 0);
+    REQUIRE(decomposition.ownerOfZ(69.9, 10.0) == 1);
+    REQUIRE(decomposition.ownerOfZ(70.0, 10.0) == 2);
+    REQUIRE(decomposition.ownerOfZ(1e9, 10.0) == 2);
+
+    std::string error_msg;
+    REQUIRE(SlabDecomposition::validate(10, 10, error_msg));
+    REQUIRE_FALSE(SlabDecomposition::validate(10, 11, error_msg));
+    REQUIRE_FALSE(SlabDecomposition::validate(10, 0, error_msg));
+}
+
+TEST_CASE("Slab diffusion matches the global solver exactly", "[decomposition][diffusion]") {
+    const int nx = 20;
+    const int ny = 18;
+    const std::vector<std::pair<int, int>> layouts = {{23, 1}, {23, 2}, {23, 3}, {23, 5}, {4, 3}};
+
+    for (BoundaryCondition boundary : {BoundaryCondition::Dirichlet, BoundaryCondition::Neumann}) {
+        DiffusionParams params;
+        params.diffusion_coeff = 100.0;
+        params.decay_rate = 0.01;
+        params.boundary_value = 0.5;
+        params.boundary = boundary;
+        const double dt = 0.1;
+        const int steps = 8;
+
+        for (auto [nz, num_ranks] : layouts) {
+            const ScalarGrid initial = randomField(nx, ny, nz, 0.0, 1.0, 7);
+            const ScalarGrid uptake = randomField(nx, ny, nz, 0.0, 0.2, 11);
+
+            ScalarGrid expected = initial;
+            DiffusionSolver serial(1);
+            for (int step = 0; step < steps; ++step) {
+                serial.step(expected, params, dt, &uptake);
+            }
+
+            LocalSlabFabric fabric(num_ranks);
+            ScalarGrid gathered;
+            runRanks(fabric, [&](int rank, SlabTransport& transport) {
+                SlabDomain domain(nx, ny, nz, initial.spacing(), transport);
+                ScalarGrid field;
+                ScalarGrid local_uptake;
+                copySlab(initial, domain, field);
+                copySlab(uptake, domain, local_uptake);
+
+                DiffusionSolver solver(1);
+                for (int step = 0; step < steps; ++step) {
+                    domain.diffuse(solver, field, params, dt, &local_uptake);
+                }
+                domain.gatherField(field, rank == 0 ? &gathered : nullptr);
+            });
+
+            INFO("nz " << nz << ", ranks " << num_ranks);
+            REQUIRE(gathered.size() == expected.size());
+            for (size_t i = 0; i < expected.size(); ++i) {
+                REQUIRE(gathered.data()[i] == expected.data()[i]);
+            }
+        }
+    }
+}
+
+TEST_CASE("Agents migrate to the rank owning their slab", "[decomposition][agents]") {
+    const int num_ranks = 3;
+    const int nz = 12;
+    const double spacing = 10.0;
+    LocalSlabFabric fabric(num_ranks);
+
+    std::vector<std::map<uint64_t, std::string>> received(num_ranks);
+    std::vector<bool> all_owned(num_ranks, false);
+    std::vector<size_t> left(num_ranks, 0);
+
+    runRanks(fabric, [&](int rank, SlabTransport& transport) {
+        SlabDomain domain(8, 8, nz, spacing, transport);
+        AgentStore agents;
+        GenotypeTable genotypes;
+        agents.setNextId(static_cast<uint64_t>(rank) * 1000 + 1);  // Disjoint ID ranges
+
+        // Every rank scatters agents over the whole domain
+        for (int i = 0; i < 30; ++i) {
+            const std::string genotype = "clone-" + std::to_string(rank) + "-" + std::to_string(i % 3);
+            agents.add(AgentType::CANCER_CELL, 5.0, 5.0, (i * 4.1) - 2.0,
+                       CellState::PROLIFERATING, 1.0 * i, 0.5, genotypes.intern(genotype));
+        }
+
+        left[rank] = domain.migrateAgents(agents, genotypes);
+
+        bool owned = true;
+        for (size_t i = 0; i < agents.size(); ++i) {
+            owned = owned && domain.ownsZ(agents.z()[i]);
+            received[rank][agents.ids()[i]] = genotypes.get(agents.genotypes()[i]);
+        }
+        all_owned[rank] = owned;
+    });
+
+    std::map<uint64_t, std::string> all;
+    for (int rank = 0; rank < num_ranks; ++rank) {
+        REQUIRE(all_owned[rank]);
+        REQUIRE(left[rank] > 0);
+        all.insert(received[rank].begin(), received[rank].end());
+    }
+    REQUIRE(all.size() == static_cast<size_t>(num_ranks * 30));
+    for (int rank = 0; rank < num_ranks; ++rank) {
+        for (int i = 0; i < 30; ++i) {
+            const uint64_t id = static_cast<uint64_t>(rank) * 1000 + 1 + i;
+            REQUIRE(all.at(id) == "clone-" + std::to_string(rank) + "-" + std::to_string(i % 3));
+        }
+    }
+}
+
+TEST_CASE("Slab collectives combine every rank", "[decomposition]") {
+    const int num_ranks = 3;
+    LocalSlabFabric fabric(num_ranks);
+    std::vector<std::string> broadcast(num_ranks);
+    std::vector<std::string> gathered;
+    std::vector<std::vector<double>> sums(num_ranks), maxima(num_ranks);
+
+    runRanks(fabric, [&](int rank, SlabTransport& transport) {
+        SlabDomain domain(4, 4, 6, 10.0, transport);
+        broadcast[rank] = domain.broadcast(rank == 0 ? "from rank 0" : "ignored");
+        std::vector<std::string> all = domain.gather(std::to_string(rank));
+        if (rank == 0) {
+            gathered = all;
+        } else {
+            REQUIRE(all.empty());
+        }
+        sums[rank] = {1.0, static_cast<double>(rank)};
+        domain.allReduceSum(sums[rank]);
+        maxima[rank] = {static_cast<double>(rank), -static_cast<double>(rank)};
+        domain.allReduceMax(maxima[rank]);
+    });
+
+    REQUIRE(gathered == std::vector<std::string>{"0", "1", "2"});
+    for (int rank = 0; rank < num_ranks; ++rank) {
+        REQUIRE(broadcast[rank] == "from rank 0");
+        REQUIRE(sums[rank] == std::vector<double>{3.0, 3.0});
+        REQUIRE(maxima[rank] == std::vector<double>{2.0, 0.0});
+    }
+}
+
+TEST_CASE("Slab fields gather into dense and sparse global fields", "[decomposition]") {
+    const int nx = 11, ny = 9, nz = 21;
+    // Random values in a corner, flat elsewhere, so most bricks collapse
+    ScalarGrid global(nx, ny, nz, 10.0, 1.0);
+    const ScalarGrid noise = randomField(nx, ny, nz, 0.0, 1.0, 3);
+    for (int k = 0; k < 10; ++k) {
+        for (int j = 0; j < 5; ++j) {
+            for (int i = 0; i < 5; ++i) {
+                global.at(i, j, k) = noise.at(i, j, k);
+            }
+        }
+    }
+
+    LocalSlabFabric fabric(4);
+    ScalarGrid dense;
+    BrickGrid sparse;
+    runRanks(fabric, [&](int rank, SlabTransport& transport) {
+        SlabDomain domain(nx, ny, nz, 10.0, transport);
+        ScalarGrid local;
+        copySlab(global, domain, local);
+        domain.gatherField(local, rank == 0 ? &dense : nullptr);
+        domain.gatherField(local, rank == 0 ? &sparse : nullptr, 0.0);
+    });
+
+    REQUIRE(dense.nz() == nz);
+    ScalarGrid expanded;
+    sparse.toDense(expanded);
+    for (size_t v = 0; v < global.size(); ++v) {
+        REQUIRE(dense.data()[v] == global.data()[v]);
+        REQUIRE(expanded.data()[v] == global.data()[v]);
+    }
+    // Only the bricks overlapping the noisy corner stay dense
+    REQUIRE(sparse.denseBricks() == 2);
+}
+
+TEST_CASE("A decomposed engine runs the model of a single engine", "[decomposition][engine]") {
+    // No division, death or migration: every step is deterministic, so the
+    // slabs must reproduce the single engine's fields and cell states exactly
+    SimulationEngine single(engineParameters(1), 1);
+    single.initialize();
+    SlabRanks ranks(engineParameters(3), 3);
+    SimulationEngine& rank0 = ranks.engine();
+    rank0.initialize();
+    REQUIRE(rank0.domain() != nullptr);
+    REQUIRE(rank0.domain()->decomposition().numRanks() == 3);
+
+    for (int s = 0; s < 6; ++s) {
+        single.step();
+        rank0.step();
+    }
+    auto gathered = rank0.snapshot();
+    REQUIRE(gathered);
+    REQUIRE(gathered->oxygen.nz() == single.oxygen().nz());
+    for (size_t v = 0; v < single.oxygen().size(); ++v) {
+        REQUIRE(gathered->oxygen.data()[v] == single.oxygen().data()[v]);
+        REQUIRE(gathered->glucose.data()[v] == single.glucose().data()[v]);
+    }
+
+    std::map<uint64_t, uint8_t> states;
+    for (size_t a = 0; a < single.agents().size(); ++a) {
+        states[single.agents().ids()[a]] = single.agents().states()[a];
+    }
+    REQUIRE(gathered->agents.size() == states.size());
+    for (size_t a = 0; a < gathered->agents.size(); ++a) {
+        REQUIRE(states.at(gathered->agents.ids()[a]) == gathered->agents.states()[a]);
+    }
+    // Rank 0 only holds its own slab's cells
+    REQUIRE(rank0.agents().size() < gathered->agents.size());
+
+    SimulationMetrics expected, actual;
+    single.computeMetrics(&expected);
+    rank0.computeMetrics(&actual);
+    REQUIRE(actual.step_number() == 6);
+    REQUIRE(actual.total_cancer_cells() == expected.total_cancer_cells());
+    REQUIRE(actual.total_cells() == expected.total_cells());
+    REQUIRE(actual.tumor_radius() == Catch::Approx(expected.tumor_radius()));
+    REQUIRE(actual.avg_oxygen() == Catch::Approx(expected.avg_oxygen()));
+    REQUIRE(actual.avg_glucose() == Catch::Approx(expected.avg_glucose()));
+    REQUIRE(actual.subclones_size() == 1);
+    REQUIRE(actual.subclones(0).cell_count() == expected.total_cancer_cells());
+}
+
+TEST_CASE("A decomposed run keeps every cell across migration and division",
+          "[decomposition][engine]") {
+    SimulationParameters params = engineParameters(4);
+    params.set_division_rate(2.0);
+    params.set_death_rate(0.05);
+    params.set_migration_rate(5.0);
+    params.set_mutation_rate(0.2);
+    (*params.mutable_extra_params())[SimulationEngine::kParamInitialTCells] = 20;
+
+    SlabRanks ranks(params, 4);
+    SimulationEngine& rank0 = ranks.engine();
+    rank0.initialize();
+    for (int s = 0; s < 8; ++s) {
+        rank0.step();
+        if (s % 3 != 2) {
+            continue;
+        }
+        auto snapshot = rank0.snapshot();
+        SimulationMetrics metrics;
+        rank0.computeMetrics(&metrics);
+        REQUIRE(static_cast<int64_t>(snapshot->agents.size()) == metrics.total_cells());
+
+        // IDs stay unique although every rank assigns them to its daughters
+        std::set<uint64_t> ids(snapshot->agents.ids().begin(), snapshot->agents.ids().end());
+        REQUIRE(ids.size() == snapshot->agents.size());
+
+        int64_t clone_cells = 0;
+        for (const SubcloneInfo& subclone : metrics.subclones()) {
+            clone_cells += subclone.cell_count();
+        }
+        REQUIRE(clone_cells == metrics.total_cancer_cells());
+        REQUIRE(static_cast<int64_t>(snapshot->agents.countType(AgentType::CANCER_CELL)) ==
+                metrics.total_cancer_cells());
+    }
+}
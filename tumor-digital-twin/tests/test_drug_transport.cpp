@@ -0,0 +1,300 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_floating_point.hpp>
+#include <cmath>
+#include <string>
+
+#include "simulation/drug_transport.h"
+#include "simulation/simulation_engine.h"
+
+using namespace tumordtwin;
+using Catch::Matchers::WithinAbs;
+using Catch::Matchers::WithinRel;
+
+namespace {
+
+TreatmentProtocol singleDrug(const std::string& mechanism, double start, double interval,
+                             int32_t doses, double amount = 2.0) {
+    TreatmentProtocol protocol;
+    protocol.set_protocol_name("test");
+    Drug* drug = protocol.add_drugs();
+    drug->set_name("doxorubicin");
+    drug->set_diffusion_coefficient(50.0);
+    drug->set_half_life(0.5);
+    drug->set_mechanism(mechanism);
+    (*drug->mutable_properties())[DrugTransport::kPropertyEmax] = 0.8;
+    (*drug->mutable_properties())[DrugTransport::kPropertyEc50] = 0.2;
+    (*drug->mutable_properties())[DrugTransport::kPropertyVolume] = 2.0;
+    DosingSchedule* schedule = protocol.add_schedules();
+    schedule->set_dose_amount(amount);
+    schedule->set_start_time(start);
+    schedule->set_interval_hours(interval);
+    schedule->set_num_doses(doses);
+    return protocol;
+}
+
+SimulationParameters engineParameters() {
+    SimulationParameters params;
+    params.set_grid_size_x(20);
+    params.set_grid_size_y(20);
+    params.set_grid_size_z(12);
+    params.set_spatial_resolution(10.0);
+    params.set_num_steps(40);
+    params.set_time_step(0.1);
+    params.set_division_rate(0.5);
+    params.set_death_rate(0.05);
+    params.set_migration_rate(0.1);
+    params.set_oxygen_diffusion_coeff(100.0);
+    params.set_glucose_diffusion_coeff(80.0);
+    (*params.mutable_extra_params())[SimulationEngine::kParamInitialTumorCells] = 300;
+    return params;
+}
+
+size_t countState(const SimulationEngine& engine, CellState state) {
+    size_t count = 0;
+    for (size_t a = 0; a < engine.agents().size(); ++a) {
+        count += engine.agents().state(a) == state;
+    }
+    return count;
+}
+
+} // namespace
+
+TEST_CASE("DrugTransport validates protocols", "[drug][validate]") {
+    std::string error_msg;
+    REQUIRE(DrugTransport::validate(TreatmentProtocol(), error_msg));
+    REQUIRE(DrugTransport::validate(singleDrug("", 0.0, 0.0, 1), error_msg));
+    REQUIRE(DrugTransport::validate(singleDrug("cytostatic", 0.0, 6.0, 4), error_msg));
+
+    TreatmentProtocol protocol = singleDrug("cytotoxic", 0.0, 6.0, 4);
+    SECTION("Unknown mechanism") {
+        protocol.mutable_drugs(0)->set_mechanism("antiangiogenic");
+    }
+    SECTION("Half life must be positive") {
+        protocol.mutable_drugs(0)->set_half_life(0.0);
+    }
+    SECTION("Negative diffusion") {
+        protocol.mutable_drugs(0)->set_diffusion_coefficient(-1.0);
+    }
+    SECTION("Cytostatic emax above one") {
+        protocol.mutable_drugs(0)->set_mechanism("cytostatic");
+        (*protocol.mutable_drugs(0)->mutable_properties())[DrugTransport::kPropertyEmax] = 1.5;
+    }
+    SECTION("Non-positive ec50") {
+        (*protocol.mutable_drugs(0)->mutable_properties())[DrugTransport::kPropertyEc50] = 0.0;
+    }
+    SECTION("Repeated doses without an interval") {
+        protocol.mutable_schedules(0)->set_interval_hours(0.0);
+    }
+    SECTION("Negative dose") {
+        protocol.mutable_schedules(0)->set_dose_amount(-1.0);
+    }
+    SECTION("Schedules without drugs") {
+        protocol.clear_drugs();
+    }
+    SECTION("More schedules than drugs") {
+        *protocol.add_drugs() = protocol.drugs(0);
+        protocol.add_schedules()->set_dose_amount(1.0);
+        protocol.add_schedules()->set_dose_amount(1.0);
+    }
+    error_msg.clear();
+    REQUIRE(!DrugTransport::validate(protocol, error_msg));
+    REQUIRE(!error_msg.empty());
+}
+
+TEST_CASE("DrugTransport doses by events and releases idle fields", "[drug][dosing]") {
+    const TreatmentProtocol protocol = singleDrug("cytotoxic", 1.0, 12.0, 2);
+    DrugTransport drugs;
+    drugs.configure(protocol, 16, 12, 10, 10.0);
+    drugs.reset(0.0, false);
+    DiffusionSolver solver(1);
+
+    REQUIRE(drugs.numDrugs() == 1);
+    REQUIRE(drugs.nextDoseTime() == 1.0);
+    REQUIRE(!drugs.active());
+
+    const double dt = 0.25;
+    double time = 0.0;
+    // Nothing exists before the first dose
+    for (; time + dt <= 1.0; time += dt) {
+        drugs.step(solver, time, dt);
+        REQUIRE(!drugs.active());
+        REQUIRE(drugs.meanConcentration(0) == 0.0);
+    }
+
+    // The dose due at 1.0 is given by the step starting there
+    drugs.step(solver, time, dt);
+    time += dt;
+    REQUIRE(drugs.active());
+    REQUIRE(drugs.nextDoseTime() == 13.0);
+    const double k = std::log(2.0) / 0.5;
+    REQUIRE_THAT(drugs.plasmaConcentration(0), WithinRel(1.0 * std::exp(-k * dt), 1e-12));
+
+    // Drug enters through the faces, so the boundary voxels see more than the center
+    REQUIRE(drugs.concentration(0, 0, 6, 5) > drugs.concentration(0, 8, 6, 5));
+    REQUIRE(drugs.concentration(0, 8, 6, 5) >= 0.0);
+    REQUIRE(drugs.meanConcentration(0) > 0.0);
+    REQUIRE(drugs.killRate(0, 6, 5) > 0.0);
+    REQUIRE(drugs.killRate(0, 6, 5) < 0.8);
+    REQUIRE(drugs.arrestFraction(0, 6, 5) == 0.0);
+
+    // Washed out long before the second dose
+    while (time + dt <= 13.0 && drugs.active()) {
+        drugs.step(solver, time, dt);
+        time += dt;
+    }
+    REQUIRE(!drugs.active());
+    REQUIRE(time < 13.0);
+    REQUIRE(drugs.plasmaConcentration(0) < DrugTransport::kDefaultNegligibleConcentration);
+
+    while (time + dt <= 13.0) {
+        drugs.step(solver, time, dt);
+        time += dt;
+    }
+    drugs.step(solver, time, dt);
+    REQUIRE(drugs.active());
+    REQUIRE(std::isinf(drugs.nextDoseTime()));
+}
+
+TEST_CASE("DrugTransport gives the doses a step spans", "[drug][dosing]") {
+    // Four doses within one long step all land in it
+    const TreatmentProtocol protocol = singleDrug("cytostatic", 0.0, 0.1, 4, 1.0);
+    DrugTransport drugs;
+    drugs.configure(protocol, 8, 8, 8, 10.0);
+    drugs.reset(0.0, false);
+    DiffusionSolver solver(1);
+
+    drugs.step(solver, 0.0, 0.5);
+    const double k = std::log(2.0) / 0.5;
+    REQUIRE_THAT(drugs.plasmaConcentration(0), WithinRel(4 * 0.5 * std::exp(-k * 0.5), 1e-12));
+    REQUIRE(std::isinf(drugs.nextDoseTime()));
+    REQUIRE(drugs.killRate(0, 0, 0) == 0.0);
+    REQUIRE(drugs.arrestFraction(0, 0, 0) > 0.0);
+    REQUIRE(drugs.arrestFraction(0, 0, 0) < 0.8);
+
+    SECTION("Resuming skips doses already given") {
+        DrugTransport resumed;
+        resumed.configure(protocol, 8, 8, 8, 10.0);
+        resumed.reset(0.2, false);
+        REQUIRE_THAT(resumed.nextDoseTime(), WithinAbs(0.2, 1e-12));
+        resumed.reset(0.25, false);
+        REQUIRE_THAT(resumed.nextDoseTime(), WithinAbs(0.3, 1e-12));
+        resumed.reset(0.35, false);
+        REQUIRE(std::isinf(resumed.nextDoseTime()));
+    }
+}
+
+TEST_CASE("Sparse drug fields match dense ones", "[drug][sparse]") {
+    const TreatmentProtocol protocol = singleDrug("cytotoxic", 0.0, 1.0, 3);
+    DrugTransport dense;
+    DrugTransport sparse;
+    dense.configure(protocol, 20, 18, 17, 10.0);
+    sparse.configure(protocol, 20, 18, 17, 10.0);
+    dense.reset(0.0, false);
+    sparse.reset(0.0, true);
+    DiffusionSolver solver(1);
+
+    for (int n = 0; n < 12; ++n) {
+        dense.step(solver, n * 0.25, 0.25);
+        sparse.step(solver, n * 0.25, 0.25);
+        REQUIRE(dense.active() == sparse.active());
+    }
+    REQUIRE_THAT(sparse.meanConcentration(0), WithinRel(dense.meanConcentration(0), 1e-9));
+    for (int k = 0; k < 17; k += 4) {
+        for (int i = 0; i < 20; i += 3) {
+            REQUIRE_THAT(sparse.concentration(0, i, 9, k),
+                         WithinAbs(dense.concentration(0, i, 9, k), 1e-12));
+        }
+    }
+
+    ScalarGrid dense_total;
+    BrickGrid sparse_total;
+    sparse.totalField(&dense_total, &sparse_total);
+    REQUIRE(dense_total.size() == 0);
+    REQUIRE(sparse_total.size() == 20u * 18u * 17u);
+    REQUIRE_THAT(sparse_total.value(3, 9, 16), WithinAbs(dense.concentration(0, 3, 9, 16), 1e-12));
+
+    SECTION("State round-trips between storages") {
+        DrugTransport restored;
+        restored.configure(protocol, 20, 18, 17, 10.0);
+        std::string error_msg;
+        REQUIRE(restored.loadState(sparse.saveState(), error_msg));
+        restored.reschedule(3.0, false);
+        REQUIRE(restored.active());
+        REQUIRE(restored.plasmaConcentration(0) == sparse.plasmaConcentration(0));
+        REQUIRE_THAT(restored.concentration(0, 7, 9, 4),
+                     WithinAbs(dense.concentration(0, 7, 9, 4), 1e-12));
+        REQUIRE(std::isinf(restored.nextDoseTime()));
+
+        DrugTransport other;
+        other.configure(protocol, 10, 18, 17, 10.0);
+        REQUIRE(!other.loadState(sparse.saveState(), error_msg));
+    }
+}
+
+TEST_CASE("SimulationEngine applies drug effects to cancer cells", "[drug][engine]") {
+    const SimulationParameters params = engineParameters();
+    SimulationEngine untreated(params, 1);
+    untreated.initialize();
+
+    SECTION("Undosed drugs leave the run unchanged") {
+        SimulationEngine treated(params, 1);
+        treated.setTreatment(singleDrug("cytotoxic", 100.0, 0.0, 1));
+        treated.initialize();
+        for (int step = 0; step < 10; ++step) {
+            untreated.step();
+            treated.step();
+        }
+        REQUIRE(!treated.drugs().active());
+        REQUIRE(treated.agents().size() == untreated.agents().size());
+        for (size_t a = 0; a < treated.agents().size(); ++a) {
+            REQUIRE(treated.agents().x()[a] == untreated.agents().x()[a]);
+            REQUIRE(treated.agents().states()[a] == untreated.agents().states()[a]);
+        }
+    }
+
+    SECTION("A cytotoxic drug kills cells") {
+        TreatmentProtocol protocol = singleDrug("cytotoxic", 0.0, 0.0, 1, 20.0);
+        protocol.mutable_drugs(0)->set_half_life(5.0);
+        protocol.mutable_drugs(0)->set_diffusion_coefficient(2000.0);
+        (*protocol.mutable_drugs(0)->mutable_properties())[DrugTransport::kPropertyEmax] = 5.0;
+        SimulationEngine treated(params, 1);
+        treated.setTreatment(protocol);
+        treated.initialize();
+        size_t killed = 0;
+        size_t baseline = 0;
+        for (int step = 0; step < 20; ++step) {
+            untreated.step();
+            treated.step();
+            killed += countState(treated, CellState::APOPTOTIC);
+            baseline += countState(untreated, CellState::APOPTOTIC);
+        }
+        REQUIRE(killed > 2 * baseline);
+
+        SimulationMetrics metrics;
+        treated.computeMetrics(&metrics);
+        REQUIRE(metrics.avg_drug_concentration() > 0.0);
+        REQUIRE(metrics.extra_metrics().at("drug.doxorubicin") == metrics.avg_drug_concentration());
+        REQUIRE(metrics.extra_metrics().at("plasma.doxorubicin") > 0.0);
+
+        auto snapshot = treated.snapshot();
+        const ScalarGrid* drug = snapshot->grid(SubstanceType::DRUG);
+        REQUIRE(drug != nullptr);
+        REQUIRE_THAT(drug->mean(), WithinRel(metrics.avg_drug_concentration(), 1e-12));
+        REQUIRE(untreated.snapshot()->grid(SubstanceType::DRUG) == nullptr);
+    }
+
+    SECTION("A cytostatic drug slows the cell cycle") {
+        TreatmentProtocol protocol = singleDrug("cytostatic", 0.0, 0.0, 1, 20.0);
+        protocol.mutable_drugs(0)->set_half_life(5.0);
+        protocol.mutable_drugs(0)->set_diffusion_coefficient(2000.0);
+        (*protocol.mutable_drugs(0)->mutable_properties())[DrugTransport::kPropertyEmax] = 1.0;
+        SimulationEngine treated(params, 1);
+        treated.setTreatment(protocol);
+        treated.initialize();
+        for (int step = 0; step < 20; ++step) {
+            untreated.step();
+            treated.step();
+        }
+        REQUIRE(treated.agents().size() < untreated.agents().size());
+    }
+}
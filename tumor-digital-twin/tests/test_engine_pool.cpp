@@ -0,0 +1,117 @@
+#include <catch2/catch_test_macros.hpp>
+#include <algorithm>
+#include <chrono>
+#include <future>
+#include <thread>
+
+#include "simulation/engine_pool.h"
+#include "simulation/simulation_engine.h"
+
+using namespace tumordtwin;
+
+namespace {
+
+SimulationParameters runParameters(int edge) {
+    SimulationParameters params;
+    params.set_grid_size_x(edge);
+    params.set_grid_size_y(edge);
+    params.set_grid_size_z(edge);
+    params.set_spatial_resolution(10.0);
+    params.set_num_steps(5);
+    params.set_time_step(0.1);
+    params.set_mutation_rate(0.01);
+    params.set_division_rate(0.5);
+    params.set_death_rate(0.05);
+    params.set_migration_rate(0.1);
+    params.set_oxygen_diffusion_coeff(1.0);
+    params.set_glucose_diffusion_coeff(0.8);
+    (*params.mutable_extra_params())[SimulationEngine::kParamInitialTumorCells] = 150;
+    (*params.mutable_extra_params())[SimulationEngine::kParamInitialTCells] = 10;
+    return params;
+}
+
+void waitReady(const EnginePool& pool) {
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(30);
+    while (!pool.ready() && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+bool sameField(const ScalarGrid& a, const ScalarGrid& b) {
+    return a.size() == b.size() && std::equal(a.data(), a.data() + a.size(), b.data());
+}
+
+} // namespace
+
+TEST_CASE("EnginePool without warm-up starts every run cold", "[engine_pool]") {
+    EnginePool pool;
+    REQUIRE(pool.ready());
+    {
+        EnginePool::Lease lease = pool.acquire(runParameters(8), 1);
+        REQUIRE_FALSE(lease.warm());
+        REQUIRE(lease->parameters().grid_size_x() == 8);
+    }
+    REQUIRE(pool.idle() == 0);
+}
+
+TEST_CASE("EnginePool hands out warm engines and takes them back", "[engine_pool]") {
+    EnginePool pool;
+    std::promise<void> release;
+    std::shared_future<void> released = release.get_future().share();
+    pool.warmUp(2, runParameters(12), 1, [released] { released.wait(); });
+
+    // Not ready while the completion callback runs
+    REQUIRE_FALSE(pool.ready());
+    release.set_value();
+    waitReady(pool);
+    REQUIRE(pool.ready());
+    REQUIRE(pool.capacity() == 2);
+    REQUIRE(pool.idle() == 2);
+
+    {
+        EnginePool::Lease first = pool.acquire(runParameters(12), 1);
+        EnginePool::Lease second = pool.acquire(runParameters(10), 1);
+        EnginePool::Lease third = pool.acquire(runParameters(12), 1);
+        REQUIRE(first.warm());
+        REQUIRE(second.warm());
+        REQUIRE_FALSE(third.warm());
+        REQUIRE(second->parameters().grid_size_x() == 10);
+        REQUIRE(pool.idle() == 0);
+    }
+    // Three engines returned, two kept
+    REQUIRE(pool.idle() == 2);
+}
+
+TEST_CASE("A rebound engine runs like a new one", "[engine_pool]") {
+    const SimulationParameters params = runParameters(12);
+
+    SimulationEngine fresh(params, 1);
+    fresh.initialize();
+
+    // An engine that ran on another lattice first
+    SimulationEngine reused(runParameters(20), 1);
+    reused.initialize();
+    reused.step();
+    reused.rebind(params, 1);
+    REQUIRE(reused.currentStep() == 0);
+    reused.initialize();
+
+    for (int s = 0; s < params.num_steps(); ++s) {
+        fresh.step();
+        reused.step();
+    }
+    REQUIRE(reused.agents().ids() == fresh.agents().ids());
+    REQUIRE(reused.agents().x() == fresh.agents().x());
+    REQUIRE(sameField(reused.oxygen(), fresh.oxygen()));
+    REQUIRE(sameField(reused.glucose(), fresh.glucose()));
+    REQUIRE(reused.profiler().stats(ProfilePhase::Diffusion).calls ==
+            fresh.profiler().stats(ProfilePhase::Diffusion).calls);
+}
+
+TEST_CASE("EnginePool stop cuts a warm-up short", "[engine_pool]") {
+    EnginePool pool;
+    pool.warmUp(1000, runParameters(8), 1);
+    pool.stop();
+    REQUIRE(pool.ready());
+    REQUIRE(pool.idle() < 1000);
+}
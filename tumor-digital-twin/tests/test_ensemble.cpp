@@ -0,0 +1,383 @@
+#include <catch2/catch_test_macros.hpp>
+#include <algorithm>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "data/patient_cache.h"
+#include "simulation/ensemble.h"
+#include "simulation/simulation_engine.h"
+#include "simulation/simulation_snapshot.h"
+
+using namespace tumordtwin;
+
+namespace {
+
+SimulationParameters baseParameters() {
+    SimulationParameters params;
+    params.set_grid_size_x(16);
+    params.set_grid_size_y(16);
+    params.set_grid_size_z(16);
+    params.set_spatial_resolution(10.0);
+    params.set_num_steps(4);
+    params.set_time_step(0.1);
+    params.set_mutation_rate(0.01);
+    params.set_division_rate(0.5);
+    params.set_death_rate(0.05);
+    params.set_migration_rate(0.1);
+    params.set_oxygen_diffusion_coeff(1.0);
+    params.set_glucose_diffusion_coeff(0.8);
+    (*params.mutable_extra_params())[SimulationEngine::kParamInitialTumorCells] = 200;
+    (*params.mutable_extra_params())[SimulationEngine::kParamInitialTCells] = 20;
+    return params;
+}
+
+PatientData patientData() {
+    PatientData data;
+    data.set_patient_id("ensemble_patient");
+    auto* vcf = data.mutable_vcf();
+    vcf->set_sample_id("tumor");
+    const double frequencies[] = {0.45, 0.2, 0.1};
+    for (int m = 0; m < 3; ++m) {
+        Mutation* mutation = vcf->add_mutations();
+        mutation->set_chromosome("chr1");
+        mutation->set_position(1000 + m);
+        mutation->set_reference_allele("A");
+        mutation->set_alternate_allele("T");
+        mutation->set_allele_frequency(frequencies[m]);
+    }
+    return data;
+}
+
+EnsembleRequest ensembleRequest() {
+    EnsembleRequest request;
+    SimulationRequest* base = request.mutable_base();
+    base->set_patient_id("ensemble_patient");
+    base->set_simulation_name("Sweep");
+    *base->mutable_params() = baseParameters();
+    base->mutable_treatment()->set_protocol_name("baseline");
+    return request;
+}
+
+bool sameField(const ScalarGrid& a, const ScalarGrid& b) {
+    return a.size() == b.size() && std::equal(a.data(), a.data() + a.size(), b.data());
+}
+
+class TempDirectory {
+public:
+    TempDirectory()
+        : path_((std::filesystem::temp_directory_path() / "tumordtwin_test_ensemble").string()) {
+        std::filesystem::remove_all(path_);
+    }
+    ~TempDirectory() { std::filesystem::remove_all(path_); }
+
+    const std::string& path() const { return path_; }
+
+private:
+    std::string path_;
+};
+
+} // namespace
+
+TEST_CASE("EnsemblePlan expands members and the parameter grid", "[ensemble]") {
+    EnsembleRequest request = ensembleRequest();
+    std::vector<EnsembleMemberSpec> members;
+    std::string error_msg;
+
+    SECTION("The base request alone is one member") {
+        REQUIRE(EnsemblePlan::expand(request, &members, error_msg));
+        REQUIRE(members.size() == 1);
+        CHECK(members[0].name == "Sweep");
+        CHECK(members[0].params.division_rate() == 0.5);
+        CHECK(members[0].treatment.protocol_name() == "baseline");
+    }
+
+    SECTION("Every member is crossed with every grid point, last axis fastest") {
+        EnsembleMember* control = request.add_members();
+        control->set_name("control");
+        EnsembleMember* treated = request.add_members();
+        treated->set_name("treated");
+        (*treated->mutable_overrides())["death_rate"] = 0.2;
+        (*treated->mutable_overrides())["extra_params.t_cell_kill_rate"] = 0.9;
+        treated->mutable_treatment()->set_protocol_name("high dose");
+
+        ParameterAxis* division = request.add_grid();
+        division->set_parameter("division_rate");
+        division->add_values(0.1);
+        division->add_values(0.3);
+        ParameterAxis* steps = request.add_grid();
+        steps->set_parameter("num_steps");
+        steps->add_values(2);
+        steps->add_values(3);
+        steps->add_values(4);
+
+        REQUIRE(EnsemblePlan::expand(request, &members, error_msg));
+        REQUIRE(members.size() == 12);
+
+        CHECK(members[0].name == "Sweep [control, division_rate=0.1, num_steps=2]");
+        CHECK(members[1].params.num_steps() == 3);
+        CHECK(members[3].params.division_rate() == 0.3);
+        CHECK(members[3].params.num_steps() == 2);
+        CHECK(members[5].params.death_rate() == 0.05);
+        CHECK(members[5].treatment.protocol_name() == "baseline");
+
+        const EnsembleMemberSpec& last = members[11];
+        CHECK(last.name == "Sweep [treated, division_rate=0.3, num_steps=4]");
+        CHECK(last.params.death_rate() == 0.2);
+        CHECK(last.params.extra_params().at("t_cell_kill_rate") == 0.9);
+        CHECK(last.treatment.protocol_name() == "high dose");
+        // Untouched parameters come from the base
+        CHECK(last.params.grid_size_x() == 16);
+        CHECK(last.params.mutation_rate() == 0.01);
+    }
+
+    SECTION("Grid values win over member overrides") {
+        (*request.add_members()->mutable_overrides())["division_rate"] = 0.9;
+        ParameterAxis* axis = request.add_grid();
+        axis->set_parameter("division_rate");
+        axis->add_values(0.2);
+        REQUIRE(EnsemblePlan::expand(request, &members, error_msg));
+        REQUIRE(members.size() == 1);
+        CHECK(members[0].params.division_rate() == 0.2);
+    }
+
+    SECTION("Unknown parameters are rejected") {
+        (*request.add_members()->mutable_overrides())["division_rat"] = 0.2;
+        CHECK_FALSE(EnsemblePlan::expand(request, &members, error_msg));
+        CHECK(error_msg == "Member 0: Unknown parameter division_rat");
+    }
+
+    SECTION("Integer fields take integral values only") {
+        ParameterAxis* axis = request.add_grid();
+        axis->set_parameter("num_steps");
+        axis->add_values(2.5);
+        CHECK_FALSE(EnsemblePlan::expand(request, &members, error_msg));
+        CHECK(error_msg == "Parameter num_steps must be an integer");
+    }
+
+    SECTION("Empty and repeated axes are rejected") {
+        ParameterAxis* axis = request.add_grid();
+        axis->set_parameter("death_rate");
+        CHECK_FALSE(EnsemblePlan::expand(request, &members, error_msg));
+
+        axis->add_values(0.1);
+        *request.add_grid() = *axis;
+        CHECK_FALSE(EnsemblePlan::expand(request, &members, error_msg));
+        CHECK(error_msg == "Parameter death_rate appears in the grid twice");
+    }
+
+    SECTION("Ensembles are bounded") {
+        for (const char* name : {"division_rate", "death_rate", "migration_rate"}) {
+            ParameterAxis* axis = request.add_grid();
+            axis->set_parameter(name);
+            for (int v = 0; v < 11; ++v) {
+                axis->add_values(0.01 * v);
+            }
+        }
+        CHECK_FALSE(EnsemblePlan::expand(request, &members, error_msg));
+    }
+
+    SECTION("Bool fields and extra parameters are settable") {
+        SimulationParameters params;
+        REQUIRE(EnsemblePlan::applyOverride(&params, "use_gpu", 1.0, error_msg));
+        CHECK(params.use_gpu());
+        REQUIRE(EnsemblePlan::applyOverride(&params, "extra_params.random_seed", 7.0, error_msg));
+        CHECK(params.extra_params().at("random_seed") == 7.0);
+        CHECK_FALSE(EnsemblePlan::applyOverride(&params, "extra_params.", 1.0, error_msg));
+        CHECK_FALSE(EnsemblePlan::applyOverride(&params, "extra_params", 1.0, error_msg));
+    }
+}
+
+TEST_CASE("Engines forked from an initial state run like freshly initialized ones",
+          "[ensemble][engine]") {
+    PatientModel model;
+    std::string error_msg;
+    REQUIRE(PatientModel::build(patientData(), &model, error_msg));
+
+    SimulationParameters params = baseParameters();
+    SimulationParameters varied = params;
+    varied.set_division_rate(0.9);
+    varied.set_death_rate(0.2);
+    varied.set_num_steps(10);
+
+    SECTION("Only initialize() inputs enter the key") {
+        CHECK(SimulationEngine::initialStateKey(params) ==
+              SimulationEngine::initialStateKey(varied));
+
+        SimulationParameters seeded = params;
+        (*seeded.mutable_extra_params())[SimulationEngine::kParamRandomSeed] = 7;
+        CHECK(SimulationEngine::initialStateKey(params) !=
+              SimulationEngine::initialStateKey(seeded));
+        SimulationParameters larger = params;
+        larger.set_grid_size_z(32);
+        CHECK(SimulationEngine::initialStateKey(params) !=
+              SimulationEngine::initialStateKey(larger));
+    }
+
+    SECTION("A fork continues the same trajectory") {
+        SimulationEngine base(params);
+        base.initialize(model);
+
+        SimulationEngine direct(varied);
+        direct.initialize(model);
+        SimulationEngine forked(varied);
+        forked.initialize(base);
+
+        for (int s = 0; s < 5; ++s) {
+            direct.step();
+            forked.step();
+        }
+        REQUIRE(forked.agents().size() == direct.agents().size());
+        CHECK(forked.agents().x() == direct.agents().x());
+        CHECK(forked.agents().genotypes() == direct.agents().genotypes());
+        CHECK(forked.genotypes().size() == direct.genotypes().size());
+        CHECK(forked.cloneCounts() == direct.cloneCounts());
+        CHECK(sameField(forked.oxygen(), direct.oxygen()));
+        CHECK(forked.rngState() == direct.rngState());
+
+        // The base is untouched by its forks
+        CHECK(base.currentStep() == 0);
+        CHECK(base.agents().size() == 220);
+    }
+
+    SECTION("Sparse fields are forked too") {
+        (*params.mutable_extra_params())[SimulationEngine::kParamSparseGrid] = 1;
+        (*varied.mutable_extra_params())[SimulationEngine::kParamSparseGrid] = 1;
+        SimulationEngine base(params);
+        base.initialize(model);
+        SimulationEngine direct(varied);
+        direct.initialize(model);
+        SimulationEngine forked(varied);
+        forked.initialize(base);
+        REQUIRE(forked.usingSparseGrid());
+
+        for (int s = 0; s < 3; ++s) {
+            direct.step();
+            forked.step();
+        }
+        CHECK(forked.agents().x() == direct.agents().x());
+        CHECK(sameField(forked.oxygen(), direct.oxygen()));
+    }
+}
+
+TEST_CASE("SharedInitialState seeds once for all members", "[ensemble]") {
+    TempDirectory directory;
+    PatientCache cache(directory.path());
+    auto patient = std::make_shared<const PatientData>(patientData());
+    const SimulationParameters params = baseParameters();
+    std::string error_msg;
+
+    SECTION("Members share one base that is released after the last copy") {
+        SharedInitialState initial(patient, params, 3);
+        std::vector<std::unique_ptr<SimulationEngine>> engines;
+        for (int m = 0; m < 3; ++m) {
+            engines.push_back(std::make_unique<SimulationEngine>(params));
+            REQUIRE(initial.initialize(*engines.back(), cache, 1, error_msg));
+            CHECK(initial.holdsBase() == (m < 2));
+        }
+        CHECK(cache.stats().misses == 1);
+        CHECK(cache.stats().hits == 0);
+        for (const auto& engine : engines) {
+            CHECK(engine->agents().x() == engines[0]->agents().x());
+            CHECK(engine->genotypes().size() == 4);
+        }
+    }
+
+    SECTION("A lone member initializes without a base") {
+        SharedInitialState initial(patient, params, 1);
+        SimulationEngine engine(params);
+        REQUIRE(initial.initialize(engine, cache, 1, error_msg));
+        CHECK_FALSE(initial.holdsBase());
+
+        SimulationEngine direct(params);
+        direct.initialize(*cache.get(*patient, error_msg));
+        CHECK(engine.agents().x() == direct.agents().x());
+    }
+
+    SECTION("Concurrent members wait for one build") {
+        SharedInitialState initial(patient, params, 4);
+        std::vector<std::unique_ptr<SimulationEngine>> engines;
+        for (int m = 0; m < 4; ++m) {
+            engines.push_back(std::make_unique<SimulationEngine>(params));
+        }
+        std::vector<std::thread> threads;
+        std::vector<int> ok(4, 0);
+        for (int m = 0; m < 4; ++m) {
+            threads.emplace_back([&, m]() {
+                std::string thread_error;
+                ok[m] = initial.initialize(*engines[m], cache, 1, thread_error);
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        CHECK(ok == std::vector<int>(4, 1));
+        CHECK(cache.stats().misses == 1);
+        CHECK_FALSE(initial.holdsBase());
+    }
+
+    SECTION("A failed build fails every member") {
+        PatientData broken = patientData();
+        broken.mutable_genomic_sequences()->set_bam_data("not a bam file");
+        SharedInitialState initial(std::make_shared<const PatientData>(broken), params, 2);
+        SimulationEngine first(params), second(params);
+        CHECK_FALSE(initial.initialize(first, cache, 1, error_msg));
+        const std::string first_error = error_msg;
+        CHECK_FALSE(first_error.empty());
+        error_msg.clear();
+        CHECK_FALSE(initial.initialize(second, cache, 1, error_msg));
+        CHECK(error_msg == first_error);
+    }
+}
+
+TEST_CASE("EnsembleRecord aggregates its members", "[ensemble]") {
+    SimulationRegistry registry;
+    std::vector<std::shared_ptr<SimulationRecord>> records;
+    for (int m = 0; m < 3; ++m) {
+        records.push_back(std::make_shared<SimulationRecord>(
+            "member-" + std::to_string(m), "patient", "member", 10, 0));
+        REQUIRE(registry.insert(records.back()));
+    }
+    EnsembleRecord ensemble("ensemble-1", "sweep", records);
+    CHECK(ensemble.status() == SimulationStatus::QUEUED);
+
+    // Two members finish with results, one is still running
+    const double volumes[] = {2.0, 4.0};
+    for (int m = 0; m < 2; ++m) {
+        auto snapshot = std::make_shared<SimulationSnapshot>();
+        snapshot->metrics.set_total_cancer_cells(100 * (m + 1));
+        snapshot->metrics.set_tumor_volume(volumes[m]);
+        (*snapshot->metrics.mutable_extra_metrics())["hypoxic_fraction"] = 0.1 * (m + 1);
+        records[m]->setProgress(10);
+        records[m]->setSnapshot(snapshot);
+        REQUIRE(registry.updateStatus(*records[m], SimulationStatus::RUNNING, "running"));
+        REQUIRE(registry.updateStatus(*records[m], SimulationStatus::COMPLETED, "done"));
+    }
+    REQUIRE(registry.updateStatus(*records[2], SimulationStatus::RUNNING, "running"));
+    records[2]->setProgress(5);
+
+    EnsembleStatusResponse response;
+    ensemble.toStatusResponse(&response);
+    CHECK(response.ensemble_id() == "ensemble-1");
+    CHECK(response.ensemble_name() == "sweep");
+    CHECK(response.status() == SimulationStatus::RUNNING);
+    CHECK(response.total_members() == 3);
+    CHECK(response.members_size() == 3);
+    CHECK(response.members_by_status().at(SimulationStatus::COMPLETED) == 2);
+    CHECK(response.members_by_status().at(SimulationStatus::RUNNING) == 1);
+    CHECK(response.progress_percentage() == (100.0 + 100.0 + 50.0) / 3.0);
+
+    const MetricSummary& volume = response.metrics().at("tumor_volume");
+    CHECK(volume.count() == 2);
+    CHECK(volume.mean() == 3.0);
+    CHECK(volume.stddev() == 1.0);
+    CHECK(volume.min() == 2.0);
+    CHECK(volume.max() == 4.0);
+    CHECK(response.metrics().at("total_cancer_cells").mean() == 150.0);
+    CHECK(response.metrics().at("hypoxic_fraction").count() == 2);
+
+    REQUIRE(registry.updateStatus(*records[2], SimulationStatus::FAILED, "failed"));
+    CHECK(ensemble.status() == SimulationStatus::FAILED);
+}
@@ -0,0 +1,143 @@
+#include <catch2/catch_test_macros.hpp>
+#include <cmath>
+#include <string>
+
+#include "storage/grid_codec.h"
+
+using namespace tumordtwin;
+
+namespace {
+
+// Smooth radial profile, like an oxygen field around a tumor
+ScalarGrid smoothGrid(int n) {
+    ScalarGrid grid(n, n, n, 10.0);
+    const double c = 0.5 * (n - 1);
+    for (int k = 0; k < n; ++k) {
+        for (int j = 0; j < n; ++j) {
+            for (int i = 0; i < n; ++i) {
+                double r2 = (i - c) * (i - c) + (j - c) * (j - c) + (k - c) * (k - c);
+                grid.at(i, j, k) = 1.0 - 0.8 * std::exp(-r2 / (n * 2.0));
+            }
+        }
+    }
+    return grid;
+}
+
+GridEncoding makeEncoding(GridPrecision precision, GridCompression compression, bool delta,
+                          double max_error = 0.0) {
+    GridEncoding encoding;
+    encoding.set_precision(precision);
+    encoding.set_compression(compression);
+    encoding.set_delta(delta);
+    encoding.set_max_error(max_error);
+    return encoding;
+}
+
+double maxAbsError(const ScalarGrid& a, const ScalarGrid& b) {
+    double error = 0.0;
+    for (size_t i = 0; i < a.size(); ++i) {
+        error = std::max(error, std::abs(a.data()[i] - b.data()[i]));
+    }
+    return error;
+}
+
+} // namespace
+
+TEST_CASE("GridCodec round-trips every available codec losslessly", "[codec][lossless]") {
+    const ScalarGrid grid = smoothGrid(24);
+    const size_t raw_bytes = grid.size() * sizeof(double);
+
+    for (auto compression : {GridCompression::COMPRESSION_NONE,
+                             GridCompression::COMPRESSION_DEFLATE,
+                             GridCompression::COMPRESSION_ZSTD,
+                             GridCompression::COMPRESSION_LZ4}) {
+        if (!GridCodec::isAvailable(compression)) {
+            continue;
+        }
+        for (bool delta : {false, true}) {
+            GridEncoding encoding = makeEncoding(GridPrecision::FLOAT64, compression, delta);
+            GridData data;
+            std::string error_msg;
+            REQUIRE(GridCodec::toProto(grid, SubstanceType::OXYGEN, encoding, &data, error_msg));
+            REQUIRE(data.compressed() == !GridCodec::isRaw(encoding));
+            if (compression != GridCompression::COMPRESSION_NONE) {
+                REQUIRE(data.values().size() < raw_bytes);
+            }
+
+            ScalarGrid decoded;
+            REQUIRE(GridCodec::fromProto(data, decoded, error_msg));
+            REQUIRE(decoded.nx() == grid.nx());
+            REQUIRE(maxAbsError(decoded, grid) == 0.0);
+        }
+    }
+}
+
+TEST_CASE("GridCodec lossy encodings", "[codec][lossy]") {
+    const ScalarGrid grid = smoothGrid(20);
+    std::string error_msg;
+
+    SECTION("float32 halves the payload") {
+        GridData data;
+        REQUIRE(GridCodec::toProto(grid, SubstanceType::GLUCOSE,
+                                   makeEncoding(GridPrecision::FLOAT32,
+                                                GridCompression::COMPRESSION_NONE, false),
+                                   &data, error_msg));
+        REQUIRE(data.values().size() == grid.size() * sizeof(float));
+
+        ScalarGrid decoded;
+        REQUIRE(GridCodec::fromProto(data, decoded, error_msg));
+        REQUIRE(maxAbsError(decoded, grid) < 1e-7);
+    }
+
+    SECTION("Quantization honours the error bound and compresses well") {
+        GridData data;
+        REQUIRE(GridCodec::toProto(grid, SubstanceType::OXYGEN,
+                                   makeEncoding(GridPrecision::QUANTIZED_INT32,
+                                                GridCompression::COMPRESSION_DEFLATE, true, 1e-4),
+                                   &data, error_msg));
+        REQUIRE(data.encoding().quantization_step() > 0.0);
+        REQUIRE(data.values().size() * 5 < grid.size() * sizeof(double));
+
+        ScalarGrid decoded;
+        REQUIRE(GridCodec::fromProto(data, decoded, error_msg));
+        REQUIRE(maxAbsError(decoded, grid) <= 1e-4 * (1.0 + 1e-9));
+    }
+
+    SECTION("Quantization needs a usable error bound") {
+        GridData data;
+        REQUIRE(!GridCodec::toProto(grid, SubstanceType::OXYGEN,
+                                    makeEncoding(GridPrecision::QUANTIZED_INT32,
+                                                 GridCompression::COMPRESSION_NONE, false),
+                                    &data, error_msg));
+        REQUIRE(!GridCodec::toProto(grid, SubstanceType::OXYGEN,
+                                    makeEncoding(GridPrecision::QUANTIZED_INT32,
+                                                 GridCompression::COMPRESSION_NONE, false, 1e-12),
+                                    &data, error_msg));
+    }
+}
+
+TEST_CASE("GridCodec negotiation and corrupt input", "[codec][negotiate]") {
+    GridEncoding requested = makeEncoding(GridPrecision::FLOAT32,
+                                          GridCompression::COMPRESSION_LZ4, true);
+    requested.set_quantization_step(3.0);
+    GridEncoding negotiated = GridCodec::negotiate(requested);
+    REQUIRE(GridCodec::isAvailable(negotiated.compression()));
+    REQUIRE(negotiated.quantization_step() == 0.0);
+    REQUIRE(negotiated.delta());
+    if (!GridCodec::isAvailable(GridCompression::COMPRESSION_LZ4)) {
+        REQUIRE(negotiated.compression() == GridCompression::COMPRESSION_DEFLATE);
+    }
+
+    const ScalarGrid grid = smoothGrid(8);
+    GridData data;
+    std::string error_msg;
+    REQUIRE(GridCodec::toProto(grid, SubstanceType::OXYGEN,
+                               makeEncoding(GridPrecision::FLOAT64,
+                                            GridCompression::COMPRESSION_DEFLATE, true),
+                               &data, error_msg));
+    data.mutable_values()->resize(data.values().size() / 2);
+
+    ScalarGrid decoded;
+    REQUIRE(!GridCodec::fromProto(data, decoded, error_msg));
+    REQUIRE(!error_msg.empty());
+}
@@ -2,6 +2,14 @@
 #include <grpcpp/grpcpp.h>
 #include <thread>
 #include <chrono>
+#include <filesystem>
+#include <future>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
 
 #include "grpc_server.h"
 #include "service.grpc.pb.h"
@@ -11,8 +19,10 @@ using namespace tumordtwin;
 // Helper class to manage server lifecycle in tests
 class TestServerFixture {
 public:
-    TestServerFixture() : server_address_("localhost:50052") {
-        server_ = std::make_unique<GrpcServer>(server_address_);
+    explicit TestServerFixture(const std::string& metrics_address = "",
+                               const GrpcServerOptions& options = GrpcServerOptions())
+        : server_address_("localhost:50052") {
+        server_ = std::make_unique<GrpcServer>(server_address_, metrics_address, options);
     }
 
     ~TestServerFixture() {
@@ -39,6 +49,14 @@ public:
         return server_address_;
     }
 
+    int metricsPort() const {
+        return server_->metricsPort();
+    }
+
+    SimulationServiceImpl& service() {
+        return server_->service();
+    }
+
     std::unique_ptr<SimulationService::Stub> createStub() {
         auto channel = grpc::CreateChannel(
             server_address_,
@@ -88,6 +106,66 @@ PatientData createValidPatientData() {
     return data;
 }
 
+// Helper function to start a simulation and return its ID
+std::string startTestSimulation(SimulationService::Stub& stub,
+                                const std::string& patient_id = "test_patient_001",
+                                int num_steps = 100) {
+    grpc::ClientContext context;
+    SimulationRequest request;
+    request.set_patient_id(patient_id);
+    request.set_simulation_name("Test Simulation");
+    *request.mutable_data() = createValidPatientData();
+    *request.mutable_params() = createValidParameters();
+    request.mutable_params()->set_num_steps(num_steps);
+
+    SimulationResponse response;
+    grpc::Status status = stub.StartSimulation(&context, request, &response);
+    return status.ok() ? response.simulation_id() : std::string();
+}
+
+// Poll until a simulation reaches the given status or the timeout expires
+bool waitForStatus(SimulationService::Stub& stub, const std::string& simulation_id,
+                   SimulationStatus expected,
+                   std::chrono::seconds timeout = std::chrono::seconds(60)) {
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (std::chrono::steady_clock::now() < deadline) {
+        grpc::ClientContext context;
+        StatusRequest request;
+        request.set_simulation_id(simulation_id);
+        StatusResponse response;
+        if (stub.GetSimulationStatus(&context, request, &response).ok() &&
+            response.status() == expected) {
+            return true;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return false;
+}
+
+// Send a raw HTTP request to 127.0.0.1:port and return the whole response
+std::string httpRequest(int port, const std::string& request) {
+    const int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(static_cast<uint16_t>(port));
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    std::string response;
+    if (::connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == 0 &&
+        ::send(fd, request.data(), request.size(), 0) == static_cast<ssize_t>(request.size())) {
+        char buffer[4096];
+        ssize_t n;
+        while ((n = ::recv(fd, buffer, sizeof(buffer), 0)) > 0) {
+            response.append(buffer, static_cast<size_t>(n));
+        }
+    }
+    ::close(fd);
+    return response;
+}
+
+std::string httpGet(int port, const std::string& path) {
+    return httpRequest(port, "GET " + path + " HTTP/1.1\r\nHost: localhost\r\n\r\n");
+}
+
 // ============================================================================
 // Test Cases
 // ============================================================================
@@ -125,6 +203,64 @@ TEST_CASE("Health check endpoint responds", "[grpc][server][health]") {
     REQUIRE(!response.message().empty());
 }
 
+TEST_CASE("Health check waits for warm engines", "[grpc][server][health][warm]") {
+    SimulationParameters params = createValidParameters();
+    params.set_grid_size_x(16);
+    params.set_grid_size_y(16);
+    params.set_grid_size_z(16);
+
+    SECTION("Service reports NOT_SERVING until the engines are built") {
+        SimulationServiceImpl service;
+        std::promise<void> release;
+        std::shared_future<void> released = release.get_future().share();
+        service.warmUp(2, params, [released] { released.wait(); });
+
+        grpc::ServerContext context;
+        HealthCheckRequest request;
+        HealthCheckResponse response;
+        REQUIRE(service.HealthCheck(&context, &request, &response).ok());
+        REQUIRE(response.status() == HealthCheckResponse::NOT_SERVING);
+
+        release.set_value();
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(30);
+        while (!service.warmedUp() && std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        REQUIRE(service.HealthCheck(&context, &request, &response).ok());
+        REQUIRE(response.status() == HealthCheckResponse::SERVING);
+        REQUIRE(service.enginePool().idle() == 2);
+    }
+
+    SECTION("Runs take a warm engine and return it") {
+        GrpcServerOptions options;
+        options.warm_engines = 1;
+        options.warm_grid = 16;
+        TestServerFixture fixture("", options);
+        REQUIRE(fixture.startServer());
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(30);
+        while (!fixture.service().warmedUp() && std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        REQUIRE(fixture.service().enginePool().idle() == 1);
+
+        auto stub = fixture.createStub();
+        grpc::ClientContext context;
+        SimulationRequest request;
+        request.set_patient_id("test_patient_001");
+        *request.mutable_data() = createValidPatientData();
+        *request.mutable_params() = params;
+        request.mutable_params()->set_num_steps(3);
+        SimulationResponse response;
+        REQUIRE(stub->StartSimulation(&context, request, &response).ok());
+        REQUIRE(waitForStatus(*stub, response.simulation_id(), SimulationStatus::COMPLETED));
+
+        const std::string metrics = fixture.service().metrics().renderPrometheus();
+        REQUIRE(metrics.find("tumordtwin_engine_acquisitions_total{origin=\"warm\"} 1\n") !=
+                std::string::npos);
+        REQUIRE(fixture.service().enginePool().idle() == 1);
+    }
+}
+
 TEST_CASE("StartSimulation with valid request", "[grpc][server][start]") {
     TestServerFixture fixture;
     REQUIRE(fixture.startServer());
@@ -147,6 +283,241 @@ TEST_CASE("StartSimulation with valid request", "[grpc][server][start]") {
     REQUIRE(!response.message().empty());
 }
 
+TEST_CASE("StartEnsemble runs a parameter sweep", "[grpc][server][ensemble]") {
+    TestServerFixture fixture;
+    REQUIRE(fixture.startServer());
+
+    auto stub = fixture.createStub();
+
+    EnsembleRequest request;
+    request.set_ensemble_name("Rate sweep");
+    SimulationRequest* base = request.mutable_base();
+    base->set_patient_id("test_patient_001");
+    base->set_simulation_name("Sweep");
+    *base->mutable_data() = createValidPatientData();
+    *base->mutable_params() = createValidParameters();
+    base->mutable_params()->set_grid_size_x(20);
+    base->mutable_params()->set_grid_size_y(20);
+    base->mutable_params()->set_grid_size_z(20);
+    base->mutable_params()->set_num_steps(3);
+    base->mutable_params()->set_num_threads(1);
+
+    SECTION("Members run to completion and their metrics are aggregated") {
+        EnsembleMember* treated = request.add_members();
+        treated->set_name("treated");
+        treated->mutable_treatment()->set_protocol_name("high dose");
+        (*treated->mutable_overrides())["death_rate"] = 0.2;
+        request.add_members()->set_name("control");
+        ParameterAxis* axis = request.add_grid();
+        axis->set_parameter("division_rate");
+        axis->add_values(0.1);
+        axis->add_values(0.4);
+
+        grpc::ClientContext context;
+        EnsembleResponse response;
+        REQUIRE(stub->StartEnsemble(&context, request, &response).ok());
+        REQUIRE(!response.ensemble_id().empty());
+        REQUIRE(response.simulation_ids_size() == 4);
+        REQUIRE(response.status() == SimulationStatus::QUEUED);
+
+        for (const std::string& sim_id : response.simulation_ids()) {
+            REQUIRE(waitForStatus(*stub, sim_id, SimulationStatus::COMPLETED));
+        }
+
+        grpc::ClientContext status_context;
+        EnsembleStatusRequest status_request;
+        status_request.set_ensemble_id(response.ensemble_id());
+        EnsembleStatusResponse status;
+        REQUIRE(stub->GetEnsembleStatus(&status_context, status_request, &status).ok());
+        REQUIRE(status.ensemble_name() == "Rate sweep");
+        REQUIRE(status.status() == SimulationStatus::COMPLETED);
+        REQUIRE(status.total_members() == 4);
+        REQUIRE(status.members_by_status().at(SimulationStatus::COMPLETED) == 4);
+        REQUIRE(status.progress_percentage() == 100.0);
+        REQUIRE(status.members(0).simulation_name() == "Sweep [treated, division_rate=0.1]");
+        REQUIRE(status.metrics().at("total_cancer_cells").count() == 4);
+        REQUIRE(status.metrics().at("total_cancer_cells").mean() > 0.0);
+
+        // Members are ordinary simulations to every other RPC
+        grpc::ClientContext list_context;
+        ListRequest list_request;
+        list_request.set_patient_id("test_patient_001");
+        SimulationList list;
+        REQUIRE(stub->ListSimulations(&list_context, list_request, &list).ok());
+        REQUIRE(list.total_count() == 4);
+    }
+
+    SECTION("Invalid members reject the whole ensemble") {
+        (*request.add_members()->mutable_overrides())["death_rate"] = -1.0;
+        request.add_members();
+
+        grpc::ClientContext context;
+        EnsembleResponse response;
+        grpc::Status status = stub->StartEnsemble(&context, request, &response);
+        REQUIRE(status.error_code() == grpc::StatusCode::INVALID_ARGUMENT);
+        REQUIRE(status.error_message() == "Member 0: Death rate must be non-negative");
+
+        grpc::ClientContext list_context;
+        SimulationList list;
+        REQUIRE(stub->ListSimulations(&list_context, ListRequest(), &list).ok());
+        REQUIRE(list.total_count() == 0);
+    }
+
+    SECTION("Unknown parameters and base errors are rejected") {
+        ParameterAxis* axis = request.add_grid();
+        axis->set_parameter("no_such_rate");
+        axis->add_values(1.0);
+
+        grpc::ClientContext context;
+        EnsembleResponse response;
+        REQUIRE(stub->StartEnsemble(&context, request, &response).error_code() ==
+                grpc::StatusCode::INVALID_ARGUMENT);
+
+        base->clear_params();
+        grpc::ClientContext base_context;
+        REQUIRE(stub->StartEnsemble(&base_context, request, &response).error_code() ==
+                grpc::StatusCode::INVALID_ARGUMENT);
+    }
+
+    SECTION("Unknown ensemble ID is not found") {
+        grpc::ClientContext context;
+        EnsembleStatusRequest status_request;
+        status_request.set_ensemble_id("no-such-ensemble");
+        EnsembleStatusResponse status;
+        REQUIRE(stub->GetEnsembleStatus(&context, status_request, &status).error_code() ==
+                grpc::StatusCode::NOT_FOUND);
+    }
+}
+
+TEST_CASE("Finished ensembles are dropped with their members", "[grpc][server][ensemble]") {
+    GrpcServerOptions options;
+    options.retain_finished = 1;
+    TestServerFixture fixture("", options);
+    REQUIRE(fixture.startServer());
+
+    auto stub = fixture.createStub();
+
+    EnsembleRequest request;
+    SimulationRequest* base = request.mutable_base();
+    base->set_patient_id("test_patient_001");
+    *base->mutable_data() = createValidPatientData();
+    *base->mutable_params() = createValidParameters();
+    base->mutable_params()->set_grid_size_x(20);
+    base->mutable_params()->set_grid_size_y(20);
+    base->mutable_params()->set_grid_size_z(20);
+    base->mutable_params()->set_num_steps(3);
+    base->mutable_params()->set_num_threads(1);
+    request.add_members()->set_name("only");
+
+    auto runEnsemble = [&] {
+        grpc::ClientContext context;
+        EnsembleResponse response;
+        REQUIRE(stub->StartEnsemble(&context, request, &response).ok());
+        REQUIRE(waitForStatus(*stub, response.simulation_ids(0), SimulationStatus::COMPLETED));
+        return response.ensemble_id();
+    };
+    auto ensembleStatus = [&](const std::string& ensemble_id) {
+        grpc::ClientContext context;
+        EnsembleStatusRequest status_request;
+        status_request.set_ensemble_id(ensemble_id);
+        EnsembleStatusResponse status;
+        return stub->GetEnsembleStatus(&context, status_request, &status).error_code();
+    };
+
+    const std::string first = runEnsemble();
+    REQUIRE(ensembleStatus(first) == grpc::StatusCode::OK);
+
+    // The second member to finish pushes the first out of the registry, and its ensemble with it
+    const std::string second = runEnsemble();
+    REQUIRE(ensembleStatus(first) == grpc::StatusCode::NOT_FOUND);
+    REQUIRE(ensembleStatus(second) == grpc::StatusCode::OK);
+}
+
+TEST_CASE("UploadPatientData streams patient data for StartSimulation", "[grpc][server][upload]") {
+    TestServerFixture fixture;
+    REQUIRE(fixture.startServer());
+
+    auto stub = fixture.createStub();
+
+    // A VCF sent in small pieces, larger than one of them
+    std::string vcf = "##fileformat=VCFv4.2\n"
+                      "#CHROM\tPOS\tID\tREF\tALT\tQUAL\tFILTER\tINFO\tFORMAT\ttumor\n";
+    vcf += "chr12\t25245350\t.\tC\tT\t60\tPASS\tAF=0.4\tGT\t0/1\n";
+    for (int i = 1; i <= 2000; ++i) {
+        vcf += "chr1\t" + std::to_string(1000 * i) + "\t.\tG\tA\t50\tPASS\tAF=0.1\tGT\t0/1\n";
+    }
+
+    grpc::ClientContext context;
+    UploadResponse upload;
+    auto writer = stub->UploadPatientData(&context, &upload);
+    PatientDataChunk chunk;
+    chunk.mutable_header()->set_patient_id("test_patient_001");
+    REQUIRE(writer->Write(chunk));
+    for (size_t offset = 0; offset < vcf.size(); offset += 4096) {
+        chunk.Clear();
+        chunk.set_payload(UPLOAD_VCF);
+        chunk.set_data(vcf.substr(offset, 4096));
+        REQUIRE(writer->Write(chunk));
+    }
+    REQUIRE(writer->WritesDone());
+    grpc::Status status = writer->Finish();
+    REQUIRE(status.ok());
+    REQUIRE(!upload.upload_id().empty());
+    REQUIRE(upload.bytes_received() == static_cast<int64_t>(vcf.size()));
+    REQUIRE(upload.mutations() == 2001);
+    REQUIRE(upload.driver_mutations_size() == 1);
+    REQUIRE(upload.driver_mutations(0) == "KRAS:G12D");
+
+    SECTION("Simulations start from the upload") {
+        grpc::ClientContext start_context;
+        SimulationRequest request;
+        request.set_patient_id("test_patient_001");
+        request.set_upload_id(upload.upload_id());
+        *request.mutable_params() = createValidParameters();
+        request.mutable_params()->set_num_steps(5);
+        SimulationResponse response;
+        REQUIRE(stub->StartSimulation(&start_context, request, &response).ok());
+        REQUIRE(!response.simulation_id().empty());
+
+        // Preprocessing sees the uploaded mutations; a second run reuses the model
+        REQUIRE(waitForStatus(*stub, response.simulation_id(), SimulationStatus::COMPLETED));
+        grpc::ClientContext again_context;
+        SimulationResponse again;
+        REQUIRE(stub->StartSimulation(&again_context, request, &again).ok());
+        REQUIRE(waitForStatus(*stub, again.simulation_id(), SimulationStatus::COMPLETED));
+    }
+
+    SECTION("Unknown uploads and other patients are rejected") {
+        grpc::ClientContext unknown_context;
+        SimulationRequest request;
+        request.set_patient_id("test_patient_001");
+        request.set_upload_id("no-such-upload");
+        *request.mutable_params() = createValidParameters();
+        SimulationResponse response;
+        REQUIRE(stub->StartSimulation(&unknown_context, request, &response).error_code() ==
+                grpc::StatusCode::NOT_FOUND);
+
+        grpc::ClientContext other_context;
+        request.set_patient_id("test_patient_002");
+        request.set_upload_id(upload.upload_id());
+        REQUIRE(stub->StartSimulation(&other_context, request, &response).error_code() ==
+                grpc::StatusCode::INVALID_ARGUMENT);
+    }
+
+    SECTION("Unparseable payloads fail the upload") {
+        grpc::ClientContext bad_context;
+        UploadResponse bad;
+        auto bad_writer = stub->UploadPatientData(&bad_context, &bad);
+        PatientDataChunk header;
+        header.mutable_header()->set_patient_id("test_patient_001");
+        header.set_payload(UPLOAD_FASTQ);
+        header.set_data("this is not FASTQ\n");
+        bad_writer->Write(header);
+        bad_writer->WritesDone();
+        REQUIRE(bad_writer->Finish().error_code() == grpc::StatusCode::INVALID_ARGUMENT);
+    }
+}
+
 TEST_CASE("Invalid requests are rejected", "[grpc][server][validation]") {
     TestServerFixture fixture;
     REQUIRE(fixture.startServer());
@@ -181,6 +552,20 @@ TEST_CASE("Invalid requests are rejected", "[grpc][server][validation]") {
         REQUIRE(status.error_code() == grpc::StatusCode::INVALID_ARGUMENT);
     }
     
+    SECTION("Spool path metadata is reserved for uploads") {
+        grpc::ClientContext context;
+        SimulationRequest request;
+        request.set_patient_id("test_patient_001");
+        *request.mutable_data() = createValidPatientData();
+        (*request.mutable_data()->mutable_metadata())["upload.dicom_path"] = "/etc/passwd";
+        *request.mutable_params() = createValidParameters();
+
+        SimulationResponse response;
+        grpc::Status status = stub->StartSimulation(&context, request, &response);
+
+        REQUIRE(status.error_code() == grpc::StatusCode::INVALID_ARGUMENT);
+    }
+
     SECTION("Missing simulation parameters is rejected") {
         grpc::ClientContext context;
         SimulationRequest request;
@@ -212,6 +597,42 @@ TEST_CASE("Invalid requests are rejected", "[grpc][server][validation]") {
         REQUIRE(status.error_code() == grpc::StatusCode::INVALID_ARGUMENT);
     }
     
+    SECTION("Multi-rank runs must fit their ranks") {
+        auto start = [&](int edge, int ranks, int checkpoint_interval) {
+            grpc::ClientContext context;
+            SimulationRequest request;
+            request.set_patient_id("test_patient_001");
+            *request.mutable_data() = createValidPatientData();
+            auto params = createValidParameters();
+            params.set_grid_size_x(edge);
+            params.set_grid_size_y(edge);
+            params.set_grid_size_z(edge);
+            params.set_num_mpi_ranks(ranks);
+            params.set_checkpoint_interval(checkpoint_interval);
+            *request.mutable_params() = params;
+            SimulationResponse response;
+            return stub->StartSimulation(&context, request, &response);
+        };
+
+        // One process holds at most 2^28 voxels
+        grpc::Status status = start(1000, 1, 0);
+        REQUIRE(status.error_code() == grpc::StatusCode::INVALID_ARGUMENT);
+        REQUIRE(status.error_message().find("num_mpi_ranks") != std::string::npos);
+
+        // Split across 4 ranks it fits, but only with MPI ranks, which this server has not
+        status = start(1000, 4, 0);
+        REQUIRE(status.error_code() == grpc::StatusCode::FAILED_PRECONDITION);
+        REQUIRE(status.error_message().find("MPI ranks") != std::string::npos);
+
+        status = start(100, 2, 10);
+        REQUIRE(status.error_code() == grpc::StatusCode::INVALID_ARGUMENT);
+        REQUIRE(status.error_message().find("checkpoint") != std::string::npos);
+
+        status = start(4, 8, 0);
+        REQUIRE(status.error_code() == grpc::StatusCode::INVALID_ARGUMENT);
+        REQUIRE(status.error_message().find("z planes") != std::string::npos);
+    }
+
     SECTION("Invalid time step is rejected") {
         grpc::ClientContext context;
         SimulationRequest request;
@@ -264,6 +685,23 @@ TEST_CASE("Invalid requests are rejected", "[grpc][server][validation]") {
         REQUIRE(!status.ok());
         REQUIRE(status.error_code() == grpc::StatusCode::INVALID_ARGUMENT);
     }
+
+    SECTION("Treatment with a non-positive half life is rejected") {
+        grpc::ClientContext context;
+        SimulationRequest request;
+        request.set_patient_id("test_patient_001");
+        *request.mutable_data() = createValidPatientData();
+        *request.mutable_params() = createValidParameters();
+        Drug* drug = request.mutable_treatment()->add_drugs();
+        drug->set_name("temozolomide");
+        drug->set_half_life(0.0);
+
+        SimulationResponse response;
+        grpc::Status status = stub->StartSimulation(&context, request, &response);
+
+        REQUIRE(!status.ok());
+        REQUIRE(status.error_code() == grpc::StatusCode::INVALID_ARGUMENT);
+    }
 }
 
 TEST_CASE("GetSimulationStatus works", "[grpc][server][status]") {
@@ -273,15 +711,75 @@ TEST_CASE("GetSimulationStatus works", "[grpc][server][status]") {
     auto stub = fixture.createStub();
     
     SECTION("Valid simulation ID returns status") {
+        std::string sim_id = startTestSimulation(*stub);
+        REQUIRE(!sim_id.empty());
+
         grpc::ClientContext context;
         StatusRequest request;
-        request.set_simulation_id("test-sim-id-123");
+        request.set_simulation_id(sim_id);
         
         StatusResponse response;
         grpc::Status status = stub->GetSimulationStatus(&context, request, &response);
         
         REQUIRE(status.ok());
-        REQUIRE(response.simulation_id() == "test-sim-id-123");
+        REQUIRE(response.simulation_id() == sim_id);
+        REQUIRE(response.total_steps() == 100);
+        REQUIRE(response.status() != SimulationStatus::SIMULATION_STATUS_UNSPECIFIED);
+    }
+
+    SECTION("Unknown simulation ID is not found") {
+        grpc::ClientContext context;
+        StatusRequest request;
+        request.set_simulation_id("test-sim-id-123");
+
+        StatusResponse response;
+        grpc::Status status = stub->GetSimulationStatus(&context, request, &response);
+
+        REQUIRE(!status.ok());
+        REQUIRE(status.error_code() == grpc::StatusCode::NOT_FOUND);
+    }
+
+    SECTION("Simulation runs to completion") {
+        std::string sim_id = startTestSimulation(*stub, "test_patient_001", 5);
+        REQUIRE(!sim_id.empty());
+        REQUIRE(waitForStatus(*stub, sim_id, SimulationStatus::COMPLETED));
+
+        grpc::ClientContext context;
+        StatusRequest request;
+        request.set_simulation_id(sim_id);
+        StatusResponse response;
+        REQUIRE(stub->GetSimulationStatus(&context, request, &response).ok());
+        REQUIRE(response.status() == SimulationStatus::COMPLETED);
+        REQUIRE(response.current_step() == 5);
+        REQUIRE(response.progress_percentage() == 100.0);
+    }
+
+    SECTION("Multi-rank simulation runs to completion on in-process ranks") {
+        grpc::ClientContext start_context;
+        SimulationRequest start_request;
+        start_request.set_patient_id("test_patient_001");
+        *start_request.mutable_data() = createValidPatientData();
+        auto params = createValidParameters();
+        params.set_grid_size_x(20);
+        params.set_grid_size_y(20);
+        params.set_grid_size_z(20);
+        params.set_num_steps(5);
+        params.set_checkpoint_interval(0);
+        params.set_num_mpi_ranks(3);
+        *start_request.mutable_params() = params;
+        SimulationResponse start_response;
+        REQUIRE(stub->StartSimulation(&start_context, start_request, &start_response).ok());
+        const std::string sim_id = start_response.simulation_id();
+        REQUIRE(waitForStatus(*stub, sim_id, SimulationStatus::COMPLETED));
+
+        grpc::ClientContext context;
+        StatusRequest request;
+        request.set_simulation_id(sim_id);
+        StatusResponse response;
+        REQUIRE(stub->GetSimulationStatus(&context, request, &response).ok());
+        REQUIRE(response.current_step() == 5);
+        REQUIRE(response.current_metrics().total_cancer_cells() > 0);
+        REQUIRE(response.current_metrics().subclones_size() > 0);
     }
     
     SECTION("Empty simulation ID is rejected") {
@@ -297,6 +795,83 @@ TEST_CASE("GetSimulationStatus works", "[grpc][server][status]") {
     }
 }
 
+TEST_CASE("WatchSimulation streams progress", "[grpc][server][watch]") {
+    TestServerFixture fixture;
+    REQUIRE(fixture.startServer());
+
+    auto stub = fixture.createStub();
+
+    SECTION("Updates follow the step cadence until completion") {
+        std::string sim_id = startTestSimulation(*stub, "test_patient_001", 20);
+        REQUIRE(!sim_id.empty());
+
+        grpc::ClientContext context;
+        WatchRequest request;
+        request.set_simulation_id(sim_id);
+        request.set_step_interval(5);
+        auto reader = stub->WatchSimulation(&context, request);
+
+        std::vector<StatusResponse> updates;
+        StatusResponse response;
+        while (reader->Read(&response)) {
+            updates.push_back(response);
+        }
+        REQUIRE(reader->Finish().ok());
+
+        REQUIRE(!updates.empty());
+        for (size_t i = 1; i < updates.size(); ++i) {
+            REQUIRE(updates[i].current_step() >= updates[i - 1].current_step());
+        }
+        // At most one update per 5 steps plus one per status change
+        REQUIRE(updates.size() <= 20 / 5 + 3);
+
+        const StatusResponse& last = updates.back();
+        REQUIRE(last.status() == SimulationStatus::COMPLETED);
+        REQUIRE(last.current_step() == 20);
+        REQUIRE(last.current_metrics().step_number() == 20);
+        REQUIRE(last.current_metrics().total_cells() > 0);
+    }
+
+    SECTION("A finished simulation yields its final status at once") {
+        std::string sim_id = startTestSimulation(*stub, "test_patient_001", 3);
+        REQUIRE(waitForStatus(*stub, sim_id, SimulationStatus::COMPLETED));
+
+        grpc::ClientContext context;
+        WatchRequest request;
+        request.set_simulation_id(sim_id);
+        auto reader = stub->WatchSimulation(&context, request);
+
+        StatusResponse response;
+        REQUIRE(reader->Read(&response));
+        REQUIRE(response.status() == SimulationStatus::COMPLETED);
+        REQUIRE(!reader->Read(&response));
+        REQUIRE(reader->Finish().ok());
+    }
+
+    SECTION("Unknown simulation ID returns NOT_FOUND") {
+        grpc::ClientContext context;
+        WatchRequest request;
+        request.set_simulation_id("no-such-simulation");
+        auto reader = stub->WatchSimulation(&context, request);
+
+        StatusResponse response;
+        REQUIRE(!reader->Read(&response));
+        REQUIRE(reader->Finish().error_code() == grpc::StatusCode::NOT_FOUND);
+    }
+
+    SECTION("Negative intervals are rejected") {
+        grpc::ClientContext context;
+        WatchRequest request;
+        request.set_simulation_id("any");
+        request.set_min_interval_ms(-1);
+        auto reader = stub->WatchSimulation(&context, request);
+
+        StatusResponse response;
+        REQUIRE(!reader->Read(&response));
+        REQUIRE(reader->Finish().error_code() == grpc::StatusCode::INVALID_ARGUMENT);
+    }
+}
+
 TEST_CASE("StopSimulation works", "[grpc][server][stop]") {
     TestServerFixture fixture;
     REQUIRE(fixture.startServer());
@@ -304,9 +879,14 @@ TEST_CASE("StopSimulation works", "[grpc][server][stop]") {
     auto stub = fixture.createStub();
     
     SECTION("Valid stop request succeeds") {
+        std::string sim_id = startTestSimulation(*stub, "test_patient_001", 1000000000);
+        REQUIRE(!sim_id.empty());
+        // Only a simulation that has started has state to checkpoint
+        REQUIRE(waitForStatus(*stub, sim_id, SimulationStatus::RUNNING));
+
         grpc::ClientContext context;
         StopRequest request;
-        request.set_simulation_id("test-sim-id-123");
+        request.set_simulation_id(sim_id);
         request.set_save_checkpoint(true);
         
         StopResponse response;
@@ -315,6 +895,22 @@ TEST_CASE("StopSimulation works", "[grpc][server][stop]") {
         REQUIRE(status.ok());
         REQUIRE(response.success() == true);
         REQUIRE(!response.checkpoint_path().empty());
+
+        REQUIRE(waitForStatus(*stub, sim_id, SimulationStatus::STOPPED));
+        REQUIRE(std::filesystem::exists(response.checkpoint_path()));
+        std::filesystem::remove(response.checkpoint_path());
+    }
+
+    SECTION("Unknown simulation ID is not found") {
+        grpc::ClientContext context;
+        StopRequest request;
+        request.set_simulation_id("test-sim-id-123");
+
+        StopResponse response;
+        grpc::Status status = stub->StopSimulation(&context, request, &response);
+
+        REQUIRE(!status.ok());
+        REQUIRE(status.error_code() == grpc::StatusCode::NOT_FOUND);
     }
     
     SECTION("Empty simulation ID is rejected") {
@@ -330,20 +926,149 @@ TEST_CASE("StopSimulation works", "[grpc][server][stop]") {
     }
 }
 
+TEST_CASE("LoadSimulation resumes from a checkpoint", "[grpc][server][load]") {
+    TestServerFixture fixture;
+    REQUIRE(fixture.startServer());
+
+    auto stub = fixture.createStub();
+
+    SECTION("Stopped simulation resumes where it left off") {
+        std::string sim_id = startTestSimulation(*stub, "test_patient_001", 1000000000);
+        REQUIRE(waitForStatus(*stub, sim_id, SimulationStatus::RUNNING));
+
+        std::string checkpoint_path;
+        {
+            grpc::ClientContext context;
+            StopRequest request;
+            request.set_simulation_id(sim_id);
+            request.set_save_checkpoint(true);
+            StopResponse response;
+            REQUIRE(stub->StopSimulation(&context, request, &response).ok());
+            checkpoint_path = response.checkpoint_path();
+        }
+        REQUIRE(waitForStatus(*stub, sim_id, SimulationStatus::STOPPED));
+
+        int32_t stopped_step = 0;
+        {
+            grpc::ClientContext context;
+            StatusRequest request;
+            request.set_simulation_id(sim_id);
+            StatusResponse response;
+            REQUIRE(stub->GetSimulationStatus(&context, request, &response).ok());
+            stopped_step = response.current_step();
+        }
+
+        grpc::ClientContext context;
+        LoadSimulationRequest request;
+        request.set_simulation_id(sim_id);
+        LoadSimulationResponse response;
+        grpc::Status status = stub->LoadSimulation(&context, request, &response);
+
+        REQUIRE(status.ok());
+        REQUIRE(response.success());
+        REQUIRE(response.state().simulation_id() == sim_id);
+        REQUIRE(response.state().patient_id() == "test_patient_001");
+        REQUIRE(response.state().current_step() == stopped_step);
+        REQUIRE(response.state().parameters().grid_size_x() == 100);
+
+        REQUIRE(waitForStatus(*stub, sim_id, SimulationStatus::RUNNING));
+
+        SECTION("An active simulation cannot be loaded over") {
+            grpc::ClientContext again_context;
+            LoadSimulationResponse again;
+            grpc::Status again_status = stub->LoadSimulation(&again_context, request, &again);
+            REQUIRE(again_status.error_code() == grpc::StatusCode::ALREADY_EXISTS);
+        }
+
+        grpc::ClientContext stop_context;
+        StopRequest stop;
+        stop.set_simulation_id(sim_id);
+        StopResponse stop_response;
+        REQUIRE(stub->StopSimulation(&stop_context, stop, &stop_response).ok());
+        REQUIRE(waitForStatus(*stub, sim_id, SimulationStatus::STOPPED));
+        std::filesystem::remove(checkpoint_path);
+    }
+
+    SECTION("Missing checkpoint returns NOT_FOUND") {
+        grpc::ClientContext context;
+        LoadSimulationRequest request;
+        request.set_simulation_id("no-such-checkpoint");
+        LoadSimulationResponse response;
+        grpc::Status status = stub->LoadSimulation(&context, request, &response);
+        REQUIRE(status.error_code() == grpc::StatusCode::NOT_FOUND);
+    }
+
+    SECTION("Paths outside the checkpoint directory are rejected") {
+        grpc::ClientContext context;
+        LoadSimulationRequest request;
+        request.set_simulation_id("escape");
+        request.set_checkpoint_path("/etc/passwd");
+        LoadSimulationResponse response;
+        grpc::Status status = stub->LoadSimulation(&context, request, &response);
+        REQUIRE(status.error_code() == grpc::StatusCode::INVALID_ARGUMENT);
+    }
+
+    SECTION("Unsafe simulation IDs are rejected") {
+        grpc::ClientContext context;
+        LoadSimulationRequest request;
+        request.set_simulation_id("../escape");
+        LoadSimulationResponse response;
+        grpc::Status status = stub->LoadSimulation(&context, request, &response);
+        REQUIRE(status.error_code() == grpc::StatusCode::INVALID_ARGUMENT);
+    }
+}
+
 TEST_CASE("ListSimulations works", "[grpc][server][list]") {
     TestServerFixture fixture;
     REQUIRE(fixture.startServer());
     
     auto stub = fixture.createStub();
     
-    grpc::ClientContext context;
-    ListRequest request;
-    
-    SimulationList response;
-    grpc::Status status = stub->ListSimulations(&context, request, &response);
-    
-    REQUIRE(status.ok());
-    REQUIRE(response.total_count() == 0);  // No simulations yet
+    SECTION("Empty registry returns no simulations") {
+        grpc::ClientContext context;
+        ListRequest request;
+        
+        SimulationList response;
+        grpc::Status status = stub->ListSimulations(&context, request, &response);
+        
+        REQUIRE(status.ok());
+        REQUIRE(response.total_count() == 0);  // No simulations yet
+    }
+
+    SECTION("Filters and pagination are applied") {
+        for (int i = 0; i < 3; ++i) {
+            REQUIRE(!startTestSimulation(*stub, "patient_a").empty());
+        }
+        REQUIRE(!startTestSimulation(*stub, "patient_b").empty());
+
+        grpc::ClientContext context;
+        ListRequest request;
+        request.set_patient_id("patient_a");
+        request.set_limit(2);
+        request.set_offset(1);
+
+        SimulationList response;
+        grpc::Status status = stub->ListSimulations(&context, request, &response);
+
+        REQUIRE(status.ok());
+        REQUIRE(response.total_count() == 3);
+        REQUIRE(response.simulations_size() == 2);
+        for (const auto& summary : response.simulations()) {
+            REQUIRE(summary.patient_id() == "patient_a");
+        }
+    }
+
+    SECTION("Negative offset is rejected") {
+        grpc::ClientContext context;
+        ListRequest request;
+        request.set_offset(-1);
+
+        SimulationList response;
+        grpc::Status status = stub->ListSimulations(&context, request, &response);
+
+        REQUIRE(!status.ok());
+        REQUIRE(status.error_code() == grpc::StatusCode::INVALID_ARGUMENT);
+    }
 }
 
 TEST_CASE("GetSimulationResults works", "[grpc][server][results]") {
@@ -352,25 +1077,133 @@ TEST_CASE("GetSimulationResults works", "[grpc][server][results]") {
     
     auto stub = fixture.createStub();
     
-    SECTION("Valid results request succeeds") {
+    SECTION("Completed simulation streams its state in chunks") {
+        std::string sim_id = startTestSimulation(*stub, "test_patient_001", 5);
+        REQUIRE(!sim_id.empty());
+        REQUIRE(waitForStatus(*stub, sim_id, SimulationStatus::COMPLETED));
+
         grpc::ClientContext context;
         ResultsRequest request;
-        request.set_simulation_id("test-sim-id-123");
+        request.set_simulation_id(sim_id);
         request.set_include_agents(true);
         request.set_include_grid_data(true);
+        request.set_step_number(-1);
         
         ResultsChunk chunk;
         auto reader = stub->GetSimulationResults(&context, request);
         
-        bool received_chunk = false;
+        std::string payload;
+        int32_t num_chunks = 0;
+        bool saw_final = false;
         while (reader->Read(&chunk)) {
-            received_chunk = true;
-            REQUIRE(chunk.simulation_id() == "test-sim-id-123");
+            REQUIRE(chunk.simulation_id() == sim_id);
+            REQUIRE(chunk.chunk_number() == num_chunks++);
+            saw_final = chunk.is_final();
+            payload += chunk.data();
         }
         
         grpc::Status status = reader->Finish();
         REQUIRE(status.ok());
-        REQUIRE(received_chunk == true);
+        REQUIRE(saw_final);
+        // Two 100^3 double grids do not fit in one message
+        REQUIRE(num_chunks == chunk.total_chunks());
+        REQUIRE(num_chunks > 1);
+
+        SimulationState state;
+        REQUIRE(state.ParseFromString(payload));
+        REQUIRE(state.simulation_id() == sim_id);
+        REQUIRE(state.current_step() == 5);
+        REQUIRE(state.grids_size() == 2);
+        REQUIRE(state.grids(0).values().size() == 100 * 100 * 100 * sizeof(double));
+        REQUIRE(state.agents_size() == state.metrics().total_cells());
+        REQUIRE(state.agents_size() > 0);
+    }
+
+    SECTION("Substance filter limits the grids") {
+        std::string sim_id = startTestSimulation(*stub, "test_patient_001", 1);
+        REQUIRE(waitForStatus(*stub, sim_id, SimulationStatus::COMPLETED));
+
+        grpc::ClientContext context;
+        ResultsRequest request;
+        request.set_simulation_id(sim_id);
+        request.set_include_grid_data(true);
+        request.add_substances(SubstanceType::GLUCOSE);
+        request.set_step_number(-1);
+
+        auto reader = stub->GetSimulationResults(&context, request);
+        ResultsChunk chunk;
+        std::string payload;
+        while (reader->Read(&chunk)) {
+            payload += chunk.data();
+        }
+        REQUIRE(reader->Finish().ok());
+
+        SimulationState state;
+        REQUIRE(state.ParseFromString(payload));
+        REQUIRE(state.grids_size() == 1);
+        REQUIRE(state.grids(0).substance() == SubstanceType::GLUCOSE);
+        REQUIRE(state.agents_size() == 0);
+    }
+
+    SECTION("A coarse axial slice is a small fraction of the grid") {
+        std::string sim_id = startTestSimulation(*stub, "test_patient_001", 1);
+        REQUIRE(waitForStatus(*stub, sim_id, SimulationStatus::COMPLETED));
+
+        grpc::ClientContext context;
+        ResultsRequest request;
+        request.set_simulation_id(sim_id);
+        request.set_include_grid_data(true);
+        request.add_substances(SubstanceType::OXYGEN);
+        request.set_step_number(-1);
+        request.mutable_slice()->set_axis(SliceAxis::SLICE_Z);
+        request.mutable_slice()->set_index(50);
+        request.set_level(2);
+
+        auto reader = stub->GetSimulationResults(&context, request);
+        ResultsChunk chunk;
+        std::string payload;
+        while (reader->Read(&chunk)) {
+            payload += chunk.data();
+        }
+        REQUIRE(reader->Finish().ok());
+
+        SimulationState state;
+        REQUIRE(state.ParseFromString(payload));
+        REQUIRE(state.grids_size() == 1);
+        const GridData& grid = state.grids(0);
+        REQUIRE(grid.level() == 2);
+        REQUIRE(grid.metadata().nx() == 25);
+        REQUIRE(grid.metadata().ny() == 25);
+        REQUIRE(grid.metadata().nz() == 1);
+        REQUIRE(grid.region().z_min() == 48);
+        REQUIRE(grid.region().z_max() == 52);
+        REQUIRE(grid.values().size() == 25 * 25 * sizeof(double));
+    }
+
+    SECTION("Unknown simulation ID returns NOT_FOUND") {
+        grpc::ClientContext context;
+        ResultsRequest request;
+        request.set_simulation_id("nonexistent-sim-id");
+
+        auto reader = stub->GetSimulationResults(&context, request);
+        ResultsChunk chunk;
+        REQUIRE(!reader->Read(&chunk));
+        REQUIRE(reader->Finish().error_code() == grpc::StatusCode::NOT_FOUND);
+    }
+
+    SECTION("Results of an unfinished simulation are not available") {
+        std::string sim_id = startTestSimulation(*stub, "test_patient_001", 1000000000);
+        REQUIRE(!sim_id.empty());
+
+        grpc::ClientContext context;
+        ResultsRequest request;
+        request.set_simulation_id(sim_id);
+        request.set_step_number(-1);
+
+        auto reader = stub->GetSimulationResults(&context, request);
+        ResultsChunk chunk;
+        REQUIRE(!reader->Read(&chunk));
+        REQUIRE(reader->Finish().error_code() == grpc::StatusCode::FAILED_PRECONDITION);
     }
     
     SECTION("Empty simulation ID is rejected") {
@@ -389,3 +1222,342 @@ TEST_CASE("GetSimulationResults works", "[grpc][server][results]") {
         REQUIRE(status.error_code() == grpc::StatusCode::INVALID_ARGUMENT);
     }
 }
+
+TEST_CASE("Past steps are served from the history", "[grpc][server][history]") {
+    TestServerFixture fixture;
+    REQUIRE(fixture.startServer());
+
+    auto stub = fixture.createStub();
+    // Snapshots follow the checkpoint interval of 10 steps
+    std::string sim_id = startTestSimulation(*stub, "test_patient_001", 25);
+    REQUIRE(!sim_id.empty());
+    REQUIRE(waitForStatus(*stub, sim_id, SimulationStatus::COMPLETED));
+
+    auto fetch = [&](ResultsRequest request, SimulationState* state) {
+        grpc::ClientContext context;
+        request.set_simulation_id(sim_id);
+        auto reader = stub->GetSimulationResults(&context, request);
+        ResultsChunk chunk;
+        std::string payload;
+        while (reader->Read(&chunk)) {
+            payload += chunk.data();
+        }
+        grpc::Status status = reader->Finish();
+        if (status.ok()) {
+            REQUIRE(state->ParseFromString(payload));
+        }
+        return status;
+    };
+
+    SECTION("GetMetricHistory returns every step column by column") {
+        grpc::ClientContext context;
+        MetricHistoryRequest request;
+        request.set_simulation_id(sim_id);
+        MetricHistory response;
+        REQUIRE(stub->GetMetricHistory(&context, request, &response).ok());
+        REQUIRE(response.simulation_id() == sim_id);
+        REQUIRE(response.step_number_size() == 26);
+        REQUIRE(response.total_cells_size() == 26);
+        for (int i = 0; i < response.step_number_size(); ++i) {
+            REQUIRE(response.step_number(i) == i);
+        }
+        REQUIRE(response.details_size() == 0);
+        REQUIRE(std::vector<int32_t>(response.snapshot_steps().begin(),
+                                     response.snapshot_steps().end()) ==
+                std::vector<int32_t>{0, 10, 20, 25});
+    }
+
+    SECTION("GetMetricHistory reads a strided range") {
+        grpc::ClientContext context;
+        MetricHistoryRequest request;
+        request.set_simulation_id(sim_id);
+        request.set_from_step(5);
+        request.set_to_step(15);
+        request.set_stride(5);
+        request.set_include_details(true);
+        MetricHistory response;
+        REQUIRE(stub->GetMetricHistory(&context, request, &response).ok());
+        REQUIRE(response.step_number_size() == 3);
+        REQUIRE(response.step_number(2) == 15);
+        REQUIRE(response.details_size() == 3);
+        REQUIRE(response.snapshot_steps_size() == 1);
+    }
+
+    SECTION("Metrics of any step are served") {
+        ResultsRequest request;
+        request.set_step_number(7);
+        SimulationState state;
+        REQUIRE(fetch(request, &state).ok());
+        REQUIRE(state.current_step() == 7);
+        REQUIRE(state.metrics().step_number() == 7);
+        REQUIRE(state.metrics().total_cells() > 0);
+        REQUIRE(state.grids_size() == 0);
+    }
+
+    SECTION("Grids and agents of a snapshot step are served") {
+        ResultsRequest request;
+        request.set_step_number(10);
+        request.set_include_agents(true);
+        request.set_include_grid_data(true);
+        request.add_substances(SubstanceType::OXYGEN);
+        SimulationState state;
+        REQUIRE(fetch(request, &state).ok());
+        REQUIRE(state.current_step() == 10);
+        REQUIRE(state.grids_size() == 1);
+        REQUIRE(state.grids(0).metadata().nx() == 100);
+        REQUIRE(state.agents_size() > 0);
+    }
+
+    SECTION("Grids of a step between snapshots are not found") {
+        ResultsRequest request;
+        request.set_step_number(7);
+        request.set_include_grid_data(true);
+        SimulationState state;
+        REQUIRE(fetch(request, &state).error_code() == grpc::StatusCode::NOT_FOUND);
+    }
+
+    SECTION("Steps that were never simulated are not found") {
+        ResultsRequest request;
+        request.set_step_number(26);
+        SimulationState state;
+        REQUIRE(fetch(request, &state).error_code() == grpc::StatusCode::NOT_FOUND);
+    }
+
+    SECTION("Unknown simulation ID returns NOT_FOUND") {
+        grpc::ClientContext context;
+        MetricHistoryRequest request;
+        request.set_simulation_id("nonexistent-sim-id");
+        MetricHistory response;
+        REQUIRE(stub->GetMetricHistory(&context, request, &response).error_code() ==
+                grpc::StatusCode::NOT_FOUND);
+    }
+}
+
+TEST_CASE("Metrics endpoint serves Prometheus metrics", "[grpc][server][metrics]") {
+    TestServerFixture fixture("127.0.0.1:0");
+    REQUIRE(fixture.startServer());
+    const int port = fixture.metricsPort();
+    REQUIRE(port > 0);
+
+    auto stub = fixture.createStub();
+    {
+        grpc::ClientContext context;
+        HealthCheckRequest request;
+        HealthCheckResponse response;
+        REQUIRE(stub->HealthCheck(&context, request, &response).ok());
+    }
+    std::string sim_id = startTestSimulation(*stub, "test_patient_001", 5);
+    REQUIRE(!sim_id.empty());
+    REQUIRE(waitForStatus(*stub, sim_id, SimulationStatus::COMPLETED));
+
+    SECTION("GET /metrics returns the registry") {
+        const std::string response = httpGet(port, "/metrics");
+        REQUIRE(response.rfind("HTTP/1.1 200 OK\r\n", 0) == 0);
+        REQUIRE(response.find("Content-Type: text/plain; version=0.0.4") != std::string::npos);
+        REQUIRE(response.find(
+                    "tumordtwin_rpc_requests_total{method=\"HealthCheck\",code=\"OK\"} 1\n") !=
+                std::string::npos);
+        REQUIRE(response.find("tumordtwin_rpc_duration_seconds_count{method=\"StartSimulation\"} 1\n") !=
+                std::string::npos);
+        REQUIRE(response.find("tumordtwin_simulation_steps_total 5\n") != std::string::npos);
+        REQUIRE(response.find("tumordtwin_step_duration_seconds_count 5\n") != std::string::npos);
+        REQUIRE(response.find("tumordtwin_phase_duration_seconds_count{phase=\"diffusion\"} 5\n") !=
+                std::string::npos);
+        REQUIRE(response.find("tumordtwin_simulations{status=\"COMPLETED\"} 1\n") !=
+                std::string::npos);
+        REQUIRE(response.find("tumordtwin_scheduler_queue_depth 0\n") != std::string::npos);
+    }
+
+    SECTION("Other paths and methods are rejected") {
+        REQUIRE(httpGet(port, "/").rfind("HTTP/1.1 404 Not Found\r\n", 0) == 0);
+        REQUIRE(httpRequest(port, "POST /metrics HTTP/1.1\r\n\r\n")
+                    .rfind("HTTP/1.1 405 Method Not Allowed\r\n", 0) == 0);
+        REQUIRE(httpRequest(port, "garbage\r\n\r\n").rfind("HTTP/1.1 400 Bad Request\r\n", 0) == 0);
+    }
+}
+
+TEST_CASE("Server options parse from command line names", "[grpc][server][options]") {
+    GrpcServerOptions options;
+    std::string error;
+
+    REQUIRE(options.set("mode", "async", error));
+    REQUIRE(options.mode == ServerMode::Async);
+    REQUIRE(options.set("cqs", "4", error));
+    REQUIRE(options.num_cqs == 4);
+    REQUIRE(options.set("pin-cqs", "true", error));
+    REQUIRE(options.pin_cqs);
+    REQUIRE(options.set("max-message-mb", "64", error));
+    REQUIRE(options.max_message_bytes == 64 << 20);
+    REQUIRE(options.set("warm-engines", "4", error));
+    REQUIRE(options.warm_engines == 4);
+    REQUIRE(options.set("warm-gpu", "1", error));
+    REQUIRE(options.warm_gpu);
+    REQUIRE(options.warmParameters().grid_size_z() == GrpcServerOptions::kDefaultWarmGrid);
+    REQUIRE(options.set("retain-finished", "100", error));
+    REQUIRE(options.retain_finished == 100);
+    REQUIRE(options.set("retain-finished-s", "3600", error));
+    REQUIRE(options.retain_finished_s == 3600);
+
+    REQUIRE(!options.set("mode", "threaded", error));
+    REQUIRE(!options.set("cqs", "-1", error));
+    REQUIRE(!options.set("cqs", "4x", error));
+    REQUIRE(!options.set("max-message-mb", "4096", error));
+    REQUIRE(!options.set("no-such-option", "1", error));
+    REQUIRE(!error.empty());
+}
+
+TEST_CASE("Async server mode serves every RPC", "[grpc][server][async]") {
+    GrpcServerOptions options;
+    options.mode = ServerMode::Async;
+    options.num_cqs = 2;
+    TestServerFixture fixture("", options);
+    REQUIRE(fixture.startServer());
+
+    auto stub = fixture.createStub();
+
+    {
+        grpc::ClientContext context;
+        HealthCheckResponse health;
+        REQUIRE(stub->HealthCheck(&context, HealthCheckRequest(), &health).ok());
+        REQUIRE(health.status() == HealthCheckResponse::SERVING);
+    }
+
+    std::string sim_id = startTestSimulation(*stub, "test_patient_001", 10);
+    REQUIRE(!sim_id.empty());
+
+    // Watch waits on alarms rather than a blocked thread
+    {
+        grpc::ClientContext context;
+        WatchRequest request;
+        request.set_simulation_id(sim_id);
+        auto reader = stub->WatchSimulation(&context, request);
+        StatusResponse update;
+        StatusResponse last;
+        while (reader->Read(&update)) {
+            last = update;
+        }
+        REQUIRE(reader->Finish().ok());
+        REQUIRE(last.status() == SimulationStatus::COMPLETED);
+        REQUIRE(last.current_step() == 10);
+    }
+
+    {
+        grpc::ClientContext context;
+        ResultsRequest request;
+        request.set_simulation_id(sim_id);
+        request.set_include_grid_data(true);
+        request.set_step_number(-1);
+        auto reader = stub->GetSimulationResults(&context, request);
+        ResultsChunk chunk;
+        std::string payload;
+        int32_t num_chunks = 0;
+        while (reader->Read(&chunk)) {
+            REQUIRE(chunk.chunk_number() == num_chunks++);
+            payload += chunk.data();
+        }
+        REQUIRE(reader->Finish().ok());
+        REQUIRE(chunk.is_final());
+        REQUIRE(num_chunks == chunk.total_chunks());
+
+        SimulationState state;
+        REQUIRE(state.ParseFromString(payload));
+        REQUIRE(state.current_step() == 10);
+    }
+
+    {
+        grpc::ClientContext context;
+        SimulationList list;
+        REQUIRE(stub->ListSimulations(&context, ListRequest(), &list).ok());
+        REQUIRE(list.simulations_size() == 1);
+    }
+
+    {
+        grpc::ClientContext context;
+        MetricHistoryRequest request;
+        request.set_simulation_id(sim_id);
+        MetricHistory history;
+        REQUIRE(stub->GetMetricHistory(&context, request, &history).ok());
+        REQUIRE(history.step_number_size() == 11);
+    }
+
+    SECTION("Errors keep their status codes") {
+        grpc::ClientContext status_context;
+        StatusRequest request;
+        request.set_simulation_id("no-such-simulation");
+        StatusResponse response;
+        REQUIRE(stub->GetSimulationStatus(&status_context, request, &response).error_code() ==
+                grpc::StatusCode::NOT_FOUND);
+
+        grpc::ClientContext watch_context;
+        WatchRequest watch;
+        watch.set_simulation_id("no-such-simulation");
+        auto reader = stub->WatchSimulation(&watch_context, watch);
+        REQUIRE(!reader->Read(&response));
+        REQUIRE(reader->Finish().error_code() == grpc::StatusCode::NOT_FOUND);
+    }
+
+    SECTION("StartSimulation checks parameters before the patient data") {
+        SimulationRequest request;
+        request.set_patient_id("test_patient_001");
+        *request.mutable_data() = createValidPatientData();
+        request.mutable_data()->mutable_dicom()->set_dicom_archive(std::string(1 << 20, 'x'));
+        *request.mutable_params() = createValidParameters();
+        request.mutable_params()->set_num_steps(0);
+
+        grpc::ClientContext bad_context;
+        SimulationResponse response;
+        grpc::Status status = stub->StartSimulation(&bad_context, request, &response);
+        REQUIRE(status.error_code() == grpc::StatusCode::INVALID_ARGUMENT);
+        REQUIRE(status.error_message() == "Number of steps must be positive");
+
+        // Patient data checks still apply once the parameters pass
+        grpc::ClientContext data_context;
+        request.mutable_params()->set_num_steps(3);
+        request.mutable_data()->mutable_dicom()->clear_patient_id();
+        REQUIRE(stub->StartSimulation(&data_context, request, &response).error_code() ==
+                grpc::StatusCode::INVALID_ARGUMENT);
+
+        grpc::ClientContext good_context;
+        request.mutable_data()->mutable_dicom()->set_patient_id("test_patient_001");
+        REQUIRE(stub->StartSimulation(&good_context, request, &response).ok());
+        REQUIRE(!response.simulation_id().empty());
+    }
+
+    SECTION("A cancelled watch releases its call") {
+        std::string long_id = startTestSimulation(*stub, "test_patient_001", 100000);
+        REQUIRE(!long_id.empty());
+
+        grpc::ClientContext context;
+        WatchRequest request;
+        request.set_simulation_id(long_id);
+        auto reader = stub->WatchSimulation(&context, request);
+        StatusResponse update;
+        REQUIRE(reader->Read(&update));
+        context.TryCancel();
+        while (reader->Read(&update)) {
+        }
+        REQUIRE(reader->Finish().error_code() == grpc::StatusCode::CANCELLED);
+
+        grpc::ClientContext stop_context;
+        StopRequest stop;
+        stop.set_simulation_id(long_id);
+        StopResponse stopped;
+        REQUIRE(stub->StopSimulation(&stop_context, stop, &stopped).ok());
+    }
+
+    SECTION("Uploads still run on the sync pool") {
+        grpc::ClientContext context;
+        UploadResponse upload;
+        auto writer = stub->UploadPatientData(&context, &upload);
+        PatientDataChunk chunk;
+        chunk.mutable_header()->set_patient_id("test_patient_001");
+        chunk.set_payload(UPLOAD_VCF);
+        chunk.set_data("##fileformat=VCFv4.2\n"
+                       "#CHROM\tPOS\tID\tREF\tALT\tQUAL\tFILTER\tINFO\tFORMAT\ttumor\n"
+                       "chr12\t25245350\t.\tC\tT\t60\tPASS\tAF=0.4\tGT\t0/1\n");
+        REQUIRE(writer->Write(chunk));
+        REQUIRE(writer->WritesDone());
+        REQUIRE(writer->Finish().ok());
+        REQUIRE(upload.mutations() == 1);
+    }
+}
@@ -0,0 +1,220 @@
+#include <catch2/catch_test_macros.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "simulation/job_scheduler.h"
+
+using namespace tumordtwin;
+
+namespace {
+
+// Job that blocks until released (or cancelled) and records peak concurrency
+struct GatedJobs {
+    std::atomic<bool> release{false};
+    std::atomic<int> running{0};
+    std::atomic<int> peak_threads{0};
+    std::atomic<int> active_threads{0};
+    std::atomic<int> completed{0};
+
+    std::shared_ptr<SimulationJob> make(const std::string& id, unsigned threads = 1) {
+        auto job = std::make_shared<SimulationJob>();
+        job->simulation_id = id;
+        job->num_threads = threads;
+        job->run = [this](SimulationJob& j) {
+            ++running;
+            int now = active_threads += static_cast<int>(j.num_threads);
+            int prev = peak_threads.load();
+            while (now > prev && !peak_threads.compare_exchange_weak(prev, now)) {}
+
+            while (!release && !j.cancelRequested()) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+
+            active_threads -= static_cast<int>(j.num_threads);
+            --running;
+            ++completed;
+        };
+        return job;
+    }
+};
+
+template <typename Pred>
+bool waitFor(Pred pred, std::chrono::milliseconds timeout = std::chrono::milliseconds(2000)) {
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (!pred()) {
+        if (std::chrono::steady_clock::now() > deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+} // namespace
+
+TEST_CASE("JobScheduler runs submitted jobs", "[scheduler]") {
+    JobScheduler scheduler(8, 2);
+    GatedJobs jobs;
+    jobs.release = true;
+
+    for (int i = 0; i < 5; ++i) {
+        REQUIRE(scheduler.submit(jobs.make("job-" + std::to_string(i))));
+    }
+
+    REQUIRE(waitFor([&] { return jobs.completed == 5; }));
+    REQUIRE(scheduler.queueDepth() == 0);
+}
+
+TEST_CASE("JobScheduler applies admission control", "[scheduler][admission]") {
+    JobScheduler scheduler(2, 1);
+    GatedJobs jobs;
+
+    REQUIRE(scheduler.submit(jobs.make("running")));
+    REQUIRE(waitFor([&] { return jobs.running == 1; }));
+
+    REQUIRE(scheduler.submit(jobs.make("queued-1")));
+    REQUIRE(scheduler.submit(jobs.make("queued-2")));
+    REQUIRE(scheduler.queueDepth() == 2);
+
+    // Queue is at capacity: further work is refused instead of piling up
+    REQUIRE_FALSE(scheduler.submit(jobs.make("rejected")));
+
+    jobs.release = true;
+    REQUIRE(waitFor([&] { return jobs.completed == 3; }));
+    REQUIRE(scheduler.submit(jobs.make("after-drain")));
+}
+
+TEST_CASE("JobScheduler queues batches whole or not at all", "[scheduler][admission]") {
+    JobScheduler scheduler(3, 1);
+    GatedJobs jobs;
+
+    REQUIRE(scheduler.submit(jobs.make("running")));
+    REQUIRE(waitFor([&] { return jobs.running == 1; }));
+
+    // Four jobs do not fit into a queue of three, so none of them is queued
+    std::vector<std::shared_ptr<SimulationJob>> batch;
+    for (int i = 0; i < 4; ++i) {
+        batch.push_back(jobs.make("batch-" + std::to_string(i)));
+    }
+    REQUIRE_FALSE(scheduler.submitBatch(batch));
+    REQUIRE(scheduler.queueDepth() == 0);
+
+    batch.pop_back();
+    REQUIRE(scheduler.submitBatch(batch));
+    REQUIRE(scheduler.queueDepth() == 3);
+    REQUIRE_FALSE(scheduler.submitBatch({}));
+
+    jobs.release = true;
+    REQUIRE(waitFor([&] { return jobs.completed == 4; }));
+}
+
+TEST_CASE("JobScheduler never oversubscribes its core budget", "[scheduler][threads]") {
+    JobScheduler scheduler(16, 4);
+    GatedJobs jobs;
+
+    SECTION("Thread requests are resolved against the budget") {
+        REQUIRE(scheduler.resolveThreadCount(0) == 1);
+        REQUIRE(scheduler.resolveThreadCount(3) == 3);
+        REQUIRE(scheduler.resolveThreadCount(64) == 4);
+    }
+
+    SECTION("Concurrent jobs share the budget") {
+        for (int i = 0; i < 6; ++i) {
+            REQUIRE(scheduler.submit(jobs.make("wide-" + std::to_string(i), 3)));
+        }
+
+        REQUIRE(waitFor([&] { return jobs.running == 1; }));
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        // Two 3-thread jobs do not fit into 4 cores
+        REQUIRE(jobs.running == 1);
+
+        jobs.release = true;
+        REQUIRE(waitFor([&] { return jobs.completed == 6; }));
+        REQUIRE(jobs.peak_threads <= 4);
+    }
+}
+
+TEST_CASE("JobScheduler cancels queued and running jobs", "[scheduler][cancel]") {
+    JobScheduler scheduler(4, 1);
+    GatedJobs jobs;
+
+    auto running = jobs.make("running");
+    auto queued = jobs.make("queued");
+    REQUIRE(scheduler.submit(running));
+    REQUIRE(waitFor([&] { return jobs.running == 1; }));
+    REQUIRE(scheduler.submit(queued));
+
+    REQUIRE(scheduler.cancel("queued"));
+    REQUIRE(scheduler.queueDepth() == 0);
+    REQUIRE(queued->cancelRequested());
+
+    REQUIRE(scheduler.cancel("running"));
+    REQUIRE(waitFor([&] { return jobs.completed == 1; }));
+
+    REQUIRE_FALSE(scheduler.cancel("unknown"));
+}
+
+TEST_CASE("JobScheduler hands movable queued jobs over", "[scheduler][steal]") {
+    JobScheduler scheduler(8, 1);
+    GatedJobs jobs;
+
+    auto running = jobs.make("running");
+    running->cost = 100.0;
+    REQUIRE(scheduler.submit(running));
+    REQUIRE(waitFor([&] { return jobs.running == 1; }));
+
+    std::vector<std::shared_ptr<SimulationJob>> queued;
+    for (const char* id : {"a", "b", "pinned", "c"}) {
+        auto job = jobs.make(id);
+        job->cost = 10.0;
+        job->movable = std::string(id) != "pinned";
+        queued.push_back(job);
+        REQUIRE(scheduler.submit(job));
+    }
+    REQUIRE(scheduler.coresInUse() == 1);
+    REQUIRE(scheduler.queuedCost() == 40.0);
+    REQUIRE(scheduler.outstandingCost() == 140.0);
+
+    // Latest first, skipping jobs that must stay
+    auto taken = scheduler.takeQueued(2);
+    REQUIRE(taken.size() == 2);
+    REQUIRE(taken[0]->simulation_id == "c");
+    REQUIRE(taken[1]->simulation_id == "b");
+    REQUIRE_FALSE(taken[0]->cancelRequested());
+    REQUIRE(scheduler.queueDepth() == 2);
+    REQUIRE(scheduler.queuedCost() == 20.0);
+
+    // Handed back in their original order
+    scheduler.restore(taken);
+    REQUIRE(scheduler.queueDepth() == 4);
+    REQUIRE(scheduler.queuedCost() == 40.0);
+    taken = scheduler.takeQueued(2);
+    REQUIRE(taken[0]->simulation_id == "c");
+    REQUIRE(taken[1]->simulation_id == "b");
+
+    taken = scheduler.takeQueued(5);
+    REQUIRE(taken.size() == 1);
+    REQUIRE(taken[0]->simulation_id == "a");
+    REQUIRE(scheduler.takeQueued(5).empty());
+
+    jobs.release = true;
+    REQUIRE(waitFor([&] { return jobs.completed == 2; }));
+    REQUIRE(scheduler.outstandingCost() == 0.0);
+}
+
+TEST_CASE("JobScheduler shutdown stops workers", "[scheduler][shutdown]") {
+    JobScheduler scheduler(4, 2);
+    GatedJobs jobs;
+
+    REQUIRE(scheduler.submit(jobs.make("a")));
+    REQUIRE(waitFor([&] { return jobs.running == 1; }));
+
+    scheduler.shutdown();
+    REQUIRE(jobs.completed == 1);
+    REQUIRE_FALSE(scheduler.submit(jobs.make("late")));
+}
@@ -0,0 +1,172 @@
+#include <catch2/catch_test_macros.hpp>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "simulation/simulation_engine.h"
+#include "utils/metrics_registry.h"
+#include "utils/profiler.h"
+
+using namespace tumordtwin;
+
+namespace {
+
+bool contains(const std::string& text, const std::string& needle) {
+    return text.find(needle) != std::string::npos;
+}
+
+} // namespace
+
+// ============================================================================
+// MetricsRegistry
+// ============================================================================
+
+TEST_CASE("Histogram buckets are inclusive and rendered cumulatively", "[metrics][histogram]") {
+    MetricsRegistry registry;
+    Histogram& h = registry.histogram("test_duration_seconds", "Test durations", {},
+                                      {0.5, 1.0, 10.0});
+    h.observe(0.25);
+    h.observe(0.5);   // On a bound: counts in that bucket
+    h.observe(4.0);
+    h.observe(100.0); // Only in +Inf
+
+    REQUIRE(h.count() == 4);
+    REQUIRE(h.bucketCount(0) == 2);
+    REQUIRE(h.bucketCount(1) == 0);
+    REQUIRE(h.bucketCount(2) == 1);
+    REQUIRE(h.bucketCount(3) == 1);
+    REQUIRE(h.sum() == 104.75);
+
+    const std::string text = registry.renderPrometheus();
+    REQUIRE(contains(text, "# HELP test_duration_seconds Test durations\n"));
+    REQUIRE(contains(text, "# TYPE test_duration_seconds histogram\n"));
+    REQUIRE(contains(text, "test_duration_seconds_bucket{le=\"0.5\"} 2\n"));
+    REQUIRE(contains(text, "test_duration_seconds_bucket{le=\"1\"} 2\n"));
+    REQUIRE(contains(text, "test_duration_seconds_bucket{le=\"10\"} 3\n"));
+    REQUIRE(contains(text, "test_duration_seconds_bucket{le=\"+Inf\"} 4\n"));
+    REQUIRE(contains(text, "test_duration_seconds_sum 104.75\n"));
+    REQUIRE(contains(text, "test_duration_seconds_count 4\n"));
+}
+
+TEST_CASE("Series are created once per label set", "[metrics][registry]") {
+    MetricsRegistry registry;
+    Counter& ok = registry.counter("requests_total", "Requests", {{"code", "OK"}});
+    Counter& again = registry.counter("requests_total", "Requests", {{"code", "OK"}});
+    Counter& failed = registry.counter("requests_total", "Requests", {{"code", "INTERNAL"}});
+    REQUIRE(&ok == &again);
+    REQUIRE(&ok != &failed);
+
+    ok.increment();
+    ok.increment(2);
+    const std::string text = registry.renderPrometheus();
+    REQUIRE(contains(text, "# TYPE requests_total counter\n"));
+    REQUIRE(contains(text, "requests_total{code=\"OK\"} 3\n"));
+    REQUIRE(contains(text, "requests_total{code=\"INTERNAL\"} 0\n"));
+
+    SECTION("Labelled histograms add le after their labels") {
+        registry.histogram("latency_seconds", "Latency", {{"method", "Get"}}, {1.0}).observe(0.5);
+        REQUIRE(contains(registry.renderPrometheus(),
+                         "latency_seconds_bucket{method=\"Get\",le=\"1\"} 1\n"));
+    }
+
+    SECTION("Label values are escaped") {
+        registry.counter("escaped_total", "Escaped", {{"path", "a\"b\\c\nd"}}).increment();
+        REQUIRE(contains(registry.renderPrometheus(), "escaped_total{path=\"a\\\"b\\\\c\\nd\"} 1\n"));
+    }
+
+    SECTION("A name cannot change type") {
+        REQUIRE_THROWS_AS(registry.histogram("requests_total", "Requests"), std::logic_error);
+    }
+}
+
+TEST_CASE("Gauges are read when rendered", "[metrics][gauge]") {
+    MetricsRegistry registry;
+    double depth = 3;
+    registry.gauge("queue_depth", "Queued jobs", {}, [&depth] { return depth; });
+    REQUIRE(contains(registry.renderPrometheus(), "queue_depth 3\n"));
+
+    depth = 7.5;
+    REQUIRE(contains(registry.renderPrometheus(), "# TYPE queue_depth gauge\nqueue_depth 7.5\n"));
+}
+
+TEST_CASE("Histograms can be observed concurrently", "[metrics][histogram][concurrency]") {
+    Histogram h(MetricsRegistry::latencyBuckets());
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&h] {
+            for (int i = 0; i < 10000; ++i) {
+                h.observe(1e-3);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    REQUIRE(h.count() == 40000);
+    REQUIRE(h.sum() > 39.99);
+    REQUIRE(h.sum() < 40.01);
+}
+
+// ============================================================================
+// StepProfiler
+// ============================================================================
+
+TEST_CASE("StepProfiler accumulates phase timings", "[metrics][profiler]") {
+    StepProfiler profiler;
+    profiler.record(ProfilePhase::Diffusion, 2000000);
+    profiler.record(ProfilePhase::Diffusion, 4000000);
+
+    const auto& stats = profiler.stats(ProfilePhase::Diffusion);
+    REQUIRE(stats.calls == 2);
+    REQUIRE(stats.total_ns == 6000000);
+    REQUIRE(stats.max_ns == 4000000);
+    REQUIRE(stats.last_ns == 4000000);
+
+    SimulationMetrics metrics;
+    profiler.toExtraMetrics(metrics.mutable_extra_metrics());
+    REQUIRE(metrics.extra_metrics().at("profile.diffusion_ms") == 3.0);
+    // Phases that never ran are left out
+    REQUIRE(metrics.extra_metrics().count("profile.checkpoint_ms") == 0);
+
+    {
+        ScopedPhaseTimer timer(profiler, ProfilePhase::Checkpoint);
+    }
+    REQUIRE(profiler.stats(ProfilePhase::Checkpoint).calls == 1);
+
+    profiler.reset();
+    REQUIRE(profiler.stats(ProfilePhase::Diffusion).calls == 0);
+}
+
+TEST_CASE("SimulationEngine profiles its step phases", "[metrics][profiler][engine]") {
+    SimulationParameters params;
+    params.set_grid_size_x(16);
+    params.set_grid_size_y(16);
+    params.set_grid_size_z(8);
+    params.set_spatial_resolution(10.0);
+    params.set_num_steps(5);
+    params.set_time_step(0.1);
+    params.set_division_rate(0.5);
+    params.set_death_rate(0.05);
+    params.set_oxygen_diffusion_coeff(100.0);
+    params.set_glucose_diffusion_coeff(80.0);
+    (*params.mutable_extra_params())[SimulationEngine::kParamInitialTumorCells] = 100;
+
+    SimulationEngine engine(params, 1);
+    engine.initialize();
+    for (int i = 0; i < 5; ++i) {
+        engine.step();
+    }
+
+    const StepProfiler& profiler = engine.profiler();
+    REQUIRE(profiler.stats(ProfilePhase::Diffusion).calls == 5);
+    REQUIRE(profiler.stats(ProfilePhase::AgentUpdate).calls == 5);
+    REQUIRE(profiler.stats(ProfilePhase::Lifecycle).calls == 5);
+    // No treatment: drug transport never runs
+    REQUIRE(profiler.stats(ProfilePhase::DrugTransport).calls == 0);
+
+    SimulationMetrics metrics;
+    engine.computeMetrics(&metrics);
+    REQUIRE(metrics.extra_metrics().count("profile.diffusion_ms") == 1);
+    REQUIRE(metrics.extra_metrics().count("profile.lifecycle_ms") == 1);
+    REQUIRE(metrics.extra_metrics().count("profile.drug_transport_ms") == 0);
+}
@@ -0,0 +1,482 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/catch_approx.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <zlib.h>
+
+#include "common.pb.h"
+#include "data/dicom_volume.h"
+#include "data/patient_cache.h"
+#include "data/patient_model.h"
+#include "simulation/simulation_engine.h"
+#include "utils/sha256.h"
+
+using namespace tumordtwin;
+using Catch::Approx;
+
+namespace {
+
+void appendLe(std::string* out, uint64_t value, size_t bytes) {
+    for (size_t b = 0; b < bytes; ++b) {
+        out->push_back(static_cast<char>(value >> (8 * b)));
+    }
+}
+
+std::string gzipCompress(const std::string& text) {
+    z_stream stream{};
+    deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, MAX_WBITS + 16, 8, Z_DEFAULT_STRATEGY);
+    std::string out(deflateBound(&stream, text.size()), '\0');
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(text.data()));
+    stream.avail_in = static_cast<uInt>(text.size());
+    stream.next_out = reinterpret_cast<Bytef*>(&out[0]);
+    stream.avail_out = static_cast<uInt>(out.size());
+    deflate(&stream, Z_FINISH);
+    out.resize(stream.total_out);
+    deflateEnd(&stream);
+    return out;
+}
+
+// Writer for the little-endian DICOM encodings the volume reader accepts
+class DicomWriter {
+public:
+    explicit DicomWriter(bool explicit_vr) : explicit_vr_(explicit_vr) {
+        out_.assign(128, '\0');
+        out_ += "DICM";
+        // The meta group is explicit VR in both encodings
+        const bool dataset_vr = explicit_vr_;
+        explicit_vr_ = true;
+        text(0x0002, 0x0010, "UI",
+             dataset_vr ? std::string("1.2.840.10008.1.2.1", 20) : std::string("1.2.840.10008.1.2"));
+        explicit_vr_ = dataset_vr;
+    }
+
+    void element(uint16_t group, uint16_t tag, const char* vr, const std::string& value) {
+        header(group, tag, vr, static_cast<uint32_t>(value.size()));
+        out_ += value;
+    }
+
+    void text(uint16_t group, uint16_t tag, const char* vr, std::string value) {
+        if (value.size() % 2 != 0) {
+            value.push_back(' ');
+        }
+        element(group, tag, vr, value);
+    }
+
+    void us(uint16_t group, uint16_t tag, uint16_t value) {
+        std::string bytes;
+        appendLe(&bytes, value, 2);
+        element(group, tag, "US", bytes);
+    }
+
+    // An undefined-length sequence holding one undefined-length item
+    void sequence(uint16_t group, uint16_t tag) {
+        header(group, tag, "SQ", 0xFFFFFFFF);
+        appendTag(0xFFFE, 0xE000);
+        appendLe(&out_, 0xFFFFFFFF, 4);
+        text(0x0008, 0x1150, "UI", "1.2.3");
+        appendTag(0xFFFE, 0xE00D);
+        appendLe(&out_, 0, 4);
+        appendTag(0xFFFE, 0xE0DD);
+        appendLe(&out_, 0, 4);
+    }
+
+    const std::string& bytes() const { return out_; }
+
+private:
+    void appendTag(uint16_t group, uint16_t tag) {
+        appendLe(&out_, group, 2);
+        appendLe(&out_, tag, 2);
+    }
+
+    void header(uint16_t group, uint16_t tag, const char* vr, uint32_t length) {
+        appendTag(group, tag);
+        if (!explicit_vr_) {
+            appendLe(&out_, length, 4);
+            return;
+        }
+        out_.append(vr, 2);
+        const std::string long_vrs = "OB OW SQ UN UT";
+        if (long_vrs.find(vr) != std::string::npos) {
+            appendLe(&out_, 0, 2);
+            appendLe(&out_, length, 4);
+        } else {
+            appendLe(&out_, length, 2);
+        }
+    }
+
+    bool explicit_vr_;
+    std::string out_;
+};
+
+// One 16-bit slice at height z; pixel (i, j) holds value(i, j)
+template <typename F>
+std::string dicomSlice(int rows, int columns, double z, int instance, bool explicit_vr, F value,
+                       double slope = 1.0) {
+    DicomWriter writer(explicit_vr);
+    writer.sequence(0x0008, 0x1140);
+    writer.text(0x0018, 0x0050, "DS", "3.0");
+    writer.text(0x0020, 0x0013, "IS", std::to_string(instance));
+    writer.text(0x0020, 0x0032, "DS", "-10.0\\-10.0\\" + std::to_string(z));
+    writer.us(0x0028, 0x0002, 1);
+    writer.us(0x0028, 0x0010, static_cast<uint16_t>(rows));
+    writer.us(0x0028, 0x0011, static_cast<uint16_t>(columns));
+    writer.text(0x0028, 0x0030, "DS", "0.5\\0.25");
+    writer.us(0x0028, 0x0100, 16);
+    writer.us(0x0028, 0x0103, 0);
+    writer.text(0x0028, 0x1052, "DS", "0");
+    writer.text(0x0028, 0x1053, "DS", std::to_string(slope));
+    std::string pixels;
+    for (int j = 0; j < rows; ++j) {
+        for (int i = 0; i < columns; ++i) {
+            appendLe(&pixels, static_cast<uint16_t>(value(i, j)), 2);
+        }
+    }
+    writer.element(0x7FE0, 0x0010, "OW", pixels);
+    return writer.bytes();
+}
+
+// Label map with a 2x2 tumor in slices 1 and 2 of a 4-slice, 6x5 series
+std::string labelMapArchive() {
+    std::string archive;
+    for (int s : {2, 0, 3, 1}) {  // Out of order on purpose
+        archive += dicomSlice(5, 6, 2.0 * s, s + 1, s % 2 == 0, [s](int i, int j) {
+            return (s == 1 || s == 2) && i >= 2 && i < 4 && j >= 1 && j < 3 ? 1 : 0;
+        });
+    }
+    return archive;
+}
+
+Mutation* addMutation(VcfData* vcf, const std::string& chromosome, int64_t position,
+                      const std::string& ref, const std::string& alt, double frequency) {
+    Mutation* mutation = vcf->add_mutations();
+    mutation->set_chromosome(chromosome);
+    mutation->set_position(position);
+    mutation->set_reference_allele(ref);
+    mutation->set_alternate_allele(alt);
+    mutation->set_allele_frequency(frequency);
+    return mutation;
+}
+
+PatientData patientData(const std::string& patient_id = "patient_cache_001") {
+    PatientData data;
+    data.set_patient_id(patient_id);
+    data.mutable_dicom()->set_patient_id(patient_id);
+    data.mutable_dicom()->set_dicom_archive(gzipCompress(labelMapArchive()));
+    data.mutable_vcf()->set_sample_id("tumor");
+    addMutation(data.mutable_vcf(), "chr12", 25245350, "C", "T", 0.5);    // KRAS:G12D, clonal
+    addMutation(data.mutable_vcf(), "17", 7675088, "C", "T", 0.45);       // TP53:R175H, clonal
+    addMutation(data.mutable_vcf(), "3", 179234297, "A", "G", 0.2);       // PIK3CA:H1047R
+    addMutation(data.mutable_vcf(), "5", 1000, "G", "C", 0.18);           // Passenger with it
+    return data;
+}
+
+std::string scratchDirectory(const std::string& name) {
+    auto dir = std::filesystem::temp_directory_path() / ("tumordtwin_test_" + name);
+    std::filesystem::remove_all(dir);
+    return dir.string();
+}
+
+SimulationParameters engineParameters() {
+    SimulationParameters params;
+    params.set_grid_size_x(32);
+    params.set_grid_size_y(32);
+    params.set_grid_size_z(32);
+    params.set_spatial_resolution(10.0);
+    params.set_time_step(0.1);
+    params.set_division_rate(0.5);
+    params.set_death_rate(0.05);
+    params.set_oxygen_diffusion_coeff(100.0);
+    params.set_glucose_diffusion_coeff(80.0);
+    (*params.mutable_extra_params())[SimulationEngine::kParamInitialTumorCells] = 500;
+    (*params.mutable_extra_params())[SimulationEngine::kParamSparseGrid] = 0;
+    return params;
+}
+
+} // namespace
+
+TEST_CASE("Sha256 matches the FIPS 180 test vectors", "[data][cache]") {
+    Sha256 hasher;
+    REQUIRE(hasher.hexDigest() ==
+            "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+
+    hasher.update("abc");
+    REQUIRE(hasher.hexDigest() ==
+            "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+
+    hasher.update("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq");
+    REQUIRE(hasher.hexDigest() ==
+            "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1");
+
+    // A million 'a's in uneven pieces, crossing block boundaries
+    const std::string a(1000000, 'a');
+    for (size_t offset = 0, piece = 1; offset < a.size(); offset += piece, piece = piece * 3 % 997 + 1) {
+        hasher.update(a.data() + offset, std::min(piece, a.size() - offset));
+    }
+    REQUIRE(hasher.hexDigest() ==
+            "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0");
+}
+
+TEST_CASE("DicomVolume stacks a series in position order", "[data][dicom]") {
+    DicomVolume volume;
+    std::string error_msg;
+    const std::string archive = labelMapArchive();
+    REQUIRE(DicomVolume::isDicom(archive));
+    REQUIRE(volume.parse(archive, error_msg));
+
+    CHECK(volume.nx() == 6);
+    CHECK(volume.ny() == 5);
+    CHECK(volume.nz() == 4);
+    CHECK(volume.dx() == Approx(0.25));  // Pixel spacing is row spacing, then column spacing
+    CHECK(volume.dy() == Approx(0.5));
+    CHECK(volume.dz() == Approx(2.0));   // From the positions, not the 3 mm thickness
+    REQUIRE(volume.values().size() == 6u * 5u * 4u);
+    size_t tumor = 0;
+    for (int k = 0; k < 4; ++k) {
+        for (int j = 0; j < 5; ++j) {
+            for (int i = 0; i < 6; ++i) {
+                const bool inside = (k == 1 || k == 2) && i >= 2 && i < 4 && j >= 1 && j < 3;
+                const float value = volume.values()[(k * 5 + j) * 6 + i];
+                CHECK(value == (inside ? 1.0f : 0.0f));
+                tumor += value > 0.0f;
+            }
+        }
+    }
+    CHECK(tumor == 8);
+
+    SECTION("stored values are rescaled") {
+        const std::string slice = dicomSlice(2, 2, 0.0, 1, true, [](int i, int j) {
+            return i + 2 * j;
+        }, 2.5);
+        REQUIRE(volume.parse(slice, error_msg));
+        CHECK(volume.nz() == 1);
+        CHECK(volume.values()[3] == Approx(7.5));
+    }
+
+    SECTION("unsupported and malformed files are rejected") {
+        DicomWriter big_endian(true);
+        std::string bytes = big_endian.bytes();
+        bytes.replace(bytes.find("1.2.840.10008.1.2.1"), 19, "1.2.840.10008.1.2.2");
+        CHECK_FALSE(volume.parse(bytes, error_msg));
+        CHECK(error_msg.find("transfer syntax") != std::string::npos);
+
+        CHECK_FALSE(volume.parse(archive.substr(0, archive.size() - 7), error_msg));
+        CHECK_FALSE(volume.parse(archive + "trailing junk", error_msg));
+    }
+}
+
+TEST_CASE("PatientModel segments the series and nests the clones", "[data][cache]") {
+    PatientModel model;
+    std::string error_msg;
+    const PatientData data = patientData();
+    REQUIRE(PatientModel::build(data, &model, error_msg));
+
+    const TumorGeometry& geometry = model.geometry;
+    CHECK(geometry.nx == 6);
+    CHECK(geometry.ny == 5);
+    CHECK(geometry.nz == 4);
+    CHECK(geometry.voxels.size() == 8);
+
+    // KRAS and TP53 (fractions 1.0, 0.9) found the trunk; PIK3CA and the passenger a subclone
+    REQUIRE(model.genotypes.size() == 3);
+    REQUIRE(model.clone_fractions.size() == 3);
+    CHECK(model.clone_fractions[0] == Approx(0.05));
+    CHECK(model.clone_fractions[1] == Approx(0.95 - 0.38));
+    CHECK(model.clone_fractions[2] == Approx(0.38));
+    CHECK(model.genotypes.parent(2) == 1);
+
+    Genotype trunk, subclone;
+    REQUIRE(trunk.ParseFromString(model.genotypes.get(1)));
+    REQUIRE(subclone.ParseFromString(model.genotypes.get(2)));
+    CHECK(trunk.mutation_positions_size() == 2);
+    CHECK(std::vector<std::string>(trunk.driver_mutations().begin(), trunk.driver_mutations().end()) ==
+          std::vector<std::string>{"KRAS:G12D", "TP53:R175H"});
+    CHECK(subclone.mutation_positions_size() == 4);
+    CHECK(subclone.driver_mutations_size() == 3);
+
+    SECTION("the model survives its cache encoding") {
+        PreprocessedPatient proto;
+        model.toProto(&proto);
+        PatientModel restored;
+        REQUIRE(restored.fromProto(proto, error_msg));
+        CHECK(restored.geometry.voxels == model.geometry.voxels);
+        CHECK(restored.geometry.dz == model.geometry.dz);
+        CHECK(restored.clone_fractions == model.clone_fractions);
+        REQUIRE(restored.genotypes.size() == model.genotypes.size());
+        for (GenotypeTable::GenotypeId id = 0; id < model.genotypes.size(); ++id) {
+            CHECK(restored.genotypes.get(id) == model.genotypes.get(id));
+            CHECK(restored.genotypes.parent(id) == model.genotypes.parent(id));
+        }
+
+        proto.set_genotype_parents(1, 2);
+        CHECK_FALSE(restored.fromProto(proto, error_msg));
+    }
+
+    SECTION("an intensity window selects the tumor") {
+        PatientData windowed = data;
+        (*windowed.mutable_metadata())[PatientModel::kMetadataSegmentationLower] = "-1";
+        (*windowed.mutable_metadata())[PatientModel::kMetadataSegmentationUpper] = "0.5";
+        REQUIRE(PatientModel::build(windowed, &model, error_msg));
+        CHECK(model.geometry.voxels.size() == 6u * 5u * 4u - 8u);
+
+        (*windowed.mutable_metadata())[PatientModel::kMetadataSegmentationUpper] = "high";
+        CHECK_FALSE(PatientModel::build(windowed, &model, error_msg));
+    }
+
+    SECTION("archives without DICOM files carry no geometry") {
+        PatientData opaque = data;
+        opaque.mutable_dicom()->set_dicom_archive("dummy_dicom_data");
+        opaque.mutable_vcf()->clear_mutations();
+        REQUIRE(PatientModel::build(opaque, &model, error_msg));
+        CHECK(model.empty());
+    }
+}
+
+TEST_CASE("PatientCache builds each patient once", "[data][cache]") {
+    const std::string directory = scratchDirectory("patient_cache");
+    std::string error_msg;
+    std::string key;
+    REQUIRE(PatientCache::contentKey(patientData(), &key, error_msg));
+    CHECK(key.size() == 64);
+
+    std::shared_ptr<const PatientModel> first;
+    {
+        PatientCache cache(directory);
+        first = cache.get(patientData(), error_msg);
+        REQUIRE(first);
+        CHECK(first->geometry.voxels.size() == 8);
+        CHECK(std::filesystem::exists(cache.modelPath(key)));
+
+        // IDs are not content, so another name for the same data hits
+        std::shared_ptr<const PatientModel> again = cache.get(patientData("renamed"), error_msg);
+        CHECK(again == first);
+
+        PatientData changed = patientData();
+        changed.mutable_vcf()->mutable_mutations(2)->set_allele_frequency(0.3);
+        std::shared_ptr<const PatientModel> other = cache.get(changed, error_msg);
+        REQUIRE(other);
+        CHECK(other != first);
+
+        const PatientCache::Stats stats = cache.stats();
+        CHECK(stats.misses == 2);
+        CHECK(stats.hits == 1);
+        CHECK(stats.disk_hits == 0);
+        CHECK(stats.entries == 2);
+        CHECK(stats.memory_bytes > 0);
+    }
+
+    SECTION("a new cache reads the models back from disk") {
+        PatientCache cache(directory);
+        std::shared_ptr<const PatientModel> loaded = cache.get(patientData(), error_msg);
+        REQUIRE(loaded);
+        CHECK(loaded->geometry.voxels == first->geometry.voxels);
+        CHECK(loaded->clone_fractions == first->clone_fractions);
+        CHECK(cache.stats().disk_hits == 1);
+        CHECK(cache.stats().misses == 0);
+    }
+
+    SECTION("models evicted from memory are served from disk") {
+        // Room for one model; a passenger at another frequency keeps the clones the same size
+        PatientCache cache(directory, first->memoryBytes());
+        PatientData changed = patientData();
+        changed.mutable_vcf()->mutable_mutations(3)->set_allele_frequency(0.17);
+        REQUIRE(cache.get(patientData(), error_msg));
+        REQUIRE(cache.get(changed, error_msg));  // Built, and evicts the first
+        REQUIRE(cache.get(patientData(), error_msg));
+        CHECK(cache.stats().entries == 1);
+        CHECK(cache.stats().disk_hits == 2);
+        CHECK(cache.stats().misses == 1);
+    }
+
+    SECTION("corrupt files are rebuilt") {
+        { std::ofstream(PatientCache(directory).modelPath(key), std::ios::trunc) << "garbage"; }
+        PatientCache cache(directory);
+        REQUIRE(cache.get(patientData(), error_msg));
+        CHECK(cache.stats().misses == 1);
+    }
+
+    SECTION("concurrent requests share one build") {
+        std::filesystem::remove_all(directory);
+        PatientCache cache(directory);
+        std::vector<std::shared_ptr<const PatientModel>> models(8);
+        std::vector<std::thread> threads;
+        for (size_t t = 0; t < models.size(); ++t) {
+            threads.emplace_back([&, t] {
+                std::string thread_error;
+                models[t] = cache.get(patientData(), thread_error);
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        for (const auto& model : models) {
+            CHECK(model == models[0]);
+        }
+        CHECK(cache.stats().misses == 1);
+        CHECK(cache.stats().hits == models.size() - 1);
+    }
+
+    SECTION("build errors are reported and not cached") {
+        PatientCache cache(directory);
+        PatientData corrupt = patientData();
+        corrupt.mutable_dicom()->set_dicom_archive(labelMapArchive().substr(0, 400));
+        CHECK_FALSE(cache.get(corrupt, error_msg));
+        CHECK_FALSE(error_msg.empty());
+        CHECK(cache.stats().entries == 0);
+    }
+
+    std::filesystem::remove_all(directory);
+}
+
+TEST_CASE("SimulationEngine seeds the patient's tumor", "[data][cache]") {
+    PatientModel model;
+    std::string error_msg;
+    REQUIRE(PatientModel::build(patientData(), &model, error_msg));
+
+    SimulationEngine engine(engineParameters());
+    engine.initialize(model);
+
+    const AgentStore& agents = engine.agents();
+    REQUIRE(agents.size() == 500);
+    REQUIRE(engine.genotypes().size() == model.genotypes.size());
+    for (GenotypeTable::GenotypeId id = 0; id < model.genotypes.size(); ++id) {
+        CHECK(engine.genotypes().get(id) == model.genotypes.get(id));
+    }
+
+    // The 2x2x2 voxel tumor is 0.5 x 1 x 4 mm: flattened along x, elongated along z
+    double lo[3] = {1e9, 1e9, 1e9}, hi[3] = {-1e9, -1e9, -1e9};
+    for (size_t n = 0; n < agents.size(); ++n) {
+        const double p[3] = {agents.x()[n], agents.y()[n], agents.z()[n]};
+        for (int a = 0; a < 3; ++a) {
+            lo[a] = std::min(lo[a], p[a]);
+            hi[a] = std::max(hi[a], p[a]);
+        }
+        CHECK(engine.voxelIndex(p[0], p[1], p[2]) >= 0);
+    }
+    CHECK(hi[2] - lo[2] > 4.0 * (hi[1] - lo[1]) * 0.9);
+    CHECK(hi[1] - lo[1] > 2.0 * (hi[0] - lo[0]) * 0.9);
+    CHECK((lo[2] + hi[2]) / 2 == Approx(160.0).margin(10.0));
+
+    const std::vector<int64_t>& counts = engine.cloneCounts();
+    REQUIRE(counts.size() == 3);
+    CHECK(counts[0] + counts[1] + counts[2] == 500);
+    CHECK(static_cast<double>(counts[2]) / 500 == Approx(model.clone_fractions[2]).margin(0.1));
+
+    SECTION("an empty model seeds like initialize()") {
+        SimulationEngine plain(engineParameters());
+        plain.initialize();
+        SimulationEngine empty(engineParameters());
+        empty.initialize(PatientModel());
+        REQUIRE(plain.agents().size() == empty.agents().size());
+        for (size_t n = 0; n < plain.agents().size(); ++n) {
+            CHECK(plain.agents().x()[n] == empty.agents().x()[n]);
+            CHECK(plain.agents().genotypes()[n] == GenotypeTable::kEmptyGenotype);
+        }
+        CHECK(empty.genotypes().size() == 1);
+    }
+}
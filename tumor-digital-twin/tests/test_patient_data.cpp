@@ -0,0 +1,367 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/catch_approx.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include <zlib.h>
+
+#include "data/bgzf_inflater.h"
+#include "data/patient_upload.h"
+#include "data/read_parsers.h"
+#include "data/vcf_parser.h"
+
+using namespace tumordtwin;
+using Catch::Approx;
+
+namespace {
+
+constexpr int64_t kKrasG12 = 25245350;
+
+void appendLe(std::string* out, uint64_t value, size_t bytes) {
+    for (size_t b = 0; b < bytes; ++b) {
+        out->push_back(static_cast<char>(value >> (8 * b)));
+    }
+}
+
+std::string gzipCompress(const std::string& text) {
+    z_stream stream{};
+    deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, MAX_WBITS + 16, 8, Z_DEFAULT_STRATEGY);
+    std::string out(deflateBound(&stream, text.size()), '\0');
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(text.data()));
+    stream.avail_in = static_cast<uInt>(text.size());
+    stream.next_out = reinterpret_cast<Bytef*>(&out[0]);
+    stream.avail_out = static_cast<uInt>(out.size());
+    deflate(&stream, Z_FINISH);
+    out.resize(stream.total_out);
+    deflateEnd(&stream);
+    return out;
+}
+
+// BGZF as written by bgzip: independent blocks of at most 64 KB, then an empty EOF block
+std::string bgzfCompress(const std::string& text, size_t block_input = 60000) {
+    std::string out;
+    size_t offset = 0;
+    do {
+        const size_t size = std::min(block_input, text.size() - offset);
+        z_stream stream{};
+        deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY);
+        std::string body(deflateBound(&stream, size), '\0');
+        stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(text.data() + offset));
+        stream.avail_in = static_cast<uInt>(size);
+        stream.next_out = reinterpret_cast<Bytef*>(&body[0]);
+        stream.avail_out = static_cast<uInt>(body.size());
+        deflate(&stream, Z_FINISH);
+        body.resize(stream.total_out);
+        deflateEnd(&stream);
+
+        const char header[] = {'\x1f', '\x8b', 8, 4, 0, 0, 0, 0, 0, '\xff', 6, 0, 'B', 'C', 2, 0};
+        out.append(header, sizeof(header));
+        appendLe(&out, sizeof(header) + 2 + body.size() + 8 - 1, 2);
+        out += body;
+        appendLe(&out, crc32(0L, reinterpret_cast<const Bytef*>(text.data() + offset),
+                             static_cast<uInt>(size)), 4);
+        appendLe(&out, size, 4);
+        offset += size;
+    } while (offset < text.size());
+
+    const unsigned char eof[] = {0x1f, 0x8b, 8, 4, 0, 0, 0, 0, 0, 0xff, 6, 0, 0x42, 0x43, 2, 0,
+                                 0x1b, 0, 3, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+    out.append(reinterpret_cast<const char*>(eof), sizeof(eof));
+    return out;
+}
+
+// Feed input in fixed-size pieces and collect the output
+bool inflateInPieces(const std::string& input, size_t piece, std::string* out,
+                     BgzfInflater::Format* format, std::string& error_msg) {
+    BgzfInflater inflater(2);
+    for (size_t offset = 0; offset < input.size(); offset += piece) {
+        const size_t size = std::min(piece, input.size() - offset);
+        if (!inflater.feed(input.data() + offset, size, out, error_msg)) {
+            return false;
+        }
+    }
+    const bool ok = inflater.finish(out, error_msg);
+    *format = inflater.format();
+    return ok;
+}
+
+std::string sampleText(size_t lines) {
+    std::string text;
+    for (size_t i = 0; i < lines; ++i) {
+        text += "line " + std::to_string(i) + " of the stream to compress\n";
+    }
+    return text;
+}
+
+const char* kVcf =
+    "##fileformat=VCFv4.2\n"
+    "##INFO=<ID=AF,Number=A,Type=Float,Description=\"Allele Frequency\">\n"
+    "#CHROM\tPOS\tID\tREF\tALT\tQUAL\tFILTER\tINFO\tFORMAT\ttumor\tnormal\n"
+    "chr12\t25245350\t.\tC\tT\t60\tPASS\tAF=0.31\tGT:AF\t0/1:0.30\t0/0:0\n"
+    "chr1\t1000\t.\tG\tA,T\t50\t.\tDP=40\tGT:AF\t1/2:0.2,0.1\t0/0:0,0\n"
+    "chr2\t5000\t.\tT\tC\t10\tLowQual\tAF=0.5\tGT\t0/1\t0/0\n"
+    "7\t140753336\trs113488022\tA\tT\t70\tPASS\tAF=0.12\n";
+
+// BAM reads of 50 bases with 5 soft-clipped, each covering the KRAS G12 hotspot
+std::string bamWithKrasReads(int ref_reads, int alt_reads) {
+    std::string bam("BAM\1", 4);
+    const std::string text = "@HD\tVN:1.6\n";
+    appendLe(&bam, text.size(), 4);
+    bam += text;
+    appendLe(&bam, 2, 4);
+    for (const char* name : {"chr1", "chr12"}) {
+        appendLe(&bam, std::strlen(name) + 1, 4);
+        bam.append(name, std::strlen(name) + 1);
+        appendLe(&bam, 133275309, 4);
+    }
+
+    const int32_t length = 50;
+    const int32_t pos = static_cast<int32_t>(kKrasG12 - 1 - 20);  // Hotspot is query base 25
+    for (int r = 0; r < ref_reads + alt_reads; ++r) {
+        const std::string name = "read" + std::to_string(r);
+        std::string record;
+        appendLe(&record, 1, 4);                 // refID: chr12
+        appendLe(&record, pos, 4);
+        record.push_back(static_cast<char>(name.size() + 1));
+        record.push_back(60);                    // mapq
+        appendLe(&record, 0, 2);                 // bin
+        appendLe(&record, 2, 2);                 // n_cigar_op
+        appendLe(&record, 0, 2);                 // flag
+        appendLe(&record, length, 4);
+        appendLe(&record, 0xffffffff, 4);        // next refID
+        appendLe(&record, 0xffffffff, 4);        // next pos
+        appendLe(&record, 0, 4);                 // tlen
+        record.append(name.c_str(), name.size() + 1);
+        appendLe(&record, (5u << 4) | 4u, 4);    // 5S
+        appendLe(&record, (45u << 4) | 0u, 4);   // 45M
+        std::string bases(length, 'G');  // Matches no hotspot allele
+        bases[25] = r < alt_reads ? 'T' : 'C';
+        for (int32_t b = 0; b < length; b += 2) {
+            auto code = [](char base) {
+                return base == 'C' ? 2 : base == 'G' ? 4 : 8;
+            };
+            record.push_back(static_cast<char>((code(bases[b]) << 4) | code(bases[b + 1])));
+        }
+        record.append(length, static_cast<char>(30));
+
+        appendLe(&bam, record.size(), 4);
+        bam += record;
+    }
+    return bam;
+}
+
+std::string tempDirectory(const std::string& name) {
+    return (std::filesystem::temp_directory_path() / ("tumordtwin_test_" + name)).string();
+}
+
+} // namespace
+
+TEST_CASE("BgzfInflater decompresses streams fed in pieces", "[data][bgzf]") {
+    const std::string text = sampleText(20000);
+    std::string error_msg;
+
+    SECTION("BGZF blocks") {
+        const std::string compressed = bgzfCompress(text);
+        for (size_t piece : {size_t{7}, size_t{4093}, compressed.size()}) {
+            std::string out;
+            BgzfInflater::Format format;
+            REQUIRE(inflateInPieces(compressed, piece, &out, &format, error_msg));
+            REQUIRE(format == BgzfInflater::Format::Bgzf);
+            REQUIRE(out == text);
+        }
+    }
+
+    SECTION("Plain gzip, concatenated members") {
+        const std::string compressed = gzipCompress(text) + gzipCompress("tail\n");
+        std::string out;
+        BgzfInflater::Format format;
+        REQUIRE(inflateInPieces(compressed, 1000, &out, &format, error_msg));
+        REQUIRE(format == BgzfInflater::Format::Gzip);
+        REQUIRE(out == text + "tail\n");
+    }
+
+    SECTION("Uncompressed input passes through") {
+        std::string out;
+        BgzfInflater::Format format;
+        REQUIRE(inflateInPieces("short", 2, &out, &format, error_msg));
+        REQUIRE(format == BgzfInflater::Format::Raw);
+        REQUIRE(out == "short");
+    }
+
+    SECTION("Corrupt and truncated input is rejected") {
+        std::string compressed = bgzfCompress(text);
+        std::string out;
+        BgzfInflater::Format format;
+        REQUIRE_FALSE(inflateInPieces(compressed.substr(0, compressed.size() / 2), 5000,
+                                      &out, &format, error_msg));
+        REQUIRE(error_msg.find("Truncated") != std::string::npos);
+
+        compressed[100] = static_cast<char>(compressed[100] ^ 0x55);
+        out.clear();
+        REQUIRE_FALSE(inflateInPieces(compressed, compressed.size(), &out, &format, error_msg));
+    }
+
+    SECTION("A block claiming more than 64 KB of output is rejected") {
+        std::string compressed = bgzfCompress("short");
+        const size_t block_size = (static_cast<uint8_t>(compressed[16]) |
+                                   (static_cast<uint8_t>(compressed[17]) << 8)) + 1;
+        compressed.replace(block_size - 4, 4, "\xff\xff\xff\x7f");
+        std::string out;
+        BgzfInflater::Format format;
+        REQUIRE_FALSE(inflateInPieces(compressed, compressed.size(), &out, &format, error_msg));
+        REQUIRE(error_msg.find("inflated bytes") != std::string::npos);
+    }
+}
+
+TEST_CASE("VcfParser extracts mutations and drivers from split text", "[data][vcf]") {
+    const std::string text = kVcf;
+    VcfData vcf;
+    VcfParser parser(&vcf);
+    std::string error_msg;
+    for (size_t offset = 0; offset < text.size(); offset += 13) {
+        REQUIRE(parser.feed(std::string_view(text).substr(offset, 13), error_msg));
+    }
+    REQUIRE(parser.finish(error_msg));
+
+    REQUIRE(parser.records() == 4);
+    REQUIRE(vcf.sample_id() == "tumor");
+    REQUIRE(vcf.mutations_size() == 4);  // LowQual record filtered, two alleles at chr1:1000
+
+    const Mutation& kras = vcf.mutations(0);
+    REQUIRE(kras.chromosome() == "chr12");
+    REQUIRE(kras.position() == kKrasG12);
+    REQUIRE(kras.genotype() == "0/1");
+    REQUIRE(kras.allele_frequency() == Approx(0.31));
+
+    REQUIRE(vcf.mutations(2).alternate_allele() == "T");
+    REQUIRE(vcf.mutations(2).allele_frequency() == Approx(0.1));  // FORMAT AF, second allele
+    REQUIRE(vcf.mutations(3).genotype().empty());
+
+    REQUIRE(parser.drivers() == std::vector<std::string>{"KRAS:G12D", "BRAF:V600E"});
+
+    SECTION("Malformed records report their line") {
+        VcfData bad;
+        VcfParser bad_parser(&bad);
+        REQUIRE_FALSE(bad_parser.feed("#header\nchr1\tnotanumber\t.\tA\tC\t1\tPASS\t.\n", error_msg));
+        REQUIRE(error_msg.find("line 2") != std::string::npos);
+    }
+}
+
+TEST_CASE("BamParser calls driver hotspots from the pileup", "[data][bam]") {
+    const std::string bam = bamWithKrasReads(12, 6);
+    BamParser parser;
+    std::string error_msg;
+    for (size_t offset = 0; offset < bam.size(); offset += 97) {
+        REQUIRE(parser.feed(std::string_view(bam).substr(offset, 97), error_msg));
+    }
+    REQUIRE(parser.finish(error_msg));
+    REQUIRE(parser.reads() == 18);
+
+    VcfData vcf;
+    std::vector<std::string> drivers;
+    parser.callDrivers(&vcf, &drivers);
+    REQUIRE(drivers == std::vector<std::string>{"KRAS:G12D"});
+    REQUIRE(vcf.mutations_size() == 1);
+    REQUIRE(vcf.mutations(0).chromosome() == "12");
+    REQUIRE(vcf.mutations(0).allele_frequency() == Approx(6.0 / 18.0));
+
+    SECTION("Too little support is not called") {
+        BamParser sparse;
+        REQUIRE(sparse.feed(bamWithKrasReads(30, 2), error_msg));
+        std::vector<std::string> none;
+        sparse.callDrivers(&vcf, &none);
+        REQUIRE(none.empty());
+    }
+
+    SECTION("Truncated streams are rejected") {
+        BamParser truncated;
+        REQUIRE(truncated.feed(std::string_view(bam).substr(0, bam.size() - 3), error_msg));
+        REQUIRE_FALSE(truncated.finish(error_msg));
+    }
+
+    SECTION("Header counts do not size allocations") {
+        // Two billion references announced, one sent
+        std::string header("BAM\1", 4);
+        appendLe(&header, 0, 4);
+        appendLe(&header, 0x7fffffff, 4);
+        appendLe(&header, 5, 4);
+        header.append("chr1", 5);
+        appendLe(&header, 1000, 4);
+        BamParser huge_count;
+        REQUIRE(huge_count.feed(header, error_msg));
+        REQUIRE_FALSE(huge_count.finish(error_msg));
+
+        std::string text_header("BAM\1", 4);
+        appendLe(&text_header, 0x7fffffff, 4);
+        BamParser huge_text;
+        REQUIRE_FALSE(huge_text.feed(text_header, error_msg));
+    }
+}
+
+TEST_CASE("FastqParser validates records", "[data][fastq]") {
+    std::string error_msg;
+    FastqParser parser;
+    REQUIRE(parser.feed("@r1\nACGT\n+\nIIII\n@r2\nAC", error_msg));
+    REQUIRE(parser.feed("G\n+r2\nIII\n", error_msg));
+    REQUIRE(parser.finish(error_msg));
+    REQUIRE(parser.reads() == 2);
+    REQUIRE(parser.bases() == 7);
+
+    FastqParser bad;
+    REQUIRE_FALSE(bad.feed("@r1\nACGT\n+\nIII\n", error_msg));
+    REQUIRE(error_msg.find("wrong length") != std::string::npos);
+}
+
+TEST_CASE("PatientUpload parses payloads while they arrive", "[data][upload]") {
+    const std::string directory = tempDirectory("upload");
+    std::filesystem::remove_all(directory);
+
+    const std::string vcf = bgzfCompress(kVcf);
+    const std::string bam = bgzfCompress(bamWithKrasReads(10, 10), 1000);
+    PatientData data;
+    std::string error_msg;
+    {
+        PatientUpload upload(directory, 2);
+        PatientData header;
+        header.set_patient_id("patient-1");
+        header.mutable_genomic_sequences()->set_sample_id("tumor-dna");
+        upload.mergeHeader(header);
+
+        // Interleave the two payloads in small pieces
+        for (size_t offset = 0; offset < std::max(vcf.size(), bam.size()); offset += 512) {
+            if (offset < vcf.size()) {
+                REQUIRE(upload.append(UPLOAD_VCF, vcf.substr(offset, 512), error_msg));
+            }
+            if (offset < bam.size()) {
+                REQUIRE(upload.append(UPLOAD_BAM, bam.substr(offset, 512), error_msg));
+            }
+        }
+        REQUIRE(upload.finish(&data, error_msg));
+        REQUIRE(upload.bytesReceived() == static_cast<int64_t>(vcf.size() + bam.size()));
+        REQUIRE(upload.reads() == 20);
+        REQUIRE(upload.drivers() == std::vector<std::string>{"KRAS:G12D", "BRAF:V600E"});
+    }
+
+    REQUIRE(data.patient_id() == "patient-1");
+    REQUIRE(data.vcf().sample_id() == "tumor");
+    REQUIRE(data.vcf().mutations_size() == 5);  // 4 from the VCF, 1 called from the BAM
+    const std::string bam_path = data.metadata().at(PatientUpload::kMetadataBamPath);
+    REQUIRE(std::filesystem::file_size(bam_path) == bam.size());
+    REQUIRE(data.metadata().count(PatientUpload::kMetadataVcfPath) == 1);
+    REQUIRE(data.metadata().count(PatientUpload::kMetadataFastqPath) == 0);
+
+    SECTION("A corrupt payload fails the upload") {
+        PatientUpload upload(directory + "_bad", 1);
+        REQUIRE(upload.append(UPLOAD_FASTQ, "not a fastq record\n", error_msg));
+        PatientData ignored;
+        REQUIRE_FALSE(upload.finish(&ignored, error_msg));
+        REQUIRE(error_msg.find("FASTQ") != std::string::npos);
+        std::filesystem::remove_all(directory + "_bad");
+    }
+
+    std::filesystem::remove_all(directory);
+}
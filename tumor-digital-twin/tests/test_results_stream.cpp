@@ -0,0 +1,415 @@
+#include <catch2/catch_test_macros.hpp>
+#include <algorithm>
+#include <memory>
+#include <string>
+
+#include "simulation/grid_pyramid.h"
+#include "storage/grid_codec.h"
+#include "storage/results_stream.h"
+
+using namespace tumordtwin;
+
+namespace {
+
+std::shared_ptr<SimulationSnapshot> makeSnapshot(size_t num_agents) {
+    auto snapshot = std::make_shared<SimulationSnapshot>();
+    snapshot->step = 12;
+    snapshot->time = 1.2;
+    snapshot->metrics.set_step_number(12);
+    snapshot->oxygen.resize(9, 7, 5, 10.0);
+    snapshot->glucose.resize(9, 7, 5, 10.0, 0.25);
+    for (size_t i = 0; i < snapshot->oxygen.size(); ++i) {
+        snapshot->oxygen.data()[i] = static_cast<double>(i);
+    }
+
+    const GenotypeTable::GenotypeId genotype = snapshot->genotypes.intern("KRAS:G12D");
+    for (size_t a = 0; a < num_agents; ++a) {
+        snapshot->agents.add(CANCER_CELL, a * 0.5, 1.0, 2.0, PROLIFERATING, 0.0, 0.0,
+                             a % 3 == 0 ? genotype : GenotypeTable::kEmptyGenotype);
+    }
+    return snapshot;
+}
+
+SimulationState makeHeader() {
+    SimulationState header;
+    header.set_simulation_id("sim-1");
+    header.set_patient_id("patient-1");
+    header.set_current_step(12);
+    header.set_status(SimulationStatus::COMPLETED);
+    return header;
+}
+
+// Drain a stream, checking chunk framing, and parse the reassembled payload
+SimulationState drain(ResultsStream& stream, size_t chunk_bytes) {
+    std::string payload;
+    ResultsChunk chunk;
+    int32_t expected_number = 0;
+    while (stream.next(&chunk)) {
+        REQUIRE(chunk.simulation_id() == "sim-1");
+        REQUIRE(chunk.chunk_number() == expected_number++);
+        REQUIRE(chunk.total_chunks() == stream.totalChunks());
+        REQUIRE(chunk.data().size() <= chunk_bytes);
+        REQUIRE(chunk.is_final() == (expected_number == stream.totalChunks()));
+        if (!chunk.is_final()) {
+            REQUIRE(chunk.data().size() == chunk_bytes);
+        }
+        payload += chunk.data();
+    }
+    REQUIRE(expected_number == stream.totalChunks());
+    REQUIRE(payload.size() == stream.totalBytes());
+
+    SimulationState state;
+    REQUIRE(state.ParseFromString(payload));
+    return state;
+}
+
+} // namespace
+
+TEST_CASE("ResultsStream reassembles into the full state", "[results][stream]") {
+    // More agents than one encoding batch, odd chunk size to split every field
+    auto snapshot = makeSnapshot(5000);
+    ResultsRequest request;
+    request.set_include_agents(true);
+    request.set_include_grid_data(true);
+
+    const size_t chunk_bytes = 1021;
+    ResultsStream stream(makeHeader(), snapshot, chunk_bytes);
+    std::string error_msg;
+    REQUIRE(stream.init(request, error_msg));
+    REQUIRE(stream.totalChunks() > 1);
+    SimulationState state = drain(stream, chunk_bytes);
+
+    REQUIRE(state.simulation_id() == "sim-1");
+    REQUIRE(state.patient_id() == "patient-1");
+    REQUIRE(state.status() == SimulationStatus::COMPLETED);
+
+    REQUIRE(state.grids_size() == 2);
+    ScalarGrid oxygen;
+    REQUIRE(state.grids(0).substance() == SubstanceType::OXYGEN);
+    REQUIRE(oxygen.fromProto(state.grids(0)));
+    REQUIRE(oxygen.nx() == 9);
+    REQUIRE(oxygen.nz() == 5);
+    for (size_t i = 0; i < oxygen.size(); ++i) {
+        REQUIRE(oxygen.data()[i] == snapshot->oxygen.data()[i]);
+    }
+
+    // Same encoding as the in-memory export
+    SimulationState expected_agents;
+    snapshot->agents.toProto(expected_agents.mutable_agents(), snapshot->genotypes);
+    REQUIRE(state.agents_size() == 5000);
+    for (int a = 0; a < state.agents_size(); ++a) {
+        REQUIRE(state.agents(a).SerializeAsString() ==
+                expected_agents.agents(a).SerializeAsString());
+    }
+}
+
+TEST_CASE("ResultsStream applies request filters", "[results][stream][filter]") {
+    auto snapshot = makeSnapshot(10);
+
+    SECTION("Scalars only") {
+        ResultsRequest request;
+        ResultsStream stream(makeHeader(), snapshot);
+        std::string error_msg;
+        REQUIRE(stream.init(request, error_msg));
+        REQUIRE(stream.totalChunks() == 1);
+        SimulationState state = drain(stream, ResultsStream::kDefaultChunkBytes);
+        REQUIRE(state.grids_size() == 0);
+        REQUIRE(state.agents_size() == 0);
+        REQUIRE(state.current_step() == 12);
+    }
+
+    SECTION("Selected substances, untracked ones skipped") {
+        ResultsRequest request;
+        request.set_include_grid_data(true);
+        request.add_substances(SubstanceType::GLUCOSE);
+        request.add_substances(SubstanceType::DRUG);
+        request.add_substances(SubstanceType::GLUCOSE);
+        ResultsStream stream(makeHeader(), snapshot, 64);
+        std::string error_msg;
+        REQUIRE(stream.init(request, error_msg));
+        SimulationState state = drain(stream, 64);
+        REQUIRE(state.grids_size() == 1);
+        REQUIRE(state.grids(0).substance() == SubstanceType::GLUCOSE);
+        REQUIRE(state.agents_size() == 0);
+    }
+
+    SECTION("Substances are ignored without include_grid_data") {
+        ResultsRequest request;
+        request.set_include_agents(true);
+        request.add_substances(SubstanceType::OXYGEN);
+        ResultsStream stream(makeHeader(), snapshot);
+        std::string error_msg;
+        REQUIRE(stream.init(request, error_msg));
+        SimulationState state = drain(stream, ResultsStream::kDefaultChunkBytes);
+        REQUIRE(state.grids_size() == 0);
+        REQUIRE(state.agents_size() == 10);
+    }
+}
+
+TEST_CASE("ResultsStream applies the negotiated grid encoding", "[results][stream][encoding]") {
+    auto snapshot = makeSnapshot(0);
+    ResultsRequest request;
+    request.set_include_grid_data(true);
+    request.add_substances(SubstanceType::OXYGEN);
+    request.mutable_grid_encoding()->set_precision(GridPrecision::FLOAT32);
+    request.mutable_grid_encoding()->set_delta(true);
+    request.mutable_grid_encoding()->set_compression(GridCompression::COMPRESSION_ZSTD);
+
+    ResultsStream stream(makeHeader(), snapshot, 100);
+    std::string error_msg;
+    REQUIRE(stream.init(request, error_msg));
+    SimulationState state = drain(stream, 100);
+
+    REQUIRE(state.grids_size() == 1);
+    const GridData& grid = state.grids(0);
+    REQUIRE(grid.compressed());
+    REQUIRE(grid.encoding().precision() == GridPrecision::FLOAT32);
+    REQUIRE(GridCodec::isAvailable(grid.encoding().compression()));
+
+    ScalarGrid decoded;
+    REQUIRE(GridCodec::fromProto(grid, decoded, error_msg));
+    for (size_t i = 0; i < decoded.size(); ++i) {
+        REQUIRE(decoded.data()[i] == static_cast<float>(snapshot->oxygen.data()[i]));
+    }
+
+    SECTION("Invalid encodings are rejected") {
+        request.mutable_grid_encoding()->set_precision(GridPrecision::QUANTIZED_INT32);
+        ResultsStream rejected(makeHeader(), snapshot);
+        REQUIRE(!rejected.init(request, error_msg));
+        REQUIRE(!error_msg.empty());
+    }
+}
+
+TEST_CASE("ResultsStream expands sparse grids into the flat layout", "[results][stream][sparse]") {
+    // More values than one expansion batch
+    auto snapshot = std::make_shared<SimulationSnapshot>();
+    snapshot->sparse_oxygen.resize(64, 64, 40, 10.0, 1.0);
+    for (int k = 30; k < 34; ++k) {
+        for (int i = 0; i < 64; ++i) {
+            snapshot->sparse_oxygen.at(i, 63 - k, k) = 0.01 * i;
+        }
+    }
+    REQUIRE(snapshot->sparse_oxygen.size() > (1u << 17));
+    ScalarGrid expected;
+    snapshot->sparse_oxygen.toDense(expected);
+
+    ResultsRequest request;
+    request.set_include_grid_data(true);
+    request.add_substances(SubstanceType::OXYGEN);
+
+    SECTION("Raw values are expanded batch by batch") {
+        const size_t chunk_bytes = 65521;
+        ResultsStream stream(makeHeader(), snapshot, chunk_bytes);
+        std::string error_msg;
+        REQUIRE(stream.init(request, error_msg));
+        SimulationState state = drain(stream, chunk_bytes);
+        REQUIRE(state.grids_size() == 1);
+        ScalarGrid oxygen;
+        REQUIRE(oxygen.fromProto(state.grids(0)));
+        REQUIRE(std::equal(oxygen.data(), oxygen.data() + oxygen.size(), expected.data()));
+    }
+
+    SECTION("Encoded values go through the dense codec") {
+        request.mutable_grid_encoding()->set_precision(GridPrecision::FLOAT32);
+        ResultsStream stream(makeHeader(), snapshot);
+        std::string error_msg;
+        REQUIRE(stream.init(request, error_msg));
+        SimulationState state = drain(stream, ResultsStream::kDefaultChunkBytes);
+        REQUIRE(state.grids_size() == 1);
+        ScalarGrid oxygen;
+        REQUIRE(GridCodec::fromProto(state.grids(0), oxygen, error_msg));
+        for (size_t n = 0; n < oxygen.size(); ++n) {
+            REQUIRE(oxygen.data()[n] == static_cast<float>(expected.data()[n]));
+        }
+    }
+}
+
+TEST_CASE("GridPyramid averages blocks of full-resolution voxels", "[results][pyramid]") {
+    ScalarGrid field(5, 4, 3, 10.0);
+    for (size_t i = 0; i < field.size(); ++i) {
+        field.data()[i] = static_cast<double>(i);
+    }
+
+    ScalarGrid coarse;
+    GridPyramid::downsample(field, 1, coarse);
+    REQUIRE(coarse.nx() == 3);
+    REQUIRE(coarse.ny() == 2);
+    REQUIRE(coarse.nz() == 2);
+    REQUIRE(coarse.spacing() == 20.0);
+    // A full 2x2x2 block, and the edge block holding only voxel (4, 3, 2)
+    double block = 0.0;
+    for (int k = 0; k < 2; ++k) {
+        for (int j = 0; j < 2; ++j) {
+            for (int i = 0; i < 2; ++i) {
+                block += field.at(i, j, k);
+            }
+        }
+    }
+    REQUIRE(coarse.at(0, 0, 0) == block / 8.0);
+    REQUIRE(coarse.at(2, 1, 1) == (field.at(4, 2, 2) + field.at(4, 3, 2)) / 2.0);
+
+    SECTION("Sparse fields give the same levels") {
+        BrickGrid sparse;
+        sparse.fromDense(field);
+        ScalarGrid from_sparse;
+        GridPyramid::downsample(sparse, 1, from_sparse);
+        REQUIRE(std::equal(coarse.data(), coarse.data() + coarse.size(), from_sparse.data()));
+    }
+
+    SECTION("Levels are built once per snapshot") {
+        SimulationSnapshot snapshot;
+        snapshot.oxygen = field;
+        const ScalarGrid* level = snapshot.levelGrid(SubstanceType::OXYGEN, 2);
+        REQUIRE(level != nullptr);
+        REQUIRE(level->nx() == 2);
+        REQUIRE(level->nz() == 1);
+        REQUIRE(snapshot.levelGrid(SubstanceType::OXYGEN, 2) == level);
+        REQUIRE(snapshot.levelGrid(SubstanceType::OXYGEN, 0) == &snapshot.oxygen);
+        REQUIRE(snapshot.levelGrid(SubstanceType::DRUG, 2) == nullptr);
+    }
+}
+
+TEST_CASE("ResultsStream selects regions, slices and levels", "[results][stream][selection]") {
+    auto snapshot = makeSnapshot(0);
+    const ScalarGrid& oxygen = snapshot->oxygen;  // 9 x 7 x 5, value = flat index
+    ResultsRequest request;
+    request.set_include_grid_data(true);
+    request.add_substances(SubstanceType::OXYGEN);
+
+    auto select = [&](const ResultsRequest& selection) {
+        ResultsStream stream(makeHeader(), snapshot, 97);
+        std::string error_msg;
+        REQUIRE(stream.init(selection, error_msg));
+        SimulationState state = drain(stream, 97);
+        REQUIRE(state.grids_size() == 1);
+        return state.grids(0);
+    };
+
+    SECTION("Region, open-ended along z") {
+        GridRegion* region = request.mutable_region();
+        region->set_x_min(2);
+        region->set_x_max(5);
+        region->set_y_min(1);
+        region->set_y_max(3);
+        const GridData data = select(request);
+        REQUIRE(data.region().x_min() == 2);
+        REQUIRE(data.region().z_max() == 5);
+        ScalarGrid grid;
+        REQUIRE(grid.fromProto(data));
+        REQUIRE(grid.nx() == 3);
+        REQUIRE(grid.ny() == 2);
+        REQUIRE(grid.nz() == 5);
+        REQUIRE(grid.at(0, 0, 0) == oxygen.at(2, 1, 0));
+        REQUIRE(grid.at(2, 1, 4) == oxygen.at(4, 2, 4));
+    }
+
+    SECTION("Axial slice with a stride") {
+        request.mutable_slice()->set_axis(SliceAxis::SLICE_Z);
+        request.mutable_slice()->set_index(3);
+        request.set_stride(2);
+        const GridData data = select(request);
+        REQUIRE(data.stride() == 2);
+        ScalarGrid grid;
+        REQUIRE(grid.fromProto(data));
+        REQUIRE(grid.nx() == 5);
+        REQUIRE(grid.ny() == 4);
+        REQUIRE(grid.nz() == 1);
+        REQUIRE(grid.spacing() == 20.0);
+        REQUIRE(grid.at(4, 3, 0) == oxygen.at(8, 6, 3));
+    }
+
+    SECTION("Whole coarse level") {
+        request.set_level(1);
+        const GridData data = select(request);
+        REQUIRE(data.level() == 1);
+        REQUIRE(!data.has_region());
+        ScalarGrid grid;
+        REQUIRE(grid.fromProto(data));
+        const ScalarGrid& level = *snapshot->levelGrid(SubstanceType::OXYGEN, 1);
+        REQUIRE(grid.nx() == 5);
+        REQUIRE(std::equal(grid.data(), grid.data() + grid.size(), level.data()));
+    }
+
+    SECTION("Slice of a coarse level covers whole coarse voxels") {
+        request.set_level(1);
+        request.mutable_slice()->set_axis(SliceAxis::SLICE_Z);
+        request.mutable_slice()->set_index(3);
+        const GridData data = select(request);
+        REQUIRE(data.region().z_min() == 2);
+        REQUIRE(data.region().z_max() == 4);
+        ScalarGrid grid;
+        REQUIRE(grid.fromProto(data));
+        REQUIRE(grid.nz() == 1);
+        REQUIRE(grid.at(1, 1, 0) == snapshot->levelGrid(SubstanceType::OXYGEN, 1)->at(1, 1, 1));
+    }
+
+    SECTION("Invalid selections are rejected") {
+        std::string error_msg;
+        ResultsRequest bad = request;
+        bad.set_level(GridPyramid::kMaxLevel + 1);
+        REQUIRE(!ResultsStream(makeHeader(), snapshot).init(bad, error_msg));
+
+        bad = request;
+        bad.set_stride(-1);
+        REQUIRE(!ResultsStream(makeHeader(), snapshot).init(bad, error_msg));
+
+        bad = request;
+        bad.mutable_region()->set_x_min(4);
+        bad.mutable_region()->set_x_max(10);
+        REQUIRE(!ResultsStream(makeHeader(), snapshot).init(bad, error_msg));
+
+        bad = request;
+        bad.mutable_slice()->set_index(1);
+        REQUIRE(!ResultsStream(makeHeader(), snapshot).init(bad, error_msg));
+
+        bad = request;
+        bad.mutable_region()->set_z_min(2);
+        bad.mutable_slice()->set_axis(SliceAxis::SLICE_Z);
+        bad.mutable_slice()->set_index(1);
+        REQUIRE(!ResultsStream(makeHeader(), snapshot).init(bad, error_msg));
+        REQUIRE(!error_msg.empty());
+    }
+}
+
+TEST_CASE("ResultsStream filters agents", "[results][stream][agents]") {
+    auto snapshot = makeSnapshot(0);
+    // One agent per 10 um voxel along x, alternating type and state
+    for (int i = 0; i < 9; ++i) {
+        snapshot->agents.add(i % 2 == 0 ? CANCER_CELL : T_CELL, i * 10.0 + 5.0, 15.0, 25.0,
+                             i % 3 == 0 ? QUIESCENT : PROLIFERATING);
+    }
+    ResultsRequest request;
+    request.set_include_agents(true);
+
+    auto selected = [&](const ResultsRequest& selection) {
+        ResultsStream stream(makeHeader(), snapshot, 64);
+        std::string error_msg;
+        REQUIRE(stream.init(selection, error_msg));
+        return drain(stream, 64).agents();
+    };
+
+    SECTION("By type and state") {
+        request.add_agent_types(T_CELL);
+        request.add_cell_states(PROLIFERATING);
+        const auto agents = selected(request);
+        REQUIRE(agents.size() == 3);  // x voxels 1, 5, 7
+        for (const Agent& agent : agents) {
+            REQUIRE(agent.type() == T_CELL);
+            REQUIRE(agent.state() == PROLIFERATING);
+        }
+    }
+
+    SECTION("By region") {
+        request.mutable_region()->set_x_min(2);
+        request.mutable_region()->set_x_max(4);
+        const auto agents = selected(request);
+        REQUIRE(agents.size() == 2);
+        // The store keeps T cells ahead of cancer cells
+        REQUIRE(agents[0].position().x() == 35.0);
+        REQUIRE(agents[1].position().x() == 25.0);
+
+        request.mutable_slice()->set_axis(SliceAxis::SLICE_Y);
+        request.mutable_slice()->set_index(0);
+        REQUIRE(selected(request).empty());
+    }
+}
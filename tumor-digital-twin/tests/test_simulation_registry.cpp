@@ -0,0 +1,330 @@
+#include <catch2/catch_test_macros.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "simulation/simulation_registry.h"
+#include "simulation/simulation_snapshot.h"
+
+using namespace tumordtwin;
+
+namespace {
+
+std::shared_ptr<SimulationRecord> makeRecord(const std::string& id,
+                                             const std::string& patient,
+                                             int32_t steps = 100) {
+    return std::make_shared<SimulationRecord>(id, patient, "sim " + id, steps, 1700000000);
+}
+
+} // namespace
+
+TEST_CASE("SimulationRegistry stores and finds records", "[registry]") {
+    SimulationRegistry registry;
+    REQUIRE(registry.insert(makeRecord("sim-1", "patient-a")));
+    REQUIRE_FALSE(registry.insert(makeRecord("sim-1", "patient-a")));
+
+    auto record = registry.find("sim-1");
+    REQUIRE(record != nullptr);
+    REQUIRE(record->patientId() == "patient-a");
+    REQUIRE(record->status() == SimulationStatus::QUEUED);
+    REQUIRE(registry.find("missing") == nullptr);
+
+    registry.erase("sim-1");
+    REQUIRE(registry.find("sim-1") == nullptr);
+    REQUIRE(registry.size() == 0);
+}
+
+TEST_CASE("SimulationRecord publishes progress", "[registry][progress]") {
+    SimulationRegistry registry;
+    auto record = makeRecord("sim-1", "patient-a", 200);
+    registry.insert(record);
+
+    REQUIRE(registry.updateStatus(*record, SimulationStatus::RUNNING, "running"));
+    record->setProgress(50);
+
+    StatusResponse response;
+    record->toStatusResponse(&response);
+    REQUIRE(response.status() == SimulationStatus::RUNNING);
+    REQUIRE(response.current_step() == 50);
+    REQUIRE(response.total_steps() == 200);
+    REQUIRE(response.progress_percentage() == 25.0);
+    REQUIRE(response.message() == "running");
+}
+
+TEST_CASE("SimulationRecord notifies watchers of changes", "[registry][watch]") {
+    SimulationRegistry registry;
+    auto record = makeRecord("sim-1", "patient-a", 200);
+    registry.insert(record);
+    record->addWatcher();
+
+    const uint64_t seen = record->version();
+    REQUIRE_FALSE(record->waitForChange(seen, std::chrono::milliseconds(10)));
+
+    std::thread worker([&] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        SimulationMetrics metrics;
+        metrics.set_step_number(7);
+        metrics.set_total_cells(1234);
+        record->setMetrics(metrics);
+        record->setProgress(7);
+    });
+    REQUIRE(record->waitForChange(seen, std::chrono::seconds(10)));
+    worker.join();
+
+    StatusResponse response;
+    record->toStatusResponse(&response);
+    REQUIRE(response.current_step() == 7);
+    REQUIRE(response.current_metrics().total_cells() == 1234);
+
+    // Status transitions count as changes too
+    const uint64_t before = record->version();
+    REQUIRE(registry.updateStatus(*record, SimulationStatus::RUNNING, "running"));
+    REQUIRE(record->version() != before);
+    record->removeWatcher();
+    REQUIRE_FALSE(record->hasWatchers());
+}
+
+TEST_CASE("SimulationRegistry ignores transitions out of terminal states", "[registry][status]") {
+    SimulationRegistry registry;
+    auto record = makeRecord("sim-1", "patient-a");
+    registry.insert(record);
+
+    REQUIRE(registry.updateStatus(*record, SimulationStatus::STOPPED, "stopped"));
+    REQUIRE_FALSE(registry.updateStatus(*record, SimulationStatus::RUNNING, "running"));
+    REQUIRE(record->status() == SimulationStatus::STOPPED);
+    REQUIRE(record->estimatedTimeRemaining() == 0);
+}
+
+TEST_CASE("SimulationRegistry lists by secondary index", "[registry][list]") {
+    SimulationRegistry registry;
+    std::vector<std::shared_ptr<SimulationRecord>> records;
+    for (int i = 0; i < 10; ++i) {
+        auto record = makeRecord("sim-" + std::to_string(i), i % 2 == 0 ? "even" : "odd");
+        registry.insert(record);
+        records.push_back(record);
+    }
+    registry.updateStatus(*records[0], SimulationStatus::RUNNING, "running");
+    registry.updateStatus(*records[1], SimulationStatus::RUNNING, "running");
+    registry.updateStatus(*records[2], SimulationStatus::RUNNING, "running");
+
+    size_t total = 0;
+
+    SECTION("No filter returns everything in creation order") {
+        auto result = registry.list("", SimulationStatus::SIMULATION_STATUS_UNSPECIFIED, 0, 100, total);
+        REQUIRE(total == 10);
+        REQUIRE(result.size() == 10);
+        REQUIRE(result.front()->simulationId() == "sim-0");
+        REQUIRE(result.back()->simulationId() == "sim-9");
+    }
+
+    SECTION("Patient filter with pagination") {
+        auto result = registry.list("even", SimulationStatus::SIMULATION_STATUS_UNSPECIFIED, 1, 2, total);
+        REQUIRE(total == 5);
+        REQUIRE(result.size() == 2);
+        REQUIRE(result[0]->simulationId() == "sim-2");
+        REQUIRE(result[1]->simulationId() == "sim-4");
+    }
+
+    SECTION("Status filter follows transitions") {
+        auto result = registry.list("", SimulationStatus::RUNNING, 0, 100, total);
+        REQUIRE(total == 3);
+        result = registry.list("", SimulationStatus::QUEUED, 0, 100, total);
+        REQUIRE(total == 7);
+    }
+
+    SECTION("Combined filter") {
+        auto result = registry.list("even", SimulationStatus::RUNNING, 0, 100, total);
+        REQUIRE(total == 2);
+        REQUIRE(result.size() == 2);
+        REQUIRE(result[0]->simulationId() == "sim-0");
+        REQUIRE(result[1]->simulationId() == "sim-2");
+    }
+
+    SECTION("Offset past the end") {
+        auto result = registry.list("odd", SimulationStatus::SIMULATION_STATUS_UNSPECIFIED, 10, 5, total);
+        REQUIRE(total == 5);
+        REQUIRE(result.empty());
+    }
+
+    SECTION("Unknown patient") {
+        auto result = registry.list("nobody", SimulationStatus::SIMULATION_STATUS_UNSPECIFIED, 0, 5, total);
+        REQUIRE(total == 0);
+        REQUIRE(result.empty());
+    }
+}
+
+TEST_CASE("SimulationRegistry pages deep into large indexes", "[registry][list]") {
+    SimulationRegistry registry;
+    std::vector<std::shared_ptr<SimulationRecord>> records;
+    for (int i = 0; i < 5000; ++i) {
+        auto record = makeRecord("sim-" + std::to_string(i), "patient");
+        registry.insert(record);
+        records.push_back(record);
+    }
+    // Every third record erased, every fifth of the rest completed out of order
+    std::vector<std::string> remaining;
+    std::vector<std::string> completed;
+    for (int i = 4999; i >= 0; --i) {
+        if (i % 3 == 0) {
+            registry.erase(records[i]->simulationId());
+        } else if (i % 5 == 0) {
+            registry.updateStatus(*records[i], SimulationStatus::COMPLETED, "done");
+        }
+    }
+    for (int i = 0; i < 5000; ++i) {
+        if (i % 3 != 0) {
+            remaining.push_back(records[i]->simulationId());
+            if (i % 5 == 0) {
+                completed.push_back(records[i]->simulationId());
+            }
+        }
+    }
+
+    size_t total = 0;
+    for (size_t offset : {size_t(0), size_t(1), size_t(1234), remaining.size() - 3}) {
+        auto result = registry.list("patient", SimulationStatus::SIMULATION_STATUS_UNSPECIFIED,
+                                    offset, 7, total);
+        REQUIRE(total == remaining.size());
+        REQUIRE(result.size() == std::min<size_t>(7, remaining.size() - offset));
+        for (size_t i = 0; i < result.size(); ++i) {
+            REQUIRE(result[i]->simulationId() == remaining[offset + i]);
+        }
+    }
+
+    auto result = registry.list("", SimulationStatus::COMPLETED, 300, 5, total);
+    REQUIRE(total == completed.size());
+    REQUIRE(result.size() == 5);
+    for (size_t i = 0; i < result.size(); ++i) {
+        REQUIRE(result[i]->simulationId() == completed[300 + i]);
+    }
+}
+
+TEST_CASE("SimulationRegistry handles concurrent access", "[registry][concurrency]") {
+    SimulationRegistry registry;
+    constexpr int kThreads = 4;
+    constexpr int kPerThread = 200;
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; ++t) {
+        threads.emplace_back([&registry, t] {
+            for (int i = 0; i < kPerThread; ++i) {
+                auto record = makeRecord("sim-" + std::to_string(t) + "-" + std::to_string(i),
+                                         "patient-" + std::to_string(t));
+                registry.insert(record);
+                registry.updateStatus(*record, SimulationStatus::RUNNING, "running");
+                record->setProgress(i);
+                registry.find(record->simulationId());
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    size_t total = 0;
+    registry.list("", SimulationStatus::RUNNING, 0, 1, total);
+    REQUIRE(total == kThreads * kPerThread);
+    registry.list("patient-2", SimulationStatus::SIMULATION_STATUS_UNSPECIFIED, 0, 1, total);
+    REQUIRE(total == kPerThread);
+}
+
+TEST_CASE("SimulationRegistry erases records racing their insert", "[registry][concurrency]") {
+    SimulationRegistry registry;
+    constexpr int kRecords = 500;
+
+    std::atomic<bool> done{false};
+    std::thread eraser([&registry, &done] {
+        while (!done.load()) {
+            for (int i = 0; i < kRecords; ++i) {
+                registry.erase("sim-" + std::to_string(i));
+            }
+        }
+    });
+    for (int i = 0; i < kRecords; ++i) {
+        auto record = makeRecord("sim-" + std::to_string(i), "patient-a");
+        registry.insert(record);
+        registry.updateStatus(*record, SimulationStatus::RUNNING, "running");
+    }
+    done = true;
+    eraser.join();
+
+    // Every record still indexed is still findable, and the reverse
+    size_t total = 0;
+    auto listed = registry.list("", SimulationStatus::SIMULATION_STATUS_UNSPECIFIED, 0, kRecords, total);
+    REQUIRE(total == registry.size());
+    size_t found = 0;
+    for (int i = 0; i < kRecords; ++i) {
+        found += registry.find("sim-" + std::to_string(i)) != nullptr ? 1 : 0;
+    }
+    REQUIRE(found == total);
+    for (const auto& record : listed) {
+        REQUIRE(registry.find(record->simulationId()) == record);
+    }
+    registry.list("patient-a", SimulationStatus::SIMULATION_STATUS_UNSPECIFIED, 0, 1, total);
+    REQUIRE(total == found);
+}
+
+TEST_CASE("SimulationRegistry drops the earliest finished records", "[registry][retention]") {
+    SimulationRegistry registry;
+    registry.setRetention(2, std::chrono::seconds(0));
+    std::vector<std::shared_ptr<SimulationRecord>> records;
+    for (int i = 0; i < 5; ++i) {
+        records.push_back(makeRecord("sim-" + std::to_string(i), "patient-a"));
+        registry.insert(records.back());
+    }
+
+    // Finished out of creation order; unfinished records are never dropped
+    registry.updateStatus(*records[3], SimulationStatus::COMPLETED, "done");
+    registry.updateStatus(*records[0], SimulationStatus::FAILED, "failed");
+    registry.updateStatus(*records[1], SimulationStatus::RUNNING, "running");
+    REQUIRE(registry.size() == 5);
+    registry.updateStatus(*records[4], SimulationStatus::STOPPED, "stopped");
+    REQUIRE(registry.size() == 4);
+    REQUIRE(registry.find("sim-3") == nullptr);
+    REQUIRE(registry.find("sim-0") != nullptr);
+
+    size_t total = 0;
+    registry.list("patient-a", SimulationStatus::SIMULATION_STATUS_UNSPECIFIED,
+                  0, 10, total);
+    REQUIRE(total == 4);
+    registry.list("", SimulationStatus::COMPLETED, 0, 10, total);
+    REQUIRE(total == 0);
+
+    SECTION("Tighter bounds apply at once") {
+        registry.setRetention(0, std::chrono::seconds(0));
+        REQUIRE(registry.size() == 2);
+        REQUIRE(registry.find("sim-1") != nullptr);
+        REQUIRE(registry.find("sim-2") != nullptr);
+    }
+
+    SECTION("Finished records expire") {
+        registry.setRetention(10, std::chrono::seconds(1));
+        std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+        registry.insert(makeRecord("sim-5", "patient-a"));
+        REQUIRE(registry.size() == 3);
+        REQUIRE(registry.find("sim-0") == nullptr);
+        REQUIRE(registry.find("sim-4") == nullptr);
+    }
+}
+
+TEST_CASE("SimulationRecord keeps result metrics after releasing its snapshot",
+          "[registry][results]") {
+    auto record = makeRecord("sim-1", "patient-a");
+    SimulationMetrics metrics;
+    REQUIRE(record->resultsStep() == -1);
+    REQUIRE_FALSE(record->resultMetrics(&metrics));
+
+    auto snapshot = std::make_shared<SimulationSnapshot>();
+    snapshot->step = 42;
+    snapshot->metrics.set_total_cells(1234);
+    record->setSnapshot(snapshot);
+    record->releaseSnapshot();
+    REQUIRE(record->snapshot() == nullptr);
+    REQUIRE(record->resultsStep() == 42);
+    REQUIRE(record->resultMetrics(&metrics));
+    REQUIRE(metrics.total_cells() == 1234);
+}
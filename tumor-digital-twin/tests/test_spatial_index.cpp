@@ -0,0 +1,163 @@
+#include <catch2/catch_test_macros.hpp>
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "simulation/spatial_index.h"
+#include "simulation/simulation_engine.h"
+
+using namespace tumordtwin;
+
+namespace {
+
+constexpr int kGrid = 20;
+constexpr double kSpacing = 10.0;
+
+void fillRandom(AgentStore& agents, size_t count, std::mt19937& rng) {
+    std::uniform_real_distribution<double> pos(0.0, kGrid * kSpacing);
+    for (size_t n = 0; n < count; ++n) {
+        agents.add(CANCER_CELL, pos(rng), pos(rng), pos(rng));
+    }
+}
+
+std::vector<uint64_t> bruteForce(const AgentStore& agents, double x, double y, double z, double r) {
+    std::vector<uint64_t> ids;
+    for (size_t a = 0; a < agents.size(); ++a) {
+        double dx = agents.x()[a] - x, dy = agents.y()[a] - y, dz = agents.z()[a] - z;
+        if (dx * dx + dy * dy + dz * dz <= r * r) {
+            ids.push_back(agents.ids()[a]);
+        }
+    }
+    std::sort(ids.begin(), ids.end());
+    return ids;
+}
+
+std::vector<uint64_t> indexed(const SpatialIndex& index, const AgentStore& agents,
+                              double x, double y, double z, double r) {
+    std::vector<uint64_t> ids;
+    index.forEachNeighbor(agents, x, y, z, r, [&](size_t a) { ids.push_back(agents.ids()[a]); });
+    std::sort(ids.begin(), ids.end());
+    return ids;
+}
+
+void requireMatchesBruteForce(const SpatialIndex& index, const AgentStore& agents,
+                              std::mt19937& rng) {
+    std::uniform_real_distribution<double> pos(0.0, kGrid * kSpacing);
+    for (int q = 0; q < 50; ++q) {
+        double x = pos(rng), y = pos(rng), z = pos(rng);
+        double r = (q % 3 + 1) * 7.5;
+        REQUIRE(indexed(index, agents, x, y, z, r) == bruteForce(agents, x, y, z, r));
+    }
+}
+
+} // namespace
+
+TEST_CASE("SpatialIndex neighbor queries match brute force", "[spatial]") {
+    std::mt19937 rng(11);
+    AgentStore agents;
+    fillRandom(agents, 3000, rng);
+
+    SpatialIndex index;
+    index.reset(kGrid, kGrid, kGrid, kSpacing);
+    index.rebuild(agents);
+    REQUIRE(index.size() == agents.size());
+    REQUIRE(index.tableSize() >= 2 * agents.size());
+
+    requireMatchesBruteForce(index, agents, rng);
+
+    SECTION("Incremental update after moves and appends") {
+        std::normal_distribution<double> jitter(0.0, 8.0);
+        for (size_t a = 0; a < agents.size(); a += 3) {
+            agents.x()[a] = std::clamp(agents.x()[a] + jitter(rng), 0.0, kGrid * kSpacing - 1e-6);
+            agents.y()[a] = std::clamp(agents.y()[a] + jitter(rng), 0.0, kGrid * kSpacing - 1e-6);
+        }
+        fillRandom(agents, 500, rng);
+        index.update(agents);
+
+        REQUIRE(index.size() == agents.size());
+        requireMatchesBruteForce(index, agents, rng);
+    }
+
+    SECTION("Mirrored swap removals") {
+        for (size_t a = agents.size(); a-- > 0;) {
+            if (a % 4 == 1) {
+                agents.remove(a);
+                index.remove(a);
+            }
+        }
+        REQUIRE(index.size() == agents.size());
+        requireMatchesBruteForce(index, agents, rng);
+    }
+
+    SECTION("Growth beyond the table triggers a rebuild") {
+        size_t before = index.tableSize();
+        fillRandom(agents, 4 * before, rng);
+        index.insertAppended(agents);
+        REQUIRE(index.tableSize() > before);
+        requireMatchesBruteForce(index, agents, rng);
+    }
+}
+
+TEST_CASE("SpatialIndex counts agents per voxel", "[spatial][count]") {
+    AgentStore agents;
+    agents.add(CANCER_CELL, 15.0, 15.0, 15.0);
+    agents.add(CANCER_CELL, 19.0, 11.0, 12.0);
+    agents.add(CANCER_CELL, 25.0, 15.0, 15.0);
+
+    SpatialIndex index;
+    index.reset(kGrid, kGrid, kGrid, kSpacing);
+    index.rebuild(agents);
+
+    REQUIRE(index.countInVoxel(index.voxelKey(15.0, 15.0, 15.0)) == 2);
+    REQUIRE(index.countInVoxel(index.voxelKey(25.0, 15.0, 15.0)) == 1);
+    REQUIRE(index.countInVoxel(index.voxelKey(150.0, 150.0, 150.0)) == 0);
+
+    // Out of range positions clamp to boundary voxels
+    REQUIRE(index.voxelKey(-5.0, -5.0, -5.0) == 0);
+}
+
+TEST_CASE("SimulationEngine population dynamics use the index", "[engine][spatial]") {
+    SimulationParameters params;
+    params.set_grid_size_x(30);
+    params.set_grid_size_y(30);
+    params.set_grid_size_z(30);
+    params.set_spatial_resolution(10.0);
+    params.set_time_step(0.5);
+    params.set_division_rate(1.0);
+    params.set_death_rate(0.0);
+    params.set_migration_rate(0.1);
+    params.set_oxygen_diffusion_coeff(100.0);
+    params.set_glucose_diffusion_coeff(100.0);
+    auto& extra = *params.mutable_extra_params();
+    extra[SimulationEngine::kParamInitialTumorCells] = 100;
+    extra[SimulationEngine::kParamInitialTCells] = 50;
+
+    SimulationEngine engine(params, 1);
+    engine.initialize();
+    REQUIRE(engine.agents().size() == 150);
+
+    auto maxOccupancy = [&engine] {
+        const auto& agents = engine.agents();
+        size_t peak = 0;
+        for (size_t a = 0; a < agents.size(); ++a) {
+            auto key = engine.spatialIndex().voxelKey(agents.x()[a], agents.y()[a], agents.z()[a]);
+            peak = std::max(peak, engine.spatialIndex().countInVoxel(key));
+        }
+        return peak;
+    };
+    // Random seeding may overfill a voxel; dynamics must never add to that
+    const size_t limit = std::max<size_t>(maxOccupancy(), 2);
+
+    for (int step = 0; step < 10; ++step) {
+        engine.step();
+        REQUIRE(engine.spatialIndex().size() == engine.agents().size());
+    }
+
+    SimulationMetrics metrics;
+    engine.computeMetrics(&metrics);
+    REQUIRE(metrics.total_cancer_cells() > 100);
+    REQUIRE(metrics.total_immune_cells() == 50);
+
+    // Division and migration respect contact inhibition
+    REQUIRE(maxOccupancy() <= limit);
+}
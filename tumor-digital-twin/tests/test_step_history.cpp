@@ -0,0 +1,220 @@
+#include <catch2/catch_test_macros.hpp>
+#include <atomic>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "simulation/simulation_engine.h"
+#include "storage/step_history.h"
+
+using namespace tumordtwin;
+
+namespace {
+
+SimulationParameters smallParameters() {
+    SimulationParameters params;
+    params.set_grid_size_x(24);
+    params.set_grid_size_y(20);
+    params.set_grid_size_z(16);
+    params.set_spatial_resolution(10.0);
+    params.set_num_steps(40);
+    params.set_time_step(0.1);
+    params.set_division_rate(0.5);
+    params.set_death_rate(0.05);
+    params.set_migration_rate(0.1);
+    params.set_mutation_rate(0.1);
+    params.set_oxygen_diffusion_coeff(100.0);
+    params.set_glucose_diffusion_coeff(80.0);
+    params.set_checkpoint_interval(10);
+    (*params.mutable_extra_params())[SimulationEngine::kParamInitialTumorCells] = 300;
+    return params;
+}
+
+std::string tempDirectory(const std::string& name) {
+    return (std::filesystem::temp_directory_path() / ("tumordtwin_test_" + name)).string();
+}
+
+SimulationMetrics metricsAt(int32_t step) {
+    SimulationMetrics metrics;
+    metrics.set_step_number(step);
+    metrics.set_simulation_time(step * 0.1);
+    metrics.set_total_cancer_cells(1000 + step);
+    metrics.set_total_cells(2000 + step);
+    metrics.set_tumor_volume(step * 1.5);
+    metrics.set_avg_oxygen(0.5 / step);
+    auto* subclone = metrics.add_subclones();
+    subclone->set_frequency(1.0);
+    subclone->set_cell_count(step);
+    (*metrics.mutable_extra_metrics())["profile.diffusion_ms"] = step * 0.01;
+    return metrics;
+}
+
+} // namespace
+
+TEST_CASE("Step history seeks metrics of any recorded step", "[step_history]") {
+    const std::string directory = tempDirectory("history_metrics");
+    std::string error_msg;
+    {
+        StepHistory history(directory);
+        REQUIRE(history.open(smallParameters(), -1, error_msg));
+        REQUIRE(history.rows() == 0);
+        REQUIRE(history.firstStep() == -1);
+        for (int32_t step = 1; step <= 50; ++step) {
+            REQUIRE(history.append(metricsAt(step), error_msg));
+        }
+        REQUIRE(history.rows() == 50);
+        REQUIRE(history.firstStep() == 1);
+
+        SimulationMetrics metrics;
+        REQUIRE(history.metrics(25, &metrics, error_msg));
+        const SimulationMetrics expected = metricsAt(25);
+        REQUIRE(metrics.SerializeAsString() == expected.SerializeAsString());
+        REQUIRE_FALSE(history.metrics(51, &metrics, error_msg));
+        REQUIRE_FALSE(history.metrics(0, &metrics, error_msg));
+
+        SECTION("Ranges are read column by column") {
+            MetricHistory range;
+            REQUIRE(history.read(10, 30, 5, true, &range, error_msg));
+            REQUIRE(range.step_number_size() == 5);
+            REQUIRE(range.total_cancer_cells_size() == 5);
+            REQUIRE(range.details_size() == 5);
+            for (int i = 0; i < 5; ++i) {
+                const int32_t step = 10 + 5 * i;
+                REQUIRE(range.step_number(i) == step);
+                REQUIRE(range.total_cancer_cells(i) == 1000 + step);
+                REQUIRE(range.avg_oxygen(i) == 0.5 / step);
+                REQUIRE(range.details(i).subclones(0).cell_count() == step);
+                REQUIRE(range.details(i).step_number() == 0);
+            }
+
+            // Bounds are clamped to the recorded steps
+            MetricHistory all;
+            REQUIRE(history.read(-5, 1000, 1, false, &all, error_msg));
+            REQUIRE(all.step_number_size() == 50);
+            REQUIRE(all.details_size() == 0);
+        }
+
+        SECTION("Steps must follow each other") {
+            REQUIRE_FALSE(history.append(metricsAt(52), error_msg));
+            REQUIRE(history.rows() == 50);
+            REQUIRE(history.append(metricsAt(51), error_msg));
+        }
+    }
+
+    SECTION("A resumed run rewinds the history to its checkpoint") {
+        StepHistory history(directory);
+        REQUIRE(history.open(smallParameters(), 20, error_msg));
+        REQUIRE(history.rows() == 20);
+        REQUIRE(history.append(metricsAt(21), error_msg));
+
+        SimulationMetrics metrics;
+        REQUIRE(history.metrics(21, &metrics, error_msg));
+        REQUIRE(metrics.total_cells() == 2021);
+        REQUIRE_FALSE(history.metrics(22, &metrics, error_msg));
+    }
+
+    SECTION("A history that stops short of the checkpoint starts over") {
+        StepHistory history(directory);
+        REQUIRE(history.open(smallParameters(), 80, error_msg));
+        REQUIRE(history.rows() == 0);
+        REQUIRE(history.append(metricsAt(81), error_msg));
+        REQUIRE(history.firstStep() == 81);
+    }
+
+    std::filesystem::remove_all(directory);
+}
+
+TEST_CASE("Step history stores snapshots losslessly", "[step_history]") {
+    const std::string directory = tempDirectory("history_snapshots");
+    SimulationEngine engine(smallParameters(), 1);
+    engine.initialize();
+    for (int step = 0; step < 10; ++step) {
+        engine.step();
+    }
+    auto snapshot = engine.snapshot();
+
+    std::string error_msg;
+    {
+        StepHistory history(directory);
+        REQUIRE(history.open(smallParameters(), -1, error_msg));
+        REQUIRE(StepHistory::snapshotInterval(history.parameters()) == 10);
+        REQUIRE(history.writeSnapshot(*snapshot, error_msg));
+        REQUIRE(history.snapshotSteps() == std::vector<int32_t>{10});
+        REQUIRE(history.loadSnapshot(9, error_msg) == nullptr);
+
+        auto loaded = history.loadSnapshot(10, error_msg);
+        REQUIRE(loaded);
+        REQUIRE(loaded->step == 10);
+        REQUIRE(loaded->time == snapshot->time);
+        REQUIRE(loaded->metrics.total_cells() == snapshot->metrics.total_cells());
+        REQUIRE(loaded->parameters.grid_size_x() == 24);
+        REQUIRE(loaded->oxygen.size() == snapshot->oxygen.size());
+        for (size_t i = 0; i < snapshot->oxygen.size(); ++i) {
+            REQUIRE(loaded->oxygen.data()[i] == snapshot->oxygen.data()[i]);
+            REQUIRE(loaded->glucose.data()[i] == snapshot->glucose.data()[i]);
+        }
+        REQUIRE(loaded->agents.size() == snapshot->agents.size());
+        for (size_t i = 0; i < snapshot->agents.size(); ++i) {
+            REQUIRE(loaded->agents.ids()[i] == snapshot->agents.ids()[i]);
+            REQUIRE(loaded->agents.x()[i] == snapshot->agents.x()[i]);
+            REQUIRE(loaded->agents.states()[i] == snapshot->agents.states()[i]);
+        }
+    }
+
+    SECTION("Snapshots are found again on reopen") {
+        StepHistory history(directory);
+        REQUIRE(history.open(smallParameters(), 10, error_msg));
+        REQUIRE(history.snapshotSteps() == std::vector<int32_t>{10});
+        REQUIRE(history.loadSnapshot(10, error_msg));
+    }
+
+    SECTION("Snapshots after the checkpoint of a resumed run are dropped") {
+        StepHistory history(directory);
+        REQUIRE(history.open(smallParameters(), 5, error_msg));
+        REQUIRE(history.snapshotSteps().empty());
+        REQUIRE(history.loadSnapshot(10, error_msg) == nullptr);
+    }
+
+    std::filesystem::remove_all(directory);
+}
+
+TEST_CASE("Step history is readable while it is written", "[step_history]") {
+    const std::string directory = tempDirectory("history_concurrent");
+    StepHistory history(directory);
+    std::string error_msg;
+    REQUIRE(history.open(smallParameters(), -1, error_msg));
+
+    constexpr int32_t kSteps = 2000;
+    std::atomic<bool> writer_ok{true};
+    std::thread writer([&] {
+        std::string writer_error;
+        for (int32_t step = 1; step <= kSteps; ++step) {
+            if (!history.append(metricsAt(step), writer_error)) {
+                writer_ok = false;
+                return;
+            }
+        }
+    });
+
+    // Every published step reads back whole, however far the writer has got
+    bool reads_ok = true;
+    size_t seen = 0;
+    while (seen < kSteps && writer_ok) {
+        const size_t rows = history.rows();
+        if (rows == 0) {
+            continue;
+        }
+        const auto step = static_cast<int32_t>(rows);
+        SimulationMetrics metrics;
+        reads_ok = reads_ok && history.metrics(step, &metrics, error_msg) &&
+                   metrics.total_cells() == 2000 + step && metrics.subclones_size() == 1;
+        seen = rows;
+    }
+    writer.join();
+
+    REQUIRE(writer_ok);
+    REQUIRE(reads_ok);
+    REQUIRE(history.rows() == kSteps);
+    std::filesystem::remove_all(directory);
+}